@@ -183,7 +183,8 @@ void DrawBackground()
 
   // method 3:
   // let the sdk handle it, with vmupro_blit_infinite_scrolling_background()
-  // issue for claude: still hangs the device
+  // still hangs the device with large scroll values; the wrap of any
+  // value is only in the host simulator so far
   if (method == 3)
   {
     Img *img = &img_sdk_tile_bg_brown_raw;
@@ -4,7 +4,8 @@
  * 
  * This header provides audio functionality for the VMUPro device.
  * 
- * @note Currently only supports 44.1kHz mono audio
+ * @note Currently only supports 44.1kHz mono audio, see vmupro_resampler.h to
+ *       stream other rates
  * @note Audio functions are designed for real-time audio streaming
  * 
  * @author 8BitMods
@@ -0,0 +1,141 @@
+/**
+ * @file vmupro_audio_pull.h
+ * @brief VMUPro Callback (Pull) Audio
+ *
+ * With vmupro_audio_add_stream_samples() the app pushes audio from its
+ * own loop, so a slow frame empties the ring buffer and a generous top-up
+ * adds latency. In pull mode the app registers a fill callback instead,
+ * and an audio task asks it for one fixed-size period at a time, keeping
+ * a set number of periods queued: small periods give low latency, more
+ * periods give more headroom. The game loop no longer touches the ring
+ * buffer at all.
+ *
+ * The task counts underruns (the ring buffer ran dry before the next
+ * period was queued) and callbacks that took longer than a period, and
+ * measures the output latency: how long the newest period waits in the
+ * ring buffer before it is heard.
+ *
+ * Emulator cores that produce a frame's worth of audio at a time can
+ * queue it from the game loop into their own FIFO and let the callback
+ * drain that FIFO a period at a time.
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-08-06
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Smallest period in frames */
+#define VMUPRO_AUDIO_PULL_MIN_PERIOD 32
+
+/** Largest period in frames */
+#define VMUPRO_AUDIO_PULL_MAX_PERIOD 2048
+
+/** Most periods that can be kept queued */
+#define VMUPRO_AUDIO_PULL_MAX_PERIODS 8
+
+  /**
+   * @brief Fill callback, called on the audio task
+   *
+   * Must write every frame: fill with silence when there is nothing to
+   * play. Keep it short, it has one period of time at most.
+   *
+   * @param samples Destination, frames samples in mono or frames
+   *                interleaved left/right pairs in stereo
+   * @param frames Frames to write, always the configured period
+   * @param user Pointer passed to vmupro_audio_pull_start()
+   */
+  typedef void (*vmupro_audio_fill_t)(int16_t *samples, int frames, void *user);
+
+  /**
+   * @brief Pull mode settings
+   */
+  typedef struct
+  {
+    uint32_t period_frames;   /**< Frames per callback, e.g. 128, 256 or 512 */
+    uint8_t periods;          /**< Periods kept queued, 2 to VMUPRO_AUDIO_PULL_MAX_PERIODS */
+    bool stereo;              /**< Callback writes interleaved stereo rather than mono */
+    bool apply_global_volume; /**< Apply the system volume, see vmupro_audio_add_stream_samples() */
+  } vmupro_audio_pull_config_t;
+
+  /**
+   * @brief Pull mode counters, since vmupro_audio_pull_start() or the last reset
+   */
+  typedef struct
+  {
+    uint32_t callbacks;        /**< Periods filled */
+    uint32_t underruns;        /**< Times the ring buffer was found empty */
+    uint32_t late_callbacks;   /**< Callbacks that took longer than a period */
+    uint32_t last_callback_us; /**< Duration of the last callback */
+    uint32_t max_callback_us;  /**< Slowest callback */
+    uint32_t latency_us;       /**< Output latency of the last period queued */
+    uint32_t max_latency_us;   /**< Highest output latency seen */
+  } vmupro_audio_pull_stats_t;
+
+  /**
+   * @brief Default settings: 256 frame stereo periods, 2 queued (about 12 ms)
+   */
+  static inline vmupro_audio_pull_config_t vmupro_audio_pull_defaults(void)
+  {
+    vmupro_audio_pull_config_t config = {256, 2, true, true};
+    return config;
+  }
+
+  /**
+   * @brief Enter listen mode and start calling fill from the audio task
+   *
+   * @param config Period size and count, NULL for vmupro_audio_pull_defaults()
+   * @param fill Callback producing each period
+   * @param user Passed to fill
+   * @return false if already running, the settings are out of range or
+   *         the task can't be started
+   *
+   * @code
+   * static void fill(int16_t *samples, int frames, void *user) {
+   *     emulator_read_audio(samples, frames); // stereo, silence if behind
+   * }
+   *
+   * vmupro_audio_pull_config_t config = vmupro_audio_pull_defaults();
+   * config.period_frames = 128;
+   * vmupro_audio_pull_start(&config, fill, NULL);
+   * @endcode
+   */
+  bool vmupro_audio_pull_start(const vmupro_audio_pull_config_t *config, vmupro_audio_fill_t fill, void *user);
+
+  /**
+   * @brief Stop the audio task and leave listen mode
+   *
+   * Once this returns the callback is no longer running.
+   */
+  void vmupro_audio_pull_stop(void);
+
+  /**
+   * @brief Whether pull mode is running
+   */
+  bool vmupro_audio_pull_is_running(void);
+
+  /**
+   * @brief Read the pull mode counters
+   *
+   * @param out_stats Destination for the counters
+   */
+  void vmupro_audio_pull_get_stats(vmupro_audio_pull_stats_t *out_stats);
+
+  /**
+   * @brief Zero the pull mode counters
+   */
+  void vmupro_audio_pull_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
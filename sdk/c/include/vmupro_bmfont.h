@@ -0,0 +1,196 @@
+/**
+ * @file vmupro_bmfont.h
+ * @brief VMUPro Custom Bitmap Fonts
+ *
+ * This header adds fonts beyond the built-in vmupro_font_id_t set. Fonts
+ * are converted offline from BMFont output (a .fnt file and its page
+ * images) with tools/sprites/font_bmfont.py and used in place: the glyph
+ * table, kerning pairs and anti-aliased glyph bitmaps are read straight
+ * from the font data, whether that is a .vmupack resource or a const
+ * array compiled into the app, so nothing is copied to RAM.
+ *
+ * Strings are UTF-8. Plain ASCII characters are looked up through a
+ * direct table without decoding or searching, everything else through a
+ * binary search of the glyph table, so localised text can be drawn
+ * directly instead of being pre-rendered into sprites.
+ *
+ * In partial update mode the drawn text is only marked dirty when the SDK
+ * is built with VMUPRO_FIRMWARE_DIRTY_RECTS, which needs firmware newer
+ * than 2.0.0 (see vmupro_mark_dirty_rect()).
+ *
+ * ## Format
+ * Little endian, 4 byte aligned. A vmupro_bmfont_header_t, then:
+ *
+ * | Section  | Contents                                                      |
+ * |----------|---------------------------------------------------------------|
+ * | Glyphs   | glyph_count x vmupro_bmfont_glyph_t, sorted by codepoint      |
+ * | Kerning  | kerning_count x vmupro_bmfont_kerning_t, grouped by first glyph and sorted by second |
+ * | Bitmaps  | 4bpp coverage (0-15) per glyph, (width + 1) / 2 bytes per row, left pixel in the high nibble |
+ *
+ * Section positions are byte offsets from the start of the font.
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-08-01
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define VMUPRO_BMFONT_MAGIC 0x4642 /**< "BF" read as a little endian uint16 */
+#define VMUPRO_BMFONT_VERSION 1
+
+/** Glyph index meaning "no glyph" in the ASCII table and the fallback field */
+#define VMUPRO_BMFONT_NO_GLYPH 0xffff
+
+  /**
+   * @brief Font header
+   */
+  typedef struct
+  {
+    uint16_t magic;          /**< VMUPRO_BMFONT_MAGIC */
+    uint8_t version;         /**< VMUPRO_BMFONT_VERSION */
+    uint8_t flags;           /**< Reserved, 0 */
+    uint16_t line_height;    /**< Distance between lines in pixels */
+    uint16_t base;           /**< Distance from the top of a line to the baseline */
+    uint16_t glyph_count;    /**< Entries in the glyph table */
+    uint16_t kerning_count;  /**< Entries in the kerning table */
+    uint16_t fallback;       /**< Glyph drawn for missing characters, or VMUPRO_BMFONT_NO_GLYPH */
+    uint16_t reserved;       /**< 0 */
+    uint32_t glyphs_offset;  /**< Offset of the glyph table */
+    uint32_t kerning_offset; /**< Offset of the kerning table */
+    uint32_t bitmap_offset;  /**< Offset of the glyph bitmaps */
+    uint16_t ascii[96];      /**< Glyph index of characters 0x20-0x7f, or VMUPRO_BMFONT_NO_GLYPH */
+  } vmupro_bmfont_header_t;
+
+  /**
+   * @brief One glyph. Bitmaps are trimmed to the inked area
+   */
+  typedef struct
+  {
+    uint32_t codepoint;     /**< Unicode codepoint */
+    uint32_t bitmap;        /**< Offset of the coverage, from the start of the bitmaps */
+    uint8_t width;          /**< Bitmap width in pixels */
+    uint8_t height;         /**< Bitmap height in pixels */
+    int8_t x_offset;        /**< Bitmap position from the pen */
+    int8_t y_offset;        /**< Bitmap position from the top of the line */
+    uint8_t advance;        /**< Pen advance in pixels */
+    uint8_t kerning_count;  /**< Kerning pairs with this glyph first */
+    uint16_t kerning_index; /**< First of those pairs in the kerning table */
+  } vmupro_bmfont_glyph_t;
+
+  /**
+   * @brief Kerning adjustment after a glyph, for one following glyph
+   */
+  typedef struct
+  {
+    uint16_t second; /**< Glyph index of the following glyph */
+    int16_t amount;  /**< Added to the pen advance */
+  } vmupro_bmfont_kerning_t;
+
+  /**
+   * @brief A loaded font, pointing into the font data
+   */
+  typedef struct
+  {
+    const vmupro_bmfont_header_t *header;   /**< Font header */
+    const vmupro_bmfont_glyph_t *glyphs;    /**< Glyph table */
+    const vmupro_bmfont_kerning_t *kerning; /**< Kerning table */
+    const uint8_t *bitmaps;                 /**< Glyph bitmaps */
+  } vmupro_bmfont_t;
+
+  /**
+   * @brief Check font data and set up a font that reads from it
+   *
+   * Nothing is copied, data must stay valid and unchanged while the font
+   * is in use.
+   *
+   * @param font Font to set up
+   * @param data Font data from font_bmfont.py, 4 byte aligned
+   * @param size Size of data in bytes
+   * @return true if data is a valid font, false otherwise
+   *
+   * @code
+   * // py tools/sprites/font_bmfont.py title.fnt --header title_font.h
+   * #include "title_font.h"
+   *
+   * vmupro_bmfont_t title;
+   * vmupro_bmfont_load(&title, title_font, sizeof(title_font));
+   * @endcode
+   */
+  bool vmupro_bmfont_load(vmupro_bmfont_t *font, const uint8_t *data, uint32_t size);
+
+  /**
+   * @brief Decode the next character of a UTF-8 string
+   *
+   * Invalid sequences (stray continuation bytes, overlong forms,
+   * surrogates, values above U+10FFFF) decode as U+FFFD and consume one
+   * byte, so decoding always makes progress.
+   *
+   * @param text Position in the string, advanced past the character
+   * @return Codepoint, or 0 at the end of the string
+   */
+  uint32_t vmupro_utf8_next(const char **text);
+
+  /**
+   * @brief Look up the glyph for a character
+   *
+   * @param font Loaded font
+   * @param codepoint Unicode codepoint
+   * @return Glyph, or NULL if the font has none (the fallback is not applied)
+   */
+  const vmupro_bmfont_glyph_t *vmupro_bmfont_find_glyph(const vmupro_bmfont_t *font, uint32_t codepoint);
+
+  /**
+   * @brief Kerning between two characters
+   *
+   * @param font Loaded font
+   * @param first Codepoint of the left character
+   * @param second Codepoint of the right character
+   * @return Pixels added to the advance of first, 0 if the pair isn't kerned
+   */
+  int vmupro_bmfont_get_kerning(const vmupro_bmfont_t *font, uint32_t first, uint32_t second);
+
+  /**
+   * @brief Width of a UTF-8 string, including kerning
+   *
+   * @param font Loaded font
+   * @param text Null-terminated UTF-8 string, '\n' starts a new line
+   * @return Width of the widest line in pixels
+   */
+  int vmupro_bmfont_text_width(const vmupro_bmfont_t *font, const char *text);
+
+  /**
+   * @brief Draw a UTF-8 string with a transparent background
+   *
+   * Glyph coverage is blended over the back buffer in color. Characters
+   * the font doesn't have are drawn as the fallback glyph, or skipped if
+   * there is none. '\n' moves down one line_height and back to x.
+   *
+   * @param font Loaded font
+   * @param text Null-terminated UTF-8 string
+   * @param x Left edge of the first line
+   * @param y Top of the first line
+   * @param color Text colour (RGB565)
+   * @return Width of the widest line in pixels
+   *
+   * @note Clipped to the screen. The colour window is not applied
+   *
+   * @code
+   * int width = vmupro_bmfont_text_width(&title, "Größe");
+   * vmupro_bmfont_draw_text(&title, "Größe", (240 - width) / 2, 40, VMUPRO_COLOR_WHITE);
+   * @endcode
+   */
+  int vmupro_bmfont_draw_text(const vmupro_bmfont_t *font, const char *text, int x, int y, uint16_t color);
+
+#ifdef __cplusplus
+}
+#endif
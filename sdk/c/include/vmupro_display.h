@@ -232,6 +232,354 @@ extern "C"
    */
   void vmupro_push_double_buffer_frame();
 
+  // Split Rendering
+  //
+  // Needs firmware newer than 2.0.0. Firmware 2.0.0 doesn't export these
+  // functions yet, so an app calling them won't load on it. Only the host
+  // simulator (tools/hostsim) implements them for now.
+
+  /**
+   * @brief Split full screen passes across both cores
+   *
+   * When enabled, the second core draws the bottom half of the screen for
+   * vmupro_render_all_layers(), vmupro_blit_scrolling_background() and
+   * vmupro_apply_mosaic_to_screen(), and the second half of the pixels for
+   * vmupro_blend_layers_*(), while the calling core does the rest. Each
+   * call returns once both halves are done, so the output is identical and
+   * drawing code needs no changes. vmupro_push_double_buffer_frame() and
+   * vmupro_display_refresh() also wait for the second core before sending.
+   *
+   * @param enabled true to split these passes, false to run them on the
+   *                calling core only (default)
+   *
+   * @note Leave it off while using vmupro_display_list_replay_async(), which
+   *       already keeps the second core busy
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_set_split_rendering(bool enabled);
+
+  /**
+   * @brief Check whether full screen passes are split across both cores
+   *
+   * @return true if split rendering is enabled
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  bool vmupro_get_split_rendering(void);
+
+  // Triple Buffering & Frame Pacing
+  //
+  // Needs firmware newer than 2.0.0. Firmware 2.0.0 doesn't export these
+  // functions yet, so an app calling them won't load on it. Only the host
+  // simulator (tools/hostsim) implements them for now.
+
+  /**
+   * @brief Called when a pushed frame has been completely sent to the panel
+   *
+   * @param present_time_us vmupro_get_time_us() time the transfer finished
+   * @param user_data Pointer passed to vmupro_set_frame_done_callback()
+   */
+  typedef void (*vmupro_frame_done_callback_t)(uint64_t present_time_us, void *user_data);
+
+  /**
+   * @brief Use a third framebuffer with the double buffer renderer
+   *
+   * With two buffers, vmupro_push_double_buffer_frame() stalls until the
+   * previous frame has been sent, because the only other buffer is still
+   * being read. With a third buffer the pushed frame is queued behind the
+   * one in flight and drawing continues straight away; a push only stalls
+   * when one frame is in flight and another is already queued.
+   *
+   * @param enabled true for three buffers, false for two (default)
+   *
+   * @note Costs another 115KB framebuffer and adds up to one frame of latency
+   * @note Takes effect from the next push, frames already queued are sent first
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_set_triple_buffering(bool enabled);
+
+  /**
+   * @brief Check whether triple buffering is enabled
+   *
+   * @return true if three framebuffers are in use
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  bool vmupro_get_triple_buffering(void);
+
+  /**
+   * @brief Push the back buffer only if that would not stall
+   *
+   * Non-blocking variant of vmupro_push_double_buffer_frame(). When the
+   * panel transfer can't accept another frame yet, nothing is pushed and
+   * the back buffer keeps its contents, so the app can run another update
+   * step or simply try again later.
+   *
+   * @return true if the frame was pushed, false if it would have stalled or
+   *         the double buffer renderer is stopped or paused
+   * @note Needs firmware newer than 2.0.0
+   */
+  bool vmupro_try_push_double_buffer_frame(void);
+
+  /**
+   * @brief Number of pushed frames not yet completely sent to the panel
+   *
+   * @return 0 when idle, 1 while a frame is in flight, 2 when another frame
+   *         is queued behind it (triple buffering only)
+   * @note Needs firmware newer than 2.0.0
+   */
+  int vmupro_get_pending_frames(void);
+
+  /**
+   * @brief Time the last pushed frame finished reaching the panel
+   *
+   * @return vmupro_get_time_us() time of the last completed transfer, 0 if
+   *         no frame has been presented yet
+   * @note Needs firmware newer than 2.0.0
+   */
+  uint64_t vmupro_get_last_present_time_us(void);
+
+  /**
+   * @brief Get notified when each pushed frame has reached the panel
+   *
+   * @param callback Function to call, or NULL to stop notifications
+   * @param user_data Passed back to the callback
+   *
+   * @note Runs on the display transfer path - keep it short and don't draw
+   *       or push frames from it
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_set_frame_done_callback(vmupro_frame_done_callback_t callback, void *user_data);
+
+  // Partial Display Updates
+  //
+  // Needs firmware newer than 2.0.0. Firmware 2.0.0 doesn't export these
+  // functions yet, so an app calling them won't load on it. Only the host
+  // simulator (tools/hostsim) implements them for now.
+  #define VMUPRO_MAX_DIRTY_RECTS 16
+
+  /**
+   * @brief Screen-space rectangle
+   */
+  typedef struct {
+    int x, y;                  /**< Top-left corner */
+    int width, height;         /**< Size in pixels */
+  } vmupro_rect_t;
+
+  /**
+   * @brief Enable or disable partial display updates
+   *
+   * Every vmupro_draw_* and vmupro_blit_* call records the screen area it
+   * touched. In partial update mode, vmupro_push_double_buffer_frame() and
+   * vmupro_display_refresh() only send the merged dirty rectangles to the
+   * panel instead of the full 240x240 frame, cutting SPI bandwidth and power
+   * for apps where little changes between frames.
+   *
+   * After a push the dirty areas are copied into the new back buffer, so it
+   * always matches what is on the panel and only changed areas need redrawing.
+   *
+   * @param enabled true to send only dirty areas, false to send full frames
+   *
+   * @note Enabling marks the whole screen dirty so the next push is a full frame
+   * @note vmupro_display_clear() marks the whole screen dirty - don't clear
+   *       every frame if you want to benefit from partial updates
+   * @note Writes made directly through vmupro_get_back_buffer() are not tracked,
+   *       report them with vmupro_mark_dirty_rect(). The SDK-side renderers
+   *       (RLE and indexed sprites, cached text, custom fonts) do that when
+   *       the SDK is built with VMUPRO_FIRMWARE_DIRTY_RECTS
+   *
+   * @example
+   * @code
+   * vmupro_start_double_buffer_renderer();
+   * vmupro_set_partial_update_mode(true);
+   * DrawStaticScene();
+   * while (running) {
+   *     // only the HUD counter changes, ~1KB is sent instead of 115KB
+   *     vmupro_draw_fill_rect(200, 4, 229, 19, VMUPRO_COLOR_BLACK);
+   *     vmupro_draw_text(score_text, 200, 4, VMUPRO_COLOR_WHITE, VMUPRO_COLOR_BLACK);
+   *     vmupro_push_double_buffer_frame();
+   * }
+   * @endcode
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_set_partial_update_mode(bool enabled);
+
+  /**
+   * @brief Check whether partial display updates are enabled
+   *
+   * @return true if only dirty areas are sent to the panel
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  bool vmupro_get_partial_update_mode(void);
+
+  /**
+   * @brief Mark a screen area as changed
+   *
+   * Use after writing to the framebuffer directly (e.g. through
+   * vmupro_get_back_buffer()) so the area is included in the next partial update.
+   *
+   * @param x Left coordinate of the area
+   * @param y Top coordinate of the area
+   * @param width Width of the area in pixels
+   * @param height Height of the area in pixels
+   *
+   * @note The area is clipped to the screen
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_mark_dirty_rect(int x, int y, int width, int height);
+
+  /**
+   * @brief Get the merged dirty rectangles for the frame being drawn
+   *
+   * Overlapping areas are merged, and once VMUPRO_MAX_DIRTY_RECTS is reached
+   * new areas are folded into the rectangle they grow the least, so the
+   * result never has more than VMUPRO_MAX_DIRTY_RECTS entries.
+   *
+   * @param out_rects Array to receive the rectangles (may be NULL to just count)
+   * @param max_rects Capacity of out_rects
+   * @return Number of dirty rectangles
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  int vmupro_get_dirty_rects(vmupro_rect_t *out_rects, int max_rects);
+
+  // Display Lists
+  //
+  // Needs firmware newer than 2.0.0. Firmware 2.0.0 doesn't export these
+  // functions yet, so an app calling them won't load on it. Only the host
+  // simulator (tools/hostsim) implements them for now.
+  #define VMUPRO_DL_SORT_LAYERS 0x01  /**< Replay in layer order (stable within a layer) */
+  #define VMUPRO_DL_CULL_OVERDRAW 0x02 /**< Skip commands completely hidden by later opaque rectangles */
+
+  /**
+   * @brief Display list recording into a caller supplied arena
+   *
+   * Commands are appended from the start of the arena and an 8 byte index
+   * entry per command from the end, so no other memory is allocated.
+   * Treat the fields as read only.
+   */
+  typedef struct {
+    uint8_t *arena;     /**< Arena start (8 byte aligned) */
+    uint32_t size;      /**< Arena size in bytes */
+    uint32_t used;      /**< Bytes of commands recorded */
+    uint32_t count;     /**< Commands recorded */
+    uint32_t window;    /**< Colour window state at the end of recording (internal) */
+    int16_t layer;      /**< Layer assigned to new commands */
+    bool overflow;      /**< The arena ran out, later commands were dropped */
+  } vmupro_display_list_t;
+
+  /**
+   * @brief Prepare a display list over an arena
+   *
+   * @param list List to initialize
+   * @param arena Memory for the commands, 8 byte aligned
+   * @param arena_size Size of arena in bytes
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_display_list_init(vmupro_display_list_t *list, void *arena, uint32_t arena_size);
+
+  /**
+   * @brief Start recording on the calling core
+   *
+   * Clears the list. Until vmupro_display_list_end(), every vmupro_draw_*,
+   * vmupro_blit_* and other drawing call in this header made from this
+   * core is appended to the list instead of drawing. Colour window changes
+   * are recorded with the commands they affect.
+   *
+   * Small parameter blocks (polygon points, affine matrices, sprite arrays,
+   * tilemap descriptions) are copied. Pixel buffers, palettes and other
+   * tables are referenced and must stay valid until the list is replayed.
+   *
+   * Calls that do not draw to the screen (layer setup, palette animation,
+   * vmupro_blend_layers_*) and blits from other SDK headers that write the
+   * back buffer directly still run immediately.
+   *
+   * @param list List to record into
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_display_list_begin(vmupro_display_list_t *list);
+
+  /**
+   * @brief Set the layer of the commands recorded next
+   *
+   * With VMUPRO_DL_SORT_LAYERS, lower layers are replayed first, so a game
+   * can record in update order (e.g. HUD, then entities, then background)
+   * and still draw back to front.
+   *
+   * @param layer Layer number, default 0
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_display_list_set_layer(int layer);
+
+  /**
+   * @brief Stop recording on the calling core
+   *
+   * @return false if the arena overflowed and commands were dropped
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  bool vmupro_display_list_end(void);
+
+  /**
+   * @brief Execute a recorded display list against the back buffer
+   *
+   * The list can be replayed any number of times. Sorting happens in place
+   * on the list's index.
+   *
+   * @param list Recorded list
+   * @param flags VMUPRO_DL_SORT_LAYERS and/or VMUPRO_DL_CULL_OVERDRAW
+   * @return Number of commands executed (culled ones excluded)
+   *
+   * @note Culling only uses commands that fully cover a rectangle with no
+   *       colour key or blending (clears, fills, opaque blits, backgrounds);
+   *       flood fills and screen mosaics are never reordered across
+   * @note Needs firmware newer than 2.0.0
+   */
+  int vmupro_display_list_replay(vmupro_display_list_t *list, uint32_t flags);
+
+  /**
+   * @brief Replay a display list on the second core
+   *
+   * Returns immediately; the calling core can record the next frame into
+   * another list meanwhile. Do not draw directly or push frames until
+   * vmupro_display_list_wait() returns.
+   *
+   * @param list Recorded list (must not be modified until the replay finishes)
+   * @param flags As for vmupro_display_list_replay()
+   * @return false if a replay is already running or could not be started
+   *
+   * @code
+   * vmupro_display_list_t lists[2]; // each over its own arena
+   * int cur = 0;
+   * while (running) {
+   *   vmupro_display_list_begin(&lists[cur]);
+   *   DrawGame();                      // records, fast
+   *   vmupro_display_list_end();
+   *   vmupro_display_list_wait();      // previous frame rasterized
+   *   vmupro_push_double_buffer_frame();
+   *   vmupro_display_list_replay_async(&lists[cur], VMUPRO_DL_SORT_LAYERS | VMUPRO_DL_CULL_OVERDRAW);
+   *   cur ^= 1;
+   * }
+   * @endcode
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  bool vmupro_display_list_replay_async(vmupro_display_list_t *list, uint32_t flags);
+
+  /**
+   * @brief Wait for the replay started by vmupro_display_list_replay_async()
+   *
+   * @return Commands executed by that replay, or 0 if none was running
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  int vmupro_display_list_wait(void);
+
   /**
    * @brief Draw a rectangle outline
    *
@@ -447,11 +795,101 @@ extern "C"
    * 
    * @note Rotation is clockwise around the center point (x, y)
    * @note Uses bilinear interpolation for smooth edges
+   * @note In the host simulator, shorthand for vmupro_blit_buffer_affine()
+   *       with a rotation matrix
    * @note PERFORMANCE WARNING: Significantly slower than 90-degree rotation
    * @note Final dimensions may be larger due to rotation bounds
    */
   void vmupro_blit_buffer_rotated_precise(uint8_t* buffer, int x, int y, int width, int height, int rotation_degrees);
 
+  // Affine Blits
+  //
+  // Needs firmware newer than 2.0.0. Firmware 2.0.0 doesn't export these
+  // functions yet, so an app calling them won't load on it. Only the host
+  // simulator (tools/hostsim) implements them for now.
+
+  /**
+   * @brief 2x3 affine transform in 16.16 fixed point
+   *
+   * Maps a source pixel position (u, v) to the screen position
+   *   x = a * u + b * v + tx
+   *   y = c * u + d * v + ty
+   * so any mix of rotation, scale, shear, flip and translation is one matrix.
+   * 0x10000 is 1.0.
+   */
+  typedef struct {
+    int32_t a, b, tx; /**< Screen x row */
+    int32_t c, d, ty; /**< Screen y row */
+  } vmupro_affine_t;
+
+  /**
+   * @brief Sampling used by vmupro_blit_buffer_affine()
+   */
+  typedef enum
+  {
+    VMUPRO_SAMPLE_NEAREST = 0,  /**< Nearest source pixel, fastest, hard edges */
+    VMUPRO_SAMPLE_BILINEAR = 1  /**< Weighted 2x2 source pixels, smooth under rotation and scaling */
+  } vmupro_sample_mode_t;
+
+  /**
+   * @brief Build a rotate + scale matrix around a pivot
+   *
+   * The source pivot lands on (dest_x, dest_y), the image is scaled about
+   * it, then rotated clockwise by angle degrees. All values are 16.16.
+   *
+   * @param matrix Matrix to fill
+   * @param angle Clockwise rotation in degrees (16.16, any value)
+   * @param scale_x Horizontal scale (16.16, negative mirrors)
+   * @param scale_y Vertical scale (16.16, negative mirrors)
+   * @param pivot_x Pivot X in the source region (16.16)
+   * @param pivot_y Pivot Y in the source region (16.16)
+   * @param dest_x Screen X of the pivot (16.16)
+   * @param dest_y Screen Y of the pivot (16.16)
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_affine_rotate_scale(vmupro_affine_t *matrix, int32_t angle, int32_t scale_x, int32_t scale_y,
+                                  int32_t pivot_x, int32_t pivot_y, int32_t dest_x, int32_t dest_y);
+
+  /**
+   * @brief Blit a buffer region through an affine transform
+   *
+   * One pass for any combination of rotation, scaling, shear and flips, so
+   * a rotating and zooming sprite needs no intermediate buffer. Only the
+   * transformed bounding box is visited, and each scanline is limited to
+   * the exact span that maps inside the source.
+   *
+   * Each screen pixel centre is mapped back into the source region;
+   * source pixel (i, j) covers [i, i + 1) x [j, j + 1).
+   *
+   * @param buffer Pointer to the source pixel buffer (RGB565)
+   * @param buffer_width Width of the full source buffer in pixels (stride)
+   * @param src_x Source region X
+   * @param src_y Source region Y
+   * @param src_width Source region width
+   * @param src_height Source region height
+   * @param matrix Transform from region coordinates to the screen
+   * @param sample VMUPRO_SAMPLE_NEAREST or VMUPRO_SAMPLE_BILINEAR
+   * @param transparent_color Colour key, or -1 to draw every pixel
+   * @param alpha Opacity (0-255, 255 = opaque)
+   *
+   * @note With a colour key and bilinear sampling, keyed pixels decide
+   *       coverage by the nearest sample and never bleed into edges
+   * @note Matrices that collapse the image to a line (zero determinant) draw nothing
+   *
+   * @code
+   * // boss rotating and pulsing around its centre, one blit
+   * vmupro_affine_t m;
+   * vmupro_affine_rotate_scale(&m, angle << 16, zoom, zoom, 32 << 16, 32 << 16, 120 << 16, 80 << 16);
+   * vmupro_blit_buffer_affine(boss, 64, 0, 0, 64, 64, &m, VMUPRO_SAMPLE_NEAREST, VMUPRO_COLOR_MAGENTA, 255);
+   * @endcode
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_blit_buffer_affine(uint8_t *buffer, int buffer_width, int src_x, int src_y, int src_width, int src_height,
+                                 const vmupro_affine_t *matrix, vmupro_sample_mode_t sample,
+                                 int transparent_color, uint8_t alpha);
+
   /**
    * @brief Blit a tiled pattern to fill an area
    * 
@@ -643,6 +1081,8 @@ extern "C"
    * @brief Blit an infinitely scrolling tiled background
    *
    * Creates an infinite scrolling effect by tiling a background pattern.
+   * The host simulator copies rows as one span per tile column, with the
+   * wrap computed once per call rather than per pixel.
    *
    * @param tile_buffer Pointer to the tile buffer
    * @param tile_width Width of a single tile
@@ -651,6 +1091,9 @@ extern "C"
    * @param scroll_y Vertical scroll offset
    * @param dest_width Destination width to fill
    * @param dest_height Destination height to fill
+   *
+   * @note Firmware 2.0.0 can hang on large scroll values, so keep them
+   *       wrapped to the tile size. Only the host simulator wraps any value
    */
   void vmupro_blit_infinite_scrolling_background(uint8_t *tile_buffer, int tile_width, int tile_height,
                                                  int scroll_x, int scroll_y, int dest_width, int dest_height);
@@ -1001,6 +1444,152 @@ extern "C"
    */
   void vmupro_sprite_batch_render(vmupro_sprite_t *sprites, int num_sprites);
 
+  // Sprite Batch Modes
+  //
+  // Needs firmware newer than 2.0.0. Firmware 2.0.0 doesn't export these
+  // functions yet, so an app calling them won't load on it. Only the host
+  // simulator (tools/hostsim) implements them for now.
+
+  /**
+   * @brief Sprite batch rendering strategies
+   */
+  typedef enum
+  {
+    VMUPRO_SPRITE_BATCH_DIRECT = 0,    /**< Draw each sprite straight to the framebuffer (default) */
+    VMUPRO_SPRITE_BATCH_TILED_16 = 16, /**< Composite 16x16 screen tiles in internal RAM */
+    VMUPRO_SPRITE_BATCH_TILED_32 = 32  /**< Composite 32x32 screen tiles in internal RAM */
+  } vmupro_sprite_batch_mode_t;
+
+  /**
+   * @brief Select how vmupro_sprite_batch_render() rasterizes
+   *
+   * In the tiled modes sprites are binned into screen tiles. Each tile that
+   * any sprite covers is read once into internal RAM, all of its sprites
+   * are composited there in priority order, and the tile is written back
+   * once, so heavily overlapping sprites no longer rewrite the same
+   * framebuffer lines in PSRAM. Tiles with no sprites are not touched.
+   *
+   * Bins are kept between calls: when the same number of sprites is
+   * passed again with unchanged priorities, only sprites whose screen
+   * area changed (moved, resized, shown or hidden) are re-binned.
+   *
+   * The output is identical to VMUPRO_SPRITE_BATCH_DIRECT.
+   *
+   * @param mode Rendering strategy
+   *
+   * @note 16x16 tiles skip more empty space, 32x32 tiles have less per-tile
+   *       overhead. Prefer 32x32 for a few large sprites, 16x16 for many small ones.
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_set_sprite_batch_mode(vmupro_sprite_batch_mode_t mode);
+
+  /**
+   * @brief Get the current sprite batch rendering strategy
+   *
+   * @return Current mode
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  vmupro_sprite_batch_mode_t vmupro_get_sprite_batch_mode(void);
+
+  // Tilemaps
+  //
+  // Needs firmware newer than 2.0.0. Firmware 2.0.0 doesn't export these
+  // functions yet, so an app calling them won't load on it. Only the host
+  // simulator (tools/hostsim) implements them for now.
+  #define VMUPRO_TILE_INDEX_MASK 0x3fff /**< Tile index bits of a 16 bit map entry */
+  #define VMUPRO_TILE_FLIP_H 0x4000     /**< Mirror the tile horizontally (16 bit map entries) */
+  #define VMUPRO_TILE_FLIP_V 0x8000     /**< Mirror the tile vertically (16 bit map entries) */
+
+  /**
+   * @brief Per tile row classes filled in by vmupro_tilemap_classify_rows()
+   */
+  typedef enum
+  {
+    VMUPRO_TILEROW_MIXED = 0,  /**< Some pixels are transparent */
+    VMUPRO_TILEROW_OPAQUE = 1, /**< No transparent pixels, copied as a whole */
+    VMUPRO_TILEROW_EMPTY = 2   /**< Only transparent pixels, skipped */
+  } vmupro_tilerow_class_t;
+
+  /**
+   * @brief Tilemap: a grid of tile indices into a tile atlas
+   *
+   * The atlas is RGB565, or with a palette an indexed image from
+   * vmupro_indexed.h (4bpp or 8bpp), expanded through the palette while
+   * drawing. Tiles are numbered left to right, top to bottom through the atlas.
+   * Map entries are either 8 bit tile indices (with optional per cell
+   * VMUPRO_DRAWFLAGS in attributes) or 16 bit entries holding a 14 bit
+   * index plus VMUPRO_TILE_FLIP_H / VMUPRO_TILE_FLIP_V.
+   *
+   * The tilemap only references its atlas, map and attributes, so cells can
+   * be edited (or the atlas swapped for animation) between frames.
+   */
+  typedef struct {
+    const uint8_t *atlas;              /**< Tile atlas, RGB565 or an indexed image (see palette) */
+    int atlas_width;                   /**< RGB565 atlas width in pixels, a multiple of tile_width. Indexed atlases use their header */
+    int tile_width, tile_height;       /**< Tile size in pixels */
+    const void *map;                   /**< map_width * map_height entries, row by row */
+    int map_width, map_height;         /**< Map size in tiles */
+    int entry_size;                    /**< Bytes per map entry, 1 or 2 */
+    const uint8_t *attributes;         /**< Optional per cell VMUPRO_DRAWFLAGS for 8 bit maps, or NULL */
+    int empty_tile;                    /**< Tile index that is never drawn, or -1 */
+    int transparent_color;             /**< Colour key inside tiles (palette index for indexed atlases), or -1 if tiles are opaque */
+    const uint8_t *row_classes;        /**< Optional vmupro_tilemap_classify_rows() output, or NULL */
+    bool wrap;                         /**< Repeat the map outside its bounds */
+    const uint16_t *palette;           /**< RGB565 palette when atlas is an indexed image, or NULL for an RGB565 atlas */
+  } vmupro_tilemap_t;
+
+  /**
+   * @brief Classify every tile row of an atlas for faster keyed rendering
+   *
+   * With a colour key, rows containing no transparent pixels are copied as a
+   * whole and rows that are entirely transparent are skipped. Store the
+   * output in vmupro_tilemap_t.row_classes.
+   *
+   * Tiles are classified up to the highest index the map uses, so run it
+   * again if cells are later set to higher tile indices.
+   *
+   * @param tilemap Complete tilemap (atlas, map, tile size and transparent_color)
+   * @param out_classes Output, one vmupro_tilerow_class_t per tile row (or NULL to query the size)
+   * @param out_size Size of out_classes in bytes
+   * @return Bytes needed ((highest tile index + 1) * tile_height), or -1 on error
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  int vmupro_tilemap_classify_rows(const vmupro_tilemap_t *tilemap, uint8_t *out_classes, int out_size);
+
+  /**
+   * @brief Render a scrolled view of a tilemap
+   *
+   * Draws the map region starting at map pixel (scroll_x, scroll_y) into the
+   * screen rectangle (x, y, width, height), in one call. Each tile row is
+   * copied as a span; opaque tiles without flips are straight row copies.
+   *
+   * @param tilemap Tilemap to draw
+   * @param scroll_x Map X coordinate (pixels) shown at the left of the view
+   * @param scroll_y Map Y coordinate (pixels) shown at the top of the view
+   * @param x View left edge on screen
+   * @param y View top edge on screen
+   * @param width View width in pixels
+   * @param height View height in pixels
+   *
+   * @note Without wrap, areas outside the map are left untouched
+   *
+   * @code
+   * static uint16_t level[60 * 15]; // from your level editor
+   * vmupro_tilemap_t ground = {
+   *     .atlas = tiles_data, .atlas_width = 128, .tile_width = 16, .tile_height = 16,
+   *     .map = level, .map_width = 60, .map_height = 15, .entry_size = 2,
+   *     .empty_tile = 0, .transparent_color = VMUPRO_COLOR_MAGENTA, .wrap = false,
+   * };
+   * vmupro_tilemap_render(&ground, camera_x, 0, 0, 0, 240, 240);
+   * @endcode
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_tilemap_render(const vmupro_tilemap_t *tilemap, int scroll_x, int scroll_y,
+                             int x, int y, int width, int height);
+
   // Multi-Layer System
   #define VMUPRO_MAX_LAYERS 8
 
@@ -1009,11 +1598,12 @@ extern "C"
    */
   typedef struct {
     bool active;               /**< Layer is allocated and active */
-    uint8_t *buffer;          /**< Layer buffer data (RGB565 format) */
+    uint8_t *buffer;          /**< Layer buffer data (RGB565 format), NULL for tilemap layers */
     int width, height;        /**< Layer dimensions */
     int scroll_x, scroll_y;   /**< Scroll position */
     int priority;             /**< Rendering priority (higher = drawn last) */
     uint8_t alpha;            /**< Layer transparency (0-255) */
+    const vmupro_tilemap_t *tilemap; /**< Tilemap backing the layer, or NULL */
   } vmupro_layer_t;
 
   /**
@@ -1086,6 +1676,111 @@ extern "C"
    */
   void vmupro_render_all_layers(void);
 
+  /**
+   * @brief Back a layer with a tilemap instead of a pixel buffer
+   *
+   * The layer is (re)created without a buffer and drawn by rendering the
+   * tilemap with the layer's scroll, priority and alpha, so a scrolling
+   * playfield costs only its map and atlas instead of a full RGB565 layer.
+   * The tilemap is referenced, not copied - keep it alive while the layer
+   * exists and edit it freely between frames.
+   *
+   * @param layer_id Layer ID (0 to VMUPRO_MAX_LAYERS-1)
+   * @param tilemap Tilemap to draw, or NULL to destroy the layer
+   *
+   * @note vmupro_layer_blit_background() has no effect on tilemap layers
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_layer_set_tilemap(int layer_id, const vmupro_tilemap_t *tilemap);
+
+  // Raster Effects
+  //
+  // Needs firmware newer than 2.0.0. Firmware 2.0.0 doesn't export these
+  // functions yet, so an app calling them won't load on it. Only the host
+  // simulator (tools/hostsim) implements them for now.
+  #define VMUPRO_RASTER_ALL_LAYERS 0xff /**< layer_mask enabling every layer */
+
+  /**
+   * @brief Per scanline parameters for vmupro_render_layers_raster()
+   */
+  typedef struct {
+    int16_t scroll_x;   /**< Added to the scroll_x of every layer drawn on this line */
+    int16_t scroll_y;   /**< Added to the scroll_y of every layer drawn on this line */
+    uint8_t palette;    /**< 0 for none, n to remap the finished line through palettes[n - 1] */
+    uint8_t layer_mask; /**< Bit i draws layer i on this line */
+  } vmupro_raster_line_t;
+
+  /**
+   * @brief Per channel colour remap applied to a whole scanline
+   *
+   * Each RGB565 channel is looked up in its own table, which covers tints,
+   * fades, brightness and inversion. Build one with
+   * vmupro_raster_palette_fade() or fill the tables directly.
+   */
+  typedef struct {
+    uint8_t r[32]; /**< Red 0-31 -> 0-31 */
+    uint8_t g[64]; /**< Green 0-63 -> 0-63 */
+    uint8_t b[32]; /**< Blue 0-31 -> 0-31 */
+  } vmupro_raster_palette_t;
+
+  /**
+   * @brief Called before each scanline is drawn, to compute or adjust its parameters
+   *
+   * @param line Scanline (0-239)
+   * @param params Parameters from the table (or the defaults), may be modified
+   * @param user_data Value passed to vmupro_render_layers_raster()
+   */
+  typedef void (*vmupro_raster_callback_t)(int line, vmupro_raster_line_t *params, void *user_data);
+
+  /**
+   * @brief Render all active layers with per scanline parameters
+   *
+   * Like vmupro_render_all_layers(), but in a single top to bottom pass
+   * where every scanline has its own scroll offsets, layer enables and
+   * palette. This gives HDMA style raster effects - water and heat haze
+   * wobble, split screens, per line tints, pseudo 3D floors - at the cost
+   * of one layer composite instead of one blit per effect.
+   *
+   * @param lines 240 vmupro_raster_line_t, one per scanline, or NULL for
+   *              no offsets, no palette and all layers enabled
+   * @param callback Optional function called per scanline, or NULL
+   * @param user_data Passed to callback
+   * @param palettes Palettes selected by vmupro_raster_line_t.palette, or NULL
+   * @param num_palettes Number of entries in palettes
+   *
+   * @note Scanlines with no enabled layers are left untouched
+   * @note The palette is applied after all layers are composited on the line
+   *
+   * @code
+   * vmupro_raster_line_t lines[240];
+   * vmupro_raster_palette_t water;
+   * vmupro_raster_palette_fade(&water, VMUPRO_COLOR_BLUE, 96);
+   * for (int y = 0; y < 240; y++) {
+   *   bool under = y >= water_line;
+   *   lines[y].scroll_x = under ? (sine[(y + frame) & 63] >> 5) : 0;
+   *   lines[y].scroll_y = 0;
+   *   lines[y].palette = under ? 1 : 0;
+   *   lines[y].layer_mask = VMUPRO_RASTER_ALL_LAYERS;
+   * }
+   * vmupro_render_layers_raster(lines, NULL, NULL, &water, 1);
+   * @endcode
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_render_layers_raster(const vmupro_raster_line_t *lines, vmupro_raster_callback_t callback,
+                                   void *user_data, const vmupro_raster_palette_t *palettes, int num_palettes);
+
+  /**
+   * @brief Build a palette that fades every colour towards a target colour
+   *
+   * @param palette Palette to fill
+   * @param target Colour to fade towards (VMUPRO_COLOR_BLACK to darken, VMUPRO_COLOR_WHITE to brighten)
+   * @param amount 0 leaves colours unchanged, 255 turns everything into target
+   *
+   * @note Needs firmware newer than 2.0.0
+   */
+  void vmupro_raster_palette_fade(vmupro_raster_palette_t *palette, vmupro_color_t target, uint8_t amount);
+
   /**
    * @brief Blit a single tile from a tilemap/tileset
    *
@@ -0,0 +1,269 @@
+/**
+ * @file vmupro_file_async.h
+ * @brief VMUPro Asynchronous File I/O
+ *
+ * Every function in vmupro_file.h returns only when the SD card is done,
+ * so a level load or a save written from the game loop freezes the
+ * screen for as long as the card takes. This header queues reads and
+ * writes instead, for an I/O task to carry out in the background while
+ * the game loop keeps drawing.
+ *
+ * Each request is carried out in chunks of VMUPRO_FILE_ASYNC_CHUNK_BYTES.
+ * Between chunks the task takes up the most urgent request waiting, so a
+ * high priority read for a stream doesn't wait behind a level load, and
+ * a low priority autosave only uses the card when nothing else does.
+ *
+ * A request can be polled with vmupro_file_async_status(), waited on
+ * with vmupro_file_async_wait(), or given a callback, which
+ * vmupro_file_async_update() calls from the game loop once the request
+ * has finished. Reads can be cancelled until they finish. Writes only
+ * until they start, so a file is never left half written.
+ *
+ * @note Call the functions in this header from one thread, normally the
+ *       game loop. The I/O task starts with the first request
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-08-13
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Most requests that can exist at once, finished or not */
+#define VMUPRO_FILE_ASYNC_MAX_REQUESTS 32
+
+/** Longest path, including the terminator */
+#define VMUPRO_FILE_ASYNC_MAX_PATH 128
+
+/** Bytes read or written at a time, a multiple of 512 */
+#define VMUPRO_FILE_ASYNC_CHUNK_BYTES 32768
+
+  /**
+   * @brief What a request does
+   */
+  typedef enum
+  {
+    VMUPRO_FILE_ASYNC_READ = 0, /**< Read size bytes at offset into buffer */
+    VMUPRO_FILE_ASYNC_LOAD,     /**< Read the whole file into a buffer the request allocates */
+    VMUPRO_FILE_ASYNC_WRITE,    /**< Replace the file with size bytes of data */
+    VMUPRO_FILE_ASYNC_WRITE_AT, /**< Write size bytes of data at offset, creating the file if needed */
+  } vmupro_file_async_op_t;
+
+  /**
+   * @brief Which waiting request the I/O task takes up first
+   */
+  typedef enum
+  {
+    VMUPRO_FILE_ASYNC_LOW = 0, /**< Autosaves and other work that can wait */
+    VMUPRO_FILE_ASYNC_NORMAL,  /**< Level and asset loads */
+    VMUPRO_FILE_ASYNC_HIGH,    /**< Streaming reads that must arrive in time */
+  } vmupro_file_async_priority_t;
+
+  /**
+   * @brief Where a request is
+   */
+  typedef enum
+  {
+    VMUPRO_FILE_ASYNC_PENDING = 0, /**< Waiting for the I/O task */
+    VMUPRO_FILE_ASYNC_RUNNING,     /**< Started, some chunks may be done */
+    VMUPRO_FILE_ASYNC_DONE,        /**< Finished, every byte transferred */
+    VMUPRO_FILE_ASYNC_FAILED,      /**< The file couldn't be read or written */
+    VMUPRO_FILE_ASYNC_CANCELLED,   /**< Cancelled before it finished */
+  } vmupro_file_async_status_t;
+
+  /**
+   * @brief Request handle, from vmupro_file_async_submit()
+   */
+  typedef struct vmupro_file_async_request vmupro_file_async_request_t;
+
+  /**
+   * @brief Completion callback, called from vmupro_file_async_update()
+   *
+   * The request is released when the callback returns. Take the buffer
+   * of a VMUPRO_FILE_ASYNC_LOAD with vmupro_file_async_take_buffer()
+   * first.
+   *
+   * @param req The request
+   * @param status VMUPRO_FILE_ASYNC_DONE, _FAILED or _CANCELLED
+   * @param user Pointer from the request
+   */
+  typedef void (*vmupro_file_async_callback_t)(vmupro_file_async_request_t *req, vmupro_file_async_status_t status,
+                                               void *user);
+
+  /**
+   * @brief A request to queue
+   */
+  typedef struct
+  {
+    vmupro_file_async_op_t op;             /**< What to do */
+    vmupro_file_async_priority_t priority; /**< How urgent it is */
+    const char *path;                      /**< Full path, copied */
+    void *buffer;                          /**< READ: destination for size bytes */
+    const void *data;                      /**< WRITE, WRITE_AT: size bytes to write */
+    uint32_t offset;                       /**< READ, WRITE_AT: first byte in the file */
+    size_t size;                           /**< READ, WRITE, WRITE_AT: bytes, at least 1 */
+    bool copy;                             /**< WRITE, WRITE_AT: copy data now, so it can change at once */
+    vmupro_file_async_callback_t callback; /**< Called when finished, or NULL to release the request yourself */
+    void *user;                            /**< Passed to callback */
+  } vmupro_file_async_desc_t;
+
+  /**
+   * @brief I/O task counters, kept since the first request or the last reset
+   */
+  typedef struct
+  {
+    uint32_t submitted;      /**< Requests queued */
+    uint32_t rejected;       /**< Requests refused with VMUPRO_FILE_ASYNC_MAX_REQUESTS in use */
+    uint32_t completed;      /**< Requests finished with every byte transferred */
+    uint32_t failed;         /**< Requests that couldn't read or write their file */
+    uint32_t cancelled;      /**< Requests cancelled */
+    uint32_t chunks;         /**< Chunks read or written */
+    uint32_t preemptions;    /**< Times a request was set aside for a more urgent one */
+    uint32_t max_chunk_us;   /**< Slowest chunk */
+    uint32_t max_wait_us[3]; /**< Longest time from submit to first chunk, by priority */
+    uint64_t bytes_read;     /**< Bytes read */
+    uint64_t bytes_written;  /**< Bytes written */
+    uint8_t max_queued;      /**< Most requests waiting or running at once */
+  } vmupro_file_async_stats_t;
+
+  /**
+   * @brief Queue a request
+   *
+   * Starts the I/O task if it isn't running. The buffer of a READ, and
+   * the data of a WRITE or WRITE_AT without copy, must stay valid until
+   * the request finishes.
+   *
+   * @param desc The request
+   * @return The request, or NULL if an argument is invalid, the path is
+   *         too long, memory runs out or VMUPRO_FILE_ASYNC_MAX_REQUESTS
+   *         are in use
+   *
+   * @code
+   * static void LevelLoaded(vmupro_file_async_request_t *req, vmupro_file_async_status_t status, void *user)
+   * {
+   *   if (status == VMUPRO_FILE_ASYNC_DONE)
+   *     StartLevel(vmupro_file_async_take_buffer(req, NULL));
+   * }
+   *
+   * vmupro_file_async_desc_t load = {
+   *   .op = VMUPRO_FILE_ASYNC_LOAD,
+   *   .priority = VMUPRO_FILE_ASYNC_NORMAL,
+   *   .path = "/sdcard/levels/2.bin",
+   *   .callback = LevelLoaded,
+   * };
+   * vmupro_file_async_submit(&load);
+   * // each frame
+   * vmupro_file_async_update();
+   * @endcode
+   */
+  vmupro_file_async_request_t *vmupro_file_async_submit(const vmupro_file_async_desc_t *desc);
+
+  /**
+   * @brief Where a request is
+   *
+   * @param req Request
+   */
+  vmupro_file_async_status_t vmupro_file_async_status(const vmupro_file_async_request_t *req);
+
+  /**
+   * @brief Bytes transferred so far
+   *
+   * @param req Request
+   */
+  size_t vmupro_file_async_progress(const vmupro_file_async_request_t *req);
+
+  /**
+   * @brief Wait for a request to finish
+   *
+   * Doesn't call the callback, vmupro_file_async_update() still does.
+   *
+   * @param req Request
+   * @param timeout_ms Longest wait, 0 to only check, negative to wait
+   *                   as long as it takes
+   * @return true if the request has finished
+   */
+  bool vmupro_file_async_wait(const vmupro_file_async_request_t *req, int timeout_ms);
+
+  /**
+   * @brief Cancel a request
+   *
+   * A waiting request is cancelled at once. A running read or load stops
+   * after the chunk in progress, leaving what was read in the buffer. A
+   * running write carries on.
+   *
+   * @param req Request
+   * @return true if the request won't finish, false if it has finished
+   *         or is a running write
+   */
+  bool vmupro_file_async_cancel(vmupro_file_async_request_t *req);
+
+  /**
+   * @brief Take the buffer a VMUPRO_FILE_ASYNC_LOAD read the file into
+   *
+   * @param req Finished request
+   * @param out_size Destination for the file size, may be NULL
+   * @return The buffer, to free() when done, or NULL if the request
+   *         isn't a finished load or the buffer was already taken
+   */
+  uint8_t *vmupro_file_async_take_buffer(vmupro_file_async_request_t *req, size_t *out_size);
+
+  /**
+   * @brief Give back a request without a callback
+   *
+   * A read or load that hasn't finished is cancelled. A write still
+   * goes to the card, so a save can be queued and released at once. The
+   * slot is freed once the request has finished, with the buffer of a
+   * load that wasn't taken.
+   *
+   * @param req Request, may be NULL
+   */
+  void vmupro_file_async_release(vmupro_file_async_request_t *req);
+
+  /**
+   * @brief Call the callbacks of finished requests
+   *
+   * Call regularly from the app loop. Callbacks run in the order their
+   * requests finished.
+   *
+   * @return Callbacks called
+   */
+  int vmupro_file_async_update(void);
+
+  /**
+   * @brief Requests waiting or running
+   */
+  int vmupro_file_async_pending(void);
+
+  /**
+   * @brief Finish every queued request and stop the I/O task
+   *
+   * Call before the app exits so that queued saves reach the card.
+   * Callbacks are still called by vmupro_file_async_update().
+   */
+  void vmupro_file_async_stop(void);
+
+  /**
+   * @brief Read the I/O task counters
+   *
+   * @param out_stats Destination for the counters
+   */
+  void vmupro_file_async_get_stats(vmupro_file_async_stats_t *out_stats);
+
+  /**
+   * @brief Zero the I/O task counters
+   */
+  void vmupro_file_async_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
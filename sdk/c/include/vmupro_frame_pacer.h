@@ -0,0 +1,85 @@
+/**
+ * @file vmupro_frame_pacer.h
+ * @brief VMUPro Frame Pacing
+ *
+ * This header provides a small helper that presents double (or triple)
+ * buffered frames at a fixed rate. Instead of a fixed vmupro_sleep_ms()
+ * after every push, which over-sleeps whenever drawing took a while, the
+ * pacer sleeps only until the next frame is due, counts the frames that
+ * missed their deadline and reports when frames actually reached the
+ * panel. Deadlines advance by exactly one period so the rate doesn't
+ * drift, and after a long stall (loading, a breakpoint) the schedule is
+ * restarted rather than rushing to catch up.
+ *
+ * @note Needs firmware newer than 2.0.0: the pacer reads
+ *       vmupro_get_last_present_time_us(), which firmware 2.0.0 doesn't
+ *       export yet. Only the host simulator implements it for now
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-07-28
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /**
+   * @brief Frame pacer state and statistics
+   */
+  typedef struct
+  {
+    uint32_t frame_us;        /**< Target frame period in microseconds */
+    uint64_t deadline_us;     /**< When the next frame is due, 0 before the first present */
+    uint64_t last_present_us; /**< When the most recent completed frame reached the panel */
+    uint32_t late_us;         /**< How late the last frame was pushed, 0 if on time */
+    uint32_t frames;          /**< Frames presented */
+    uint32_t missed;          /**< Frames pushed after their deadline */
+  } vmupro_frame_pacer_t;
+
+  /**
+   * @brief Set up a pacer for a target frame rate
+   *
+   * @param pacer Pacer to initialise
+   * @param fps Target frames per second (1-1000)
+   */
+  void vmupro_frame_pacer_init(vmupro_frame_pacer_t *pacer, uint32_t fps);
+
+  /**
+   * @brief Wait for the next frame deadline, then push the back buffer
+   *
+   * Call in place of vmupro_push_double_buffer_frame() at the end of each
+   * frame. Sleeps until the frame is due, then pushes it. A frame that is
+   * already late is pushed straight away and counted in missed.
+   *
+   * @param pacer Pacer set up with vmupro_frame_pacer_init()
+   * @return true if the frame was on time, false if it missed its deadline
+   *
+   * @note last_present_us is read after the push. While a transfer is in
+   *       flight it is the time the previous frame was presented
+   *
+   * @code
+   * vmupro_frame_pacer_t pacer;
+   * vmupro_frame_pacer_init(&pacer, 60);
+   * vmupro_start_double_buffer_renderer();
+   * vmupro_set_triple_buffering(true);
+   * while (running) {
+   *     UpdateGame();
+   *     DrawGame();
+   *     if (!vmupro_frame_pacer_present(&pacer))
+   *         vmupro_log(VMUPRO_LOG_WARN, "GAME", "late by %u us", (unsigned)pacer.late_us);
+   * }
+   * @endcode
+   */
+  bool vmupro_frame_pacer_present(vmupro_frame_pacer_t *pacer);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,160 @@
+/**
+ * @file vmupro_indexed.h
+ * @brief VMUPro Indexed Colour (4bpp/8bpp) Images
+ *
+ * This header provides 4 and 8 bits per pixel images that are expanded
+ * through an RGB565 palette while drawing. Assets take a quarter (4bpp)
+ * or half (8bpp) of the memory of RGB565 buffers, and because the palette
+ * is looked up at render time, palette effects such as
+ * vmupro_animate_palette_range() or vmupro_interpolate_palette() only
+ * touch the 16 or 256 palette entries instead of every pixel.
+ *
+ * Images are normally produced offline with tools/sprites/sprite_indexed.py,
+ * which also quantizes true colour artwork down to the palette size.
+ *
+ * ## Format
+ * An 8 byte header (little endian) followed by the pixel rows:
+ *
+ * | Offset | Size | Field                                 |
+ * |--------|------|---------------------------------------|
+ * | 0      | 2    | Magic, VMUPRO_INDEXED_MAGIC ("IX")    |
+ * | 2      | 2    | Width in pixels                       |
+ * | 4      | 2    | Height in pixels                      |
+ * | 6      | 1    | Bits per pixel, 4 or 8                |
+ * | 7      | 1    | Flags, reserved (0)                   |
+ * | 8      | ...  | height rows of VMUPRO_INDEXED_STRIDE() bytes |
+ *
+ * In 4bpp images the left pixel of each pair is in the high nibble.
+ * Rows start on a byte boundary. Palettes are arrays of RGB565 (big
+ * endian) values, the same format as VMUPRO_COLOR_* and every other
+ * palette in the SDK.
+ *
+ * Tilemaps (vmupro_tilemap_t, firmware newer than 2.0.0) accept an
+ * indexed image as their atlas, with the palette in vmupro_tilemap_t.palette.
+ *
+ * In partial update mode the drawn area is only marked dirty when the SDK
+ * is built with VMUPRO_FIRMWARE_DIRTY_RECTS, which needs firmware newer
+ * than 2.0.0 (see vmupro_mark_dirty_rect()).
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-07-21
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vmupro_display.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define VMUPRO_INDEXED_MAGIC 0x5849 /**< "IX" read as a little endian uint16 */
+#define VMUPRO_INDEXED_HEADER_SIZE 8
+
+/** Bytes per row of an indexed image */
+#define VMUPRO_INDEXED_STRIDE(width, bpp) (((width) * (bpp) + 7) / 8)
+
+/** Pass as transparent_index to draw every pixel */
+#define VMUPRO_INDEXED_OPAQUE -1
+
+  /**
+   * @brief Indexed image header, followed by the pixel rows
+   */
+  typedef struct
+  {
+    uint16_t magic;  /**< VMUPRO_INDEXED_MAGIC */
+    uint16_t width;  /**< Width in pixels */
+    uint16_t height; /**< Height in pixels */
+    uint8_t bpp;     /**< Bits per pixel, 4 or 8 */
+    uint8_t flags;   /**< Reserved, 0 */
+  } vmupro_indexed_header_t;
+
+  /**
+   * @brief Check an indexed image and read its dimensions
+   *
+   * @param image Indexed image
+   * @param width Receives the width (may be NULL)
+   * @param height Receives the height (may be NULL)
+   * @param bpp Receives the bits per pixel (may be NULL)
+   * @return true if image is a valid 4bpp or 8bpp indexed image
+   */
+  bool vmupro_indexed_get_info(const uint8_t *image, int *width, int *height, int *bpp);
+
+  /**
+   * @brief Draw an indexed image
+   *
+   * @param image Indexed image
+   * @param palette RGB565 palette covering every index used by the image
+   * @param x Destination X coordinate (top-left corner)
+   * @param y Destination Y coordinate (top-left corner)
+   * @param transparent_index Palette index to skip, or VMUPRO_INDEXED_OPAQUE
+   * @param flags VMUPRO_DRAWFLAGS_FLIP_H and/or VMUPRO_DRAWFLAGS_FLIP_V
+   *
+   * @note Clipped to the screen, only the visible part is read
+   *
+   * @code
+   * #include "hero_idx.h" // from sprite_indexed.py hero.png --bpp 4 --header hero_idx.h
+   *
+   * vmupro_blit_indexed(hero_idx, hero_palette, x, y, 0, VMUPRO_DRAWFLAGS_NORMAL);
+   * @endcode
+   */
+  void vmupro_blit_indexed(const uint8_t *image, const uint16_t *palette, int x, int y,
+                           int transparent_index, vmupro_drawflags_t flags);
+
+  /**
+   * @brief Draw part of an indexed image, e.g. one tile of an atlas
+   *
+   * @param image Indexed image holding the atlas
+   * @param palette RGB565 palette
+   * @param x Destination X coordinate (top-left corner)
+   * @param y Destination Y coordinate (top-left corner)
+   * @param src_x Left edge of the region in the image
+   * @param src_y Top edge of the region in the image
+   * @param width Region width in pixels
+   * @param height Region height in pixels
+   * @param transparent_index Palette index to skip, or VMUPRO_INDEXED_OPAQUE
+   * @param flags Flip flags, applied within the region
+   *
+   * @note Regions reaching outside the image are ignored
+   */
+  void vmupro_blit_indexed_region(const uint8_t *image, const uint16_t *palette, int x, int y,
+                                  int src_x, int src_y, int width, int height,
+                                  int transparent_index, vmupro_drawflags_t flags);
+
+  /**
+   * @brief Fill the screen with a scrolled, wrapping indexed layer
+   *
+   * The palette-aware counterpart of vmupro_blit_scrolling_background():
+   * the image repeats in both directions and (scroll_x, scroll_y) is drawn
+   * at the top-left of the screen. With a transparent index, several layers
+   * can be stacked for parallax, each with its own palette.
+   *
+   * This draws straight to the screen, not through vmupro_layer_t. For an
+   * indexed layer in the layer system, back it with a vmupro_tilemap_t
+   * whose atlas is an indexed image and whose palette is set.
+   *
+   * @param image Indexed image, any size
+   * @param palette RGB565 palette
+   * @param scroll_x Horizontal scroll, any value (wraps)
+   * @param scroll_y Vertical scroll, any value (wraps)
+   * @param transparent_index Palette index to skip, or VMUPRO_INDEXED_OPAQUE
+   *
+   * @code
+   * // Water shimmer for free: rotate 4 palette entries every few frames
+   * if ((frame & 3) == 0)
+   *   vmupro_animate_palette_range(sea_palette, 8, 11, 1);
+   * vmupro_render_indexed_layer(sea_idx, sea_palette, camera_x / 2, 0, VMUPRO_INDEXED_OPAQUE);
+   * vmupro_render_indexed_layer(land_idx, land_palette, camera_x, 0, 0);
+   * @endcode
+   */
+  void vmupro_render_indexed_layer(const uint8_t *image, const uint16_t *palette, int scroll_x, int scroll_y,
+                                   int transparent_index);
+
+#ifdef __cplusplus
+}
+#endif
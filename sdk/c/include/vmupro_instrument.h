@@ -0,0 +1,293 @@
+/**
+ * @file vmupro_instrument.h
+ * @brief VMUPro Sampled Instruments
+ *
+ * Instruments play 16-bit samples as MIDI notes, like the Lua
+ * vmupro.sound.instrument API, mixed in by the synth engine
+ * (vmupro_synth.h) after its synths.
+ *
+ * An instrument is a list of zones. Each zone plays one sample over a
+ * range of keys and velocities, repitched from its root key, so a piano
+ * can use a sample every few notes and a louder one for hard hits. A
+ * zone can loop between two frames while the note is held, and fades
+ * out over its release time when the note ends.
+ *
+ * Long samples don't have to fit in RAM. A streamed zone keeps only the
+ * first frames of its file resident, and each voice playing it reads
+ * the rest from the SD card through two buffers of
+ * VMUPRO_INSTRUMENT_STREAM_BYTES, refilled by
+ * vmupro_instrument_update() from the game loop. The resident head
+ * covers the time until the first refill.
+ *
+ * When all voices are busy, a note takes a released voice if there is
+ * one, else a held one chosen by the instrument's policy: the oldest
+ * note, the quietest, or the one playing the same note. Each case is
+ * counted in vmupro_instrument_get_stats().
+ *
+ * | Lua                                    | C                            |
+ * |----------------------------------------|------------------------------|
+ * | vmupro.sound.instrument.new()          | vmupro_instrument_new()      |
+ * | vmupro.sound.instrument.addVoice(...)  | vmupro_instrument_add_zone() |
+ * | vmupro.sound.instrument.free(inst)     | vmupro_instrument_free()     |
+ *
+ * Notes are MIDI note numbers, velocities 1 to 127, and volumes 8.8
+ * fixed point (VMUPRO_SYNTH_UNITY is 1.0).
+ *
+ * @note Call the functions in this header from one thread, normally the
+ *       game loop, except the _render_ functions, which are for a synth
+ *       engine scheduler such as the sequencer's
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-08-12
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vmupro_mixer.h"
+#include "vmupro_synth.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Most instruments that can exist at once */
+#define VMUPRO_INSTRUMENT_MAX 8
+
+/** Most zones in an instrument, the Lua voice limit */
+#define VMUPRO_INSTRUMENT_MAX_ZONES 16
+
+/** Most voices an instrument can sound at once */
+#define VMUPRO_INSTRUMENT_MAX_VOICES 32
+
+/** Size of each of a voice's two stream buffers, a multiple of 512 */
+#define VMUPRO_INSTRUMENT_STREAM_BYTES 8192
+
+/** Resident frames of a streamed zone when none are asked for, about 0.19s */
+#define VMUPRO_INSTRUMENT_DEFAULT_HEAD_FRAMES 8192
+
+/** Root key of a zone played at its recorded pitch on every key */
+#define VMUPRO_INSTRUMENT_FIXED_PITCH 0xff
+
+  /**
+   * @brief Which held voice a note takes when all are busy
+   */
+  typedef enum
+  {
+    VMUPRO_INSTRUMENT_STEAL_OLDEST = 0, /**< The note that started first */
+    VMUPRO_INSTRUMENT_STEAL_QUIETEST,   /**< The note with the lowest gain */
+    VMUPRO_INSTRUMENT_STEAL_SAME_NOTE,  /**< A voice playing the same note, even with others free; else the oldest */
+  } vmupro_instrument_steal_t;
+
+  /**
+   * @brief Where and how a zone plays its sample
+   */
+  typedef struct
+  {
+    uint8_t key_low;       /**< Lowest note */
+    uint8_t key_high;      /**< Highest note */
+    uint8_t velocity_low;  /**< Lowest velocity, 1 to 127 */
+    uint8_t velocity_high; /**< Highest velocity */
+    uint8_t root_key;      /**< Note the sample was recorded at, or VMUPRO_INSTRUMENT_FIXED_PITCH */
+    uint16_t volume;       /**< 8.8 fixed point, up to 4 * VMUPRO_SYNTH_UNITY */
+    uint32_t loop_start;   /**< First frame of the loop */
+    uint32_t loop_end;     /**< Frame after the loop, 0 for no loop */
+    uint32_t release_ms;   /**< Fade after the note ends */
+  } vmupro_instrument_zone_t;
+
+  /**
+   * @brief Instrument handle, from vmupro_instrument_new()
+   */
+  typedef struct vmupro_instrument vmupro_instrument_t;
+
+  /**
+   * @brief Instrument counters, kept since vmupro_instrument_new()
+   */
+  typedef struct
+  {
+    uint32_t notes;            /**< Notes started */
+    uint32_t notes_unmapped;   /**< Notes no zone covers */
+    uint32_t retriggers;       /**< Notes that took the voice playing the same note */
+    uint32_t steals_released;  /**< Notes that cut off a released voice */
+    uint32_t steals_held;      /**< Notes that cut off a held voice, chosen by the steal policy */
+    uint32_t stream_reads;     /**< SD reads for streamed zones */
+    uint32_t stream_bytes;     /**< Bytes read */
+    uint32_t max_read_us;      /**< Slowest read */
+    uint32_t underruns;        /**< Streamed voices cut off because their next buffer wasn't read in time */
+    uint32_t resident_bytes;   /**< RAM held for streamed zones: heads and voice buffers */
+    uint8_t active_voices;     /**< Voices sounding in the last render */
+    uint8_t peak_voices;       /**< Most voices sounding in one render */
+  } vmupro_instrument_stats_t;
+
+  /**
+   * @brief Zone over every key and velocity, rooted at middle C, no loop,
+   *        20ms release
+   */
+  static inline vmupro_instrument_zone_t vmupro_instrument_zone_defaults(void)
+  {
+    vmupro_instrument_zone_t zone = {0, 127, 1, 127, 60, VMUPRO_SYNTH_UNITY, 0, 0, 20};
+    return zone;
+  }
+
+  /**
+   * @brief Create an instrument
+   *
+   * @param polyphony Voices, 1 to VMUPRO_INSTRUMENT_MAX_VOICES
+   * @return The instrument, or NULL if polyphony is out of range or
+   *         VMUPRO_INSTRUMENT_MAX instruments exist
+   *
+   * @code
+   * vmupro_instrument_t *strings = vmupro_instrument_new(8);
+   * vmupro_instrument_zone_t zone = vmupro_instrument_zone_defaults();
+   * zone.root_key = 57;
+   * zone.release_ms = 300;
+   * vmupro_instrument_add_streamed_zone(strings, "/sdcard/sounds/strings.wav", 0, &zone);
+   * vmupro_instrument_play_note(strings, 60, 100);
+   * // each frame
+   * vmupro_instrument_update(strings);
+   * @endcode
+   */
+  vmupro_instrument_t *vmupro_instrument_new(int polyphony);
+
+  /**
+   * @brief Silence and free an instrument
+   *
+   * Waits for the audio task to let go of it. Resident samples are left
+   * to the caller; streamed zones are freed.
+   *
+   * @param inst Instrument, may be NULL
+   */
+  void vmupro_instrument_free(vmupro_instrument_t *inst);
+
+  /**
+   * @brief Add a zone over a resident sample
+   *
+   * Zones are matched in the order they were added, the first covering
+   * the note's key and velocity plays it.
+   *
+   * @param inst Instrument
+   * @param sample Sample, not copied, must stay valid while the instrument exists
+   * @param zone Keys, velocities, pitch, loop and release
+   * @return false if the instrument has VMUPRO_INSTRUMENT_MAX_ZONES zones
+   *         or the zone doesn't fit the sample
+   */
+  bool vmupro_instrument_add_zone(vmupro_instrument_t *inst, const vmupro_sound_sample_t *sample,
+                                  const vmupro_instrument_zone_t *zone);
+
+  /**
+   * @brief Add a zone played from a WAV file, streaming all but its head
+   *
+   * Reads the head now. The head is rounded so that the rest of the data
+   * starts on a 512 byte boundary, and should last longer than the time
+   * between two vmupro_instrument_update() calls. A loop must lie within
+   * the head. Files no longer than the head are loaded whole.
+   *
+   * @param inst Instrument
+   * @param path Full path to a 16-bit PCM WAV file, mono or stereo
+   * @param head_frames Resident frames, 0 for VMUPRO_INSTRUMENT_DEFAULT_HEAD_FRAMES
+   * @param zone Keys, velocities, pitch, loop and release
+   * @return false if the file can't be read, isn't a supported WAV file,
+   *         memory runs out or the zone doesn't fit
+   */
+  bool vmupro_instrument_add_streamed_zone(vmupro_instrument_t *inst, const char *path, uint32_t head_frames,
+                                           const vmupro_instrument_zone_t *zone);
+
+  /**
+   * @brief Choose which held voice a note takes when all are busy
+   *
+   * @param inst Instrument
+   * @param policy Policy, VMUPRO_INSTRUMENT_STEAL_OLDEST by default
+   */
+  void vmupro_instrument_set_steal_policy(vmupro_instrument_t *inst, vmupro_instrument_steal_t policy);
+
+  /**
+   * @brief Set the volume of all notes, sounding and new
+   *
+   * @param inst Instrument
+   * @param left 8.8 fixed point, up to 4 * VMUPRO_SYNTH_UNITY
+   * @param right 8.8 fixed point, up to 4 * VMUPRO_SYNTH_UNITY
+   */
+  void vmupro_instrument_set_volume(vmupro_instrument_t *inst, uint16_t left, uint16_t right);
+
+  /**
+   * @brief Start a note, held until vmupro_instrument_note_off()
+   *
+   * @param inst Instrument
+   * @param note MIDI note, 0 to 127
+   * @param velocity 1 to 127, 127 plays at the zone's volume
+   * @return false if the synth engine isn't running or an argument is out
+   *         of range
+   */
+  bool vmupro_instrument_play_note(vmupro_instrument_t *inst, int note, int velocity);
+
+  /**
+   * @brief Release every voice holding a note
+   *
+   * @param inst Instrument
+   * @param note MIDI note, 0 to 127
+   */
+  void vmupro_instrument_note_off(vmupro_instrument_t *inst, int note);
+
+  /**
+   * @brief Cut off every voice at once
+   *
+   * @param inst Instrument
+   */
+  void vmupro_instrument_stop(vmupro_instrument_t *inst);
+
+  /**
+   * @brief Refill the stream buffers of streamed voices
+   *
+   * Call regularly from the app loop, at least once per
+   * VMUPRO_INSTRUMENT_STREAM_BYTES of playback per voice. Does nothing
+   * when no streamed zone is playing.
+   *
+   * @param inst Instrument
+   * @return Reads made
+   */
+  int vmupro_instrument_update(vmupro_instrument_t *inst);
+
+  /**
+   * @brief Start a note from a scheduler, on the frame being scheduled
+   *
+   * Only call from a vmupro_synth_scheduler_t.
+   *
+   * @param inst Instrument
+   * @param note MIDI note, 0 to 127
+   * @param velocity 1 to 127
+   */
+  void vmupro_instrument_render_note_on(vmupro_instrument_t *inst, uint8_t note, uint8_t velocity);
+
+  /**
+   * @brief Release a note from a scheduler, on the frame being scheduled
+   *
+   * Only call from a vmupro_synth_scheduler_t.
+   *
+   * @param inst Instrument
+   * @param note MIDI note, 0 to 127
+   */
+  void vmupro_instrument_render_note_off(vmupro_instrument_t *inst, uint8_t note);
+
+  /**
+   * @brief Voices sounding, as of the last render
+   *
+   * @param inst Instrument
+   */
+  int vmupro_instrument_get_active_voices(const vmupro_instrument_t *inst);
+
+  /**
+   * @brief Read the instrument counters
+   *
+   * @param inst Instrument
+   * @param out_stats Destination for the counters. Those kept by the
+   *                  audio task may be a render behind
+   */
+  void vmupro_instrument_get_stats(const vmupro_instrument_t *inst, vmupro_instrument_stats_t *out_stats);
+
+#ifdef __cplusplus
+}
+#endif
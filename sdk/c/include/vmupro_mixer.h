@@ -0,0 +1,356 @@
+/**
+ * @file vmupro_mixer.h
+ * @brief VMUPro Sound Samples and Software Mixer
+ *
+ * vmupro_audio_add_stream_samples() feeds a single ring buffer, so playing
+ * more than one sound at a time needs a mixer. This header provides one,
+ * with the capabilities of the Lua vmupro.sound.sample API: 16-bit PCM
+ * samples (WAV files, in memory WAV data or raw PCM) at any sample rate,
+ * mono or stereo, played with a repeat count and a finish callback,
+ * per-sample stereo volume and playback rate.
+ *
+ * Up to VMUPRO_MIXER_MAX_VOICES samples play at once. Each playing sample
+ * is a voice with its own volume, pan and rate, mixed in fixed point into
+ * a 32-bit stereo accumulator and packed to 16 bits with saturation, so
+ * loud mixes clip instead of wrapping around. The mix runs on the pull
+ * mode audio task (vmupro_audio_pull.h), which keeps the ring buffer
+ * topped up: the game loop only posts commands to it and never waits
+ * for a refill.
+ *
+ * | Lua                                | C                                      |
+ * |------------------------------------|----------------------------------------|
+ * | vmupro.sound.sample.new(path)      | vmupro_sound_sample_new()              |
+ * | vmupro.sound.sample.play(...)      | vmupro_sound_sample_play()             |
+ * | vmupro.sound.sample.stop(s)        | vmupro_sound_sample_stop()             |
+ * | vmupro.sound.sample.isPlaying(s)   | vmupro_sound_sample_is_playing()       |
+ * | vmupro.sound.sample.free(s)        | vmupro_sound_sample_free()             |
+ * | vmupro.sound.sample.setVolume(...) | vmupro_sound_sample_set_volume()       |
+ * | vmupro.sound.sample.getVolume(s)   | vmupro_sound_sample_get_volume()       |
+ * | vmupro.sound.sample.setRate(...)   | vmupro_sound_sample_set_rate()         |
+ * | vmupro.sound.sample.getRate(s)     | vmupro_sound_sample_get_rate()         |
+ * | vmupro.sound.update()              | vmupro_sound_update()                  |
+ *
+ * Volumes are 8.8 fixed point (VMUPRO_MIXER_UNITY is 1.0) and rates 16.16
+ * fixed point (VMUPRO_MIXER_RATE_ONE is 1.0).
+ *
+ * @note Call the functions in this header from one thread, normally the
+ *       game loop. Only the mixing happens on the audio task
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-08-04
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Most voices the mixer can play at once */
+#define VMUPRO_MIXER_MAX_VOICES 16
+
+/** Output rate of the mixer in Hz */
+#define VMUPRO_MIXER_RATE 44100
+
+/** Stereo frames mixed at a time, and the pull mode period of vmupro_mixer_start() */
+#define VMUPRO_MIXER_BLOCK_FRAMES 256
+
+/** Frames the audio task keeps queued in the ring buffer, about 23 ms */
+#define VMUPRO_MIXER_LATENCY_FRAMES 1024
+
+/** Volume 1.0 in 8.8 fixed point. Volumes go up to 4 * VMUPRO_MIXER_UNITY */
+#define VMUPRO_MIXER_UNITY 256
+
+/** Playback rate 1.0 in 16.16 fixed point */
+#define VMUPRO_MIXER_RATE_ONE 0x10000
+
+  /**
+   * @brief Called on the game thread once a voice has played all its repeats
+   *
+   * @param voice Voice returned by vmupro_sound_sample_play()
+   * @param user Pointer passed to vmupro_sound_sample_play()
+   */
+  typedef void (*vmupro_sound_finished_t)(int voice, void *user);
+
+  /**
+   * @brief 16-bit PCM sound
+   *
+   * Filled in by one of the vmupro_sound_sample_init functions or by
+   * vmupro_sound_sample_new(). The PCM data is not copied by init and
+   * must stay valid while the sample is in use.
+   */
+  typedef struct
+  {
+    const int16_t *pcm;     /**< Interleaved PCM, channels samples per frame */
+    uint32_t frames;        /**< Length in frames (Lua: sampleCount) */
+    uint32_t sample_rate;   /**< Sample rate in Hz (Lua: sampleRate) */
+    uint8_t channels;       /**< 1 = mono, 2 = stereo */
+    bool allocated;         /**< Created by vmupro_sound_sample_new(), released by free */
+    uint16_t volume_left;   /**< Left volume for new and playing voices, 8.8 fixed point */
+    uint16_t volume_right;  /**< Right volume for new and playing voices, 8.8 fixed point */
+    uint32_t rate;          /**< Playback rate, 16.16 fixed point */
+  } vmupro_sound_sample_t;
+
+  /**
+   * @brief Mixer statistics, counted since vmupro_mixer_start()
+   */
+  typedef struct
+  {
+    uint32_t blocks;          /**< Blocks of VMUPRO_MIXER_BLOCK_FRAMES mixed */
+    uint32_t clipped;         /**< Output samples that saturated */
+    uint32_t voices_started;  /**< Voices started */
+    uint32_t voices_refused;  /**< Plays refused because no voice was free */
+    uint8_t active_voices;    /**< Voices playing in the last block */
+    uint8_t peak_voices;      /**< Most voices playing in one block */
+    uint32_t last_mix_us;     /**< Time to mix the last block */
+    uint32_t max_mix_us;      /**< Slowest block */
+    uint64_t total_mix_us;    /**< Time spent mixing */
+  } vmupro_mixer_stats_t;
+
+  /**
+   * @brief Start listen mode and the audio task
+   *
+   * @param voice_count Voices to mix, 1 to VMUPRO_MIXER_MAX_VOICES
+   * @return true if the mixer is running
+   *
+   * @code
+   * vmupro_mixer_start(8);
+   * vmupro_sound_sample_t *jump = vmupro_sound_sample_new("/sdcard/sfx/jump.wav");
+   * ...
+   * vmupro_sound_sample_play(jump, 0, NULL, NULL);
+   * @endcode
+   */
+  bool vmupro_mixer_start(int voice_count);
+
+  /**
+   * @brief Start the mixer without an audio task
+   *
+   * For apps that already stream audio from their own loop or thread,
+   * or that want a different period than vmupro_mixer_start(): nothing
+   * is mixed until vmupro_mixer_render() is called, and listen mode is
+   * left to the app.
+   *
+   * @param voice_count Voices to mix, 1 to VMUPRO_MIXER_MAX_VOICES
+   * @return true if the mixer is running
+   */
+  bool vmupro_mixer_start_manual(int voice_count);
+
+  /**
+   * @brief Mix the next frames into a buffer
+   *
+   * Only for a mixer started with vmupro_mixer_start_manual(), otherwise
+   * the buffer is filled with silence.
+   *
+   * @param stereo Interleaved left/right destination
+   * @param frames Stereo frames to mix
+   *
+   * @code
+   * static void fill(int16_t *samples, int frames, void *user) {
+   *     vmupro_mixer_render(samples, frames);
+   * }
+   *
+   * vmupro_mixer_start_manual(8);
+   * vmupro_audio_pull_config_t config = vmupro_audio_pull_defaults();
+   * config.period_frames = 128;
+   * vmupro_audio_pull_start(&config, fill, NULL);
+   * @endcode
+   */
+  void vmupro_mixer_render(int16_t *stereo, int frames);
+
+  /**
+   * @brief Stop all voices, the audio task and listen mode
+   *
+   * Listen mode is only left if vmupro_mixer_start() entered it. Finish
+   * callbacks still pending are dropped.
+   */
+  void vmupro_mixer_stop(void);
+
+  /**
+   * @brief Whether the mixer has been started
+   */
+  bool vmupro_mixer_is_running(void);
+
+  /**
+   * @brief Read the mixer statistics
+   *
+   * @param out_stats Destination for the counters. They are updated by
+   *                  the audio task, so fields may come from adjacent blocks
+   */
+  void vmupro_mixer_get_stats(vmupro_mixer_stats_t *out_stats);
+
+  /**
+   * @brief Set up a sample over raw PCM
+   *
+   * @param sample Sample to set up, volume and rate start at 1.0
+   * @param pcm Interleaved 16-bit PCM, 2 byte aligned
+   * @param frames Length in frames
+   * @param channels 1 or 2
+   * @param sample_rate Sample rate in Hz
+   * @return false if a parameter is out of range
+   */
+  bool vmupro_sound_sample_init(vmupro_sound_sample_t *sample, const int16_t *pcm, uint32_t frames,
+                                uint8_t channels, uint32_t sample_rate);
+
+  /**
+   * @brief Set up a sample over WAV file data in memory
+   *
+   * @param sample Sample to set up
+   * @param wav RIFF/WAVE data, 16-bit PCM mono or stereo, 2 byte aligned
+   * @param size Size of wav in bytes
+   * @return false if the data is not a supported WAV file
+   */
+  bool vmupro_sound_sample_init_wav(vmupro_sound_sample_t *sample, const uint8_t *wav, uint32_t size);
+
+  /**
+   * @brief Load a WAV file
+   *
+   * @param path Full path, e.g. "/sdcard/sounds/beep.wav"
+   * @return The sample, or NULL if the file can't be read or isn't a
+   *         supported WAV file. Release with vmupro_sound_sample_free()
+   */
+  vmupro_sound_sample_t *vmupro_sound_sample_new(const char *path);
+
+  /**
+   * @brief Stop a sample's voices and release it
+   *
+   * While the pull mode task (vmupro_audio_pull.h) renders the mixer,
+   * its own or an app callback calling vmupro_mixer_render(), waits for
+   * it to let go of the sample's voices. Otherwise, with the mixer
+   * rendered manually from the game loop or not at all, the voices end at
+   * once, even while the task plays other audio. A manual mixer rendered
+   * from a thread of your own must not be rendering while a playing
+   * sample is freed. Memory is only released for samples from
+   * vmupro_sound_sample_new().
+   *
+   * @param sample Sample to release
+   */
+  void vmupro_sound_sample_free(vmupro_sound_sample_t *sample);
+
+  /**
+   * @brief Play a sample on a free voice
+   *
+   * @param sample Sample to play, with its current volume and rate
+   * @param repeat_count Extra times to play it, 0 to play once
+   * @param finished Called from vmupro_sound_update() after the last repeat, may be NULL
+   * @param user Passed to finished
+   * @return Voice handle, or -1 if the mixer isn't running or no voice is free
+   */
+  int vmupro_sound_sample_play(vmupro_sound_sample_t *sample, int repeat_count, vmupro_sound_finished_t finished,
+                               void *user);
+
+  /**
+   * @brief Stop every voice playing a sample
+   *
+   * @param sample Sample to stop
+   */
+  void vmupro_sound_sample_stop(const vmupro_sound_sample_t *sample);
+
+  /**
+   * @brief Whether any voice is playing a sample
+   *
+   * @param sample Sample to check
+   * @return true from vmupro_sound_sample_play() until the sample ends or is stopped
+   */
+  bool vmupro_sound_sample_is_playing(const vmupro_sound_sample_t *sample);
+
+  /**
+   * @brief Set a sample's stereo volume, including voices already playing it
+   *
+   * @param sample Sample to adjust
+   * @param left Left volume, 8.8 fixed point
+   * @param right Right volume, 8.8 fixed point
+   *
+   * @code
+   * vmupro_sound_sample_set_volume(beep, VMUPRO_MIXER_UNITY, 0); // left only
+   * @endcode
+   */
+  void vmupro_sound_sample_set_volume(vmupro_sound_sample_t *sample, uint16_t left, uint16_t right);
+
+  /**
+   * @brief Get a sample's stereo volume
+   *
+   * @param sample Sample to query
+   * @param left Left volume, 8.8 fixed point, may be NULL
+   * @param right Right volume, 8.8 fixed point, may be NULL
+   */
+  void vmupro_sound_sample_get_volume(const vmupro_sound_sample_t *sample, uint16_t *left, uint16_t *right);
+
+  /**
+   * @brief Set a sample's playback rate, including voices already playing it
+   *
+   * Changes speed and pitch together.
+   *
+   * @param sample Sample to adjust
+   * @param rate 16.16 fixed point, VMUPRO_MIXER_RATE_ONE for normal speed
+   */
+  void vmupro_sound_sample_set_rate(vmupro_sound_sample_t *sample, uint32_t rate);
+
+  /**
+   * @brief Get a sample's playback rate
+   *
+   * @param sample Sample to query
+   * @return 16.16 fixed point rate
+   */
+  uint32_t vmupro_sound_sample_get_rate(const vmupro_sound_sample_t *sample);
+
+  /**
+   * @brief Run finish callbacks
+   *
+   * Mixing doesn't depend on it, but finish callbacks are only called
+   * from here. Call once per frame.
+   */
+  void vmupro_sound_update(void);
+
+  /**
+   * @brief Stop one voice
+   *
+   * @param voice Voice handle, stale handles are ignored
+   */
+  void vmupro_mixer_voice_stop(int voice);
+
+  /**
+   * @brief Whether a voice is still playing
+   *
+   * @param voice Voice handle
+   * @return false once the voice has ended, even if it has been reused
+   */
+  bool vmupro_mixer_voice_is_playing(int voice);
+
+  /**
+   * @brief Set one voice's stereo volume
+   *
+   * @param voice Voice handle
+   * @param left Left volume, 8.8 fixed point
+   * @param right Right volume, 8.8 fixed point
+   */
+  void vmupro_mixer_voice_set_volume(int voice, uint16_t left, uint16_t right);
+
+  /**
+   * @brief Set one voice's volume and pan
+   *
+   * The far side is turned down linearly, the centre plays at volume on
+   * both sides.
+   *
+   * @param voice Voice handle
+   * @param volume Volume, 8.8 fixed point
+   * @param pan -128 (left) to 127 (right), 0 for centre
+   */
+  void vmupro_mixer_voice_set_pan(int voice, uint16_t volume, int pan);
+
+  /**
+   * @brief Set one voice's playback rate
+   *
+   * @param voice Voice handle
+   * @param rate 16.16 fixed point
+   */
+  void vmupro_mixer_voice_set_rate(int voice, uint32_t rate);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,468 @@
+/**
+ * @file vmupro_profile.h
+ * @brief VMUPro Frame Profiler
+ *
+ * Opt-in instrumentation for the display, audio and file APIs. Build the
+ * app with VMUPRO_PROFILE defined, e.g. with
+ * idf_build_set_property(COMPILE_OPTIONS "-DVMUPRO_PROFILE" APPEND) in the
+ * project's CMakeLists.txt, and every call to the functions listed in
+ * vmupro_profile_id_t is timed with vmupro_get_time_us() and aggregated
+ * per function: call count, work done (pixels, characters, samples or
+ * bytes), total and worst case microseconds. Pushes and refreshes also
+ * mark frame boundaries, so their entry is the time spent waiting for the
+ * panel and the frame time is tracked alongside. Each call to
+ * vmupro_audio_add_stream_samples() samples the ring buffer fill.
+ *
+ * Without VMUPRO_PROFILE the API calls are not wrapped, cost nothing, and
+ * the counters stay at zero.
+ *
+ * Results can be drawn on screen with vmupro_profile_draw_overlay() or
+ * dumped as CSV through vmupro_log() with vmupro_profile_dump_csv().
+ *
+ * @note Each profiled call costs two vmupro_get_time_us() reads, which
+ *       matters for many tiny calls. Compare entries against each other
+ *       rather than reading the totals as exact
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-07-29
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "vmupro_display.h"
+#include "vmupro_audio.h"
+#include "vmupro_file.h"
+#include "vmupro_fonts.h"
+#include "vmupro_utils.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /**
+   * @brief Profiled API functions
+   */
+  typedef enum
+  {
+    VMUPRO_PROF_DISPLAY_CLEAR = 0,
+    VMUPRO_PROF_DISPLAY_REFRESH,
+    VMUPRO_PROF_PUSH_DOUBLE_BUFFER_FRAME,
+    VMUPRO_PROF_DRAW_FILL_RECT,
+    VMUPRO_PROF_DRAW_LINE,
+    VMUPRO_PROF_DRAW_TEXT,
+    VMUPRO_PROF_BLIT_BUFFER_AT,
+    VMUPRO_PROF_BLIT_BUFFER_TRANSPARENT,
+    VMUPRO_PROF_BLIT_BUFFER_BLENDED,
+    VMUPRO_PROF_BLIT_BUFFER_FLIPPED,
+    VMUPRO_PROF_BLIT_BUFFER_SCALED,
+    VMUPRO_PROF_BLIT_BUFFER_AFFINE,
+    VMUPRO_PROF_BLIT_TILE,
+    VMUPRO_PROF_BLIT_TILE_ADVANCED,
+    VMUPRO_PROF_BLIT_SCROLLING_BACKGROUND,
+    VMUPRO_PROF_APPLY_MOSAIC_TO_SCREEN,
+    VMUPRO_PROF_SPRITE_BATCH_RENDER,
+    VMUPRO_PROF_TILEMAP_RENDER,
+    VMUPRO_PROF_RENDER_ALL_LAYERS,
+    VMUPRO_PROF_RENDER_LAYERS_RASTER,
+    VMUPRO_PROF_DISPLAY_LIST_REPLAY,
+    VMUPRO_PROF_AUDIO_ADD_STREAM_SAMPLES,
+    VMUPRO_PROF_READ_FILE_COMPLETE,
+    VMUPRO_PROF_READ_FILE_BYTES,
+    VMUPRO_PROF_WRITE_FILE_COMPLETE,
+    VMUPRO_PROF_WRITE_FILE_BYTES,
+    VMUPRO_PROF_COUNT
+  } vmupro_profile_id_t;
+
+  /**
+   * @brief Counters for one API function
+   */
+  typedef struct
+  {
+    const char *name;  /**< API function name */
+    uint32_t calls;    /**< Calls since the last reset */
+    uint64_t units;    /**< Pixels drawn (clipped), characters, samples, bytes or display list commands */
+    uint64_t total_us; /**< Time spent in the function */
+    uint32_t max_us;   /**< Slowest single call */
+  } vmupro_profile_entry_t;
+
+  /**
+   * @brief Frame and audio counters
+   */
+  typedef struct
+  {
+    uint32_t frames;          /**< Frames (pushes and refreshes) since the last reset */
+    uint64_t frame_us;        /**< Time covered by those frames */
+    uint32_t max_frame_us;    /**< Longest frame */
+    uint32_t audio_samples;   /**< Ring buffer fill samples taken */
+    uint8_t audio_fill_min;   /**< Lowest ring buffer fill seen, percent */
+    uint8_t audio_fill_last;  /**< Most recent ring buffer fill, percent */
+  } vmupro_profile_summary_t;
+
+  /**
+   * @brief Clear all counters and restart frame timing
+   */
+  void vmupro_profile_reset(void);
+
+  /**
+   * @brief Add one call to a function's counters
+   *
+   * Used by the VMUPRO_PROFILE wrappers, and available to time app code
+   * under an existing id.
+   *
+   * @param id Function to charge
+   * @param start_us vmupro_get_time_us() when the call started
+   * @param units Work done by the call (see vmupro_profile_entry_t)
+   */
+  void vmupro_profile_record(vmupro_profile_id_t id, uint64_t start_us, uint32_t units);
+
+  /**
+   * @brief Mark the end of a frame
+   *
+   * Called automatically after every push and refresh in profiled builds.
+   */
+  void vmupro_profile_frame(void);
+
+  /**
+   * @brief Record an audio ring buffer fill sample
+   *
+   * @param fill_percent Value returned by vmupro_get_ringbuffer_fill_state()
+   */
+  void vmupro_profile_audio_fill(int fill_percent);
+
+  /**
+   * @brief Read the counters of every profiled function
+   *
+   * @return Array of VMUPRO_PROF_COUNT entries, indexed by vmupro_profile_id_t
+   */
+  const vmupro_profile_entry_t *vmupro_profile_get_entries(void);
+
+  /**
+   * @brief Read the frame and audio counters
+   *
+   * @param out_summary Destination for the counters
+   */
+  void vmupro_profile_get_summary(vmupro_profile_summary_t *out_summary);
+
+  /**
+   * @brief Get the called functions, most expensive first
+   *
+   * @param out_ids Receives the ids, ordered by total time (may be NULL to just count)
+   * @param max_ids Capacity of out_ids
+   * @return Number of ids written, or the number of called functions if out_ids is NULL
+   */
+  int vmupro_profile_get_ranking(vmupro_profile_id_t *out_ids, int max_ids);
+
+  /**
+   * @brief Log the counters as CSV
+   *
+   * Writes one line per function that was called, most expensive first,
+   * then the frame and audio counters, through vmupro_log() at
+   * VMUPRO_LOG_INFO with the tag "PROFILE":
+   *
+   * @code
+   * name,calls,units,total_us,us_per_frame,max_us
+   * vmupro_blit_buffer_blended,600,2457600,31250,520,71
+   * ...
+   * frames,avg_frame_us,max_frame_us,audio_fill_min,audio_fill_last
+   * 60,16702,18110,42,57
+   * @endcode
+   */
+  void vmupro_profile_dump_csv(void);
+
+  /**
+   * @brief Draw the frame time and the most expensive functions
+   *
+   * Draws a black panel with the average and worst frame time, the audio
+   * fill, and one line per function with its microseconds per frame and
+   * calls per frame, most expensive first. Draw it last, just before the
+   * push, so the overlay itself doesn't hide anything.
+   *
+   * @param x Left edge of the panel
+   * @param y Top edge of the panel
+   * @param rows Maximum number of functions to list
+   *
+   * @note Selects VMUPRO_FONT_TINY_6x8, set your own font again afterwards
+   * @note The overlay's own drawing calls are not counted
+   */
+  void vmupro_profile_draw_overlay(int x, int y, int rows);
+
+  /**
+   * @brief Visible part of a screen rectangle, in pixels
+   */
+  static inline uint32_t vmupro_profile_area(int x, int y, int width, int height)
+  {
+    int x1 = x + width > 240 ? 240 : x + width;
+    int y1 = y + height > 240 ? 240 : y + height;
+    x = x < 0 ? 0 : x;
+    y = y < 0 ? 0 : y;
+    return x1 > x && y1 > y ? (uint32_t)((x1 - x) * (y1 - y)) : 0;
+  }
+
+#if defined(VMUPRO_PROFILE) && !defined(VMUPRO_PROFILE_INTERNAL)
+
+  // Each wrapper times the real call, which it still reaches by name
+  // because the renaming macros below are defined after the wrappers
+
+  static inline void vmupro_profiled_display_clear(vmupro_color_t color)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_display_clear(color);
+    vmupro_profile_record(VMUPRO_PROF_DISPLAY_CLEAR, start, 240 * 240);
+  }
+
+  static inline void vmupro_profiled_display_refresh(void)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_display_refresh();
+    vmupro_profile_record(VMUPRO_PROF_DISPLAY_REFRESH, start, 0);
+    vmupro_profile_frame();
+  }
+
+  static inline void vmupro_profiled_push_double_buffer_frame(void)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_push_double_buffer_frame();
+    vmupro_profile_record(VMUPRO_PROF_PUSH_DOUBLE_BUFFER_FRAME, start, 0);
+    vmupro_profile_frame();
+  }
+
+  static inline void vmupro_profiled_draw_fill_rect(int x1, int y1, int x2, int y2, vmupro_color_t color)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_draw_fill_rect(x1, y1, x2, y2, color);
+    vmupro_profile_record(VMUPRO_PROF_DRAW_FILL_RECT, start, vmupro_profile_area(x1, y1, x2 - x1 + 1, y2 - y1 + 1));
+  }
+
+  static inline void vmupro_profiled_draw_line(int x1, int y1, int x2, int y2, vmupro_color_t color)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_draw_line(x1, y1, x2, y2, color);
+    int dx = x2 > x1 ? x2 - x1 : x1 - x2;
+    int dy = y2 > y1 ? y2 - y1 : y1 - y2;
+    vmupro_profile_record(VMUPRO_PROF_DRAW_LINE, start, (uint32_t)(dx > dy ? dx : dy) + 1);
+  }
+
+  static inline void vmupro_profiled_draw_text(const char *text, int x, int y, uint16_t color, uint16_t bg_color)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_draw_text(text, x, y, color, bg_color);
+    vmupro_profile_record(VMUPRO_PROF_DRAW_TEXT, start, text ? (uint32_t)strlen(text) : 0);
+  }
+
+  static inline void vmupro_profiled_blit_buffer_at(uint8_t *buffer, int x, int y, int width, int height)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_blit_buffer_at(buffer, x, y, width, height);
+    vmupro_profile_record(VMUPRO_PROF_BLIT_BUFFER_AT, start, vmupro_profile_area(x, y, width, height));
+  }
+
+  static inline void vmupro_profiled_blit_buffer_transparent(uint8_t *buffer, int x, int y, int width, int height,
+                                                             vmupro_color_t transparent_color, vmupro_drawflags_t flags)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_blit_buffer_transparent(buffer, x, y, width, height, transparent_color, flags);
+    vmupro_profile_record(VMUPRO_PROF_BLIT_BUFFER_TRANSPARENT, start, vmupro_profile_area(x, y, width, height));
+  }
+
+  static inline void vmupro_profiled_blit_buffer_blended(uint8_t *buffer, int x, int y, int width, int height,
+                                                         uint8_t alpha_level)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_blit_buffer_blended(buffer, x, y, width, height, alpha_level);
+    vmupro_profile_record(VMUPRO_PROF_BLIT_BUFFER_BLENDED, start, vmupro_profile_area(x, y, width, height));
+  }
+
+  static inline void vmupro_profiled_blit_buffer_flipped(uint8_t *buffer, int x, int y, int width, int height,
+                                                         vmupro_drawflags_t flags)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_blit_buffer_flipped(buffer, x, y, width, height, flags);
+    vmupro_profile_record(VMUPRO_PROF_BLIT_BUFFER_FLIPPED, start, vmupro_profile_area(x, y, width, height));
+  }
+
+  static inline void vmupro_profiled_blit_buffer_scaled(uint8_t *buffer, int buffer_width, int src_x, int src_y,
+                                                        int src_width, int src_height, int dest_x, int dest_y,
+                                                        int dest_width, int dest_height)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_blit_buffer_scaled(buffer, buffer_width, src_x, src_y, src_width, src_height, dest_x, dest_y, dest_width,
+                              dest_height);
+    vmupro_profile_record(VMUPRO_PROF_BLIT_BUFFER_SCALED, start,
+                          vmupro_profile_area(dest_x, dest_y, dest_width, dest_height));
+  }
+
+  // the destination shape isn't known up front, the source area is counted
+  static inline void vmupro_profiled_blit_buffer_affine(uint8_t *buffer, int buffer_width, int src_x, int src_y,
+                                                        int src_width, int src_height, const vmupro_affine_t *matrix,
+                                                        vmupro_sample_mode_t sample, int transparent_color,
+                                                        uint8_t alpha)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_blit_buffer_affine(buffer, buffer_width, src_x, src_y, src_width, src_height, matrix, sample,
+                              transparent_color, alpha);
+    vmupro_profile_record(VMUPRO_PROF_BLIT_BUFFER_AFFINE, start,
+                          src_width > 0 && src_height > 0 ? (uint32_t)(src_width * src_height) : 0);
+  }
+
+  static inline void vmupro_profiled_blit_tile(uint8_t *buffer, int x, int y, int src_x, int src_y, int width,
+                                               int height, int tilemap_width)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_blit_tile(buffer, x, y, src_x, src_y, width, height, tilemap_width);
+    vmupro_profile_record(VMUPRO_PROF_BLIT_TILE, start, vmupro_profile_area(x, y, width, height));
+  }
+
+  static inline void vmupro_profiled_blit_tile_advanced(uint8_t *buffer, int x, int y, int atlas_src_x,
+                                                        int atlas_src_y, int width, int height, int tilemap_width,
+                                                        vmupro_color_t transparent_color, vmupro_drawflags_t flags)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_blit_tile_advanced(buffer, x, y, atlas_src_x, atlas_src_y, width, height, tilemap_width,
+                              transparent_color, flags);
+    vmupro_profile_record(VMUPRO_PROF_BLIT_TILE_ADVANCED, start, vmupro_profile_area(x, y, width, height));
+  }
+
+  static inline void vmupro_profiled_blit_scrolling_background(uint8_t *bg_buffer, int bg_width, int bg_height,
+                                                               int scroll_x, int scroll_y, int dest_width,
+                                                               int dest_height)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_blit_scrolling_background(bg_buffer, bg_width, bg_height, scroll_x, scroll_y, dest_width, dest_height);
+    vmupro_profile_record(VMUPRO_PROF_BLIT_SCROLLING_BACKGROUND, start,
+                          vmupro_profile_area(0, 0, dest_width, dest_height));
+  }
+
+  static inline void vmupro_profiled_apply_mosaic_to_screen(int x, int y, int width, int height, int mosaic_size)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_apply_mosaic_to_screen(x, y, width, height, mosaic_size);
+    vmupro_profile_record(VMUPRO_PROF_APPLY_MOSAIC_TO_SCREEN, start, vmupro_profile_area(x, y, width, height));
+  }
+
+  static inline void vmupro_profiled_sprite_batch_render(vmupro_sprite_t *sprites, int num_sprites)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_sprite_batch_render(sprites, num_sprites);
+    uint32_t pixels = 0;
+    for (int i = 0; i < num_sprites; i++)
+      pixels += vmupro_profile_area(sprites[i].x, sprites[i].y, sprites[i].width, sprites[i].height);
+    vmupro_profile_record(VMUPRO_PROF_SPRITE_BATCH_RENDER, start, pixels);
+  }
+
+  static inline void vmupro_profiled_tilemap_render(const vmupro_tilemap_t *tilemap, int scroll_x, int scroll_y,
+                                                    int x, int y, int width, int height)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_tilemap_render(tilemap, scroll_x, scroll_y, x, y, width, height);
+    vmupro_profile_record(VMUPRO_PROF_TILEMAP_RENDER, start, vmupro_profile_area(x, y, width, height));
+  }
+
+  static inline void vmupro_profiled_render_all_layers(void)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_render_all_layers();
+    vmupro_profile_record(VMUPRO_PROF_RENDER_ALL_LAYERS, start, 240 * 240);
+  }
+
+  static inline void vmupro_profiled_render_layers_raster(const vmupro_raster_line_t *lines,
+                                                          vmupro_raster_callback_t callback, void *user_data,
+                                                          const vmupro_raster_palette_t *palettes, int num_palettes)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_render_layers_raster(lines, callback, user_data, palettes, num_palettes);
+    vmupro_profile_record(VMUPRO_PROF_RENDER_LAYERS_RASTER, start, 240 * 240);
+  }
+
+  static inline int vmupro_profiled_display_list_replay(vmupro_display_list_t *list, uint32_t flags)
+  {
+    uint64_t start = vmupro_get_time_us();
+    int commands = vmupro_display_list_replay(list, flags);
+    vmupro_profile_record(VMUPRO_PROF_DISPLAY_LIST_REPLAY, start, commands > 0 ? (uint32_t)commands : 0);
+    return commands;
+  }
+
+  static inline void vmupro_profiled_audio_add_stream_samples(int16_t *samples, int numSamples,
+                                                              vmupro_stereo_mode_t stereo_mode,
+                                                              bool applyGlobalVolume)
+  {
+    uint64_t start = vmupro_get_time_us();
+    vmupro_audio_add_stream_samples(samples, numSamples, stereo_mode, applyGlobalVolume);
+    vmupro_profile_record(VMUPRO_PROF_AUDIO_ADD_STREAM_SAMPLES, start, numSamples > 0 ? (uint32_t)numSamples : 0);
+
+    uint32_t filled, size;
+    vmupro_profile_audio_fill(vmupro_get_ringbuffer_fill_state(&filled, &size));
+  }
+
+  static inline bool vmupro_profiled_read_file_complete(const char *filename, uint8_t *buffer, size_t *file_size)
+  {
+    uint64_t start = vmupro_get_time_us();
+    bool ok = vmupro_read_file_complete(filename, buffer, file_size);
+    vmupro_profile_record(VMUPRO_PROF_READ_FILE_COMPLETE, start, ok && file_size ? (uint32_t)*file_size : 0);
+    return ok;
+  }
+
+  static inline bool vmupro_profiled_read_file_bytes(const char *filename, uint8_t *buffer, uint32_t offset,
+                                                     int num_bytes)
+  {
+    uint64_t start = vmupro_get_time_us();
+    bool ok = vmupro_read_file_bytes(filename, buffer, offset, num_bytes);
+    vmupro_profile_record(VMUPRO_PROF_READ_FILE_BYTES, start, ok && num_bytes > 0 ? (uint32_t)num_bytes : 0);
+    return ok;
+  }
+
+  static inline bool vmupro_profiled_write_file_complete(const char *filename, const uint8_t *data, size_t size)
+  {
+    uint64_t start = vmupro_get_time_us();
+    bool ok = vmupro_write_file_complete(filename, data, size);
+    vmupro_profile_record(VMUPRO_PROF_WRITE_FILE_COMPLETE, start, ok ? (uint32_t)size : 0);
+    return ok;
+  }
+
+  static inline bool vmupro_profiled_write_file_bytes(const char *filename, const uint8_t *data, uint32_t offset,
+                                                      size_t length)
+  {
+    uint64_t start = vmupro_get_time_us();
+    bool ok = vmupro_write_file_bytes(filename, data, offset, length);
+    vmupro_profile_record(VMUPRO_PROF_WRITE_FILE_BYTES, start, ok ? (uint32_t)length : 0);
+    return ok;
+  }
+
+#define vmupro_display_clear vmupro_profiled_display_clear
+#define vmupro_display_refresh vmupro_profiled_display_refresh
+#define vmupro_push_double_buffer_frame vmupro_profiled_push_double_buffer_frame
+#define vmupro_draw_fill_rect vmupro_profiled_draw_fill_rect
+#define vmupro_draw_line vmupro_profiled_draw_line
+#define vmupro_draw_text vmupro_profiled_draw_text
+#define vmupro_blit_buffer_at vmupro_profiled_blit_buffer_at
+#define vmupro_blit_buffer_transparent vmupro_profiled_blit_buffer_transparent
+#define vmupro_blit_buffer_blended vmupro_profiled_blit_buffer_blended
+#define vmupro_blit_buffer_flipped vmupro_profiled_blit_buffer_flipped
+#define vmupro_blit_buffer_scaled vmupro_profiled_blit_buffer_scaled
+#define vmupro_blit_buffer_affine vmupro_profiled_blit_buffer_affine
+#define vmupro_blit_tile vmupro_profiled_blit_tile
+#define vmupro_blit_tile_advanced vmupro_profiled_blit_tile_advanced
+#define vmupro_blit_scrolling_background vmupro_profiled_blit_scrolling_background
+#define vmupro_apply_mosaic_to_screen vmupro_profiled_apply_mosaic_to_screen
+#define vmupro_sprite_batch_render vmupro_profiled_sprite_batch_render
+#define vmupro_tilemap_render vmupro_profiled_tilemap_render
+#define vmupro_render_all_layers vmupro_profiled_render_all_layers
+#define vmupro_render_layers_raster vmupro_profiled_render_layers_raster
+#define vmupro_display_list_replay vmupro_profiled_display_list_replay
+#define vmupro_audio_add_stream_samples vmupro_profiled_audio_add_stream_samples
+#define vmupro_read_file_complete vmupro_profiled_read_file_complete
+#define vmupro_read_file_bytes vmupro_profiled_read_file_bytes
+#define vmupro_write_file_complete vmupro_profiled_write_file_complete
+#define vmupro_write_file_bytes vmupro_profiled_write_file_bytes
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
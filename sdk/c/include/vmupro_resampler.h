@@ -0,0 +1,316 @@
+/**
+ * @file vmupro_resampler.h
+ * @brief VMUPro Sample Rate Conversion
+ *
+ * The audio output runs at 44.1kHz. Sources at other rates (emulated
+ * sound chips at 32kHz, 48kHz or 22.05kHz, samples recorded at 8kHz)
+ * have to be converted first. A resampler converts one stream of mono or
+ * interleaved stereo frames between any two rates in fixed point, with
+ * the cost/quality trade-off chosen explicitly:
+ *
+ * - VMUPRO_RESAMPLE_LINEAR interpolates between neighbouring samples. It
+ *   is the cheapest, but aliases and dulls the top octave.
+ * - VMUPRO_RESAMPLE_SINC_8 and VMUPRO_RESAMPLE_SINC_16 are polyphase
+ *   windowed-sinc filters with 8 or 16 taps. The filter cutoff follows
+ *   the lower of the two rates, so downsampling doesn't alias.
+ *
+ * For plain streaming, vmupro_audio_stream_set_format() and
+ * vmupro_audio_stream_write() wrap a resampler around
+ * vmupro_audio_add_stream_samples(), so an app can stream its native
+ * rate directly.
+ *
+ * A core paced by vmupro_get_time_us() never produces exactly 44100
+ * frames per DAC second, so over minutes the ring buffer fills up or
+ * runs dry. Dynamic rate control nudges the conversion ratio by up to
+ * 0.5% (inaudible) to hold the ring buffer at a target fill, so the
+ * buffer can stay small without gaps. Enable it on the stream with
+ * vmupro_audio_stream_set_rate_control(), or run a
+ * vmupro_rate_control_t against any other FIFO.
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-08-07
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vmupro_audio.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Most taps of any quality */
+#define VMUPRO_RESAMPLER_MAX_TAPS 16
+
+/** Filter phases stored per quality, coefficients in between are interpolated */
+#define VMUPRO_RESAMPLER_PHASES 64
+
+/** Lowest and highest supported rates */
+#define VMUPRO_RESAMPLER_MIN_RATE 4000
+#define VMUPRO_RESAMPLER_MAX_RATE 96000
+
+/** Largest rate correction, in parts per million */
+#define VMUPRO_RATE_CONTROL_MAX_PPM 5000
+
+  /**
+   * @brief Conversion quality, in order of cost
+   */
+  typedef enum
+  {
+    VMUPRO_RESAMPLE_LINEAR = 0, /**< 2 taps, about 4 multiplies per output sample */
+    VMUPRO_RESAMPLE_SINC_8,     /**< 8 tap windowed sinc, about 16 multiplies per output sample */
+    VMUPRO_RESAMPLE_SINC_16,    /**< 16 tap windowed sinc, about 32 multiplies per output sample */
+  } vmupro_resample_quality_t;
+
+  /**
+   * @brief Resampler state
+   *
+   * Set up with vmupro_resampler_init(). The filter kernel is held in the
+   * struct (about 2KB), so keep it static or on the heap rather than on
+   * a small task stack.
+   */
+  typedef struct
+  {
+    uint32_t in_rate;                   /**< Source rate in Hz */
+    uint32_t out_rate;                  /**< Destination rate in Hz */
+    uint8_t channels;                   /**< 1 for mono, 2 for interleaved stereo */
+    uint8_t taps;                       /**< Taps of the chosen quality */
+    vmupro_resample_quality_t quality;  /**< Chosen quality */
+    uint32_t step_int;                  /**< Whole source frames advanced per output frame */
+    uint32_t step_frac;                 /**< Fractional part of the step, 0.32 fixed point */
+    uint32_t frac;                      /**< Position between two source frames, 0.32 fixed point */
+    uint32_t skip;                      /**< Source frames to take in before the next output frame */
+    uint32_t head;                      /**< Next history slot */
+    int32_t adjust_ppm;                 /**< Output rate correction, see vmupro_resampler_set_adjust() */
+    int16_t history[2][VMUPRO_RESAMPLER_MAX_TAPS * 2];
+    int16_t kernel[(VMUPRO_RESAMPLER_PHASES + 1) * VMUPRO_RESAMPLER_MAX_TAPS];
+  } vmupro_resampler_t;
+
+  /**
+   * @brief Set up a resampler
+   *
+   * The output starts aligned with the input: output frame n is the
+   * source at time n / out_rate. The sinc qualities need taps / 2 source
+   * frames of lookahead, so the output trails the input by that much
+   * until vmupro_resampler_flush().
+   *
+   * @param r Resampler to set up
+   * @param in_rate Source rate in Hz
+   * @param out_rate Destination rate in Hz
+   * @param channels 1 for mono or 2 for interleaved stereo
+   * @param quality Conversion quality
+   * @return false if a rate or the channel count is out of range
+   *
+   * @code
+   * static vmupro_resampler_t rs;
+   * vmupro_resampler_init(&rs, 32000, 44100, 2, VMUPRO_RESAMPLE_SINC_8);
+   * @endcode
+   */
+  bool vmupro_resampler_init(vmupro_resampler_t *r, uint32_t in_rate, uint32_t out_rate, int channels,
+                             vmupro_resample_quality_t quality);
+
+  /**
+   * @brief Forget all history, keeping the rates and quality
+   *
+   * @param r Resampler to reset
+   */
+  void vmupro_resampler_reset(vmupro_resampler_t *r);
+
+  /**
+   * @brief Convert as much input as fits in the output
+   *
+   * Stops when the input is used up or the output is full, whichever is
+   * first. Input that wasn't used has to be passed again next time.
+   *
+   * @param r Resampler
+   * @param in Source frames, interleaved if stereo
+   * @param in_frames Source frames available
+   * @param in_used Set to the source frames taken in, may be NULL
+   * @param out Destination, interleaved if stereo
+   * @param max_out_frames Room in the destination in frames
+   * @return Frames written to out
+   */
+  int vmupro_resampler_process(vmupro_resampler_t *r, const int16_t *in, int in_frames, int *in_used, int16_t *out,
+                               int max_out_frames);
+
+  /**
+   * @brief Fine tune the conversion ratio
+   *
+   * Positive values produce more output per input frame, as if out_rate
+   * were that many parts per million higher; the pitch drops by the same
+   * amount. Takes effect from the next output frame, without a click.
+   *
+   * @param r Resampler
+   * @param ppm Correction, clamped to +/- VMUPRO_RATE_CONTROL_MAX_PPM
+   */
+  void vmupro_resampler_set_adjust(vmupro_resampler_t *r, int32_t ppm);
+
+  /**
+   * @brief Most output frames in_frames of input can produce
+   *
+   * @param r Resampler
+   * @param in_frames Source frames
+   * @return Upper bound on the frames vmupro_resampler_process() writes
+   */
+  int vmupro_resampler_max_output(const vmupro_resampler_t *r, int in_frames);
+
+  /**
+   * @brief Push the remaining lookahead out with silence
+   *
+   * Call at the end of a sound so its last taps / 2 source frames are
+   * heard.
+   *
+   * @param r Resampler
+   * @param out Destination, interleaved if stereo
+   * @param max_out_frames Room in the destination in frames
+   * @return Frames written to out
+   */
+  int vmupro_resampler_flush(vmupro_resampler_t *r, int16_t *out, int max_out_frames);
+
+  /**
+   * @brief Dynamic rate control settings
+   */
+  typedef struct
+  {
+    uint32_t target_fill;    /**< Frames to hold queued, the latency */
+    uint32_t max_adjust_ppm; /**< Largest correction, up to VMUPRO_RATE_CONTROL_MAX_PPM */
+  } vmupro_rate_control_config_t;
+
+  /**
+   * @brief Dynamic rate control telemetry
+   */
+  typedef struct
+  {
+    uint32_t updates;         /**< Fill levels seen */
+    uint32_t fill;            /**< Last fill level, in frames */
+    uint32_t avg_fill;        /**< Smoothed fill level the correction is based on */
+    uint32_t min_fill;        /**< Lowest fill level seen */
+    uint32_t max_fill;        /**< Highest fill level seen */
+    uint32_t empty;           /**< Updates that found the buffer empty, each one a likely gap */
+    uint32_t saturated;       /**< Updates that needed more than max_adjust_ppm */
+    int32_t adjust_ppm;       /**< Correction in use */
+    int32_t drift_ppm;        /**< Long term part of the correction: how far the producer's clock is off */
+    int32_t min_adjust_ppm;   /**< Lowest correction used */
+    int32_t max_adjust_ppm;   /**< Highest correction used */
+  } vmupro_rate_control_stats_t;
+
+  /**
+   * @brief Dynamic rate control state
+   *
+   * A proportional-integral controller on the smoothed fill level. The
+   * proportional part reaches the limit at half the target away from it,
+   * the integral part learns the steady clock drift so the fill settles
+   * on the target itself rather than beside it.
+   */
+  typedef struct
+  {
+    vmupro_rate_control_config_t config;
+    uint32_t avg_fill_q8;   /**< Smoothed fill, 24.8 fixed point */
+    int64_t integral_q8;    /**< Drift estimate in ppm, 24.8 fixed point */
+    vmupro_rate_control_stats_t stats;
+  } vmupro_rate_control_t;
+
+  /**
+   * @brief Default settings: hold 1024 frames (23ms), correct up to 0.5%
+   */
+  static inline vmupro_rate_control_config_t vmupro_rate_control_defaults(void)
+  {
+    vmupro_rate_control_config_t config = {1024, VMUPRO_RATE_CONTROL_MAX_PPM};
+    return config;
+  }
+
+  /**
+   * @brief Set up a controller
+   *
+   * @param rc Controller
+   * @param config Settings, NULL for vmupro_rate_control_defaults()
+   */
+  void vmupro_rate_control_init(vmupro_rate_control_t *rc, const vmupro_rate_control_config_t *config);
+
+  /**
+   * @brief Feed the controller a fill level and get the correction
+   *
+   * Call once per batch of audio queued, before queueing it.
+   *
+   * @param rc Controller
+   * @param fill Frames waiting in the buffer being held
+   * @param frames Frames queued since the last update
+   * @return Correction for vmupro_resampler_set_adjust()
+   *
+   * @code
+   * // emulator FIFO drained by a pull mode callback
+   * int32_t ppm = vmupro_rate_control_update(&rc, fifo_fill(), frames_last_time);
+   * vmupro_resampler_set_adjust(&rs, ppm);
+   * @endcode
+   */
+  int32_t vmupro_rate_control_update(vmupro_rate_control_t *rc, uint32_t fill, uint32_t frames);
+
+  /**
+   * @brief Set the rate of the stream passed to vmupro_audio_stream_write()
+   *
+   * Resets the conversion history. A 44.1kHz source is passed through
+   * unconverted.
+   *
+   * @param sample_rate Source rate in Hz
+   * @param stereo_mode VMUPRO_AUDIO_MONO or VMUPRO_AUDIO_STEREO
+   * @param quality Conversion quality
+   * @return false if the rate is out of range
+   *
+   * @code
+   * vmupro_audio_start_listen_mode();
+   * vmupro_audio_stream_set_format(32000, VMUPRO_AUDIO_STEREO, VMUPRO_RESAMPLE_SINC_8);
+   * // each frame
+   * vmupro_audio_stream_write(apu_samples, apu_frames, true);
+   * @endcode
+   */
+  bool vmupro_audio_stream_set_format(uint32_t sample_rate, vmupro_stereo_mode_t stereo_mode,
+                                      vmupro_resample_quality_t quality);
+
+  /**
+   * @brief Convert frames to 44.1kHz and queue them for playback
+   *
+   * Same as vmupro_audio_add_stream_samples(), but counted in frames of
+   * the format set with vmupro_audio_stream_set_format() (44.1kHz mono
+   * if it was never called).
+   *
+   * @param samples Source frames, interleaved if stereo
+   * @param frames Number of frames
+   * @param applyGlobalVolume Apply the system volume
+   */
+  void vmupro_audio_stream_write(const int16_t *samples, int frames, bool applyGlobalVolume);
+
+  /**
+   * @brief Hold the ring buffer fill with dynamic rate control
+   *
+   * Each vmupro_audio_stream_write() then checks the ring buffer fill
+   * and corrects the conversion ratio. A 44.1kHz stream is converted too
+   * while this is on. Queue a frame's worth of audio per write and keep
+   * target_fill above the largest write, or the ring buffer can empty
+   * between writes.
+   *
+   * @param config Settings, NULL to turn rate control off
+   *
+   * @code
+   * vmupro_audio_stream_set_format(32040, VMUPRO_AUDIO_STEREO, VMUPRO_RESAMPLE_SINC_8);
+   * vmupro_rate_control_config_t drc = vmupro_rate_control_defaults();
+   * drc.target_fill = 1536;
+   * vmupro_audio_stream_set_rate_control(&drc);
+   * @endcode
+   */
+  void vmupro_audio_stream_set_rate_control(const vmupro_rate_control_config_t *config);
+
+  /**
+   * @brief Read the stream's rate control telemetry
+   *
+   * @param out_stats Destination, zeroed if rate control is off
+   */
+  void vmupro_audio_stream_get_rate_control_stats(vmupro_rate_control_stats_t *out_stats);
+
+#ifdef __cplusplus
+}
+#endif
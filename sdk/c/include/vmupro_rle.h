@@ -0,0 +1,120 @@
+/**
+ * @file vmupro_rle.h
+ * @brief VMUPro Run-Length Encoded Sprites
+ *
+ * This header provides a compact sprite format for mostly transparent
+ * images and a blitter that draws straight from it. Only the opaque
+ * spans of each row are stored, so the transparent parts of a sprite
+ * cost neither storage nor memory bandwidth, and no per-pixel colour
+ * key test is needed when drawing.
+ *
+ * Sprites are normally encoded offline with tools/sprites/sprite_rle.py,
+ * or at runtime with vmupro_rle_encode().
+ *
+ * ## Format
+ * All header fields are little endian, pixels are big endian RGB565
+ * exactly as in uncompressed buffers.
+ *
+ * | Offset | Size       | Field                                              |
+ * |--------|------------|----------------------------------------------------|
+ * | 0      | 2          | Magic, VMUPRO_RLE_MAGIC ("RL")                     |
+ * | 2      | 2          | Width in pixels                                    |
+ * | 4      | 2          | Height in pixels                                   |
+ * | 6      | 2          | Flags, reserved (0)                                |
+ * | 8      | 4 * height | Byte offset of each row, from the start of the data |
+ * | ...    |            | Row data                                           |
+ *
+ * Each row is a span count followed by that many spans:
+ * `uint16 span_count`, then `{ uint16 skip, uint16 count, count x pixel }`
+ * where skip is the number of transparent pixels since the end of the
+ * previous span (or the start of the row).
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-07-18
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vmupro_display.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define VMUPRO_RLE_MAGIC 0x4C52 /**< "RL" read as a little endian uint16 */
+#define VMUPRO_RLE_HEADER_SIZE 8
+
+  /**
+   * @brief Fixed part of an RLE sprite, followed by the row offset table
+   */
+  typedef struct
+  {
+    uint16_t magic;  /**< VMUPRO_RLE_MAGIC */
+    uint16_t width;  /**< Width in pixels */
+    uint16_t height; /**< Height in pixels */
+    uint16_t flags;  /**< Reserved, 0 */
+  } vmupro_rle_header_t;
+
+  /**
+   * @brief Encode an RGB565 buffer as an RLE sprite
+   *
+   * Pixels equal to transparent_color are dropped, every other pixel is
+   * stored in an opaque span. Call once with out set to NULL to get the
+   * required size, allocate, then call again to encode.
+   *
+   * @param buffer Source pixels (RGB565, width * height)
+   * @param width Source width in pixels (1-65535)
+   * @param height Source height in pixels (1-65535)
+   * @param transparent_color Colour key to drop
+   * @param out Destination, 4 byte aligned (or NULL to query the size)
+   * @param out_size Size of out in bytes
+   * @return Encoded size in bytes, or -1 if the arguments are invalid or out is too small
+   */
+  int vmupro_rle_encode(const uint8_t *buffer, int width, int height, vmupro_color_t transparent_color,
+                        uint8_t *out, int out_size);
+
+  /**
+   * @brief Check an RLE sprite and read its dimensions
+   *
+   * @param rle Encoded sprite
+   * @param width Receives the width (may be NULL)
+   * @param height Receives the height (may be NULL)
+   * @return true if rle points to a 4 byte aligned RLE sprite, false otherwise
+   */
+  bool vmupro_rle_get_info(const uint8_t *rle, int *width, int *height);
+
+  /**
+   * @brief Draw an RLE sprite
+   *
+   * Copies the opaque spans straight into the back buffer. Rows outside
+   * the screen are skipped using the row offset table and spans are
+   * clipped against the screen edges, so off-screen parts cost nothing.
+   *
+   * @param rle Encoded sprite (4 byte aligned)
+   * @param x Destination X coordinate (top-left corner)
+   * @param y Destination Y coordinate (top-left corner)
+   * @param flags VMUPRO_DRAWFLAGS_FLIP_H and/or VMUPRO_DRAWFLAGS_FLIP_V
+   *
+   * @note Output matches vmupro_blit_buffer_transparent() with the colour key
+   *       used for encoding, except that vmupro_set_color_window() is not applied
+   * @note In partial update mode the drawn area is only marked dirty when the
+   *       SDK is built with VMUPRO_FIRMWARE_DIRTY_RECTS, which needs firmware
+   *       newer than 2.0.0 (see vmupro_mark_dirty_rect())
+   *
+   * @code
+   * // tools/sprites/sprite_rle.py ship.png --header ship_rle.h
+   * #include "ship_rle.h"
+   *
+   * vmupro_blit_rle(ship_rle, player_x, player_y, facing_left ? VMUPRO_DRAWFLAGS_FLIP_H : VMUPRO_DRAWFLAGS_NORMAL);
+   * @endcode
+   */
+  void vmupro_blit_rle(const uint8_t *rle, int x, int y, vmupro_drawflags_t flags);
+
+#ifdef __cplusplus
+}
+#endif
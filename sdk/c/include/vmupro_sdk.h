@@ -18,8 +18,22 @@
 #include "vmupro_utils.h"
 #include "vmupro_buttons.h"
 #include "vmupro_file.h"
+#include "vmupro_file_async.h"
 #include "vmupro_audio.h"
 #include "vmupro_fonts.h"
+#include "vmupro_rle.h"
+#include "vmupro_indexed.h"
+#include "vmupro_frame_pacer.h"
+#include "vmupro_text.h"
+#include "vmupro_bmfont.h"
+#include "vmupro_resampler.h"
+#include "vmupro_audio_pull.h"
+#include "vmupro_wav_stream.h"
+#include "vmupro_mixer.h"
+#include "vmupro_synth.h"
+#include "vmupro_instrument.h"
+#include "vmupro_sequence.h"
+#include "vmupro_profile.h"
 
 #ifdef __cplusplus
 extern "C"
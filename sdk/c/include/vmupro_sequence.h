@@ -0,0 +1,288 @@
+/**
+ * @file vmupro_sequence.h
+ * @brief VMUPro MIDI Sequencer
+ *
+ * Plays standard MIDI files (.mid) through synths (vmupro_synth.h) or
+ * sampled instruments (vmupro_instrument.h).
+ *
+ * A MIDI file stores each track as its own stream of variable length
+ * ticks, with the tempo in yet another. When the file is loaded, the
+ * tracks are merged and the tempo map applied once, and the result is
+ * kept as a flat array of note events sorted by time, each with its
+ * distance from the one before in output frames. Each event's frame is
+ * rounded from its exact time since the start, so rounding never
+ * accumulates over a long song.
+ *
+ * Events are dispatched by the synth engine's scheduler on the audio task:
+ * the engine renders up to the frame an event is due, plays it, and
+ * carries on, so every note starts on its exact frame however busy the
+ * game loop is, and no update call is needed. The counters from
+ * vmupro_sequence_get_stats() show any events dispatched late and how far
+ * the music has drifted from the system clock.
+ *
+ * | Lua                                         | C                                        |
+ * |---------------------------------------------|------------------------------------------|
+ * | vmupro.sound.sequence.new(path)             | vmupro_sequence_new()                    |
+ * | vmupro.sound.sequence.getTrackCount(seq)    | vmupro_sequence_get_track_count()        |
+ * | vmupro.sound.sequence.setTrackInstrument()  | vmupro_sequence_set_track_instrument()   |
+ * | vmupro.sound.sequence.getTrackPolyphony()   | vmupro_sequence_get_track_polyphony()    |
+ * | vmupro.sound.sequence.getTrackNotesActive() | vmupro_sequence_get_track_notes_active() |
+ * | vmupro.sound.sequence.play(seq)             | vmupro_sequence_play()                   |
+ * | vmupro.sound.sequence.stop(seq)             | vmupro_sequence_stop()                   |
+ * | vmupro.sound.sequence.setLooping(...)       | vmupro_sequence_set_looping()            |
+ * | vmupro.sound.sequence.isPlaying(seq)        | vmupro_sequence_is_playing()             |
+ * | vmupro.sound.sequence.free(seq)             | vmupro_sequence_free()                   |
+ *
+ * Tracks are numbered from 0. In a format 0 file, each MIDI channel is a
+ * track. Format 2 files aren't supported.
+ *
+ * @note Call the functions in this header from one thread, normally the
+ *       game loop. The sequencer installs the synth engine's scheduler
+ *       (vmupro_synth_engine_set_scheduler()) when a sequence first plays
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-08-11
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "vmupro_synth.h"
+#include "vmupro_instrument.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Most tracks in a sequence */
+#define VMUPRO_SEQUENCE_MAX_TRACKS 32
+
+/** Most synths a track can play notes on */
+#define VMUPRO_SEQUENCE_MAX_TRACK_SYNTHS 16
+
+/** Most sequences playing at once */
+#define VMUPRO_SEQUENCE_MAX_PLAYING 4
+
+  /**
+   * @brief What a compiled event does
+   */
+  typedef enum
+  {
+    VMUPRO_SEQUENCE_NOTE_ON = 0, /**< Start note, at velocity value */
+    VMUPRO_SEQUENCE_NOTE_OFF,    /**< Release note */
+    VMUPRO_SEQUENCE_PROGRAM,     /**< Program change to value */
+    VMUPRO_SEQUENCE_END,         /**< End of the sequence, always the last event */
+  } vmupro_sequence_event_kind_t;
+
+  /**
+   * @brief One compiled event
+   */
+  typedef struct
+  {
+    uint32_t delta_frames; /**< Frames after the previous event, or the start */
+    uint8_t track;         /**< Track, from 0 */
+    uint8_t kind;          /**< vmupro_sequence_event_kind_t */
+    uint8_t note;          /**< MIDI note number */
+    uint8_t value;         /**< Velocity 1 to 127, or program */
+  } vmupro_sequence_event_t;
+
+  /**
+   * @brief Opaque sequence handle
+   */
+  typedef struct vmupro_sequence vmupro_sequence_t;
+
+  /**
+   * @brief Sequence counters, kept since vmupro_sequence_new()
+   */
+  typedef struct
+  {
+    uint32_t dispatched;      /**< Events dispatched */
+    uint32_t late;            /**< Events dispatched after their frame */
+    uint32_t max_late_frames; /**< Latest dispatch */
+    uint32_t loops;           /**< Times the sequence started over */
+    uint32_t notes_stolen;    /**< Notes that cut off a held note, with all of the track's synths busy */
+    uint32_t notes_dropped;   /**< Notes on tracks without synths or an instrument */
+    uint32_t position_frames; /**< Frames into the sequence rendered so far */
+    int32_t drift_us;         /**< Music time minus system time since play, as of the last event */
+  } vmupro_sequence_stats_t;
+
+  /**
+   * @brief Load and compile a MIDI file
+   *
+   * @param path Full path, e.g. "/sdcard/music/title.mid"
+   * @return The sequence, or NULL if the file can't be read or isn't a
+   *         supported MIDI file
+   *
+   * @code
+   * vmupro_sequence_t *song = vmupro_sequence_new("/sdcard/music/title.mid");
+   * vmupro_synth_t *lead[4];
+   * for (int i = 0; i < 4; i++)
+   *   lead[i] = vmupro_synth_new(VMUPRO_SYNTH_SQUARE);
+   * vmupro_sequence_set_track_synths(song, 1, lead, 4);
+   * vmupro_sequence_set_looping(song, true);
+   * vmupro_sequence_play(song);
+   * @endcode
+   */
+  vmupro_sequence_t *vmupro_sequence_new(const char *path);
+
+  /**
+   * @brief Compile a MIDI file already in memory
+   *
+   * @param data File contents, not needed after the call
+   * @param size Length of data in bytes
+   * @return The sequence, or NULL if data isn't a supported MIDI file
+   */
+  vmupro_sequence_t *vmupro_sequence_new_from_memory(const void *data, size_t size);
+
+  /**
+   * @brief Stop and free a sequence
+   *
+   * Waits for the audio task to let go of the sequence, or lets go of it
+   * at once when no audio task is rendering the engine
+   * (vmupro_synth_engine_has_audio_task()), e.g. a manual engine rendered
+   * from the game loop. A manual engine rendered from a thread of your
+   * own must not be rendering meanwhile. The synths are left to the
+   * caller.
+   *
+   * @param seq Sequence, may be NULL
+   */
+  void vmupro_sequence_free(vmupro_sequence_t *seq);
+
+  /**
+   * @brief Number of tracks
+   *
+   * @param seq Sequence
+   */
+  int vmupro_sequence_get_track_count(const vmupro_sequence_t *seq);
+
+  /**
+   * @brief Play a track's notes on a set of synths
+   *
+   * Each note takes a synth that isn't sounding, else the one released
+   * longest ago, else the one whose note started first. A note that is
+   * already held retriggers its synth, and velocity 127 plays at
+   * VMUPRO_SYNTH_UNITY. The synths keep their own waveforms and
+   * envelopes, and shouldn't be played directly while the sequence plays.
+   *
+   * @param seq Sequence, which must be stopped
+   * @param track Track, from 0
+   * @param synths Synths, copied, in place of any instrument. NULL and 0 to silence the track
+   * @param count Number of synths, up to VMUPRO_SEQUENCE_MAX_TRACK_SYNTHS
+   * @return false if the sequence is playing or an argument is out of range
+   */
+  bool vmupro_sequence_set_track_synths(vmupro_sequence_t *seq, int track, vmupro_synth_t *const *synths, int count);
+
+  /**
+   * @brief Play a track's notes on a sampled instrument
+   *
+   * The instrument picks the zone and voice for each note, and counts
+   * its own steals. It can be shared by several tracks and played
+   * directly as well.
+   *
+   * @param seq Sequence, which must be stopped
+   * @param track Track, from 0
+   * @param inst Instrument, in place of the track's synths. NULL to silence the track
+   * @return false if the sequence is playing or the track is out of range
+   */
+  bool vmupro_sequence_set_track_instrument(vmupro_sequence_t *seq, int track, vmupro_instrument_t *inst);
+
+  /**
+   * @brief Most notes a track holds at once
+   *
+   * Worked out when the file is loaded: as many synths as this play the
+   * track without stealing.
+   *
+   * @param seq Sequence
+   * @param track Track, from 0
+   */
+  int vmupro_sequence_get_track_polyphony(const vmupro_sequence_t *seq, int track);
+
+  /**
+   * @brief Notes a track is holding now
+   *
+   * @param seq Sequence
+   * @param track Track, from 0
+   */
+  int vmupro_sequence_get_track_notes_active(const vmupro_sequence_t *seq, int track);
+
+  /**
+   * @brief A track's first program change
+   *
+   * The sequencer doesn't switch synths on program changes. Use this to
+   * pick the synths for a track when the sequence is loaded.
+   *
+   * @param seq Sequence
+   * @param track Track, from 0
+   * @return Program 0 to 127, or -1 if the track has none
+   */
+  int vmupro_sequence_get_track_program(const vmupro_sequence_t *seq, int track);
+
+  /**
+   * @brief Play from the start
+   *
+   * Starts the synth engine (vmupro_synth_engine_start()) if it isn't
+   * running. Does nothing if the sequence is already playing.
+   *
+   * @param seq Sequence
+   * @return false if the engine can't be started or
+   *         VMUPRO_SEQUENCE_MAX_PLAYING sequences are playing
+   */
+  bool vmupro_sequence_play(vmupro_sequence_t *seq);
+
+  /**
+   * @brief Stop playing and release held notes
+   *
+   * @param seq Sequence
+   */
+  void vmupro_sequence_stop(vmupro_sequence_t *seq);
+
+  /**
+   * @brief Start over at the end, or stop there
+   *
+   * @param seq Sequence
+   * @param loop Whether to loop
+   */
+  void vmupro_sequence_set_looping(vmupro_sequence_t *seq, bool loop);
+
+  /**
+   * @brief Whether the sequence is playing
+   *
+   * @param seq Sequence
+   */
+  bool vmupro_sequence_is_playing(const vmupro_sequence_t *seq);
+
+  /**
+   * @brief Length, from the start to the end of the longest track
+   *
+   * @param seq Sequence
+   * @return Frames at VMUPRO_SYNTH_RATE
+   */
+  uint32_t vmupro_sequence_get_length(const vmupro_sequence_t *seq);
+
+  /**
+   * @brief The compiled events
+   *
+   * @param seq Sequence
+   * @param out_count Destination for the number of events, ending with
+   *                  VMUPRO_SEQUENCE_END
+   * @return The events, owned by the sequence
+   */
+  const vmupro_sequence_event_t *vmupro_sequence_get_events(const vmupro_sequence_t *seq, uint32_t *out_count);
+
+  /**
+   * @brief Read the sequence counters
+   *
+   * @param seq Sequence
+   * @param out_stats Destination for the counters. They are updated by
+   *                  the audio task, so may be a render behind
+   */
+  void vmupro_sequence_get_stats(const vmupro_sequence_t *seq, vmupro_sequence_stats_t *out_stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,440 @@
+/**
+ * @file vmupro_synth.h
+ * @brief VMUPro Band-Limited Synthesizer
+ *
+ * Software synthesizers with the waveforms and ADSR envelope of the Lua
+ * vmupro.sound.synth API, rendered in fixed point on the pull mode audio
+ * task (vmupro_audio_pull.h).
+ *
+ * Naive square, sawtooth and triangle waves have harmonics far past
+ * 22kHz, which fold back into the audible range as inharmonic whistles
+ * on high notes. The oscillators here are band-limited with PolyBLEP
+ * (square, sawtooth and the pulse of the PO Digital model) and PolyBLAMP
+ * (triangle) corrections: a polynomial around each discontinuity, only
+ * on the one or two samples next to it, so the cost per sample stays
+ * close to the naive wave. Sine comes from an interpolated table.
+ *
+ * Each synth renders VMUPRO_SYNTH_BLOCK_FRAMES at a time: the envelope,
+ * volume and oscillator settings are worked out once per block and the
+ * inner loop only steps the phase and ramps the gain. This is what
+ * allows VMUPRO_SYNTH_MAX synths, twice the Lua limit. Each synth counts
+ * the time spent rendering it (vmupro_synth_get_stats()), so expensive
+ * voices can be found.
+ *
+ * | Lua                                  | C                               |
+ * |--------------------------------------|---------------------------------|
+ * | vmupro.sound.synth.new(waveform)     | vmupro_synth_new()              |
+ * | vmupro.sound.synth.free(s)           | vmupro_synth_free()             |
+ * | vmupro.sound.synth.setWaveform(...)  | vmupro_synth_set_waveform()     |
+ * | vmupro.sound.synth.setAttack(...)    | vmupro_synth_set_attack()       |
+ * | vmupro.sound.synth.setDecay(...)     | vmupro_synth_set_decay()        |
+ * | vmupro.sound.synth.setSustain(...)   | vmupro_synth_set_sustain()      |
+ * | vmupro.sound.synth.setRelease(...)   | vmupro_synth_set_release()      |
+ * | vmupro.sound.synth.setVolume(...)    | vmupro_synth_set_volume()       |
+ * | vmupro.sound.synth.getVolume(s)      | vmupro_synth_get_volume()       |
+ * | vmupro.sound.synth.playNote(...)     | vmupro_synth_play_note()        |
+ * | vmupro.sound.synth.playMIDINote(...) | vmupro_synth_play_midi_note()   |
+ * | vmupro.sound.synth.noteOff(s)        | vmupro_synth_note_off()         |
+ * | vmupro.sound.synth.stop(s)           | vmupro_synth_stop()             |
+ * | vmupro.sound.synth.isPlaying(s)      | vmupro_synth_is_playing()       |
+ * | vmupro.sound.synth.setParameter(...) | vmupro_synth_set_parameter()    |
+ * | vmupro.sound.synth.getParameter(...) | vmupro_synth_get_parameter()    |
+ *
+ * Times are in milliseconds, frequencies in 16.16 fixed point Hz, and
+ * levels, volumes and parameters 8.8 fixed point (VMUPRO_SYNTH_UNITY is
+ * 1.0).
+ *
+ * @note Call the functions in this header from one thread, normally the
+ *       game loop. Only the rendering happens on the audio task
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-08-10
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Most synths that can exist at once */
+#define VMUPRO_SYNTH_MAX 32
+
+/** Output rate in Hz */
+#define VMUPRO_SYNTH_RATE 44100
+
+/** Frames rendered per synth between envelope and setting updates */
+#define VMUPRO_SYNTH_BLOCK_FRAMES 32
+
+/** Pull mode period of vmupro_synth_engine_start() */
+#define VMUPRO_SYNTH_PERIOD_FRAMES 256
+
+/** 1.0 in 8.8 fixed point. Volumes go up to 4 * VMUPRO_SYNTH_UNITY */
+#define VMUPRO_SYNTH_UNITY 256
+
+/** Highest note frequency, in Hz. Higher frequencies are clamped */
+#define VMUPRO_SYNTH_MAX_FREQUENCY 20000
+
+  /**
+   * @brief Waveforms, with the values of the Lua vmupro.sound.kWave* constants
+   */
+  typedef enum
+  {
+    VMUPRO_SYNTH_SQUARE = 0,  /**< Square wave */
+    VMUPRO_SYNTH_TRIANGLE,    /**< Triangle wave */
+    VMUPRO_SYNTH_SINE,        /**< Sine wave */
+    VMUPRO_SYNTH_NOISE,       /**< White noise, redrawn 16 times per cycle of the note */
+    VMUPRO_SYNTH_SAWTOOTH,    /**< Sawtooth wave */
+    VMUPRO_SYNTH_PO_PHASE,    /**< Phase distortion: parameter 0 bends the sine towards a sawtooth, 1 adds the octave */
+    VMUPRO_SYNTH_PO_DIGITAL,  /**< Pulse: parameter 0 narrows the pulse, 1 adds a square one octave down */
+    VMUPRO_SYNTH_PO_VOSIM,    /**< VOSIM: parameter 0 raises the formant 1 to 8 times the note, 1 shortens its decay */
+    VMUPRO_SYNTH_WAVEFORM_COUNT
+  } vmupro_synth_waveform_t;
+
+  /**
+   * @brief Synth handle, from vmupro_synth_new()
+   */
+  typedef struct vmupro_synth vmupro_synth_t;
+
+  /**
+   * @brief Cost counters for one synth, kept since vmupro_synth_new()
+   */
+  typedef struct
+  {
+    uint32_t notes;     /**< Notes played */
+    uint32_t blocks;    /**< Blocks of up to VMUPRO_SYNTH_BLOCK_FRAMES rendered */
+    uint64_t frames;    /**< Frames rendered */
+    uint64_t render_us; /**< Time spent rendering */
+  } vmupro_synth_stats_t;
+
+  /**
+   * @brief Engine counters, kept since vmupro_synth_engine_start()
+   */
+  typedef struct
+  {
+    uint32_t renders;        /**< Stretches rendered: pull mode periods, split at scheduled events */
+    uint32_t clipped;        /**< Output samples that saturated */
+    uint8_t active_synths;   /**< Synths sounding in the last render */
+    uint8_t peak_synths;     /**< Most synths sounding in one render */
+    uint32_t last_render_us; /**< Time of the last render */
+    uint32_t max_render_us;  /**< Slowest render */
+    uint64_t total_us;       /**< Time spent rendering */
+    uint64_t frames;         /**< Frames rendered */
+  } vmupro_synth_engine_stats_t;
+
+  /**
+   * @brief Start listen mode and render synths on the audio task
+   *
+   * @return true if the engine is running
+   */
+  bool vmupro_synth_engine_start(void);
+
+  /**
+   * @brief Start the engine without an audio task
+   *
+   * Nothing is rendered until vmupro_synth_engine_render() is called, and
+   * listen mode is left to the app. Use this to play synths alongside
+   * other audio, e.g. the mixer, from one pull mode callback.
+   *
+   * @return true if the engine is running
+   */
+  bool vmupro_synth_engine_start_manual(void);
+
+  /**
+   * @brief Render the next frames of all synths into a buffer
+   *
+   * Only for an engine started with vmupro_synth_engine_start_manual(),
+   * otherwise the buffer is filled with silence. The output doesn't depend
+   * on how the frames are split between calls.
+   *
+   * @param stereo Interleaved left/right destination
+   * @param frames Stereo frames to render
+   */
+  void vmupro_synth_engine_render(int16_t *stereo, int frames);
+
+  /**
+   * @brief Silence all synths and stop the audio task and listen mode
+   *
+   * Synths stay allocated and keep their settings.
+   */
+  void vmupro_synth_engine_stop(void);
+
+  /**
+   * @brief Whether the engine has been started
+   */
+  bool vmupro_synth_engine_is_running(void);
+
+  /**
+   * @brief Whether an audio task may be rendering the engine
+   *
+   * True while the engine runs and the pull mode task (vmupro_audio_pull.h)
+   * renders it: the engine's own task, or an app callback that has called
+   * vmupro_synth_engine_render() since the task started. A task playing
+   * other audio doesn't count. Otherwise anything waiting on a render
+   * would wait forever, so the sequencer lets go of its sequences at once.
+   */
+  bool vmupro_synth_engine_has_audio_task(void);
+
+  /**
+   * @brief Read the engine counters
+   *
+   * @param out_stats Destination for the counters
+   */
+  void vmupro_synth_engine_get_stats(vmupro_synth_engine_stats_t *out_stats);
+
+  /**
+   * @brief Called on the audio task before each stretch of rendering
+   *
+   * The engine asks before rendering anything, and again after as many
+   * frames as the scheduler returned, so whatever the scheduler does
+   * with vmupro_synth_render_note_on() and vmupro_synth_render_note_off()
+   * takes effect on exactly the frame it is called for. Used by
+   * vmupro_sequence.h.
+   *
+   * @param frame Frames rendered since the engine was first started
+   * @param max_frames Frames the engine is about to render
+   * @param user Pointer passed to vmupro_synth_engine_set_scheduler()
+   * @return Frames to render before calling again, 1 to max_frames
+   */
+  typedef int (*vmupro_synth_scheduler_t)(uint64_t frame, int max_frames, void *user);
+
+  /**
+   * @brief Install the scheduler, NULL to remove it
+   *
+   * There is one scheduler. vmupro_sequence_play() installs its own, so
+   * don't use both.
+   *
+   * @param scheduler Called on the audio task, before each stretch of rendering
+   * @param user Passed to scheduler
+   */
+  void vmupro_synth_engine_set_scheduler(vmupro_synth_scheduler_t scheduler, void *user);
+
+  /**
+   * @brief Called on the audio task to add more sound to each stretch
+   *
+   * Called after the synths have rendered, with the same frames. Adds
+   * into the engine's stereo accumulator, where a 16-bit sample at
+   * VMUPRO_SYNTH_UNITY gain is sample * VMUPRO_SYNTH_UNITY. Used by
+   * vmupro_instrument.h.
+   *
+   * @param acc Interleaved left/right accumulator, 2 * frames values
+   * @param frames Frames in this stretch
+   * @param user Pointer passed to vmupro_synth_engine_set_source()
+   */
+  typedef void (*vmupro_synth_source_t)(int32_t *acc, int frames, void *user);
+
+  /**
+   * @brief Install the source, NULL to remove it
+   *
+   * There is one source. vmupro_instrument_new() installs its own.
+   *
+   * @param source Called on the audio task, after the synths of each stretch
+   * @param user Passed to source
+   */
+  void vmupro_synth_engine_set_source(vmupro_synth_source_t source, void *user);
+
+  /**
+   * @brief Start a note from a scheduler, on the frame being scheduled
+   *
+   * Only call from a vmupro_synth_scheduler_t. The note is held until
+   * vmupro_synth_render_note_off().
+   *
+   * @param synth Synth
+   * @param frequency 16.16 fixed point Hz
+   * @param velocity 8.8 fixed point, 0 to VMUPRO_SYNTH_UNITY
+   */
+  void vmupro_synth_render_note_on(vmupro_synth_t *synth, uint32_t frequency, uint16_t velocity);
+
+  /**
+   * @brief Release a note from a scheduler, on the frame being scheduled
+   *
+   * Only call from a vmupro_synth_scheduler_t.
+   *
+   * @param synth Synth
+   */
+  void vmupro_synth_render_note_off(vmupro_synth_t *synth);
+
+  /**
+   * @brief Whether a synth is sounding, as the audio task sees it
+   *
+   * Only call from a vmupro_synth_scheduler_t.
+   *
+   * @param synth Synth
+   */
+  bool vmupro_synth_render_is_sounding(const vmupro_synth_t *synth);
+
+  /**
+   * @brief Create a synth
+   *
+   * Envelope: no attack or decay, full sustain, no release. Volume 1.0,
+   * parameters 0.5.
+   *
+   * @param waveform Waveform to play
+   * @return The synth, or NULL if VMUPRO_SYNTH_MAX synths exist
+   *
+   * @code
+   * vmupro_synth_engine_start();
+   * vmupro_synth_t *lead = vmupro_synth_new(VMUPRO_SYNTH_SAWTOOTH);
+   * vmupro_synth_set_release(lead, 300);
+   * vmupro_synth_play_midi_note(lead, 60, VMUPRO_SYNTH_UNITY, 500);
+   * @endcode
+   */
+  vmupro_synth_t *vmupro_synth_new(vmupro_synth_waveform_t waveform);
+
+  /**
+   * @brief Silence a synth and release it
+   *
+   * @param synth Synth, may be NULL
+   */
+  void vmupro_synth_free(vmupro_synth_t *synth);
+
+  /**
+   * @brief Change the waveform, also of a note already playing
+   *
+   * @param synth Synth
+   * @param waveform New waveform
+   */
+  void vmupro_synth_set_waveform(vmupro_synth_t *synth, vmupro_synth_waveform_t waveform);
+
+  /**
+   * @brief Set the time to rise from silence to full level
+   *
+   * @param synth Synth
+   * @param ms Attack time
+   */
+  void vmupro_synth_set_attack(vmupro_synth_t *synth, uint32_t ms);
+
+  /**
+   * @brief Set the time to fall from full level to the sustain level
+   *
+   * @param synth Synth
+   * @param ms Decay time
+   */
+  void vmupro_synth_set_decay(vmupro_synth_t *synth, uint32_t ms);
+
+  /**
+   * @brief Set the level held until the note ends
+   *
+   * @param synth Synth
+   * @param level 8.8 fixed point, 0 to VMUPRO_SYNTH_UNITY
+   */
+  void vmupro_synth_set_sustain(vmupro_synth_t *synth, uint16_t level);
+
+  /**
+   * @brief Set the time to fall from the sustain level to silence
+   *
+   * @param synth Synth
+   * @param ms Release time
+   */
+  void vmupro_synth_set_release(vmupro_synth_t *synth, uint32_t ms);
+
+  /**
+   * @brief Set the stereo volume, also of a note already playing
+   *
+   * @param synth Synth
+   * @param left Left volume, 8.8 fixed point
+   * @param right Right volume, 8.8 fixed point
+   */
+  void vmupro_synth_set_volume(vmupro_synth_t *synth, uint16_t left, uint16_t right);
+
+  /**
+   * @brief Get the stereo volume
+   *
+   * @param synth Synth
+   * @param left Left volume, 8.8 fixed point, may be NULL
+   * @param right Right volume, 8.8 fixed point, may be NULL
+   */
+  void vmupro_synth_get_volume(const vmupro_synth_t *synth, uint16_t *left, uint16_t *right);
+
+  /**
+   * @brief Play a note
+   *
+   * A note played while another sounds takes over from its current level
+   * and phase, without a click.
+   *
+   * @param synth Synth
+   * @param frequency 16.16 fixed point Hz, e.g. 440 << 16
+   * @param velocity 8.8 fixed point, 0 to VMUPRO_SYNTH_UNITY
+   * @param length_ms Time until the release starts, negative to hold until vmupro_synth_note_off()
+   * @return false if the engine isn't running
+   */
+  bool vmupro_synth_play_note(vmupro_synth_t *synth, uint32_t frequency, uint16_t velocity, int32_t length_ms);
+
+  /**
+   * @brief Play a MIDI note, 69 being A4 at 440Hz
+   *
+   * @param synth Synth
+   * @param note MIDI note number, 0 to 127
+   * @param velocity 8.8 fixed point, 0 to VMUPRO_SYNTH_UNITY
+   * @param length_ms Time until the release starts, negative to hold until vmupro_synth_note_off()
+   * @return false if the engine isn't running or note is out of range
+   */
+  bool vmupro_synth_play_midi_note(vmupro_synth_t *synth, int note, uint16_t velocity, int32_t length_ms);
+
+  /**
+   * @brief 16.16 fixed point frequency of a MIDI note
+   *
+   * @param note MIDI note number, 0 to 127
+   */
+  uint32_t vmupro_synth_midi_frequency(int note);
+
+  /**
+   * @brief Start the release of the current note
+   *
+   * @param synth Synth
+   */
+  void vmupro_synth_note_off(vmupro_synth_t *synth);
+
+  /**
+   * @brief Silence the synth at once, skipping the release
+   *
+   * The level falls to zero over one block rather than in a single
+   * sample, which would click.
+   *
+   * @param synth Synth
+   */
+  void vmupro_synth_stop(vmupro_synth_t *synth);
+
+  /**
+   * @brief Whether a note is sounding, including its release
+   *
+   * @param synth Synth
+   */
+  bool vmupro_synth_is_playing(const vmupro_synth_t *synth);
+
+  /**
+   * @brief Set a PO waveform parameter
+   *
+   * @param synth Synth
+   * @param index 0 or 1
+   * @param value 8.8 fixed point, 0 to VMUPRO_SYNTH_UNITY
+   */
+  void vmupro_synth_set_parameter(vmupro_synth_t *synth, int index, uint16_t value);
+
+  /**
+   * @brief Get a PO waveform parameter
+   *
+   * @param synth Synth
+   * @param index 0 or 1
+   * @return 8.8 fixed point value
+   */
+  uint16_t vmupro_synth_get_parameter(const vmupro_synth_t *synth, int index);
+
+  /**
+   * @brief Read a synth's cost counters
+   *
+   * @param synth Synth
+   * @param out_stats Destination for the counters. They are updated by the
+   *                  audio task, so fields may come from adjacent renders
+   */
+  void vmupro_synth_get_stats(const vmupro_synth_t *synth, vmupro_synth_stats_t *out_stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,207 @@
+/**
+ * @file vmupro_text.h
+ * @brief VMUPro Glyph Cache and Text Runs
+ *
+ * vmupro_draw_text() rasterizes every glyph on every call and always fills
+ * the character cells with a background colour. Text that is redrawn each
+ * frame, such as a score or an FPS counter, can instead be drawn from a
+ * glyph cache: each glyph of a font is rasterized once into 4bpp
+ * anti-aliasing coverage, and drawing only blends the inked pixels over
+ * whatever is already on screen, so text has a transparent background.
+ *
+ * On top of the cache, a text run lays a string out once (glyph lookups and
+ * x offsets) so that a label which rarely changes is only blitted each
+ * frame, and vmupro_text_draw_batch() draws a whole HUD in one call.
+ * Cached metrics also replace vmupro_calc_text_length() for layout.
+ *
+ * In partial update mode the drawn text is only marked dirty when the SDK
+ * is built with VMUPRO_FIRMWARE_DIRTY_RECTS, which needs firmware newer
+ * than 2.0.0 (see vmupro_mark_dirty_rect()).
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-07-30
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vmupro_fonts.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Maximum number of glyphs in a text run */
+#define VMUPRO_TEXT_RUN_MAX 64
+
+  /**
+   * @brief Metrics of one cached glyph
+   */
+  typedef struct
+  {
+    uint8_t advance; /**< Horizontal advance in pixels */
+    uint8_t top;     /**< First row with any coverage */
+    uint8_t bottom;  /**< One past the last row with coverage, equal to top if the glyph is blank */
+  } vmupro_glyph_t;
+
+  /**
+   * @brief Cached glyphs of one font over a character range
+   *
+   * Filled in by vmupro_glyph_cache_init(). The glyph table and the
+   * coverage live in the arena passed to init, which must stay valid for
+   * as long as the cache is used.
+   */
+  typedef struct
+  {
+    vmupro_font_id_t font;  /**< Font the glyphs were rasterized from */
+    uint8_t first;          /**< First cached character */
+    uint8_t last;           /**< Last cached character */
+    uint8_t height;         /**< Line height in pixels */
+    uint8_t stride;         /**< Bytes per coverage row */
+    uint16_t glyph_bytes;   /**< Bytes of coverage per glyph */
+    vmupro_glyph_t *glyphs; /**< last - first + 1 glyph metrics */
+    uint8_t *coverage;      /**< 4bpp coverage, 0-15, left pixel in the high nibble */
+  } vmupro_glyph_cache_t;
+
+  /**
+   * @brief A string laid out against a glyph cache, ready to blit
+   */
+  typedef struct
+  {
+    const vmupro_glyph_cache_t *cache; /**< Cache the run was laid out with */
+    uint16_t width;                    /**< Total advance in pixels */
+    uint8_t count;                     /**< Inked glyphs in the run */
+    uint8_t glyph[VMUPRO_TEXT_RUN_MAX];  /**< Glyph index in the cache */
+    int16_t x[VMUPRO_TEXT_RUN_MAX];      /**< Offset of each glyph from the run's left edge */
+  } vmupro_text_run_t;
+
+  /**
+   * @brief One string of a vmupro_text_draw_batch() call
+   */
+  typedef struct
+  {
+    const char *text; /**< Null-terminated string */
+    int x;            /**< Left edge */
+    int y;            /**< Top edge */
+    uint16_t color;   /**< Text colour (RGB565) */
+  } vmupro_text_item_t;
+
+  /**
+   * @brief Arena size needed to cache a font over a character range
+   *
+   * @param font_id Font to cache
+   * @param first First character, e.g. ' '
+   * @param last Last character, e.g. '~'
+   * @return Size in bytes, or 0 if the range is empty
+   */
+  uint32_t vmupro_glyph_cache_size(vmupro_font_id_t font_id, uint8_t first, uint8_t last);
+
+  /**
+   * @brief Rasterize a font into a glyph cache
+   *
+   * Each glyph is drawn white on black with vmupro_draw_text() into the
+   * top-left corner of the back buffer and read back as coverage. The
+   * pixels there are restored afterwards, and the font is left selected.
+   * Call it while loading, not while a display list is being recorded
+   * or with a colour window set.
+   *
+   * @param cache Cache to fill
+   * @param font_id Font to cache
+   * @param first First character
+   * @param last Last character
+   * @param arena Memory for the glyphs, at least vmupro_glyph_cache_size() bytes
+   * @param arena_size Size of arena in bytes
+   * @return true on success, false if arena is too small or the range is empty
+   *
+   * @code
+   * static uint8_t hud_glyphs[4096];
+   * vmupro_glyph_cache_t hud_font;
+   * vmupro_glyph_cache_init(&hud_font, VMUPRO_FONT_QUANTICO_18x20, ' ', '~', hud_glyphs, sizeof(hud_glyphs));
+   * @endcode
+   */
+  bool vmupro_glyph_cache_init(vmupro_glyph_cache_t *cache, vmupro_font_id_t font_id, uint8_t first, uint8_t last,
+                               void *arena, uint32_t arena_size);
+
+  /**
+   * @brief Width of a string in cached glyphs
+   *
+   * The cached equivalent of vmupro_calc_text_length(), without walking
+   * the font. Characters outside the cached range count as 0.
+   *
+   * @param cache Glyph cache
+   * @param text Null-terminated string
+   * @return Width in pixels
+   */
+  int vmupro_text_width(const vmupro_glyph_cache_t *cache, const char *text);
+
+  /**
+   * @brief Draw a string from a glyph cache with a transparent background
+   *
+   * Only inked pixels are written, blended over the back buffer by their
+   * coverage. Characters outside the cached range are skipped.
+   *
+   * @param cache Glyph cache
+   * @param text Null-terminated string
+   * @param x Left edge
+   * @param y Top edge
+   * @param color Text colour (RGB565)
+   * @return Width of the string in pixels
+   *
+   * @note Clipped to the screen. The colour window is not applied
+   */
+  int vmupro_text_draw(const vmupro_glyph_cache_t *cache, const char *text, int x, int y, uint16_t color);
+
+  /**
+   * @brief Lay out a string once for repeated drawing
+   *
+   * @param run Run to fill
+   * @param cache Glyph cache, must outlive the run
+   * @param text Null-terminated string
+   * @return false if the string had more than VMUPRO_TEXT_RUN_MAX inked
+   *         glyphs and was cut short
+   */
+  bool vmupro_text_run_set(vmupro_text_run_t *run, const vmupro_glyph_cache_t *cache, const char *text);
+
+  /**
+   * @brief Draw a laid out text run with a transparent background
+   *
+   * @param run Run filled by vmupro_text_run_set()
+   * @param x Left edge
+   * @param y Top edge
+   * @param color Text colour (RGB565)
+   *
+   * @code
+   * vmupro_text_run_t title;
+   * vmupro_text_run_set(&title, &hud_font, "PAUSED");
+   * ...
+   * vmupro_text_run_draw(&title, (240 - title.width) / 2, 100, VMUPRO_COLOR_WHITE);
+   * @endcode
+   */
+  void vmupro_text_run_draw(const vmupro_text_run_t *run, int x, int y, uint16_t color);
+
+  /**
+   * @brief Draw several strings from one glyph cache
+   *
+   * @param cache Glyph cache
+   * @param items Strings with their positions and colours
+   * @param count Number of items
+   *
+   * @code
+   * vmupro_snprintf(score, sizeof(score), "%06d", player_score);
+   * vmupro_snprintf(fps, sizeof(fps), "%d FPS", frames_per_second);
+   * const vmupro_text_item_t hud[] = {
+   *     {score, 4, 4, VMUPRO_COLOR_WHITE},
+   *     {fps, 180, 4, VMUPRO_COLOR_YELLOW},
+   * };
+   * vmupro_text_draw_batch(&hud_font, hud, 2);
+   * @endcode
+   */
+  void vmupro_text_draw_batch(const vmupro_glyph_cache_t *cache, const vmupro_text_item_t *items, int count);
+
+#ifdef __cplusplus
+}
+#endif
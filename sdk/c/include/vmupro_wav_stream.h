@@ -0,0 +1,218 @@
+/**
+ * @file vmupro_wav_stream.h
+ * @brief VMUPro Streaming WAV Playback
+ *
+ * vmupro_sound_sample_new() loads a whole file into memory, which is fine
+ * for sound effects but takes megabytes for a music track. A WAV stream
+ * keeps two read buffers and decodes 16-bit PCM, 8-bit PCM or IMA ADPCM
+ * from them as it plays, so a multi-minute track needs a few KB.
+ *
+ * The work is split in two. vmupro_wav_stream_update(), called from the
+ * app loop, refills whichever buffer has been played out with one SD
+ * read at a 512-byte aligned offset (the packer pads resources to 512
+ * bytes, so these line up with the card's sectors). The audio task
+ * decodes from the other buffer meanwhile, converting the file's rate to
+ * 44.1kHz stereo with a resampler. Each buffer has to last longer than one
+ * trip round the app loop: the default 4KB holds 23ms of 44.1kHz stereo
+ * PCM or 93ms of ADPCM.
+ *
+ * vmupro_wav_stream_play() plays a stream on its own through pull mode.
+ * To play music under mixer sound effects, start the mixer with
+ * vmupro_mixer_start_manual() and add vmupro_wav_stream_read() to
+ * vmupro_mixer_render() in your own pull mode callback.
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-08-08
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vmupro_resampler.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Reads start on, and buffers are a multiple of, this many bytes */
+#define VMUPRO_WAV_STREAM_ALIGN 512
+
+/** Smallest and largest read buffer */
+#define VMUPRO_WAV_STREAM_MIN_BUFFER 512
+#define VMUPRO_WAV_STREAM_MAX_BUFFER 65536
+
+  /**
+   * @brief Sample encodings that can be streamed
+   */
+  typedef enum
+  {
+    VMUPRO_WAV_PCM16 = 0, /**< 16-bit signed PCM */
+    VMUPRO_WAV_PCM8,      /**< 8-bit unsigned PCM */
+    VMUPRO_WAV_IMA_ADPCM, /**< 4-bit IMA (DVI) ADPCM, WAV format 0x11 */
+  } vmupro_wav_encoding_t;
+
+  /**
+   * @brief Opaque stream handle
+   */
+  typedef struct vmupro_wav_stream vmupro_wav_stream_t;
+
+  /**
+   * @brief Stream settings
+   */
+  typedef struct
+  {
+    uint32_t buffer_bytes;             /**< Size of each of the two read buffers, rounded up to 512 bytes */
+    vmupro_resample_quality_t quality; /**< Conversion quality when the file isn't 44.1kHz */
+    bool loop;                         /**< Start over at the end of the data */
+  } vmupro_wav_stream_config_t;
+
+  /**
+   * @brief What vmupro_wav_stream_open() found in the file
+   */
+  typedef struct
+  {
+    vmupro_wav_encoding_t encoding; /**< Sample encoding */
+    uint8_t channels;               /**< 1 or 2 */
+    uint32_t sample_rate;           /**< Rate in Hz */
+    uint32_t frames;                /**< Length in frames at sample_rate */
+    uint32_t data_offset;           /**< File offset of the first sample byte */
+    uint32_t data_bytes;            /**< Length of the sample data */
+    uint16_t block_align;           /**< Bytes per frame (PCM) or per ADPCM block */
+  } vmupro_wav_stream_info_t;
+
+  /**
+   * @brief Stream counters
+   */
+  typedef struct
+  {
+    uint32_t reads;          /**< SD reads made */
+    uint32_t bytes_read;     /**< Bytes read */
+    uint32_t last_read_us;   /**< Duration of the last read */
+    uint32_t max_read_us;    /**< Slowest read */
+    uint32_t frames_decoded; /**< Frames decoded, at the file's rate */
+    uint32_t underruns;      /**< Times the decoder found both buffers played out */
+    uint32_t loops;          /**< Times the data started over */
+  } vmupro_wav_stream_stats_t;
+
+  /**
+   * @brief Default settings: 2 x 4KB buffers, 8 tap conversion, no loop
+   */
+  static inline vmupro_wav_stream_config_t vmupro_wav_stream_defaults(void)
+  {
+    vmupro_wav_stream_config_t config = {4096, VMUPRO_RESAMPLE_SINC_8, false};
+    return config;
+  }
+
+  /**
+   * @brief Open a WAV file and fill both buffers
+   *
+   * @param path Full path, e.g. "/sdcard/music/title.wav"
+   * @param config Settings, NULL for vmupro_wav_stream_defaults()
+   * @return The stream, or NULL if the file can't be read, isn't a
+   *         supported WAV or memory runs out
+   *
+   * @code
+   * vmupro_wav_stream_t *music = vmupro_wav_stream_open("/sdcard/music/title.wav", NULL);
+   * vmupro_wav_stream_set_loop(music, true);
+   * vmupro_wav_stream_play(music);
+   * // each frame
+   * vmupro_wav_stream_update(music);
+   * @endcode
+   */
+  vmupro_wav_stream_t *vmupro_wav_stream_open(const char *path, const vmupro_wav_stream_config_t *config);
+
+  /**
+   * @brief Stop playback and free the stream
+   *
+   * @param stream Stream from vmupro_wav_stream_open(), may be NULL
+   */
+  void vmupro_wav_stream_close(vmupro_wav_stream_t *stream);
+
+  /**
+   * @brief Read the stream's format
+   *
+   * @param stream Stream
+   * @param out_info Destination for the format
+   */
+  void vmupro_wav_stream_get_info(const vmupro_wav_stream_t *stream, vmupro_wav_stream_info_t *out_info);
+
+  /**
+   * @brief Refill played out buffers from the file
+   *
+   * Call regularly from the app loop, at least once per buffer's worth of
+   * playback. Does nothing when both buffers are full.
+   *
+   * @param stream Stream
+   * @return false once the stream has played to the end or a read failed
+   */
+  bool vmupro_wav_stream_update(vmupro_wav_stream_t *stream);
+
+  /**
+   * @brief Decode the next frames as 44.1kHz stereo
+   *
+   * Always writes frames frames: past the end of the data, or when the
+   * buffers have run dry, the rest is silence. Only one thread at a time
+   * may read, normally the audio task.
+   *
+   * @param stream Stream
+   * @param stereo Destination, interleaved left/right
+   * @param frames Frames to write
+   * @return Frames of audio written, the rest is silence
+   */
+  int vmupro_wav_stream_read(vmupro_wav_stream_t *stream, int16_t *stereo, int frames);
+
+  /**
+   * @brief Play the stream on its own through pull mode
+   *
+   * @param stream Stream
+   * @return false if pull mode is already in use
+   */
+  bool vmupro_wav_stream_play(vmupro_wav_stream_t *stream);
+
+  /**
+   * @brief Stop playback started with vmupro_wav_stream_play()
+   *
+   * @param stream Stream
+   */
+  void vmupro_wav_stream_stop(vmupro_wav_stream_t *stream);
+
+  /**
+   * @brief Whether the stream has played to the end
+   *
+   * Never true for a looping stream.
+   *
+   * @param stream Stream
+   */
+  bool vmupro_wav_stream_is_finished(const vmupro_wav_stream_t *stream);
+
+  /**
+   * @brief Loop at the end of the data, or stop there
+   *
+   * @param stream Stream
+   * @param loop Whether to loop
+   */
+  void vmupro_wav_stream_set_loop(vmupro_wav_stream_t *stream, bool loop);
+
+  /**
+   * @brief Set the playback volume
+   *
+   * @param stream Stream
+   * @param volume 8.8 fixed point, 256 plays as recorded, up to 1024
+   */
+  void vmupro_wav_stream_set_volume(vmupro_wav_stream_t *stream, uint16_t volume);
+
+  /**
+   * @brief Read the stream counters
+   *
+   * @param stream Stream
+   * @param out_stats Destination for the counters
+   */
+  void vmupro_wav_stream_get_stats(const vmupro_wav_stream_t *stream, vmupro_wav_stream_stats_t *out_stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,132 @@
+// sdk/c/src/vmupro_audio_internal.h
+//
+// Helpers shared by the audio sources (mixer, synths, instruments, WAV
+// streams and the resampler), internal to the SDK sources
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "vmupro_utils.h"
+
+//
+// Pull mode audio task (vmupro_audio_pull.c)
+//
+// Which engines the running task renders: an engine's own task, or an
+// app's pull mode callback rendering a manual engine. Waiting for a render
+// only makes sense for those, any other engine is rendered by the game
+// loop or not at all. Cleared whenever the task starts or stops.
+//
+
+#define AUDIO_ENGINE_MIXER 0x01
+#define AUDIO_ENGINE_SYNTH 0x02
+
+// Records the engine as rendered by the task just started for it
+void vmupro_audio_pull_claim(uint32_t engine);
+
+// Records the engine if called on the task, from each render
+void vmupro_audio_pull_note_render(uint32_t engine);
+
+// Whether the running task renders the engine
+bool vmupro_audio_pull_renders(uint32_t engine);
+
+// Little endian fields of RIFF/WAV headers
+static inline uint32_t Read32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint16_t Read16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline int16_t Saturate(int32_t v)
+{
+  if (v > 32767)
+    return 32767;
+  if (v < -32768)
+    return -32768;
+  return (int16_t)v;
+}
+
+//
+// Queue
+//
+// Single producer/single consumer ring of fixed size items, e.g. commands
+// from the game thread to the audio task. Neither side takes a lock: the
+// producer only moves head and the consumer only moves tail.
+//
+
+typedef struct
+{
+  void *slots;           // count items of size bytes
+  uint32_t size;
+  uint32_t count;
+  _Atomic uint32_t head; // next item the producer writes
+  _Atomic uint32_t tail; // next item the consumer reads
+} Queue;
+
+// Static initializer for a queue over an array
+#define QUEUE_OF(array) {(array), sizeof((array)[0]), sizeof(array) / sizeof((array)[0]), 0, 0}
+
+static inline void QueueInit(Queue *q, void *slots, uint32_t size, uint32_t count)
+{
+  q->slots = slots;
+  q->size = size;
+  q->count = count;
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+}
+
+static inline void *QueueAt(const Queue *q, uint32_t index)
+{
+  return (uint8_t *)q->slots + (size_t)(index % q->count) * q->size;
+}
+
+// Producer side, false if the queue is full
+static inline bool QueuePost(Queue *q, const void *item)
+{
+  uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+  if (head - tail == q->count)
+    return false;
+  memcpy(QueueAt(q, head), item, q->size);
+  atomic_store_explicit(&q->head, head + 1, memory_order_release);
+  return true;
+}
+
+// Blocks only in the unlikely case that the queue is full while draining()
+// says the audio task is emptying it. Without the audio task nothing would
+// make room, so the item is dropped and false returned.
+static inline bool QueuePostWait(Queue *q, const void *item, bool (*draining)(void))
+{
+  while (!QueuePost(q, item))
+  {
+    if (!draining())
+      return false;
+    vmupro_sleep_ms(1);
+  }
+  return true;
+}
+
+// Consumer side: items tail to the returned head are ready, hand the new
+// tail back with QueueConsumed() once they have been used
+static inline uint32_t QueuePending(Queue *q, uint32_t *tail)
+{
+  *tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  return atomic_load_explicit(&q->head, memory_order_acquire);
+}
+
+static inline void QueueConsumed(Queue *q, uint32_t tail)
+{
+  atomic_store_explicit(&q->tail, tail, memory_order_release);
+}
+
+// Drops every pending item, only while nothing consumes the queue
+static inline void QueueClear(Queue *q)
+{
+  atomic_store(&q->tail, atomic_load(&q->head));
+}
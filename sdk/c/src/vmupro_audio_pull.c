@@ -0,0 +1,179 @@
+// sdk/c/src/vmupro_audio_pull.c
+//
+// Callback (pull) audio on its own task, see vmupro_audio_pull.h
+// The task tops the ring buffer up to periods * period_frames, one
+// callback per period, then sleeps until a period has played out.
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "vmupro_audio.h"
+#include "vmupro_utils.h"
+#include "vmupro_audio_pull.h"
+#include "vmupro_audio_internal.h"
+
+#define OUTPUT_RATE 44100
+#define TASK_STACK 8192
+
+static pthread_t pullTask;
+static atomic_bool running = false;
+static vmupro_audio_pull_config_t pullConfig;
+static vmupro_audio_fill_t pullFill;
+static void *pullUser;
+static vmupro_audio_pull_stats_t pullStats;
+static int16_t periodBuf[VMUPRO_AUDIO_PULL_MAX_PERIOD * 2];
+// AUDIO_ENGINE_* rendered by the task since it started
+static _Atomic uint32_t taskEngines = 0;
+static _Thread_local bool onTask = false;
+
+static inline uint32_t FramesToUs(uint32_t frames)
+{
+  return (uint32_t)((uint64_t)frames * 1000000ull / OUTPUT_RATE);
+}
+
+// vmupro_get_ringbuffer_fill_state() counts 16 bit samples, two per
+// stereo frame, the task counts frames
+static void RingFillFrames(uint32_t *filled, uint32_t *size)
+{
+  vmupro_get_ringbuffer_fill_state(filled, size);
+  if (pullConfig.stereo)
+  {
+    *filled /= 2;
+    *size /= 2;
+  }
+}
+
+static void SleepUs(uint32_t us)
+{
+  if (us >= 1000)
+    vmupro_sleep_ms(us / 1000);
+  else
+    vmupro_delay_us(us);
+}
+
+static void *PullTask(void *arg)
+{
+  (void)arg;
+  onTask = true;
+  uint32_t period = pullConfig.period_frames;
+  uint32_t target = period * pullConfig.periods;
+  uint32_t periodUs = FramesToUs(period);
+  vmupro_stereo_mode_t mode = pullConfig.stereo ? VMUPRO_AUDIO_STEREO : VMUPRO_AUDIO_MONO;
+  int samples = (int)(pullConfig.stereo ? period * 2 : period);
+  bool primed = false;
+
+  while (atomic_load(&running))
+  {
+    uint32_t filled = 0, size = 0;
+    RingFillFrames(&filled, &size);
+    if (primed && filled == 0)
+      pullStats.underruns++;
+
+    while (filled + period <= target && atomic_load(&running))
+    {
+      uint64_t start = vmupro_get_time_us();
+      pullFill(periodBuf, (int)period, pullUser);
+      uint32_t us = (uint32_t)(vmupro_get_time_us() - start);
+      vmupro_audio_add_stream_samples(periodBuf, samples, mode, pullConfig.apply_global_volume);
+      filled += period;
+      primed = true;
+
+      pullStats.callbacks++;
+      pullStats.last_callback_us = us;
+      if (us > pullStats.max_callback_us)
+        pullStats.max_callback_us = us;
+      if (us > periodUs)
+        pullStats.late_callbacks++;
+      // the new period is heard once everything queued ahead of it has played
+      pullStats.latency_us = FramesToUs(filled);
+      if (pullStats.latency_us > pullStats.max_latency_us)
+        pullStats.max_latency_us = pullStats.latency_us;
+    }
+
+    // wake when there is room for the next period
+    uint32_t room = target - period;
+    SleepUs(filled > room ? FramesToUs(filled - room) : 0);
+  }
+  return NULL;
+}
+
+bool vmupro_audio_pull_start(const vmupro_audio_pull_config_t *config, vmupro_audio_fill_t fill, void *user)
+{
+  vmupro_audio_pull_config_t c = config != NULL ? *config : vmupro_audio_pull_defaults();
+  if (atomic_load(&running) || fill == NULL || c.period_frames < VMUPRO_AUDIO_PULL_MIN_PERIOD ||
+      c.period_frames > VMUPRO_AUDIO_PULL_MAX_PERIOD || c.periods < 2 || c.periods > VMUPRO_AUDIO_PULL_MAX_PERIODS)
+    return false;
+  if (!vmupro_audio_start_listen_mode())
+    return false;
+
+  // everything queued has to fit in the ring buffer, compared in samples
+  uint32_t filled = 0, size = 0;
+  vmupro_get_ringbuffer_fill_state(&filled, &size);
+  if (size != 0 && c.period_frames * c.periods * (c.stereo ? 2u : 1u) > size)
+  {
+    vmupro_audio_exit_listen_mode();
+    return false;
+  }
+
+  pullConfig = c;
+  pullFill = fill;
+  pullUser = user;
+  memset(&pullStats, 0, sizeof(pullStats));
+  atomic_store(&taskEngines, 0);
+  atomic_store(&running, true);
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, TASK_STACK);
+  if (pthread_create(&pullTask, &attr, PullTask, NULL) != 0)
+  {
+    atomic_store(&running, false);
+    vmupro_audio_exit_listen_mode();
+    return false;
+  }
+  return true;
+}
+
+void vmupro_audio_pull_stop(void)
+{
+  if (!atomic_load(&running))
+    return;
+  atomic_store(&running, false);
+  pthread_join(pullTask, NULL);
+  atomic_store(&taskEngines, 0);
+  vmupro_audio_exit_listen_mode();
+}
+
+bool vmupro_audio_pull_is_running(void)
+{
+  return atomic_load(&running);
+}
+
+void vmupro_audio_pull_claim(uint32_t engine)
+{
+  if (atomic_load(&running))
+    atomic_fetch_or(&taskEngines, engine);
+}
+
+void vmupro_audio_pull_note_render(uint32_t engine)
+{
+  if (onTask && !(atomic_load_explicit(&taskEngines, memory_order_relaxed) & engine))
+    atomic_fetch_or(&taskEngines, engine);
+}
+
+bool vmupro_audio_pull_renders(uint32_t engine)
+{
+  return atomic_load(&running) && (atomic_load(&taskEngines) & engine) != 0;
+}
+
+void vmupro_audio_pull_get_stats(vmupro_audio_pull_stats_t *out_stats)
+{
+  if (out_stats != NULL)
+    *out_stats = pullStats;
+}
+
+void vmupro_audio_pull_reset_stats(void)
+{
+  memset(&pullStats, 0, sizeof(pullStats));
+}
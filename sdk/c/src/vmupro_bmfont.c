@@ -0,0 +1,315 @@
+// sdk/c/src/vmupro_bmfont.c
+//
+// Custom bitmap fonts read in place from font_bmfont.py output, see vmupro_bmfont.h
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vmupro_display.h"
+#include "vmupro_bmfont.h"
+#include "vmupro_text_blend.h"
+#include "vmupro_dirty_rect.h"
+
+#define SCREEN_W 240
+#define SCREEN_H 240
+
+#define REPLACEMENT_CHAR 0xfffd
+
+static bool SectionFits(uint32_t offset, uint32_t bytes, uint32_t size)
+{
+  return (offset & 3) == 0 && offset <= size && bytes <= size - offset;
+}
+
+bool vmupro_bmfont_load(vmupro_bmfont_t *font, const uint8_t *data, uint32_t size)
+{
+  if (font == NULL || data == NULL || ((uintptr_t)data & 3) != 0 || size < sizeof(vmupro_bmfont_header_t))
+    return false;
+
+  const vmupro_bmfont_header_t *header = (const vmupro_bmfont_header_t *)data;
+  if (header->magic != VMUPRO_BMFONT_MAGIC || header->version != VMUPRO_BMFONT_VERSION || header->line_height == 0)
+    return false;
+  if (!SectionFits(header->glyphs_offset, header->glyph_count * (uint32_t)sizeof(vmupro_bmfont_glyph_t), size) ||
+      !SectionFits(header->kerning_offset, header->kerning_count * (uint32_t)sizeof(vmupro_bmfont_kerning_t), size) ||
+      header->bitmap_offset > size)
+    return false;
+  if (header->fallback != VMUPRO_BMFONT_NO_GLYPH && header->fallback >= header->glyph_count)
+    return false;
+  for (int i = 0; i < 96; i++)
+  {
+    if (header->ascii[i] != VMUPRO_BMFONT_NO_GLYPH && header->ascii[i] >= header->glyph_count)
+      return false;
+  }
+
+  // every glyph's bitmap and kerning pairs must be inside the data
+  const vmupro_bmfont_glyph_t *glyphs = (const vmupro_bmfont_glyph_t *)(data + header->glyphs_offset);
+  const vmupro_bmfont_kerning_t *kerning = (const vmupro_bmfont_kerning_t *)(data + header->kerning_offset);
+  uint32_t bitmapBytes = size - header->bitmap_offset;
+  for (int i = 0; i < header->glyph_count; i++)
+  {
+    const vmupro_bmfont_glyph_t *g = &glyphs[i];
+    uint32_t bytes = (uint32_t)(g->width + 1) / 2 * g->height;
+    if (g->bitmap > bitmapBytes || bytes > bitmapBytes - g->bitmap)
+      return false;
+    if ((uint32_t)g->kerning_index + g->kerning_count > header->kerning_count)
+      return false;
+    if (i > 0 && g->codepoint <= glyphs[i - 1].codepoint)
+      return false;
+  }
+  for (int i = 0; i < header->kerning_count; i++)
+  {
+    if (kerning[i].second >= header->glyph_count)
+      return false;
+  }
+
+  font->header = header;
+  font->glyphs = glyphs;
+  font->kerning = kerning;
+  font->bitmaps = data + header->bitmap_offset;
+  return true;
+}
+
+uint32_t vmupro_utf8_next(const char **text)
+{
+  const unsigned char *p = (const unsigned char *)*text;
+  uint32_t c = p[0];
+  if (c == 0)
+    return 0;
+  if (c < 0x80)
+  {
+    *text += 1;
+    return c;
+  }
+
+  int length;
+  uint32_t min;
+  if ((c & 0xe0) == 0xc0)
+  {
+    length = 2;
+    min = 0x80;
+    c &= 0x1f;
+  }
+  else if ((c & 0xf0) == 0xe0)
+  {
+    length = 3;
+    min = 0x800;
+    c &= 0x0f;
+  }
+  else if ((c & 0xf8) == 0xf0)
+  {
+    length = 4;
+    min = 0x10000;
+    c &= 0x07;
+  }
+  else
+  {
+    *text += 1;
+    return REPLACEMENT_CHAR;
+  }
+
+  for (int i = 1; i < length; i++)
+  {
+    // also stops at the terminator
+    if ((p[i] & 0xc0) != 0x80)
+    {
+      *text += 1;
+      return REPLACEMENT_CHAR;
+    }
+    c = (c << 6) | (p[i] & 0x3f);
+  }
+  if (c < min || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+  {
+    *text += 1;
+    return REPLACEMENT_CHAR;
+  }
+  *text += length;
+  return c;
+}
+
+static int FindGlyphIndex(const vmupro_bmfont_t *font, uint32_t codepoint)
+{
+  if (codepoint >= 0x20 && codepoint < 0x80)
+  {
+    uint16_t index = font->header->ascii[codepoint - 0x20];
+    return index == VMUPRO_BMFONT_NO_GLYPH ? -1 : index;
+  }
+
+  int lo = 0;
+  int hi = font->header->glyph_count - 1;
+  while (lo <= hi)
+  {
+    int mid = (lo + hi) >> 1;
+    uint32_t c = font->glyphs[mid].codepoint;
+    if (c == codepoint)
+      return mid;
+    if (c < codepoint)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return -1;
+}
+
+const vmupro_bmfont_glyph_t *vmupro_bmfont_find_glyph(const vmupro_bmfont_t *font, uint32_t codepoint)
+{
+  if (font == NULL || font->header == NULL)
+    return NULL;
+  int index = FindGlyphIndex(font, codepoint);
+  return index < 0 ? NULL : &font->glyphs[index];
+}
+
+static int KerningAmount(const vmupro_bmfont_t *font, int first, int second)
+{
+  const vmupro_bmfont_glyph_t *g = &font->glyphs[first];
+  const vmupro_bmfont_kerning_t *pairs = font->kerning + g->kerning_index;
+  int lo = 0;
+  int hi = g->kerning_count - 1;
+  while (lo <= hi)
+  {
+    int mid = (lo + hi) >> 1;
+    if (pairs[mid].second == second)
+      return pairs[mid].amount;
+    if (pairs[mid].second < second)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return 0;
+}
+
+int vmupro_bmfont_get_kerning(const vmupro_bmfont_t *font, uint32_t first, uint32_t second)
+{
+  if (font == NULL || font->header == NULL)
+    return 0;
+  int a = FindGlyphIndex(font, first);
+  int b = FindGlyphIndex(font, second);
+  return a < 0 || b < 0 ? 0 : KerningAmount(font, a, b);
+}
+
+// Next glyph of the string: the glyph index, -1 to skip, or -2 at a line
+// break. ASCII is resolved through the header table without decoding
+static inline int NextGlyph(const vmupro_bmfont_t *font, const char **text)
+{
+  unsigned char c = (unsigned char)**text;
+  int index;
+  if (c < 0x80)
+  {
+    *text += 1;
+    if (c == '\n')
+      return -2;
+    index = c < 0x20 ? -1 : font->header->ascii[c - 0x20];
+    if (index == VMUPRO_BMFONT_NO_GLYPH)
+      index = -1;
+  }
+  else
+  {
+    index = FindGlyphIndex(font, vmupro_utf8_next(text));
+  }
+  if (index < 0 && font->header->fallback != VMUPRO_BMFONT_NO_GLYPH)
+    index = font->header->fallback;
+  return index;
+}
+
+int vmupro_bmfont_text_width(const vmupro_bmfont_t *font, const char *text)
+{
+  if (font == NULL || font->header == NULL || text == NULL)
+    return 0;
+
+  int width = 0;
+  int pen = 0;
+  int prev = -1;
+  while (*text)
+  {
+    int index = NextGlyph(font, &text);
+    if (index == -2)
+    {
+      pen = 0;
+      prev = -1;
+      continue;
+    }
+    if (index < 0)
+      continue;
+    if (prev >= 0 && font->glyphs[prev].kerning_count)
+      pen += KerningAmount(font, prev, index);
+    pen += font->glyphs[index].advance;
+    prev = index;
+    if (pen > width)
+      width = pen;
+  }
+  return width;
+}
+
+static void DrawGlyph(uint16_t *fb, const vmupro_bmfont_t *font, const vmupro_bmfont_glyph_t *g, int x, int y,
+                      const TextColor *color)
+{
+  int x0 = x < 0 ? -x : 0;
+  int y0 = y < 0 ? -y : 0;
+  int x1 = x + g->width > SCREEN_W ? SCREEN_W - x : g->width;
+  int y1 = y + g->height > SCREEN_H ? SCREEN_H - y : g->height;
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  int stride = (g->width + 1) / 2;
+  const uint8_t *bitmap = font->bitmaps + g->bitmap;
+  for (int gy = y0; gy < y1; gy++)
+  {
+    const uint8_t *row = bitmap + gy * stride;
+    uint16_t *dst = fb + (y + gy) * SCREEN_W + x;
+    for (int gx = x0; gx < x1; gx++)
+    {
+      int value = (row[gx >> 1] >> ((gx & 1) ? 0 : 4)) & 0x0f;
+      if (value == 15)
+        dst[gx] = color->be;
+      else if (value != 0)
+        dst[gx] = BlendCoverage(color, dst[gx], value);
+    }
+  }
+}
+
+int vmupro_bmfont_draw_text(const vmupro_bmfont_t *font, const char *text, int x, int y, uint16_t color)
+{
+  if (font == NULL || font->header == NULL || text == NULL)
+    return 0;
+
+  TextColor c = MakeTextColor(color);
+  uint16_t *fb = (uint16_t *)vmupro_get_back_buffer();
+
+  // bounds of everything drawn, for the dirty rect
+  int minX = SCREEN_W, minY = SCREEN_H, maxX = 0, maxY = 0;
+  int width = 0;
+  int pen = 0;
+  int prev = -1;
+  while (*text)
+  {
+    int index = NextGlyph(font, &text);
+    if (index == -2)
+    {
+      pen = 0;
+      prev = -1;
+      y += font->header->line_height;
+      continue;
+    }
+    if (index < 0)
+      continue;
+
+    const vmupro_bmfont_glyph_t *g = &font->glyphs[index];
+    if (prev >= 0 && font->glyphs[prev].kerning_count)
+      pen += KerningAmount(font, prev, index);
+    if (g->width != 0)
+    {
+      int gx = x + pen + g->x_offset;
+      int gy = y + g->y_offset;
+      DrawGlyph(fb, font, g, gx, gy, &c);
+      minX = gx < minX ? gx : minX;
+      minY = gy < minY ? gy : minY;
+      maxX = gx + g->width > maxX ? gx + g->width : maxX;
+      maxY = gy + g->height > maxY ? gy + g->height : maxY;
+    }
+    pen += g->advance;
+    prev = index;
+    if (pen > width)
+      width = pen;
+  }
+
+  if (minX < maxX && minY < maxY)
+    MarkDirtyRect(minX, minY, maxX - minX, maxY - minY);
+  return width;
+}
@@ -0,0 +1,26 @@
+// sdk/c/src/vmupro_dirty_rect.h
+//
+// Reports the screen area an SDK-side renderer wrote to the back buffer,
+// internal to the SDK sources
+//
+// vmupro_mark_dirty_rect() needs firmware newer than 2.0.0. Firmware 2.0.0
+// doesn't export it, so an app calling it won't load on it. The call is
+// only compiled in when VMUPRO_FIRMWARE_DIRTY_RECTS is defined, which the
+// host simulator (tools/hostsim) does. Without it, an app using partial
+// update mode marks the areas these renderers draw to itself.
+
+#pragma once
+
+#include "vmupro_display.h"
+
+static inline void MarkDirtyRect(int x, int y, int width, int height)
+{
+#ifdef VMUPRO_FIRMWARE_DIRTY_RECTS
+  vmupro_mark_dirty_rect(x, y, width, height);
+#else
+  (void)x;
+  (void)y;
+  (void)width;
+  (void)height;
+#endif
+}
@@ -0,0 +1,500 @@
+// sdk/c/src/vmupro_file_async.c
+//
+// Asynchronous file I/O on its own task, see vmupro_file_async.h
+// Requests live in a fixed pool guarded by one mutex. The task takes the
+// most urgent waiting request, oldest first within a priority, moves one
+// chunk with the lock released, then picks again, so a more urgent
+// request submitted in the meantime goes next.
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "vmupro_file.h"
+#include "vmupro_utils.h"
+#include "vmupro_file_async.h"
+
+#define TASK_STACK 8192
+#define MAX_REQUESTS VMUPRO_FILE_ASYNC_MAX_REQUESTS
+
+struct vmupro_file_async_request
+{
+  bool used;
+  bool released;   // handle given back, free the slot once finished
+  bool queued;     // in the finished queue, waiting for its callback
+  bool delivering; // callback running, freed when it returns
+  bool active;     // chunk in flight on the task
+  bool cancelling; // cancelled while active, finish after the chunk
+  vmupro_file_async_status_t status;
+  vmupro_file_async_op_t op;
+  vmupro_file_async_priority_t priority;
+  uint32_t seq;
+  uint64_t submitUs;
+  char path[VMUPRO_FILE_ASYNC_MAX_PATH];
+  uint8_t *buffer;     // READ destination, or LOAD allocation
+  const uint8_t *data; // WRITE and WRITE_AT source
+  uint8_t *copy;       // owned copy of data
+  uint32_t offset;
+  size_t size; // unknown for a LOAD until it starts
+  size_t done;
+  vmupro_file_async_callback_t callback;
+  void *user;
+};
+
+static struct vmupro_file_async_request requests[MAX_REQUESTS];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t requestFinished = PTHREAD_COND_INITIALIZER;
+static pthread_t ioTask;
+static bool running = false;
+static bool stopping = false;
+static uint32_t nextSeq;
+static vmupro_file_async_stats_t stats;
+
+// finished requests with a callback, oldest first
+static vmupro_file_async_request_t *finishedQueue[MAX_REQUESTS];
+static int finishedHead;
+static int finishedCount;
+
+static inline bool IsFinished(vmupro_file_async_status_t status)
+{
+  return status >= VMUPRO_FILE_ASYNC_DONE;
+}
+
+static inline bool IsWrite(vmupro_file_async_op_t op)
+{
+  return op == VMUPRO_FILE_ASYNC_WRITE || op == VMUPRO_FILE_ASYNC_WRITE_AT;
+}
+
+static int QueuedLocked(void)
+{
+  int n = 0;
+  for (int i = 0; i < MAX_REQUESTS; i++)
+    n += requests[i].used && !IsFinished(requests[i].status);
+  return n;
+}
+
+static void FreeSlot(vmupro_file_async_request_t *r)
+{
+  free(r->copy);
+  if (r->op == VMUPRO_FILE_ASYNC_LOAD)
+    free(r->buffer);
+  memset(r, 0, sizeof(*r));
+}
+
+static void FinishLocked(vmupro_file_async_request_t *r, vmupro_file_async_status_t status)
+{
+  r->status = status;
+  r->cancelling = false;
+  free(r->copy);
+  r->copy = NULL;
+  r->data = NULL;
+  if (status == VMUPRO_FILE_ASYNC_DONE)
+    stats.completed++;
+  else if (status == VMUPRO_FILE_ASYNC_FAILED)
+    stats.failed++;
+  else
+    stats.cancelled++;
+
+  if (r->released)
+    FreeSlot(r);
+  else if (r->callback != NULL)
+  {
+    finishedQueue[(finishedHead + finishedCount) % MAX_REQUESTS] = r;
+    finishedCount++;
+    r->queued = true;
+  }
+  pthread_cond_broadcast(&requestFinished);
+}
+
+static bool CancelLocked(vmupro_file_async_request_t *r)
+{
+  if (IsFinished(r->status))
+    return false;
+  if (r->status == VMUPRO_FILE_ASYNC_PENDING)
+  {
+    FinishLocked(r, VMUPRO_FILE_ASYNC_CANCELLED);
+    return true;
+  }
+  if (IsWrite(r->op))
+    return false;
+  if (r->active)
+    r->cancelling = true;
+  else
+    FinishLocked(r, VMUPRO_FILE_ASYNC_CANCELLED);
+  return true;
+}
+
+// Most urgent request waiting for a chunk, oldest first within a priority
+static vmupro_file_async_request_t *PickLocked(void)
+{
+  vmupro_file_async_request_t *best = NULL;
+  for (int i = 0; i < MAX_REQUESTS; i++)
+  {
+    vmupro_file_async_request_t *r = &requests[i];
+    if (!r->used || IsFinished(r->status) || r->active)
+      continue;
+    if (best == NULL || r->priority > best->priority ||
+        (r->priority == best->priority && (int32_t)(r->seq - best->seq) < 0))
+      best = r;
+  }
+  return best;
+}
+
+//
+// I/O task
+//
+
+// Moves the next chunk of r, with the lock released. Only the task
+// touches the fields used here while r is active. A LOAD first sizes
+// the file and allocates its buffer, moving nothing
+static bool Transfer(vmupro_file_async_request_t *r, size_t *moved)
+{
+  *moved = 0;
+  if (r->op == VMUPRO_FILE_ASYNC_LOAD && r->buffer == NULL)
+  {
+    size_t size = vmupro_get_file_size(r->path);
+    if (size == (size_t)-1)
+      return false;
+    uint8_t *buffer = malloc(size > 0 ? size : 1);
+    if (buffer == NULL)
+      return false;
+    r->buffer = buffer;
+    r->size = size;
+    return true;
+  }
+
+  size_t n = r->size - r->done;
+  if (n > VMUPRO_FILE_ASYNC_CHUNK_BYTES)
+    n = VMUPRO_FILE_ASYNC_CHUNK_BYTES;
+  bool ok;
+  switch (r->op)
+  {
+  case VMUPRO_FILE_ASYNC_READ:
+    ok = vmupro_read_file_bytes(r->path, r->buffer + r->done, r->offset + (uint32_t)r->done, (int)n);
+    break;
+  case VMUPRO_FILE_ASYNC_LOAD:
+    ok = vmupro_read_file_bytes(r->path, r->buffer + r->done, (uint32_t)r->done, (int)n);
+    break;
+  case VMUPRO_FILE_ASYNC_WRITE:
+    // the first chunk replaces the file, the rest extend it
+    if (r->done == 0)
+      ok = vmupro_write_file_complete(r->path, r->data, n);
+    else
+      ok = vmupro_write_file_bytes(r->path, r->data + r->done, (uint32_t)r->done, n);
+    break;
+  default:
+    ok = vmupro_write_file_bytes(r->path, r->data + r->done, r->offset + (uint32_t)r->done, n);
+    break;
+  }
+  if (ok)
+    *moved = n;
+  return ok;
+}
+
+static void *IoTask(void *arg)
+{
+  (void)arg;
+  vmupro_file_async_request_t *last = NULL;
+  uint32_t lastSeq = 0;
+
+  pthread_mutex_lock(&lock);
+  for (;;)
+  {
+    vmupro_file_async_request_t *r = PickLocked();
+    if (r == NULL)
+    {
+      if (stopping)
+        break;
+      pthread_cond_wait(&workReady, &lock);
+      continue;
+    }
+    // the previous request still has chunks to go
+    if (last != NULL && last != r && last->used && last->seq == lastSeq && !IsFinished(last->status))
+      stats.preemptions++;
+    last = r;
+    lastSeq = r->seq;
+
+    if (r->status == VMUPRO_FILE_ASYNC_PENDING)
+    {
+      r->status = VMUPRO_FILE_ASYNC_RUNNING;
+      uint32_t wait = (uint32_t)(vmupro_get_time_us() - r->submitUs);
+      if (wait > stats.max_wait_us[r->priority])
+        stats.max_wait_us[r->priority] = wait;
+    }
+    r->active = true;
+    pthread_mutex_unlock(&lock);
+
+    uint64_t start = vmupro_get_time_us();
+    size_t moved;
+    bool ok = Transfer(r, &moved);
+    uint32_t us = (uint32_t)(vmupro_get_time_us() - start);
+
+    pthread_mutex_lock(&lock);
+    r->active = false;
+    if (moved > 0)
+    {
+      r->done += moved;
+      stats.chunks++;
+      if (us > stats.max_chunk_us)
+        stats.max_chunk_us = us;
+      if (IsWrite(r->op))
+        stats.bytes_written += moved;
+      else
+        stats.bytes_read += moved;
+    }
+    if (!ok)
+      FinishLocked(r, VMUPRO_FILE_ASYNC_FAILED);
+    else if (r->done == r->size && (r->op != VMUPRO_FILE_ASYNC_LOAD || r->buffer != NULL))
+      FinishLocked(r, VMUPRO_FILE_ASYNC_DONE);
+    else if (r->cancelling)
+      FinishLocked(r, VMUPRO_FILE_ASYNC_CANCELLED);
+  }
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+//
+// API
+//
+
+vmupro_file_async_request_t *vmupro_file_async_submit(const vmupro_file_async_desc_t *desc)
+{
+  if (desc == NULL || desc->path == NULL || strlen(desc->path) >= VMUPRO_FILE_ASYNC_MAX_PATH ||
+      desc->op > VMUPRO_FILE_ASYNC_WRITE_AT || desc->priority > VMUPRO_FILE_ASYNC_HIGH)
+    return NULL;
+  if (desc->op == VMUPRO_FILE_ASYNC_READ && (desc->buffer == NULL || desc->size == 0))
+    return NULL;
+  if (IsWrite(desc->op) && (desc->data == NULL || desc->size == 0))
+    return NULL;
+
+  uint8_t *copy = NULL;
+  if (IsWrite(desc->op) && desc->copy)
+  {
+    copy = malloc(desc->size);
+    if (copy == NULL)
+      return NULL;
+    memcpy(copy, desc->data, desc->size);
+  }
+
+  pthread_mutex_lock(&lock);
+  vmupro_file_async_request_t *r = NULL;
+  for (int i = 0; i < MAX_REQUESTS && r == NULL; i++)
+  {
+    if (!requests[i].used)
+      r = &requests[i];
+  }
+  if (r == NULL)
+  {
+    stats.rejected++;
+    pthread_mutex_unlock(&lock);
+    free(copy);
+    return NULL;
+  }
+
+  r->used = true;
+  r->status = VMUPRO_FILE_ASYNC_PENDING;
+  r->op = desc->op;
+  r->priority = desc->priority;
+  r->seq = nextSeq++;
+  r->submitUs = vmupro_get_time_us();
+  strcpy(r->path, desc->path);
+  r->buffer = desc->op == VMUPRO_FILE_ASYNC_READ ? desc->buffer : NULL;
+  r->copy = copy;
+  r->data = copy != NULL ? copy : desc->data;
+  r->offset = desc->offset;
+  r->size = desc->op == VMUPRO_FILE_ASYNC_LOAD ? 0 : desc->size;
+  r->callback = desc->callback;
+  r->user = desc->user;
+
+  if (!running)
+  {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, TASK_STACK);
+    if (pthread_create(&ioTask, &attr, IoTask, NULL) != 0)
+    {
+      FreeSlot(r);
+      pthread_mutex_unlock(&lock);
+      return NULL;
+    }
+    running = true;
+  }
+
+  stats.submitted++;
+  int queued = QueuedLocked();
+  if (queued > stats.max_queued)
+    stats.max_queued = (uint8_t)queued;
+  pthread_cond_signal(&workReady);
+  pthread_mutex_unlock(&lock);
+  return r;
+}
+
+vmupro_file_async_status_t vmupro_file_async_status(const vmupro_file_async_request_t *req)
+{
+  if (req == NULL)
+    return VMUPRO_FILE_ASYNC_FAILED;
+  pthread_mutex_lock(&lock);
+  vmupro_file_async_status_t status = req->status;
+  pthread_mutex_unlock(&lock);
+  return status;
+}
+
+size_t vmupro_file_async_progress(const vmupro_file_async_request_t *req)
+{
+  if (req == NULL)
+    return 0;
+  pthread_mutex_lock(&lock);
+  size_t done = req->done;
+  pthread_mutex_unlock(&lock);
+  return done;
+}
+
+bool vmupro_file_async_wait(const vmupro_file_async_request_t *req, int timeout_ms)
+{
+  if (req == NULL)
+    return false;
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  if (timeout_ms > 0)
+  {
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+  }
+
+  pthread_mutex_lock(&lock);
+  while (!IsFinished(req->status) && timeout_ms != 0)
+  {
+    if (timeout_ms < 0)
+      pthread_cond_wait(&requestFinished, &lock);
+    else if (pthread_cond_timedwait(&requestFinished, &lock, &deadline) == ETIMEDOUT)
+      break;
+  }
+  bool finished = IsFinished(req->status);
+  pthread_mutex_unlock(&lock);
+  return finished;
+}
+
+bool vmupro_file_async_cancel(vmupro_file_async_request_t *req)
+{
+  if (req == NULL)
+    return false;
+  pthread_mutex_lock(&lock);
+  bool cancelled = req->used && CancelLocked(req);
+  pthread_mutex_unlock(&lock);
+  return cancelled;
+}
+
+uint8_t *vmupro_file_async_take_buffer(vmupro_file_async_request_t *req, size_t *out_size)
+{
+  if (req == NULL)
+    return NULL;
+  pthread_mutex_lock(&lock);
+  uint8_t *buffer = NULL;
+  if (req->op == VMUPRO_FILE_ASYNC_LOAD && req->status == VMUPRO_FILE_ASYNC_DONE)
+  {
+    buffer = req->buffer;
+    req->buffer = NULL;
+    if (out_size != NULL && buffer != NULL)
+      *out_size = req->size;
+  }
+  pthread_mutex_unlock(&lock);
+  return buffer;
+}
+
+void vmupro_file_async_release(vmupro_file_async_request_t *req)
+{
+  if (req == NULL)
+    return;
+  pthread_mutex_lock(&lock);
+  if (req->used && !req->delivering && !req->released)
+  {
+    req->released = true;
+    // writes go on to the card, their slot is freed when they finish
+    if (!IsFinished(req->status) && !IsWrite(req->op))
+      CancelLocked(req);
+    else if (IsFinished(req->status) && !req->queued)
+      FreeSlot(req);
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+int vmupro_file_async_update(void)
+{
+  int calls = 0;
+  pthread_mutex_lock(&lock);
+  while (finishedCount > 0)
+  {
+    vmupro_file_async_request_t *r = finishedQueue[finishedHead];
+    finishedHead = (finishedHead + 1) % MAX_REQUESTS;
+    finishedCount--;
+    r->queued = false;
+    if (r->released)
+    {
+      FreeSlot(r);
+      continue;
+    }
+
+    r->delivering = true;
+    vmupro_file_async_callback_t callback = r->callback;
+    vmupro_file_async_status_t status = r->status;
+    void *user = r->user;
+    pthread_mutex_unlock(&lock);
+    callback(r, status, user);
+    pthread_mutex_lock(&lock);
+    FreeSlot(r);
+    calls++;
+  }
+  pthread_mutex_unlock(&lock);
+  return calls;
+}
+
+int vmupro_file_async_pending(void)
+{
+  pthread_mutex_lock(&lock);
+  int n = QueuedLocked();
+  pthread_mutex_unlock(&lock);
+  return n;
+}
+
+void vmupro_file_async_stop(void)
+{
+  pthread_mutex_lock(&lock);
+  if (!running)
+  {
+    pthread_mutex_unlock(&lock);
+    return;
+  }
+  stopping = true;
+  pthread_cond_signal(&workReady);
+  pthread_mutex_unlock(&lock);
+
+  pthread_join(ioTask, NULL);
+
+  pthread_mutex_lock(&lock);
+  running = false;
+  stopping = false;
+  pthread_mutex_unlock(&lock);
+}
+
+void vmupro_file_async_get_stats(vmupro_file_async_stats_t *out_stats)
+{
+  if (out_stats == NULL)
+    return;
+  pthread_mutex_lock(&lock);
+  *out_stats = stats;
+  pthread_mutex_unlock(&lock);
+}
+
+void vmupro_file_async_reset_stats(void)
+{
+  pthread_mutex_lock(&lock);
+  memset(&stats, 0, sizeof(stats));
+  pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,73 @@
+// sdk/c/src/vmupro_frame_pacer.c
+//
+// Fixed rate frame presentation, see vmupro_frame_pacer.h
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vmupro_display.h"
+#include "vmupro_utils.h"
+#include "vmupro_frame_pacer.h"
+// profiled builds time the push and count the frame
+#include "vmupro_profile.h"
+
+// Sleep in whole milliseconds while the deadline is far away, so other
+// tasks can run, and spend the last stretch in the precise delay
+static void SleepUntil(uint64_t when)
+{
+  uint64_t now = vmupro_get_time_us();
+  if (when > now + 2000)
+    vmupro_sleep_ms((uint32_t)((when - now) / 1000 - 1));
+  now = vmupro_get_time_us();
+  if (when > now)
+    vmupro_delay_us(when - now);
+}
+
+void vmupro_frame_pacer_init(vmupro_frame_pacer_t *pacer, uint32_t fps)
+{
+  if (pacer == NULL)
+    return;
+  if (fps < 1)
+    fps = 1;
+  if (fps > 1000)
+    fps = 1000;
+
+  pacer->frame_us = 1000000 / fps;
+  pacer->deadline_us = 0;
+  pacer->last_present_us = 0;
+  pacer->late_us = 0;
+  pacer->frames = 0;
+  pacer->missed = 0;
+}
+
+bool vmupro_frame_pacer_present(vmupro_frame_pacer_t *pacer)
+{
+  if (pacer == NULL)
+    return false;
+
+  uint64_t now = vmupro_get_time_us();
+  if (pacer->deadline_us == 0)
+    pacer->deadline_us = now;
+
+  bool onTime = now <= pacer->deadline_us;
+  if (onTime)
+  {
+    SleepUntil(pacer->deadline_us);
+    pacer->late_us = 0;
+  }
+  else
+  {
+    pacer->late_us = (uint32_t)(now - pacer->deadline_us);
+    pacer->missed++;
+  }
+
+  vmupro_push_double_buffer_frame();
+  pacer->frames++;
+  pacer->last_present_us = vmupro_get_last_present_time_us();
+
+  // Advance by exactly one period so the rate doesn't drift. More than a
+  // whole frame behind, restart the schedule instead of rushing frames out
+  pacer->deadline_us += pacer->frame_us;
+  if (now >= pacer->deadline_us)
+    pacer->deadline_us = now + pacer->frame_us;
+  return onTime;
+}
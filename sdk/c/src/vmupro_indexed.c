@@ -0,0 +1,151 @@
+// sdk/c/src/vmupro_indexed.c
+//
+// 4bpp/8bpp indexed colour images, see vmupro_indexed.h for the format
+
+#include <stdint.h>
+#include <string.h>
+#include "vmupro_display.h"
+#include "vmupro_indexed.h"
+#include "vmupro_dirty_rect.h"
+
+#define SCREEN_W 240
+#define SCREEN_H 240
+
+static inline int WrapMod(int v, int m)
+{
+  int r = v % m;
+  return r < 0 ? r + m : r;
+}
+
+// Expand count pixels of one source row, starting at column sx and
+// stepping by +1 or -1, into dst
+static void DrawIndexedRow(uint16_t *dst, const uint8_t *row, int bpp, int sx, int step, int count,
+                           const uint16_t *palette, int key)
+{
+  if (bpp == 8)
+  {
+    if (key < 0)
+    {
+      for (int i = 0; i < count; i++, sx += step)
+        dst[i] = palette[row[sx]];
+    }
+    else
+    {
+      for (int i = 0; i < count; i++, sx += step)
+      {
+        int index = row[sx];
+        if (index != key)
+          dst[i] = palette[index];
+      }
+    }
+    return;
+  }
+
+  // 4bpp, high nibble first
+  for (int i = 0; i < count; i++, sx += step)
+  {
+    int index = (row[sx >> 1] >> ((sx & 1) ? 0 : 4)) & 0x0f;
+    if (index != key)
+      dst[i] = palette[index];
+  }
+}
+
+bool vmupro_indexed_get_info(const uint8_t *image, int *width, int *height, int *bpp)
+{
+  if (image == NULL)
+    return false;
+
+  vmupro_indexed_header_t header;
+  memcpy(&header, image, sizeof(header));
+  if (header.magic != VMUPRO_INDEXED_MAGIC || header.width == 0 || header.height == 0 ||
+      (header.bpp != 4 && header.bpp != 8))
+    return false;
+
+  if (width)
+    *width = header.width;
+  if (height)
+    *height = header.height;
+  if (bpp)
+    *bpp = header.bpp;
+  return true;
+}
+
+void vmupro_blit_indexed_region(const uint8_t *image, const uint16_t *palette, int x, int y,
+                                int src_x, int src_y, int width, int height,
+                                int transparent_index, vmupro_drawflags_t flags)
+{
+  int imageW, imageH, bpp;
+  if (palette == NULL || !vmupro_indexed_get_info(image, &imageW, &imageH, &bpp))
+    return;
+  if (src_x < 0 || src_y < 0 || width <= 0 || height <= 0 || src_x + width > imageW || src_y + height > imageH)
+    return;
+
+  int x0 = x < 0 ? 0 : x;
+  int y0 = y < 0 ? 0 : y;
+  int x1 = x + width > SCREEN_W ? SCREEN_W : x + width;
+  int y1 = y + height > SCREEN_H ? SCREEN_H : y + height;
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  bool flipH = (flags & VMUPRO_DRAWFLAGS_FLIP_H) != 0;
+  bool flipV = (flags & VMUPRO_DRAWFLAGS_FLIP_V) != 0;
+  int stride = VMUPRO_INDEXED_STRIDE(imageW, bpp);
+  const uint8_t *pixels = image + VMUPRO_INDEXED_HEADER_SIZE;
+  uint16_t *fb = (uint16_t *)vmupro_get_back_buffer();
+
+  // first visible column in region space, walked backwards when flipped
+  int sx = flipH ? width - 1 - (x0 - x) : x0 - x;
+  for (int dy = y0; dy < y1; dy++)
+  {
+    int sy = flipV ? height - 1 - (dy - y) : dy - y;
+    const uint8_t *row = pixels + (src_y + sy) * stride;
+    DrawIndexedRow(fb + dy * SCREEN_W + x0, row, bpp, src_x + sx, flipH ? -1 : 1, x1 - x0, palette, transparent_index);
+  }
+
+  MarkDirtyRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+void vmupro_blit_indexed(const uint8_t *image, const uint16_t *palette, int x, int y,
+                         int transparent_index, vmupro_drawflags_t flags)
+{
+  int width, height;
+  if (!vmupro_indexed_get_info(image, &width, &height, NULL))
+    return;
+  vmupro_blit_indexed_region(image, palette, x, y, 0, 0, width, height, transparent_index, flags);
+}
+
+void vmupro_render_indexed_layer(const uint8_t *image, const uint16_t *palette, int scroll_x, int scroll_y,
+                                 int transparent_index)
+{
+  int width, height, bpp;
+  if (palette == NULL || !vmupro_indexed_get_info(image, &width, &height, &bpp))
+    return;
+
+  int stride = VMUPRO_INDEXED_STRIDE(width, bpp);
+  const uint8_t *pixels = image + VMUPRO_INDEXED_HEADER_SIZE;
+  uint16_t *fb = (uint16_t *)vmupro_get_back_buffer();
+
+  // wrap once per frame, then per row only at the image edges
+  int startX = WrapMod(scroll_x, width);
+  int sy = WrapMod(scroll_y, height);
+  for (int dy = 0; dy < SCREEN_H; dy++)
+  {
+    const uint8_t *row = pixels + sy * stride;
+    uint16_t *dst = fb + dy * SCREEN_W;
+    int sx = startX;
+    int dx = 0;
+    while (dx < SCREEN_W)
+    {
+      int run = width - sx;
+      if (run > SCREEN_W - dx)
+        run = SCREEN_W - dx;
+      DrawIndexedRow(dst + dx, row, bpp, sx, 1, run, palette, transparent_index);
+      dx += run;
+      sx = 0;
+    }
+    if (++sy == height)
+      sy = 0;
+  }
+
+  MarkDirtyRect(0, 0, SCREEN_W, SCREEN_H);
+}
@@ -0,0 +1,712 @@
+// sdk/c/src/vmupro_instrument.c
+//
+// Sampled instruments, see vmupro_instrument.h
+// Instruments are published to the audio task through a few atomic slots
+// and rendered by the synth engine's source hook. As in the synth engine,
+// the game thread posts notes through a single producer/single consumer
+// queue per instrument. Each streamed voice publishes the chunk of the
+// file it is reading in one atomic word, and the game thread tags each of
+// the voice's two buffers with the chunk it holds once the read is done.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "vmupro_file.h"
+#include "vmupro_utils.h"
+#include "vmupro_resampler.h"
+#include "vmupro_mixer.h"
+#include "vmupro_synth.h"
+#include "vmupro_instrument.h"
+#include "vmupro_audio_internal.h"
+
+#define COMMAND_SLOTS 64
+#define MAX_VOLUME (VMUPRO_SYNTH_UNITY * 4)
+#define ENV_ONE 65536
+#define MAX_STEP (64u << 16) // frames of the sample per output frame, 16.16
+#define SECTOR 512
+#define HEADER_PROBE 4096
+#define MAX_CHUNKS 0xffff
+
+// progress and buffer tags: generation << 20 | zone << 16 | chunk
+#define TAG_CHUNK(t) ((t) & 0xffffu)
+#define TAG_ZONE(t) (((t) >> 16) & 0xfu)
+#define GENERATION_MASK 0xfffu
+
+typedef enum
+{
+  CMD_NOTE_ON = 0,
+  CMD_NOTE_OFF,
+  CMD_STOP,
+} CommandType;
+
+typedef enum
+{
+  VOICE_OFF = 0,
+  VOICE_HELD,
+  VOICE_RELEASED,
+} VoiceState;
+
+typedef struct
+{
+  uint8_t type;
+  uint8_t note;
+  uint8_t velocity;
+} Command;
+
+// Fixed once published by zoneCount
+typedef struct
+{
+  vmupro_instrument_zone_t z;
+  const int16_t *pcm;   // the first resident frames
+  uint32_t resident;
+  uint32_t frames;      // whole sample
+  uint32_t rate;
+  uint8_t channels;
+  uint32_t releaseStep; // per frame, from ENV_ONE
+  // streamed zones only
+  uint8_t *block;       // head and path, owned
+  const char *path;
+  uint32_t tailOffset;  // file offset of frame resident
+  uint32_t dataEnd;
+  uint32_t chunkFrames;
+} Zone;
+
+typedef struct
+{
+  // owned by the audio task
+  uint8_t state;
+  uint8_t note;
+  uint8_t zone;
+  uint64_t pos;  // 16.16 frame of the sample
+  uint32_t step; // 16.16
+  int32_t gain;  // zone volume and velocity, 8.8
+  uint32_t env;  // 16.16 level
+  uint32_t age;  // when the note was started or released
+  uint32_t tag;  // generation and zone of the stream
+  uint32_t chunk;
+  // shared with the game thread
+  _Atomic uint32_t progress;  // tag | chunk being read, 0 when not streaming
+  _Atomic uint32_t filled[2]; // tag | chunk each buffer holds
+} Voice;
+
+struct vmupro_instrument
+{
+  Zone zones[VMUPRO_INSTRUMENT_MAX_ZONES];
+  _Atomic int zoneCount;
+  int polyphony;
+  int16_t *streamBuffers; // two per voice, allocated with the first streamed zone
+  _Atomic uint8_t policy;
+  _Atomic uint32_t volume; // left << 16 | right
+
+  Command commands[COMMAND_SLOTS];
+  Queue commandQueue;
+
+  // owned by the audio task
+  Voice voices[VMUPRO_INSTRUMENT_MAX_VOICES];
+  uint32_t clock;
+  uint32_t generation;
+  vmupro_instrument_stats_t stats;
+  _Atomic uint8_t activeVoices;
+
+  // owned by the game thread
+  uint32_t streamReads;
+  uint32_t streamBytes;
+  uint32_t maxReadUs;
+  uint32_t residentBytes;
+};
+
+static vmupro_instrument_t *_Atomic instruments[VMUPRO_INSTRUMENT_MAX];
+// set while the audio task walks the instruments, so free can wait it out
+static atomic_bool rendering = false;
+static bool sourceInstalled = false;
+
+static inline int16_t *StreamBuffer(vmupro_instrument_t *inst, const Voice *v, uint32_t chunk)
+{
+  size_t index = (size_t)(v - inst->voices) * 2 + (chunk & 1);
+  return inst->streamBuffers + index * (VMUPRO_INSTRUMENT_STREAM_BYTES / sizeof(int16_t));
+}
+
+//
+// Audio task
+//
+
+static void EndVoice(Voice *v)
+{
+  v->state = VOICE_OFF;
+  atomic_store_explicit(&v->progress, 0, memory_order_release);
+}
+
+// Sample frames per output frame for a note, 16.16
+static uint32_t StepFor(const Zone *z, uint8_t note)
+{
+  uint64_t ratio = 65536;
+  if (z->z.root_key != VMUPRO_INSTRUMENT_FIXED_PITCH)
+    ratio = ((uint64_t)vmupro_synth_midi_frequency(note) << 16) / vmupro_synth_midi_frequency(z->z.root_key);
+  uint64_t step = (ratio * z->rate + VMUPRO_SYNTH_RATE / 2) / VMUPRO_SYNTH_RATE;
+  return step > MAX_STEP ? MAX_STEP : step < 1 ? 1 : (uint32_t)step;
+}
+
+// The voice a note takes: with the same-note policy one already playing
+// it, else a silent one, else the one released longest ago, else a held
+// one chosen by the policy
+static Voice *PickVoice(vmupro_instrument_t *inst, uint8_t note, uint8_t policy)
+{
+  Voice *pick = NULL;
+  if (policy == VMUPRO_INSTRUMENT_STEAL_SAME_NOTE)
+  {
+    for (int i = 0; i < inst->polyphony && pick == NULL; i++)
+    {
+      if (inst->voices[i].state != VOICE_OFF && inst->voices[i].note == note)
+        pick = &inst->voices[i];
+    }
+    if (pick != NULL)
+    {
+      inst->stats.retriggers++;
+      return pick;
+    }
+  }
+  for (int i = 0; i < inst->polyphony; i++)
+  {
+    if (inst->voices[i].state == VOICE_OFF)
+      return &inst->voices[i];
+  }
+  for (int i = 0; i < inst->polyphony; i++)
+  {
+    Voice *v = &inst->voices[i];
+    if (v->state == VOICE_RELEASED && (pick == NULL || inst->clock - v->age > inst->clock - pick->age))
+      pick = v;
+  }
+  if (pick != NULL)
+  {
+    inst->stats.steals_released++;
+    return pick;
+  }
+  for (int i = 0; i < inst->polyphony; i++)
+  {
+    Voice *v = &inst->voices[i];
+    if (pick == NULL)
+      pick = v;
+    else if (policy == VMUPRO_INSTRUMENT_STEAL_QUIETEST ? v->gain < pick->gain
+                                                         : inst->clock - v->age > inst->clock - pick->age)
+      pick = v;
+  }
+  inst->stats.steals_held++;
+  return pick;
+}
+
+static void NoteOn(vmupro_instrument_t *inst, uint8_t note, uint8_t velocity)
+{
+  int zones = atomic_load_explicit(&inst->zoneCount, memory_order_acquire);
+  int zone = -1;
+  for (int i = 0; i < zones && zone < 0; i++)
+  {
+    const vmupro_instrument_zone_t *z = &inst->zones[i].z;
+    if (note >= z->key_low && note <= z->key_high && velocity >= z->velocity_low && velocity <= z->velocity_high)
+      zone = i;
+  }
+  if (zone < 0)
+  {
+    inst->stats.notes_unmapped++;
+    return;
+  }
+
+  const Zone *z = &inst->zones[zone];
+  Voice *v = PickVoice(inst, note, atomic_load_explicit(&inst->policy, memory_order_relaxed));
+  v->state = VOICE_HELD;
+  v->note = note;
+  v->zone = (uint8_t)zone;
+  v->pos = 0;
+  v->step = StepFor(z, note);
+  v->gain = (int32_t)((z->z.volume * ((velocity * VMUPRO_SYNTH_UNITY + 63) / 127)) >> 8);
+  v->env = ENV_ONE;
+  v->age = ++inst->clock;
+  v->chunk = 0;
+  v->tag = 0;
+  if (z->path != NULL)
+  {
+    inst->generation = (inst->generation + 1) & GENERATION_MASK;
+    if (inst->generation == 0)
+      inst->generation = 1;
+    v->tag = inst->generation << 20 | (uint32_t)zone << 16;
+  }
+  atomic_store_explicit(&v->progress, v->tag, memory_order_release);
+  inst->stats.notes++;
+}
+
+static void NoteOff(vmupro_instrument_t *inst, uint8_t note)
+{
+  for (int i = 0; i < inst->polyphony; i++)
+  {
+    Voice *v = &inst->voices[i];
+    if (v->state == VOICE_HELD && v->note == note)
+    {
+      v->state = VOICE_RELEASED;
+      v->age = ++inst->clock;
+    }
+  }
+}
+
+static void RunCommands(vmupro_instrument_t *inst)
+{
+  uint32_t tail;
+  uint32_t head = QueuePending(&inst->commandQueue, &tail);
+  for (; tail != head; tail++)
+  {
+    const Command *cmd = QueueAt(&inst->commandQueue, tail);
+    if (cmd->type == CMD_NOTE_ON)
+    {
+      NoteOn(inst, cmd->note, cmd->velocity);
+    }
+    else if (cmd->type == CMD_NOTE_OFF)
+    {
+      NoteOff(inst, cmd->note);
+    }
+    else
+    {
+      for (int i = 0; i < inst->polyphony; i++)
+        EndVoice(&inst->voices[i]);
+    }
+  }
+  QueueConsumed(&inst->commandQueue, tail);
+}
+
+// Finds frame i of the voice's sample: a pointer to it and the frames
+// readable from there. Moving into the next chunk of a stream hands the
+// previous buffer back to the game thread. False if the chunk isn't loaded
+static bool Span(vmupro_instrument_t *inst, Voice *v, const Zone *z, uint32_t i, const int16_t **out, uint32_t *avail)
+{
+  if (i < z->resident)
+  {
+    *out = z->pcm + (size_t)i * z->channels;
+    *avail = z->resident - i;
+    return true;
+  }
+  uint32_t chunk = (i - z->resident) / z->chunkFrames;
+  if (chunk == v->chunk + 1)
+  {
+    v->chunk = chunk;
+    atomic_store_explicit(&v->progress, v->tag | chunk, memory_order_release);
+  }
+  if (chunk != v->chunk ||
+      atomic_load_explicit(&v->filled[chunk & 1], memory_order_acquire) != (v->tag | chunk))
+    return false;
+  uint32_t offset = i - z->resident - chunk * z->chunkFrames;
+  *out = StreamBuffer(inst, v, chunk) + (size_t)offset * z->channels;
+  *avail = z->chunkFrames - offset;
+  if (*avail > z->frames - i)
+    *avail = z->frames - i;
+  return true;
+}
+
+// The frame after a span, for interpolating across its end. Falls back
+// to the span's last frame when the next chunk isn't loaded yet
+static const int16_t *After(vmupro_instrument_t *inst, Voice *v, const Zone *z, uint32_t i, const int16_t *last)
+{
+  if (z->z.loop_end != 0 && i == z->z.loop_end)
+    i = z->z.loop_start;
+  if (i >= z->frames)
+    return last;
+  if (i < z->resident)
+    return z->pcm + (size_t)i * z->channels;
+  uint32_t chunk = (i - z->resident) / z->chunkFrames;
+  if (atomic_load_explicit(&v->filled[chunk & 1], memory_order_acquire) != (v->tag | chunk))
+    return last;
+  return StreamBuffer(inst, v, chunk) + (size_t)(i - z->resident - chunk * z->chunkFrames) * z->channels;
+}
+
+// Adds frames of one voice to the accumulator, span by span
+static void RenderVoice(vmupro_instrument_t *inst, Voice *v, int32_t *acc, int frames, int32_t volL, int32_t volR)
+{
+  const Zone *z = &inst->zones[v->zone];
+  uint32_t end = z->z.loop_end != 0 ? z->z.loop_end : z->frames;
+  int right = z->channels - 1;
+  int32_t gainL = (v->gain * volL) >> 8;
+  int32_t gainR = (v->gain * volR) >> 8;
+  int32_t release = v->state == VOICE_RELEASED ? (int32_t)z->releaseStep : 0;
+  int done = 0;
+  while (done < frames)
+  {
+    uint32_t i = (uint32_t)(v->pos >> 16);
+    if (i >= end)
+    {
+      if (z->z.loop_end == 0)
+      {
+        EndVoice(v);
+        return;
+      }
+      v->pos -= (uint64_t)(z->z.loop_end - z->z.loop_start) << 16;
+      continue;
+    }
+    const int16_t *p;
+    uint32_t avail;
+    if (!Span(inst, v, z, i, &p, &avail))
+    {
+      inst->stats.underruns++;
+      EndVoice(v);
+      return;
+    }
+
+    // frames whose next frame is in the span too, else one across its end
+    uint32_t stop = avail < end - i ? i + avail : end;
+    uint64_t last = (uint64_t)(stop - 1) << 16;
+    uint64_t n = v->pos < last ? (last - v->pos + v->step - 1) / v->step : 1;
+    if (n > (uint64_t)(frames - done))
+      n = (uint64_t)(frames - done);
+    const int16_t *after = v->pos < last ? NULL : After(inst, v, z, stop, p);
+
+    uint64_t base = (uint64_t)i << 16;
+    int32_t env = (int32_t)v->env;
+    int32_t *out = acc + done * 2;
+    for (int k = 0; k < (int)n; k++)
+    {
+      uint32_t at = (uint32_t)((v->pos - base) >> 16);
+      int32_t frac = (int32_t)((v->pos & 0xffff) >> 1);
+      const int16_t *a = p + (size_t)at * z->channels;
+      const int16_t *b = after != NULL ? after : a + z->channels;
+      int32_t l = a[0] + (((b[0] - a[0]) * frac) >> 15);
+      int32_t r = a[right] + (((b[right] - a[right]) * frac) >> 15);
+      if (env < ENV_ONE)
+      {
+        l = (l * (env >> 1)) >> 15;
+        r = (r * (env >> 1)) >> 15;
+      }
+      out[k * 2] += l * gainL;
+      out[k * 2 + 1] += r * gainR;
+      v->pos += v->step;
+      env -= release;
+      if (env <= 0)
+      {
+        EndVoice(v);
+        return;
+      }
+    }
+    v->env = (uint32_t)env;
+    done += (int)n;
+  }
+}
+
+static void RenderInstrument(vmupro_instrument_t *inst, int32_t *acc, int frames)
+{
+  RunCommands(inst);
+  uint32_t volume = atomic_load_explicit(&inst->volume, memory_order_relaxed);
+  int active = 0;
+  for (int i = 0; i < inst->polyphony; i++)
+  {
+    Voice *v = &inst->voices[i];
+    if (v->state == VOICE_OFF)
+      continue;
+    active++;
+    RenderVoice(inst, v, acc, frames, (int32_t)(volume >> 16), (int32_t)(volume & 0xffff));
+  }
+  atomic_store_explicit(&inst->activeVoices, (uint8_t)active, memory_order_relaxed);
+  inst->stats.active_voices = (uint8_t)active;
+  if (active > inst->stats.peak_voices)
+    inst->stats.peak_voices = (uint8_t)active;
+}
+
+// Synth engine source: mixes every instrument in after the synths
+static void Render(int32_t *acc, int frames, void *user)
+{
+  (void)user;
+  atomic_store(&rendering, true);
+  for (int i = 0; i < VMUPRO_INSTRUMENT_MAX; i++)
+  {
+    vmupro_instrument_t *inst = atomic_load(&instruments[i]);
+    if (inst != NULL)
+      RenderInstrument(inst, acc, frames);
+  }
+  atomic_store(&rendering, false);
+}
+
+void vmupro_instrument_render_note_on(vmupro_instrument_t *inst, uint8_t note, uint8_t velocity)
+{
+  if (inst != NULL && note <= 127 && velocity >= 1 && velocity <= 127)
+    NoteOn(inst, note, velocity);
+}
+
+void vmupro_instrument_render_note_off(vmupro_instrument_t *inst, uint8_t note)
+{
+  if (inst != NULL)
+    NoteOff(inst, note);
+}
+
+//
+// Instruments
+//
+
+vmupro_instrument_t *vmupro_instrument_new(int polyphony)
+{
+  if (polyphony < 1 || polyphony > VMUPRO_INSTRUMENT_MAX_VOICES)
+    return NULL;
+  vmupro_instrument_t *inst = calloc(1, sizeof(*inst));
+  if (inst == NULL)
+    return NULL;
+  inst->polyphony = polyphony;
+  QueueInit(&inst->commandQueue, inst->commands, sizeof(inst->commands[0]), COMMAND_SLOTS);
+  atomic_init(&inst->volume, (uint32_t)VMUPRO_SYNTH_UNITY << 16 | VMUPRO_SYNTH_UNITY);
+
+  if (!sourceInstalled)
+  {
+    vmupro_synth_engine_set_source(Render, NULL);
+    sourceInstalled = true;
+  }
+  for (int i = 0; i < VMUPRO_INSTRUMENT_MAX; i++)
+  {
+    vmupro_instrument_t *empty = NULL;
+    if (atomic_compare_exchange_strong(&instruments[i], &empty, inst))
+      return inst;
+  }
+  free(inst);
+  return NULL;
+}
+
+void vmupro_instrument_free(vmupro_instrument_t *inst)
+{
+  if (inst == NULL)
+    return;
+  for (int i = 0; i < VMUPRO_INSTRUMENT_MAX; i++)
+  {
+    vmupro_instrument_t *self = inst;
+    atomic_compare_exchange_strong(&instruments[i], &self, NULL);
+  }
+  while (atomic_load(&rendering))
+    vmupro_sleep_ms(1);
+  for (int i = 0; i < atomic_load(&inst->zoneCount); i++)
+    free(inst->zones[i].block);
+  free(inst->streamBuffers);
+  free(inst);
+}
+
+// Checks a zone against its sample and publishes it
+static bool AddZone(vmupro_instrument_t *inst, Zone *zone, const vmupro_instrument_zone_t *settings)
+{
+  const vmupro_instrument_zone_t *s = settings;
+  int count = atomic_load(&inst->zoneCount);
+  if (count == VMUPRO_INSTRUMENT_MAX_ZONES || s->key_low > s->key_high || s->key_high > 127 ||
+      s->velocity_low > s->velocity_high || s->velocity_high > 127 ||
+      (s->root_key > 127 && s->root_key != VMUPRO_INSTRUMENT_FIXED_PITCH) ||
+      (s->loop_end != 0 && (s->loop_start >= s->loop_end || s->loop_end > zone->resident)))
+    return false;
+  zone->z = *s;
+  if (zone->z.volume > MAX_VOLUME)
+    zone->z.volume = MAX_VOLUME;
+  uint64_t releaseFrames = (uint64_t)s->release_ms * VMUPRO_SYNTH_RATE / 1000;
+  zone->releaseStep = releaseFrames <= 1 ? ENV_ONE : (uint32_t)(ENV_ONE / releaseFrames);
+  if (zone->releaseStep == 0)
+    zone->releaseStep = 1;
+  inst->zones[count] = *zone;
+  atomic_store_explicit(&inst->zoneCount, count + 1, memory_order_release);
+  return true;
+}
+
+bool vmupro_instrument_add_zone(vmupro_instrument_t *inst, const vmupro_sound_sample_t *sample,
+                                const vmupro_instrument_zone_t *zone)
+{
+  if (inst == NULL || sample == NULL || zone == NULL || sample->pcm == NULL || sample->frames == 0 ||
+      sample->channels < 1 || sample->channels > 2 || sample->sample_rate < VMUPRO_RESAMPLER_MIN_RATE ||
+      sample->sample_rate > VMUPRO_RESAMPLER_MAX_RATE)
+    return false;
+  Zone z;
+  memset(&z, 0, sizeof(z));
+  z.pcm = sample->pcm;
+  z.resident = z.frames = sample->frames;
+  z.rate = sample->sample_rate;
+  z.channels = sample->channels;
+  return AddZone(inst, &z, zone);
+}
+
+bool vmupro_instrument_add_streamed_zone(vmupro_instrument_t *inst, const char *path, uint32_t head_frames,
+                                         const vmupro_instrument_zone_t *zone)
+{
+  if (inst == NULL || path == NULL || zone == NULL)
+    return false;
+  size_t fileSize = vmupro_get_file_size(path);
+  if (fileSize == (size_t)-1 || fileSize < 12 || fileSize > UINT32_MAX)
+    return false;
+
+  // the format and where the data starts, from the first few KB
+  uint32_t probe = fileSize < HEADER_PROBE ? (uint32_t)fileSize : HEADER_PROBE;
+  uint8_t *header = malloc(probe);
+  vmupro_sound_sample_t info;
+  if (header == NULL)
+    return false;
+  bool found = vmupro_read_file_bytes(path, header, 0, (int)probe) && vmupro_sound_sample_init_wav(&info, header, probe);
+  uint32_t dataOffset = found ? (uint32_t)((const uint8_t *)info.pcm - header) : 0;
+  uint32_t dataBytes = found ? Read32(header + dataOffset - 4) : 0;
+  free(header);
+  if (!found || info.sample_rate < VMUPRO_RESAMPLER_MIN_RATE || info.sample_rate > VMUPRO_RESAMPLER_MAX_RATE)
+    return false;
+
+  // a truncated file plays what it has
+  uint32_t frameBytes = 2 * (uint32_t)info.channels;
+  if (dataBytes > fileSize - dataOffset)
+    dataBytes = (uint32_t)(fileSize - dataOffset);
+  uint32_t frames = dataBytes / frameBytes;
+  uint32_t head = head_frames != 0 ? head_frames : VMUPRO_INSTRUMENT_DEFAULT_HEAD_FRAMES;
+  uint32_t chunkFrames = VMUPRO_INSTRUMENT_STREAM_BYTES / frameBytes;
+  if (head < frames)
+  {
+    // the tail starts on a sector, so every buffer is an aligned read
+    uint64_t tail = ((uint64_t)dataOffset + (uint64_t)head * frameBytes + SECTOR - 1) & ~(uint64_t)(SECTOR - 1);
+    if ((tail - dataOffset) % frameBytes == 0)
+      head = (uint32_t)((tail - dataOffset) / frameBytes);
+  }
+  if (head >= frames)
+    head = frames;
+  else if ((frames - head + chunkFrames - 1) / chunkFrames > MAX_CHUNKS)
+    frames = head + MAX_CHUNKS * chunkFrames;
+  if (frames == 0)
+    return false;
+
+  // the head and the path share one allocation
+  bool streamed = head < frames;
+  size_t headBytes = (size_t)head * frameBytes;
+  size_t pathLen = streamed ? strlen(path) + 1 : 0;
+  uint8_t *block = malloc(headBytes + pathLen);
+  if (block == NULL)
+    return false;
+  if (!vmupro_read_file_bytes(path, block, dataOffset, (int)headBytes))
+  {
+    free(block);
+    return false;
+  }
+
+  Zone z;
+  memset(&z, 0, sizeof(z));
+  z.pcm = (const int16_t *)block;
+  z.resident = head;
+  z.frames = frames;
+  z.rate = info.sample_rate;
+  z.channels = info.channels;
+  z.block = block;
+  if (streamed)
+  {
+    memcpy(block + headBytes, path, pathLen);
+    z.path = (const char *)(block + headBytes);
+    z.tailOffset = dataOffset + (uint32_t)headBytes;
+    z.dataEnd = dataOffset + frames * frameBytes;
+    z.chunkFrames = chunkFrames;
+  }
+
+  size_t bufferBytes = (size_t)inst->polyphony * 2 * VMUPRO_INSTRUMENT_STREAM_BYTES;
+  if (streamed && inst->streamBuffers == NULL)
+  {
+    inst->streamBuffers = malloc(bufferBytes);
+    if (inst->streamBuffers == NULL)
+    {
+      free(block);
+      return false;
+    }
+    inst->residentBytes += (uint32_t)bufferBytes;
+  }
+  if (!AddZone(inst, &z, zone))
+  {
+    free(block);
+    return false;
+  }
+  inst->residentBytes += (uint32_t)headBytes;
+  return true;
+}
+
+void vmupro_instrument_set_steal_policy(vmupro_instrument_t *inst, vmupro_instrument_steal_t policy)
+{
+  if (inst != NULL && policy >= VMUPRO_INSTRUMENT_STEAL_OLDEST && policy <= VMUPRO_INSTRUMENT_STEAL_SAME_NOTE)
+    atomic_store(&inst->policy, (uint8_t)policy);
+}
+
+void vmupro_instrument_set_volume(vmupro_instrument_t *inst, uint16_t left, uint16_t right)
+{
+  if (inst == NULL)
+    return;
+  left = left > MAX_VOLUME ? MAX_VOLUME : left;
+  right = right > MAX_VOLUME ? MAX_VOLUME : right;
+  atomic_store(&inst->volume, (uint32_t)left << 16 | right);
+}
+
+bool vmupro_instrument_play_note(vmupro_instrument_t *inst, int note, int velocity)
+{
+  if (inst == NULL || note < 0 || note > 127 || velocity < 1 || velocity > 127 || !vmupro_synth_engine_is_running())
+    return false;
+  Command cmd = {CMD_NOTE_ON, (uint8_t)note, (uint8_t)velocity};
+  return QueuePost(&inst->commandQueue, &cmd);
+}
+
+void vmupro_instrument_note_off(vmupro_instrument_t *inst, int note)
+{
+  if (inst == NULL || note < 0 || note > 127)
+    return;
+  Command cmd = {CMD_NOTE_OFF, (uint8_t)note, 0};
+  QueuePost(&inst->commandQueue, &cmd);
+}
+
+void vmupro_instrument_stop(vmupro_instrument_t *inst)
+{
+  if (inst == NULL)
+    return;
+  Command cmd = {CMD_STOP, 0, 0};
+  QueuePost(&inst->commandQueue, &cmd);
+}
+
+//
+// Streaming, on the game thread
+//
+
+int vmupro_instrument_update(vmupro_instrument_t *inst)
+{
+  if (inst == NULL || inst->streamBuffers == NULL)
+    return 0;
+  int reads = 0;
+  for (int i = 0; i < inst->polyphony; i++)
+  {
+    Voice *v = &inst->voices[i];
+    uint32_t progress = atomic_load_explicit(&v->progress, memory_order_acquire);
+    const Zone *z = &inst->zones[TAG_ZONE(progress)];
+    if (progress == 0 || z->path == NULL)
+      continue;
+    // the chunk being read and the one after it
+    for (uint32_t chunk = TAG_CHUNK(progress); chunk <= TAG_CHUNK(progress) + 1; chunk++)
+    {
+      uint32_t tag = (progress & ~0xffffu) | chunk;
+      uint32_t offset = z->tailOffset + chunk * VMUPRO_INSTRUMENT_STREAM_BYTES;
+      if (offset >= z->dataEnd || atomic_load_explicit(&v->filled[chunk & 1], memory_order_relaxed) == tag)
+        continue;
+      uint32_t len = z->dataEnd - offset < VMUPRO_INSTRUMENT_STREAM_BYTES ? z->dataEnd - offset
+                                                                           : VMUPRO_INSTRUMENT_STREAM_BYTES;
+      uint64_t start = vmupro_get_time_us();
+      if (!vmupro_read_file_bytes(z->path, (uint8_t *)StreamBuffer(inst, v, chunk), offset, (int)len))
+        break;
+      uint32_t us = (uint32_t)(vmupro_get_time_us() - start);
+      inst->streamReads++;
+      inst->streamBytes += len;
+      if (us > inst->maxReadUs)
+        inst->maxReadUs = us;
+      atomic_store_explicit(&v->filled[chunk & 1], tag, memory_order_release);
+      reads++;
+    }
+  }
+  return reads;
+}
+
+int vmupro_instrument_get_active_voices(const vmupro_instrument_t *inst)
+{
+  if (inst == NULL)
+    return 0;
+  return atomic_load_explicit(&((vmupro_instrument_t *)inst)->activeVoices, memory_order_relaxed);
+}
+
+void vmupro_instrument_get_stats(const vmupro_instrument_t *inst, vmupro_instrument_stats_t *out_stats)
+{
+  if (out_stats == NULL)
+    return;
+  if (inst == NULL)
+  {
+    memset(out_stats, 0, sizeof(*out_stats));
+    return;
+  }
+  *out_stats = inst->stats;
+  out_stats->stream_reads = inst->streamReads;
+  out_stats->stream_bytes = inst->streamBytes;
+  out_stats->max_read_us = inst->maxReadUs;
+  out_stats->resident_bytes = inst->residentBytes;
+}
@@ -0,0 +1,694 @@
+// sdk/c/src/vmupro_mixer.c
+//
+// Sound samples and the software mixer, see vmupro_mixer.h
+// The game thread and the audio task share two single producer/single
+// consumer queues: commands one way, finished voices the other. Whether a
+// voice is busy is published through one atomic word per voice.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "vmupro_audio.h"
+#include "vmupro_audio_pull.h"
+#include "vmupro_file.h"
+#include "vmupro_utils.h"
+#include "vmupro_mixer.h"
+#include "vmupro_audio_internal.h"
+
+#define COMMAND_SLOTS 64
+#define EVENT_SLOTS 64
+#define MAX_VOLUME (VMUPRO_MIXER_UNITY * 4)
+#define MAX_RATE (VMUPRO_MIXER_RATE_ONE * 16)
+
+typedef enum
+{
+  CMD_PLAY = 0,
+  CMD_STOP,
+  CMD_VOLUME,
+  CMD_RATE,
+} CommandType;
+
+typedef struct
+{
+  uint8_t type;
+  uint8_t slot;
+  uint32_t generation;
+  const vmupro_sound_sample_t *sample;
+  int32_t a, b;
+  uint16_t left, right;
+  vmupro_sound_finished_t finished;
+  void *user;
+} Command;
+
+typedef struct
+{
+  int voice;
+  vmupro_sound_finished_t finished;
+  void *user;
+} Event;
+
+// Owned by the audio task
+typedef struct
+{
+  bool active;
+  uint32_t generation;
+  const int16_t *pcm;
+  uint32_t frames;
+  uint32_t sampleRate;
+  uint8_t channels;
+  uint64_t pos; // 16.16 frames into the sample
+  uint32_t step;
+  int repeats;
+  int32_t gainL, gainR;
+  vmupro_sound_finished_t finished;
+  void *user;
+} Voice;
+
+static Voice voices[VMUPRO_MIXER_MAX_VOICES];
+static int voiceCount = 0;
+
+// generation << 1 | busy, set busy by the game thread, cleared by the audio task
+static _Atomic uint32_t voiceStatus[VMUPRO_MIXER_MAX_VOICES];
+
+// Owned by the game thread
+static uint32_t slotGeneration[VMUPRO_MIXER_MAX_VOICES];
+static const vmupro_sound_sample_t *slotSample[VMUPRO_MIXER_MAX_VOICES];
+
+static Command commands[COMMAND_SLOTS];
+static Queue commandQueue = QUEUE_OF(commands);
+static Event events[EVENT_SLOTS];
+static Queue eventQueue = QUEUE_OF(events);
+
+static atomic_bool running = false;
+// started by vmupro_mixer_start(), mixing on the pull mode audio task
+static bool ownsOutput = false;
+static vmupro_mixer_stats_t mixerStats;
+
+static int32_t mixAcc[VMUPRO_MIXER_BLOCK_FRAMES * 2];
+
+static inline uint32_t StepFor(uint32_t sampleRate, uint32_t rate)
+{
+  return (uint32_t)(((uint64_t)sampleRate * rate + VMUPRO_MIXER_RATE / 2) / VMUPRO_MIXER_RATE);
+}
+
+static inline int VoiceHandle(int slot, uint32_t generation)
+{
+  return (int)(generation << 8) | slot;
+}
+
+//
+// Queues
+//
+
+// Whether the pull mode task renders the mixer: its own task, or the
+// app's pull mode callback rendering a manual mixer. Otherwise nothing
+// empties the command queue but the game thread's own renders.
+static bool AudioTaskRendering(void)
+{
+  return atomic_load(&running) && vmupro_audio_pull_renders(AUDIO_ENGINE_MIXER);
+}
+
+static void PostCommandWait(const Command *cmd)
+{
+  QueuePostWait(&commandQueue, cmd, AudioTaskRendering);
+}
+
+static void PostEvent(int voice, vmupro_sound_finished_t finished, void *user)
+{
+  Event e = {voice, finished, user};
+  QueuePost(&eventQueue, &e);
+}
+
+//
+// Audio task
+//
+
+static void EndVoice(int slot, bool notify)
+{
+  Voice *v = &voices[slot];
+  v->active = false;
+  if (notify && v->finished != NULL)
+    PostEvent(VoiceHandle(slot, v->generation), v->finished, v->user);
+  atomic_store_explicit(&voiceStatus[slot], v->generation << 1, memory_order_release);
+}
+
+static void RunCommands(void)
+{
+  uint32_t tail;
+  uint32_t head = QueuePending(&commandQueue, &tail);
+  for (; tail != head; tail++)
+  {
+    const Command *cmd = QueueAt(&commandQueue, tail);
+    Voice *v = &voices[cmd->slot];
+    if (cmd->type == CMD_PLAY)
+    {
+      const vmupro_sound_sample_t *s = cmd->sample;
+      v->active = true;
+      v->generation = cmd->generation;
+      v->pcm = s->pcm;
+      v->frames = s->frames;
+      v->sampleRate = s->sample_rate;
+      v->channels = s->channels;
+      v->pos = 0;
+      v->step = StepFor(s->sample_rate, (uint32_t)cmd->b);
+      v->repeats = cmd->a;
+      v->gainL = cmd->left;
+      v->gainR = cmd->right;
+      v->finished = cmd->finished;
+      v->user = cmd->user;
+      continue;
+    }
+    if (!v->active || v->generation != cmd->generation)
+      continue;
+    if (cmd->type == CMD_STOP)
+    {
+      EndVoice(cmd->slot, false);
+    }
+    else if (cmd->type == CMD_VOLUME)
+    {
+      v->gainL = cmd->left;
+      v->gainR = cmd->right;
+    }
+    else if (cmd->type == CMD_RATE)
+    {
+      v->step = StepFor(v->sampleRate, (uint32_t)cmd->a);
+    }
+  }
+  QueueConsumed(&commandQueue, tail);
+}
+
+// With no audio task nothing else empties the queue, so the game thread
+// applies the pending commands itself and ends the sample's voices
+static void RetireSample(const vmupro_sound_sample_t *sample)
+{
+  if (!atomic_load(&running))
+    return;
+  RunCommands();
+  for (int i = 0; i < voiceCount; i++)
+  {
+    if (slotSample[i] == sample && (atomic_load_explicit(&voiceStatus[i], memory_order_acquire) & 1))
+      EndVoice(i, false);
+  }
+}
+
+// Straight copy for samples at the output rate, the common case
+static int MixVoiceUnity(Voice *v, int32_t *acc, int count)
+{
+  uint32_t at = (uint32_t)(v->pos >> 16);
+  int n = v->frames - at < (uint32_t)count ? (int)(v->frames - at) : count;
+  int32_t gl = v->gainL, gr = v->gainR;
+  if (v->channels == 1)
+  {
+    const int16_t *src = v->pcm + at;
+    for (int i = 0; i < n; i++)
+    {
+      acc[i * 2] += src[i] * gl;
+      acc[i * 2 + 1] += src[i] * gr;
+    }
+  }
+  else
+  {
+    const int16_t *src = v->pcm + at * 2;
+    for (int i = 0; i < n; i++)
+    {
+      acc[i * 2] += src[i * 2] * gl;
+      acc[i * 2 + 1] += src[i * 2 + 1] * gr;
+    }
+  }
+  v->pos += (uint64_t)n << 16;
+  return n;
+}
+
+// Any other rate, linear interpolation between neighbouring frames with a
+// 15-bit fraction so the product stays within 32 bits
+static int MixVoiceResampled(Voice *v, int32_t *acc, int count)
+{
+  uint64_t end = (uint64_t)v->frames << 16;
+  int32_t gl = v->gainL, gr = v->gainR;
+  int stride = v->channels;
+  int last = v->channels - 1;
+  int n = 0;
+  while (n < count && v->pos < end)
+  {
+    uint32_t at = (uint32_t)(v->pos >> 16);
+    int32_t frac = (int32_t)(v->pos & 0xffff) >> 1;
+    const int16_t *a = v->pcm + at * stride;
+    const int16_t *b = at + 1 < v->frames ? a + stride : a;
+    int32_t l = a[0] + (((b[0] - a[0]) * frac) >> 15);
+    int32_t r = a[last] + (((b[last] - a[last]) * frac) >> 15);
+    acc[n * 2] += l * gl;
+    acc[n * 2 + 1] += r * gr;
+    v->pos += v->step;
+    n++;
+  }
+  return n;
+}
+
+static void MixVoice(int slot, int32_t *acc, int count)
+{
+  Voice *v = &voices[slot];
+  int done = 0;
+  while (done < count)
+  {
+    if (v->step == VMUPRO_MIXER_RATE_ONE && (v->pos & 0xffff) == 0)
+      done += MixVoiceUnity(v, acc + done * 2, count - done);
+    else
+      done += MixVoiceResampled(v, acc + done * 2, count - done);
+
+    if (v->pos >= (uint64_t)v->frames << 16)
+    {
+      if (v->repeats == 0 || v->frames == 0)
+      {
+        EndVoice(slot, true);
+        return;
+      }
+      v->repeats--;
+      v->pos -= (uint64_t)v->frames << 16;
+    }
+  }
+}
+
+// Mix up to one block, 8.8 gains packed back to 16 bits with saturation
+static void MixBlock(int16_t *out, int frames)
+{
+  uint64_t start = vmupro_get_time_us();
+  memset(mixAcc, 0, frames * 2 * sizeof(int32_t));
+  int active = 0;
+  for (int i = 0; i < voiceCount; i++)
+  {
+    if (!voices[i].active)
+      continue;
+    active++;
+    MixVoice(i, mixAcc, frames);
+  }
+
+  uint32_t clipped = 0;
+  for (int i = 0; i < frames * 2; i++)
+  {
+    int32_t s = mixAcc[i] >> 8;
+    if (s > INT16_MAX || s < INT16_MIN)
+    {
+      s = s > INT16_MAX ? INT16_MAX : INT16_MIN;
+      clipped++;
+    }
+    out[i] = (int16_t)s;
+  }
+
+  uint32_t us = (uint32_t)(vmupro_get_time_us() - start);
+  mixerStats.blocks++;
+  mixerStats.clipped += clipped;
+  mixerStats.active_voices = (uint8_t)active;
+  if (active > mixerStats.peak_voices)
+    mixerStats.peak_voices = (uint8_t)active;
+  mixerStats.last_mix_us = us;
+  if (us > mixerStats.max_mix_us)
+    mixerStats.max_mix_us = us;
+  mixerStats.total_mix_us += us;
+}
+
+static void RenderFrames(int16_t *stereo, int frames)
+{
+  vmupro_audio_pull_note_render(AUDIO_ENGINE_MIXER);
+  RunCommands();
+  while (frames > 0)
+  {
+    int n = frames < VMUPRO_MIXER_BLOCK_FRAMES ? frames : VMUPRO_MIXER_BLOCK_FRAMES;
+    MixBlock(stereo, n);
+    stereo += n * 2;
+    frames -= n;
+  }
+}
+
+// Pull mode callback, on the audio task
+static void MixerFill(int16_t *samples, int frames, void *user)
+{
+  (void)user;
+  RenderFrames(samples, frames);
+}
+
+//
+// Mixer
+//
+
+static void ResetVoices(void)
+{
+  for (int i = 0; i < VMUPRO_MIXER_MAX_VOICES; i++)
+  {
+    voices[i].active = false;
+    atomic_store(&voiceStatus[i], slotGeneration[i] << 1);
+    slotSample[i] = NULL;
+  }
+  QueueClear(&commandQueue);
+  QueueClear(&eventQueue);
+}
+
+static bool Open(int voice_count)
+{
+  if (atomic_load(&running) || voice_count < 1 || voice_count > VMUPRO_MIXER_MAX_VOICES)
+    return false;
+  voiceCount = voice_count;
+  memset(&mixerStats, 0, sizeof(mixerStats));
+  ResetVoices();
+  atomic_store(&running, true);
+  return true;
+}
+
+bool vmupro_mixer_start(int voice_count)
+{
+  if (atomic_load(&running))
+    return ownsOutput;
+  if (!Open(voice_count))
+    return false;
+
+  vmupro_audio_pull_config_t config = {VMUPRO_MIXER_BLOCK_FRAMES,
+                                       VMUPRO_MIXER_LATENCY_FRAMES / VMUPRO_MIXER_BLOCK_FRAMES, true, true};
+  if (!vmupro_audio_pull_start(&config, MixerFill, NULL))
+  {
+    atomic_store(&running, false);
+    return false;
+  }
+  vmupro_audio_pull_claim(AUDIO_ENGINE_MIXER);
+  ownsOutput = true;
+  return true;
+}
+
+bool vmupro_mixer_start_manual(int voice_count)
+{
+  if (atomic_load(&running))
+    return !ownsOutput;
+  return Open(voice_count);
+}
+
+void vmupro_mixer_render(int16_t *stereo, int frames)
+{
+  if (stereo == NULL || frames <= 0)
+    return;
+  if (!atomic_load(&running) || ownsOutput)
+  {
+    memset(stereo, 0, (size_t)frames * 2 * sizeof(int16_t));
+    return;
+  }
+  RenderFrames(stereo, frames);
+}
+
+void vmupro_mixer_stop(void)
+{
+  if (!atomic_load(&running))
+    return;
+  if (ownsOutput)
+    vmupro_audio_pull_stop();
+  atomic_store(&running, false);
+  ownsOutput = false;
+  ResetVoices();
+}
+
+bool vmupro_mixer_is_running(void)
+{
+  return atomic_load(&running);
+}
+
+void vmupro_mixer_get_stats(vmupro_mixer_stats_t *out_stats)
+{
+  if (out_stats != NULL)
+    *out_stats = mixerStats;
+}
+
+//
+// Samples
+//
+
+bool vmupro_sound_sample_init(vmupro_sound_sample_t *sample, const int16_t *pcm, uint32_t frames,
+                              uint8_t channels, uint32_t sample_rate)
+{
+  if (sample == NULL || (pcm == NULL && frames != 0) || ((uintptr_t)pcm & 1) != 0 || channels < 1 ||
+      channels > 2 || sample_rate == 0 || sample_rate > VMUPRO_MIXER_RATE * 4)
+    return false;
+  sample->pcm = pcm;
+  sample->frames = frames;
+  sample->sample_rate = sample_rate;
+  sample->channels = channels;
+  sample->allocated = false;
+  sample->volume_left = VMUPRO_MIXER_UNITY;
+  sample->volume_right = VMUPRO_MIXER_UNITY;
+  sample->rate = VMUPRO_MIXER_RATE_ONE;
+  return true;
+}
+
+bool vmupro_sound_sample_init_wav(vmupro_sound_sample_t *sample, const uint8_t *wav, uint32_t size)
+{
+  if (wav == NULL || size < 12 || memcmp(wav, "RIFF", 4) != 0 || memcmp(wav + 8, "WAVE", 4) != 0)
+    return false;
+
+  int channels = 0;
+  uint32_t rate = 0;
+  bool pcm16 = false;
+  uint32_t at = 12;
+  while (at + 8 <= size)
+  {
+    uint32_t chunk = Read32(wav + at + 4);
+    const uint8_t *body = wav + at + 8;
+    uint32_t avail = size - at - 8;
+    if (memcmp(wav + at, "fmt ", 4) == 0 && chunk >= 16 && chunk <= avail)
+    {
+      uint16_t format = Read16(body);
+      channels = Read16(body + 2);
+      rate = Read32(body + 4);
+      // 1 is PCM, 0xfffe (extensible) is accepted for its usual 16-bit PCM contents,
+      // checked here so the data chunk never divides by a bad channel count
+      pcm16 = (format == 1 || format == 0xfffe) && Read16(body + 14) == 16 && channels >= 1 && channels <= 2;
+    }
+    else if (memcmp(wav + at, "data", 4) == 0)
+    {
+      if (!pcm16)
+        return false;
+      // a truncated file plays what it has
+      uint32_t bytes = chunk < avail ? chunk : avail;
+      return vmupro_sound_sample_init(sample, (const int16_t *)body, bytes / (2 * (uint32_t)channels),
+                                      (uint8_t)channels, rate);
+    }
+    if (chunk > avail)
+      return false;
+    at += 8 + chunk + (chunk & 1);
+  }
+  return false;
+}
+
+vmupro_sound_sample_t *vmupro_sound_sample_new(const char *path)
+{
+  size_t size = vmupro_get_file_size(path);
+  if (size == (size_t)-1 || size < 12 || size > UINT32_MAX)
+    return NULL;
+
+  // the sample and the file share one allocation, the file 4 byte aligned after it
+  size_t header = (sizeof(vmupro_sound_sample_t) + 3) & ~(size_t)3;
+  uint8_t *block = malloc(header + size);
+  if (block == NULL)
+    return NULL;
+  vmupro_sound_sample_t *sample = (vmupro_sound_sample_t *)block;
+  size_t read = 0;
+  if (!vmupro_read_file_complete(path, block + header, &read) ||
+      !vmupro_sound_sample_init_wav(sample, block + header, (uint32_t)read))
+  {
+    free(block);
+    return NULL;
+  }
+  sample->allocated = true;
+  return sample;
+}
+
+void vmupro_sound_sample_free(vmupro_sound_sample_t *sample)
+{
+  if (sample == NULL)
+    return;
+  vmupro_sound_sample_stop(sample);
+  while (vmupro_sound_sample_is_playing(sample))
+  {
+    if (!AudioTaskRendering())
+    {
+      RetireSample(sample);
+      break;
+    }
+    vmupro_sleep_ms(1);
+  }
+  if (sample->allocated)
+    free(sample);
+}
+
+int vmupro_sound_sample_play(vmupro_sound_sample_t *sample, int repeat_count, vmupro_sound_finished_t finished,
+                             void *user)
+{
+  if (sample == NULL || !atomic_load(&running))
+    return -1;
+
+  int slot = -1;
+  for (int i = 0; i < voiceCount; i++)
+  {
+    if ((atomic_load_explicit(&voiceStatus[i], memory_order_acquire) & 1) == 0)
+    {
+      slot = i;
+      break;
+    }
+  }
+  if (slot < 0)
+  {
+    mixerStats.voices_refused++;
+    return -1;
+  }
+
+  uint32_t generation = (slotGeneration[slot] + 1) & 0x7fffff;
+  if (generation == 0)
+    generation = 1;
+  Command cmd = {CMD_PLAY, (uint8_t)slot, generation, sample, repeat_count < 0 ? 0 : repeat_count,
+                 (int32_t)sample->rate, sample->volume_left, sample->volume_right, finished, user};
+  if (!QueuePost(&commandQueue, &cmd))
+  {
+    mixerStats.voices_refused++;
+    return -1;
+  }
+  slotGeneration[slot] = generation;
+  slotSample[slot] = sample;
+  atomic_store_explicit(&voiceStatus[slot], generation << 1 | 1, memory_order_release);
+  mixerStats.voices_started++;
+  return VoiceHandle(slot, generation);
+}
+
+// Voices the game thread last started with sample that haven't ended
+static inline bool SlotPlaying(int slot, const vmupro_sound_sample_t *sample)
+{
+  return slotSample[slot] == sample && (atomic_load_explicit(&voiceStatus[slot], memory_order_acquire) & 1);
+}
+
+void vmupro_sound_sample_stop(const vmupro_sound_sample_t *sample)
+{
+  for (int i = 0; i < voiceCount; i++)
+  {
+    if (SlotPlaying(i, sample))
+      vmupro_mixer_voice_stop(VoiceHandle(i, slotGeneration[i]));
+  }
+}
+
+bool vmupro_sound_sample_is_playing(const vmupro_sound_sample_t *sample)
+{
+  if (sample == NULL)
+    return false;
+  for (int i = 0; i < voiceCount; i++)
+  {
+    if (SlotPlaying(i, sample))
+      return true;
+  }
+  return false;
+}
+
+void vmupro_sound_sample_set_volume(vmupro_sound_sample_t *sample, uint16_t left, uint16_t right)
+{
+  if (sample == NULL)
+    return;
+  sample->volume_left = left > MAX_VOLUME ? MAX_VOLUME : left;
+  sample->volume_right = right > MAX_VOLUME ? MAX_VOLUME : right;
+  for (int i = 0; i < voiceCount; i++)
+  {
+    if (SlotPlaying(i, sample))
+      vmupro_mixer_voice_set_volume(VoiceHandle(i, slotGeneration[i]), sample->volume_left, sample->volume_right);
+  }
+}
+
+void vmupro_sound_sample_get_volume(const vmupro_sound_sample_t *sample, uint16_t *left, uint16_t *right)
+{
+  if (left)
+    *left = sample ? sample->volume_left : 0;
+  if (right)
+    *right = sample ? sample->volume_right : 0;
+}
+
+void vmupro_sound_sample_set_rate(vmupro_sound_sample_t *sample, uint32_t rate)
+{
+  if (sample == NULL)
+    return;
+  sample->rate = rate == 0 ? 1 : rate > MAX_RATE ? MAX_RATE : rate;
+  for (int i = 0; i < voiceCount; i++)
+  {
+    if (SlotPlaying(i, sample))
+      vmupro_mixer_voice_set_rate(VoiceHandle(i, slotGeneration[i]), sample->rate);
+  }
+}
+
+uint32_t vmupro_sound_sample_get_rate(const vmupro_sound_sample_t *sample)
+{
+  return sample ? sample->rate : 0;
+}
+
+void vmupro_sound_update(void)
+{
+  uint32_t tail;
+  uint32_t head = QueuePending(&eventQueue, &tail);
+  for (; tail != head; tail++)
+  {
+    Event e = *(const Event *)QueueAt(&eventQueue, tail);
+    // release the slot first, so the callback can queue more events
+    QueueConsumed(&eventQueue, tail + 1);
+    e.finished(e.voice, e.user);
+  }
+}
+
+//
+// Voices
+//
+
+static bool VoiceSlot(int voice, int *slot, uint32_t *generation)
+{
+  if (voice < 0)
+    return false;
+  *slot = voice & 0xff;
+  *generation = (uint32_t)voice >> 8;
+  return *slot < voiceCount;
+}
+
+void vmupro_mixer_voice_stop(int voice)
+{
+  int slot;
+  uint32_t generation;
+  if (!vmupro_mixer_voice_is_playing(voice) || !VoiceSlot(voice, &slot, &generation))
+    return;
+  Command cmd = {CMD_STOP, (uint8_t)slot, generation, NULL, 0, 0, 0, 0, NULL, NULL};
+  PostCommandWait(&cmd);
+}
+
+bool vmupro_mixer_voice_is_playing(int voice)
+{
+  int slot;
+  uint32_t generation;
+  if (!VoiceSlot(voice, &slot, &generation))
+    return false;
+  return atomic_load_explicit(&voiceStatus[slot], memory_order_acquire) == (generation << 1 | 1);
+}
+
+void vmupro_mixer_voice_set_volume(int voice, uint16_t left, uint16_t right)
+{
+  int slot;
+  uint32_t generation;
+  if (!vmupro_mixer_voice_is_playing(voice) || !VoiceSlot(voice, &slot, &generation))
+    return;
+  Command cmd = {CMD_VOLUME, (uint8_t)slot, generation, NULL, 0, 0, left > MAX_VOLUME ? MAX_VOLUME : left,
+                 right > MAX_VOLUME ? MAX_VOLUME : right, NULL, NULL};
+  PostCommandWait(&cmd);
+}
+
+void vmupro_mixer_voice_set_pan(int voice, uint16_t volume, int pan)
+{
+  pan = pan < -128 ? -128 : pan > 127 ? 127 : pan;
+  int left = pan > 0 ? volume * (127 - pan) / 127 : volume;
+  int right = pan < 0 ? volume * (128 + pan) / 128 : volume;
+  vmupro_mixer_voice_set_volume(voice, (uint16_t)left, (uint16_t)right);
+}
+
+void vmupro_mixer_voice_set_rate(int voice, uint32_t rate)
+{
+  int slot;
+  uint32_t generation;
+  if (!vmupro_mixer_voice_is_playing(voice) || !VoiceSlot(voice, &slot, &generation))
+    return;
+  rate = rate == 0 ? 1 : rate > MAX_RATE ? MAX_RATE : rate;
+  Command cmd = {CMD_RATE, (uint8_t)slot, generation, NULL, (int32_t)rate, 0, 0, 0, NULL, NULL};
+  PostCommandWait(&cmd);
+}
@@ -0,0 +1,151 @@
+// sdk/c/src/vmupro_profile.c
+//
+// Per function call counters for VMUPRO_PROFILE builds, see vmupro_profile.h
+
+#define VMUPRO_PROFILE_INTERNAL
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "vmupro_log.h"
+#include "vmupro_utils.h"
+#include "vmupro_profile.h"
+
+static vmupro_profile_entry_t entries[VMUPRO_PROF_COUNT] = {
+    [VMUPRO_PROF_DISPLAY_CLEAR] = {"vmupro_display_clear"},
+    [VMUPRO_PROF_DISPLAY_REFRESH] = {"vmupro_display_refresh"},
+    [VMUPRO_PROF_PUSH_DOUBLE_BUFFER_FRAME] = {"vmupro_push_double_buffer_frame"},
+    [VMUPRO_PROF_DRAW_FILL_RECT] = {"vmupro_draw_fill_rect"},
+    [VMUPRO_PROF_DRAW_LINE] = {"vmupro_draw_line"},
+    [VMUPRO_PROF_DRAW_TEXT] = {"vmupro_draw_text"},
+    [VMUPRO_PROF_BLIT_BUFFER_AT] = {"vmupro_blit_buffer_at"},
+    [VMUPRO_PROF_BLIT_BUFFER_TRANSPARENT] = {"vmupro_blit_buffer_transparent"},
+    [VMUPRO_PROF_BLIT_BUFFER_BLENDED] = {"vmupro_blit_buffer_blended"},
+    [VMUPRO_PROF_BLIT_BUFFER_FLIPPED] = {"vmupro_blit_buffer_flipped"},
+    [VMUPRO_PROF_BLIT_BUFFER_SCALED] = {"vmupro_blit_buffer_scaled"},
+    [VMUPRO_PROF_BLIT_BUFFER_AFFINE] = {"vmupro_blit_buffer_affine"},
+    [VMUPRO_PROF_BLIT_TILE] = {"vmupro_blit_tile"},
+    [VMUPRO_PROF_BLIT_TILE_ADVANCED] = {"vmupro_blit_tile_advanced"},
+    [VMUPRO_PROF_BLIT_SCROLLING_BACKGROUND] = {"vmupro_blit_scrolling_background"},
+    [VMUPRO_PROF_APPLY_MOSAIC_TO_SCREEN] = {"vmupro_apply_mosaic_to_screen"},
+    [VMUPRO_PROF_SPRITE_BATCH_RENDER] = {"vmupro_sprite_batch_render"},
+    [VMUPRO_PROF_TILEMAP_RENDER] = {"vmupro_tilemap_render"},
+    [VMUPRO_PROF_RENDER_ALL_LAYERS] = {"vmupro_render_all_layers"},
+    [VMUPRO_PROF_RENDER_LAYERS_RASTER] = {"vmupro_render_layers_raster"},
+    [VMUPRO_PROF_DISPLAY_LIST_REPLAY] = {"vmupro_display_list_replay"},
+    [VMUPRO_PROF_AUDIO_ADD_STREAM_SAMPLES] = {"vmupro_audio_add_stream_samples"},
+    [VMUPRO_PROF_READ_FILE_COMPLETE] = {"vmupro_read_file_complete"},
+    [VMUPRO_PROF_READ_FILE_BYTES] = {"vmupro_read_file_bytes"},
+    [VMUPRO_PROF_WRITE_FILE_COMPLETE] = {"vmupro_write_file_complete"},
+    [VMUPRO_PROF_WRITE_FILE_BYTES] = {"vmupro_write_file_bytes"},
+};
+
+static vmupro_profile_summary_t summary;
+static uint64_t frameStartUs = 0;
+
+void vmupro_profile_reset(void)
+{
+  for (int i = 0; i < VMUPRO_PROF_COUNT; i++)
+  {
+    entries[i].calls = 0;
+    entries[i].units = 0;
+    entries[i].total_us = 0;
+    entries[i].max_us = 0;
+  }
+  memset(&summary, 0, sizeof(summary));
+  frameStartUs = vmupro_get_time_us();
+}
+
+void vmupro_profile_record(vmupro_profile_id_t id, uint64_t start_us, uint32_t units)
+{
+  if ((unsigned)id >= VMUPRO_PROF_COUNT)
+    return;
+
+  uint32_t us = (uint32_t)(vmupro_get_time_us() - start_us);
+  vmupro_profile_entry_t *e = &entries[id];
+  e->calls++;
+  e->units += units;
+  e->total_us += us;
+  if (us > e->max_us)
+    e->max_us = us;
+}
+
+void vmupro_profile_frame(void)
+{
+  uint64_t now = vmupro_get_time_us();
+  // the first frame after boot or a reset has no start to measure from
+  if (frameStartUs != 0)
+  {
+    uint32_t us = (uint32_t)(now - frameStartUs);
+    summary.frames++;
+    summary.frame_us += us;
+    if (us > summary.max_frame_us)
+      summary.max_frame_us = us;
+  }
+  frameStartUs = now;
+}
+
+void vmupro_profile_audio_fill(int fill_percent)
+{
+  uint8_t fill = (uint8_t)(fill_percent < 0 ? 0 : fill_percent > 100 ? 100 : fill_percent);
+  if (summary.audio_samples == 0 || fill < summary.audio_fill_min)
+    summary.audio_fill_min = fill;
+  summary.audio_fill_last = fill;
+  summary.audio_samples++;
+}
+
+const vmupro_profile_entry_t *vmupro_profile_get_entries(void)
+{
+  return entries;
+}
+
+void vmupro_profile_get_summary(vmupro_profile_summary_t *out_summary)
+{
+  if (out_summary)
+    *out_summary = summary;
+}
+
+int vmupro_profile_get_ranking(vmupro_profile_id_t *out_ids, int max_ids)
+{
+  // insertion sort of the called functions, there are only a few dozen
+  vmupro_profile_id_t order[VMUPRO_PROF_COUNT];
+  int count = 0;
+  for (int i = 0; i < VMUPRO_PROF_COUNT; i++)
+  {
+    if (entries[i].calls == 0)
+      continue;
+    int j = count++;
+    while (j > 0 && entries[order[j - 1]].total_us < entries[i].total_us)
+    {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = (vmupro_profile_id_t)i;
+  }
+
+  if (out_ids == NULL)
+    return count;
+  if (count > max_ids)
+    count = max_ids;
+  memcpy(out_ids, order, sizeof(order[0]) * count);
+  return count;
+}
+
+void vmupro_profile_dump_csv(void)
+{
+  vmupro_profile_id_t order[VMUPRO_PROF_COUNT];
+  int count = vmupro_profile_get_ranking(order, VMUPRO_PROF_COUNT);
+  uint32_t frames = summary.frames ? summary.frames : 1;
+
+  vmupro_log(VMUPRO_LOG_INFO, "PROFILE", "name,calls,units,total_us,us_per_frame,max_us");
+  for (int i = 0; i < count; i++)
+  {
+    const vmupro_profile_entry_t *e = &entries[order[i]];
+    vmupro_log(VMUPRO_LOG_INFO, "PROFILE", "%s,%lu,%llu,%llu,%llu,%lu", e->name, (unsigned long)e->calls,
+               (unsigned long long)e->units, (unsigned long long)e->total_us,
+               (unsigned long long)(e->total_us / frames), (unsigned long)e->max_us);
+  }
+  vmupro_log(VMUPRO_LOG_INFO, "PROFILE", "frames,avg_frame_us,max_frame_us,audio_fill_min,audio_fill_last");
+  vmupro_log(VMUPRO_LOG_INFO, "PROFILE", "%lu,%llu,%lu,%d,%d", (unsigned long)summary.frames,
+             (unsigned long long)(summary.frame_us / frames), (unsigned long)summary.max_frame_us,
+             summary.audio_fill_min, summary.audio_fill_last);
+}
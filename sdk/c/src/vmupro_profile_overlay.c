@@ -0,0 +1,53 @@
+// sdk/c/src/vmupro_profile_overlay.c
+//
+// On screen view of the VMUPRO_PROFILE counters, see vmupro_profile.h
+// Kept apart from the counters so builds without text rendering can
+// still log them
+
+#define VMUPRO_PROFILE_INTERNAL
+#include <stdint.h>
+#include <string.h>
+#include "vmupro_display.h"
+#include "vmupro_fonts.h"
+#include "vmupro_utils.h"
+#include "vmupro_profile.h"
+
+#define LINE_H 9
+#define PANEL_W 234
+
+void vmupro_profile_draw_overlay(int x, int y, int rows)
+{
+  vmupro_profile_summary_t summary;
+  vmupro_profile_get_summary(&summary);
+  const vmupro_profile_entry_t *entries = vmupro_profile_get_entries();
+
+  vmupro_profile_id_t order[VMUPRO_PROF_COUNT];
+  int count = vmupro_profile_get_ranking(order, rows < VMUPRO_PROF_COUNT ? (rows < 0 ? 0 : rows) : VMUPRO_PROF_COUNT);
+  uint32_t frames = summary.frames ? summary.frames : 1;
+
+  vmupro_set_font(VMUPRO_FONT_TINY_6x8);
+  vmupro_draw_fill_rect(x, y, x + PANEL_W - 1, y + (count + 1) * LINE_H + 1, VMUPRO_COLOR_BLACK);
+
+  char line[48];
+  uint32_t avg = (uint32_t)(summary.frame_us / frames);
+  vmupro_snprintf(line, sizeof(line), "frame %lu.%02lums max %lu.%02lu", (unsigned long)(avg / 1000),
+                  (unsigned long)(avg % 1000 / 10), (unsigned long)(summary.max_frame_us / 1000),
+                  (unsigned long)(summary.max_frame_us % 1000 / 10));
+  if (summary.audio_samples)
+  {
+    size_t len = strlen(line);
+    vmupro_snprintf(line + len, sizeof(line) - len, " aud %d%%", summary.audio_fill_min);
+  }
+  // a frame over budget at 60fps is drawn in red
+  vmupro_draw_text(line, x + 2, y + 1, avg > 16667 ? VMUPRO_COLOR_RED : VMUPRO_COLOR_GREEN, VMUPRO_COLOR_BLACK);
+
+  for (int i = 0; i < count; i++)
+  {
+    const vmupro_profile_entry_t *e = &entries[order[i]];
+    // "vmupro_" adds nothing on a 40 column line
+    const char *name = strncmp(e->name, "vmupro_", 7) == 0 ? e->name + 7 : e->name;
+    vmupro_snprintf(line, sizeof(line), "%-24.24s%6lu %5lux", name, (unsigned long)(e->total_us / frames),
+                    (unsigned long)((e->calls + frames / 2) / frames));
+    vmupro_draw_text(line, x + 2, y + 1 + (i + 1) * LINE_H, VMUPRO_COLOR_WHITE, VMUPRO_COLOR_BLACK);
+  }
+}
@@ -0,0 +1,386 @@
+// sdk/c/src/vmupro_resampler.c
+//
+// Fixed point sample rate conversion, see vmupro_resampler.h
+// The position between source frames is kept in 0.32 fixed point. The top
+// 6 bits pick one of the 64 filter phases and the next 15 interpolate to
+// the following one, so any ratio works without a table per rate.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "vmupro_audio.h"
+#include "vmupro_resampler.h"
+#include "vmupro_audio_internal.h"
+
+#define OUTPUT_RATE 44100
+#define PI 3.14159265358979323846
+#define COEF_BITS 14
+#define PHASE_BITS 6
+#define STREAM_CHUNK 256
+// passband edge as a fraction of the lower Nyquist rate
+#define SINC_CUTOFF 0.9
+
+static vmupro_resampler_t streamResampler;
+static bool streamConvert = false;
+static bool streamRateControl = false;
+static vmupro_rate_control_t streamControl;
+static uint32_t streamQueued;
+static vmupro_stereo_mode_t streamMode = VMUPRO_AUDIO_MONO;
+static int16_t streamBuf[STREAM_CHUNK * 2];
+
+static double Sinc(double x)
+{
+  if (fabs(x) < 1e-9)
+    return 1.0;
+  return sin(PI * x) / (PI * x);
+}
+
+// Blackman window over [0, 1]
+static double Window(double t)
+{
+  if (t <= 0.0 || t >= 1.0)
+    return 0.0;
+  return 0.42 - 0.5 * cos(2.0 * PI * t) + 0.08 * cos(4.0 * PI * t);
+}
+
+// One row per phase, phase p puts the output p / PHASES of the way from
+// tap taps / 2 - 1 to tap taps / 2. Every row sums to unity so DC passes
+// unchanged, the extra last row lets the top phase interpolate too.
+static void BuildKernel(vmupro_resampler_t *r)
+{
+  int taps = r->taps;
+  double ratio = r->in_rate > r->out_rate ? (double)r->out_rate / r->in_rate : 1.0;
+  double fc = 0.5 * ratio * SINC_CUTOFF;
+
+  for (int p = 0; p <= VMUPRO_RESAMPLER_PHASES; p++)
+  {
+    double f = (double)p / VMUPRO_RESAMPLER_PHASES;
+    double h[VMUPRO_RESAMPLER_MAX_TAPS];
+    double sum = 0.0;
+    for (int i = 0; i < taps; i++)
+    {
+      double d = i - (taps / 2 - 1) - f;
+      h[i] = 2.0 * fc * Sinc(2.0 * fc * d) * Window((d + taps / 2) / taps);
+      sum += h[i];
+    }
+
+    int16_t *row = &r->kernel[p * VMUPRO_RESAMPLER_MAX_TAPS];
+    int32_t total = 0;
+    int peak = 0;
+    for (int i = 0; i < taps; i++)
+    {
+      row[i] = (int16_t)lround(h[i] / sum * (1 << COEF_BITS));
+      total += row[i];
+      if (abs(row[i]) > abs(row[peak]))
+        peak = i;
+    }
+    // rounding leftovers go on the largest tap
+    row[peak] += (int16_t)((1 << COEF_BITS) - total);
+  }
+}
+
+static inline void Push(vmupro_resampler_t *r, const int16_t *frame)
+{
+  uint32_t head = r->head;
+  for (int c = 0; c < r->channels; c++)
+  {
+    r->history[c][head] = frame[c];
+    r->history[c][head + r->taps] = frame[c];
+  }
+  r->head = head + 1 == r->taps ? 0 : head + 1;
+}
+
+static inline void Render(const vmupro_resampler_t *r, int16_t *frame)
+{
+  uint32_t head = r->head;
+  if (r->quality == VMUPRO_RESAMPLE_LINEAR)
+  {
+    int32_t t = (int32_t)(r->frac >> 17);
+    for (int c = 0; c < r->channels; c++)
+    {
+      const int16_t *w = &r->history[c][head];
+      frame[c] = (int16_t)(w[0] + (((int32_t)w[1] - w[0]) * t >> 15));
+    }
+    return;
+  }
+
+  int taps = r->taps;
+  uint32_t phase = r->frac >> (32 - PHASE_BITS);
+  int32_t t = (int32_t)((r->frac >> (32 - PHASE_BITS - 15)) & 0x7fff);
+  const int16_t *k0 = &r->kernel[phase * VMUPRO_RESAMPLER_MAX_TAPS];
+  const int16_t *k1 = k0 + VMUPRO_RESAMPLER_MAX_TAPS;
+  int32_t k[VMUPRO_RESAMPLER_MAX_TAPS];
+  for (int i = 0; i < taps; i++)
+    k[i] = k0[i] + (((int32_t)k1[i] - k0[i]) * t >> 15);
+
+  for (int c = 0; c < r->channels; c++)
+  {
+    const int16_t *w = &r->history[c][head];
+    int32_t acc = 1 << (COEF_BITS - 1);
+    for (int i = 0; i < taps; i++)
+      acc += k[i] * w[i];
+    frame[c] = Saturate(acc >> COEF_BITS);
+  }
+}
+
+// Source frames per output frame in 32.32, out_rate scaled by the correction
+static void UpdateStep(vmupro_resampler_t *r)
+{
+  uint64_t step = ((uint64_t)r->in_rate << 32) / r->out_rate;
+  step = step * 1000000u / (uint64_t)(1000000 + r->adjust_ppm);
+  r->step_int = (uint32_t)(step >> 32);
+  r->step_frac = (uint32_t)step;
+}
+
+bool vmupro_resampler_init(vmupro_resampler_t *r, uint32_t in_rate, uint32_t out_rate, int channels,
+                           vmupro_resample_quality_t quality)
+{
+  if (r == NULL || channels < 1 || channels > 2 || in_rate < VMUPRO_RESAMPLER_MIN_RATE ||
+      in_rate > VMUPRO_RESAMPLER_MAX_RATE || out_rate < VMUPRO_RESAMPLER_MIN_RATE ||
+      out_rate > VMUPRO_RESAMPLER_MAX_RATE)
+    return false;
+
+  r->in_rate = in_rate;
+  r->out_rate = out_rate;
+  r->channels = (uint8_t)channels;
+  switch (quality)
+  {
+  case VMUPRO_RESAMPLE_SINC_8:
+    r->taps = 8;
+    break;
+  case VMUPRO_RESAMPLE_SINC_16:
+    r->taps = 16;
+    break;
+  default:
+    quality = VMUPRO_RESAMPLE_LINEAR;
+    r->taps = 2;
+    break;
+  }
+  r->quality = quality;
+
+  r->adjust_ppm = 0;
+  UpdateStep(r);
+  if (quality != VMUPRO_RESAMPLE_LINEAR)
+    BuildKernel(r);
+  vmupro_resampler_reset(r);
+  return true;
+}
+
+void vmupro_resampler_reset(vmupro_resampler_t *r)
+{
+  memset(r->history, 0, sizeof(r->history));
+  r->head = 0;
+  r->frac = 0;
+  // fill up to the tap just left of the output point, so the first output
+  // frame lands on the first source frame
+  r->skip = r->taps / 2 + 1;
+}
+
+int vmupro_resampler_process(vmupro_resampler_t *r, const int16_t *in, int in_frames, int *in_used, int16_t *out,
+                             int max_out_frames)
+{
+  int used = 0, written = 0;
+  int channels = r->channels;
+  while (written < max_out_frames)
+  {
+    while (r->skip > 0 && used < in_frames)
+    {
+      Push(r, in + used * channels);
+      used++;
+      r->skip--;
+    }
+    if (r->skip > 0)
+      break;
+
+    Render(r, out + written * channels);
+    written++;
+    uint32_t frac = r->frac + r->step_frac;
+    r->skip = r->step_int + (frac < r->frac);
+    r->frac = frac;
+  }
+  if (in_used != NULL)
+    *in_used = used;
+  return written;
+}
+
+void vmupro_resampler_set_adjust(vmupro_resampler_t *r, int32_t ppm)
+{
+  if (ppm > VMUPRO_RATE_CONTROL_MAX_PPM)
+    ppm = VMUPRO_RATE_CONTROL_MAX_PPM;
+  if (ppm < -VMUPRO_RATE_CONTROL_MAX_PPM)
+    ppm = -VMUPRO_RATE_CONTROL_MAX_PPM;
+  if (ppm == r->adjust_ppm)
+    return;
+  r->adjust_ppm = ppm;
+  UpdateStep(r);
+}
+
+int vmupro_resampler_max_output(const vmupro_resampler_t *r, int in_frames)
+{
+  if (in_frames <= 0)
+    return 1;
+  uint64_t outRate = (uint64_t)r->out_rate * (uint64_t)(1000000 + VMUPRO_RATE_CONTROL_MAX_PPM) / 1000000u + 1;
+  return (int)(((uint64_t)in_frames * outRate + r->in_rate - 1) / r->in_rate) + 1;
+}
+
+int vmupro_resampler_flush(vmupro_resampler_t *r, int16_t *out, int max_out_frames)
+{
+  static const int16_t silence[VMUPRO_RESAMPLER_MAX_TAPS];
+  return vmupro_resampler_process(r, silence, r->taps / 2, NULL, out, max_out_frames);
+}
+
+//
+// Dynamic rate control
+//
+
+void vmupro_rate_control_init(vmupro_rate_control_t *rc, const vmupro_rate_control_config_t *config)
+{
+  memset(rc, 0, sizeof(*rc));
+  rc->config = config != NULL ? *config : vmupro_rate_control_defaults();
+  if (rc->config.target_fill == 0)
+    rc->config.target_fill = 1;
+  if (rc->config.max_adjust_ppm > VMUPRO_RATE_CONTROL_MAX_PPM)
+    rc->config.max_adjust_ppm = VMUPRO_RATE_CONTROL_MAX_PPM;
+}
+
+int32_t vmupro_rate_control_update(vmupro_rate_control_t *rc, uint32_t fill, uint32_t frames)
+{
+  vmupro_rate_control_stats_t *st = &rc->stats;
+  int64_t limit = rc->config.max_adjust_ppm;
+  int64_t target = rc->config.target_fill;
+
+  // smooth out the jitter of bursty writes and reads, over about 8 updates
+  if (st->updates == 0)
+  {
+    rc->avg_fill_q8 = fill << 8;
+    st->min_fill = st->max_fill = fill;
+  }
+  else
+  {
+    rc->avg_fill_q8 = (uint32_t)((int64_t)rc->avg_fill_q8 + (((int64_t)fill << 8) - rc->avg_fill_q8) / 8);
+  }
+
+  // full correction half the target away, more output when running low
+  int64_t p = (target * 256 - rc->avg_fill_q8) * limit * 2 / (target * 256);
+  if (p > limit)
+    p = limit;
+  if (p < -limit)
+    p = -limit;
+
+  // the integral settles on the clock drift. Its time constant is four
+  // times the proportional one, counted in frames queued rather than
+  // updates, so the loop is critically damped whatever the write size
+  if (limit > 0)
+  {
+    int64_t window = 4 * target * 1000000 / (limit * 2);
+    rc->integral_q8 += p * 256 * (int64_t)frames / window;
+    if (rc->integral_q8 > limit * 256)
+      rc->integral_q8 = limit * 256;
+    if (rc->integral_q8 < -limit * 256)
+      rc->integral_q8 = -limit * 256;
+  }
+
+  int64_t adjust = p + rc->integral_q8 / 256;
+  bool saturated = adjust > limit || adjust < -limit;
+  if (adjust > limit)
+    adjust = limit;
+  if (adjust < -limit)
+    adjust = -limit;
+
+  // the buffer starts out empty, only count it running dry afterwards
+  if (fill == 0 && st->updates > 0)
+    st->empty++;
+  st->updates++;
+  st->fill = fill;
+  st->avg_fill = rc->avg_fill_q8 >> 8;
+  if (fill < st->min_fill)
+    st->min_fill = fill;
+  if (fill > st->max_fill)
+    st->max_fill = fill;
+  if (saturated)
+    st->saturated++;
+  st->adjust_ppm = (int32_t)adjust;
+  st->drift_ppm = (int32_t)(rc->integral_q8 / 256);
+  if (adjust < st->min_adjust_ppm)
+    st->min_adjust_ppm = (int32_t)adjust;
+  if (adjust > st->max_adjust_ppm)
+    st->max_adjust_ppm = (int32_t)adjust;
+  return (int32_t)adjust;
+}
+
+//
+// Streaming
+//
+
+bool vmupro_audio_stream_set_format(uint32_t sample_rate, vmupro_stereo_mode_t stereo_mode,
+                                    vmupro_resample_quality_t quality)
+{
+  int channels = stereo_mode == VMUPRO_AUDIO_STEREO ? 2 : 1;
+  if (!vmupro_resampler_init(&streamResampler, sample_rate, OUTPUT_RATE, channels, quality))
+    return false;
+  streamMode = stereo_mode;
+  streamConvert = sample_rate != OUTPUT_RATE || streamRateControl;
+  return true;
+}
+
+void vmupro_audio_stream_write(const int16_t *samples, int frames, bool applyGlobalVolume)
+{
+  if (samples == NULL || frames <= 0)
+    return;
+  int channels = streamMode == VMUPRO_AUDIO_STEREO ? 2 : 1;
+  if (!streamConvert)
+  {
+    vmupro_audio_add_stream_samples((int16_t *)samples, frames * channels, streamMode, applyGlobalVolume);
+    return;
+  }
+
+  if (streamRateControl)
+  {
+    // the fill state counts samples, the controller frames
+    uint32_t filled = 0;
+    vmupro_get_ringbuffer_fill_state(&filled, NULL);
+    filled /= (uint32_t)channels;
+    vmupro_resampler_set_adjust(&streamResampler, vmupro_rate_control_update(&streamControl, filled, streamQueued));
+    streamQueued = 0;
+  }
+
+  while (frames > 0)
+  {
+    int used = 0;
+    int n = vmupro_resampler_process(&streamResampler, samples, frames, &used, streamBuf, STREAM_CHUNK);
+    if (n > 0)
+      vmupro_audio_add_stream_samples(streamBuf, n * channels, streamMode, applyGlobalVolume);
+    samples += used * channels;
+    frames -= used;
+    streamQueued += (uint32_t)n;
+  }
+}
+
+void vmupro_audio_stream_set_rate_control(const vmupro_rate_control_config_t *config)
+{
+  if (streamResampler.in_rate == 0)
+    vmupro_resampler_init(&streamResampler, OUTPUT_RATE, OUTPUT_RATE, 1, VMUPRO_RESAMPLE_LINEAR);
+  streamRateControl = config != NULL;
+  if (streamRateControl)
+  {
+    vmupro_rate_control_init(&streamControl, config);
+    streamQueued = 0;
+  }
+  else
+  {
+    vmupro_resampler_set_adjust(&streamResampler, 0);
+  }
+  // a 44.1kHz stream goes through the resampler only while it is corrected
+  streamConvert = streamResampler.in_rate != OUTPUT_RATE || streamRateControl;
+}
+
+void vmupro_audio_stream_get_rate_control_stats(vmupro_rate_control_stats_t *out_stats)
+{
+  if (out_stats == NULL)
+    return;
+  if (streamRateControl)
+    *out_stats = streamControl.stats;
+  else
+    memset(out_stats, 0, sizeof(*out_stats));
+}
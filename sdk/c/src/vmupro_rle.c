@@ -0,0 +1,160 @@
+// sdk/c/src/vmupro_rle.c
+//
+// Run-length encoded sprites, see vmupro_rle.h for the format
+
+#include <stdint.h>
+#include <string.h>
+#include "vmupro_display.h"
+#include "vmupro_rle.h"
+#include "vmupro_dirty_rect.h"
+
+#define SCREEN_W 240
+#define SCREEN_H 240
+
+static inline uint16_t PixelAt(const uint8_t *buffer, int index)
+{
+  uint16_t p;
+  memcpy(&p, buffer + index * 2, 2);
+  return p;
+}
+
+int vmupro_rle_encode(const uint8_t *buffer, int width, int height, vmupro_color_t transparent_color,
+                      uint8_t *out, int out_size)
+{
+  if (buffer == NULL || width <= 0 || height <= 0 || width > 0xffff || height > 0xffff)
+    return -1;
+  if (out != NULL && ((uintptr_t)out & 3) != 0)
+    return -1;
+
+  uint16_t key = (uint16_t)transparent_color;
+  int pos = VMUPRO_RLE_HEADER_SIZE + height * 4;
+  if (out != NULL && pos > out_size)
+    return -1;
+
+  for (int y = 0; y < height; y++)
+  {
+    int rowStart = pos;
+    uint16_t spans = 0;
+    pos += 2;
+
+    int x = 0;
+    int last = 0;
+    while (x < width)
+    {
+      while (x < width && PixelAt(buffer, y * width + x) == key)
+        x++;
+      if (x == width)
+        break;
+      int start = x;
+      while (x < width && PixelAt(buffer, y * width + x) != key)
+        x++;
+
+      uint16_t skip = (uint16_t)(start - last);
+      uint16_t count = (uint16_t)(x - start);
+      if (out != NULL)
+      {
+        if (pos + 4 + count * 2 > out_size)
+          return -1;
+        memcpy(out + pos, &skip, 2);
+        memcpy(out + pos + 2, &count, 2);
+        memcpy(out + pos + 4, buffer + (y * width + start) * 2, count * 2);
+      }
+      pos += 4 + count * 2;
+      last = x;
+      spans++;
+    }
+
+    if (out != NULL)
+    {
+      uint32_t offset = (uint32_t)rowStart;
+      memcpy(out + VMUPRO_RLE_HEADER_SIZE + y * 4, &offset, 4);
+      memcpy(out + rowStart, &spans, 2);
+    }
+  }
+
+  if (out != NULL)
+  {
+    vmupro_rle_header_t header = {VMUPRO_RLE_MAGIC, (uint16_t)width, (uint16_t)height, 0};
+    memcpy(out, &header, sizeof(header));
+  }
+  return pos;
+}
+
+bool vmupro_rle_get_info(const uint8_t *rle, int *width, int *height)
+{
+  if (rle == NULL || ((uintptr_t)rle & 3) != 0)
+    return false;
+
+  const vmupro_rle_header_t *header = (const vmupro_rle_header_t *)rle;
+  if (header->magic != VMUPRO_RLE_MAGIC || header->width == 0 || header->height == 0)
+    return false;
+
+  if (width)
+    *width = header->width;
+  if (height)
+    *height = header->height;
+  return true;
+}
+
+void vmupro_blit_rle(const uint8_t *rle, int x, int y, vmupro_drawflags_t flags)
+{
+  int width, height;
+  if (!vmupro_rle_get_info(rle, &width, &height))
+    return;
+
+  int x0 = x < 0 ? 0 : x;
+  int y0 = y < 0 ? 0 : y;
+  int x1 = x + width > SCREEN_W ? SCREEN_W : x + width;
+  int y1 = y + height > SCREEN_H ? SCREEN_H : y + height;
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  bool flipH = (flags & VMUPRO_DRAWFLAGS_FLIP_H) != 0;
+  bool flipV = (flags & VMUPRO_DRAWFLAGS_FLIP_V) != 0;
+  const uint32_t *rowOffsets = (const uint32_t *)(rle + VMUPRO_RLE_HEADER_SIZE);
+  uint16_t *fb = (uint16_t *)vmupro_get_back_buffer();
+
+  for (int dy = y0; dy < y1; dy++)
+  {
+    int row = flipV ? height - 1 - (dy - y) : dy - y;
+    const uint16_t *p = (const uint16_t *)(rle + rowOffsets[row]);
+    int spans = *p++;
+    uint16_t *dst = fb + dy * SCREEN_W;
+    int sx = 0;
+
+    for (int i = 0; i < spans; i++)
+    {
+      sx += p[0];
+      int count = p[1];
+      const uint16_t *pixels = p + 2;
+      p += 2 + count;
+
+      // Spans run left to right in the sprite, so they run right to left
+      // on screen when flipped; either way stop once past the clip edge
+      int d0 = flipH ? x + width - sx - count : x + sx;
+      int d1 = d0 + count;
+      sx += count;
+      if (flipH ? d1 <= x0 : d0 >= x1)
+        break;
+      if (flipH ? d0 >= x1 : d1 <= x0)
+        continue;
+
+      int c0 = d0 < x0 ? x0 : d0;
+      int c1 = d1 > x1 ? x1 : d1;
+      if (!flipH)
+      {
+        const uint16_t *src = pixels + (c0 - d0);
+        for (int dx = c0; dx < c1; dx++)
+          dst[dx] = *src++;
+      }
+      else
+      {
+        const uint16_t *src = pixels + (d1 - 1 - c0);
+        for (int dx = c0; dx < c1; dx++)
+          dst[dx] = *src--;
+      }
+    }
+  }
+
+  MarkDirtyRect(x0, y0, x1 - x0, y1 - y0);
+}
@@ -0,0 +1,785 @@
+// sdk/c/src/vmupro_sequence.c
+//
+// MIDI sequencer, see vmupro_sequence.h
+// A file is compiled once into a flat array of events with frame deltas.
+// Playing sequences are published to the audio task through a few atomic
+// slots, and the synth engine's scheduler dispatches their events on the
+// frame they fall on. The game thread only posts play and stop requests.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "vmupro_file.h"
+#include "vmupro_utils.h"
+#include "vmupro_synth.h"
+#include "vmupro_instrument.h"
+#include "vmupro_sequence.h"
+
+#define DEFAULT_TEMPO 500000 // microseconds per quarter note, 120bpm
+#define NO_NOTE 0xff
+#define NO_PROGRAM 0xff
+
+// Moved on by the game thread to STARTING and STOPPING, and by the audio
+// task to PLAYING and IDLE
+typedef enum
+{
+  STATE_IDLE = 0,
+  STATE_STARTING,
+  STATE_PLAYING,
+  STATE_STOPPING,
+} State;
+
+typedef struct
+{
+  // owned by the game thread, fixed while playing
+  vmupro_synth_t *synths[VMUPRO_SEQUENCE_MAX_TRACK_SYNTHS];
+  uint8_t synthCount;
+  vmupro_instrument_t *instrument; // plays the track instead of synths
+  uint8_t polyphony;
+  uint8_t program;
+  // owned by the audio task
+  uint8_t held[VMUPRO_SEQUENCE_MAX_TRACK_SYNTHS]; // note per synth, NO_NOTE once released
+  uint32_t age[VMUPRO_SEQUENCE_MAX_TRACK_SYNTHS]; // when each synth was last started or released
+  uint32_t clock;
+  uint32_t instrumentNotes[4]; // notes held on the instrument
+  _Atomic uint8_t notesActive;
+} Track;
+
+struct vmupro_sequence
+{
+  vmupro_sequence_event_t *events;
+  uint32_t eventCount;
+  uint32_t length;
+  int trackCount;
+  Track tracks[VMUPRO_SEQUENCE_MAX_TRACKS];
+
+  _Atomic uint8_t state;
+  atomic_bool loop;
+  atomic_bool registered; // in a playing slot
+
+  // owned by the audio task
+  uint32_t index;     // next event
+  uint64_t nextFrame; // engine frame the next event is due on
+  uint64_t loopFrame; // engine frame the current pass started on
+  uint64_t playFrame;
+  uint64_t playUs;
+  vmupro_sequence_stats_t stats;
+};
+
+static vmupro_sequence_t *_Atomic playingSlots[VMUPRO_SEQUENCE_MAX_PLAYING];
+static bool schedulerInstalled = false;
+
+//
+// Compiler
+//
+
+typedef struct
+{
+  const uint8_t *p;
+  const uint8_t *end;
+  uint32_t tick; // of the event at p
+  uint8_t running;
+  bool done;
+} Cursor;
+
+typedef struct
+{
+  bool smpte;
+  uint32_t tempo;
+  uint64_t denominator; // time units per second
+  uint64_t units;       // time since the start, in units
+  uint32_t lastTick;
+} Clock;
+
+static bool ReadVarLen(const uint8_t **p, const uint8_t *end, uint32_t *out)
+{
+  uint32_t value = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    if (*p >= end)
+      return false;
+    uint8_t b = *(*p)++;
+    value = value << 7 | (b & 0x7f);
+    if (!(b & 0x80))
+    {
+      *out = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline uint32_t ReadBE(const uint8_t *p, int bytes)
+{
+  uint32_t value = 0;
+  for (int i = 0; i < bytes; i++)
+    value = value << 8 | p[i];
+  return value;
+}
+
+// Reads the delta time in front of the cursor's next event
+static void NextDelta(Cursor *c)
+{
+  uint32_t delta;
+  if (c->done || !ReadVarLen(&c->p, c->end, &delta) || c->p >= c->end)
+  {
+    c->done = true;
+    return;
+  }
+  c->tick += delta;
+}
+
+// Frame of tick, rounded from the exact time since the start
+static uint32_t FrameAt(Clock *clock, uint32_t tick)
+{
+  clock->units += (uint64_t)(tick - clock->lastTick) * (clock->smpte ? 100 : clock->tempo);
+  clock->lastTick = tick;
+  uint64_t seconds = clock->units / clock->denominator;
+  uint64_t rest = clock->units % clock->denominator;
+  uint64_t frames =
+    seconds * VMUPRO_SYNTH_RATE + (rest * VMUPRO_SYNTH_RATE + clock->denominator / 2) / clock->denominator;
+  return frames > UINT32_MAX ? UINT32_MAX : (uint32_t)frames;
+}
+
+// Works out the polyphony of each track as its notes go on and off
+typedef struct
+{
+  uint32_t held[VMUPRO_SEQUENCE_MAX_TRACKS][4];
+  uint8_t count[VMUPRO_SEQUENCE_MAX_TRACKS];
+} NoteMap;
+
+static void TrackNote(vmupro_sequence_t *seq, NoteMap *notes, int track, uint8_t note, bool on)
+{
+  uint32_t *word = &notes->held[track][note >> 5];
+  uint32_t bit = 1u << (note & 31);
+  if (on && !(*word & bit))
+  {
+    *word |= bit;
+    if (++notes->count[track] > seq->tracks[track].polyphony)
+      seq->tracks[track].polyphony = notes->count[track];
+  }
+  else if (!on && (*word & bit))
+  {
+    *word &= ~bit;
+    notes->count[track]--;
+  }
+}
+
+// Merges the tracks in time order, lowest track first on a tie. Counts the
+// events when out is NULL, otherwise fills out with them
+static uint32_t Compile(vmupro_sequence_t *seq, const Cursor *start, int cursors, bool channelTracks, Clock clock,
+                        vmupro_sequence_event_t *out)
+{
+  Cursor c[VMUPRO_SEQUENCE_MAX_TRACKS];
+  NoteMap notes;
+  memcpy(c, start, sizeof(c[0]) * (size_t)cursors);
+  memset(&notes, 0, sizeof(notes));
+  for (int i = 0; i < cursors; i++)
+    NextDelta(&c[i]);
+
+  uint32_t count = 0;
+  uint32_t lastFrame = 0;
+  uint32_t endTick = 0;
+  for (;;)
+  {
+    Cursor *next = NULL;
+    int track = 0;
+    for (int i = 0; i < cursors; i++)
+    {
+      if (!c[i].done && (next == NULL || c[i].tick < next->tick))
+      {
+        next = &c[i];
+        track = i;
+      }
+    }
+    if (next == NULL)
+      break;
+    if (next->tick > endTick)
+      endTick = next->tick;
+
+    uint8_t status = *next->p;
+    if (status & 0x80)
+      next->p++;
+    else
+      status = next->running;
+
+    if (status >= 0x80 && status < 0xf0)
+    {
+      next->running = status;
+      int size = (status & 0xe0) == 0xc0 ? 1 : 2;
+      if (next->end - next->p < size)
+      {
+        next->done = true;
+        continue;
+      }
+      uint8_t a = next->p[0] & 0x7f;
+      uint8_t b = size > 1 ? next->p[1] & 0x7f : 0;
+      next->p += size;
+
+      int kind = -1;
+      uint8_t type = status & 0xf0;
+      if (type == 0x90 && b > 0)
+        kind = VMUPRO_SEQUENCE_NOTE_ON;
+      else if (type == 0x80 || type == 0x90)
+        kind = VMUPRO_SEQUENCE_NOTE_OFF;
+      else if (type == 0xc0)
+        kind = VMUPRO_SEQUENCE_PROGRAM;
+      int eventTrack = channelTracks ? (status & 0x0f) : track;
+
+      if (kind >= 0)
+      {
+        if (out != NULL)
+        {
+          uint32_t frame = FrameAt(&clock, next->tick);
+          out[count] = (vmupro_sequence_event_t){frame - lastFrame, (uint8_t)eventTrack, (uint8_t)kind,
+                                                 kind == VMUPRO_SEQUENCE_PROGRAM ? 0 : a,
+                                                 kind == VMUPRO_SEQUENCE_PROGRAM ? a : b};
+          lastFrame = frame;
+          if (kind == VMUPRO_SEQUENCE_PROGRAM && seq->tracks[eventTrack].program == NO_PROGRAM)
+            seq->tracks[eventTrack].program = a;
+          if (kind != VMUPRO_SEQUENCE_PROGRAM)
+            TrackNote(seq, &notes, eventTrack, a, kind == VMUPRO_SEQUENCE_NOTE_ON);
+        }
+        else if (eventTrack >= seq->trackCount)
+        {
+          seq->trackCount = eventTrack + 1;
+        }
+        count++;
+      }
+    }
+    else if (status == 0xf0 || status == 0xf7 || status == 0xff)
+    {
+      // sysex and meta events cancel running status
+      next->running = 0;
+      uint8_t meta = 0;
+      uint32_t length;
+      if (status == 0xff)
+      {
+        if (next->p >= next->end)
+        {
+          next->done = true;
+          continue;
+        }
+        meta = *next->p++;
+      }
+      if (!ReadVarLen(&next->p, next->end, &length) || (uint32_t)(next->end - next->p) < length)
+      {
+        next->done = true;
+        continue;
+      }
+      if (meta == 0x51 && length == 3 && out != NULL)
+      {
+        FrameAt(&clock, next->tick);
+        clock.tempo = ReadBE(next->p, 3);
+      }
+      next->p += length;
+      if (meta == 0x2f)
+      {
+        next->done = true;
+        continue;
+      }
+    }
+    else
+    {
+      // a data byte with no running status, or a real time message
+      next->done = true;
+      continue;
+    }
+    NextDelta(next);
+  }
+
+  if (out != NULL)
+  {
+    uint32_t frame = FrameAt(&clock, endTick);
+    out[count] = (vmupro_sequence_event_t){frame - lastFrame, 0, VMUPRO_SEQUENCE_END, 0, 0};
+    seq->length = frame;
+  }
+  return count + 1;
+}
+
+vmupro_sequence_t *vmupro_sequence_new_from_memory(const void *data, size_t size)
+{
+  const uint8_t *file = data;
+  if (file == NULL || size < 14 || memcmp(file, "MThd", 4) != 0)
+    return NULL;
+  uint32_t headerSize = ReadBE(file + 4, 4);
+  uint32_t format = ReadBE(file + 8, 2);
+  uint32_t trackChunks = ReadBE(file + 10, 2);
+  uint32_t division = ReadBE(file + 12, 2);
+  if (headerSize < 6 || headerSize > size - 8 || format > 1 || trackChunks == 0 ||
+      trackChunks > VMUPRO_SEQUENCE_MAX_TRACKS || (format == 0 && trackChunks != 1) || (division & 0x7fff) == 0)
+    return NULL;
+
+  Clock clock = {0};
+  clock.tempo = DEFAULT_TEMPO;
+  if (division & 0x8000)
+  {
+    // frames per second times ticks per frame, in hundredths for 29.97
+    int fps = -(int8_t)(division >> 8);
+    if (fps != 24 && fps != 25 && fps != 29 && fps != 30)
+      return NULL;
+    clock.smpte = true;
+    clock.denominator = (uint64_t)(fps == 29 ? 2997 : fps * 100) * (division & 0xff);
+    if (clock.denominator == 0)
+      return NULL;
+  }
+  else
+  {
+    clock.denominator = (uint64_t)division * 1000000;
+  }
+
+  Cursor cursors[VMUPRO_SEQUENCE_MAX_TRACKS];
+  int found = 0;
+  size_t at = 8 + headerSize;
+  while (found < (int)trackChunks && size - at >= 8)
+  {
+    uint32_t chunk = ReadBE(file + at + 4, 4);
+    size_t body = at + 8;
+    size_t end = chunk > size - body ? size : body + chunk;
+    if (memcmp(file + at, "MTrk", 4) == 0)
+      cursors[found++] = (Cursor){file + body, file + end, 0, 0, false};
+    if (end >= size)
+      break;
+    at = end;
+  }
+  if (found == 0)
+    return NULL;
+
+  vmupro_sequence_t *seq = calloc(1, sizeof(*seq));
+  if (seq == NULL)
+    return NULL;
+  for (int i = 0; i < VMUPRO_SEQUENCE_MAX_TRACKS; i++)
+  {
+    seq->tracks[i].program = NO_PROGRAM;
+    memset(seq->tracks[i].held, NO_NOTE, sizeof(seq->tracks[i].held));
+  }
+  bool channelTracks = format == 0;
+  seq->trackCount = channelTracks ? 1 : found;
+
+  seq->eventCount = Compile(seq, cursors, found, channelTracks, clock, NULL);
+  seq->events = malloc(sizeof(vmupro_sequence_event_t) * seq->eventCount);
+  if (seq->events == NULL)
+  {
+    free(seq);
+    return NULL;
+  }
+  Compile(seq, cursors, found, channelTracks, clock, seq->events);
+  return seq;
+}
+
+vmupro_sequence_t *vmupro_sequence_new(const char *path)
+{
+  size_t size = vmupro_get_file_size(path);
+  if (size == (size_t)-1 || size < 14)
+    return NULL;
+  uint8_t *file = malloc(size);
+  if (file == NULL)
+    return NULL;
+  size_t read = 0;
+  vmupro_sequence_t *seq = NULL;
+  if (vmupro_read_file_complete(path, file, &read))
+    seq = vmupro_sequence_new_from_memory(file, read);
+  free(file);
+  return seq;
+}
+
+//
+// Audio task
+//
+
+static void CountNotes(Track *t)
+{
+  uint8_t active = 0;
+  for (int i = 0; i < t->synthCount; i++)
+    active += t->held[i] != NO_NOTE;
+  atomic_store_explicit(&t->notesActive, active, memory_order_relaxed);
+}
+
+// Keeps track of the notes an instrument holds, for notesActive and the
+// releases on stop. The instrument picks its own voices
+static void InstrumentNote(Track *t, uint8_t note, uint8_t velocity)
+{
+  uint32_t *word = &t->instrumentNotes[note >> 5];
+  uint32_t bit = 1u << (note & 31);
+  uint8_t active = atomic_load_explicit(&t->notesActive, memory_order_relaxed);
+  if (velocity > 0)
+  {
+    if (!(*word & bit))
+      active++;
+    *word |= bit;
+    vmupro_instrument_render_note_on(t->instrument, note, velocity);
+  }
+  else if (*word & bit)
+  {
+    active--;
+    *word &= ~bit;
+    vmupro_instrument_render_note_off(t->instrument, note);
+  }
+  atomic_store_explicit(&t->notesActive, active, memory_order_relaxed);
+}
+
+static void NoteOn(vmupro_sequence_t *seq, Track *t, uint8_t note, uint8_t velocity)
+{
+  if (t->instrument != NULL)
+  {
+    InstrumentNote(t, note, velocity);
+    return;
+  }
+  if (t->synthCount == 0)
+  {
+    seq->stats.notes_dropped++;
+    return;
+  }
+  // the synth already holding the note, else a silent one, else the one
+  // released longest ago, else the oldest note
+  int pick = -1;
+  for (int i = 0; i < t->synthCount && pick < 0; i++)
+    if (t->held[i] == note)
+      pick = i;
+  for (int i = 0; i < t->synthCount && pick < 0; i++)
+    if (t->held[i] == NO_NOTE && !vmupro_synth_render_is_sounding(t->synths[i]))
+      pick = i;
+  for (int pass = 0; pass < 2 && pick < 0; pass++)
+  {
+    for (int i = 0; i < t->synthCount; i++)
+    {
+      if ((t->held[i] == NO_NOTE) == (pass == 0) && (pick < 0 || t->clock - t->age[i] > t->clock - t->age[pick]))
+        pick = i;
+    }
+    if (pick >= 0 && pass == 1)
+      seq->stats.notes_stolen++;
+  }
+  t->held[pick] = note;
+  t->age[pick] = ++t->clock;
+  vmupro_synth_render_note_on(t->synths[pick], vmupro_synth_midi_frequency(note),
+                              (uint16_t)((velocity * VMUPRO_SYNTH_UNITY + 63) / 127));
+  CountNotes(t);
+}
+
+static void NoteOff(Track *t, uint8_t note)
+{
+  if (t->instrument != NULL)
+  {
+    InstrumentNote(t, note, 0);
+    return;
+  }
+  for (int i = 0; i < t->synthCount; i++)
+  {
+    if (t->held[i] != note)
+      continue;
+    t->held[i] = NO_NOTE;
+    t->age[i] = ++t->clock;
+    vmupro_synth_render_note_off(t->synths[i]);
+    CountNotes(t);
+    return;
+  }
+}
+
+static void ReleaseAll(vmupro_sequence_t *seq)
+{
+  for (int i = 0; i < seq->trackCount; i++)
+  {
+    Track *t = &seq->tracks[i];
+    for (int s = 0; s < t->synthCount; s++)
+    {
+      if (t->held[s] != NO_NOTE)
+        NoteOff(t, t->held[s]);
+    }
+    for (int note = 0; note < 128 && t->instrument != NULL; note++)
+    {
+      if (t->instrumentNotes[note >> 5] & (1u << (note & 31)))
+        NoteOff(t, (uint8_t)note);
+    }
+  }
+}
+
+static void Start(vmupro_sequence_t *seq, uint64_t frame)
+{
+  for (int i = 0; i < seq->trackCount; i++)
+  {
+    Track *t = &seq->tracks[i];
+    memset(t->held, NO_NOTE, sizeof(t->held));
+    memset(t->age, 0, sizeof(t->age));
+    memset(t->instrumentNotes, 0, sizeof(t->instrumentNotes));
+    t->clock = 0;
+    CountNotes(t);
+  }
+  seq->index = 0;
+  seq->loopFrame = seq->playFrame = frame;
+  seq->nextFrame = frame + seq->events[0].delta_frames;
+  seq->playUs = vmupro_get_time_us();
+}
+
+// Releases the notes and the slot of a sequence that has gone idle
+static void Finish(vmupro_sequence_t *seq, int slot)
+{
+  ReleaseAll(seq);
+  atomic_store_explicit(&playingSlots[slot], NULL, memory_order_relaxed);
+  atomic_store_explicit(&seq->registered, false, memory_order_release);
+}
+
+// Dispatches every event due by frame. Returns false at the end
+static bool Dispatch(vmupro_sequence_t *seq, uint64_t frame)
+{
+  while (seq->nextFrame <= frame)
+  {
+    const vmupro_sequence_event_t *e = &seq->events[seq->index];
+    if (frame > seq->nextFrame)
+    {
+      uint64_t late = frame - seq->nextFrame;
+      seq->stats.late++;
+      if (late > seq->stats.max_late_frames)
+        seq->stats.max_late_frames = late > UINT32_MAX ? UINT32_MAX : (uint32_t)late;
+    }
+    seq->stats.dispatched++;
+    int64_t musicUs = (int64_t)((seq->nextFrame - seq->playFrame) * 1000000 / VMUPRO_SYNTH_RATE);
+    seq->stats.drift_us = (int32_t)(musicUs - (int64_t)(vmupro_get_time_us() - seq->playUs));
+
+    Track *t = &seq->tracks[e->track];
+    if (e->kind == VMUPRO_SEQUENCE_NOTE_ON)
+    {
+      NoteOn(seq, t, e->note, e->value);
+    }
+    else if (e->kind == VMUPRO_SEQUENCE_NOTE_OFF)
+    {
+      NoteOff(t, e->note);
+    }
+    else if (e->kind == VMUPRO_SEQUENCE_END)
+    {
+      ReleaseAll(seq);
+      // an empty sequence would loop forever on one frame
+      if (!atomic_load_explicit(&seq->loop, memory_order_relaxed) || seq->length == 0)
+        return false;
+      seq->stats.loops++;
+      seq->index = 0;
+      seq->loopFrame = seq->nextFrame;
+      seq->nextFrame += seq->events[0].delta_frames;
+      continue;
+    }
+    seq->index++;
+    seq->nextFrame += seq->events[seq->index].delta_frames;
+  }
+  return true;
+}
+
+// Synth engine scheduler: plays what is due, and renders up to the next event
+static int Schedule(uint64_t frame, int max_frames, void *user)
+{
+  (void)user;
+  int until = max_frames;
+  for (int i = 0; i < VMUPRO_SEQUENCE_MAX_PLAYING; i++)
+  {
+    vmupro_sequence_t *seq = atomic_load_explicit(&playingSlots[i], memory_order_acquire);
+    if (seq == NULL)
+      continue;
+    uint8_t state = atomic_load_explicit(&seq->state, memory_order_acquire);
+    if (state == STATE_STOPPING)
+    {
+      if (atomic_compare_exchange_strong(&seq->state, &state, STATE_IDLE))
+        Finish(seq, i);
+      continue;
+    }
+    if (state == STATE_STARTING && atomic_compare_exchange_strong(&seq->state, &state, STATE_PLAYING))
+    {
+      state = STATE_PLAYING;
+      Start(seq, frame);
+    }
+    if (state != STATE_PLAYING)
+      continue;
+    if (!Dispatch(seq, frame))
+    {
+      // unless the game thread has just asked to play or stop, handled next time
+      if (atomic_compare_exchange_strong(&seq->state, &state, STATE_IDLE))
+        Finish(seq, i);
+      continue;
+    }
+    seq->stats.position_frames = (uint32_t)(frame - seq->loopFrame);
+    if (seq->nextFrame - frame < (uint64_t)until)
+      until = (int)(seq->nextFrame - frame);
+  }
+  return until;
+}
+
+//
+// Sequences
+//
+
+static inline bool ValidTrack(const vmupro_sequence_t *seq, int track)
+{
+  return seq != NULL && track >= 0 && track < seq->trackCount;
+}
+
+// Takes a sequence out of its slot when there is no audio task to do it,
+// with the engine stopped or rendered manually from the game loop
+static void Unregister(vmupro_sequence_t *seq)
+{
+  atomic_store(&seq->state, STATE_IDLE);
+  for (int i = 0; i < VMUPRO_SEQUENCE_MAX_PLAYING; i++)
+  {
+    if (atomic_load(&playingSlots[i]) == seq)
+      Finish(seq, i);
+  }
+}
+
+void vmupro_sequence_free(vmupro_sequence_t *seq)
+{
+  if (seq == NULL)
+    return;
+  vmupro_sequence_stop(seq);
+  while (atomic_load(&seq->registered))
+  {
+    if (!vmupro_synth_engine_has_audio_task())
+      Unregister(seq);
+    else
+      vmupro_sleep_ms(1);
+  }
+  free(seq->events);
+  free(seq);
+}
+
+int vmupro_sequence_get_track_count(const vmupro_sequence_t *seq)
+{
+  return seq != NULL ? seq->trackCount : 0;
+}
+
+bool vmupro_sequence_set_track_synths(vmupro_sequence_t *seq, int track, vmupro_synth_t *const *synths, int count)
+{
+  if (!ValidTrack(seq, track) || count < 0 || count > VMUPRO_SEQUENCE_MAX_TRACK_SYNTHS ||
+      (count > 0 && synths == NULL) || atomic_load(&seq->registered))
+    return false;
+  Track *t = &seq->tracks[track];
+  for (int i = 0; i < count; i++)
+  {
+    if (synths[i] == NULL)
+      return false;
+  }
+  memcpy(t->synths, synths, sizeof(t->synths[0]) * (size_t)count);
+  t->synthCount = (uint8_t)count;
+  t->instrument = NULL;
+  return true;
+}
+
+bool vmupro_sequence_set_track_instrument(vmupro_sequence_t *seq, int track, vmupro_instrument_t *inst)
+{
+  if (!ValidTrack(seq, track) || atomic_load(&seq->registered))
+    return false;
+  Track *t = &seq->tracks[track];
+  t->instrument = inst;
+  t->synthCount = 0;
+  return true;
+}
+
+int vmupro_sequence_get_track_polyphony(const vmupro_sequence_t *seq, int track)
+{
+  return ValidTrack(seq, track) ? seq->tracks[track].polyphony : 0;
+}
+
+int vmupro_sequence_get_track_notes_active(const vmupro_sequence_t *seq, int track)
+{
+  if (!ValidTrack(seq, track))
+    return 0;
+  return atomic_load_explicit(&((vmupro_sequence_t *)seq)->tracks[track].notesActive, memory_order_relaxed);
+}
+
+int vmupro_sequence_get_track_program(const vmupro_sequence_t *seq, int track)
+{
+  if (!ValidTrack(seq, track) || seq->tracks[track].program == NO_PROGRAM)
+    return -1;
+  return seq->tracks[track].program;
+}
+
+bool vmupro_sequence_play(vmupro_sequence_t *seq)
+{
+  if (seq == NULL)
+    return false;
+  if (!vmupro_synth_engine_is_running())
+  {
+    // nothing has played it since the engine stopped
+    if (atomic_load(&seq->registered))
+      Unregister(seq);
+    if (!vmupro_synth_engine_start())
+      return false;
+  }
+  uint8_t state = atomic_load(&seq->state);
+  while (state != STATE_IDLE)
+  {
+    // a stop the audio task hasn't seen yet turns back into a start
+    if (state != STATE_STOPPING || atomic_compare_exchange_strong(&seq->state, &state, STATE_STARTING))
+      return true;
+  }
+  // played to the end, the audio task is letting go of it
+  while (atomic_load(&seq->registered))
+  {
+    if (!vmupro_synth_engine_has_audio_task())
+      Unregister(seq);
+    else
+      vmupro_sleep_ms(1);
+  }
+  if (!schedulerInstalled)
+  {
+    vmupro_synth_engine_set_scheduler(Schedule, NULL);
+    schedulerInstalled = true;
+  }
+
+  atomic_store(&seq->state, STATE_STARTING);
+  atomic_store(&seq->registered, true);
+  for (int i = 0; i < VMUPRO_SEQUENCE_MAX_PLAYING; i++)
+  {
+    vmupro_sequence_t *empty = NULL;
+    if (atomic_compare_exchange_strong_explicit(&playingSlots[i], &empty, seq, memory_order_release,
+                                                memory_order_relaxed))
+      return true;
+  }
+  atomic_store(&seq->state, STATE_IDLE);
+  atomic_store(&seq->registered, false);
+  return false;
+}
+
+void vmupro_sequence_stop(vmupro_sequence_t *seq)
+{
+  if (seq == NULL)
+    return;
+  uint8_t state = atomic_load(&seq->state);
+  while ((state == STATE_STARTING || state == STATE_PLAYING) &&
+         !atomic_compare_exchange_strong(&seq->state, &state, STATE_STOPPING))
+  {
+  }
+  if (atomic_load(&seq->registered) && !vmupro_synth_engine_has_audio_task())
+    Unregister(seq);
+}
+
+void vmupro_sequence_set_looping(vmupro_sequence_t *seq, bool loop)
+{
+  if (seq != NULL)
+    atomic_store(&seq->loop, loop);
+}
+
+bool vmupro_sequence_is_playing(const vmupro_sequence_t *seq)
+{
+  return seq != NULL && atomic_load(&((vmupro_sequence_t *)seq)->state) != STATE_IDLE;
+}
+
+uint32_t vmupro_sequence_get_length(const vmupro_sequence_t *seq)
+{
+  return seq != NULL ? seq->length : 0;
+}
+
+const vmupro_sequence_event_t *vmupro_sequence_get_events(const vmupro_sequence_t *seq, uint32_t *out_count)
+{
+  if (out_count != NULL)
+    *out_count = seq != NULL ? seq->eventCount : 0;
+  return seq != NULL ? seq->events : NULL;
+}
+
+void vmupro_sequence_get_stats(const vmupro_sequence_t *seq, vmupro_sequence_stats_t *out_stats)
+{
+  if (out_stats == NULL)
+    return;
+  if (seq == NULL)
+  {
+    memset(out_stats, 0, sizeof(*out_stats));
+    return;
+  }
+  *out_stats = seq->stats;
+}
@@ -0,0 +1,960 @@
+// sdk/c/src/vmupro_synth.c
+//
+// Band-limited synthesizer, see vmupro_synth.h
+// As in the mixer, the game thread posts commands to the audio task through
+// a single producer/single consumer queue, and whether a synth is sounding
+// is published through one atomic word per synth. Synths render voice by
+// voice, a block of VMUPRO_SYNTH_BLOCK_FRAMES at a time: the oscillator
+// fills a scratch block, then the envelope ramp and stereo gains apply it.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <math.h>
+#include "vmupro_audio.h"
+#include "vmupro_audio_pull.h"
+#include "vmupro_utils.h"
+#include "vmupro_synth.h"
+#include "vmupro_audio_internal.h"
+
+#define COMMAND_SLOTS 128
+#define MAX_VOLUME (VMUPRO_SYNTH_UNITY * 4)
+#define LATENCY_PERIODS 4
+#define SINE_BITS 10
+#define SINE_SIZE (1 << SINE_BITS)
+#define ENV_ONE (1u << 24)
+#define HALF_CYCLE 0x80000000u
+#define PI 3.14159265358979323846
+
+typedef enum
+{
+  CMD_NEW = 0,
+  CMD_SETTINGS,
+  CMD_NOTE,
+  CMD_NOTE_OFF,
+  CMD_STOP,
+} CommandType;
+
+typedef enum
+{
+  ENV_OFF = 0,
+  ENV_ATTACK,
+  ENV_DECAY,
+  ENV_SUSTAIN,
+  ENV_RELEASE,
+  ENV_STOPPING,
+} EnvState;
+
+// Settings as the audio task uses them, envelope rates per block in 8.24
+typedef struct
+{
+  uint8_t waveform;
+  uint16_t volumeL, volumeR;
+  uint16_t param[2];
+  uint32_t attackStep;
+  uint32_t decayStep;
+  uint32_t sustain;
+  uint32_t releaseBlocks;
+} Settings;
+
+typedef struct
+{
+  uint8_t type;
+  uint8_t slot;
+  uint32_t generation;
+  Settings settings;
+  uint32_t inc;
+  int32_t length;
+  uint16_t velocity;
+} Command;
+
+// Owned by the audio task
+typedef struct
+{
+  uint8_t state;
+  uint32_t generation;
+  Settings s;
+  uint32_t phase, inc;
+  uint32_t phase2; // sub oscillator or VOSIM formant
+  uint32_t noise;
+  int32_t noiseValue;
+  int32_t vosimAmp, dcIn, dcOut;
+  uint16_t velocity;
+  int32_t lengthLeft;   // frames until the release, negative to hold
+  uint32_t env;         // 8.24 level
+  int32_t envStep;      // per frame within the block
+  uint32_t envTarget;   // level at the end of the block
+  uint32_t releaseStep; // per block
+  int ctrlLeft;         // frames left in the block
+  vmupro_synth_stats_t stats;
+} Voice;
+
+// Owned by the game thread
+struct vmupro_synth
+{
+  bool used;
+  uint32_t generation;
+  uint32_t attackMs, decayMs, releaseMs;
+  uint16_t sustain;
+  Settings settings;
+};
+
+static vmupro_synth_t synths[VMUPRO_SYNTH_MAX];
+static Voice voices[VMUPRO_SYNTH_MAX];
+
+// generation << 1 | sounding, set by the game thread on a note, cleared by
+// the audio task when the note it was started with ends
+static _Atomic uint32_t synthStatus[VMUPRO_SYNTH_MAX];
+
+static Command commands[COMMAND_SLOTS];
+static Queue commandQueue = QUEUE_OF(commands);
+
+static atomic_bool running = false;
+// started by vmupro_synth_engine_start(), rendering on the pull mode audio task
+static bool ownsOutput = false;
+static vmupro_synth_engine_stats_t engineStats;
+
+// frames rendered since the engine was first started, and the scheduler
+// asked before each stretch of them
+static uint64_t enginePosition = 0;
+static _Atomic(vmupro_synth_scheduler_t) scheduler = NULL;
+static void *_Atomic schedulerUser = NULL;
+// sound mixed in after the synths, e.g. sampled instruments
+static _Atomic(vmupro_synth_source_t) source = NULL;
+static void *_Atomic sourceUser = NULL;
+
+static int16_t sineTable[SINE_SIZE + 1];
+static bool sineReady = false;
+static int32_t renderAcc[VMUPRO_SYNTH_PERIOD_FRAMES * 2];
+
+// MIDI notes 120 to 131 in 16.16 Hz, lower octaves are shifted down
+static const uint32_t topOctave[12] = {548668578u, 581294109u, 615859655u, 652480576u, 691279090u, 732384684u,
+                                       775934544u, 822074013u, 870957077u, 922746880u, 977616265u, 1035748353u};
+
+static inline int SlotOf(const vmupro_synth_t *synth)
+{
+  return (int)(synth - synths);
+}
+
+static inline bool InPool(const vmupro_synth_t *synth)
+{
+  return synth != NULL && synth >= synths && synth < synths + VMUPRO_SYNTH_MAX;
+}
+
+static inline bool Valid(const vmupro_synth_t *synth)
+{
+  return InPool(synth) && synth->used;
+}
+
+//
+// Queue
+//
+
+static bool PostCommandWait(const Command *cmd)
+{
+  return atomic_load(&running) && QueuePostWait(&commandQueue, cmd, vmupro_synth_engine_has_audio_task);
+}
+
+//
+// Oscillators
+//
+
+static void BuildSineTable(void)
+{
+  if (sineReady)
+    return;
+  for (int i = 0; i <= SINE_SIZE; i++)
+    sineTable[i] = (int16_t)lround(32767.0 * sin(2.0 * PI * i / SINE_SIZE));
+  sineReady = true;
+}
+
+static inline int32_t Sine(uint32_t phase)
+{
+  uint32_t i = phase >> (32 - SINE_BITS);
+  int32_t frac = (int32_t)((phase >> (16 - SINE_BITS)) & 0xffff);
+  int32_t a = sineTable[i];
+  return a + (((sineTable[i + 1] - a) * frac) >> 16);
+}
+
+// 1 - distance / dt in Q15 when the phase is within dt of a discontinuity
+// at 0, otherwise -1. rcp is 2^47 / dt
+static inline int32_t EdgeCloseness(uint32_t t, uint32_t dt, uint64_t rcp, bool *after)
+{
+  uint32_t dist;
+  if (t < dt)
+  {
+    dist = t;
+    *after = true;
+  }
+  else if (0u - t <= dt)
+  {
+    dist = 0u - t;
+    *after = false;
+  }
+  else
+  {
+    return -1;
+  }
+  int32_t x = (int32_t)(((uint64_t)dist * rcp) >> 32);
+  return x >= 32768 ? 0 : 32768 - x;
+}
+
+// PolyBLEP residual for a step of -2 to +2 at phase 0, Q15
+static inline int32_t PolyBlep(uint32_t t, uint32_t dt, uint64_t rcp)
+{
+  bool after;
+  int32_t y = EdgeCloseness(t, dt, rcp, &after);
+  if (y <= 0)
+    return 0;
+  int32_t r = (y * y) >> 15;
+  return after ? -r : r;
+}
+
+// PolyBLAMP residual for a unit change of slope per sample at phase 0, Q15
+static inline int32_t PolyBlamp(uint32_t t, uint32_t dt, uint64_t rcp)
+{
+  bool after;
+  int32_t y = EdgeCloseness(t, dt, rcp, &after);
+  if (y <= 0)
+    return 0;
+  int32_t y2 = (y * y) >> 15;
+  return ((y2 * y) >> 15) / 6;
+}
+
+static inline uint32_t NextNoise(uint32_t x)
+{
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+// Fills out with n frames of the voice's waveform, Q15
+static void RenderOscillator(Voice *v, int32_t *out, int n)
+{
+  uint32_t p = v->phase;
+  uint32_t dt = v->inc;
+  uint64_t rcp = ((uint64_t)1 << 47) / (dt ? dt : 1);
+  switch (v->s.waveform)
+  {
+  case VMUPRO_SYNTH_SQUARE:
+    for (int i = 0; i < n; i++, p += dt)
+    {
+      int32_t naive = p < HALF_CYCLE ? 32768 : -32768;
+      out[i] = naive + PolyBlep(p, dt, rcp) - PolyBlep(p - HALF_CYCLE, dt, rcp);
+    }
+    break;
+
+  case VMUPRO_SYNTH_TRIANGLE:
+  {
+    // corners at 0 and half a cycle, the slope changing by 8 * dt per sample
+    for (int i = 0; i < n; i++, p += dt)
+    {
+      int32_t naive = p < HALF_CYCLE ? (int32_t)(p >> 15) - 32768 : 98304 - (int32_t)(p >> 15);
+      int32_t r = PolyBlamp(p, dt, rcp) - PolyBlamp(p - HALF_CYCLE, dt, rcp);
+      out[i] = naive + (int32_t)(((int64_t)r * dt) >> 29);
+    }
+    break;
+  }
+
+  case VMUPRO_SYNTH_SINE:
+    for (int i = 0; i < n; i++, p += dt)
+      out[i] = Sine(p);
+    break;
+
+  case VMUPRO_SYNTH_NOISE:
+    for (int i = 0; i < n; i++)
+    {
+      uint32_t before = p >> 28;
+      p += dt;
+      if (p >> 28 != before || dt >= (1u << 28))
+      {
+        v->noise = NextNoise(v->noise);
+        v->noiseValue = (int16_t)(v->noise >> 16);
+      }
+      out[i] = v->noiseValue;
+    }
+    break;
+
+  case VMUPRO_SYNTH_SAWTOOTH:
+    for (int i = 0; i < n; i++, p += dt)
+      out[i] = (int32_t)(p >> 16) - 32768 - PolyBlep(p, dt, rcp);
+    break;
+
+  case VMUPRO_SYNTH_PO_PHASE:
+  {
+    // the first half of the sine is squeezed into [0, knee), kept a few
+    // samples wide so the bend doesn't alias
+    uint32_t minKnee = dt < HALF_CYCLE / 4 ? dt * 4 : HALF_CYCLE;
+    uint32_t knee = HALF_CYCLE - (uint32_t)(((uint64_t)(HALF_CYCLE - minKnee) * v->s.param[0]) >> 8);
+    uint64_t rise = ((uint64_t)HALF_CYCLE << 16) / knee;
+    uint64_t fall = ((uint64_t)HALF_CYCLE << 16) / (0u - knee);
+    int32_t octave = v->s.param[1];
+    for (int i = 0; i < n; i++, p += dt)
+    {
+      uint32_t w = p < knee ? (uint32_t)(((uint64_t)p * rise) >> 16)
+                            : HALF_CYCLE + (uint32_t)(((uint64_t)(p - knee) * fall) >> 16);
+      out[i] = (Sine(w) * (VMUPRO_SYNTH_UNITY - octave) + Sine(w * 2) * octave) >> 8;
+    }
+    break;
+  }
+
+  case VMUPRO_SYNTH_PO_DIGITAL:
+  {
+    // pulse 50% to 5% wide with its DC removed, plus a band-limited square
+    // an octave down
+    uint32_t width = HALF_CYCLE - (uint32_t)(((uint64_t)(HALF_CYCLE - HALF_CYCLE / 10) * v->s.param[0]) >> 8);
+    if (width < dt * 2)
+      width = dt * 2;
+    int32_t dc = (int32_t)(width >> 16) - 32768;
+    uint32_t subDt = dt >> 1;
+    uint32_t q = v->phase2;
+    int32_t sub = v->s.param[1] >> 1;
+    for (int i = 0; i < n; i++, p += dt, q += subDt)
+    {
+      int32_t pulse = (p < width ? 32768 : -32768) - dc + PolyBlep(p, dt, rcp) - PolyBlep(p - width, dt, rcp);
+      int32_t low = (q < HALF_CYCLE ? 32768 : -32768) + PolyBlep(q, subDt, rcp * 2) -
+                    PolyBlep(q - HALF_CYCLE, subDt, rcp * 2);
+      out[i] = (pulse * (VMUPRO_SYNTH_UNITY - sub) + low * sub) >> 8;
+    }
+    v->phase2 = q;
+    break;
+  }
+
+  case VMUPRO_SYNTH_PO_VOSIM:
+  {
+    // sin^2 pulses at the formant, each param 1 quieter than the last,
+    // restarting every cycle of the note; a one pole high pass takes out
+    // the DC of the pulse train
+    uint64_t formant = ((uint64_t)dt * (256 + 7 * v->s.param[0])) >> 8;
+    uint32_t fdt = formant >= HALF_CYCLE ? HALF_CYCLE - 1 : (uint32_t)formant;
+    int32_t decay = 32768 - ((v->s.param[1] * 29491) >> 8);
+    uint32_t q = v->phase2;
+    for (int i = 0; i < n; i++)
+    {
+      uint32_t last = p;
+      p += dt;
+      if (p < last)
+      {
+        q = 0;
+        v->vosimAmp = 32768;
+      }
+      else
+      {
+        uint32_t lastQ = q;
+        q += fdt;
+        if (q < lastQ)
+          v->vosimAmp = (v->vosimAmp * decay) >> 15;
+      }
+      int32_t pulse = (32768 - Sine(q + (HALF_CYCLE >> 1))) >> 1;
+      int32_t x = (pulse * v->vosimAmp) >> 14;
+      v->dcOut = x - v->dcIn + ((v->dcOut * 32604) >> 15);
+      v->dcIn = x;
+      out[i] = v->dcOut;
+    }
+    v->phase2 = q;
+    break;
+  }
+
+  default:
+    memset(out, 0, (size_t)n * sizeof(int32_t));
+    p += dt * (uint32_t)n;
+    break;
+  }
+  v->phase = p;
+}
+
+//
+// Audio task
+//
+
+static void EndVoice(int slot)
+{
+  Voice *v = &voices[slot];
+  v->state = ENV_OFF;
+  uint32_t sounding = v->generation << 1 | 1;
+  atomic_compare_exchange_strong_explicit(&synthStatus[slot], &sounding, v->generation << 1, memory_order_release,
+                                          memory_order_relaxed);
+}
+
+static void StartRelease(Voice *v)
+{
+  v->state = ENV_RELEASE;
+  v->releaseStep = v->env / v->s.releaseBlocks;
+  if (v->releaseStep == 0)
+    v->releaseStep = 1;
+  v->lengthLeft = -1;
+  v->ctrlLeft = 0;
+}
+
+static void NoteOn(Voice *v, uint32_t inc, uint16_t velocity, int32_t length)
+{
+  if (v->state == ENV_OFF)
+  {
+    v->phase = 0;
+    v->phase2 = 0;
+    v->env = 0;
+    v->vosimAmp = 32768;
+    v->dcIn = v->dcOut = 0;
+  }
+  v->state = ENV_ATTACK;
+  v->inc = inc;
+  v->velocity = velocity;
+  v->lengthLeft = length;
+  v->ctrlLeft = 0;
+  v->stats.notes++;
+}
+
+static void RunCommands(void)
+{
+  uint32_t tail;
+  uint32_t head = QueuePending(&commandQueue, &tail);
+  for (; tail != head; tail++)
+  {
+    const Command *cmd = QueueAt(&commandQueue, tail);
+    Voice *v = &voices[cmd->slot];
+    if (cmd->type == CMD_NEW)
+    {
+      memset(v, 0, sizeof(*v));
+      v->generation = cmd->generation;
+      v->s = cmd->settings;
+      v->noise = 0x9e3779b9u ^ cmd->slot;
+      continue;
+    }
+    if (cmd->type == CMD_SETTINGS)
+    {
+      v->s = cmd->settings;
+      continue;
+    }
+    if (cmd->type == CMD_NOTE)
+    {
+      v->generation = cmd->generation;
+      NoteOn(v, cmd->inc, cmd->velocity, cmd->length);
+      continue;
+    }
+    if (v->state == ENV_OFF || v->generation != cmd->generation)
+      continue;
+    if (cmd->type == CMD_NOTE_OFF && v->state != ENV_RELEASE && v->state != ENV_STOPPING)
+    {
+      StartRelease(v);
+    }
+    else if (cmd->type == CMD_STOP)
+    {
+      v->state = ENV_STOPPING;
+      v->lengthLeft = -1;
+      v->ctrlLeft = 0;
+    }
+  }
+  QueueConsumed(&commandQueue, tail);
+}
+
+// Works out where the envelope is heading by the end of the next block
+static void StartBlock(Voice *v)
+{
+  uint32_t env = v->env;
+  uint32_t target = env;
+  switch (v->state)
+  {
+  case ENV_ATTACK:
+    target = ENV_ONE - env > v->s.attackStep ? env + v->s.attackStep : ENV_ONE;
+    if (target == ENV_ONE)
+      v->state = ENV_DECAY;
+    break;
+  case ENV_DECAY:
+    target = env > v->s.sustain + v->s.decayStep ? env - v->s.decayStep : v->s.sustain;
+    if (target == v->s.sustain)
+      v->state = ENV_SUSTAIN;
+    break;
+  case ENV_SUSTAIN:
+    target = v->s.sustain;
+    break;
+  case ENV_RELEASE:
+    target = env > v->releaseStep ? env - v->releaseStep : 0;
+    break;
+  default:
+    target = 0;
+    break;
+  }
+  v->envTarget = target;
+  v->envStep = ((int32_t)target - (int32_t)env) / VMUPRO_SYNTH_BLOCK_FRAMES;
+  v->ctrlLeft = VMUPRO_SYNTH_BLOCK_FRAMES;
+  v->stats.blocks++;
+}
+
+// Adds frames of one voice to the 8.8 accumulator, block by block
+static void RenderVoice(int slot, int32_t *acc, int frames)
+{
+  Voice *v = &voices[slot];
+  int32_t osc[VMUPRO_SYNTH_BLOCK_FRAMES];
+  int done = 0;
+  while (done < frames && v->state != ENV_OFF)
+  {
+    if (v->lengthLeft == 0)
+      StartRelease(v);
+    if (v->ctrlLeft == 0)
+      StartBlock(v);
+
+    int n = frames - done < v->ctrlLeft ? frames - done : v->ctrlLeft;
+    if (v->lengthLeft > 0 && v->lengthLeft < n)
+      n = v->lengthLeft;
+
+    RenderOscillator(v, osc, n);
+    int32_t gainL = (v->s.volumeL * v->velocity) >> 8;
+    int32_t gainR = (v->s.volumeR * v->velocity) >> 8;
+    int32_t env = (int32_t)v->env;
+    int32_t step = v->envStep;
+    int32_t *out = acc + done * 2;
+    for (int i = 0; i < n; i++)
+    {
+      int32_t s = (int32_t)(((int64_t)osc[i] * (env >> 9)) >> 15);
+      out[i * 2] += s * gainL;
+      out[i * 2 + 1] += s * gainR;
+      env += step;
+    }
+
+    v->ctrlLeft -= n;
+    v->env = v->ctrlLeft == 0 ? v->envTarget : (uint32_t)env;
+    if (v->lengthLeft > 0)
+      v->lengthLeft -= n;
+    v->stats.frames += (uint64_t)n;
+    done += n;
+
+    if (v->ctrlLeft == 0 && v->env == 0 && (v->state == ENV_RELEASE || v->state == ENV_STOPPING))
+      EndVoice(slot);
+  }
+}
+
+static void RenderChunk(int16_t *out, int frames)
+{
+  memset(renderAcc, 0, (size_t)frames * 2 * sizeof(int32_t));
+  uint64_t start = vmupro_get_time_us();
+  uint64_t mark = start;
+  int active = 0;
+  for (int i = 0; i < VMUPRO_SYNTH_MAX; i++)
+  {
+    if (voices[i].state == ENV_OFF)
+      continue;
+    active++;
+    RenderVoice(i, renderAcc, frames);
+    // chained timestamps, so rounding doesn't pile up in either direction
+    uint64_t now = vmupro_get_time_us();
+    voices[i].stats.render_us += now - mark;
+    mark = now;
+  }
+  vmupro_synth_source_t add = atomic_load_explicit(&source, memory_order_acquire);
+  if (add != NULL)
+    add(renderAcc, frames, atomic_load_explicit(&sourceUser, memory_order_relaxed));
+
+  uint32_t clipped = 0;
+  for (int i = 0; i < frames * 2; i++)
+  {
+    int32_t s = renderAcc[i] >> 8;
+    if (s > INT16_MAX || s < INT16_MIN)
+    {
+      s = s > INT16_MAX ? INT16_MAX : INT16_MIN;
+      clipped++;
+    }
+    out[i] = (int16_t)s;
+  }
+
+  uint32_t us = (uint32_t)(vmupro_get_time_us() - start);
+  engineStats.renders++;
+  engineStats.clipped += clipped;
+  engineStats.active_synths = (uint8_t)active;
+  if (active > engineStats.peak_synths)
+    engineStats.peak_synths = (uint8_t)active;
+  engineStats.last_render_us = us;
+  if (us > engineStats.max_render_us)
+    engineStats.max_render_us = us;
+  engineStats.total_us += us;
+  engineStats.frames += (uint64_t)frames;
+}
+
+static void RenderFrames(int16_t *stereo, int frames)
+{
+  vmupro_audio_pull_note_render(AUDIO_ENGINE_SYNTH);
+  RunCommands();
+  vmupro_synth_scheduler_t schedule = atomic_load_explicit(&scheduler, memory_order_acquire);
+  void *user = atomic_load_explicit(&schedulerUser, memory_order_relaxed);
+  while (frames > 0)
+  {
+    int n = frames < VMUPRO_SYNTH_PERIOD_FRAMES ? frames : VMUPRO_SYNTH_PERIOD_FRAMES;
+    if (schedule != NULL)
+    {
+      int until = schedule(enginePosition, n, user);
+      n = until < 1 ? 1 : until < n ? until : n;
+    }
+    RenderChunk(stereo, n);
+    enginePosition += (uint64_t)n;
+    stereo += n * 2;
+    frames -= n;
+  }
+}
+
+// Pull mode callback, on the audio task
+static void SynthFill(int16_t *samples, int frames, void *user)
+{
+  (void)user;
+  RenderFrames(samples, frames);
+}
+
+//
+// Engine
+//
+
+static void ResetVoices(void)
+{
+  // pending commands are dropped, but synths created since the last render
+  // still start their counters from zero
+  uint32_t tail;
+  uint32_t head = QueuePending(&commandQueue, &tail);
+  for (; tail != head; tail++)
+  {
+    const Command *cmd = QueueAt(&commandQueue, tail);
+    if (cmd->type == CMD_NEW)
+      memset(&voices[cmd->slot].stats, 0, sizeof(voices[cmd->slot].stats));
+  }
+  QueueConsumed(&commandQueue, head);
+  for (int i = 0; i < VMUPRO_SYNTH_MAX; i++)
+  {
+    vmupro_synth_stats_t stats = voices[i].stats;
+    memset(&voices[i], 0, sizeof(voices[i]));
+    voices[i].stats = stats;
+    voices[i].generation = synths[i].generation;
+    voices[i].s = synths[i].settings;
+    voices[i].noise = 0x9e3779b9u ^ (uint32_t)i;
+    atomic_store(&synthStatus[i], synths[i].generation << 1);
+  }
+}
+
+static bool Open(void)
+{
+  if (atomic_load(&running))
+    return false;
+  BuildSineTable();
+  memset(&engineStats, 0, sizeof(engineStats));
+  ResetVoices();
+  atomic_store(&running, true);
+  return true;
+}
+
+bool vmupro_synth_engine_start(void)
+{
+  if (atomic_load(&running))
+    return ownsOutput;
+  if (!Open())
+    return false;
+
+  vmupro_audio_pull_config_t config = {VMUPRO_SYNTH_PERIOD_FRAMES, LATENCY_PERIODS, true, true};
+  if (!vmupro_audio_pull_start(&config, SynthFill, NULL))
+  {
+    atomic_store(&running, false);
+    return false;
+  }
+  vmupro_audio_pull_claim(AUDIO_ENGINE_SYNTH);
+  ownsOutput = true;
+  return true;
+}
+
+bool vmupro_synth_engine_start_manual(void)
+{
+  if (atomic_load(&running))
+    return !ownsOutput;
+  return Open();
+}
+
+void vmupro_synth_engine_render(int16_t *stereo, int frames)
+{
+  if (stereo == NULL || frames <= 0)
+    return;
+  if (!atomic_load(&running) || ownsOutput)
+  {
+    memset(stereo, 0, (size_t)frames * 2 * sizeof(int16_t));
+    return;
+  }
+  RenderFrames(stereo, frames);
+}
+
+void vmupro_synth_engine_stop(void)
+{
+  if (!atomic_load(&running))
+    return;
+  if (ownsOutput)
+    vmupro_audio_pull_stop();
+  atomic_store(&running, false);
+  ownsOutput = false;
+  ResetVoices();
+}
+
+bool vmupro_synth_engine_is_running(void)
+{
+  return atomic_load(&running);
+}
+
+bool vmupro_synth_engine_has_audio_task(void)
+{
+  return atomic_load(&running) && vmupro_audio_pull_renders(AUDIO_ENGINE_SYNTH);
+}
+
+void vmupro_synth_engine_get_stats(vmupro_synth_engine_stats_t *out_stats)
+{
+  if (out_stats != NULL)
+    *out_stats = engineStats;
+}
+
+void vmupro_synth_engine_set_scheduler(vmupro_synth_scheduler_t schedule, void *user)
+{
+  atomic_store_explicit(&schedulerUser, user, memory_order_relaxed);
+  atomic_store_explicit(&scheduler, schedule, memory_order_release);
+}
+
+void vmupro_synth_engine_set_source(vmupro_synth_source_t add, void *user)
+{
+  atomic_store_explicit(&sourceUser, user, memory_order_relaxed);
+  atomic_store_explicit(&source, add, memory_order_release);
+}
+
+//
+// Scheduled notes, on the audio task. The synth belongs to the scheduler's
+// owner while it plays, so only the pool bounds are checked here
+//
+
+void vmupro_synth_render_note_on(vmupro_synth_t *synth, uint32_t frequency, uint16_t velocity)
+{
+  if (!InPool(synth))
+    return;
+  int slot = SlotOf(synth);
+  Voice *v = &voices[slot];
+  if (frequency > (uint32_t)VMUPRO_SYNTH_MAX_FREQUENCY << 16)
+    frequency = (uint32_t)VMUPRO_SYNTH_MAX_FREQUENCY << 16;
+  NoteOn(v, (uint32_t)(((uint64_t)frequency << 16) / VMUPRO_SYNTH_RATE),
+         velocity > VMUPRO_SYNTH_UNITY ? VMUPRO_SYNTH_UNITY : velocity, -1);
+  // sounding under the generation of the last note the game thread played
+  atomic_store_explicit(&synthStatus[slot], v->generation << 1 | 1, memory_order_release);
+}
+
+void vmupro_synth_render_note_off(vmupro_synth_t *synth)
+{
+  if (!InPool(synth))
+    return;
+  Voice *v = &voices[SlotOf(synth)];
+  if (v->state != ENV_OFF && v->state != ENV_RELEASE && v->state != ENV_STOPPING)
+    StartRelease(v);
+}
+
+bool vmupro_synth_render_is_sounding(const vmupro_synth_t *synth)
+{
+  return InPool(synth) && voices[SlotOf(synth)].state != ENV_OFF;
+}
+
+//
+// Synths
+//
+
+static inline uint32_t BlocksFor(uint32_t ms)
+{
+  uint64_t frames = (uint64_t)ms * VMUPRO_SYNTH_RATE / 1000;
+  uint64_t blocks = (frames + VMUPRO_SYNTH_BLOCK_FRAMES / 2) / VMUPRO_SYNTH_BLOCK_FRAMES;
+  return blocks < 1 ? 1 : blocks > 0x7fffffff ? 0x7fffffff : (uint32_t)blocks;
+}
+
+// Converts the game side settings for the audio task
+static void Convert(vmupro_synth_t *synth)
+{
+  Settings *s = &synth->settings;
+  s->sustain = (uint32_t)synth->sustain << 16;
+  s->attackStep = ENV_ONE / BlocksFor(synth->attackMs);
+  s->decayStep = (ENV_ONE - s->sustain) / BlocksFor(synth->decayMs);
+  if (s->decayStep == 0)
+    s->decayStep = 1;
+  s->releaseBlocks = BlocksFor(synth->releaseMs);
+}
+
+static void Update(vmupro_synth_t *synth)
+{
+  Convert(synth);
+  Command cmd = {.type = CMD_SETTINGS, .slot = (uint8_t)SlotOf(synth), .settings = synth->settings};
+  PostCommandWait(&cmd);
+}
+
+static void PostNoteCommand(vmupro_synth_t *synth, CommandType type)
+{
+  Command cmd = {.type = (uint8_t)type, .slot = (uint8_t)SlotOf(synth), .generation = synth->generation};
+  PostCommandWait(&cmd);
+}
+
+vmupro_synth_t *vmupro_synth_new(vmupro_synth_waveform_t waveform)
+{
+  if ((int)waveform < 0 || waveform >= VMUPRO_SYNTH_WAVEFORM_COUNT)
+    return NULL;
+  for (int i = 0; i < VMUPRO_SYNTH_MAX; i++)
+  {
+    vmupro_synth_t *synth = &synths[i];
+    if (synth->used)
+      continue;
+    synth->used = true;
+    synth->attackMs = 0;
+    synth->decayMs = 0;
+    synth->releaseMs = 0;
+    synth->sustain = VMUPRO_SYNTH_UNITY;
+    synth->settings = (Settings){(uint8_t)waveform, VMUPRO_SYNTH_UNITY, VMUPRO_SYNTH_UNITY,
+                                 {VMUPRO_SYNTH_UNITY / 2, VMUPRO_SYNTH_UNITY / 2}, 0, 0, 0, 1};
+    Convert(synth);
+    // a fresh voice, cutting off the fade of a freed synth in this slot
+    Command cmd = {.type = CMD_NEW, .slot = (uint8_t)i, .generation = synth->generation, .settings = synth->settings};
+    if (!PostCommandWait(&cmd))
+      memset(&voices[i].stats, 0, sizeof(voices[i].stats));
+    return synth;
+  }
+  return NULL;
+}
+
+void vmupro_synth_free(vmupro_synth_t *synth)
+{
+  if (!Valid(synth))
+    return;
+  vmupro_synth_stop(synth);
+  synth->used = false;
+}
+
+void vmupro_synth_set_waveform(vmupro_synth_t *synth, vmupro_synth_waveform_t waveform)
+{
+  if (!Valid(synth) || (int)waveform < 0 || waveform >= VMUPRO_SYNTH_WAVEFORM_COUNT)
+    return;
+  synth->settings.waveform = (uint8_t)waveform;
+  Update(synth);
+}
+
+void vmupro_synth_set_attack(vmupro_synth_t *synth, uint32_t ms)
+{
+  if (!Valid(synth))
+    return;
+  synth->attackMs = ms;
+  Update(synth);
+}
+
+void vmupro_synth_set_decay(vmupro_synth_t *synth, uint32_t ms)
+{
+  if (!Valid(synth))
+    return;
+  synth->decayMs = ms;
+  Update(synth);
+}
+
+void vmupro_synth_set_sustain(vmupro_synth_t *synth, uint16_t level)
+{
+  if (!Valid(synth))
+    return;
+  synth->sustain = level > VMUPRO_SYNTH_UNITY ? VMUPRO_SYNTH_UNITY : level;
+  Update(synth);
+}
+
+void vmupro_synth_set_release(vmupro_synth_t *synth, uint32_t ms)
+{
+  if (!Valid(synth))
+    return;
+  synth->releaseMs = ms;
+  Update(synth);
+}
+
+void vmupro_synth_set_volume(vmupro_synth_t *synth, uint16_t left, uint16_t right)
+{
+  if (!Valid(synth))
+    return;
+  synth->settings.volumeL = left > MAX_VOLUME ? MAX_VOLUME : left;
+  synth->settings.volumeR = right > MAX_VOLUME ? MAX_VOLUME : right;
+  Update(synth);
+}
+
+void vmupro_synth_get_volume(const vmupro_synth_t *synth, uint16_t *left, uint16_t *right)
+{
+  bool valid = Valid(synth);
+  if (left)
+    *left = valid ? synth->settings.volumeL : 0;
+  if (right)
+    *right = valid ? synth->settings.volumeR : 0;
+}
+
+bool vmupro_synth_play_note(vmupro_synth_t *synth, uint32_t frequency, uint16_t velocity, int32_t length_ms)
+{
+  if (!Valid(synth) || !atomic_load(&running))
+    return false;
+  if (frequency > (uint32_t)VMUPRO_SYNTH_MAX_FREQUENCY << 16)
+    frequency = (uint32_t)VMUPRO_SYNTH_MAX_FREQUENCY << 16;
+
+  uint32_t generation = (synth->generation + 1) & 0x7fffffff;
+  if (generation == 0)
+    generation = 1;
+  Command cmd = {.type = CMD_NOTE, .slot = (uint8_t)SlotOf(synth), .generation = generation};
+  cmd.inc = (uint32_t)(((uint64_t)frequency << 16) / VMUPRO_SYNTH_RATE);
+  cmd.velocity = velocity > VMUPRO_SYNTH_UNITY ? VMUPRO_SYNTH_UNITY : velocity;
+  cmd.length = length_ms < 0 ? -1 : (int32_t)((int64_t)length_ms * VMUPRO_SYNTH_RATE / 1000);
+  if (cmd.length == 0)
+    cmd.length = 1;
+  if (!PostCommandWait(&cmd))
+    return false;
+  synth->generation = generation;
+  atomic_store_explicit(&synthStatus[SlotOf(synth)], generation << 1 | 1, memory_order_release);
+  return true;
+}
+
+uint32_t vmupro_synth_midi_frequency(int note)
+{
+  if (note < 0 || note > 127)
+    return 0;
+  return topOctave[note % 12] >> (10 - note / 12);
+}
+
+bool vmupro_synth_play_midi_note(vmupro_synth_t *synth, int note, uint16_t velocity, int32_t length_ms)
+{
+  if (note < 0 || note > 127)
+    return false;
+  return vmupro_synth_play_note(synth, vmupro_synth_midi_frequency(note), velocity, length_ms);
+}
+
+void vmupro_synth_note_off(vmupro_synth_t *synth)
+{
+  if (vmupro_synth_is_playing(synth))
+    PostNoteCommand(synth, CMD_NOTE_OFF);
+}
+
+void vmupro_synth_stop(vmupro_synth_t *synth)
+{
+  if (vmupro_synth_is_playing(synth))
+    PostNoteCommand(synth, CMD_STOP);
+}
+
+bool vmupro_synth_is_playing(const vmupro_synth_t *synth)
+{
+  if (!Valid(synth))
+    return false;
+  return atomic_load_explicit(&synthStatus[SlotOf(synth)], memory_order_acquire) == (synth->generation << 1 | 1);
+}
+
+void vmupro_synth_set_parameter(vmupro_synth_t *synth, int index, uint16_t value)
+{
+  if (!Valid(synth) || index < 0 || index > 1)
+    return;
+  synth->settings.param[index] = value > VMUPRO_SYNTH_UNITY ? VMUPRO_SYNTH_UNITY : value;
+  Update(synth);
+}
+
+uint16_t vmupro_synth_get_parameter(const vmupro_synth_t *synth, int index)
+{
+  if (!Valid(synth) || index < 0 || index > 1)
+    return 0;
+  return synth->settings.param[index];
+}
+
+void vmupro_synth_get_stats(const vmupro_synth_t *synth, vmupro_synth_stats_t *out_stats)
+{
+  if (out_stats == NULL)
+    return;
+  if (!Valid(synth))
+  {
+    memset(out_stats, 0, sizeof(*out_stats));
+    return;
+  }
+  *out_stats = voices[SlotOf(synth)].stats;
+}
@@ -0,0 +1,245 @@
+// sdk/c/src/vmupro_text.c
+//
+// Glyph cache, text runs and batched text, see vmupro_text.h
+
+#include <stdint.h>
+#include <string.h>
+#include "vmupro_display.h"
+#include "vmupro_fonts.h"
+#include "vmupro_text.h"
+#include "vmupro_text_blend.h"
+#include "vmupro_dirty_rect.h"
+
+#define SCREEN_W 240
+#define SCREEN_H 240
+
+// Largest character cell that can be captured, the built-in fonts go up to 32x37
+#define CELL_MAX 48
+
+static uint16_t savedCell[CELL_MAX * CELL_MAX];
+
+static bool GetCell(vmupro_font_id_t font_id, int *width, int *height)
+{
+  vmupro_font_info_t info = vmupro_get_font_info(font_id);
+  if (info.Width <= 0 || info.Height <= 0 || info.Width > CELL_MAX || info.Height > CELL_MAX)
+    return false;
+  *width = info.Width;
+  *height = info.Height;
+  return true;
+}
+
+uint32_t vmupro_glyph_cache_size(vmupro_font_id_t font_id, uint8_t first, uint8_t last)
+{
+  int width, height;
+  if (last < first || !GetCell(font_id, &width, &height))
+    return 0;
+  uint32_t count = (uint32_t)(last - first + 1);
+  uint32_t glyphBytes = (uint32_t)((width + 1) / 2 * height);
+  return count * (sizeof(vmupro_glyph_t) + glyphBytes);
+}
+
+bool vmupro_glyph_cache_init(vmupro_glyph_cache_t *cache, vmupro_font_id_t font_id, uint8_t first, uint8_t last,
+                             void *arena, uint32_t arena_size)
+{
+  int width, height;
+  uint32_t size = vmupro_glyph_cache_size(font_id, first, last);
+  if (cache == NULL || arena == NULL || size == 0 || arena_size < size || !GetCell(font_id, &width, &height))
+    return false;
+
+  int count = last - first + 1;
+  cache->font = font_id;
+  cache->first = first;
+  cache->last = last;
+  cache->height = (uint8_t)height;
+  cache->stride = (uint8_t)((width + 1) / 2);
+  cache->glyph_bytes = (uint16_t)(cache->stride * height);
+  cache->glyphs = (vmupro_glyph_t *)arena;
+  cache->coverage = (uint8_t *)arena + count * sizeof(vmupro_glyph_t);
+  memset(cache->coverage, 0, (size_t)count * cache->glyph_bytes);
+
+  uint16_t *fb = (uint16_t *)vmupro_get_back_buffer();
+  for (int y = 0; y < height; y++)
+    memcpy(savedCell + y * width, fb + y * SCREEN_W, width * sizeof(uint16_t));
+
+  vmupro_set_font(font_id);
+  for (int i = 0; i < count; i++)
+  {
+    char text[2] = {(char)(first + i), '\0'};
+    int advance = vmupro_calc_text_length(text);
+    if (advance > width)
+      advance = width;
+    if (advance < 0)
+      advance = 0;
+
+    vmupro_glyph_t *glyph = &cache->glyphs[i];
+    glyph->advance = (uint8_t)advance;
+    glyph->top = 0;
+    glyph->bottom = 0;
+    if (advance == 0)
+      continue;
+
+    // white on black, so the green channel reads back as the coverage
+    vmupro_draw_text(text, 0, 0, VMUPRO_COLOR_WHITE, VMUPRO_COLOR_BLACK);
+    uint8_t *coverage = cache->coverage + i * cache->glyph_bytes;
+    for (int y = 0; y < height; y++)
+    {
+      uint8_t *row = coverage + y * cache->stride;
+      bool inked = false;
+      for (int x = 0; x < advance; x++)
+      {
+        int value = ((Swap16(fb[y * SCREEN_W + x]) >> 5) & 0x3f) >> 2;
+        if (value == 0)
+          continue;
+        row[x >> 1] |= (uint8_t)(value << ((x & 1) ? 0 : 4));
+        inked = true;
+      }
+      if (inked)
+      {
+        if (glyph->bottom == 0)
+          glyph->top = (uint8_t)y;
+        glyph->bottom = (uint8_t)(y + 1);
+      }
+    }
+  }
+
+  for (int y = 0; y < height; y++)
+    memcpy(fb + y * SCREEN_W, savedCell + y * width, width * sizeof(uint16_t));
+  MarkDirtyRect(0, 0, width, height);
+  return true;
+}
+
+static inline const vmupro_glyph_t *FindGlyph(const vmupro_glyph_cache_t *cache, unsigned char c)
+{
+  if (c < cache->first || c > cache->last)
+    return NULL;
+  return &cache->glyphs[c - cache->first];
+}
+
+int vmupro_text_width(const vmupro_glyph_cache_t *cache, const char *text)
+{
+  if (cache == NULL || text == NULL)
+    return 0;
+  int width = 0;
+  for (const unsigned char *p = (const unsigned char *)text; *p; p++)
+  {
+    const vmupro_glyph_t *glyph = FindGlyph(cache, *p);
+    if (glyph != NULL)
+      width += glyph->advance;
+  }
+  return width;
+}
+
+// Blend one glyph's inked rows at (x, y), clipped to the screen
+static void DrawGlyph(uint16_t *fb, const vmupro_glyph_cache_t *cache, int index, int x, int y, const TextColor *color)
+{
+  const vmupro_glyph_t *glyph = &cache->glyphs[index];
+  int y0 = y + glyph->top < 0 ? -y : glyph->top;
+  int y1 = y + glyph->bottom > SCREEN_H ? SCREEN_H - y : glyph->bottom;
+  int x0 = x < 0 ? -x : 0;
+  int x1 = x + glyph->advance > SCREEN_W ? SCREEN_W - x : glyph->advance;
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  const uint8_t *coverage = cache->coverage + index * cache->glyph_bytes;
+  for (int gy = y0; gy < y1; gy++)
+  {
+    const uint8_t *row = coverage + gy * cache->stride;
+    uint16_t *dst = fb + (y + gy) * SCREEN_W + x;
+    for (int gx = x0; gx < x1; gx++)
+    {
+      int value = (row[gx >> 1] >> ((gx & 1) ? 0 : 4)) & 0x0f;
+      if (value == 15)
+        dst[gx] = color->be;
+      else if (value != 0)
+        dst[gx] = BlendCoverage(color, dst[gx], value);
+    }
+  }
+}
+
+static int DrawString(uint16_t *fb, const vmupro_glyph_cache_t *cache, const char *text, int x, int y,
+                      const TextColor *color)
+{
+  int width = 0;
+  bool visibleRows = y < SCREEN_H && y + cache->height > 0;
+  for (const unsigned char *p = (const unsigned char *)text; *p; p++)
+  {
+    const vmupro_glyph_t *glyph = FindGlyph(cache, *p);
+    if (glyph == NULL)
+      continue;
+    if (visibleRows && glyph->bottom > glyph->top)
+      DrawGlyph(fb, cache, (int)(glyph - cache->glyphs), x + width, y, color);
+    width += glyph->advance;
+  }
+  return width;
+}
+
+int vmupro_text_draw(const vmupro_glyph_cache_t *cache, const char *text, int x, int y, uint16_t color)
+{
+  if (cache == NULL || text == NULL)
+    return 0;
+  TextColor c = MakeTextColor(color);
+  int width = DrawString((uint16_t *)vmupro_get_back_buffer(), cache, text, x, y, &c);
+  MarkDirtyRect(x, y, width, cache->height);
+  return width;
+}
+
+bool vmupro_text_run_set(vmupro_text_run_t *run, const vmupro_glyph_cache_t *cache, const char *text)
+{
+  if (run == NULL)
+    return false;
+  run->cache = cache;
+  run->width = 0;
+  run->count = 0;
+  if (cache == NULL || text == NULL)
+    return true;
+
+  int width = 0;
+  for (const unsigned char *p = (const unsigned char *)text; *p; p++)
+  {
+    const vmupro_glyph_t *glyph = FindGlyph(cache, *p);
+    if (glyph == NULL)
+      continue;
+    // blank glyphs only move the pen
+    if (glyph->bottom > glyph->top)
+    {
+      if (run->count == VMUPRO_TEXT_RUN_MAX)
+        return false;
+      run->glyph[run->count] = (uint8_t)(glyph - cache->glyphs);
+      run->x[run->count] = (int16_t)width;
+      run->count++;
+    }
+    width += glyph->advance;
+    run->width = (uint16_t)width;
+  }
+  return true;
+}
+
+void vmupro_text_run_draw(const vmupro_text_run_t *run, int x, int y, uint16_t color)
+{
+  if (run == NULL || run->cache == NULL || run->count == 0)
+    return;
+  const vmupro_glyph_cache_t *cache = run->cache;
+  if (y >= SCREEN_H || y + cache->height <= 0)
+    return;
+
+  TextColor c = MakeTextColor(color);
+  uint16_t *fb = (uint16_t *)vmupro_get_back_buffer();
+  for (int i = 0; i < run->count; i++)
+    DrawGlyph(fb, cache, run->glyph[i], x + run->x[i], y, &c);
+  MarkDirtyRect(x, y, run->width, cache->height);
+}
+
+void vmupro_text_draw_batch(const vmupro_glyph_cache_t *cache, const vmupro_text_item_t *items, int count)
+{
+  if (cache == NULL || items == NULL)
+    return;
+  uint16_t *fb = (uint16_t *)vmupro_get_back_buffer();
+  for (int i = 0; i < count; i++)
+  {
+    if (items[i].text == NULL)
+      continue;
+    TextColor c = MakeTextColor(items[i].color);
+    int width = DrawString(fb, cache, items[i].text, items[i].x, items[i].y, &c);
+    MarkDirtyRect(items[i].x, items[i].y, width, cache->height);
+  }
+}
@@ -0,0 +1,39 @@
+// sdk/c/src/vmupro_text_blend.h
+//
+// Anti-aliased glyph blending shared by vmupro_text.c and vmupro_bmfont.c,
+// internal to the SDK sources
+
+#pragma once
+
+#include <stdint.h>
+
+// Buffers hold big endian RGB565, swap to do channel maths
+static inline uint16_t Swap16(uint16_t v)
+{
+  return (uint16_t)((v >> 8) | (v << 8));
+}
+
+// Text colour split into native RGB565 channels once per draw
+typedef struct
+{
+  uint16_t be;
+  int r, g, b;
+} TextColor;
+
+static inline TextColor MakeTextColor(uint16_t color)
+{
+  uint16_t native = Swap16(color);
+  TextColor c = {color, native >> 11, (native >> 5) & 0x3f, native & 0x1f};
+  return c;
+}
+
+// bg + (fg - bg) * coverage / 15 per channel, matching the firmware's anti-aliasing
+static inline uint16_t BlendCoverage(const TextColor *fg, uint16_t bgBE, int coverage)
+{
+  uint16_t bg = Swap16(bgBE);
+  int br = bg >> 11, bgG = (bg >> 5) & 0x3f, bb = bg & 0x1f;
+  int r = br + (fg->r - br) * coverage / 15;
+  int g = bgG + (fg->g - bgG) * coverage / 15;
+  int b = bb + (fg->b - bb) * coverage / 15;
+  return Swap16((uint16_t)((r << 11) | (g << 5) | b));
+}
@@ -0,0 +1,563 @@
+// sdk/c/src/vmupro_wav_stream.c
+//
+// Streaming WAV playback, see vmupro_wav_stream.h
+// The app loop (reader) and the audio task (decoder) hand the two read
+// buffers back and forth through one atomic flag each: the reader only
+// touches a buffer while it is empty, the decoder only while it is full.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "vmupro_file.h"
+#include "vmupro_utils.h"
+#include "vmupro_audio_pull.h"
+#include "vmupro_resampler.h"
+#include "vmupro_wav_stream.h"
+#include "vmupro_audio_internal.h"
+
+#define OUTPUT_RATE 44100
+#define SCRATCH_FRAMES 128
+#define UNITY_VOLUME 256
+#define MAX_VOLUME (UNITY_VOLUME * 4)
+#define PLAY_PERIOD 256
+#define PLAY_PERIODS 4
+
+typedef struct
+{
+  atomic_bool full;
+  uint32_t start; // first valid byte, past the header on the first read
+  uint32_t end;   // one past the last valid byte
+  bool dataEnd;   // the sample data ends with this buffer
+} ReadBuffer;
+
+typedef enum
+{
+  BYTES_OK = 0,
+  BYTES_STARVED,
+  BYTES_DATA_END,
+} BytesResult;
+
+struct vmupro_wav_stream
+{
+  vmupro_wav_stream_info_t info;
+  const char *path;
+  uint32_t bufferBytes;
+  uint8_t *buffers[2];
+  ReadBuffer meta[2];
+  atomic_bool loop;
+  atomic_bool finished;
+  atomic_uint volume;
+  vmupro_wav_stream_stats_t stats;
+
+  // reader, app loop only
+  int readNext;
+  uint32_t readPos;
+  bool readDone;
+  bool readFailed;
+
+  // decoder, audio task only
+  int decodeNext;
+  uint32_t decodePos;
+  uint8_t pending[8];
+  int pendingLen;
+  bool atDataEnd; // the last group ended the data exactly
+  uint32_t blockLeft; // ADPCM bytes left in the current block, 0 before a header
+  int32_t predictor[2];
+  int stepIndex[2];
+  bool ended;
+  bool flushed;
+  int16_t scratch[SCRATCH_FRAMES * 2];
+  int scratchLen;
+  int scratchPos;
+  vmupro_resampler_t resampler;
+};
+
+static vmupro_wav_stream_t *playing;
+
+static const int16_t imaSteps[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+    9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t imaIndexShift[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+//
+// Header
+//
+
+// Walks the RIFF chunks with small reads, only the sample data is streamed
+static bool ParseHeader(const char *path, vmupro_wav_stream_info_t *info)
+{
+  size_t fileSize = vmupro_get_file_size(path);
+  uint8_t head[12];
+  if (fileSize == (size_t)-1 || fileSize < 12 || fileSize > UINT32_MAX ||
+      !vmupro_read_file_bytes(path, head, 0, 12) || memcmp(head, "RIFF", 4) != 0 || memcmp(head + 8, "WAVE", 4) != 0)
+    return false;
+
+  bool haveFormat = false;
+  uint32_t factFrames = 0;
+  uint32_t at = 12;
+  while (at + 8 <= fileSize)
+  {
+    uint8_t chunk[8 + 20];
+    if (!vmupro_read_file_bytes(path, chunk, at, 8))
+      return false;
+    uint32_t size = Read32(chunk + 4);
+    uint32_t body = at + 8;
+    if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16 && body + 16 <= fileSize)
+    {
+      if (!vmupro_read_file_bytes(path, chunk + 8, body, 16))
+        return false;
+      uint16_t format = Read16(chunk + 8);
+      uint16_t bits = Read16(chunk + 22);
+      info->channels = (uint8_t)Read16(chunk + 10);
+      info->sample_rate = Read32(chunk + 12);
+      info->block_align = Read16(chunk + 20);
+      // 1 is PCM, 0xfffe (extensible) is accepted for its usual PCM contents
+      if ((format == 1 || format == 0xfffe) && bits == 16)
+        info->encoding = VMUPRO_WAV_PCM16;
+      else if ((format == 1 || format == 0xfffe) && bits == 8)
+        info->encoding = VMUPRO_WAV_PCM8;
+      else if (format == 0x11 && bits == 4)
+        info->encoding = VMUPRO_WAV_IMA_ADPCM;
+      else
+        return false;
+      haveFormat = true;
+    }
+    else if (memcmp(chunk, "fact", 4) == 0 && size >= 4 && body + 4 <= fileSize)
+    {
+      if (!vmupro_read_file_bytes(path, chunk + 8, body, 4))
+        return false;
+      factFrames = Read32(chunk + 8);
+    }
+    else if (memcmp(chunk, "data", 4) == 0)
+    {
+      if (!haveFormat)
+        return false;
+      info->data_offset = body;
+      // a truncated file plays what it has
+      info->data_bytes = size < fileSize - body ? size : (uint32_t)(fileSize - body);
+      break;
+    }
+    at = body + size + (size & 1);
+  }
+
+  int channels = info->channels;
+  if (info->data_offset == 0 || channels < 1 || channels > 2 || info->sample_rate < VMUPRO_RESAMPLER_MIN_RATE ||
+      info->sample_rate > VMUPRO_RESAMPLER_MAX_RATE)
+    return false;
+
+  if (info->encoding == VMUPRO_WAV_IMA_ADPCM)
+  {
+    // stereo blocks interleave 4 bytes of each channel after the headers
+    int header = 4 * channels;
+    if (info->block_align <= header || (info->block_align - header) % (4 * channels) != 0)
+      return false;
+    uint32_t perBlock = (uint32_t)(info->block_align - header) * 2 / channels + 1;
+    uint32_t blocks = info->data_bytes / info->block_align;
+    uint32_t tail = info->data_bytes % info->block_align;
+    info->frames = blocks * perBlock + (tail > (uint32_t)header ? (tail - header) * 2 / channels + 1 : 0);
+    if (factFrames != 0 && factFrames < info->frames)
+      info->frames = factFrames;
+  }
+  else
+  {
+    uint32_t frameBytes = (uint32_t)channels * (info->encoding == VMUPRO_WAV_PCM16 ? 2 : 1);
+    if (info->block_align != frameBytes)
+      return false;
+    info->frames = info->data_bytes / frameBytes;
+  }
+  return true;
+}
+
+//
+// Reader
+//
+
+// One aligned read into the next empty buffer; false when there is
+// nothing to do or the read failed
+static bool FillNext(vmupro_wav_stream_t *s)
+{
+  ReadBuffer *b = &s->meta[s->readNext];
+  if (s->readDone || s->readFailed || atomic_load_explicit(&b->full, memory_order_acquire))
+    return false;
+
+  uint32_t dataEnd = s->info.data_offset + s->info.data_bytes;
+  uint32_t aligned = s->readPos & ~(uint32_t)(VMUPRO_WAV_STREAM_ALIGN - 1);
+  uint32_t len = dataEnd - aligned < s->bufferBytes ? dataEnd - aligned : s->bufferBytes;
+
+  uint64_t start = vmupro_get_time_us();
+  if (!vmupro_read_file_bytes(s->path, s->buffers[s->readNext], aligned, (int)len))
+  {
+    s->readFailed = true;
+    return false;
+  }
+  uint32_t us = (uint32_t)(vmupro_get_time_us() - start);
+  s->stats.reads++;
+  s->stats.bytes_read += len;
+  s->stats.last_read_us = us;
+  if (us > s->stats.max_read_us)
+    s->stats.max_read_us = us;
+
+  b->start = s->readPos - aligned;
+  b->end = len;
+  b->dataEnd = aligned + len == dataEnd;
+  s->readPos = aligned + len;
+  if (b->dataEnd)
+  {
+    s->readPos = s->info.data_offset;
+    s->readDone = !atomic_load(&s->loop);
+  }
+  atomic_store_explicit(&b->full, true, memory_order_release);
+  s->readNext ^= 1;
+  return true;
+}
+
+//
+// Decoder
+//
+
+// Gathers n bytes into pending across buffer boundaries. A group cut off
+// by the end of the data is dropped.
+static BytesResult TakeBytes(vmupro_wav_stream_t *s, int n)
+{
+  if (s->atDataEnd)
+  {
+    s->atDataEnd = false;
+    return BYTES_DATA_END;
+  }
+  while (s->pendingLen < n)
+  {
+    ReadBuffer *b = &s->meta[s->decodeNext];
+    if (!atomic_load_explicit(&b->full, memory_order_acquire))
+      return BYTES_STARVED;
+    if (s->decodePos < b->start)
+      s->decodePos = b->start;
+
+    uint32_t take = b->end - s->decodePos;
+    if (take > (uint32_t)(n - s->pendingLen))
+      take = (uint32_t)(n - s->pendingLen);
+    memcpy(s->pending + s->pendingLen, s->buffers[s->decodeNext] + s->decodePos, take);
+    s->pendingLen += (int)take;
+    s->decodePos += take;
+
+    if (s->decodePos == b->end)
+    {
+      bool dataEnd = b->dataEnd;
+      atomic_store_explicit(&b->full, false, memory_order_release);
+      s->decodeNext ^= 1;
+      s->decodePos = 0;
+      if (dataEnd && s->pendingLen < n)
+      {
+        s->pendingLen = 0;
+        return BYTES_DATA_END;
+      }
+      s->atDataEnd = dataEnd;
+    }
+  }
+  return BYTES_OK;
+}
+
+static inline int16_t ImaNibble(vmupro_wav_stream_t *s, int c, int nibble)
+{
+  int step = imaSteps[s->stepIndex[c]];
+  int diff = step >> 3;
+  if (nibble & 1)
+    diff += step >> 2;
+  if (nibble & 2)
+    diff += step >> 1;
+  if (nibble & 4)
+    diff += step;
+  int32_t p = s->predictor[c] + ((nibble & 8) ? -diff : diff);
+  s->predictor[c] = Saturate(p);
+  int index = s->stepIndex[c] + imaIndexShift[nibble];
+  s->stepIndex[c] = index < 0 ? 0 : index > 88 ? 88 : index;
+  return (int16_t)s->predictor[c];
+}
+
+// Decodes one group (a PCM frame, an ADPCM block header or the ADPCM
+// bytes after it) onto the end of the scratch buffer
+static BytesResult DecodeGroup(vmupro_wav_stream_t *s)
+{
+  int channels = s->info.channels;
+  int16_t *out = s->scratch + s->scratchLen * channels;
+  int n;
+  switch (s->info.encoding)
+  {
+  case VMUPRO_WAV_PCM16:
+    n = 2 * channels;
+    break;
+  case VMUPRO_WAV_PCM8:
+    n = channels;
+    break;
+  default:
+    n = s->blockLeft == 0 ? 4 * channels : channels == 2 ? 8 : 1;
+    break;
+  }
+
+  BytesResult r = TakeBytes(s, n);
+  if (r != BYTES_OK)
+  {
+    if (r == BYTES_DATA_END)
+      s->blockLeft = 0;
+    return r;
+  }
+  s->pendingLen = 0;
+  const uint8_t *p = s->pending;
+
+  if (s->info.encoding == VMUPRO_WAV_PCM16)
+  {
+    for (int c = 0; c < channels; c++)
+      out[c] = (int16_t)Read16(p + c * 2);
+    s->scratchLen++;
+  }
+  else if (s->info.encoding == VMUPRO_WAV_PCM8)
+  {
+    for (int c = 0; c < channels; c++)
+      out[c] = (int16_t)((p[c] - 128) << 8);
+    s->scratchLen++;
+  }
+  else if (s->blockLeft == 0)
+  {
+    // the header holds the block's first frame
+    for (int c = 0; c < channels; c++)
+    {
+      s->predictor[c] = (int16_t)Read16(p + c * 4);
+      s->stepIndex[c] = p[c * 4 + 2] > 88 ? 88 : p[c * 4 + 2];
+      out[c] = (int16_t)s->predictor[c];
+    }
+    s->blockLeft = s->info.block_align - 4u * channels;
+    s->scratchLen++;
+  }
+  else if (channels == 1)
+  {
+    out[0] = ImaNibble(s, 0, p[0] & 15);
+    out[1] = ImaNibble(s, 0, p[0] >> 4);
+    s->blockLeft -= 1;
+    s->scratchLen += 2;
+  }
+  else
+  {
+    // 4 bytes (8 frames) of left, then 4 of right
+    for (int c = 0; c < 2; c++)
+    {
+      for (int i = 0; i < 8; i++)
+        out[i * 2 + c] = ImaNibble(s, c, (p[c * 4 + i / 2] >> ((i & 1) * 4)) & 15);
+    }
+    s->blockLeft -= 8;
+    s->scratchLen += 8;
+  }
+  return BYTES_OK;
+}
+
+// Refills the scratch buffer at the file's rate; false when nothing new
+// could be decoded
+static bool DecodeScratch(vmupro_wav_stream_t *s)
+{
+  s->scratchLen = 0;
+  s->scratchPos = 0;
+  while (!s->ended && s->scratchLen <= SCRATCH_FRAMES - 8)
+  {
+    BytesResult r = DecodeGroup(s);
+    if (r == BYTES_STARVED)
+      break;
+    if (r == BYTES_DATA_END)
+    {
+      if (atomic_load(&s->loop))
+        s->stats.loops++;
+      else
+        s->ended = true;
+    }
+  }
+  s->stats.frames_decoded += (uint32_t)s->scratchLen;
+  return s->scratchLen > 0;
+}
+
+// Mono output of the resampler doubled in place into stereo
+static void MonoToStereo(int16_t *frames, int count)
+{
+  for (int i = count - 1; i >= 0; i--)
+  {
+    int16_t v = frames[i];
+    frames[i * 2] = v;
+    frames[i * 2 + 1] = v;
+  }
+}
+
+int vmupro_wav_stream_read(vmupro_wav_stream_t *s, int16_t *stereo, int frames)
+{
+  if (s == NULL || stereo == NULL || frames <= 0)
+    return 0;
+  int channels = s->info.channels;
+  int written = 0;
+  bool starved = false;
+  while (written < frames)
+  {
+    if (s->scratchPos == s->scratchLen && !DecodeScratch(s))
+    {
+      starved = !s->ended;
+      break;
+    }
+    int used = 0;
+    int16_t *dst = stereo + written * 2;
+    int n = vmupro_resampler_process(&s->resampler, s->scratch + s->scratchPos * channels,
+                                     s->scratchLen - s->scratchPos, &used, dst, frames - written);
+    if (channels == 1)
+      MonoToStereo(dst, n);
+    s->scratchPos += used;
+    written += n;
+  }
+
+  // the last few frames are still inside the conversion filter
+  if (s->ended && !s->flushed && s->scratchPos == s->scratchLen && frames - written >= VMUPRO_RESAMPLER_MAX_TAPS)
+  {
+    int n = vmupro_resampler_flush(&s->resampler, stereo + written * 2, frames - written);
+    if (channels == 1)
+      MonoToStereo(stereo + written * 2, n);
+    written += n;
+    s->flushed = true;
+    atomic_store(&s->finished, true);
+  }
+  if (starved)
+    s->stats.underruns++;
+
+  uint32_t volume = atomic_load(&s->volume);
+  if (volume != UNITY_VOLUME)
+  {
+    for (int i = 0; i < written * 2; i++)
+      stereo[i] = Saturate((int32_t)stereo[i] * (int32_t)volume >> 8);
+  }
+  memset(stereo + written * 2, 0, (size_t)(frames - written) * 2 * sizeof(int16_t));
+  return written;
+}
+
+//
+// Stream
+//
+
+vmupro_wav_stream_t *vmupro_wav_stream_open(const char *path, const vmupro_wav_stream_config_t *config)
+{
+  vmupro_wav_stream_config_t c = config != NULL ? *config : vmupro_wav_stream_defaults();
+  vmupro_wav_stream_info_t info;
+  memset(&info, 0, sizeof(info));
+  if (path == NULL || !ParseHeader(path, &info))
+    return NULL;
+
+  uint32_t bufferBytes = (c.buffer_bytes + VMUPRO_WAV_STREAM_ALIGN - 1) & ~(uint32_t)(VMUPRO_WAV_STREAM_ALIGN - 1);
+  if (bufferBytes < VMUPRO_WAV_STREAM_MIN_BUFFER)
+    bufferBytes = VMUPRO_WAV_STREAM_MIN_BUFFER;
+  if (bufferBytes > VMUPRO_WAV_STREAM_MAX_BUFFER)
+    bufferBytes = VMUPRO_WAV_STREAM_MAX_BUFFER;
+
+  // the stream, both buffers and the path share one allocation
+  size_t header = (sizeof(vmupro_wav_stream_t) + 3) & ~(size_t)3;
+  size_t pathLen = strlen(path) + 1;
+  uint8_t *block = malloc(header + 2 * (size_t)bufferBytes + pathLen);
+  if (block == NULL)
+    return NULL;
+  vmupro_wav_stream_t *s = (vmupro_wav_stream_t *)block;
+  memset(s, 0, sizeof(*s));
+  s->info = info;
+  s->bufferBytes = bufferBytes;
+  s->buffers[0] = block + header;
+  s->buffers[1] = block + header + bufferBytes;
+  memcpy(block + header + 2 * (size_t)bufferBytes, path, pathLen);
+  s->path = (const char *)(block + header + 2 * (size_t)bufferBytes);
+  atomic_init(&s->meta[0].full, false);
+  atomic_init(&s->meta[1].full, false);
+  atomic_init(&s->loop, c.loop);
+  atomic_init(&s->finished, false);
+  atomic_init(&s->volume, UNITY_VOLUME);
+  s->readPos = info.data_offset;
+
+  // a 44.1kHz file goes through unchanged at the linear setting
+  vmupro_resample_quality_t quality = info.sample_rate == OUTPUT_RATE ? VMUPRO_RESAMPLE_LINEAR : c.quality;
+  vmupro_resampler_init(&s->resampler, info.sample_rate, OUTPUT_RATE, info.channels, quality);
+
+  vmupro_wav_stream_update(s);
+  if (s->readFailed)
+  {
+    free(block);
+    return NULL;
+  }
+  return s;
+}
+
+void vmupro_wav_stream_close(vmupro_wav_stream_t *s)
+{
+  if (s == NULL)
+    return;
+  vmupro_wav_stream_stop(s);
+  free(s);
+}
+
+void vmupro_wav_stream_get_info(const vmupro_wav_stream_t *s, vmupro_wav_stream_info_t *out_info)
+{
+  if (s != NULL && out_info != NULL)
+    *out_info = s->info;
+}
+
+bool vmupro_wav_stream_update(vmupro_wav_stream_t *s)
+{
+  if (s == NULL)
+    return false;
+  // looping switched back on after the last read
+  if (s->readDone && atomic_load(&s->loop) && !atomic_load(&s->finished))
+    s->readDone = false;
+  while (FillNext(s))
+    ;
+  return !s->readFailed && !atomic_load(&s->finished);
+}
+
+static void PlayFill(int16_t *samples, int frames, void *user)
+{
+  vmupro_wav_stream_read((vmupro_wav_stream_t *)user, samples, frames);
+}
+
+bool vmupro_wav_stream_play(vmupro_wav_stream_t *s)
+{
+  if (s == NULL || playing != NULL)
+    return false;
+  vmupro_audio_pull_config_t config = vmupro_audio_pull_defaults();
+  config.period_frames = PLAY_PERIOD;
+  config.periods = PLAY_PERIODS;
+  if (!vmupro_audio_pull_start(&config, PlayFill, s))
+    return false;
+  playing = s;
+  return true;
+}
+
+void vmupro_wav_stream_stop(vmupro_wav_stream_t *s)
+{
+  if (s == NULL || playing != s)
+    return;
+  vmupro_audio_pull_stop();
+  playing = NULL;
+}
+
+bool vmupro_wav_stream_is_finished(const vmupro_wav_stream_t *s)
+{
+  return s == NULL || atomic_load(&s->finished);
+}
+
+void vmupro_wav_stream_set_loop(vmupro_wav_stream_t *s, bool loop)
+{
+  if (s != NULL)
+    atomic_store(&s->loop, loop);
+}
+
+void vmupro_wav_stream_set_volume(vmupro_wav_stream_t *s, uint16_t volume)
+{
+  if (s != NULL)
+    atomic_store(&s->volume, volume > MAX_VOLUME ? MAX_VOLUME : volume);
+}
+
+void vmupro_wav_stream_get_stats(const vmupro_wav_stream_t *s, vmupro_wav_stream_stats_t *out_stats)
+{
+  if (s != NULL && out_stats != NULL)
+    *out_stats = s->stats;
+}
@@ -0,0 +1,118 @@
+// tools/hostsim/bench/bench.h
+//
+// Assets and helpers shared by the benchmark cases in bench_display.c and
+// the --verify suites in verify_display.c, verify_text.c, verify_audio.c
+// and verify_file.c. Everything here is set up by InitAssets() or by the
+// Setup* helper named with it
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "vmupro_sdk.h"
+
+//
+// Display assets (bench_display.c)
+//
+
+#define SPRITE_SIZE 64
+#define BG_SIZE 256
+#define TILE_SIZE 65
+
+// 8x4 atlas of 16x16 tiles and the maps drawn from it
+#define ATLAS_W 128
+#define ATLAS_H 64
+#define MAP_W 40
+#define MAP_H 30
+
+#define CROWD_SIZE 128
+
+extern uint16_t sprite[SPRITE_SIZE * SPRITE_SIZE];
+extern uint16_t background[BG_SIZE * BG_SIZE];
+extern uint16_t tile[TILE_SIZE * TILE_SIZE];
+extern uint16_t indexedPalette[256];
+extern uint8_t sprite8[VMUPRO_INDEXED_HEADER_SIZE + SPRITE_SIZE * SPRITE_SIZE];
+extern uint8_t sprite4[VMUPRO_INDEXED_HEADER_SIZE + SPRITE_SIZE * SPRITE_SIZE / 2];
+extern uint8_t layer8[VMUPRO_INDEXED_HEADER_SIZE + BG_SIZE * BG_SIZE];
+extern uint8_t tileMap8[MAP_W * MAP_H];
+extern uint8_t tileAttributes[MAP_W * MAP_H];
+extern uint8_t tileRowClasses[32 * 16];
+extern vmupro_tilemap_t tilemap;
+extern uint8_t tileAtlas8[VMUPRO_INDEXED_HEADER_SIZE + ATLAS_W * ATLAS_H];
+extern uint8_t tileAtlas4[VMUPRO_INDEXED_HEADER_SIZE + ATLAS_W * ATLAS_H / 2];
+extern vmupro_raster_palette_t rasterPalettes[2];
+extern vmupro_display_list_t displayList;
+extern uint16_t blendLayer[240 * 240];
+extern vmupro_sprite_t crowd[CROWD_SIZE];
+
+void MakeIndexed(uint8_t *out, int width, int height, int bpp, int (*index)(int x, int y));
+void ExpandIndexed(const uint8_t *image, uint16_t *out, int transparentIndex, uint16_t key);
+int Index4(int x, int y);
+void RasterFromTable(int line, vmupro_raster_line_t *params, void *user_data);
+void CrowdFrame(int frame);
+void SceneBackground(int f);
+void ScenePlayfield(int f);
+void SceneHud(int f);
+void DrawFrame(int f, bool leaveWindow);
+
+//
+// Text assets (bench_display.c)
+//
+
+#define BMF_LINE_HEIGHT 16
+
+extern uint8_t glyphArena[65536];
+extern const uint32_t bmfExtra[4];
+extern uint32_t bmfData[8192];
+
+int BmfWidth(uint32_t cp);
+int BmfHeight(uint32_t cp);
+int BmfXOffset(uint32_t cp);
+int BmfYOffset(uint32_t cp);
+int BmfAdvance(uint32_t cp);
+int BmfCoverage(uint32_t cp, int x, int y);
+int BmfKerning(uint32_t first, uint32_t second);
+uint32_t MakeBmFont(void);
+
+//
+// Audio assets (bench_display.c)
+//
+
+#define MIX_MONO_FRAMES 4410
+#define MIX_STEREO_FRAMES 3000
+#define MIX_HALF_FRAMES 2205
+#define MIX_LOUD_FRAMES 1024
+#define INST_FRAMES 40000
+
+// A MIDI file event: its tick and its bytes, status first
+typedef struct
+{
+  uint32_t tick;
+  uint8_t size;
+  uint8_t bytes[6];
+} SmfEvent;
+
+extern int16_t mixStereo[MIX_STEREO_FRAMES * 2];
+extern int16_t mixHalf[MIX_HALF_FRAMES];
+extern vmupro_sound_sample_t sndMono, sndStereo, sndHalf, sndLoud;
+extern vmupro_synth_t *benchSynths[VMUPRO_SYNTH_MAX];
+extern int16_t instMono[INST_FRAMES];
+
+void SetupMixerSamples(void);
+uint32_t WriteSmfHeader(uint8_t *out, int tracks, int division);
+uint32_t WriteSmfTrack(uint8_t *out, const SmfEvent *events, int count, uint32_t endTick);
+void InstrumentTone(int16_t *out, int samples, uint32_t seed);
+bool WriteInstrumentWav(const char *path, const int16_t *pcm, uint32_t frames, int channels, uint32_t rate);
+
+//
+// --verify suites, each returning its number of mismatches
+//
+
+// Screen copy the display and text suites compare the back buffer with
+extern uint16_t reference[240 * 240];
+int CompareWithReference(const char *what, int x, int y, int w, int h, int flags);
+
+int RunDisplayVerify(void);
+int RunTextVerify(void);
+int RunAudioVerify(void);
+int RunFileVerify(void);
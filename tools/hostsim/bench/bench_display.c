@@ -0,0 +1,1210 @@
+// tools/hostsim/bench/bench_display.c
+//
+// Micro benchmark for the display API running against the host simulator
+// Reports ns per call and ns per destination pixel for each blit variant
+//
+// Usage:
+//   bench_display [-n iterations] [--csv out.csv] [--baseline base.csv] [--tolerance pct]
+//   bench_display --verify
+//
+// With --baseline, exits non-zero when any case is more than
+// --tolerance percent (default 25) slower per pixel than the baseline
+// --verify runs the cross-checks in verify_display.c, verify_text.c,
+// verify_audio.c and verify_file.c, and exits non-zero on any difference
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "vmupro_sdk.h"
+#include "vmupro_host.h"
+#include "bench.h"
+
+#define MAX_CASES 96
+
+uint16_t sprite[SPRITE_SIZE * SPRITE_SIZE];
+uint16_t background[BG_SIZE * BG_SIZE];
+uint16_t tile[TILE_SIZE * TILE_SIZE];
+static uint8_t mask[SPRITE_SIZE * SPRITE_SIZE];
+static uint8_t indexed[240 * 240];
+static int16_t palette[256];
+static uint32_t spriteRle[SPRITE_SIZE * SPRITE_SIZE];
+uint16_t indexedPalette[256];
+uint8_t sprite8[VMUPRO_INDEXED_HEADER_SIZE + SPRITE_SIZE * SPRITE_SIZE];
+uint8_t sprite4[VMUPRO_INDEXED_HEADER_SIZE + SPRITE_SIZE * SPRITE_SIZE / 2];
+uint8_t layer8[VMUPRO_INDEXED_HEADER_SIZE + BG_SIZE * BG_SIZE];
+
+// 8x4 atlas of 16x16 tiles: opaque, holed, empty and half-empty tiles
+static uint16_t tileAtlas[ATLAS_W * ATLAS_H];
+static uint16_t tileMap16[MAP_W * MAP_H];
+uint8_t tileMap8[MAP_W * MAP_H];
+uint8_t tileAttributes[MAP_W * MAP_H];
+uint8_t tileRowClasses[32 * 16];
+vmupro_tilemap_t tilemap;
+uint8_t tileAtlas8[VMUPRO_INDEXED_HEADER_SIZE + ATLAS_W * ATLAS_H];
+uint8_t tileAtlas4[VMUPRO_INDEXED_HEADER_SIZE + ATLAS_W * ATLAS_H / 2];
+
+static vmupro_raster_line_t rasterLines[240];
+vmupro_raster_palette_t rasterPalettes[2];
+static uint64_t dlArena[8192];
+vmupro_display_list_t displayList;
+static int lineOffsets[240];
+static int iter;
+
+typedef struct
+{
+  const char *name;
+  int pixels; // destination pixels touched (or audio frames produced) per call
+  void (*run)(void);
+} BenchCase;
+
+typedef struct
+{
+  const char *name;
+  double nsPerCall;
+  double nsPerPixel;
+} BenchResult;
+
+static uint64_t NowNs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Indexed image whose pixels are index(x, y), transparent where the
+// RGB565 sprite has its colour key
+void MakeIndexed(uint8_t *out, int width, int height, int bpp, int (*index)(int x, int y))
+{
+  vmupro_indexed_header_t header = {VMUPRO_INDEXED_MAGIC, (uint16_t)width, (uint16_t)height, (uint8_t)bpp, 0};
+  memcpy(out, &header, sizeof(header));
+  int stride = VMUPRO_INDEXED_STRIDE(width, bpp);
+  uint8_t *pixels = out + VMUPRO_INDEXED_HEADER_SIZE;
+  memset(pixels, 0, stride * height);
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      int i = index(x, y);
+      if (bpp == 8)
+        pixels[y * stride + x] = (uint8_t)i;
+      else
+        pixels[y * stride + x / 2] |= (uint8_t)(i << ((x & 1) ? 0 : 4));
+    }
+  }
+}
+
+// RGB565 copy of an indexed image, with the transparent index as the key
+void ExpandIndexed(const uint8_t *image, uint16_t *out, int transparentIndex, uint16_t key)
+{
+  int width, height, bpp;
+  vmupro_indexed_get_info(image, &width, &height, &bpp);
+  int stride = VMUPRO_INDEXED_STRIDE(width, bpp);
+  const uint8_t *pixels = image + VMUPRO_INDEXED_HEADER_SIZE;
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      int i = bpp == 8 ? pixels[y * stride + x] : (pixels[y * stride + x / 2] >> ((x & 1) ? 0 : 4)) & 0x0f;
+      out[y * width + x] = i == transparentIndex ? key : indexedPalette[i];
+    }
+  }
+}
+
+static int Index8(int x, int y) { return sprite[y * SPRITE_SIZE + x] == VMUPRO_COLOR_MAGENTA ? 0 : 1 + (x * 3 + y) % 255; }
+int Index4(int x, int y) { return sprite[y * SPRITE_SIZE + x] == VMUPRO_COLOR_MAGENTA ? 0 : 1 + (x + y) % 15; }
+static int IndexLayer(int x, int y) { return (x * 7 + y * 13) & 0xff; }
+static int IndexAtlas8(int x, int y) { return tileAtlas[y * ATLAS_W + x] == VMUPRO_COLOR_MAGENTA ? 0 : 1 + (x * 3 + y * 5) % 255; }
+static int IndexAtlas4(int x, int y) { return tileAtlas[y * ATLAS_W + x] == VMUPRO_COLOR_MAGENTA ? 0 : 1 + (x + y * 3) % 15; }
+
+static void InitAssets(void)
+{
+  // opaque checker with a transparent (magenta) border ring, roughly
+  // the coverage of a typical character sprite
+  for (int y = 0; y < SPRITE_SIZE; y++)
+  {
+    for (int x = 0; x < SPRITE_SIZE; x++)
+    {
+      int dx = x - SPRITE_SIZE / 2;
+      int dy = y - SPRITE_SIZE / 2;
+      bool inside = dx * dx + dy * dy < (SPRITE_SIZE / 2 - 2) * (SPRITE_SIZE / 2 - 2);
+      sprite[y * SPRITE_SIZE + x] = inside ? (((x ^ y) & 8) ? VMUPRO_COLOR_WHITE : VMUPRO_COLOR_VMUGREEN) : VMUPRO_COLOR_MAGENTA;
+      mask[y * SPRITE_SIZE + x] = inside;
+    }
+  }
+  for (int i = 0; i < BG_SIZE * BG_SIZE; i++)
+    background[i] = (uint16_t)(i * 2654435761u >> 16);
+  for (int i = 0; i < TILE_SIZE * TILE_SIZE; i++)
+    tile[i] = (uint16_t)(i * 40503u);
+  for (int i = 0; i < 240 * 240; i++)
+    indexed[i] = (uint8_t)i;
+  for (int i = 0; i < 256; i++)
+    palette[i] = (int16_t)(i * 257);
+  for (int i = 0; i < 240; i++)
+    lineOffsets[i] = (i * 7) % 23 - 11;
+  vmupro_rle_encode((uint8_t *)sprite, SPRITE_SIZE, SPRITE_SIZE, VMUPRO_COLOR_MAGENTA, (uint8_t *)spriteRle, sizeof(spriteRle));
+  for (int i = 0; i < 256; i++)
+  {
+    indexedPalette[i] = (uint16_t)(i * 2654435761u >> 16);
+    if (indexedPalette[i] == VMUPRO_COLOR_MAGENTA)
+      indexedPalette[i] ^= 1;
+  }
+  MakeIndexed(sprite8, SPRITE_SIZE, SPRITE_SIZE, 8, Index8);
+  MakeIndexed(sprite4, SPRITE_SIZE, SPRITE_SIZE, 4, Index4);
+  MakeIndexed(layer8, BG_SIZE, BG_SIZE, 8, IndexLayer);
+
+  for (int y = 0; y < ATLAS_H; y++)
+  {
+    for (int x = 0; x < ATLAS_W; x++)
+    {
+      int t = (y / 16) * 8 + x / 16;
+      int tx = x % 16 - 8;
+      int ty = y % 16;
+      bool hole = (t % 4 == 1 && tx * tx + (ty - 8) * (ty - 8) < 20) || t % 4 == 2 || (t % 4 == 3 && ty < 8);
+      uint16_t c = (uint16_t)(0x0841 * (t + 1) + x * 3 + y * 5);
+      // keep the key (and 0xffff, the opaque reference key) out of solid pixels
+      if (c == VMUPRO_COLOR_MAGENTA || c == 0xffff)
+        c ^= 1;
+      tileAtlas[y * ATLAS_W + x] = hole ? VMUPRO_COLOR_MAGENTA : c;
+    }
+  }
+  for (int i = 0; i < MAP_W * MAP_H; i++)
+  {
+    int x = i % MAP_W;
+    int y = i / MAP_W;
+    int t = (x * 7 + y * 3) % 32;
+    int flip = (x + y * 3) & 3;
+    tileMap16[i] = (uint16_t)(t | (flip & 1 ? VMUPRO_TILE_FLIP_H : 0) | (flip & 2 ? VMUPRO_TILE_FLIP_V : 0));
+    tileMap8[i] = (uint8_t)t;
+    tileAttributes[i] = (uint8_t)flip;
+  }
+  tilemap = (vmupro_tilemap_t){(uint8_t *)tileAtlas, ATLAS_W, 16, 16, tileMap16, MAP_W, MAP_H, 2, NULL, 5,
+                               VMUPRO_COLOR_MAGENTA, NULL, false, NULL};
+  vmupro_tilemap_classify_rows(&tilemap, tileRowClasses, sizeof(tileRowClasses));
+  MakeIndexed(tileAtlas8, ATLAS_W, ATLAS_H, 8, IndexAtlas8);
+  MakeIndexed(tileAtlas4, ATLAS_W, ATLAS_H, 4, IndexAtlas4);
+
+  // water wobble and a blue tint below line 160, a darker band on top
+  for (int i = 0; i < 240; i++)
+    rasterLines[i] = (vmupro_raster_line_t){(int16_t)(i >= 160 ? lineOffsets[i] : 0), 0,
+                                            (uint8_t)(i >= 160 ? 1 : (i < 24 ? 2 : 0)), VMUPRO_RASTER_ALL_LAYERS};
+  vmupro_raster_palette_fade(&rasterPalettes[0], VMUPRO_COLOR_BLUE, 96);
+  vmupro_raster_palette_fade(&rasterPalettes[1], VMUPRO_COLOR_BLACK, 128);
+
+  vmupro_display_list_init(&displayList, dlArena, sizeof(dlArena));
+}
+
+// Positions drift by a few pixels so alignment varies between calls
+#define PX (88 + (iter & 7))
+#define PY (88 + ((iter >> 3) & 7))
+
+static void RunClear(void) { vmupro_display_clear(VMUPRO_COLOR_NAVY); }
+static void RunFillRect(void) { vmupro_draw_fill_rect(PX, PY, PX + 63, PY + 63, VMUPRO_COLOR_RED); }
+static void RunBlitAt(void) { vmupro_blit_buffer_at((uint8_t *)sprite, PX, PY, SPRITE_SIZE, SPRITE_SIZE); }
+static void RunBlitClipped(void) { vmupro_blit_buffer_at((uint8_t *)sprite, -32 + (iter & 7), 208, SPRITE_SIZE, SPRITE_SIZE); }
+static void RunTransparent(void) { vmupro_blit_buffer_transparent((uint8_t *)sprite, PX, PY, SPRITE_SIZE, SPRITE_SIZE, VMUPRO_COLOR_MAGENTA, VMUPRO_DRAWFLAGS_NORMAL); }
+static void RunTransparentFlip(void) { vmupro_blit_buffer_transparent((uint8_t *)sprite, PX, PY, SPRITE_SIZE, SPRITE_SIZE, VMUPRO_COLOR_MAGENTA, VMUPRO_DRAWFLAGS_FLIP_H | VMUPRO_DRAWFLAGS_FLIP_V); }
+static void RunBlended(void) { vmupro_blit_buffer_blended((uint8_t *)sprite, PX, PY, SPRITE_SIZE, SPRITE_SIZE, 128); }
+static void RunFixedAlpha(void) { vmupro_blit_buffer_fixed_alpha((uint8_t *)sprite, PX, PY, SPRITE_SIZE, SPRITE_SIZE, 1); }
+static void RunDithered(void) { vmupro_blit_buffer_dithered((uint8_t *)sprite, PX, PY, SPRITE_SIZE, SPRITE_SIZE, 4); }
+static void RunFlipped(void) { vmupro_blit_buffer_flipped((uint8_t *)sprite, PX, PY, SPRITE_SIZE, SPRITE_SIZE, VMUPRO_DRAWFLAGS_FLIP_H); }
+static void RunScaled1x(void) { vmupro_blit_buffer_scaled((uint8_t *)sprite, SPRITE_SIZE, 0, 0, SPRITE_SIZE, SPRITE_SIZE, PX, PY, SPRITE_SIZE, SPRITE_SIZE); }
+static void RunScaled2x(void) { vmupro_blit_buffer_scaled((uint8_t *)sprite, SPRITE_SIZE, 0, 0, SPRITE_SIZE, SPRITE_SIZE, PX - 32, PY - 32, SPRITE_SIZE * 2, SPRITE_SIZE * 2); }
+static void RunAdvanced(void) { vmupro_blit_buffer_advanced((uint8_t *)sprite, SPRITE_SIZE, 0, 0, SPRITE_SIZE, SPRITE_SIZE, PX - 32, PY - 32, SPRITE_SIZE * 2, SPRITE_SIZE * 2, 1, 0, VMUPRO_COLOR_MAGENTA); }
+static void RunRot90(void) { vmupro_blit_buffer_rotated_90((uint8_t *)sprite, PX, PY, SPRITE_SIZE, SPRITE_SIZE, 1); }
+static void RunAffine(vmupro_sample_mode_t sample, int key, uint8_t alpha)
+{
+  vmupro_affine_t m;
+  int32_t zoom = 0x18000 + (iter & 7) * 0x1000;
+  vmupro_affine_rotate_scale(&m, (30 + (iter & 7)) << 16, zoom, zoom, 32 << 16, 32 << 16, 120 << 16, 120 << 16);
+  vmupro_blit_buffer_affine((uint8_t *)sprite, SPRITE_SIZE, 0, 0, SPRITE_SIZE, SPRITE_SIZE, &m, sample, key, alpha);
+}
+static void RunAffineNearest(void) { RunAffine(VMUPRO_SAMPLE_NEAREST, -1, 255); }
+static void RunAffineNearestKeyed(void) { RunAffine(VMUPRO_SAMPLE_NEAREST, VMUPRO_COLOR_MAGENTA, 255); }
+static void RunAffineBilinear(void) { RunAffine(VMUPRO_SAMPLE_BILINEAR, -1, 255); }
+static void RunAffineBilinearKeyedAlpha(void) { RunAffine(VMUPRO_SAMPLE_BILINEAR, VMUPRO_COLOR_MAGENTA, 160); }
+static void RunRotPrecise(void) { vmupro_blit_buffer_rotated_precise((uint8_t *)sprite, 120, 120, SPRITE_SIZE, SPRITE_SIZE, 30 + (iter & 7)); }
+static void RunRle(void) { vmupro_blit_rle((uint8_t *)spriteRle, PX, PY, VMUPRO_DRAWFLAGS_NORMAL); }
+static void RunRleFlip(void) { vmupro_blit_rle((uint8_t *)spriteRle, PX, PY, VMUPRO_DRAWFLAGS_FLIP_H | VMUPRO_DRAWFLAGS_FLIP_V); }
+static void RunIndexed8(void) { vmupro_blit_indexed(sprite8, indexedPalette, PX, PY, 0, VMUPRO_DRAWFLAGS_NORMAL); }
+static void RunIndexed4(void) { vmupro_blit_indexed(sprite4, indexedPalette, PX, PY, 0, VMUPRO_DRAWFLAGS_NORMAL); }
+static void RunIndexed4Flip(void) { vmupro_blit_indexed(sprite4, indexedPalette, PX, PY, 0, VMUPRO_DRAWFLAGS_FLIP_H | VMUPRO_DRAWFLAGS_FLIP_V); }
+static void RunIndexedLayer(void) { vmupro_render_indexed_layer(layer8, indexedPalette, iter, iter, VMUPRO_INDEXED_OPAQUE); }
+// The per-tile loop games use today, as in gfx_samples DrawGround()
+static void RunTilesPerBlit(void)
+{
+  int sx = iter & 15;
+  for (int r = 0; r < 16; r++)
+  {
+    for (int c = 0; c < 16; c++)
+    {
+      int t = tileMap16[r * MAP_W + c] & VMUPRO_TILE_INDEX_MASK;
+      vmupro_blit_tile_advanced((uint8_t *)tileAtlas, c * 16 - sx, r * 16, (t % 8) * 16, (t / 8) * 16, 16, 16, ATLAS_W,
+                                VMUPRO_COLOR_MAGENTA, VMUPRO_DRAWFLAGS_NORMAL);
+    }
+  }
+}
+
+static void RunTilemapKeyed(void)
+{
+  tilemap.row_classes = NULL;
+  vmupro_tilemap_render(&tilemap, iter & 15, 0, 0, 0, 240, 240);
+}
+
+static void RunTilemapClassified(void)
+{
+  tilemap.row_classes = tileRowClasses;
+  vmupro_tilemap_render(&tilemap, iter & 15, 0, 0, 0, 240, 240);
+}
+
+static void RunTilemapOpaque(void)
+{
+  vmupro_tilemap_t opaque = tilemap;
+  opaque.transparent_color = -1;
+  opaque.empty_tile = -1;
+  vmupro_tilemap_render(&opaque, iter & 15, 0, 0, 0, 240, 240);
+}
+
+static void RunTilemapIndexed4(void)
+{
+  vmupro_tilemap_t indexed4 = tilemap;
+  indexed4.atlas = tileAtlas4;
+  indexed4.palette = indexedPalette;
+  indexed4.transparent_color = 0;
+  vmupro_tilemap_render(&indexed4, iter & 15, 0, 0, 0, 240, 240);
+}
+
+// A buffer layer under a keyed tilemap layer, created on first use
+static void SetupLayers(void)
+{
+  static vmupro_tilemap_t map;
+  if (map.atlas != NULL)
+    return;
+  map = tilemap;
+  map.row_classes = tileRowClasses;
+  map.wrap = true;
+  vmupro_layer_create(0, BG_SIZE, BG_SIZE);
+  vmupro_layer_blit_background(0, (uint8_t *)background, BG_SIZE, BG_SIZE);
+  vmupro_layer_set_tilemap(1, &map);
+}
+
+static void RunAllLayers(void)
+{
+  SetupLayers();
+  vmupro_layer_set_scroll(0, iter, 0);
+  vmupro_render_all_layers();
+}
+
+static void RunAllLayersSplit(void)
+{
+  vmupro_set_split_rendering(true);
+  RunAllLayers();
+}
+
+uint16_t blendLayer[240 * 240];
+static void RunBlendAdditive(void) { vmupro_blend_layers_additive((uint8_t *)blendLayer, (uint8_t *)background, 240, 240); }
+
+static void RunBlendAdditiveSplit(void)
+{
+  vmupro_set_split_rendering(true);
+  RunBlendAdditive();
+}
+
+static void RunRasterTable(void)
+{
+  SetupLayers();
+  vmupro_layer_set_scroll(0, iter, 0);
+  vmupro_render_layers_raster(rasterLines, NULL, NULL, rasterPalettes, 2);
+}
+
+void RasterFromTable(int line, vmupro_raster_line_t *params, void *user_data)
+{
+  *params = ((const vmupro_raster_line_t *)user_data)[line];
+}
+
+static void RunRasterCallback(void)
+{
+  SetupLayers();
+  vmupro_layer_set_scroll(0, iter, 0);
+  vmupro_render_layers_raster(NULL, RasterFromTable, rasterLines, rasterPalettes, 2);
+}
+
+static void RunMasked(void) { vmupro_blit_buffer_masked((uint8_t *)sprite, mask, PX, PY, SPRITE_SIZE, SPRITE_SIZE, VMUPRO_DRAWFLAGS_NORMAL); }
+static void RunColorMultiply(void) { vmupro_blit_buffer_color_multiply((uint8_t *)sprite, PX, PY, SPRITE_SIZE, SPRITE_SIZE, VMUPRO_COLOR_RED); }
+static void RunColorAdd(void) { vmupro_blit_buffer_color_add((uint8_t *)sprite, PX, PY, SPRITE_SIZE, SPRITE_SIZE, VMUPRO_COLOR_NAVY); }
+static void RunMosaic(void) { vmupro_blit_buffer_mosaic((uint8_t *)sprite, PX, PY, SPRITE_SIZE, SPRITE_SIZE, 4); }
+static void RunBlurred(void) { vmupro_blit_buffer_blurred((uint8_t *)sprite, PX, PY, SPRITE_SIZE, SPRITE_SIZE, 2); }
+static void RunTile(void) { vmupro_blit_tile((uint8_t *)background, PX, PY, 32, 32, 32, 32, BG_SIZE); }
+static void RunTileAdvanced(void) { vmupro_blit_tile_advanced((uint8_t *)sprite, PX, PY, 16, 16, 32, 32, SPRITE_SIZE, VMUPRO_COLOR_MAGENTA, VMUPRO_DRAWFLAGS_FLIP_H); }
+static void RunTilePattern(void) { vmupro_blit_tile_pattern((uint8_t *)tile, TILE_SIZE, TILE_SIZE, -(iter % TILE_SIZE), -(iter % TILE_SIZE), 240 + TILE_SIZE, 240 + TILE_SIZE); }
+static void RunScrollingBg(void) { vmupro_blit_scrolling_background((uint8_t *)background, BG_SIZE, BG_SIZE, iter, iter, 240, 240); }
+static void RunInfiniteBg(void) { vmupro_blit_infinite_scrolling_background((uint8_t *)tile, TILE_SIZE, TILE_SIZE, iter, iter, 240, 240); }
+static void RunInfiniteBg16(void) { vmupro_blit_infinite_scrolling_background((uint8_t *)tile, 16, 16, -iter, iter, 240, 240); }
+static void RunLineScroll(void) { vmupro_blit_line_scroll_background((uint8_t *)background, BG_SIZE, BG_SIZE, lineOffsets, NULL); }
+static void RunWithPalette(void) { vmupro_blit_buffer_with_palette(indexed, palette); }
+static void RunMosaicScreen(void) { vmupro_apply_mosaic_to_screen(0, 0, 240, 240, 8); }
+
+static void RunScrollingBgSplit(void)
+{
+  vmupro_set_split_rendering(true);
+  RunScrollingBg();
+}
+
+static void RunMosaicScreenSplit(void)
+{
+  vmupro_set_split_rendering(true);
+  RunMosaicScreen();
+}
+static void RunPolygonFilled(void)
+{
+  int pts[] = {120, 20, 220, 200, 20, 200};
+  vmupro_draw_polygon_filled(pts, 3, VMUPRO_COLOR_ORANGE);
+}
+
+static void RunSpriteBatch(void)
+{
+  vmupro_sprite_t batch[16];
+  for (int i = 0; i < 16; i++)
+  {
+    batch[i] = (vmupro_sprite_t){(uint8_t *)sprite, (i * 37 + iter) % 200, (i * 53) % 200, SPRITE_SIZE, SPRITE_SIZE,
+                                 i & 1, 0, 255, VMUPRO_COLOR_MAGENTA, i % 3};
+  }
+  vmupro_sprite_batch_render(batch, 16);
+}
+
+// 128 overlapping sprites, an eighth of them moving each frame
+vmupro_sprite_t crowd[CROWD_SIZE];
+
+void CrowdFrame(int frame)
+{
+  for (int i = 0; i < CROWD_SIZE; i++)
+  {
+    int moving = (i & 7) == (frame & 7);
+    int x = (i * 37 + (moving ? frame : 0)) % 240 - 32;
+    int y = (i * 53) % 240 - 32;
+    int alpha = i % 5 == 0 ? 128 : 255;
+    crowd[i] = (vmupro_sprite_t){(uint8_t *)sprite, x, y, SPRITE_SIZE, SPRITE_SIZE,
+                                 i & 1, (i >> 1) & 1, (uint8_t)alpha, VMUPRO_COLOR_MAGENTA, i % 4};
+  }
+}
+
+static void RunCrowd(vmupro_sprite_batch_mode_t mode)
+{
+  vmupro_set_sprite_batch_mode(mode);
+  CrowdFrame(iter);
+  vmupro_sprite_batch_render(crowd, CROWD_SIZE);
+}
+
+static void RunCrowdDirect(void) { RunCrowd(VMUPRO_SPRITE_BATCH_DIRECT); }
+static void RunCrowdTiled16(void) { RunCrowd(VMUPRO_SPRITE_BATCH_TILED_16); }
+static void RunCrowdTiled32(void) { RunCrowd(VMUPRO_SPRITE_BATCH_TILED_32); }
+
+// A game frame in three parts: background, playfield, HUD
+
+void SceneBackground(int f)
+{
+  vmupro_display_clear(VMUPRO_COLOR_NAVY);
+  vmupro_blit_scrolling_background((uint8_t *)background, BG_SIZE, BG_SIZE, f * 3, f, 240, 240);
+}
+
+void ScenePlayfield(int f)
+{
+  for (int i = 0; i < 12; i++)
+    vmupro_blit_buffer_transparent((uint8_t *)sprite, (i * 41 + f * 5) % 260 - 40, (i * 67) % 260 - 40,
+                                   SPRITE_SIZE, SPRITE_SIZE, VMUPRO_COLOR_MAGENTA, (vmupro_drawflags_t)(i & 3));
+
+  vmupro_affine_t m;
+  vmupro_affine_rotate_scale(&m, (f * 10) << 16, 0x14000, 0x14000, 32 << 16, 32 << 16, 120 << 16, 100 << 16);
+  vmupro_blit_buffer_affine((uint8_t *)sprite, SPRITE_SIZE, 0, 0, SPRITE_SIZE, SPRITE_SIZE, &m,
+                            VMUPRO_SAMPLE_BILINEAR, VMUPRO_COLOR_MAGENTA, 255);
+  // the matrix and points are copied when recorded
+  memset(&m, 0, sizeof(m));
+
+  int pts[] = {20 + f, 150, 90, 130, 110, 190, 40, 210};
+  vmupro_draw_polygon_filled(pts, 4, VMUPRO_COLOR_ORANGE);
+  vmupro_draw_polygon(pts, 4, VMUPRO_COLOR_WHITE);
+  pts[0] = 0;
+
+  vmupro_set_color_window(30, 30, 150, 150, VMUPRO_COLOR_RED);
+  vmupro_draw_fill_rect(20, 20, 100, 100, VMUPRO_COLOR_GREEN);
+  vmupro_draw_circle_filled(120, 120, 40, VMUPRO_COLOR_RED);
+  vmupro_clear_color_window();
+
+  if (f % 3 == 0)
+  {
+    // the outline must still bound the fill even though it ends up hidden
+    vmupro_draw_rect(160, 150, 220, 190, VMUPRO_COLOR_WHITE);
+    vmupro_flood_fill(170, 160, VMUPRO_COLOR_BLUE, VMUPRO_COLOR_WHITE);
+    vmupro_draw_fill_rect(160, 150, 220, 190, VMUPRO_COLOR_GREY);
+  }
+
+  CrowdFrame(f);
+  vmupro_sprite_batch_render(crowd, 16);
+  vmupro_tilemap_render(&tilemap, f * 7, f * 3, 16, 160, 120, 64);
+  // opaque, anything fully under it is culled
+  vmupro_blit_buffer_at((uint8_t *)sprite, 180, 60, SPRITE_SIZE, SPRITE_SIZE);
+}
+
+void SceneHud(int f)
+{
+  char score[16];
+  snprintf(score, sizeof(score), "SCORE %06d", f * 10);
+  vmupro_draw_fill_rect(0, 0, 239, 15, VMUPRO_COLOR_BLACK);
+  vmupro_draw_line(0, 15, 239, 15, VMUPRO_COLOR_YELLOW);
+  vmupro_set_font(VMUPRO_FONT_TINY_6x8);
+  vmupro_draw_text(score, 4, 4, VMUPRO_COLOR_WHITE, VMUPRO_COLOR_BLACK);
+  vmupro_apply_mosaic_to_screen(160, 40 + (f & 7), 64, 64, 4);
+}
+
+void DrawFrame(int f, bool leaveWindow)
+{
+  SceneBackground(f);
+  ScenePlayfield(f);
+  SceneHud(f);
+  if (leaveWindow)
+    vmupro_set_color_window(0, 180, 239, 239, VMUPRO_COLOR_BLACK);
+}
+
+static void RunFrameImmediate(void) { DrawFrame(iter, false); }
+
+// Recorded in update order (HUD first), replayed back to front
+static void RunFrameDisplayList(void)
+{
+  vmupro_display_list_begin(&displayList);
+  vmupro_display_list_set_layer(2);
+  SceneHud(iter);
+  vmupro_display_list_set_layer(1);
+  ScenePlayfield(iter);
+  vmupro_display_list_set_layer(0);
+  SceneBackground(iter);
+  vmupro_display_list_end();
+  vmupro_display_list_replay(&displayList, VMUPRO_DL_SORT_LAYERS | VMUPRO_DL_CULL_OVERDRAW);
+}
+
+// Score and FPS counter redrawn every frame, as the firmware draws them
+// and from a glyph cache, a pre-laid-out run and a batch
+#define HUD_FONT VMUPRO_FONT_QUANTICO_18x20
+uint8_t glyphArena[65536];
+static vmupro_glyph_cache_t hudGlyphs;
+static vmupro_text_run_t hudLabel;
+
+static void SetupText(void)
+{
+  if (hudGlyphs.glyphs != NULL)
+    return;
+  vmupro_glyph_cache_init(&hudGlyphs, HUD_FONT, ' ', '~', glyphArena, sizeof(glyphArena));
+  vmupro_text_run_set(&hudLabel, &hudGlyphs, "SCORE");
+}
+
+static void HudStrings(char *score, char *fps)
+{
+  snprintf(score, 16, "%06d", iter * 10);
+  snprintf(fps, 16, "%d FPS", 50 + (iter & 15));
+}
+
+static void RunTextFirmware(void)
+{
+  char score[16], fps[16];
+  HudStrings(score, fps);
+  vmupro_set_font(HUD_FONT);
+  vmupro_draw_text("SCORE", 4, 4, VMUPRO_COLOR_WHITE, VMUPRO_COLOR_BLACK);
+  vmupro_draw_text(score, 84, 4, VMUPRO_COLOR_WHITE, VMUPRO_COLOR_BLACK);
+  vmupro_draw_text(fps, 160, 4, VMUPRO_COLOR_YELLOW, VMUPRO_COLOR_BLACK);
+}
+
+static void RunTextCache(void)
+{
+  char score[16], fps[16];
+  SetupText();
+  HudStrings(score, fps);
+  vmupro_text_draw(&hudGlyphs, "SCORE", 4, 4, VMUPRO_COLOR_WHITE);
+  vmupro_text_draw(&hudGlyphs, score, 84, 4, VMUPRO_COLOR_WHITE);
+  vmupro_text_draw(&hudGlyphs, fps, 160, 4, VMUPRO_COLOR_YELLOW);
+}
+
+static void RunTextRunBatch(void)
+{
+  char score[16], fps[16];
+  SetupText();
+  HudStrings(score, fps);
+  vmupro_text_run_draw(&hudLabel, 4, 4, VMUPRO_COLOR_WHITE);
+  const vmupro_text_item_t items[] = {{score, 84, 4, VMUPRO_COLOR_WHITE}, {fps, 160, 4, VMUPRO_COLOR_YELLOW}};
+  vmupro_text_draw_batch(&hudGlyphs, items, 2);
+}
+
+// Custom font built the way font_bmfont.py lays it out: printable ASCII
+// plus a few characters from other scripts, with generated glyphs
+const uint32_t bmfExtra[] = {0xe9, 0x3a9, 0x3042, 0x1f600};
+static const struct
+{
+  uint32_t first, second;
+  int amount;
+} bmfPairs[] = {{'A', 'T', -1}, {'A', 'V', -2}, {'T', 'o', -3}, {'V', 'A', -1}, {0xe9, 0x3a9, 1}};
+uint32_t bmfData[8192];
+static vmupro_bmfont_t bmFont;
+
+int BmfWidth(uint32_t cp) { return cp == ' ' ? 0 : 3 + cp % 7; }
+int BmfHeight(uint32_t cp) { return cp == ' ' ? 0 : 5 + cp % 9; }
+int BmfXOffset(uint32_t cp) { return (int)(cp % 3) - 1; }
+int BmfYOffset(uint32_t cp) { return (int)(cp % 4); }
+int BmfAdvance(uint32_t cp) { return cp == ' ' ? 4 : 4 + cp % 7; }
+int BmfCoverage(uint32_t cp, int x, int y)
+{
+  uint32_t h = (cp * 31 + (uint32_t)x * 7 + (uint32_t)y * 13) % 23;
+  return h < 16 ? (int)h : (h < 19 ? 15 : 0);
+}
+int BmfKerning(uint32_t first, uint32_t second)
+{
+  for (int i = 0; i < (int)(sizeof(bmfPairs) / sizeof(bmfPairs[0])); i++)
+  {
+    if (bmfPairs[i].first == first && bmfPairs[i].second == second)
+      return bmfPairs[i].amount;
+  }
+  return 0;
+}
+
+uint32_t MakeBmFont(void)
+{
+  enum
+  {
+    NUM_EXTRA = sizeof(bmfExtra) / sizeof(bmfExtra[0]),
+    NUM_GLYPHS = 95 + NUM_EXTRA,
+    NUM_PAIRS = sizeof(bmfPairs) / sizeof(bmfPairs[0])
+  };
+  uint32_t codepoints[NUM_GLYPHS];
+  for (int i = 0; i < 95; i++)
+    codepoints[i] = 0x20 + i;
+  for (int i = 0; i < NUM_EXTRA; i++)
+    codepoints[95 + i] = bmfExtra[i];
+
+  uint8_t *data = (uint8_t *)bmfData;
+  memset(bmfData, 0, sizeof(bmfData));
+  vmupro_bmfont_header_t *header = (vmupro_bmfont_header_t *)data;
+  header->magic = VMUPRO_BMFONT_MAGIC;
+  header->version = VMUPRO_BMFONT_VERSION;
+  header->line_height = BMF_LINE_HEIGHT;
+  header->base = 12;
+  header->glyph_count = NUM_GLYPHS;
+  header->kerning_count = NUM_PAIRS;
+  header->fallback = '?' - 0x20;
+  header->glyphs_offset = sizeof(*header);
+  header->kerning_offset = header->glyphs_offset + NUM_GLYPHS * sizeof(vmupro_bmfont_glyph_t);
+  header->bitmap_offset = header->kerning_offset + NUM_PAIRS * sizeof(vmupro_bmfont_kerning_t);
+  for (int i = 0; i < 96; i++)
+    header->ascii[i] = i < 95 ? i : VMUPRO_BMFONT_NO_GLYPH;
+
+  vmupro_bmfont_glyph_t *glyphs = (vmupro_bmfont_glyph_t *)(data + header->glyphs_offset);
+  vmupro_bmfont_kerning_t *kerning = (vmupro_bmfont_kerning_t *)(data + header->kerning_offset);
+  uint8_t *bitmaps = data + header->bitmap_offset;
+  uint32_t bitmapSize = 0;
+  int pair = 0;
+  for (int i = 0; i < NUM_GLYPHS; i++)
+  {
+    uint32_t cp = codepoints[i];
+    vmupro_bmfont_glyph_t *g = &glyphs[i];
+    g->codepoint = cp;
+    g->bitmap = bitmapSize;
+    g->width = BmfWidth(cp);
+    g->height = BmfHeight(cp);
+    g->x_offset = BmfXOffset(cp);
+    g->y_offset = BmfYOffset(cp);
+    g->advance = BmfAdvance(cp);
+    g->kerning_index = pair;
+    // pairs are listed by first, then second glyph
+    for (int k = 0; k < NUM_PAIRS; k++)
+    {
+      if (bmfPairs[k].first != cp)
+        continue;
+      int second = 0;
+      while (codepoints[second] != bmfPairs[k].second)
+        second++;
+      kerning[pair].second = second;
+      kerning[pair].amount = bmfPairs[k].amount;
+      pair++;
+      g->kerning_count++;
+    }
+    int stride = (g->width + 1) / 2;
+    for (int y = 0; y < g->height; y++)
+    {
+      for (int x = 0; x < g->width; x++)
+        bitmaps[bitmapSize + y * stride + x / 2] |= BmfCoverage(cp, x, y) << ((x & 1) ? 0 : 4);
+    }
+    bitmapSize += stride * g->height;
+  }
+  return (header->bitmap_offset + bitmapSize + 3) & ~3u;
+}
+
+static void SetupBmFont(void)
+{
+  if (bmFont.header == NULL)
+    vmupro_bmfont_load(&bmFont, (const uint8_t *)bmfData, MakeBmFont());
+}
+
+static void RunBmFontAscii(void)
+{
+  char score[16], fps[16];
+  SetupBmFont();
+  HudStrings(score, fps);
+  vmupro_bmfont_draw_text(&bmFont, "SCORE", 4, 4, VMUPRO_COLOR_WHITE);
+  vmupro_bmfont_draw_text(&bmFont, score, 84, 4, VMUPRO_COLOR_WHITE);
+  vmupro_bmfont_draw_text(&bmFont, fps, 160, 4, VMUPRO_COLOR_YELLOW);
+}
+
+static void RunBmFontUtf8(void)
+{
+  SetupBmFont();
+  vmupro_bmfont_draw_text(&bmFont, "Caf\xc3\xa9 \xce\xa9 AVATAR \xe3\x81\x82\xf0\x9f\x98\x80", 4, 4 + (iter & 7),
+                          VMUPRO_COLOR_WHITE);
+}
+
+//
+// Audio mixer
+//
+
+
+static int16_t mixMono[MIX_MONO_FRAMES];
+int16_t mixStereo[MIX_STEREO_FRAMES * 2];
+int16_t mixHalf[MIX_HALF_FRAMES];
+static int16_t mixLoud[MIX_LOUD_FRAMES];
+vmupro_sound_sample_t sndMono, sndStereo, sndHalf, sndLoud;
+static int16_t mixBlock[VMUPRO_MIXER_BLOCK_FRAMES * 2];
+
+void SetupMixerSamples(void)
+{
+  uint32_t seed = 0x1234567;
+  for (int i = 0; i < MIX_MONO_FRAMES; i++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    mixMono[i] = (int16_t)((int)(seed >> 16) % 40000 - 20000);
+  }
+  mixMono[0] = 12345;
+  for (int i = 0; i < MIX_STEREO_FRAMES * 2; i++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    mixStereo[i] = (int16_t)((int)(seed >> 16) % 30000 - 15000);
+  }
+  for (int i = 0; i < MIX_HALF_FRAMES; i++)
+    mixHalf[i] = (int16_t)((i * 389) % 24000 - 12000);
+  for (int i = 0; i < MIX_LOUD_FRAMES; i++)
+    mixLoud[i] = (i & 1) ? 30000 : -30000;
+
+  vmupro_sound_sample_init(&sndMono, mixMono, MIX_MONO_FRAMES, 1, 44100);
+  vmupro_sound_sample_init(&sndStereo, mixStereo, MIX_STEREO_FRAMES, 2, 44100);
+  vmupro_sound_sample_init(&sndHalf, mixHalf, MIX_HALF_FRAMES, 1, 22050);
+  vmupro_sound_sample_init(&sndLoud, mixLoud, MIX_LOUD_FRAMES, 1, 44100);
+}
+
+// 8 voices: plain, stereo and resampled, looping for the whole run
+static void RunMixer8(void)
+{
+  if (!vmupro_mixer_is_running())
+  {
+    SetupMixerSamples();
+    vmupro_mixer_start_manual(8);
+    vmupro_sound_sample_t *samples[] = {&sndMono, &sndStereo, &sndHalf, &sndMono};
+    for (int i = 0; i < 8; i++)
+    {
+      int voice = vmupro_sound_sample_play(samples[i & 3], 1 << 20, NULL, NULL);
+      vmupro_mixer_voice_set_pan(voice, VMUPRO_MIXER_UNITY / 4, i * 32 - 128);
+      if (i >= 6)
+        vmupro_mixer_voice_set_rate(voice, VMUPRO_MIXER_RATE_ONE * 3 / 2);
+    }
+  }
+  vmupro_mixer_render(mixBlock, VMUPRO_MIXER_BLOCK_FRAMES);
+}
+
+//
+// Sample rate conversion
+//
+
+static vmupro_resampler_t benchResamplers[3];
+static int resampleInPos;
+
+// 32kHz stereo to 44.1kHz, one mixer block of output per call
+static void RunResample(vmupro_resample_quality_t quality)
+{
+  vmupro_resampler_t *r = &benchResamplers[quality];
+  if (r->in_rate == 0)
+  {
+    SetupMixerSamples();
+    vmupro_resampler_init(r, 32000, 44100, 2, quality);
+  }
+  if (resampleInPos + VMUPRO_MIXER_BLOCK_FRAMES > MIX_STEREO_FRAMES)
+    resampleInPos = 0;
+  int used = 0;
+  vmupro_resampler_process(r, mixStereo + resampleInPos * 2, VMUPRO_MIXER_BLOCK_FRAMES, &used, mixBlock,
+                           VMUPRO_MIXER_BLOCK_FRAMES);
+  resampleInPos += used;
+}
+
+static void RunResampleLinear(void) { RunResample(VMUPRO_RESAMPLE_LINEAR); }
+static void RunResampleSinc8(void) { RunResample(VMUPRO_RESAMPLE_SINC_8); }
+static void RunResampleSinc16(void) { RunResample(VMUPRO_RESAMPLE_SINC_16); }
+
+//
+// Synthesizer
+//
+
+vmupro_synth_t *benchSynths[VMUPRO_SYNTH_MAX];
+
+// All synths holding notes an octave and a half apart, one pull mode period per call
+static void RunSynth(bool mixed)
+{
+  if (!vmupro_synth_engine_is_running())
+  {
+    vmupro_synth_engine_start_manual();
+    for (int i = 0; i < VMUPRO_SYNTH_MAX; i++)
+    {
+      if (benchSynths[i] == NULL)
+        benchSynths[i] = vmupro_synth_new(VMUPRO_SYNTH_SAWTOOTH);
+      vmupro_synth_set_waveform(benchSynths[i], mixed ? (vmupro_synth_waveform_t)(i % 8) : VMUPRO_SYNTH_SAWTOOTH);
+      vmupro_synth_set_volume(benchSynths[i], VMUPRO_SYNTH_UNITY / 32, VMUPRO_SYNTH_UNITY / 32);
+      vmupro_synth_play_midi_note(benchSynths[i], 36 + i * 2, VMUPRO_SYNTH_UNITY, -1);
+    }
+  }
+  vmupro_synth_engine_render(mixBlock, VMUPRO_SYNTH_PERIOD_FRAMES);
+}
+
+static void RunSynthSaw(void) { RunSynth(false); }
+static void RunSynthMixed(void) { RunSynth(true); }
+
+//
+// Sequencer
+//
+
+static void PutBE(uint8_t *p, uint32_t v, int bytes)
+{
+  for (int i = bytes - 1; i >= 0; i--, v >>= 8)
+    p[i] = (uint8_t)v;
+}
+
+static int PutVarLen(uint8_t *p, uint32_t v)
+{
+  int n = 1;
+  while (n < 4 && v >> (7 * n))
+    n++;
+  for (int i = 0; i < n; i++)
+    p[i] = (uint8_t)((v >> (7 * (n - 1 - i))) & 0x7f) | (i < n - 1 ? 0x80 : 0);
+  return n;
+}
+
+// Writes an MThd chunk for a format 1 file
+uint32_t WriteSmfHeader(uint8_t *out, int tracks, int division)
+{
+  memcpy(out, "MThd", 4);
+  PutBE(out + 4, 6, 4);
+  PutBE(out + 8, 1, 2);
+  PutBE(out + 10, (uint32_t)tracks, 2);
+  PutBE(out + 12, (uint32_t)division, 2);
+  return 14;
+}
+
+// Writes an MTrk chunk, leaving out repeated channel statuses, with the
+// end of track at endTick
+uint32_t WriteSmfTrack(uint8_t *out, const SmfEvent *events, int count, uint32_t endTick)
+{
+  static const SmfEvent endOfTrack = {0, 3, {0xff, 0x2f, 0x00}};
+  uint32_t at = 8, tick = 0;
+  uint8_t running = 0;
+  for (int i = 0; i <= count; i++)
+  {
+    const SmfEvent *e = i < count ? &events[i] : &endOfTrack;
+    uint32_t when = i < count ? e->tick : endTick;
+    at += (uint32_t)PutVarLen(out + at, when - tick);
+    tick = when;
+    int skip = e->bytes[0] == running ? 1 : 0;
+    running = e->bytes[0] < 0xf0 ? e->bytes[0] : 0;
+    memcpy(out + at, e->bytes + skip, (size_t)(e->size - skip));
+    at += (uint32_t)(e->size - skip);
+  }
+  memcpy(out, "MTrk", 4);
+  PutBE(out + 4, at - 8, 4);
+  return at;
+}
+
+// 8 tracks of 4 note chords changing every 64th note at 240bpm, some 24
+// events a pull mode period
+#define DENSE_TRACKS 8
+#define DENSE_STEPS 64
+static SmfEvent denseEvents[DENSE_STEPS * 8];
+static uint8_t denseFile[DENSE_TRACKS * (DENSE_STEPS * 8 * 4 + 16) + 64];
+static vmupro_sequence_t *benchSequence;
+
+static vmupro_sequence_t *MakeDenseSequence(void)
+{
+  static const SmfEvent tempo = {0, 6, {0xff, 0x51, 0x03, 0x03, 0xd0, 0x90}};
+  uint32_t size = WriteSmfHeader(denseFile, DENSE_TRACKS + 1, 96);
+  size += WriteSmfTrack(denseFile + size, &tempo, 1, 0);
+  for (int t = 0; t < DENSE_TRACKS; t++)
+  {
+    int n = 0;
+    for (int step = 0; step < DENSE_STEPS; step++)
+    {
+      for (int off = 0; off < 2; off++)
+      {
+        for (int v = 0; v < 4; v++)
+        {
+          uint8_t note = (uint8_t)(36 + t * 6 + v * 4 + step % 5);
+          denseEvents[n++] = (SmfEvent){(uint32_t)(step * 6 + off * 5), 3, {(uint8_t)(0x90 | t), note, off ? 0 : 100}};
+        }
+      }
+    }
+    size += WriteSmfTrack(denseFile + size, denseEvents, n, DENSE_STEPS * 6);
+  }
+  return vmupro_sequence_new_from_memory(denseFile, size);
+}
+
+// All synths playing a dense sequence, one pull mode period per call. The
+// renders are split at every event
+static void RunSequenceDense(void)
+{
+  if (!vmupro_synth_engine_is_running())
+  {
+    vmupro_synth_engine_start_manual();
+    if (benchSequence == NULL)
+      benchSequence = MakeDenseSequence();
+    for (int i = 0; i < VMUPRO_SYNTH_MAX; i++)
+    {
+      if (benchSynths[i] == NULL)
+        benchSynths[i] = vmupro_synth_new(VMUPRO_SYNTH_SAWTOOTH);
+      vmupro_synth_set_waveform(benchSynths[i], (vmupro_synth_waveform_t)(i % 8));
+      vmupro_synth_set_volume(benchSynths[i], VMUPRO_SYNTH_UNITY / 32, VMUPRO_SYNTH_UNITY / 32);
+      vmupro_synth_set_release(benchSynths[i], 5);
+    }
+    for (int t = 0; t < DENSE_TRACKS; t++)
+      vmupro_sequence_set_track_synths(benchSequence, t + 1, benchSynths + t * 4, 4);
+    vmupro_sequence_set_looping(benchSequence, true);
+    vmupro_sequence_play(benchSequence);
+  }
+  vmupro_synth_engine_render(mixBlock, VMUPRO_SYNTH_PERIOD_FRAMES);
+}
+
+//
+// Instruments
+//
+
+#define INST_WAV_DATA 152
+int16_t instMono[INST_FRAMES];
+static uint8_t instFile[INST_WAV_DATA + INST_FRAMES * 4];
+static vmupro_instrument_t *benchInstrument;
+static vmupro_instrument_t *benchStreamed;
+
+static void PutLE(uint8_t *p, uint32_t v, int bytes)
+{
+  for (int i = 0; i < bytes; i++, v >>= 8)
+    p[i] = (uint8_t)v;
+}
+
+// A tone with noise on top, so interpolation has something to get wrong
+void InstrumentTone(int16_t *out, int samples, uint32_t seed)
+{
+  uint32_t lcg = seed;
+  for (int i = 0; i < samples; i++)
+  {
+    lcg = lcg * 1103515245u + 12345u;
+    out[i] = (int16_t)(lrint(12000.0 * sin(i * 0.05 + seed)) + (int)((lcg >> 16) & 0x1fff) - 4096);
+  }
+}
+
+// Writes 16-bit PCM as a WAV file with a LIST chunk ahead of the data, so
+// the samples start INST_WAV_DATA bytes in, off a read boundary
+bool WriteInstrumentWav(const char *path, const int16_t *pcm, uint32_t frames, int channels, uint32_t rate)
+{
+  uint32_t bytes = frames * (uint32_t)channels * 2;
+  memcpy(instFile, "RIFF\0\0\0\0WAVEfmt ", 16);
+  PutLE(instFile + 4, INST_WAV_DATA - 8 + bytes, 4);
+  PutLE(instFile + 16, 16, 4);
+  PutLE(instFile + 20, 1, 2);
+  PutLE(instFile + 22, (uint32_t)channels, 2);
+  PutLE(instFile + 24, rate, 4);
+  PutLE(instFile + 28, rate * (uint32_t)channels * 2, 4);
+  PutLE(instFile + 32, (uint32_t)channels * 2, 2);
+  PutLE(instFile + 34, 16, 2);
+  memcpy(instFile + 36, "LIST", 4);
+  PutLE(instFile + 40, 100, 4);
+  memset(instFile + 44, 'x', 100);
+  memcpy(instFile + 144, "data", 4);
+  PutLE(instFile + 148, bytes, 4);
+  memcpy(instFile + INST_WAV_DATA, pcm, bytes);
+  return vmupro_write_file_complete(path, instFile, INST_WAV_DATA + bytes);
+}
+
+// 16 voices two semitones apart on one instrument, one pull mode period
+// per call. Streamed, the notes start over every 100 periods, before the
+// highest runs out, and the buffers are refilled after each period
+static void RunInstrument(bool streamed)
+{
+  vmupro_instrument_t **inst = streamed ? &benchStreamed : &benchInstrument;
+  if (*inst == NULL)
+  {
+    InstrumentTone(instMono, INST_FRAMES, 7);
+    vmupro_instrument_zone_t zone = vmupro_instrument_zone_defaults();
+    zone.root_key = 72;
+    zone.volume = VMUPRO_SYNTH_UNITY / 16;
+    *inst = vmupro_instrument_new(16);
+    vmupro_instrument_set_steal_policy(*inst, VMUPRO_INSTRUMENT_STEAL_SAME_NOTE);
+    if (streamed)
+    {
+      WriteInstrumentWav("/tmp/vmupro_bench_instrument.wav", instMono, INST_FRAMES, 1, 44100);
+      vmupro_instrument_add_streamed_zone(*inst, "/tmp/vmupro_bench_instrument.wav", 4096, &zone);
+    }
+    else
+    {
+      static vmupro_sound_sample_t sample;
+      vmupro_sound_sample_init(&sample, instMono, INST_FRAMES, 1, 44100);
+      zone.loop_start = 1000;
+      zone.loop_end = INST_FRAMES;
+      vmupro_instrument_add_zone(*inst, &sample, &zone);
+    }
+  }
+  bool start = !vmupro_synth_engine_is_running();
+  if (start)
+  {
+    vmupro_synth_engine_start_manual();
+    vmupro_instrument_stop(*inst);
+  }
+  if (start || (streamed && iter % 100 == 0))
+  {
+    for (int i = 0; i < 16; i++)
+      vmupro_instrument_play_note(*inst, 48 + i * 2, 100);
+  }
+  vmupro_synth_engine_render(mixBlock, VMUPRO_SYNTH_PERIOD_FRAMES);
+  if (streamed)
+    vmupro_instrument_update(*inst);
+}
+
+static void RunInstrumentResident(void) { RunInstrument(false); }
+static void RunInstrumentStreamed(void) { RunInstrument(true); }
+
+static const BenchCase cases[] = {
+    {"display_clear", 240 * 240, RunClear},
+    {"draw_fill_rect", 64 * 64, RunFillRect},
+    {"draw_polygon_filled", 100 * 180, RunPolygonFilled},
+    {"blit_buffer_at", 64 * 64, RunBlitAt},
+    {"blit_buffer_at_clipped", 32 * 32, RunBlitClipped},
+    {"blit_buffer_transparent", 64 * 64, RunTransparent},
+    {"blit_buffer_transparent_flip_hv", 64 * 64, RunTransparentFlip},
+    {"blit_rle", 64 * 64, RunRle},
+    {"blit_rle_flip_hv", 64 * 64, RunRleFlip},
+    {"blit_indexed_8bpp", 64 * 64, RunIndexed8},
+    {"blit_indexed_4bpp", 64 * 64, RunIndexed4},
+    {"blit_indexed_4bpp_flip_hv", 64 * 64, RunIndexed4Flip},
+    {"blit_buffer_blended", 64 * 64, RunBlended},
+    {"blit_buffer_fixed_alpha", 64 * 64, RunFixedAlpha},
+    {"blit_buffer_dithered", 64 * 64, RunDithered},
+    {"blit_buffer_flipped", 64 * 64, RunFlipped},
+    {"blit_buffer_scaled_1x", 64 * 64, RunScaled1x},
+    {"blit_buffer_scaled_2x", 128 * 128, RunScaled2x},
+    {"blit_buffer_advanced_2x", 128 * 128, RunAdvanced},
+    {"blit_buffer_rotated_90", 64 * 64, RunRot90},
+    {"blit_buffer_rotated_precise", 64 * 64, RunRotPrecise},
+    {"blit_affine_rotozoom_nearest", 64 * 64, RunAffineNearest},
+    {"blit_affine_rotozoom_nearest_keyed", 64 * 64, RunAffineNearestKeyed},
+    {"blit_affine_rotozoom_bilinear", 64 * 64, RunAffineBilinear},
+    {"blit_affine_rotozoom_bilinear_keyed_a160", 64 * 64, RunAffineBilinearKeyedAlpha},
+    {"blit_buffer_masked", 64 * 64, RunMasked},
+    {"blit_buffer_color_multiply", 64 * 64, RunColorMultiply},
+    {"blit_buffer_color_add", 64 * 64, RunColorAdd},
+    {"blit_buffer_mosaic", 64 * 64, RunMosaic},
+    {"blit_buffer_blurred", 64 * 64, RunBlurred},
+    {"blit_buffer_with_palette", 240 * 240, RunWithPalette},
+    {"blit_tile", 32 * 32, RunTile},
+    {"blit_tile_advanced", 32 * 32, RunTileAdvanced},
+    {"blit_tile_pattern", 240 * 240, RunTilePattern},
+    {"blit_scrolling_background", 240 * 240, RunScrollingBg},
+    {"blit_scrolling_background_split", 240 * 240, RunScrollingBgSplit},
+    {"blit_infinite_scrolling_background", 240 * 240, RunInfiniteBg},
+    {"blit_infinite_scrolling_background_16", 240 * 240, RunInfiniteBg16},
+    {"blit_line_scroll_background", 240 * 240, RunLineScroll},
+    {"render_indexed_layer_8bpp", 240 * 240, RunIndexedLayer},
+    {"render_all_layers_buffer_tilemap", 240 * 240, RunAllLayers},
+    {"render_all_layers_buffer_tilemap_split", 240 * 240, RunAllLayersSplit},
+    {"render_layers_raster_table", 240 * 240, RunRasterTable},
+    {"render_layers_raster_callback", 240 * 240, RunRasterCallback},
+    {"tiles_blit_tile_advanced_loop", 240 * 240, RunTilesPerBlit},
+    {"tilemap_render_keyed", 240 * 240, RunTilemapKeyed},
+    {"tilemap_render_keyed_classified", 240 * 240, RunTilemapClassified},
+    {"tilemap_render_opaque", 240 * 240, RunTilemapOpaque},
+    {"tilemap_render_indexed4", 240 * 240, RunTilemapIndexed4},
+    {"apply_mosaic_to_screen", 240 * 240, RunMosaicScreen},
+    {"apply_mosaic_to_screen_split", 240 * 240, RunMosaicScreenSplit},
+    {"blend_layers_additive", 240 * 240, RunBlendAdditive},
+    {"blend_layers_additive_split", 240 * 240, RunBlendAdditiveSplit},
+    {"sprite_batch_render_16", 16 * 64 * 64, RunSpriteBatch},
+    {"sprite_batch_crowd_direct", CROWD_SIZE * 64 * 64, RunCrowdDirect},
+    {"sprite_batch_crowd_tiled_16", CROWD_SIZE * 64 * 64, RunCrowdTiled16},
+    {"sprite_batch_crowd_tiled_32", CROWD_SIZE * 64 * 64, RunCrowdTiled32},
+    {"text_hud_draw_text", 3 * 80 * 20, RunTextFirmware},
+    {"text_hud_glyph_cache", 3 * 80 * 20, RunTextCache},
+    {"text_hud_run_batch", 3 * 80 * 20, RunTextRunBatch},
+    {"bmfont_hud_ascii", 3 * 80 * 20, RunBmFontAscii},
+    {"bmfont_utf8_kerned", 120 * 16, RunBmFontUtf8},
+    {"mixer_8_voices_block", 8 * VMUPRO_MIXER_BLOCK_FRAMES, RunMixer8},
+    {"resample_32k_stereo_linear", VMUPRO_MIXER_BLOCK_FRAMES, RunResampleLinear},
+    {"resample_32k_stereo_sinc_8", VMUPRO_MIXER_BLOCK_FRAMES, RunResampleSinc8},
+    {"resample_32k_stereo_sinc_16", VMUPRO_MIXER_BLOCK_FRAMES, RunResampleSinc16},
+    {"synth_32_sawtooth_block", VMUPRO_SYNTH_MAX * VMUPRO_SYNTH_PERIOD_FRAMES, RunSynthSaw},
+    {"synth_32_mixed_block", VMUPRO_SYNTH_MAX * VMUPRO_SYNTH_PERIOD_FRAMES, RunSynthMixed},
+    {"sequence_32_synths_dense_block", VMUPRO_SYNTH_MAX * VMUPRO_SYNTH_PERIOD_FRAMES, RunSequenceDense},
+    {"instrument_16_voices_block", 16 * VMUPRO_SYNTH_PERIOD_FRAMES, RunInstrumentResident},
+    {"instrument_16_voices_streamed_block", 16 * VMUPRO_SYNTH_PERIOD_FRAMES, RunInstrumentStreamed},
+    {"frame_immediate", 240 * 240, RunFrameImmediate},
+    {"frame_display_list_sorted_culled", 240 * 240, RunFrameDisplayList},
+};
+
+#define NUM_CASES ((int)(sizeof(cases) / sizeof(cases[0])))
+
+// Best of several batches, to filter out scheduler noise
+static BenchResult RunCase(const BenchCase *bc, int iterations)
+{
+  for (iter = 0; iter < iterations / 10 + 1; iter++)
+    bc->run();
+
+  uint64_t best = UINT64_MAX;
+  for (int batch = 0; batch < 5; batch++)
+  {
+    uint64_t start = NowNs();
+    for (iter = 0; iter < iterations; iter++)
+      bc->run();
+    uint64_t elapsed = NowNs() - start;
+    best = elapsed < best ? elapsed : best;
+  }
+  // the *_split cases turn split rendering on, the audio cases start the mixer, synths, a sequence or
+  // instruments
+  vmupro_set_split_rendering(false);
+  vmupro_mixer_stop();
+  vmupro_synth_engine_stop();
+  vmupro_sequence_stop(benchSequence);
+  vmupro_instrument_stop(benchInstrument);
+  vmupro_instrument_stop(benchStreamed);
+
+  BenchResult r;
+  r.name = bc->name;
+  r.nsPerCall = (double)best / iterations;
+  r.nsPerPixel = r.nsPerCall / bc->pixels;
+  return r;
+}
+
+static int RunVerify(void)
+{
+  int failures = RunDisplayVerify();
+  failures += RunTextVerify();
+  failures += RunAudioVerify();
+  failures += RunFileVerify();
+  printf("verify: %d mismatch(es)\n", failures);
+  return failures ? 1 : 0;
+}
+
+static bool LoadBaseline(const char *path, const char *name, double *outNsPerPixel)
+{
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+    return false;
+
+  char line[256];
+  bool found = false;
+  while (!found && fgets(line, sizeof(line), f))
+  {
+    char caseName[128];
+    double perCall, perPixel;
+    if (sscanf(line, "%127[^,],%lf,%lf", caseName, &perCall, &perPixel) == 3 && strcmp(caseName, name) == 0)
+    {
+      *outNsPerPixel = perPixel;
+      found = true;
+    }
+  }
+  fclose(f);
+  return found;
+}
+
+int main(int argc, char **argv)
+{
+  int iterations = 200;
+  const char *csvPath = NULL;
+  const char *baselinePath = NULL;
+  double tolerance = 25.0;
+  bool verify = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      iterations = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+      csvPath = argv[++i];
+    else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+      baselinePath = argv[++i];
+    else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+      tolerance = atof(argv[++i]);
+    else if (strcmp(argv[i], "--verify") == 0)
+      verify = true;
+    else
+    {
+      fprintf(stderr, "usage: %s [-n iterations] [--csv out.csv] [--baseline base.csv] [--tolerance pct] [--verify]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (iterations < 1)
+    iterations = 1;
+
+  InitAssets();
+  vmupro_host_reset();
+  vmupro_start_double_buffer_renderer();
+
+  if (verify)
+    return RunVerify();
+
+#ifdef VMUPRO_PROFILE
+  vmupro_profile_reset();
+#endif
+
+  BenchResult results[MAX_CASES];
+  printf("%-38s %12s %10s\n", "case", "ns/call", "ns/pixel");
+  for (int i = 0; i < NUM_CASES; i++)
+  {
+    results[i] = RunCase(&cases[i], iterations);
+    printf("%-38s %12.1f %10.3f\n", results[i].name, results[i].nsPerCall, results[i].nsPerPixel);
+  }
+
+#ifdef VMUPRO_PROFILE
+  // per API function totals across every case, see vmupro_profile.h
+  vmupro_profile_dump_csv();
+#endif
+
+  vmupro_stop_double_buffer_renderer();
+
+  if (csvPath)
+  {
+    FILE *f = fopen(csvPath, "w");
+    if (f == NULL)
+    {
+      fprintf(stderr, "can't write %s\n", csvPath);
+      return 2;
+    }
+    fprintf(f, "case,ns_per_call,ns_per_pixel\n");
+    for (int i = 0; i < NUM_CASES; i++)
+      fprintf(f, "%s,%.3f,%.5f\n", results[i].name, results[i].nsPerCall, results[i].nsPerPixel);
+    fclose(f);
+  }
+
+  int regressions = 0;
+  if (baselinePath)
+  {
+    for (int i = 0; i < NUM_CASES; i++)
+    {
+      double base;
+      if (!LoadBaseline(baselinePath, results[i].name, &base) || base <= 0.0)
+        continue;
+      double change = (results[i].nsPerPixel / base - 1.0) * 100.0;
+      if (change > tolerance)
+      {
+        printf("REGRESSION %s: %.3f -> %.3f ns/pixel (+%.1f%%)\n", results[i].name, base, results[i].nsPerPixel, change);
+        regressions++;
+      }
+    }
+    printf("%d regression(s) against %s (tolerance %.1f%%)\n", regressions, baselinePath, tolerance);
+  }
+
+  return regressions ? 1 : 0;
+}
@@ -0,0 +1,1900 @@
+// tools/hostsim/bench/verify_audio.c
+//
+// bench_display --verify checks for audio: the mixer against a frame by
+// frame model, pull mode keeping the output fed, sample rate conversion
+// and rate control, streamed WAV and ADPCM files against whole ones,
+// band-limited synths, MIDI sequences against the tempo map, and sampled
+// instruments against a per-voice model, resident or streamed
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "vmupro_sdk.h"
+#include "vmupro_host.h"
+#include "bench.h"
+
+// Independent model of one mixer voice, advanced a frame at a time
+typedef struct
+{
+  const vmupro_sound_sample_t *s;
+  bool active;
+  uint64_t pos;
+  uint32_t step;
+  int repeats;
+  int32_t gl, gr;
+} RefVoice;
+
+static void RefVoiceStart(RefVoice *v, const vmupro_sound_sample_t *s, int repeats, int gl, int gr, uint32_t rate)
+{
+  v->s = s;
+  v->active = true;
+  v->pos = 0;
+  v->step = (uint32_t)(((uint64_t)s->sample_rate * rate + 22050) / 44100);
+  v->repeats = repeats;
+  v->gl = gl;
+  v->gr = gr;
+}
+
+static void RefMix(RefVoice *rv, int count, int16_t *out, int frames, uint32_t *clipped)
+{
+  for (int f = 0; f < frames; f++)
+  {
+    int32_t acc[2] = {0, 0};
+    for (int i = 0; i < count; i++)
+    {
+      RefVoice *v = &rv[i];
+      if (!v->active)
+        continue;
+      uint32_t at = (uint32_t)(v->pos >> 16);
+      int32_t frac = (int32_t)(v->pos & 0xffff) >> 1;
+      int ch = v->s->channels;
+      for (int c = 0; c < 2; c++)
+      {
+        int k = ch == 2 ? c : 0;
+        int32_t a = v->s->pcm[at * ch + k];
+        int32_t b = at + 1 < v->s->frames ? v->s->pcm[(at + 1) * ch + k] : a;
+        acc[c] += (a + (((b - a) * frac) >> 15)) * (c ? v->gr : v->gl);
+      }
+      v->pos += v->step;
+      if (v->pos >= (uint64_t)v->s->frames << 16)
+      {
+        if (v->repeats == 0)
+          v->active = false;
+        else
+        {
+          v->repeats--;
+          v->pos -= (uint64_t)v->s->frames << 16;
+        }
+      }
+    }
+    for (int c = 0; c < 2; c++)
+    {
+      int32_t x = acc[c] >> 8;
+      if (x > 32767 || x < -32768)
+        (*clipped)++;
+      out[f * 2 + c] = (int16_t)(x > 32767 ? 32767 : x < -32768 ? -32768 : x);
+    }
+  }
+}
+
+static int CompareAudio(const char *what, const int16_t *got, const int16_t *expected, int frames)
+{
+  for (int i = 0; i < frames * 2; i++)
+  {
+    if (got[i] != expected[i])
+    {
+      printf("MISMATCH %s frame %d %s: %d, expected %d\n", what, i / 2, (i & 1) ? "right" : "left", got[i],
+             expected[i]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int mixFinished;
+static int mixFinishedVoice;
+
+static void OnSoundFinished(int voice, void *user)
+{
+  (void)user;
+  mixFinished++;
+  mixFinishedVoice = voice;
+}
+
+// Stands in for audio an app plays through its own pull mode task
+static void PullSilence(int16_t *samples, int frames, void *user)
+{
+  (void)user;
+  memset(samples, 0, (size_t)frames * 2 * sizeof(int16_t));
+}
+
+static void PullMixer(int16_t *samples, int frames, void *user)
+{
+  (void)user;
+  vmupro_mixer_render(samples, frames);
+}
+
+#define MIX_VERIFY_FRAMES 12000
+static int16_t mixGot[MIX_VERIFY_FRAMES * 2];
+static int16_t mixExpected[MIX_VERIFY_FRAMES * 2];
+
+// Renders in uneven chunks and changes voices part way through, against a
+// frame by frame model; then checks WAV loading and the audio task itself
+static int VerifyMixer(void)
+{
+  static const int chunks[] = {1, 255, 256, 257, 1000, 3};
+  int failures = 0;
+  vmupro_host_reset();
+  SetupMixerSamples();
+
+  RefVoice ref[4];
+  uint32_t refClipped = 0;
+  memset(ref, 0, sizeof(ref));
+  vmupro_mixer_start_manual(4);
+  mixFinished = 0;
+  vmupro_sound_sample_set_volume(&sndMono, 200, 100);
+  int voiceMono = vmupro_sound_sample_play(&sndMono, 1, OnSoundFinished, NULL);
+  RefVoiceStart(&ref[0], &sndMono, 1, 200, 100, VMUPRO_MIXER_RATE_ONE);
+  int voiceStereo = vmupro_sound_sample_play(&sndStereo, 0, NULL, NULL);
+  vmupro_mixer_voice_set_pan(voiceStereo, 300, -64);
+  RefVoiceStart(&ref[1], &sndStereo, 0, 300, 300 * 64 / 128, VMUPRO_MIXER_RATE_ONE);
+  vmupro_sound_sample_set_rate(&sndHalf, VMUPRO_MIXER_RATE_ONE * 3 / 2);
+  vmupro_sound_sample_play(&sndHalf, 2, NULL, NULL);
+  RefVoiceStart(&ref[2], &sndHalf, 2, VMUPRO_MIXER_UNITY, VMUPRO_MIXER_UNITY, VMUPRO_MIXER_RATE_ONE * 3 / 2);
+
+  int done = 0;
+  bool changed = false;
+  for (int c = 0; done < MIX_VERIFY_FRAMES; c++)
+  {
+    int n = chunks[c % 6];
+    n = n < MIX_VERIFY_FRAMES - done ? n : MIX_VERIFY_FRAMES - done;
+    if (done >= 2000 && !changed)
+    {
+      changed = true;
+      // two loud voices to saturate, and changes to playing voices
+      vmupro_sound_sample_set_volume(&sndLoud, 512, 512);
+      vmupro_sound_sample_play(&sndLoud, 0, NULL, NULL);
+      RefVoiceStart(&ref[3], &sndLoud, 0, 512, 512, VMUPRO_MIXER_RATE_ONE);
+      vmupro_sound_sample_set_volume(&sndMono, 64, 256);
+      ref[0].gl = 64;
+      ref[0].gr = 256;
+      vmupro_mixer_voice_set_rate(voiceStereo, VMUPRO_MIXER_RATE_ONE / 3);
+      ref[1].step = (uint32_t)(((uint64_t)44100 * (VMUPRO_MIXER_RATE_ONE / 3) + 22050) / 44100);
+    }
+    vmupro_mixer_render(mixGot + done * 2, n);
+    RefMix(ref, 4, mixExpected + done * 2, n, &refClipped);
+    done += n;
+  }
+  failures += CompareAudio("mixer_render", mixGot, mixExpected, MIX_VERIFY_FRAMES);
+
+  vmupro_mixer_stats_t stats;
+  vmupro_mixer_get_stats(&stats);
+  vmupro_sound_update();
+  if (stats.clipped != refClipped || refClipped == 0 || stats.peak_voices != 4 || stats.voices_started != 4)
+  {
+    printf("MISMATCH mixer stats: %u clipped (expected %u), peak %u voices, %u started\n", stats.clipped, refClipped,
+           stats.peak_voices, stats.voices_started);
+    failures++;
+  }
+  if (mixFinished != 1 || mixFinishedVoice != voiceMono || vmupro_mixer_voice_is_playing(voiceMono) ||
+      vmupro_sound_sample_is_playing(&sndMono))
+  {
+    printf("MISMATCH mixer finish callback: %d call(s)\n", mixFinished);
+    failures++;
+  }
+
+  // a full mixer refuses plays, stale handles are ignored
+  vmupro_mixer_stop();
+  vmupro_mixer_start_manual(2);
+  int first = vmupro_sound_sample_play(&sndMono, 0, NULL, NULL);
+  vmupro_sound_sample_play(&sndMono, 0, NULL, NULL);
+  bool refused = vmupro_sound_sample_play(&sndStereo, 0, NULL, NULL) < 0;
+  vmupro_mixer_voice_stop(first);
+  vmupro_mixer_render(mixGot, 16);
+  int again = vmupro_sound_sample_play(&sndStereo, 0, NULL, NULL);
+  vmupro_mixer_voice_stop(first);
+  vmupro_mixer_render(mixGot, 16);
+  if (!refused || again < 0 || again == first || vmupro_mixer_voice_is_playing(first) ||
+      !vmupro_mixer_voice_is_playing(again))
+  {
+    printf("MISMATCH mixer voice allocation\n");
+    failures++;
+  }
+  vmupro_mixer_stop();
+
+  // WAV files, from memory and through the file API
+  static uint8_t wav[44 + 2 * 2 * 100] __attribute__((aligned(4)));
+  static const uint8_t wavHeader[44] = {'R', 'I', 'F', 'F', (36 + 400) & 0xff, (36 + 400) >> 8, 0, 0,
+                                        'W', 'A', 'V', 'E', 'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 2, 0,
+                                        0x22, 0x56, 0, 0, 0x88, 0x58, 0x01, 0, 4, 0, 16, 0,
+                                        'd', 'a', 't', 'a', 400 & 0xff, 400 >> 8, 0, 0};
+  memcpy(wav, wavHeader, sizeof(wavHeader));
+  memcpy(wav + 44, mixStereo, 400);
+  vmupro_sound_sample_t fromMemory;
+  bool wavOk = vmupro_sound_sample_init_wav(&fromMemory, wav, sizeof(wav)) && fromMemory.frames == 100 &&
+               fromMemory.channels == 2 && fromMemory.sample_rate == 22050 &&
+               memcmp(fromMemory.pcm, mixStereo, 400) == 0;
+  vmupro_host_set_sdcard_root("/tmp");
+  vmupro_sound_sample_t *fromFile = NULL;
+  if (vmupro_write_file_complete("/sdcard/vmupro_bench_mixer.wav", wav, sizeof(wav)))
+    fromFile = vmupro_sound_sample_new("/sdcard/vmupro_bench_mixer.wav");
+  wavOk = wavOk && fromFile != NULL && fromFile->frames == 100 && memcmp(fromFile->pcm, mixStereo, 400) == 0;
+  vmupro_sound_sample_free(fromFile);
+  remove("/tmp/vmupro_bench_mixer.wav");
+  wav[21] = 3; // float samples
+  wavOk = wavOk && !vmupro_sound_sample_init_wav(&fromMemory, wav, sizeof(wav)) &&
+          vmupro_sound_sample_new("/sdcard/missing.wav") == NULL;
+  wav[21] = 0;
+  wav[22] = 0; // no channels
+  wavOk = wavOk && !vmupro_sound_sample_init_wav(&fromMemory, wav, sizeof(wav));
+  wav[22] = 1;
+  wav[23] = 1; // 257 channels
+  wavOk = wavOk && !vmupro_sound_sample_init_wav(&fromMemory, wav, sizeof(wav));
+  vmupro_host_set_sdcard_root(NULL);
+  if (!wavOk)
+  {
+    printf("MISMATCH mixer WAV loading\n");
+    failures++;
+  }
+
+  // The audio task produces the same mix through the ring buffer
+  vmupro_mixer_start_manual(1);
+  vmupro_sound_sample_set_volume(&sndMono, VMUPRO_MIXER_UNITY, VMUPRO_MIXER_UNITY);
+  vmupro_sound_sample_play(&sndMono, 0, NULL, NULL);
+  vmupro_mixer_render(mixExpected, MIX_MONO_FRAMES);
+
+  // Freeing a playing sample with nothing but the game loop rendering
+  // ends its voice at once rather than waiting on a render, even while a
+  // pull mode task that doesn't render the mixer is running
+  vmupro_audio_pull_start(NULL, PullSilence, NULL);
+  vmupro_sound_sample_play(&sndMono, 0, NULL, NULL);
+  vmupro_mixer_render(mixGot, 64);
+  vmupro_sound_sample_free(&sndMono);
+  vmupro_mixer_render(mixGot, 64);
+  vmupro_audio_pull_stop();
+  int loud = 0;
+  for (int i = 0; i < 64 * 2; i++)
+    loud += mixGot[i] != 0;
+  if (vmupro_sound_sample_is_playing(&sndMono) || loud != 0)
+  {
+    printf("MISMATCH mixer manual free left the voice playing\n");
+    failures++;
+  }
+
+  // Rendered from the app's own pull mode callback, free waits for the
+  // task to end the voice as it does for the mixer's own task
+  vmupro_audio_pull_start(NULL, PullMixer, NULL);
+  vmupro_sound_sample_play(&sndMono, 0, NULL, NULL);
+  vmupro_audio_pull_stats_t pullStats = {0};
+  uint64_t rendered = vmupro_get_time_us() + 1000000;
+  while (pullStats.callbacks == 0 && vmupro_get_time_us() < rendered)
+  {
+    vmupro_sleep_ms(1);
+    vmupro_audio_pull_get_stats(&pullStats);
+  }
+  bool taskPlaying = vmupro_sound_sample_is_playing(&sndMono);
+  vmupro_sound_sample_free(&sndMono);
+  vmupro_audio_pull_stop();
+  if (!taskPlaying || vmupro_sound_sample_is_playing(&sndMono))
+  {
+    printf("MISMATCH mixer free from a pull mode callback: playing %d before, %d after\n", taskPlaying,
+           vmupro_sound_sample_is_playing(&sndMono));
+    failures++;
+  }
+  vmupro_mixer_stop();
+
+  vmupro_host_audio_set_realtime(false);
+  vmupro_host_audio_capture(mixGot, MIX_VERIFY_FRAMES);
+  mixFinished = 0;
+  vmupro_mixer_start(4);
+  int voice = vmupro_sound_sample_play(&sndMono, 0, OnSoundFinished, NULL);
+  uint64_t deadline = vmupro_get_time_us() + 5000000;
+  while ((vmupro_mixer_voice_is_playing(voice) || vmupro_host_audio_captured() < MIX_MONO_FRAMES + 2048) &&
+         vmupro_host_audio_captured() < MIX_VERIFY_FRAMES && vmupro_get_time_us() < deadline)
+  {
+    // the mixer writes stereo, two samples per frame
+    uint32_t filled = 0;
+    vmupro_get_ringbuffer_fill_state(&filled, NULL);
+    if (filled >= VMUPRO_MIXER_BLOCK_FRAMES * 2)
+      vmupro_host_audio_drain(VMUPRO_MIXER_BLOCK_FRAMES);
+    else
+      vmupro_sleep_ms(1);
+  }
+  vmupro_sound_update();
+  vmupro_mixer_stop();
+  uint32_t got = vmupro_host_audio_captured();
+  vmupro_host_audio_capture(NULL, 0);
+
+  uint32_t start = 0;
+  while (start < got && mixGot[start * 2] == 0)
+    start++;
+  if (start + MIX_MONO_FRAMES > got || mixFinished != 1)
+  {
+    printf("MISMATCH mixer task played %u of %d frames, %d finish callback(s)\n",
+           got > start ? got - start : 0, MIX_MONO_FRAMES, mixFinished);
+    failures++;
+  }
+  else
+  {
+    failures += CompareAudio("mixer_task", mixGot + start * 2, mixExpected, MIX_MONO_FRAMES);
+  }
+
+  vmupro_host_reset();
+  return failures;
+}
+
+static int pullNext;
+static int pullBadPeriods;
+
+// Stereo ramp, so lost or repeated periods show up in the capture
+static void PullRamp(int16_t *samples, int frames, void *user)
+{
+  if (frames != *(int *)user)
+    pullBadPeriods++;
+  for (int i = 0; i < frames; i++, pullNext++)
+  {
+    samples[i * 2] = (int16_t)(pullNext & 0x7fff);
+    samples[i * 2 + 1] = (int16_t)-(pullNext & 0x7fff);
+  }
+}
+
+// Plays the output in real time, checks the callback kept it fed without
+// gaps, then starves it
+static int VerifyAudioPull(void)
+{
+  enum
+  {
+    PERIOD = 256,
+    PERIODS = 4,
+    CAPTURE = 24 * PERIOD
+  };
+  int failures = 0;
+  int period = PERIOD;
+  vmupro_host_reset();
+  vmupro_host_audio_capture(mixGot, CAPTURE);
+  pullNext = 0;
+  pullBadPeriods = 0;
+
+  vmupro_audio_pull_config_t config = vmupro_audio_pull_defaults();
+  config.period_frames = PERIOD;
+  config.periods = PERIODS;
+  vmupro_audio_pull_config_t tooSmall = config, tooFew = config, tooBig = config;
+  tooSmall.period_frames = 16;
+  tooFew.periods = 1;
+  tooBig.period_frames = VMUPRO_AUDIO_PULL_MAX_PERIOD;
+  tooBig.periods = VMUPRO_AUDIO_PULL_MAX_PERIODS;
+  bool rejected = !vmupro_audio_pull_start(&tooSmall, PullRamp, &period) &&
+                  !vmupro_audio_pull_start(&tooFew, PullRamp, &period) &&
+                  !vmupro_audio_pull_start(&tooBig, PullRamp, &period);
+  if (!vmupro_audio_pull_start(&config, PullRamp, &period) || !rejected ||
+      vmupro_audio_pull_start(&config, PullRamp, &period))
+  {
+    printf("MISMATCH audio_pull_start accepted or refused the wrong settings\n");
+    vmupro_audio_pull_stop();
+    return 1;
+  }
+
+  uint64_t deadline = vmupro_get_time_us() + 5000000;
+  while (vmupro_host_audio_captured() < CAPTURE && vmupro_get_time_us() < deadline)
+    vmupro_sleep_ms(5);
+  vmupro_audio_pull_stats_t stats;
+  vmupro_audio_pull_get_stats(&stats);
+  uint32_t got = vmupro_host_audio_captured();
+  for (uint32_t i = 0; i < got; i++)
+  {
+    if (mixGot[i * 2] != (int16_t)(i & 0x7fff) || mixGot[i * 2 + 1] != (int16_t)-(i & 0x7fff))
+    {
+      printf("MISMATCH audio_pull frame %u: %d/%d\n", i, mixGot[i * 2], mixGot[i * 2 + 1]);
+      failures++;
+      break;
+    }
+  }
+  uint32_t maxLatency = PERIOD * PERIODS * 1000000u / 44100;
+  if (got < CAPTURE || pullBadPeriods != 0 || stats.underruns != 0 || stats.callbacks < CAPTURE / PERIOD ||
+      stats.latency_us == 0 || stats.max_latency_us > maxLatency)
+  {
+    printf("MISMATCH audio_pull: %u frames, %u callbacks, %u underruns, latency %u us (max %u, limit %u)\n", got,
+           stats.callbacks, stats.underruns, stats.latency_us, stats.max_latency_us, maxLatency);
+    failures++;
+  }
+
+  // the output overtakes the callback
+  vmupro_host_audio_set_realtime(false);
+  vmupro_host_audio_drain(4096);
+  deadline = vmupro_get_time_us() + 1000000;
+  while (stats.underruns == 0 && vmupro_get_time_us() < deadline)
+  {
+    vmupro_sleep_ms(1);
+    vmupro_audio_pull_get_stats(&stats);
+  }
+  vmupro_audio_pull_stop();
+  vmupro_host_audio_stats_t output;
+  vmupro_host_audio_get_stats(&output);
+  int callbacks = pullNext;
+  vmupro_sleep_ms(10);
+  if (stats.underruns == 0 || output.underruns == 0 || vmupro_audio_pull_is_running() || pullNext != callbacks)
+  {
+    printf("MISMATCH audio_pull underrun not reported (%u), or callbacks after stop\n", stats.underruns);
+    failures++;
+  }
+  printf("audio pull: %d frame periods, %u callbacks, latency %u us\n", PERIOD, stats.callbacks, stats.latency_us);
+
+  vmupro_host_reset();
+  return failures;
+}
+
+// Signal to noise ratio in dB of a resampled sine against the exact sine
+static double SineSnr(vmupro_resample_quality_t quality, uint32_t inRate, double freq)
+{
+  static vmupro_resampler_t r;
+  const double twoPi = 6.283185307179586;
+  int inFrames = MIX_VERIFY_FRAMES / 2;
+  for (int i = 0; i < inFrames; i++)
+    mixExpected[i] = (int16_t)lround(16000.0 * sin(twoPi * freq * i / inRate));
+  vmupro_resampler_init(&r, inRate, 44100, 1, quality);
+  int n = vmupro_resampler_process(&r, mixExpected, inFrames, NULL, mixGot, MIX_VERIFY_FRAMES);
+  double signal = 0.0, noise = 0.0;
+  for (int i = 16; i < n - 16; i++)
+  {
+    double exact = 16000.0 * sin(twoPi * freq * i / 44100.0);
+    signal += exact * exact;
+    noise += (mixGot[i] - exact) * (mixGot[i] - exact);
+  }
+  return 10.0 * log10(signal / (noise + 1e-9));
+}
+
+// Linear against its formula, chunked conversion against a single pass,
+// the quality of each mode on sines, and the stream wrapper through the
+// ring buffer
+static int VerifyResampler(void)
+{
+  static vmupro_resampler_t r, mono;
+  static const int chunks[] = {1, 7, 64, 300, 2, 1000};
+  int failures = 0;
+  vmupro_host_reset();
+  SetupMixerSamples();
+
+  vmupro_resampler_init(&r, 22050, 44100, 1, VMUPRO_RESAMPLE_LINEAR);
+  int n = vmupro_resampler_process(&r, mixHalf, MIX_HALF_FRAMES, NULL, mixGot, MIX_VERIFY_FRAMES);
+  for (int i = 0; i < n; i++)
+  {
+    int a = mixHalf[i / 2], b = mixHalf[i / 2 + 1];
+    int expected = (i & 1) ? a + ((b - a) * 16384 >> 15) : a;
+    if (mixGot[i] != expected)
+    {
+      printf("MISMATCH resample_linear frame %d: %d, expected %d\n", i, mixGot[i], expected);
+      failures++;
+      break;
+    }
+  }
+  if (n != MIX_HALF_FRAMES * 2 - 2 || n > vmupro_resampler_max_output(&r, MIX_HALF_FRAMES))
+  {
+    printf("MISMATCH resample_linear produced %d frames\n", n);
+    failures++;
+  }
+
+  // uneven input and output chunks give the same output as one call
+  vmupro_resampler_init(&r, 48000, 44100, 2, VMUPRO_RESAMPLE_SINC_16);
+  int whole = vmupro_resampler_process(&r, mixStereo, MIX_STEREO_FRAMES, NULL, mixExpected, MIX_VERIFY_FRAMES);
+  whole += vmupro_resampler_flush(&r, mixExpected + whole * 2, MIX_VERIFY_FRAMES - whole);
+  vmupro_resampler_reset(&r);
+  int done = 0, got = 0;
+  for (int c = 0; done < MIX_STEREO_FRAMES; c++)
+  {
+    int in = chunks[c % 6] < MIX_STEREO_FRAMES - done ? chunks[c % 6] : MIX_STEREO_FRAMES - done;
+    int used = 0;
+    got += vmupro_resampler_process(&r, mixStereo + done * 2, in, &used, mixGot + got * 2, chunks[(c + 3) % 6]);
+    done += used;
+  }
+  got += vmupro_resampler_flush(&r, mixGot + got * 2, MIX_VERIFY_FRAMES - got);
+  if (got != whole)
+  {
+    printf("MISMATCH resample_chunked produced %d frames, expected %d\n", got, whole);
+    failures++;
+  }
+  else
+  {
+    failures += CompareAudio("resample_chunked", mixGot, mixExpected, whole);
+  }
+
+  // the right channel converts the same as on its own
+  for (int i = 0; i < MIX_STEREO_FRAMES; i++)
+    mixExpected[i] = mixStereo[i * 2 + 1];
+  vmupro_resampler_init(&mono, 48000, 44100, 1, VMUPRO_RESAMPLE_SINC_16);
+  n = vmupro_resampler_process(&mono, mixExpected, MIX_STEREO_FRAMES, NULL, mixExpected + MIX_STEREO_FRAMES,
+                               MIX_VERIFY_FRAMES);
+  for (int i = 0; i < n; i++)
+  {
+    if (mixGot[i * 2 + 1] != mixExpected[MIX_STEREO_FRAMES + i])
+    {
+      printf("MISMATCH resample_stereo frame %d: %d, expected %d\n", i, mixGot[i * 2 + 1],
+             mixExpected[MIX_STEREO_FRAMES + i]);
+      failures++;
+      break;
+    }
+  }
+
+  // more taps buy a wider clean passband
+  double linear = SineSnr(VMUPRO_RESAMPLE_LINEAR, 32000, 1000.0);
+  double sinc8 = SineSnr(VMUPRO_RESAMPLE_SINC_8, 32000, 5000.0);
+  double sinc16 = SineSnr(VMUPRO_RESAMPLE_SINC_16, 32000, 10000.0);
+  double linearHigh = SineSnr(VMUPRO_RESAMPLE_LINEAR, 32000, 10000.0);
+  if (linear < 40.0 || sinc8 < 45.0 || sinc16 < 40.0 || linearHigh > sinc16 - 20.0)
+  {
+    printf("MISMATCH resample quality: linear %.1f dB at 1kHz, %.1f dB at 10kHz, sinc 8 %.1f dB at 5kHz, "
+           "sinc 16 %.1f dB at 10kHz\n", linear, linearHigh, sinc8, sinc16);
+    failures++;
+  }
+
+  // 32kHz stereo through the stream wrapper reaches the ring buffer converted
+  vmupro_resampler_init(&r, 32000, 44100, 2, VMUPRO_RESAMPLE_SINC_8);
+  whole = vmupro_resampler_process(&r, mixStereo, 2000, NULL, mixExpected, MIX_VERIFY_FRAMES);
+  vmupro_host_audio_set_realtime(false);
+  vmupro_host_audio_capture(mixGot, MIX_VERIFY_FRAMES);
+  vmupro_audio_start_listen_mode();
+  bool accepted = !vmupro_audio_stream_set_format(1000, VMUPRO_AUDIO_STEREO, VMUPRO_RESAMPLE_SINC_8) &&
+                  vmupro_audio_stream_set_format(32000, VMUPRO_AUDIO_STEREO, VMUPRO_RESAMPLE_SINC_8);
+  for (done = 0; done < 2000; done += 125)
+    vmupro_audio_stream_write(mixStereo + done * 2, 125, false);
+  vmupro_host_audio_drain(4096);
+  got = (int)vmupro_host_audio_captured();
+  vmupro_host_audio_capture(NULL, 0);
+  vmupro_audio_exit_listen_mode();
+  if (!accepted || got != whole)
+  {
+    printf("MISMATCH audio_stream_write queued %d frames, expected %d\n", got, whole);
+    failures++;
+  }
+  else
+  {
+    failures += CompareAudio("audio_stream_write", mixGot, mixExpected, whole);
+  }
+  vmupro_audio_stream_set_format(44100, VMUPRO_AUDIO_MONO, VMUPRO_RESAMPLE_LINEAR);
+  printf("resampler: 32kHz sine SNR linear %.1f dB (1kHz), sinc 8 %.1f dB (5kHz), sinc 16 %.1f dB (10kHz)\n",
+         linear, sinc8, sinc16);
+
+  vmupro_host_reset();
+  return failures;
+}
+
+// One game frame of 32kHz audio per write against an output clock that
+// runs drift ppm fast. Returns the host output counters, and the fill
+// range and times found empty over the second half of the run
+static vmupro_host_audio_stats_t RunDriftingStream(int drift, int frames, bool control, uint32_t *minFill,
+                                                    uint32_t *maxFill, vmupro_rate_control_stats_t *stats)
+{
+  enum
+  {
+    WRITE = 533
+  };
+  vmupro_host_reset();
+  vmupro_host_audio_set_realtime(false);
+  vmupro_audio_start_listen_mode();
+  vmupro_audio_stream_set_format(32000, VMUPRO_AUDIO_MONO, VMUPRO_RESAMPLE_LINEAR);
+  vmupro_rate_control_config_t config = vmupro_rate_control_defaults();
+  vmupro_audio_stream_set_rate_control(control ? &config : NULL);
+
+  // output frames per game frame, in millionths
+  uint64_t perFrame = (uint64_t)WRITE * 44100 * (uint64_t)(1000000 + drift) / 32000;
+  uint64_t owed = 0;
+  *minFill = UINT32_MAX;
+  *maxFill = 0;
+  vmupro_rate_control_stats_t half;
+  for (int f = 0; f < frames; f++)
+  {
+    if (f == frames / 2)
+      vmupro_audio_stream_get_rate_control_stats(&half);
+    owed += perFrame;
+    vmupro_host_audio_drain((uint32_t)(owed / 1000000));
+    owed %= 1000000;
+    uint32_t filled = 0;
+    vmupro_get_ringbuffer_fill_state(&filled, NULL);
+    if (f >= frames / 2)
+    {
+      *minFill = filled < *minFill ? filled : *minFill;
+      *maxFill = filled > *maxFill ? filled : *maxFill;
+    }
+    vmupro_audio_stream_write(mixHalf + (f * 7) % (MIX_HALF_FRAMES - WRITE), WRITE, false);
+  }
+  vmupro_audio_stream_get_rate_control_stats(stats);
+  stats->empty -= half.empty;
+  vmupro_host_audio_stats_t output;
+  vmupro_host_audio_get_stats(&output);
+  vmupro_audio_stream_set_rate_control(NULL);
+  vmupro_audio_stream_set_format(44100, VMUPRO_AUDIO_MONO, VMUPRO_RESAMPLE_LINEAR);
+  vmupro_audio_exit_listen_mode();
+  return output;
+}
+
+// A producer 0.3% slow or fast against the output: left alone the ring
+// buffer runs dry or overflows, with rate control the fill settles on the
+// target and the correction on the drift
+static int VerifyRateControl(void)
+{
+  enum
+  {
+    FRAMES = 4000
+  };
+  int failures = 0;
+  uint32_t target = vmupro_rate_control_defaults().target_fill;
+  for (int drift = -3000; drift <= 3000; drift += 6000)
+  {
+    uint32_t minFill, maxFill;
+    vmupro_rate_control_stats_t stats;
+    vmupro_host_audio_stats_t loose = RunDriftingStream(drift, FRAMES, false, &minFill, &maxFill, &stats);
+    vmupro_host_audio_stats_t held = RunDriftingStream(drift, FRAMES, true, &minFill, &maxFill, &stats);
+    printf("rate control %+d ppm: fill %u-%u (target %u), correction %+d ppm, drift %+d ppm\n", drift, minFill,
+           maxFill, target, stats.adjust_ppm, stats.drift_ppm);
+    bool gapsWithout = drift > 0 ? loose.underruns > 0 : loose.overflow_frames > 0;
+    if (!gapsWithout || held.underruns != 0 || held.overflow_frames != 0 || stats.empty != 0 ||
+        minFill < target * 3 / 4 || maxFill > target * 5 / 4 || abs(stats.drift_ppm - drift) > 300 ||
+        stats.updates != FRAMES)
+    {
+      printf("MISMATCH rate control %+d ppm: %llu/%llu underruns, %llu/%llu overflow frames, %u empty, %u updates\n",
+             drift, (unsigned long long)loose.underruns, (unsigned long long)held.underruns,
+             (unsigned long long)loose.overflow_frames, (unsigned long long)held.overflow_frames, stats.empty,
+             stats.updates);
+      failures++;
+    }
+  }
+  vmupro_host_reset();
+  return failures;
+}
+
+#define STREAM_TONE_FRAMES 6000
+static int16_t streamTone[STREAM_TONE_FRAMES * 2];
+static uint8_t streamFile[44 + 108 + STREAM_TONE_FRAMES * 4];
+static uint8_t streamAdpcm[STREAM_TONE_FRAMES * 4];
+
+static void Put16(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void Put32(uint8_t *p, uint32_t v)
+{
+  Put16(p, v & 0xffff);
+  Put16(p + 2, v >> 16);
+}
+
+// Writes a WAV file under /tmp, with a LIST chunk ahead of the data when
+// asked so the samples don't start on a read boundary
+static bool WriteStreamWav(const char *name, int format, int channels, uint32_t rate, int bits, int blockAlign,
+                           const void *data, uint32_t bytes, bool list)
+{
+  uint32_t at = 12;
+  memcpy(streamFile, "RIFF\0\0\0\0WAVEfmt ", 16);
+  Put32(streamFile + 16, 16);
+  Put16(streamFile + 20, (uint32_t)format);
+  Put16(streamFile + 22, (uint32_t)channels);
+  Put32(streamFile + 24, rate);
+  Put32(streamFile + 28, rate * (uint32_t)blockAlign);
+  Put16(streamFile + 32, (uint32_t)blockAlign);
+  Put16(streamFile + 34, (uint32_t)bits);
+  at = 36;
+  if (list)
+  {
+    memcpy(streamFile + at, "LIST", 4);
+    Put32(streamFile + at + 4, 100);
+    memset(streamFile + at + 8, 'x', 100);
+    at += 108;
+  }
+  memcpy(streamFile + at, "data", 4);
+  Put32(streamFile + at + 4, bytes);
+  memcpy(streamFile + at + 8, data, bytes);
+  Put32(streamFile + 4, at + 8 + bytes - 8);
+  char path[64];
+  snprintf(path, sizeof(path), "/sdcard/%s", name);
+  return vmupro_write_file_complete(path, streamFile, at + 8 + bytes);
+}
+
+static const int16_t benchImaSteps[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+    9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+static const int benchImaShift[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+// Reference IMA step: decodes nibble n against predictor/index
+static int ImaStep(int *predictor, int *index, int n)
+{
+  int step = benchImaSteps[*index];
+  int diff = step >> 3;
+  if (n & 1)
+    diff += step >> 2;
+  if (n & 2)
+    diff += step >> 1;
+  if (n & 4)
+    diff += step;
+  int p = *predictor + ((n & 8) ? -diff : diff);
+  *predictor = p > 32767 ? 32767 : p < -32768 ? -32768 : p;
+  *index += benchImaShift[n & 7];
+  *index = *index < 0 ? 0 : *index > 88 ? 88 : *index;
+  return *predictor;
+}
+
+// Standard IMA ADPCM encoder, whole blocks only
+static uint32_t ImaEncode(const int16_t *pcm, int frames, int channels, int blockAlign, uint8_t *out)
+{
+  int perBlock = (blockAlign - 4 * channels) * 2 / channels + 1;
+  int predictor[2] = {0, 0}, index[2] = {0, 0};
+  uint32_t bytes = 0;
+  for (int start = 0; start + perBlock <= frames; start += perBlock)
+  {
+    uint8_t *block = out + bytes;
+    memset(block, 0, (size_t)blockAlign);
+    for (int c = 0; c < channels; c++)
+    {
+      predictor[c] = pcm[start * channels + c];
+      Put16(block + c * 4, (uint16_t)predictor[c]);
+      block[c * 4 + 2] = (uint8_t)index[c];
+    }
+    for (int i = 1; i < perBlock; i++)
+    {
+      for (int c = 0; c < channels; c++)
+      {
+        int diff = pcm[(start + i) * channels + c] - predictor[c];
+        int step = benchImaSteps[index[c]];
+        int n = diff < 0 ? 8 : 0;
+        diff = diff < 0 ? -diff : diff;
+        for (int bit = 4; bit >= 1; bit >>= 1, step >>= 1)
+        {
+          if (diff >= step)
+          {
+            n |= bit;
+            diff -= step;
+          }
+        }
+        ImaStep(&predictor[c], &index[c], n);
+        // mono packs nibbles in order, stereo 8 nibbles per channel per 8 bytes
+        int k = i - 1;
+        int byte = channels == 1 ? 4 + k / 2 : 8 + (k / 8) * 8 + c * 4 + (k % 8) / 2;
+        block[byte] |= (uint8_t)(n << ((k & 1) * 4));
+      }
+    }
+    bytes += (uint32_t)blockAlign;
+  }
+  return bytes;
+}
+
+// Block at a time decoder, to check the streaming one against
+static int ImaDecode(const uint8_t *data, uint32_t bytes, int channels, int blockAlign, int16_t *out)
+{
+  int perBlock = (blockAlign - 4 * channels) * 2 / channels + 1;
+  int frames = 0;
+  for (uint32_t at = 0; at + (uint32_t)blockAlign <= bytes; at += (uint32_t)blockAlign)
+  {
+    const uint8_t *block = data + at;
+    for (int c = 0; c < channels; c++)
+    {
+      int predictor = (int16_t)(block[c * 4] | block[c * 4 + 1] << 8);
+      int index = block[c * 4 + 2];
+      out[frames * channels + c] = (int16_t)predictor;
+      for (int k = 0; k < perBlock - 1; k++)
+      {
+        int byte = channels == 1 ? 4 + k / 2 : 8 + (k / 8) * 8 + c * 4 + (k % 8) / 2;
+        int n = (block[byte] >> ((k & 1) * 4)) & 15;
+        out[(frames + 1 + k) * channels + c] = (int16_t)ImaStep(&predictor, &index, n);
+      }
+    }
+    frames += perBlock;
+  }
+  return frames;
+}
+
+// Reads a whole stream in uneven chunks, refilling between chunks
+static int ReadWholeStream(vmupro_wav_stream_t *stream, int16_t *out, int maxFrames)
+{
+  static const int chunks[] = {1, 100, 37, 128, 3, 90};
+  int got = 0;
+  for (int c = 0; got < maxFrames && !vmupro_wav_stream_is_finished(stream); c++)
+  {
+    vmupro_wav_stream_update(stream);
+    int n = chunks[c % 6] < maxFrames - got ? chunks[c % 6] : maxFrames - got;
+    got += vmupro_wav_stream_read(stream, out + got * 2, n);
+  }
+  return got;
+}
+
+// PCM and ADPCM, mono and stereo, at and off 44.1kHz, through 512 byte
+// buffers against the whole file decoded at once; then looping,
+// starving, bad files, and real time playback through pull mode
+static int VerifyWavStream(void)
+{
+  int failures = 0;
+  vmupro_host_reset();
+  vmupro_host_set_sdcard_root("/tmp");
+  for (int i = 0; i < STREAM_TONE_FRAMES; i++)
+  {
+    streamTone[i * 2] = (int16_t)lround(12000.0 * sin(i * 0.0627) + 4000.0 * sin(i * 0.31));
+    streamTone[i * 2 + 1] = (int16_t)lround(9000.0 * sin(i * 0.0419 + 1.0));
+  }
+  vmupro_wav_stream_config_t small = vmupro_wav_stream_defaults();
+  small.buffer_bytes = 512;
+  vmupro_wav_stream_info_t info;
+  vmupro_wav_stream_stats_t stats;
+
+  // 16-bit stereo at 44.1kHz comes out unchanged, read from offset 0 to the
+  // end of the data with nothing read twice
+  WriteStreamWav("bench_pcm16.wav", 1, 2, 44100, 16, 4, mixStereo, MIX_STEREO_FRAMES * 4, true);
+  vmupro_wav_stream_t *stream = vmupro_wav_stream_open("/sdcard/bench_pcm16.wav", &small);
+  int got = stream != NULL ? ReadWholeStream(stream, mixGot, MIX_VERIFY_FRAMES) : 0;
+  vmupro_wav_stream_get_info(stream, &info);
+  vmupro_wav_stream_get_stats(stream, &stats);
+  if (stream == NULL || got != MIX_STEREO_FRAMES || info.frames != MIX_STEREO_FRAMES || info.data_offset != 152 ||
+      stats.underruns != 0 || stats.bytes_read != 152 + MIX_STEREO_FRAMES * 4 ||
+      vmupro_wav_stream_update(stream))
+  {
+    printf("MISMATCH wav_stream pcm16: %d frames, %u underruns, %u bytes read\n", got, stats.underruns,
+           stats.bytes_read);
+    failures++;
+  }
+  else
+  {
+    failures += CompareAudio("wav_stream_pcm16", mixGot, mixStereo, MIX_STEREO_FRAMES);
+  }
+  vmupro_wav_stream_close(stream);
+
+  // stereo ADPCM with blocks spanning read buffers
+  uint32_t adpcmBytes = ImaEncode(streamTone, STREAM_TONE_FRAMES, 2, 1024, streamAdpcm);
+  int frames = ImaDecode(streamAdpcm, adpcmBytes, 2, 1024, mixExpected);
+  WriteStreamWav("bench_adpcm.wav", 0x11, 2, 44100, 4, 1024, streamAdpcm, adpcmBytes, true);
+  stream = vmupro_wav_stream_open("/sdcard/bench_adpcm.wav", &small);
+  got = stream != NULL ? ReadWholeStream(stream, mixGot, MIX_VERIFY_FRAMES) : 0;
+  vmupro_wav_stream_get_info(stream, &info);
+  double signal = 0.0, noise = 0.0;
+  for (int i = 0; i < frames * 2; i++)
+  {
+    signal += (double)streamTone[i] * streamTone[i];
+    noise += (double)(mixExpected[i] - streamTone[i]) * (mixExpected[i] - streamTone[i]);
+  }
+  double adpcmSnr = 10.0 * log10(signal / (noise + 1e-9));
+  if (stream == NULL || got != frames || info.frames != (uint32_t)frames || info.encoding != VMUPRO_WAV_IMA_ADPCM ||
+      adpcmSnr < 20.0)
+  {
+    printf("MISMATCH wav_stream adpcm: %d of %d frames, %.1f dB\n", got, frames, adpcmSnr);
+    failures++;
+  }
+  else
+  {
+    failures += CompareAudio("wav_stream_adpcm", mixGot, mixExpected, frames);
+  }
+  vmupro_wav_stream_close(stream);
+
+  // mono ADPCM at 22.05kHz goes through the resampler
+  static int16_t monoTone[STREAM_TONE_FRAMES];
+  static int16_t monoDecoded[STREAM_TONE_FRAMES];
+  static vmupro_resampler_t r;
+  for (int i = 0; i < STREAM_TONE_FRAMES; i++)
+    monoTone[i] = streamTone[i * 2];
+  adpcmBytes = ImaEncode(monoTone, STREAM_TONE_FRAMES, 1, 256, streamAdpcm);
+  frames = ImaDecode(streamAdpcm, adpcmBytes, 1, 256, monoDecoded);
+  vmupro_resampler_init(&r, 22050, 44100, 1, small.quality);
+  int expected = vmupro_resampler_process(&r, monoDecoded, frames, NULL, mixExpected, MIX_VERIFY_FRAMES);
+  expected += vmupro_resampler_flush(&r, mixExpected + expected, MIX_VERIFY_FRAMES - expected);
+  for (int i = expected - 1; i >= 0; i--)
+    mixExpected[i * 2] = mixExpected[i * 2 + 1] = mixExpected[i];
+  WriteStreamWav("bench_adpcm_mono.wav", 0x11, 1, 22050, 4, 256, streamAdpcm, adpcmBytes, false);
+  stream = vmupro_wav_stream_open("/sdcard/bench_adpcm_mono.wav", &small);
+  got = stream != NULL ? ReadWholeStream(stream, mixGot, MIX_VERIFY_FRAMES) : 0;
+  if (got != expected)
+  {
+    printf("MISMATCH wav_stream adpcm mono 22kHz: %d frames, expected %d\n", got, expected);
+    failures++;
+  }
+  else
+  {
+    failures += CompareAudio("wav_stream_adpcm_mono", mixGot, mixExpected, expected);
+  }
+  vmupro_wav_stream_close(stream);
+
+  // 8-bit mono loops seamlessly, at half volume
+  static uint8_t pcm8[300];
+  for (int i = 0; i < 300; i++)
+    pcm8[i] = (uint8_t)(128 + (i * 37) % 200 - 100);
+  WriteStreamWav("bench_pcm8.wav", 1, 1, 44100, 8, 1, pcm8, sizeof(pcm8), false);
+  small.loop = true;
+  stream = vmupro_wav_stream_open("/sdcard/bench_pcm8.wav", &small);
+  vmupro_wav_stream_set_volume(stream, 128);
+  got = stream != NULL ? ReadWholeStream(stream, mixGot, 1000) : 0;
+  vmupro_wav_stream_get_stats(stream, &stats);
+  for (int i = 0; i < 1000; i++)
+    mixExpected[i * 2] = mixExpected[i * 2 + 1] = (int16_t)(((pcm8[i % 300] - 128) << 8) * 128 >> 8);
+  if (got != 1000 || stats.loops < 3 || vmupro_wav_stream_is_finished(stream))
+  {
+    printf("MISMATCH wav_stream loop: %d frames, %u loops\n", got, stats.loops);
+    failures++;
+  }
+  else
+  {
+    failures += CompareAudio("wav_stream_loop", mixGot, mixExpected, 1000);
+  }
+  vmupro_wav_stream_close(stream);
+  small.loop = false;
+
+  // without updates the buffers run dry into silence
+  stream = vmupro_wav_stream_open("/sdcard/bench_pcm16.wav", &small);
+  got = vmupro_wav_stream_read(stream, mixGot, 400);
+  vmupro_wav_stream_get_stats(stream, &stats);
+  bool silent = true;
+  for (int i = got * 2; i < 400 * 2; i++)
+    silent = silent && mixGot[i] == 0;
+  if (got >= 400 || got < 200 || stats.underruns != 1 || !silent)
+  {
+    printf("MISMATCH wav_stream starved: %d frames, %u underruns\n", got, stats.underruns);
+    failures++;
+  }
+  vmupro_wav_stream_close(stream);
+
+  static const uint8_t floatFormat[4] = {0};
+  WriteStreamWav("bench_float.wav", 3, 1, 44100, 32, 4, floatFormat, 4, false);
+  if (vmupro_wav_stream_open("/sdcard/bench_float.wav", NULL) != NULL ||
+      vmupro_wav_stream_open("/sdcard/missing.wav", NULL) != NULL)
+  {
+    printf("MISMATCH wav_stream opened a bad file\n");
+    failures++;
+  }
+
+  // real time through pull mode, the app loop refilling
+  stream = vmupro_wav_stream_open("/sdcard/bench_pcm16.wav", NULL);
+  vmupro_host_audio_capture(mixGot, MIX_VERIFY_FRAMES);
+  bool started = vmupro_wav_stream_play(stream);
+  uint64_t deadline = vmupro_get_time_us() + 5000000;
+  while (started && vmupro_wav_stream_update(stream) && vmupro_get_time_us() < deadline)
+    vmupro_sleep_ms(5);
+  vmupro_sleep_ms(40);
+  vmupro_wav_stream_get_stats(stream, &stats);
+  vmupro_wav_stream_close(stream);
+  got = (int)vmupro_host_audio_captured();
+  vmupro_host_audio_capture(NULL, 0);
+  int first = 0;
+  while (first < got && mixGot[first * 2] == 0 && mixGot[first * 2 + 1] == 0)
+    first++;
+  if (!started || first + MIX_STEREO_FRAMES > got || stats.underruns != 0)
+  {
+    printf("MISMATCH wav_stream play: %d frames captured, %u underruns\n", got - first, stats.underruns);
+    failures++;
+  }
+  else
+  {
+    failures += CompareAudio("wav_stream_play", mixGot + first * 2, mixStereo, MIX_STEREO_FRAMES);
+  }
+  printf("wav stream: ADPCM %.1f dB, %u reads of up to %u bytes, slowest %u us\n", adpcmSnr, stats.reads,
+         vmupro_wav_stream_defaults().buffer_bytes, stats.max_read_us);
+
+  remove("/tmp/bench_pcm16.wav");
+  remove("/tmp/bench_adpcm.wav");
+  remove("/tmp/bench_adpcm_mono.wav");
+  remove("/tmp/bench_pcm8.wav");
+  remove("/tmp/bench_float.wav");
+  vmupro_host_set_sdcard_root(NULL);
+  vmupro_host_reset();
+  return failures;
+}
+
+// Power of one DFT bin of the left channel, by Goertzel
+static double BinPower(const int16_t *stereo, int frames, int bin)
+{
+  const double twoPi = 6.283185307179586;
+  double c = 2.0 * cos(twoPi * bin / frames);
+  double s1 = 0.0, s2 = 0.0;
+  for (int i = 0; i < frames; i++)
+  {
+    double s0 = stereo[i * 2] + c * s1 - s2;
+    s2 = s1;
+    s1 = s0;
+  }
+  return s1 * s1 + s2 * s2 - c * s1 * s2;
+}
+
+#define ALIAS_FRAMES 4410
+#define ALIAS_HZ 3000
+
+// Energy off the harmonics of ALIAS_HZ against the energy on them, in dB.
+// Bins are 10Hz, and with 44.1kHz output every alias of a 3kHz note lands
+// 900Hz or 2100Hz from a harmonic
+static double AliasRatio(const int16_t *stereo)
+{
+  int step = ALIAS_HZ * ALIAS_FRAMES / 44100;
+  double harmonic = 0.0, alias = 0.0;
+  for (int bin = 1; bin < ALIAS_FRAMES / 2; bin++)
+  {
+    double power = BinPower(stereo, ALIAS_FRAMES, bin);
+    if (bin % step == 0)
+      harmonic += power;
+    else
+      alias += power;
+  }
+  return 10.0 * log10(alias / harmonic + 1e-30);
+}
+
+// The same wave without band-limiting
+static void NaiveWave(vmupro_synth_waveform_t waveform, int16_t *stereo, int frames)
+{
+  uint32_t inc = (uint32_t)(((uint64_t)ALIAS_HZ << 32) / 44100);
+  uint32_t p = 0;
+  for (int i = 0; i < frames; i++, p += inc)
+  {
+    int32_t v;
+    if (waveform == VMUPRO_SYNTH_SAWTOOTH)
+      v = (int32_t)(p >> 16) - 32768;
+    else if (waveform == VMUPRO_SYNTH_SQUARE)
+      v = p < 0x80000000u ? 32767 : -32768;
+    else
+      v = p < 0x80000000u ? (int32_t)(p >> 15) - 32768 : 98304 - (int32_t)(p >> 15);
+    stereo[i * 2] = stereo[i * 2 + 1] = (int16_t)(v / 2);
+  }
+}
+
+// Plays the same notes on 4 synths and renders frames frames in chunks
+// of the given sizes, or in one go for a NULL chunks
+static void RenderSynthScene(vmupro_synth_t **s, int16_t *out, int frames, const int *chunks)
+{
+  vmupro_synth_engine_stop();
+  vmupro_synth_engine_start_manual();
+  vmupro_synth_play_note(s[0], 220 << 16, VMUPRO_SYNTH_UNITY, 40);
+  vmupro_synth_play_midi_note(s[1], 81, VMUPRO_SYNTH_UNITY / 2, 70);
+  vmupro_synth_play_midi_note(s[2], 45, VMUPRO_SYNTH_UNITY, 90);
+  vmupro_synth_play_midi_note(s[3], 100, VMUPRO_SYNTH_UNITY, 25);
+  int done = 0;
+  for (int c = 0; done < frames; c++)
+  {
+    int n = chunks == NULL ? frames : chunks[c % 5] < frames - done ? chunks[c % 5] : frames - done;
+    vmupro_synth_engine_render(out + done * 2, n);
+    done += n;
+  }
+}
+
+// Peak level of the left channel over [from, to)
+static int PeakLevel(const int16_t *stereo, int from, int to)
+{
+  int peak = 0;
+  for (int i = from; i < to; i++)
+    peak = abs(stereo[i * 2]) > peak ? abs(stereo[i * 2]) : peak;
+  return peak;
+}
+
+// Aliasing of the band-limited waves against naive ones, the output not
+// depending on how frames are split between renders, the envelope
+// stages, stereo volume, the synth limit and the cost counters
+static int VerifySynth(void)
+{
+  int failures = 0;
+  vmupro_synth_engine_stop();
+  for (int i = 0; i < VMUPRO_SYNTH_MAX; i++)
+  {
+    vmupro_synth_free(benchSynths[i]);
+    benchSynths[i] = NULL;
+  }
+
+  // the band-limited waves at 3kHz, against the naive waves
+  static const vmupro_synth_waveform_t aliased[] = {VMUPRO_SYNTH_SAWTOOTH, VMUPRO_SYNTH_SQUARE, VMUPRO_SYNTH_TRIANGLE};
+  static const char *const aliasedNames[] = {"sawtooth", "square", "triangle"};
+  static const double aliasLimit[] = {-25.0, -29.0, -48.0};
+  double ratio[3], naiveRatio[3];
+  vmupro_synth_engine_start_manual();
+  vmupro_synth_t *synth = vmupro_synth_new(VMUPRO_SYNTH_SAWTOOTH);
+  vmupro_synth_set_volume(synth, VMUPRO_SYNTH_UNITY / 2, VMUPRO_SYNTH_UNITY / 2);
+  for (int w = 0; w < 3; w++)
+  {
+    vmupro_synth_set_waveform(synth, aliased[w]);
+    vmupro_synth_play_note(synth, ALIAS_HZ << 16, VMUPRO_SYNTH_UNITY, -1);
+    vmupro_synth_engine_render(mixGot, 256);
+    vmupro_synth_engine_render(mixGot, ALIAS_FRAMES);
+    ratio[w] = AliasRatio(mixGot);
+    NaiveWave(aliased[w], mixExpected, ALIAS_FRAMES);
+    naiveRatio[w] = AliasRatio(mixExpected);
+    if (ratio[w] > aliasLimit[w] || ratio[w] > naiveRatio[w] - 12.0)
+    {
+      printf("MISMATCH synth %s aliasing %.1f dB, naive %.1f dB\n", aliasedNames[w], ratio[w], naiveRatio[w]);
+      failures++;
+    }
+  }
+  vmupro_synth_stop(synth);
+  vmupro_synth_engine_render(mixGot, VMUPRO_SYNTH_BLOCK_FRAMES);
+  if (vmupro_synth_is_playing(synth))
+  {
+    printf("MISMATCH synth still playing a block after stop\n");
+    failures++;
+  }
+  vmupro_synth_free(synth);
+
+  // any split of the frames renders the same
+  static const int chunks[] = {1, 100, 37, 256, 5};
+  vmupro_synth_t *scene[4];
+  static const vmupro_synth_waveform_t sceneWaves[] = {VMUPRO_SYNTH_PO_DIGITAL, VMUPRO_SYNTH_PO_VOSIM,
+                                                       VMUPRO_SYNTH_PO_PHASE, VMUPRO_SYNTH_NOISE};
+  for (int i = 0; i < 4; i++)
+  {
+    scene[i] = vmupro_synth_new(sceneWaves[i]);
+    vmupro_synth_set_attack(scene[i], 5 + i * 3);
+    vmupro_synth_set_decay(scene[i], 20);
+    vmupro_synth_set_sustain(scene[i], VMUPRO_SYNTH_UNITY / 2);
+    vmupro_synth_set_release(scene[i], 15);
+    vmupro_synth_set_volume(scene[i], VMUPRO_SYNTH_UNITY / 3, VMUPRO_SYNTH_UNITY / 4);
+    vmupro_synth_set_parameter(scene[i], 0, (uint16_t)(60 * i));
+  }
+  RenderSynthScene(scene, mixExpected, 6000, NULL);
+  RenderSynthScene(scene, mixGot, 6000, chunks);
+  failures += CompareAudio("synth_chunked", mixGot, mixExpected, 6000);
+  vmupro_synth_stats_t stats;
+  vmupro_synth_engine_stats_t engine;
+  vmupro_synth_engine_get_stats(&engine);
+  uint64_t synthUs = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    vmupro_synth_get_stats(scene[i], &stats);
+    synthUs += stats.render_us;
+    // two scenes, each note held for its length plus the release
+    static const int lengths[] = {40, 70, 90, 25};
+    uint64_t expectFrames = 2 * (uint64_t)((lengths[i] + 15) * 441 / 10);
+    if (stats.notes != 2 || stats.frames < expectFrames || stats.frames > expectFrames + 2 * 64 ||
+        vmupro_synth_is_playing(scene[i]))
+    {
+      printf("MISMATCH synth %d stats: %u notes, %llu frames (expected about %llu)\n", i, stats.notes,
+             (unsigned long long)stats.frames, (unsigned long long)expectFrames);
+      failures++;
+    }
+  }
+  if (engine.peak_synths != 4 || engine.frames != 6000 || PeakLevel(mixGot, 5000, 6000) != 0)
+  {
+    printf("MISMATCH synth engine stats: peak %u synths, %llu frames\n", engine.peak_synths,
+           (unsigned long long)engine.frames);
+    failures++;
+  }
+  for (int i = 0; i < 4; i++)
+    vmupro_synth_free(scene[i]);
+
+  // envelope stages: 10ms attack, 10ms decay to half, held 50ms, 20ms release
+  synth = vmupro_synth_new(VMUPRO_SYNTH_SQUARE);
+  vmupro_synth_set_attack(synth, 10);
+  vmupro_synth_set_decay(synth, 10);
+  vmupro_synth_set_sustain(synth, VMUPRO_SYNTH_UNITY / 2);
+  vmupro_synth_set_release(synth, 20);
+  vmupro_synth_set_volume(synth, VMUPRO_SYNTH_UNITY / 2, 0);
+  vmupro_synth_play_note(synth, 100 << 16, VMUPRO_SYNTH_UNITY, 50);
+  vmupro_synth_engine_render(mixGot, 5000);
+  int attack = PeakLevel(mixGot, 0, 200), full = PeakLevel(mixGot, 400, 480), held = PeakLevel(mixGot, 1000, 2200);
+  int released = PeakLevel(mixGot, 2300, 2500), after = PeakLevel(mixGot, 3150, 5000);
+  bool rightSilent = true;
+  for (int i = 0; i < 5000; i++)
+    rightSilent = rightSilent && mixGot[i * 2 + 1] == 0;
+  if (attack > 8500 || full < 15500 || abs(held - 8192) > 200 || released >= held || released < 1000 || after != 0 ||
+      !rightSilent || vmupro_synth_is_playing(synth))
+  {
+    printf("MISMATCH synth envelope: attack %d, full %d, held %d, released %d, after %d\n", attack, full, held,
+           released, after);
+    failures++;
+  }
+  vmupro_synth_free(synth);
+
+  // the synth limit, and MIDI tuning
+  vmupro_synth_t *all[VMUPRO_SYNTH_MAX];
+  int created = 0;
+  for (int i = 0; i < VMUPRO_SYNTH_MAX; i++)
+    created += (all[i] = vmupro_synth_new(VMUPRO_SYNTH_SINE)) != NULL;
+  bool full33 = vmupro_synth_new(VMUPRO_SYNTH_SINE) == NULL;
+  vmupro_synth_free(all[7]);
+  all[7] = vmupro_synth_new(VMUPRO_SYNTH_SINE);
+  if (created != VMUPRO_SYNTH_MAX || !full33 || all[7] == NULL || vmupro_synth_midi_frequency(69) != 440u << 16 ||
+      vmupro_synth_midi_frequency(60) >> 8 != (uint32_t)lround(261.6256 * 256))
+  {
+    printf("MISMATCH synth allocation: %d created\n", created);
+    failures++;
+  }
+  for (int i = 0; i < VMUPRO_SYNTH_MAX; i++)
+    vmupro_synth_free(all[i]);
+  vmupro_synth_engine_stop();
+
+  printf("synth: 3kHz aliasing sawtooth %.1f dB (naive %.1f), square %.1f dB (naive %.1f), triangle %.1f dB "
+         "(naive %.1f)\n",
+         ratio[0], naiveRatio[0], ratio[1], naiveRatio[1], ratio[2], naiveRatio[2]);
+  return failures;
+}
+
+// Three tracks at 96 ticks a quarter note: tempo changes, a text event and
+// an end of track early on the first; a monophonic line with a program
+// change, note offs as zero velocity note ons under running status and a
+// sysex on the second; chords and a control change on the third
+#define SEQ_DIVISION 96
+#define SEQ_FRAMES 100000
+static const SmfEvent seqConductor[] = {
+    {0, 6, {0xff, 0x51, 0x03, 0x03, 0xd0, 0x90}},
+    {10, 5, {0xff, 0x01, 0x02, 'h', 'i'}},
+    {96, 6, {0xff, 0x51, 0x03, 0x03, 0x0d, 0x40}},
+    {192, 6, {0xff, 0x51, 0x03, 0x04, 0xab, 0xcb}},
+};
+static const SmfEvent seqLead[] = {
+    {0, 2, {0xc0, 5}},           {0, 3, {0x90, 60, 100}},  {40, 3, {0x90, 60, 0}},
+    {48, 3, {0x90, 64, 80}},     {60, 6, {0xf0, 0x04, 0x7e, 0x7f, 0x09, 0xf7}},
+    {90, 3, {0x80, 64, 0}},      {96, 3, {0x90, 67, 127}}, {150, 3, {0x80, 67, 64}},
+    {192, 3, {0x90, 72, 48}},    {250, 3, {0x80, 72, 0}},
+};
+static const SmfEvent seqChords[] = {
+    {96, 3, {0x91, 72, 96}},  {96, 3, {0x91, 76, 96}},  {100, 3, {0x91, 79, 96}},
+    {120, 3, {0xb1, 7, 100}}, {180, 3, {0x81, 72, 0}},  {180, 3, {0x81, 76, 0}},
+    {192, 3, {0x91, 48, 64}}, {200, 3, {0x81, 79, 0}},  {270, 3, {0x81, 48, 0}},
+};
+// microseconds per quarter note from each tick on
+static const uint32_t seqTempo[][2] = {{0, 250000}, {96, 200000}, {192, 306123}};
+#define SEQ_END_TICK 288
+
+static uint8_t seqFile[1024];
+static int16_t seqGot[SEQ_FRAMES * 2];
+static int16_t seqExpected[SEQ_FRAMES * 2];
+
+typedef struct
+{
+  uint32_t tick, frame;
+  int track, order;
+  vmupro_sequence_event_t event;
+} SeqRef;
+
+// The frame of a tick, worked out in floating point from the tempo table
+static uint32_t SeqFrame(uint32_t tick)
+{
+  double seconds = 0.0;
+  for (int i = 0; i < 3; i++)
+  {
+    uint32_t from = seqTempo[i][0], to = i < 2 ? seqTempo[i + 1][0] : UINT32_MAX;
+    if (tick > from)
+      seconds += (double)((tick < to ? tick : to) - from) * seqTempo[i][1] / (SEQ_DIVISION * 1e6);
+  }
+  return (uint32_t)lround(seconds * VMUPRO_SYNTH_RATE);
+}
+
+static int CompareSeqRef(const void *a, const void *b)
+{
+  const SeqRef *x = a, *y = b;
+  if (x->tick != y->tick)
+    return x->tick < y->tick ? -1 : 1;
+  return x->track != y->track ? x->track - y->track : x->order - y->order;
+}
+
+// The events the file should compile to, in time order
+static int BuildSeqRef(SeqRef *out)
+{
+  const SmfEvent *tracks[] = {seqLead, seqChords};
+  const int counts[] = {sizeof(seqLead) / sizeof(seqLead[0]), sizeof(seqChords) / sizeof(seqChords[0])};
+  int n = 0;
+  for (int t = 0; t < 2; t++)
+  {
+    for (int i = 0; i < counts[t]; i++)
+    {
+      const SmfEvent *e = &tracks[t][i];
+      uint8_t type = e->bytes[0] & 0xf0;
+      int kind;
+      if (type == 0x90 && e->bytes[2] > 0)
+        kind = VMUPRO_SEQUENCE_NOTE_ON;
+      else if (type == 0x80 || type == 0x90)
+        kind = VMUPRO_SEQUENCE_NOTE_OFF;
+      else if (type == 0xc0)
+        kind = VMUPRO_SEQUENCE_PROGRAM;
+      else
+        continue;
+      bool program = kind == VMUPRO_SEQUENCE_PROGRAM;
+      out[n] = (SeqRef){e->tick, SeqFrame(e->tick), t + 1, i,
+                        {0, (uint8_t)(t + 1), (uint8_t)kind, program ? 0 : e->bytes[1],
+                         program ? e->bytes[1] : e->bytes[2]}};
+      n++;
+    }
+  }
+  qsort(out, (size_t)n, sizeof(out[0]), CompareSeqRef);
+  return n;
+}
+
+// Renders in chunks of the given sizes, or in one go for a NULL chunks
+static void RenderChunks(int16_t *out, int frames, const int *chunks)
+{
+  int done = 0;
+  for (int c = 0; done < frames; c++)
+  {
+    int n = chunks == NULL ? frames : chunks[c % 5] < frames - done ? chunks[c % 5] : frames - done;
+    vmupro_synth_engine_render(out + done * 2, n);
+    done += n;
+  }
+}
+
+static int FirstSound(const int16_t *stereo, int frames)
+{
+  int i = 0;
+  while (i < frames && stereo[i * 2] == 0 && stereo[i * 2 + 1] == 0)
+    i++;
+  return i;
+}
+
+// The compiled events against the tempo map worked out in floating point,
+// notes starting on the same frames as notes played by hand, the output
+// not depending on how frames are split between renders, and a looping
+// sequence played in real time under a game loop with uneven frames
+static int VerifySequence(void)
+{
+  int failures = 0;
+  vmupro_synth_engine_stop();
+  uint32_t size = WriteSmfHeader(seqFile, 3, SEQ_DIVISION);
+  size += WriteSmfTrack(seqFile + size, seqConductor, 4, 192);
+  size += WriteSmfTrack(seqFile + size, seqLead, sizeof(seqLead) / sizeof(seqLead[0]), 250);
+  size += WriteSmfTrack(seqFile + size, seqChords, sizeof(seqChords) / sizeof(seqChords[0]), SEQ_END_TICK);
+  vmupro_sequence_t *seq = vmupro_sequence_new_from_memory(seqFile, size);
+  SeqRef refs[32];
+  int refCount = BuildSeqRef(refs);
+  uint32_t count = 0;
+  const vmupro_sequence_event_t *events = vmupro_sequence_get_events(seq, &count);
+  uint32_t length = vmupro_sequence_get_length(seq);
+  if (seq == NULL || count != (uint32_t)refCount + 1 || length != SeqFrame(SEQ_END_TICK) ||
+      vmupro_sequence_get_track_count(seq) != 3 || vmupro_sequence_get_track_polyphony(seq, 1) != 1 ||
+      vmupro_sequence_get_track_polyphony(seq, 2) != 3 || vmupro_sequence_get_track_program(seq, 1) != 5 ||
+      vmupro_sequence_get_track_program(seq, 2) != -1)
+  {
+    printf("MISMATCH sequence compiled to %u events over %u frames, expected %d over %u\n", count, length,
+           refCount + 1, SeqFrame(SEQ_END_TICK));
+    vmupro_sequence_free(seq);
+    return 1;
+  }
+  uint32_t frame = 0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    frame += events[i].delta_frames;
+    const vmupro_sequence_event_t *e = &events[i];
+    bool end = i == count - 1;
+    const vmupro_sequence_event_t *x = end ? NULL : &refs[i].event;
+    if (end ? e->kind != VMUPRO_SEQUENCE_END || frame != length
+            : frame != refs[i].frame || e->track != x->track || e->kind != x->kind || e->note != x->note ||
+                e->value != x->value)
+    {
+      printf("MISMATCH sequence event %u: frame %u, track %u, kind %u, note %u, value %u\n", i, frame, e->track,
+             e->kind, e->note, e->value);
+      failures++;
+      break;
+    }
+  }
+
+  // the lead line on one synth against the same notes played by hand,
+  // each render ending on a note's frame; the chords have no synths
+  vmupro_synth_t *lead = vmupro_synth_new(VMUPRO_SYNTH_SQUARE);
+  vmupro_synth_set_attack(lead, 2);
+  vmupro_synth_set_release(lead, 10);
+  vmupro_synth_set_volume(lead, VMUPRO_SYNTH_UNITY / 2, VMUPRO_SYNTH_UNITY / 3);
+  vmupro_sequence_set_track_synths(seq, 1, &lead, 1);
+  int total = (int)length + 2000;
+  vmupro_synth_engine_start_manual();
+  vmupro_sequence_play(seq);
+  vmupro_synth_engine_render(seqGot, total);
+  vmupro_sequence_stats_t stats;
+  vmupro_sequence_get_stats(seq, &stats);
+  bool ended = !vmupro_sequence_is_playing(seq);
+  vmupro_synth_engine_stop();
+  vmupro_synth_engine_start_manual();
+  int done = 0;
+  for (int i = 0; i < refCount; i++)
+  {
+    const vmupro_sequence_event_t *x = &refs[i].event;
+    if (x->track != 1 || x->kind == VMUPRO_SEQUENCE_PROGRAM)
+      continue;
+    vmupro_synth_engine_render(seqExpected + done * 2, (int)refs[i].frame - done);
+    done = (int)refs[i].frame;
+    if (x->kind == VMUPRO_SEQUENCE_NOTE_ON)
+      vmupro_synth_play_note(lead, vmupro_synth_midi_frequency(x->note),
+                             (uint16_t)((x->value * VMUPRO_SYNTH_UNITY + 63) / 127), -1);
+    else
+      vmupro_synth_note_off(lead);
+  }
+  vmupro_synth_engine_render(seqExpected + done * 2, total - done);
+  failures += CompareAudio("sequence_by_hand", seqGot, seqExpected, total);
+  if (!ended || stats.dispatched != count || stats.notes_dropped != 4 || stats.late != 0 || stats.loops != 0)
+  {
+    printf("MISMATCH sequence stats: %u dispatched, %u dropped, %u late, %s\n", stats.dispatched,
+           stats.notes_dropped, stats.late, ended ? "ended" : "still playing");
+    failures++;
+  }
+
+  // the chords on three synths, looping, in one render and in uneven chunks
+  static const int chunks[] = {1, 100, 37, 256, 5};
+  vmupro_synth_t *pad[3];
+  for (int i = 0; i < 3; i++)
+  {
+    pad[i] = vmupro_synth_new(VMUPRO_SYNTH_TRIANGLE);
+    vmupro_synth_set_release(pad[i], 30);
+    vmupro_synth_set_volume(pad[i], VMUPRO_SYNTH_UNITY / 4, VMUPRO_SYNTH_UNITY / 4);
+  }
+  vmupro_sequence_set_track_synths(seq, 2, pad, 3);
+  vmupro_sequence_set_looping(seq, true);
+  int looped = (int)length * 5 / 2;
+  int chord = (int)SeqFrame(110);
+  vmupro_synth_engine_stop();
+  vmupro_synth_engine_start_manual();
+  vmupro_sequence_play(seq);
+  vmupro_synth_engine_render(seqExpected, chord);
+  int leadNotes = vmupro_sequence_get_track_notes_active(seq, 1);
+  int chordNotes = vmupro_sequence_get_track_notes_active(seq, 2);
+  vmupro_synth_engine_render(seqExpected + chord * 2, looped - chord);
+  vmupro_sequence_stop(seq);
+  vmupro_synth_engine_stop();
+  vmupro_synth_engine_start_manual();
+  vmupro_sequence_play(seq);
+  RenderChunks(seqGot, looped, chunks);
+  failures += CompareAudio("sequence_chunked", seqGot, seqExpected, looped);
+  vmupro_sequence_get_stats(seq, &stats);
+  if (leadNotes != 1 || chordNotes != 3 || stats.loops != 4 || stats.notes_stolen != 0 || stats.late != 0)
+  {
+    printf("MISMATCH sequence looping: %d/%d notes active, %u loops, %u stolen\n", leadNotes, chordNotes,
+           stats.loops, stats.notes_stolen);
+    failures++;
+  }
+  vmupro_sequence_stop(seq);
+  vmupro_synth_engine_stop();
+
+  // real time through pull mode: the game loop busy for up to 15ms a
+  // frame, then asleep for up to 7ms, against the same two passes rendered
+  // offline
+  vmupro_synth_engine_start_manual();
+  vmupro_sequence_play(seq);
+  vmupro_synth_engine_render(seqExpected, SEQ_FRAMES);
+  vmupro_sequence_stop(seq);
+  vmupro_synth_engine_stop();
+  vmupro_sequence_stats_t before;
+  vmupro_sequence_get_stats(seq, &before);
+  vmupro_host_audio_capture(seqGot, SEQ_FRAMES);
+  bool started = vmupro_sequence_play(seq);
+  uint64_t deadline = vmupro_get_time_us() + 5000000;
+  uint32_t lcg = 1;
+  stats = before;
+  while (started && stats.loops < before.loops + 2 && vmupro_get_time_us() < deadline)
+  {
+    lcg = lcg * 1103515245u + 12345u;
+    uint64_t busyUntil = vmupro_get_time_us() + (lcg >> 16) % 15000;
+    while (vmupro_get_time_us() < busyUntil)
+    {
+    }
+    vmupro_sleep_ms((int)((lcg >> 8) % 8));
+    vmupro_sequence_get_stats(seq, &stats);
+  }
+  vmupro_sleep_ms(100);
+  vmupro_sequence_stop(seq);
+  vmupro_synth_engine_stop();
+  int got = (int)vmupro_host_audio_captured();
+  vmupro_host_audio_capture(NULL, 0);
+  int offset = FirstSound(seqGot, got) - FirstSound(seqExpected, SEQ_FRAMES);
+  if (!started || offset < 0 || offset + 2 * (int)length > got || stats.late != before.late)
+  {
+    printf("MISMATCH sequence play: %d frames captured, %u loops, %u late\n", got, stats.loops - before.loops,
+           stats.late - before.late);
+    failures++;
+  }
+  else
+  {
+    failures += CompareAudio("sequence_play", seqGot + offset * 2, seqExpected, 2 * (int)length);
+  }
+
+  vmupro_sequence_free(seq);
+
+  // a manual engine rendered from the game loop: stop and free let go of
+  // the sequence at once rather than waiting for a render, even while a
+  // pull mode task that doesn't render the engine is running
+  vmupro_audio_pull_start(NULL, PullSilence, NULL);
+  vmupro_synth_engine_start_manual();
+  seq = vmupro_sequence_new_from_memory(seqFile, size);
+  vmupro_sequence_set_track_synths(seq, 1, &lead, 1);
+  bool played = vmupro_sequence_play(seq);
+  vmupro_synth_engine_render(seqGot, 256);
+  vmupro_sequence_stop(seq);
+  bool stopped = !vmupro_sequence_is_playing(seq) && vmupro_sequence_get_track_notes_active(seq, 1) == 0;
+  bool replayed = vmupro_sequence_play(seq);
+  vmupro_synth_engine_render(seqGot, 256);
+  vmupro_sequence_free(seq);
+  vmupro_synth_engine_stop();
+  vmupro_audio_pull_stop();
+  if (!played || !stopped || !replayed)
+  {
+    printf("MISMATCH sequence manual engine: played %d, stopped %d, replayed %d\n", played, stopped, replayed);
+    failures++;
+  }
+
+  vmupro_synth_free(lead);
+  for (int i = 0; i < 3; i++)
+    vmupro_synth_free(pad[i]);
+
+#ifdef VMUPRO_EXAMPLES_DIR
+  // the example song: every track merged, its length and number of events
+  // as worked out separately from the file
+  vmupro_host_set_sdcard_root(VMUPRO_EXAMPLES_DIR "/nested_example/assets");
+  seq = vmupro_sequence_new("/sdcard/settlers.mid");
+  vmupro_host_set_sdcard_root(NULL);
+  events = vmupro_sequence_get_events(seq, &count);
+  uint32_t notes = 0;
+  frame = 0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    frame += events[i].delta_frames;
+    notes += events[i].kind == VMUPRO_SEQUENCE_NOTE_ON;
+  }
+  if (seq == NULL || vmupro_sequence_get_track_count(seq) != 8 || count != 1724 || notes != 858 ||
+      events[count - 1].kind != VMUPRO_SEQUENCE_END || frame != 2654391 || frame != vmupro_sequence_get_length(seq))
+  {
+    printf("MISMATCH sequence settlers.mid: %u events\n", count);
+    failures++;
+  }
+  else
+  {
+    printf("sequence: settlers.mid %u events, %u notes, %.1f s\n", count, notes,
+           (double)frame / VMUPRO_SYNTH_RATE);
+  }
+  vmupro_sequence_free(seq);
+#endif
+
+  printf("sequence: drift %d us after %u loops in real time\n", stats.drift_us, stats.loops - before.loops);
+  vmupro_host_reset();
+  return failures;
+}
+
+#define INST_RENDER 40000
+static int16_t instStereo[INST_FRAMES * 2];
+static int16_t instGot[INST_RENDER * 2];
+static int16_t instExpected[INST_RENDER * 2];
+static int16_t instLevels[3][64];
+
+// One voice worked out frame by frame: linear interpolation, the loop,
+// and the release ramp from frame releaseAt on
+static void RefInstrumentVoice(const int16_t *pcm, uint32_t frames, int channels, uint32_t step, int32_t gain,
+                     uint32_t loopStart, uint32_t loopEnd, int releaseAt, int32_t releaseStep, int16_t *out, int n)
+{
+  memset(out, 0, (size_t)n * 2 * sizeof(int16_t));
+  uint64_t pos = 0;
+  int32_t env = 65536, release = 0;
+  for (int f = 0; f < n; f++)
+  {
+    if (f == releaseAt)
+      release = releaseStep;
+    while (loopEnd != 0 && pos >> 16 >= loopEnd)
+      pos -= (uint64_t)(loopEnd - loopStart) << 16;
+    uint32_t i = (uint32_t)(pos >> 16);
+    if (i >= frames)
+      break;
+    uint32_t next = loopEnd != 0 && i + 1 == loopEnd ? loopStart : i + 1 < frames ? i + 1 : i;
+    int32_t frac = (int32_t)((pos & 0xffff) >> 1);
+    for (int c = 0; c < 2; c++)
+    {
+      int ch = c < channels ? c : 0;
+      int32_t a = pcm[i * channels + ch], b = pcm[next * channels + ch];
+      int32_t x = a + (((b - a) * frac) >> 15);
+      if (env < 65536)
+        x = (x * (env >> 1)) >> 15;
+      x = (x * gain) >> 8;
+      out[f * 2 + c] = (int16_t)(x > 32767 ? 32767 : x < -32768 ? -32768 : x);
+    }
+    pos += step;
+    env -= release;
+    if (env <= 0)
+      break;
+  }
+}
+
+// The step the instrument should use, checked against the equal
+// tempered ratio in floating point
+static uint32_t InstrumentStep(int note, int root, uint32_t rate, int *failures)
+{
+  uint64_t ratio = ((uint64_t)vmupro_synth_midi_frequency(note) << 16) / vmupro_synth_midi_frequency(root);
+  uint32_t step = (uint32_t)((ratio * rate + 22050) / 44100);
+  double exact = pow(2.0, (note - root) / 12.0) * rate / 44100.0 * 65536.0;
+  if (fabs(step - exact) > exact * 1e-4)
+  {
+    printf("MISMATCH instrument step %d from %d: %u, expected %.1f\n", note, root, step, exact);
+    (*failures)++;
+  }
+  return step;
+}
+
+static inline int32_t VelocityGain(int velocity)
+{
+  return (VMUPRO_SYNTH_UNITY * ((velocity * VMUPRO_SYNTH_UNITY + 63) / 127)) >> 8;
+}
+
+// Plays notes on a fresh instrument over one looped level per zone, and
+// returns the left level after 32 frames
+static int InstrumentLevel(vmupro_instrument_t *inst, const int *notes, const int *velocities, int count,
+                           const int *offs)
+{
+  vmupro_instrument_stop(inst);
+  for (int i = 0; i < count; i++)
+  {
+    if (offs != NULL && offs[i])
+      vmupro_instrument_note_off(inst, notes[i]);
+    else
+      vmupro_instrument_play_note(inst, notes[i], velocities[i]);
+    vmupro_synth_engine_render(instGot, 32);
+  }
+  return instGot[31 * 2];
+}
+
+static uint32_t HashAudio(const int16_t *stereo, int frames)
+{
+  uint32_t h = 2166136261u;
+  for (int i = 0; i < frames * 2; i++)
+    h = (h ^ (uint16_t)stereo[i]) * 16777619u;
+  return h;
+}
+
+// Interpolation, loops and release against a frame by frame model, a
+// streamed zone against the same sample resident and starved of reads,
+// zone selection by key and velocity, each steal policy and its
+// counters, and a sequence track played on an instrument
+static int VerifyInstrument(void)
+{
+  int failures = 0;
+  static const int chunks[] = {1, 100, 37, 256, 5};
+  vmupro_synth_engine_stop();
+  vmupro_synth_engine_start_manual();
+  InstrumentTone(instMono, INST_FRAMES, 7);
+  InstrumentTone(instStereo, INST_FRAMES * 2, 11);
+
+  // mono, pitched up a fifth, released after 8000 frames; stereo at
+  // 22050Hz, pitched down, looping until its release
+  vmupro_sound_sample_t mono, stereo;
+  vmupro_sound_sample_init(&mono, instMono, INST_FRAMES, 1, 44100);
+  vmupro_sound_sample_init(&stereo, instStereo, INST_FRAMES, 2, 22050);
+  vmupro_instrument_t *inst = vmupro_instrument_new(2);
+  vmupro_instrument_zone_t zone = vmupro_instrument_zone_defaults();
+  zone.key_low = 60;
+  zone.release_ms = 10;
+  vmupro_instrument_add_zone(inst, &mono, &zone);
+  zone = vmupro_instrument_zone_defaults();
+  zone.key_high = 59;
+  zone.loop_start = 1000;
+  zone.loop_end = 3000;
+  zone.release_ms = 100;
+  vmupro_instrument_add_zone(inst, &stereo, &zone);
+
+  vmupro_instrument_play_note(inst, 67, 100);
+  RenderChunks(instGot, 8000, chunks);
+  vmupro_instrument_note_off(inst, 67);
+  RenderChunks(instGot + 8000 * 2, INST_RENDER - 8000, chunks);
+  RefInstrumentVoice(instMono, INST_FRAMES, 1, InstrumentStep(67, 60, 44100, &failures), VelocityGain(100), 0, 0, 8000,
+           65536 / 441, instExpected, INST_RENDER);
+  failures += CompareAudio("instrument_release", instGot, instExpected, INST_RENDER);
+
+  vmupro_instrument_play_note(inst, 55, 127);
+  RenderChunks(instGot, 20000, chunks);
+  vmupro_instrument_note_off(inst, 55);
+  RenderChunks(instGot + 20000 * 2, INST_RENDER - 20000, chunks);
+  RefInstrumentVoice(instStereo, INST_FRAMES, 2, InstrumentStep(55, 60, 22050, &failures), VelocityGain(127), 1000, 3000,
+           20000, 65536 / 4410, instExpected, INST_RENDER);
+  failures += CompareAudio("instrument_loop", instGot, instExpected, INST_RENDER);
+  int left = vmupro_instrument_get_active_voices(inst);
+  vmupro_instrument_free(inst);
+
+  // the mono sample streamed from a file with a 3000 frame head, refilled
+  // after each period, then starved
+  const char *path = "/tmp/vmupro_bench_instrument.wav";
+  WriteInstrumentWav(path, instMono, INST_FRAMES, 1, 44100);
+  inst = vmupro_instrument_new(1);
+  zone = vmupro_instrument_zone_defaults();
+  bool added = vmupro_instrument_add_streamed_zone(inst, path, 3000, &zone);
+  vmupro_instrument_play_note(inst, 67, 100);
+  for (int done = 0; done < INST_RENDER; done += VMUPRO_SYNTH_PERIOD_FRAMES)
+  {
+    int n = INST_RENDER - done < VMUPRO_SYNTH_PERIOD_FRAMES ? INST_RENDER - done : VMUPRO_SYNTH_PERIOD_FRAMES;
+    vmupro_synth_engine_render(instGot + done * 2, n);
+    vmupro_instrument_update(inst);
+  }
+  RefInstrumentVoice(instMono, INST_FRAMES, 1, InstrumentStep(67, 60, 44100, &failures), VelocityGain(100), 0, 0, -1, 0,
+           instExpected, INST_RENDER);
+  failures += CompareAudio("instrument_streamed", instGot, instExpected, INST_RENDER);
+  vmupro_instrument_stats_t stats;
+  vmupro_instrument_get_stats(inst, &stats);
+  // the head is rounded up to 3252 frames, so the tail starts at byte 6656
+  uint32_t tail = (INST_FRAMES - 3252) * 2;
+  uint32_t reads = (tail + VMUPRO_INSTRUMENT_STREAM_BYTES - 1) / VMUPRO_INSTRUMENT_STREAM_BYTES;
+  if (!added || left != 0 || stats.stream_reads != reads || stats.stream_bytes != tail || stats.underruns != 0 ||
+      stats.resident_bytes != 3252 * 2 + 2 * VMUPRO_INSTRUMENT_STREAM_BYTES)
+  {
+    printf("MISMATCH instrument stream: %u reads, %u bytes, %u underruns, %u resident, %d left sounding\n",
+           stats.stream_reads, stats.stream_bytes, stats.underruns, stats.resident_bytes, left);
+    failures++;
+  }
+  vmupro_instrument_play_note(inst, 67, 100);
+  vmupro_synth_engine_render(instGot, INST_RENDER);
+  vmupro_instrument_get_stats(inst, &stats);
+  if (stats.underruns != 1 || vmupro_instrument_get_active_voices(inst) != 0 ||
+      FirstSound(instGot + 2200 * 2, INST_RENDER - 2200) != INST_RENDER - 2200)
+  {
+    printf("MISMATCH instrument starved: %u underruns\n", stats.underruns);
+    failures++;
+  }
+  vmupro_instrument_free(inst);
+  remove(path);
+
+  // zones by key and velocity over flat levels, pitched or not
+  vmupro_sound_sample_t level[3];
+  for (int z = 0; z < 3; z++)
+  {
+    for (int i = 0; i < 64; i++)
+      instLevels[z][i] = (int16_t)(1000 * (z + 1));
+    vmupro_sound_sample_init(&level[z], instLevels[z], 64, 1, 44100);
+  }
+  inst = vmupro_instrument_new(4);
+  zone = vmupro_instrument_zone_defaults();
+  zone.loop_end = 64;
+  zone.key_high = 59;
+  zone.velocity_high = 63;
+  vmupro_instrument_add_zone(inst, &level[0], &zone);
+  zone.velocity_low = 64;
+  zone.velocity_high = 127;
+  vmupro_instrument_add_zone(inst, &level[1], &zone);
+  zone = vmupro_instrument_zone_defaults();
+  zone.loop_end = 64;
+  zone.key_low = zone.key_high = 60;
+  zone.root_key = VMUPRO_INSTRUMENT_FIXED_PITCH;
+  vmupro_instrument_add_zone(inst, &level[2], &zone);
+  static const int zoneNotes[] = {40, 40, 60, 61};
+  static const int zoneVelocities[] = {63, 64, 127, 100};
+  static const int zoneLevels[] = {1000, 2000, 3000, 0};
+  for (int i = 0; i < 4; i++)
+  {
+    int got = InstrumentLevel(inst, &zoneNotes[i], &zoneVelocities[i], 1, NULL);
+    int expected = (zoneLevels[i] * VelocityGain(zoneVelocities[i])) >> 8;
+    if (got != expected)
+    {
+      printf("MISMATCH instrument zone for note %d velocity %d: level %d, expected %d\n", zoneNotes[i],
+             zoneVelocities[i], got, expected);
+      failures++;
+    }
+  }
+  vmupro_instrument_get_stats(inst, &stats);
+  if (stats.notes != 3 || stats.notes_unmapped != 1)
+  {
+    printf("MISMATCH instrument zone counters: %u notes, %u unmapped\n", stats.notes, stats.notes_unmapped);
+    failures++;
+  }
+  vmupro_instrument_free(inst);
+
+  // two voices and a third note: the oldest and the quietest lose their
+  // voice; with same note, a repeated note retriggers its own voice and a
+  // released voice goes before a held one
+  static const int stealNotes[] = {60, 62, 64, 60, 60, 60, 62, 64};
+  static const int stealVelocities[] = {127, 40, 127, 127, 40, 0, 127, 127};
+  static const int stealOffs[] = {0, 0, 0, 0, 0, 1, 0, 0};
+  for (int policy = VMUPRO_INSTRUMENT_STEAL_OLDEST; policy <= VMUPRO_INSTRUMENT_STEAL_SAME_NOTE; policy++)
+  {
+    inst = vmupro_instrument_new(2);
+    zone = vmupro_instrument_zone_defaults();
+    zone.loop_end = 64;
+    zone.root_key = VMUPRO_INSTRUMENT_FIXED_PITCH;
+    zone.release_ms = 1000;
+    vmupro_instrument_add_zone(inst, &level[0], &zone);
+    vmupro_instrument_set_steal_policy(inst, (vmupro_instrument_steal_t)policy);
+    bool same = policy == VMUPRO_INSTRUMENT_STEAL_SAME_NOTE;
+    int got = same ? InstrumentLevel(inst, stealNotes + 3, stealVelocities + 3, 5, stealOffs + 3)
+                   : InstrumentLevel(inst, stealNotes, stealVelocities, 3, NULL);
+    // what is left: 62 and 64, 60 and 64, or 62 and 64 after 60's release was cut off
+    int32_t kept = policy == VMUPRO_INSTRUMENT_STEAL_QUIETEST ? VelocityGain(127) : VelocityGain(same ? 127 : 40);
+    int expected = (1000 * kept >> 8) + (1000 * VelocityGain(127) >> 8);
+    vmupro_instrument_get_stats(inst, &stats);
+    if (got != expected || stats.steals_held != (same ? 0u : 1u) || stats.steals_released != (same ? 1u : 0u) ||
+        stats.retriggers != (same ? 1u : 0u) || stats.peak_voices != 2)
+    {
+      printf("MISMATCH instrument steal policy %d: level %d, expected %d; %u held, %u released, %u retriggers\n",
+             policy, got, expected, stats.steals_held, stats.steals_released, stats.retriggers);
+      failures++;
+    }
+    vmupro_instrument_free(inst);
+  }
+
+  // the sequence test's lead line on an instrument, against the same
+  // notes played by hand
+  uint32_t size = WriteSmfHeader(seqFile, 3, SEQ_DIVISION);
+  size += WriteSmfTrack(seqFile + size, seqConductor, 4, 192);
+  size += WriteSmfTrack(seqFile + size, seqLead, sizeof(seqLead) / sizeof(seqLead[0]), 250);
+  size += WriteSmfTrack(seqFile + size, seqChords, sizeof(seqChords) / sizeof(seqChords[0]), SEQ_END_TICK);
+  vmupro_sequence_t *seq = vmupro_sequence_new_from_memory(seqFile, size);
+  SeqRef refs[32];
+  int refCount = BuildSeqRef(refs);
+  inst = vmupro_instrument_new(4);
+  zone = vmupro_instrument_zone_defaults();
+  zone.loop_start = 1000;
+  zone.loop_end = INST_FRAMES;
+  zone.release_ms = 30;
+  vmupro_instrument_add_zone(inst, &mono, &zone);
+  vmupro_sequence_set_track_instrument(seq, 1, inst);
+  int total = (int)vmupro_sequence_get_length(seq) + 2000;
+  vmupro_synth_engine_stop();
+  vmupro_synth_engine_start_manual();
+  vmupro_sequence_play(seq);
+  RenderChunks(instGot, total, chunks);
+  vmupro_sequence_stats_t seqStats;
+  vmupro_sequence_get_stats(seq, &seqStats);
+  vmupro_synth_engine_stop();
+  vmupro_synth_engine_start_manual();
+  vmupro_instrument_stop(inst);
+  int done = 0;
+  for (int i = 0; i < refCount; i++)
+  {
+    const vmupro_sequence_event_t *x = &refs[i].event;
+    if (x->track != 1 || x->kind == VMUPRO_SEQUENCE_PROGRAM)
+      continue;
+    vmupro_synth_engine_render(instExpected + done * 2, (int)refs[i].frame - done);
+    done = (int)refs[i].frame;
+    if (x->kind == VMUPRO_SEQUENCE_NOTE_ON)
+      vmupro_instrument_play_note(inst, x->note, x->value);
+    else
+      vmupro_instrument_note_off(inst, x->note);
+  }
+  vmupro_synth_engine_render(instExpected + done * 2, total - done);
+  failures += CompareAudio("instrument_sequence", instGot, instExpected, total);
+  if (seqStats.notes_dropped != 4 || seqStats.late != 0 || vmupro_sequence_get_track_notes_active(seq, 1) != 0)
+  {
+    printf("MISMATCH instrument sequence: %u dropped, %u late\n", seqStats.notes_dropped, seqStats.late);
+    failures++;
+  }
+  vmupro_synth_engine_stop();
+  vmupro_sequence_free(seq);
+  vmupro_instrument_free(inst);
+
+#ifdef VMUPRO_EXAMPLES_DIR
+  // an example orchestral sample streamed with the default head, period
+  // by period against the whole file loaded
+  const char *clarinet = VMUPRO_EXAMPLES_DIR "/nested_example/assets/clarinet.wav";
+  vmupro_sound_sample_t *whole = vmupro_sound_sample_new(clarinet);
+  vmupro_instrument_t *resident = vmupro_instrument_new(1);
+  vmupro_instrument_t *streamed = vmupro_instrument_new(1);
+  zone = vmupro_instrument_zone_defaults();
+  vmupro_instrument_add_zone(resident, whole, &zone);
+  added = vmupro_instrument_add_streamed_zone(streamed, clarinet, 0, &zone);
+  vmupro_synth_engine_start_manual();
+  int periods = whole != NULL ? (int)(whole->frames / VMUPRO_SYNTH_PERIOD_FRAMES) + 2 : 0;
+  uint32_t *hashes = calloc((size_t)periods + 1, sizeof(uint32_t));
+  int differ = -1;
+  for (int pass = 0; pass < 2 && added && hashes != NULL; pass++)
+  {
+    vmupro_instrument_play_note(pass == 0 ? resident : streamed, 60, 127);
+    for (int i = 0; i < periods; i++)
+    {
+      vmupro_synth_engine_render(instGot, VMUPRO_SYNTH_PERIOD_FRAMES);
+      vmupro_instrument_update(streamed);
+      uint32_t h = HashAudio(instGot, VMUPRO_SYNTH_PERIOD_FRAMES);
+      if (pass == 0)
+        hashes[i] = h;
+      else if (h != hashes[i] && differ < 0)
+        differ = i;
+    }
+  }
+  vmupro_instrument_get_stats(streamed, &stats);
+  uint32_t fileBytes = whole != NULL ? whole->frames * 2 : 0;
+  if (!added || hashes == NULL || differ >= 0 || stats.underruns != 0 || stats.resident_bytes * 3 > fileBytes)
+  {
+    printf("MISMATCH instrument clarinet.wav: period %d differs, %u underruns, %u bytes resident\n", differ,
+           stats.underruns, stats.resident_bytes);
+    failures++;
+  }
+  else
+  {
+    printf("instrument: clarinet.wav streamed with %u KB of %u KB resident, %u reads\n", stats.resident_bytes / 1024,
+           fileBytes / 1024, stats.stream_reads);
+  }
+  free(hashes);
+  vmupro_synth_engine_stop();
+  vmupro_instrument_free(resident);
+  vmupro_instrument_free(streamed);
+  vmupro_sound_sample_free(whole);
+#endif
+
+  vmupro_synth_engine_stop();
+  vmupro_host_reset();
+  return failures;
+}
+
+int RunAudioVerify(void)
+{
+  int failures = VerifyMixer();
+  failures += VerifyAudioPull();
+  failures += VerifyResampler();
+  failures += VerifyRateControl();
+  failures += VerifyWavStream();
+  failures += VerifySynth();
+  failures += VerifySequence();
+  failures += VerifyInstrument();
+  return failures;
+}
@@ -0,0 +1,1069 @@
+// tools/hostsim/bench/verify_display.c
+//
+// bench_display --verify checks for the display API: the vectorized
+// paths against their scalar equivalents with every flip and at every
+// screen edge, RLE and indexed colour sprites against the colour keyed
+// blit, tilemaps against per tile blits and indexed atlas tilemaps
+// against their RGB565 expansion, display list replays and split
+// rendering against immediate drawing, partial display updates against
+// full redraws with two and three buffers, and frame pacing
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vmupro_sdk.h"
+#include "vmupro_host.h"
+#include "bench.h"
+
+uint16_t reference[240 * 240];
+
+static const int edgePositions[] = {-70, -64, -33, -1, 0, 3, 101, 176, 203, 232, 239, 240};
+#define NUM_EDGES ((int)(sizeof(edgePositions) / sizeof(edgePositions[0])))
+
+int CompareWithReference(const char *what, int x, int y, int w, int h, int flags)
+{
+  const uint16_t *fb = (const uint16_t *)vmupro_get_back_buffer();
+  for (int i = 0; i < 240 * 240; i++)
+  {
+    if (fb[i] != reference[i])
+    {
+      printf("MISMATCH %s %dx%d at %d,%d flags %d: first diff at pixel %d,%d\n", what, w, h, x, y, flags, i % 240, i / 240);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Vector row kernel vs scalar kernel, all flip combinations and edge clips
+static int VerifyTransparent(void)
+{
+  // odd sizes exercise the 16/8 pixel groups and the scalar tail
+  static const int sizes[][2] = {{64, 64}, {37, 23}, {16, 5}, {8, 8}, {7, 3}, {1, 1}};
+  int failures = 0;
+
+  for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+  {
+    for (int flags = 0; flags < 4; flags++)
+    {
+      for (int xi = 0; xi < NUM_EDGES; xi++)
+      {
+        for (int yi = 0; yi < NUM_EDGES; yi++)
+        {
+          int x = edgePositions[xi];
+          int y = edgePositions[yi];
+          int w = sizes[s][0];
+          int h = sizes[s][1];
+
+          vmupro_host_set_scalar_kernels(true);
+          vmupro_display_clear(VMUPRO_COLOR_NAVY);
+          vmupro_blit_buffer_transparent((uint8_t *)sprite, x, y, w, h, VMUPRO_COLOR_MAGENTA, (vmupro_drawflags_t)flags);
+          memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+
+          vmupro_host_set_scalar_kernels(false);
+          vmupro_display_clear(VMUPRO_COLOR_NAVY);
+          vmupro_blit_buffer_transparent((uint8_t *)sprite, x, y, w, h, VMUPRO_COLOR_MAGENTA, (vmupro_drawflags_t)flags);
+          failures += CompareWithReference("blit_buffer_transparent", x, y, w, h, flags);
+        }
+      }
+    }
+  }
+  return failures;
+}
+
+// An RLE sprite must draw exactly what the colour keyed blit does
+static int VerifyRle(void)
+{
+  static const int sizes[][2] = {{64, 64}, {37, 23}, {7, 3}, {1, 1}};
+  static uint32_t encoded[SPRITE_SIZE * SPRITE_SIZE];
+  int failures = 0;
+  int rawBytes = 0;
+  int rleBytes = 0;
+
+  for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+  {
+    int w = sizes[s][0];
+    int h = sizes[s][1];
+    int size = vmupro_rle_encode((uint8_t *)sprite, w, h, VMUPRO_COLOR_MAGENTA, (uint8_t *)encoded, sizeof(encoded));
+    if (size < 0 || size != vmupro_rle_encode((uint8_t *)sprite, w, h, VMUPRO_COLOR_MAGENTA, NULL, 0))
+    {
+      printf("MISMATCH rle_encode %dx%d: bad size %d\n", w, h, size);
+      failures++;
+      continue;
+    }
+    rawBytes += w * h * 2;
+    rleBytes += size;
+
+    for (int flags = 0; flags < 4; flags++)
+    {
+      for (int xi = 0; xi < NUM_EDGES; xi++)
+      {
+        for (int yi = 0; yi < NUM_EDGES; yi++)
+        {
+          int x = edgePositions[xi];
+          int y = edgePositions[yi];
+
+          vmupro_display_clear(VMUPRO_COLOR_NAVY);
+          vmupro_blit_buffer_transparent((uint8_t *)sprite, x, y, w, h, VMUPRO_COLOR_MAGENTA, (vmupro_drawflags_t)flags);
+          memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+
+          vmupro_display_clear(VMUPRO_COLOR_NAVY);
+          vmupro_blit_rle((uint8_t *)encoded, x, y, (vmupro_drawflags_t)flags);
+          failures += CompareWithReference("blit_rle", x, y, w, h, flags);
+        }
+      }
+    }
+  }
+
+  printf("rle sprites: %d bytes raw, %d bytes encoded (%.0f%%)\n", rawBytes, rleBytes, 100.0 * rleBytes / rawBytes);
+  return failures;
+}
+
+// Indexed blits must match the RGB565 equivalent of the same image
+static int VerifyIndexed(void)
+{
+  static uint8_t odd4[VMUPRO_INDEXED_HEADER_SIZE + 19 * 23];
+  static uint16_t expanded[BG_SIZE * BG_SIZE];
+  const uint8_t *images[] = {sprite8, sprite4, odd4};
+  int failures = 0;
+
+  MakeIndexed(odd4, 37, 23, 4, Index4);
+
+  for (int i = 0; i < 3; i++)
+  {
+    int w, h;
+    vmupro_indexed_get_info(images[i], &w, &h, NULL);
+    ExpandIndexed(images[i], expanded, 0, VMUPRO_COLOR_MAGENTA);
+
+    for (int flags = 0; flags < 4; flags++)
+    {
+      for (int xi = 0; xi < NUM_EDGES; xi++)
+      {
+        for (int yi = 0; yi < NUM_EDGES; yi++)
+        {
+          int x = edgePositions[xi];
+          int y = edgePositions[yi];
+
+          vmupro_display_clear(VMUPRO_COLOR_NAVY);
+          vmupro_blit_buffer_transparent((uint8_t *)expanded, x, y, w, h, VMUPRO_COLOR_MAGENTA, (vmupro_drawflags_t)flags);
+          memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+          vmupro_display_clear(VMUPRO_COLOR_NAVY);
+          vmupro_blit_indexed(images[i], indexedPalette, x, y, 0, (vmupro_drawflags_t)flags);
+          failures += CompareWithReference("blit_indexed", x, y, w, h, flags);
+
+          // an odd sized region out of the middle, as an atlas tile
+          vmupro_display_clear(VMUPRO_COLOR_NAVY);
+          vmupro_blit_tile_advanced((uint8_t *)expanded, x, y, 3, 5, 13, 11, w, VMUPRO_COLOR_MAGENTA, (vmupro_drawflags_t)flags);
+          memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+          vmupro_display_clear(VMUPRO_COLOR_NAVY);
+          vmupro_blit_indexed_region(images[i], indexedPalette, x, y, 3, 5, 13, 11, 0, (vmupro_drawflags_t)flags);
+          failures += CompareWithReference("blit_indexed_region", x, y, 13, 11, flags);
+        }
+      }
+    }
+  }
+
+  static const int scrolls[] = {0, 1, 17, 255, 256, 1000, -1, -300, -100001};
+  ExpandIndexed(layer8, expanded, VMUPRO_INDEXED_OPAQUE, 0);
+  for (int xi = 0; xi < 9; xi++)
+  {
+    for (int yi = 0; yi < 9; yi++)
+    {
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      vmupro_blit_scrolling_background((uint8_t *)expanded, BG_SIZE, BG_SIZE, scrolls[xi], scrolls[yi], 240, 240);
+      memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      vmupro_render_indexed_layer(layer8, indexedPalette, scrolls[xi], scrolls[yi], VMUPRO_INDEXED_OPAQUE);
+      failures += CompareWithReference("render_indexed_layer", scrolls[xi], scrolls[yi], BG_SIZE, BG_SIZE, 0);
+    }
+  }
+  return failures;
+}
+
+// One vmupro_blit_tile_advanced per visible cell
+static void ReferenceTilemap(const vmupro_tilemap_t *tm, int scrollX, int scrollY)
+{
+  int c0 = scrollX >= 0 ? scrollX / 16 : -((-scrollX + 15) / 16);
+  int r0 = scrollY >= 0 ? scrollY / 16 : -((-scrollY + 15) / 16);
+  for (int r = r0; r * 16 - scrollY < 240; r++)
+  {
+    for (int c = c0; c * 16 - scrollX < 240; c++)
+    {
+      int cr = r;
+      int cc = c;
+      if (tm->wrap)
+      {
+        cr = ((r % tm->map_height) + tm->map_height) % tm->map_height;
+        cc = ((c % tm->map_width) + tm->map_width) % tm->map_width;
+      }
+      else if (r < 0 || r >= tm->map_height || c < 0 || c >= tm->map_width)
+      {
+        continue;
+      }
+
+      int cell = cr * tm->map_width + cc;
+      int t, flags;
+      if (tm->entry_size == 1)
+      {
+        t = ((const uint8_t *)tm->map)[cell];
+        flags = tm->attributes ? tm->attributes[cell] : 0;
+      }
+      else
+      {
+        uint16_t e = ((const uint16_t *)tm->map)[cell];
+        t = e & VMUPRO_TILE_INDEX_MASK;
+        flags = (e & VMUPRO_TILE_FLIP_H ? VMUPRO_DRAWFLAGS_FLIP_H : 0) | (e & VMUPRO_TILE_FLIP_V ? VMUPRO_DRAWFLAGS_FLIP_V : 0);
+      }
+      if (t == tm->empty_tile)
+        continue;
+      vmupro_blit_tile_advanced((uint8_t *)tm->atlas, c * 16 - scrollX, r * 16 - scrollY, (t % 8) * 16, (t / 8) * 16, 16, 16,
+                                ATLAS_W, (vmupro_color_t)tm->transparent_color, (vmupro_drawflags_t)flags);
+    }
+  }
+}
+
+// Tilemaps must match drawing every cell with vmupro_blit_tile_advanced,
+// and a tilemap layer must match rendering the tilemap directly
+static int VerifyTilemap(void)
+{
+  static const int scrolls[] = {0, 7, -5, 16, -33, 200, 437, -1000};
+  int failures = 0;
+
+  vmupro_tilemap_t variants[6];
+  variants[0] = tilemap;
+  variants[1] = tilemap;
+  variants[1].row_classes = tileRowClasses;
+  variants[2] = tilemap;
+  variants[2].wrap = true;
+  variants[3] = variants[1];
+  variants[3].transparent_color = -1;
+  variants[4] = tilemap;
+  variants[4].map = tileMap8;
+  variants[4].entry_size = 1;
+  variants[4].attributes = tileAttributes;
+  variants[4].wrap = true;
+  variants[5] = variants[4];
+  variants[5].row_classes = tileRowClasses;
+  variants[5].empty_tile = -1;
+
+  for (int v = 0; v < 6; v++)
+  {
+    for (int xi = 0; xi < 8; xi++)
+    {
+      for (int yi = 0; yi < 8; yi++)
+      {
+        vmupro_display_clear(VMUPRO_COLOR_NAVY);
+        ReferenceTilemap(&variants[v], scrolls[xi], scrolls[yi]);
+        memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+
+        vmupro_display_clear(VMUPRO_COLOR_NAVY);
+        vmupro_tilemap_render(&variants[v], scrolls[xi], scrolls[yi], 0, 0, 240, 240);
+        failures += CompareWithReference("tilemap_render", scrolls[xi], scrolls[yi], v, 0, 0);
+
+        vmupro_layer_set_tilemap(0, &variants[v]);
+        vmupro_layer_set_scroll(0, scrolls[xi], scrolls[yi]);
+        vmupro_display_clear(VMUPRO_COLOR_NAVY);
+        vmupro_render_all_layers();
+        vmupro_layer_set_tilemap(0, NULL);
+        failures += CompareWithReference("layer_set_tilemap", scrolls[xi], scrolls[yi], v, 0, 0);
+      }
+    }
+  }
+  tilemap.row_classes = NULL;
+  return failures;
+}
+
+// A tilemap over an indexed atlas must match the same tilemap over the
+// RGB565 expansion of the atlas, keyed on the transparent index, drawn
+// directly or as a layer with alpha
+static int VerifyTilemapIndexed(void)
+{
+  static const int scrolls[] = {0, 7, -5, 16, -33, 437};
+  static uint16_t expanded[ATLAS_W * ATLAS_H];
+  static uint8_t indexedClasses[32 * 16];
+  static uint8_t expandedClasses[32 * 16];
+  const uint8_t *atlases[2] = {tileAtlas8, tileAtlas4};
+  int failures = 0;
+
+  for (int v = 0; v < 8; v++)
+  {
+    vmupro_tilemap_t got = tilemap;
+    got.atlas = atlases[v & 1];
+    got.atlas_width = 0;
+    got.palette = indexedPalette;
+    got.transparent_color = (v & 4) ? -1 : 0;
+    got.wrap = (v & 2) != 0;
+    if (v >= 6)
+    {
+      got.map = tileMap8;
+      got.entry_size = 1;
+      got.attributes = tileAttributes;
+    }
+
+    vmupro_tilemap_t want = got;
+    ExpandIndexed(got.atlas, expanded, got.transparent_color, VMUPRO_COLOR_MAGENTA);
+    want.atlas = (uint8_t *)expanded;
+    want.atlas_width = ATLAS_W;
+    want.palette = NULL;
+    want.transparent_color = (v & 4) ? -1 : VMUPRO_COLOR_MAGENTA;
+    if (v & 2)
+    {
+      vmupro_tilemap_classify_rows(&got, indexedClasses, sizeof(indexedClasses));
+      vmupro_tilemap_classify_rows(&want, expandedClasses, sizeof(expandedClasses));
+      got.row_classes = indexedClasses;
+      want.row_classes = expandedClasses;
+      if (memcmp(indexedClasses, expandedClasses, sizeof(indexedClasses)) != 0)
+      {
+        printf("MISMATCH tilemap_classify_rows indexed variant %d\n", v);
+        failures++;
+      }
+    }
+
+    for (int xi = 0; xi < 6; xi++)
+    {
+      for (int yi = 0; yi < 6; yi++)
+      {
+        for (int layer = 0; layer < 2; layer++)
+        {
+          vmupro_tilemap_t *maps[2] = {&want, &got};
+          for (int m = 0; m < 2; m++)
+          {
+            vmupro_display_clear(VMUPRO_COLOR_NAVY);
+            if (layer)
+            {
+              vmupro_layer_set_tilemap(0, maps[m]);
+              vmupro_layer_set_scroll(0, scrolls[xi], scrolls[yi]);
+              vmupro_layer_set_alpha(0, 160);
+              vmupro_render_all_layers();
+              vmupro_layer_set_tilemap(0, NULL);
+            }
+            else
+            {
+              vmupro_tilemap_render(maps[m], scrolls[xi], scrolls[yi], 0, 0, 240, 240);
+            }
+            if (m == 0)
+              memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+          }
+          failures += CompareWithReference(layer ? "layer_set_tilemap indexed" : "tilemap_render indexed",
+                                           scrolls[xi], scrolls[yi], v, 0, 0);
+        }
+      }
+    }
+  }
+  return failures;
+}
+
+// The span copier must match sampling the tile at (x + scroll) mod size
+// for every pixel, for any scroll and for tiles narrower or wider than
+// the screen
+static int VerifyInfiniteBackground(void)
+{
+  static const int sizes[][2] = {{TILE_SIZE, TILE_SIZE}, {16, 16}, {7, 3}, {1, 1}, {240, 17}, {300, 10}};
+  static const int scrolls[] = {0, 5, -1, -65, 1000000007, -999999};
+  static const int dests[][2] = {{240, 240}, {100, 37}};
+  int failures = 0;
+
+  for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+  {
+    int tw = sizes[s][0];
+    int th = sizes[s][1];
+    for (int si = 0; si < 6 * 6; si++)
+    {
+      int sx = scrolls[si % 6];
+      int sy = scrolls[si / 6];
+      for (int d = 0; d < 2; d++)
+      {
+        vmupro_display_clear(VMUPRO_COLOR_NAVY);
+        memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+        for (int y = 0; y < dests[d][1]; y++)
+        {
+          for (int x = 0; x < dests[d][0]; x++)
+          {
+            int tx = (int)((((int64_t)x + sx) % tw + tw) % tw);
+            int ty = (int)((((int64_t)y + sy) % th + th) % th);
+            reference[y * 240 + x] = tile[ty * tw + tx];
+          }
+        }
+
+        vmupro_blit_infinite_scrolling_background((uint8_t *)tile, tw, th, sx, sy, dests[d][0], dests[d][1]);
+        failures += CompareWithReference("blit_infinite_scrolling_background", sx, sy, tw, th, d);
+      }
+    }
+  }
+  return failures;
+}
+
+// Each raster scanline must match the same row of a full frame rendered
+// with that line's scroll offsets and layer enables, then remapped
+static int VerifyRaster(void)
+{
+  static vmupro_raster_line_t lines[240];
+  static const int baseScroll[2][2] = {{13, -7}, {-40, 300}};
+  int failures = 0;
+
+  vmupro_host_reset();
+  vmupro_layer_create(0, BG_SIZE, BG_SIZE);
+  vmupro_layer_blit_background(0, (uint8_t *)background, BG_SIZE, BG_SIZE);
+  vmupro_tilemap_t map = tilemap;
+  map.row_classes = tileRowClasses;
+  map.wrap = true;
+  vmupro_layer_set_tilemap(1, &map);
+
+  for (int pass = 0; pass < 2; pass++)
+  {
+    uint8_t alpha = pass == 0 ? 255 : 128;
+    vmupro_layer_set_alpha(0, alpha);
+    vmupro_layer_set_alpha(1, alpha);
+    for (int l = 0; l < 2; l++)
+      vmupro_layer_set_scroll(l, baseScroll[l][0], baseScroll[l][1]);
+
+    // no table, no callback: identical to vmupro_render_all_layers()
+    vmupro_display_clear(VMUPRO_COLOR_NAVY);
+    vmupro_render_all_layers();
+    memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+    vmupro_display_clear(VMUPRO_COLOR_NAVY);
+    vmupro_render_layers_raster(NULL, NULL, NULL, NULL, 0);
+    failures += CompareWithReference("render_layers_raster defaults", 0, 0, 240, 240, pass);
+
+    for (int y = 0; y < 240; y++)
+    {
+      int mask = y % 5 == 0 ? 0 : (y % 5 == 1 ? 1 : (y % 5 == 2 ? 2 : VMUPRO_RASTER_ALL_LAYERS));
+      lines[y] = (vmupro_raster_line_t){(int16_t)((y * 37) % 301 - 150), (int16_t)((y * 11) % 97 - 48 - y),
+                                        (uint8_t)(y % 3), (uint8_t)mask};
+
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      for (int l = 0; l < 2; l++)
+      {
+        vmupro_layer_set_scroll(l, baseScroll[l][0] + lines[y].scroll_x, baseScroll[l][1] + lines[y].scroll_y);
+        vmupro_layer_set_alpha(l, (mask & (1 << l)) ? alpha : 0);
+      }
+      vmupro_render_all_layers();
+      const uint16_t *row = (const uint16_t *)vmupro_get_back_buffer() + y * 240;
+      for (int x = 0; x < 240; x++)
+      {
+        uint16_t c = row[x];
+        if (lines[y].palette != 0)
+        {
+          const vmupro_raster_palette_t *p = &rasterPalettes[lines[y].palette - 1];
+          uint16_t n = (uint16_t)((c >> 8) | (c << 8));
+          n = (uint16_t)((p->r[n >> 11] << 11) | (p->g[(n >> 5) & 0x3f] << 5) | p->b[n & 0x1f]);
+          c = (uint16_t)((n >> 8) | (n << 8));
+        }
+        reference[y * 240 + x] = c;
+      }
+    }
+    for (int l = 0; l < 2; l++)
+    {
+      vmupro_layer_set_scroll(l, baseScroll[l][0], baseScroll[l][1]);
+      vmupro_layer_set_alpha(l, alpha);
+    }
+
+    vmupro_display_clear(VMUPRO_COLOR_NAVY);
+    vmupro_render_layers_raster(lines, NULL, NULL, rasterPalettes, 2);
+    failures += CompareWithReference("render_layers_raster table", 0, 0, 240, 240, pass);
+
+    vmupro_display_clear(VMUPRO_COLOR_NAVY);
+    vmupro_render_layers_raster(NULL, RasterFromTable, lines, rasterPalettes, 2);
+    failures += CompareWithReference("render_layers_raster callback", 0, 0, 240, 240, pass);
+  }
+
+  // fade endpoints
+  vmupro_raster_palette_t fade;
+  vmupro_raster_palette_fade(&fade, VMUPRO_COLOR_WHITE, 0);
+  for (int i = 0; i < 64; i++)
+  {
+    if (fade.g[i] != i || (i < 32 && (fade.r[i] != i || fade.b[i] != i)))
+    {
+      printf("MISMATCH raster_palette_fade amount 0 at %d\n", i);
+      failures++;
+      break;
+    }
+  }
+  vmupro_raster_palette_fade(&fade, VMUPRO_COLOR_WHITE, 255);
+  if (fade.r[0] != 31 || fade.g[0] != 63 || fade.b[0] != 31)
+  {
+    printf("MISMATCH raster_palette_fade amount 255\n");
+    failures++;
+  }
+
+  vmupro_host_reset();
+  return failures;
+}
+
+// Nearest sampling by brute force over the whole screen: every pixel
+// centre mapped back through the inverse matrix, drawn if inside
+static void ReferenceAffine(const uint16_t *region, int stride, int w, int h, const vmupro_affine_t *m)
+{
+  int64_t det = (int64_t)m->a * m->d - (int64_t)m->b * m->c;
+  int64_t ia = ((int64_t)m->d << 32) / det;
+  int64_t ib = ((int64_t)-m->b << 32) / det;
+  int64_t ic = ((int64_t)-m->c << 32) / det;
+  int64_t id = ((int64_t)m->a << 32) / det;
+  for (int y = 0; y < 240; y++)
+  {
+    for (int x = 0; x < 240; x++)
+    {
+      int64_t px = ((int64_t)x << 16) + 0x8000 - m->tx;
+      int64_t py = ((int64_t)y << 16) + 0x8000 - m->ty;
+      int64_t u = (ia * px + ib * py) >> 16;
+      int64_t v = (ic * px + id * py) >> 16;
+      if (u >= 0 && v >= 0 && u < ((int64_t)w << 16) && v < ((int64_t)h << 16))
+        reference[y * 240 + x] = region[(v >> 16) * stride + (u >> 16)];
+    }
+  }
+}
+
+// The affine blit must reproduce the dedicated blits for the transforms
+// they cover, and the brute force reference for everything else
+static int VerifyAffine(void)
+{
+  enum
+  {
+    W = 37,
+    H = 23,
+    SX = 5,
+    SY = 9
+  };
+  static uint16_t odd[W * H];
+  const uint16_t *region = sprite + SY * SPRITE_SIZE + SX;
+  for (int y = 0; y < H; y++)
+    memcpy(odd + y * W, region + y * SPRITE_SIZE, W * 2);
+
+  int failures = 0;
+  const int one = 0x10000;
+  for (int xi = 0; xi < NUM_EDGES; xi++)
+  {
+    for (int yi = 0; yi < NUM_EDGES; yi++)
+    {
+      int x = edgePositions[xi];
+      int y = edgePositions[yi];
+
+      // translation, nearest and bilinear
+      vmupro_affine_t m = {one, 0, x * one, 0, one, y * one};
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      vmupro_blit_buffer_at((uint8_t *)odd, x, y, W, H);
+      memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+      for (int sample = 0; sample < 2; sample++)
+      {
+        vmupro_display_clear(VMUPRO_COLOR_NAVY);
+        vmupro_blit_buffer_affine((uint8_t *)sprite, SPRITE_SIZE, SX, SY, W, H, &m, (vmupro_sample_mode_t)sample, -1, 255);
+        failures += CompareWithReference("blit_buffer_affine translate", x, y, W, H, sample);
+      }
+
+      // alpha
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      vmupro_blit_buffer_blended((uint8_t *)odd, x, y, W, H, 100);
+      memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      vmupro_blit_buffer_affine((uint8_t *)sprite, SPRITE_SIZE, SX, SY, W, H, &m, VMUPRO_SAMPLE_NEAREST, -1, 100);
+      failures += CompareWithReference("blit_buffer_affine alpha", x, y, W, H, 0);
+
+      // flips with a colour key
+      for (int flags = 0; flags < 4; flags++)
+      {
+        vmupro_affine_t f = {(flags & 1) ? -one : one, 0, (x + ((flags & 1) ? W : 0)) * one,
+                             0, (flags & 2) ? -one : one, (y + ((flags & 2) ? H : 0)) * one};
+        vmupro_display_clear(VMUPRO_COLOR_NAVY);
+        vmupro_blit_buffer_transparent((uint8_t *)odd, x, y, W, H, VMUPRO_COLOR_MAGENTA, (vmupro_drawflags_t)flags);
+        memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+        vmupro_display_clear(VMUPRO_COLOR_NAVY);
+        vmupro_blit_buffer_affine((uint8_t *)sprite, SPRITE_SIZE, SX, SY, W, H, &f, VMUPRO_SAMPLE_NEAREST,
+                                  VMUPRO_COLOR_MAGENTA, 255);
+        failures += CompareWithReference("blit_buffer_affine flip", x, y, W, H, flags);
+      }
+
+      // quarter turns, clockwise
+      vmupro_affine_t turns[3] = {{0, -one, (x + H) * one, one, 0, y * one},
+                                  {-one, 0, (x + W) * one, 0, -one, (y + H) * one},
+                                  {0, one, x * one, -one, 0, (y + W) * one}};
+      for (int r = 0; r < 3; r++)
+      {
+        vmupro_display_clear(VMUPRO_COLOR_NAVY);
+        vmupro_blit_buffer_rotated_90((uint8_t *)odd, x, y, W, H, r + 1);
+        memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+        vmupro_display_clear(VMUPRO_COLOR_NAVY);
+        vmupro_blit_buffer_affine((uint8_t *)sprite, SPRITE_SIZE, SX, SY, W, H, &turns[r], VMUPRO_SAMPLE_NEAREST, -1, 255);
+        failures += CompareWithReference("blit_buffer_affine rotate_90", x, y, W, H, r + 1);
+      }
+
+      // integer zoom
+      vmupro_affine_t zoom = {2 * one, 0, x * one, 0, 2 * one, y * one};
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      vmupro_blit_buffer_scaled((uint8_t *)odd, W, 0, 0, W, H, x, y, W * 2, H * 2);
+      memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      vmupro_blit_buffer_affine((uint8_t *)sprite, SPRITE_SIZE, SX, SY, W, H, &zoom, VMUPRO_SAMPLE_NEAREST, -1, 255);
+      failures += CompareWithReference("blit_buffer_affine zoom", x, y, W * 2, H * 2, 0);
+    }
+  }
+
+  // arbitrary rotation, scale and shear against the brute force reference
+  static const int32_t zooms[] = {0x8000, 0x10000, 0x1b333, 0x40000, -0x14000};
+  for (int angle = 0; angle < 360; angle += 37)
+  {
+    for (int z = 0; z < 5; z++)
+    {
+      for (int pos = 0; pos < 4; pos++)
+      {
+        int cx = pos == 0 ? 120 : (pos == 1 ? -10 : (pos == 2 ? 235 : 60));
+        int cy = pos == 3 ? 250 : 100 + pos * 20;
+        vmupro_affine_t m;
+        vmupro_affine_rotate_scale(&m, angle << 16, zooms[z], zooms[(z + angle) % 5], (W << 15) + 0x1234,
+                                   H << 15, cx << 16, (cy << 16) + 0x4000);
+        m.b += (angle & 1) ? 0x3000 : 0; // shear
+        vmupro_display_clear(VMUPRO_COLOR_NAVY);
+        memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+        ReferenceAffine(region, SPRITE_SIZE, W, H, &m);
+        vmupro_blit_buffer_affine((uint8_t *)sprite, SPRITE_SIZE, SX, SY, W, H, &m, VMUPRO_SAMPLE_NEAREST, -1, 255);
+        failures += CompareWithReference("blit_buffer_affine rotozoom", cx, cy, angle, z, pos);
+      }
+    }
+  }
+  return failures;
+}
+
+// A 1:1 scaled blit must land exactly where vmupro_blit_buffer_at does
+static int VerifyScaledIdentity(void)
+{
+  int failures = 0;
+  for (int xi = 0; xi < NUM_EDGES; xi++)
+  {
+    for (int yi = 0; yi < NUM_EDGES; yi++)
+    {
+      int x = edgePositions[xi];
+      int y = edgePositions[yi];
+
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      vmupro_blit_buffer_at((uint8_t *)sprite, x, y, SPRITE_SIZE, SPRITE_SIZE);
+      memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      vmupro_blit_buffer_scaled((uint8_t *)sprite, SPRITE_SIZE, 0, 0, SPRITE_SIZE, SPRITE_SIZE, x, y, SPRITE_SIZE, SPRITE_SIZE);
+      failures += CompareWithReference("blit_buffer_scaled_1x", x, y, SPRITE_SIZE, SPRITE_SIZE, 0);
+    }
+  }
+  return failures;
+}
+
+// Frame n of a scene with a static background, a moving sprite and a
+// small HUD counter
+static void SpritePos(int frame, int *x, int *y)
+{
+  *x = -20 + (frame * 7) % 260;
+  *y = 30 + (frame * 3) % 200;
+}
+
+static void DrawHud(int frame)
+{
+  vmupro_draw_fill_rect(4, 4, 4 + (frame % 40), 11, VMUPRO_COLOR_YELLOW);
+  vmupro_draw_fill_rect(5 + (frame % 40), 4, 44, 11, VMUPRO_COLOR_NAVY);
+}
+
+// Partial updates must leave the panel identical to full redraws,
+// including on frames where the back buffer relies on copy-forward
+static int VerifyPartialUpdates(void)
+{
+  enum
+  {
+    FRAMES = 90
+  };
+  static uint16_t fullPanel[FRAMES][240 * 240];
+  int failures = 0;
+
+  vmupro_host_reset();
+  vmupro_start_double_buffer_renderer();
+  for (int f = 0; f < FRAMES; f++)
+  {
+    int x, y;
+    SpritePos(f, &x, &y);
+    vmupro_blit_scrolling_background((uint8_t *)background, BG_SIZE, BG_SIZE, 0, 0, 240, 240);
+    vmupro_blit_buffer_transparent((uint8_t *)sprite, x, y, SPRITE_SIZE, SPRITE_SIZE, VMUPRO_COLOR_MAGENTA, VMUPRO_DRAWFLAGS_NORMAL);
+    DrawHud(f);
+    vmupro_push_double_buffer_frame();
+    memcpy(fullPanel[f], vmupro_host_get_panel(), sizeof(fullPanel[f]));
+  }
+  vmupro_host_stats_t full;
+  vmupro_host_get_stats(&full);
+
+  // with three buffers and a slow panel frames queue up, so the new back
+  // buffer is sometimes two frames behind
+  static const bool triple[] = {false, true};
+  vmupro_host_stats_t partial[2];
+  for (int t = 0; t < 2; t++)
+  {
+    vmupro_host_reset();
+    vmupro_start_double_buffer_renderer();
+    vmupro_set_partial_update_mode(true);
+    vmupro_set_triple_buffering(triple[t]);
+    if (triple[t])
+      vmupro_host_set_panel_transfer_time(2000);
+    for (int f = 0; f < FRAMES; f++)
+    {
+      int x, y;
+      SpritePos(f, &x, &y);
+      if (f == 0)
+      {
+        vmupro_blit_scrolling_background((uint8_t *)background, BG_SIZE, BG_SIZE, 0, 0, 240, 240);
+      }
+      else
+      {
+        // restore the background under last frame's sprite
+        int px, py;
+        SpritePos(f - 1, &px, &py);
+        int cx = px < 0 ? 0 : px;
+        int cy = py < 0 ? 0 : py;
+        vmupro_blit_tile((uint8_t *)background, cx, cy, cx, cy, px + SPRITE_SIZE - cx, py + SPRITE_SIZE - cy, BG_SIZE);
+      }
+      vmupro_blit_buffer_transparent((uint8_t *)sprite, x, y, SPRITE_SIZE, SPRITE_SIZE, VMUPRO_COLOR_MAGENTA, VMUPRO_DRAWFLAGS_NORMAL);
+      DrawHud(f);
+      vmupro_push_double_buffer_frame();
+      if (memcmp(fullPanel[f], vmupro_host_get_panel(), sizeof(fullPanel[f])) != 0)
+      {
+        printf("MISMATCH partial update panel differs from full redraw at frame %d%s\n", f,
+               triple[t] ? " (triple buffered)" : "");
+        failures++;
+      }
+    }
+    vmupro_host_get_stats(&partial[t]);
+  }
+
+  printf("partial updates: %.1f KB/frame full, %.1f KB/frame partial (%.1f rects/frame), %d/%d triple buffered pushes stalled\n",
+         full.bytes_transferred / 1024.0 / FRAMES, partial[0].bytes_transferred / 1024.0 / FRAMES,
+         (double)partial[0].dirty_rects_sent / FRAMES, (int)partial[1].push_stalls, FRAMES);
+  return failures;
+}
+
+static uint64_t presentTimes[8];
+static int presentCount;
+
+static void OnFrameDone(uint64_t present_time_us, void *user_data)
+{
+  (void)user_data;
+  if (presentCount < 8)
+    presentTimes[presentCount] = present_time_us;
+  presentCount++;
+}
+
+// Pushes stall, queue and complete in order against a slow simulated
+// panel, and the pacer holds its rate and reports late frames
+static int VerifyFramePacing(void)
+{
+  enum
+  {
+    TRANSFER_US = 20000,
+    PACED_FRAMES = 20
+  };
+  int failures = 0;
+
+  vmupro_host_reset();
+  vmupro_start_double_buffer_renderer();
+  vmupro_host_set_panel_transfer_time(TRANSFER_US);
+  presentCount = 0;
+  vmupro_set_frame_done_callback(OnFrameDone, NULL);
+
+  // two buffers: the second push must wait for the first transfer
+  bool first = vmupro_try_push_double_buffer_frame();
+  bool second = vmupro_try_push_double_buffer_frame();
+  // three buffers: one more frame can queue behind it
+  vmupro_set_triple_buffering(true);
+  bool third = vmupro_try_push_double_buffer_frame();
+  int pending = vmupro_get_pending_frames();
+  bool fourth = vmupro_try_push_double_buffer_frame();
+  if (!first || second || !third || pending != 2 || fourth)
+  {
+    printf("MISMATCH try push gave %d %d %d %d with %d pending, expected 1 0 1 0 with 2\n",
+           first, second, third, fourth, pending);
+    failures++;
+  }
+
+  // a blocking push waits for the first transfer, then the queue drains
+  vmupro_push_double_buffer_frame();
+  vmupro_delay_us(3 * TRANSFER_US);
+  if (vmupro_get_pending_frames() != 0 || presentCount != 3 ||
+      vmupro_get_last_present_time_us() != presentTimes[2])
+  {
+    printf("MISMATCH %d frame done callbacks after 3 pushes\n", presentCount);
+    failures++;
+  }
+  for (int i = 1; i < presentCount && i < 8; i++)
+  {
+    if (presentTimes[i] < presentTimes[i - 1] + TRANSFER_US)
+    {
+      printf("MISMATCH frame %d presented %d us after the previous one\n", i,
+             (int)(presentTimes[i] - presentTimes[i - 1]));
+      failures++;
+    }
+  }
+
+  vmupro_host_reset();
+  vmupro_start_double_buffer_renderer();
+  vmupro_frame_pacer_t pacer;
+  vmupro_frame_pacer_init(&pacer, 100);
+  uint64_t start = vmupro_get_time_us();
+  for (int f = 0; f < PACED_FRAMES; f++)
+    vmupro_frame_pacer_present(&pacer);
+  uint64_t elapsed = vmupro_get_time_us() - start;
+  if (elapsed < (uint64_t)(PACED_FRAMES - 1) * pacer.frame_us)
+  {
+    printf("MISMATCH %d paced frames at 100 fps took %d us\n", PACED_FRAMES, (int)elapsed);
+    failures++;
+  }
+  uint32_t missedOnTime = pacer.missed;
+
+  // a frame that overran by more than a period is late, the next is on time again
+  vmupro_delay_us(pacer.frame_us * 3);
+  bool late = vmupro_frame_pacer_present(&pacer);
+  bool recovered = vmupro_frame_pacer_present(&pacer);
+  if (late || pacer.missed != missedOnTime + 1 || !recovered)
+  {
+    printf("MISMATCH pacer after a long frame: on time %d then %d, %d missed\n", late, recovered,
+           (int)(pacer.missed - missedOnTime));
+    failures++;
+  }
+
+  printf("frame pacing: %d frames at 100 fps in %.1f ms, %d missed\n", PACED_FRAMES, elapsed / 1000.0,
+         (int)missedOnTime);
+  return failures;
+}
+
+// Tiled sprite batches must match direct rendering, including frames
+// where only some sprites were re-binned
+static void CrowdVerifyFrame(int frame)
+{
+  CrowdFrame(frame);
+  // hidden, unkeyed and reprioritized sprites
+  crowd[3].alpha = frame & 1 ? 0 : 255;
+  crowd[5].transparent_color = (vmupro_color_t)-1;
+  crowd[9].priority = frame >= 12 ? 7 : 1;
+}
+
+static int VerifySpriteBatchTiled(void)
+{
+  enum
+  {
+    FRAMES = 24
+  };
+  static uint16_t direct[FRAMES][240 * 240];
+  static const vmupro_sprite_batch_mode_t modes[] = {VMUPRO_SPRITE_BATCH_TILED_16, VMUPRO_SPRITE_BATCH_TILED_32};
+  int failures = 0;
+
+  vmupro_host_reset();
+  for (int f = 0; f < FRAMES; f++)
+  {
+    CrowdVerifyFrame(f);
+    vmupro_display_clear(VMUPRO_COLOR_NAVY);
+    vmupro_sprite_batch_render(crowd, CROWD_SIZE);
+    memcpy(direct[f], vmupro_get_back_buffer(), sizeof(direct[f]));
+  }
+
+  for (int m = 0; m < 2; m++)
+  {
+    vmupro_host_reset();
+    vmupro_set_sprite_batch_mode(modes[m]);
+    for (int f = 0; f < FRAMES; f++)
+    {
+      CrowdVerifyFrame(f);
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      vmupro_sprite_batch_render(crowd, CROWD_SIZE);
+      memcpy(reference, direct[f], sizeof(reference));
+      failures += CompareWithReference("sprite_batch_render_tiled", f, 0, CROWD_SIZE, 0, modes[m]);
+    }
+
+    vmupro_host_stats_t st;
+    vmupro_host_get_stats(&st);
+    printf("tiled %dx%d sprite batch: %.1f sprites binned/frame, %.1f tiles/frame\n", modes[m], modes[m],
+           (double)st.sprites_binned / FRAMES, (double)st.sprite_tiles / FRAMES);
+  }
+  vmupro_host_reset();
+  return failures;
+}
+
+// Every split pass against the same pass on one core
+static void SplitPasses(int variant)
+{
+  static const int mosaic[4][5] = {{0, 0, 240, 240, 8}, {13, 17, 200, 190, 7}, {-20, 101, 300, 30, 3}, {5, 5, 230, 1, 4}};
+  const int *m = mosaic[variant];
+
+  if (variant & 1)
+    vmupro_set_color_window(40, 60, 200, 180, VMUPRO_COLOR_NAVY);
+  vmupro_display_clear(VMUPRO_COLOR_NAVY);
+  vmupro_blit_scrolling_background((uint8_t *)background, BG_SIZE, BG_SIZE, variant * 77 - 100, variant * 31, 240 - variant * 13, 240 - variant * 29);
+  vmupro_layer_set_scroll(0, variant * 19, -variant * 5);
+  vmupro_layer_set_scroll(1, -variant * 23, variant * 41);
+  vmupro_render_all_layers();
+  vmupro_apply_mosaic_to_screen(m[0], m[1], m[2], m[3], m[4]);
+  vmupro_clear_color_window();
+}
+
+static int VerifySplitRendering(void)
+{
+  static uint16_t blendRef[3][240 * 240];
+  int failures = 0;
+
+  vmupro_host_reset();
+  vmupro_layer_create(0, BG_SIZE, BG_SIZE);
+  vmupro_layer_blit_background(0, (uint8_t *)background, BG_SIZE, BG_SIZE);
+  vmupro_tilemap_t map = tilemap;
+  map.wrap = true;
+  vmupro_layer_set_tilemap(1, &map);
+
+  for (int variant = 0; variant < 4; variant++)
+  {
+    uint8_t alpha = variant >= 2 ? 128 : 255;
+    vmupro_layer_set_alpha(1, alpha);
+
+    vmupro_set_split_rendering(false);
+    SplitPasses(variant);
+    memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+    vmupro_set_split_rendering(true);
+    SplitPasses(variant);
+    failures += CompareWithReference("split_rendering", variant, 0, 240, 240, alpha);
+  }
+
+  // odd sizes so the halves are uneven
+  static const int blendSize[2] = {240 * 240, 37 * 11};
+  for (int s = 0; s < 2; s++)
+  {
+    for (int split = 0; split < 2; split++)
+    {
+      vmupro_set_split_rendering(split != 0);
+      for (int op = 0; op < 3; op++)
+      {
+        uint16_t *out = split ? blendLayer : blendRef[op];
+        for (int i = 0; i < 240 * 240; i++)
+          out[i] = tile[i % (TILE_SIZE * TILE_SIZE)];
+        if (op == 0)
+          vmupro_blend_layers_additive((uint8_t *)out, (uint8_t *)background, blendSize[s], 1);
+        else if (op == 1)
+          vmupro_blend_layers_multiply((uint8_t *)out, (uint8_t *)background, blendSize[s], 1);
+        else
+          vmupro_blend_layers_screen((uint8_t *)out, (uint8_t *)background, blendSize[s], 1);
+        if (split && memcmp(out, blendRef[op], sizeof(blendLayer)) != 0)
+        {
+          printf("MISMATCH split blend_layers op %d size %d\n", op, blendSize[s]);
+          failures++;
+        }
+      }
+    }
+  }
+
+  vmupro_host_reset();
+  return failures;
+}
+
+// Display list replays against drawing the same calls immediately
+static int VerifyDisplayList(void)
+{
+  enum
+  {
+    FRAMES = 12
+  };
+  static const uint32_t flagSets[] = {0, VMUPRO_DL_SORT_LAYERS, VMUPRO_DL_CULL_OVERDRAW,
+                                      VMUPRO_DL_SORT_LAYERS | VMUPRO_DL_CULL_OVERDRAW};
+  int failures = 0;
+  uint32_t recorded = 0;
+
+  for (int f = 0; f < FRAMES; f++)
+  {
+    // a window set before the replay starts, and one left set by the list
+    bool startWindow = f % 4 == 1;
+    bool endWindow = f & 1;
+
+    vmupro_host_reset();
+    if (startWindow)
+      vmupro_set_color_window(0, 100, 239, 180, VMUPRO_COLOR_NAVY);
+    DrawFrame(f, endWindow);
+    vmupro_draw_fill_rect(0, 200, 239, 239, VMUPRO_COLOR_YELLOW);
+    memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+
+    for (int k = 0; k < 5; k++)
+    {
+      vmupro_host_reset();
+      if (startWindow)
+        vmupro_set_color_window(0, 100, 239, 180, VMUPRO_COLOR_NAVY);
+      vmupro_display_list_begin(&displayList);
+      DrawFrame(f, endWindow);
+      if (!vmupro_display_list_end())
+      {
+        printf("MISMATCH display list overflowed at frame %d\n", f);
+        return failures + 1;
+      }
+      recorded = displayList.count;
+      // the batch is copied, later edits must not show
+      CrowdFrame(f + 1);
+      if (k < 4)
+      {
+        vmupro_display_list_replay(&displayList, flagSets[k]);
+      }
+      else
+      {
+        vmupro_display_list_replay_async(&displayList, VMUPRO_DL_SORT_LAYERS | VMUPRO_DL_CULL_OVERDRAW);
+        vmupro_display_list_wait();
+      }
+      vmupro_draw_fill_rect(0, 200, 239, 239, VMUPRO_COLOR_YELLOW);
+      failures += CompareWithReference("display_list_replay", f, startWindow, (int)recorded, endWindow, k);
+    }
+
+    // recorded HUD first, sorted back into place
+    if (!startWindow)
+    {
+      vmupro_host_reset();
+      vmupro_display_list_begin(&displayList);
+      vmupro_display_list_set_layer(2);
+      SceneHud(f);
+      vmupro_display_list_set_layer(-1);
+      SceneBackground(f);
+      vmupro_display_list_set_layer(1);
+      ScenePlayfield(f);
+      vmupro_display_list_end();
+      vmupro_display_list_replay(&displayList, VMUPRO_DL_SORT_LAYERS | VMUPRO_DL_CULL_OVERDRAW);
+      if (endWindow)
+        vmupro_set_color_window(0, 180, 239, 239, VMUPRO_COLOR_BLACK);
+      vmupro_draw_fill_rect(0, 200, 239, 239, VMUPRO_COLOR_YELLOW);
+      failures += CompareWithReference("display_list_sorted", f, 0, (int)displayList.count, endWindow, 0);
+    }
+  }
+
+  vmupro_host_stats_t st;
+  vmupro_host_get_stats(&st);
+  printf("display lists: %u commands/frame, %.1f%% culled\n", recorded,
+         100.0 * st.dl_culled / (double)(st.dl_commands + st.dl_culled));
+  if (st.dl_culled == 0)
+  {
+    printf("MISMATCH display list culling never triggered\n");
+    failures++;
+  }
+
+  // running out of arena drops commands and reports it
+  static uint64_t smallArena[16];
+  vmupro_display_list_t small;
+  vmupro_display_list_init(&small, smallArena, sizeof(smallArena));
+  vmupro_display_list_begin(&small);
+  DrawFrame(0, false);
+  if (vmupro_display_list_end() || !small.overflow || small.count == 0)
+  {
+    printf("MISMATCH display list overflow not reported (%u commands)\n", small.count);
+    failures++;
+  }
+
+  vmupro_host_reset();
+  return failures;
+}
+
+int RunDisplayVerify(void)
+{
+  int failures = VerifyTransparent();
+  failures += VerifyScaledIdentity();
+  failures += VerifyAffine();
+  failures += VerifyRle();
+  failures += VerifyIndexed();
+  failures += VerifyTilemap();
+  failures += VerifyTilemapIndexed();
+  failures += VerifyInfiniteBackground();
+  failures += VerifyRaster();
+  failures += VerifyPartialUpdates();
+  failures += VerifyFramePacing();
+  failures += VerifySpriteBatchTiled();
+  failures += VerifyDisplayList();
+  failures += VerifySplitRendering();
+  return failures;
+}
@@ -0,0 +1,321 @@
+// tools/hostsim/bench/verify_file.c
+//
+// bench_display --verify checks for background file I/O: priorities,
+// cancellation and callbacks on a simulated card, and the bytes against
+// the synchronous file API
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vmupro_sdk.h"
+#include "vmupro_host.h"
+#include "bench.h"
+
+#define ASYNC_BYTES (1 << 20)
+#define ASYNC_CARD_SPEED (16u << 20)
+#define ASYNC_HIGH_READS 8
+#define ASYNC_HIGH_BYTES 4096
+
+static uint8_t asyncData[ASYNC_BYTES];
+static uint8_t asyncGot[ASYNC_BYTES];
+static int asyncOrder[VMUPRO_FILE_ASYNC_MAX_REQUESTS];
+static vmupro_file_async_status_t asyncStatus[VMUPRO_FILE_ASYNC_MAX_REQUESTS];
+static int asyncCalls;
+static uint8_t *asyncLoaded;
+static size_t asyncLoadedSize;
+
+static void AsyncRecord(vmupro_file_async_request_t *req, vmupro_file_async_status_t status, void *user)
+{
+  (void)req;
+  if (asyncCalls < VMUPRO_FILE_ASYNC_MAX_REQUESTS)
+  {
+    asyncOrder[asyncCalls] = *(const int *)user;
+    asyncStatus[asyncCalls] = status;
+  }
+  asyncCalls++;
+}
+
+static void AsyncLoaded(vmupro_file_async_request_t *req, vmupro_file_async_status_t status, void *user)
+{
+  AsyncRecord(req, status, user);
+  asyncLoaded = vmupro_file_async_take_buffer(req, &asyncLoadedSize);
+}
+
+// Polls until the request has moved some bytes, so that it is part way
+// through when the caller acts
+static bool AsyncStarted(const vmupro_file_async_request_t *req)
+{
+  uint64_t deadline = vmupro_get_time_us() + 2000000;
+  while (vmupro_file_async_progress(req) == 0 && vmupro_get_time_us() < deadline)
+    vmupro_delay_us(200);
+  return vmupro_file_async_status(req) == VMUPRO_FILE_ASYNC_RUNNING;
+}
+
+// Writes and reads against the synchronous file API, a load under a game
+// loop against the same load done in one call, priorities, cancellation,
+// callbacks, failures and the request limit, on a simulated 16 MB/s card
+static int VerifyFileAsync(void)
+{
+  const char *path = "/tmp/vmupro_verify_async.bin";
+  const char *savePath = "/tmp/vmupro_verify_async_save.bin";
+  static const int ids[VMUPRO_FILE_ASYNC_MAX_REQUESTS] = {0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10,
+                                                          11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21,
+                                                          22, 23, 24, 25, 26, 27, 28, 29, 30, 31};
+  int failures = 0;
+  vmupro_host_reset();
+  vmupro_host_set_sdcard_speed(ASYNC_CARD_SPEED);
+  vmupro_file_async_reset_stats();
+  uint32_t seed = 0x2545f491u;
+  for (int i = 0; i < ASYNC_BYTES; i++)
+  {
+    seed = seed * 1664525u + 1013904223u;
+    asyncData[i] = (uint8_t)(seed >> 24);
+  }
+
+  // a copied write: the source is wiped as soon as it is queued
+  uint8_t *scratch = malloc(ASYNC_BYTES);
+  memcpy(scratch, asyncData, ASYNC_BYTES);
+  vmupro_file_async_desc_t write = {
+      .op = VMUPRO_FILE_ASYNC_WRITE, .priority = VMUPRO_FILE_ASYNC_LOW, .path = path, .data = scratch,
+      .size = ASYNC_BYTES, .copy = true};
+  vmupro_file_async_request_t *req = vmupro_file_async_submit(&write);
+  memset(scratch, 0, ASYNC_BYTES);
+  free(scratch);
+  bool finished = vmupro_file_async_wait(req, -1);
+  vmupro_file_async_status_t status = vmupro_file_async_status(req);
+  size_t progress = vmupro_file_async_progress(req);
+  vmupro_file_async_release(req);
+  memset(asyncGot, 0, ASYNC_BYTES);
+  if (req == NULL || !finished || status != VMUPRO_FILE_ASYNC_DONE || progress != ASYNC_BYTES ||
+      !vmupro_read_file_bytes(path, asyncGot, 0, ASYNC_BYTES) || memcmp(asyncGot, asyncData, ASYNC_BYTES) != 0 ||
+      vmupro_get_file_size(path) != ASYNC_BYTES)
+  {
+    printf("MISMATCH file_async write: status %d, %zu bytes\n", (int)status, progress);
+    failures++;
+  }
+
+  // the same file loaded in one call, then in the background under a
+  // game loop that takes 2ms a frame
+  uint64_t start = vmupro_get_time_us();
+  vmupro_read_file_bytes(path, asyncGot, 0, ASYNC_BYTES);
+  uint32_t syncUs = (uint32_t)(vmupro_get_time_us() - start);
+  asyncCalls = 0;
+  asyncLoaded = NULL;
+  vmupro_file_async_desc_t load = {.op = VMUPRO_FILE_ASYNC_LOAD,
+                                   .priority = VMUPRO_FILE_ASYNC_NORMAL,
+                                   .path = path,
+                                   .callback = AsyncLoaded,
+                                   .user = (void *)&ids[0]};
+  req = vmupro_file_async_submit(&load);
+  uint32_t longestUs = 0;
+  uint64_t deadline = vmupro_get_time_us() + 5000000;
+  while (req != NULL && asyncCalls == 0 && vmupro_get_time_us() < deadline)
+  {
+    uint64_t frame = vmupro_get_time_us();
+    vmupro_file_async_update();
+    vmupro_delay_us(2000);
+    uint32_t us = (uint32_t)(vmupro_get_time_us() - frame);
+    if (us > longestUs)
+      longestUs = us;
+  }
+  if (asyncCalls != 1 || asyncStatus[0] != VMUPRO_FILE_ASYNC_DONE || asyncLoaded == NULL ||
+      asyncLoadedSize != ASYNC_BYTES || memcmp(asyncLoaded, asyncData, ASYNC_BYTES) != 0 ||
+      longestUs * 4 > syncUs)
+  {
+    printf("MISMATCH file_async load: %d callbacks, %zu bytes, longest frame %u us against %u us\n", asyncCalls,
+           asyncLoadedSize, longestUs, syncUs);
+    failures++;
+  }
+  else
+  {
+    printf("file async: %d KB load stalls %u ms in one call, longest frame %.1f ms in the background\n",
+           ASYNC_BYTES / 1024, syncUs / 1000, longestUs / 1000.0);
+  }
+  free(asyncLoaded);
+  asyncLoaded = NULL;
+
+  // high priority reads cut in on a running low priority load, and
+  // finish in the order they were queued
+  vmupro_file_async_reset_stats();
+  asyncCalls = 0;
+  load.priority = VMUPRO_FILE_ASYNC_LOW;
+  load.callback = NULL;
+  vmupro_file_async_request_t *background = vmupro_file_async_submit(&load);
+  bool started = AsyncStarted(background);
+  for (int i = 0; i < ASYNC_HIGH_READS; i++)
+  {
+    vmupro_file_async_desc_t read = {.op = VMUPRO_FILE_ASYNC_READ,
+                                     .priority = VMUPRO_FILE_ASYNC_HIGH,
+                                     .path = path,
+                                     .buffer = asyncGot + i * ASYNC_HIGH_BYTES,
+                                     .offset = (uint32_t)(i * 100003) % (ASYNC_BYTES - ASYNC_HIGH_BYTES),
+                                     .size = ASYNC_HIGH_BYTES,
+                                     .callback = AsyncRecord,
+                                     .user = (void *)&ids[i]};
+    vmupro_file_async_submit(&read);
+  }
+  deadline = vmupro_get_time_us() + 5000000;
+  while (asyncCalls < ASYNC_HIGH_READS && vmupro_get_time_us() < deadline)
+  {
+    vmupro_file_async_update();
+    vmupro_delay_us(500);
+  }
+  bool backgroundRunning = vmupro_file_async_status(background) == VMUPRO_FILE_ASYNC_RUNNING;
+  int wrong = 0;
+  for (int i = 0; i < ASYNC_HIGH_READS && i < asyncCalls; i++)
+  {
+    uint32_t offset = (uint32_t)(i * 100003) % (ASYNC_BYTES - ASYNC_HIGH_BYTES);
+    wrong += asyncOrder[i] != i || asyncStatus[i] != VMUPRO_FILE_ASYNC_DONE ||
+             memcmp(asyncGot + i * ASYNC_HIGH_BYTES, asyncData + offset, ASYNC_HIGH_BYTES) != 0;
+  }
+  vmupro_file_async_wait(background, -1);
+  size_t loadedSize = 0;
+  uint8_t *loaded = vmupro_file_async_take_buffer(background, &loadedSize);
+  vmupro_file_async_stats_t stats;
+  vmupro_file_async_get_stats(&stats);
+  uint32_t chunkUs = VMUPRO_FILE_ASYNC_CHUNK_BYTES * 1000000ull / ASYNC_CARD_SPEED;
+  if (!started || asyncCalls != ASYNC_HIGH_READS || wrong != 0 || !backgroundRunning || loaded == NULL ||
+      loadedSize != ASYNC_BYTES || memcmp(loaded, asyncData, ASYNC_BYTES) != 0 || stats.preemptions == 0 ||
+      stats.max_wait_us[VMUPRO_FILE_ASYNC_HIGH] > 10 * chunkUs)
+  {
+    printf("MISMATCH file_async priority: %d of %d reads, %d wrong, load %s, %u preemptions, high wait %u us\n",
+           asyncCalls, ASYNC_HIGH_READS, wrong, backgroundRunning ? "running" : "finished first", stats.preemptions,
+           stats.max_wait_us[VMUPRO_FILE_ASYNC_HIGH]);
+    failures++;
+  }
+  else
+  {
+    printf("file async: high priority reads wait at most %.1f ms behind a load (%u us chunks)\n",
+           stats.max_wait_us[VMUPRO_FILE_ASYNC_HIGH] / 1000.0, chunkUs);
+  }
+  free(loaded);
+  vmupro_file_async_release(background);
+
+  // cancelling a waiting read, a running load and a running write
+  asyncCalls = 0;
+  background = vmupro_file_async_submit(&load);
+  started = AsyncStarted(background);
+  memset(asyncGot, 0xa5, ASYNC_HIGH_BYTES);
+  vmupro_file_async_desc_t queued = {.op = VMUPRO_FILE_ASYNC_READ,
+                                     .priority = VMUPRO_FILE_ASYNC_LOW,
+                                     .path = path,
+                                     .buffer = asyncGot,
+                                     .size = ASYNC_HIGH_BYTES,
+                                     .callback = AsyncRecord,
+                                     .user = (void *)&ids[1]};
+  req = vmupro_file_async_submit(&queued);
+  bool cancelWaiting = vmupro_file_async_cancel(req) && vmupro_file_async_status(req) == VMUPRO_FILE_ASYNC_CANCELLED &&
+                       !vmupro_file_async_cancel(req);
+  bool cancelLoad = vmupro_file_async_cancel(background) && vmupro_file_async_wait(background, 2000) &&
+                    vmupro_file_async_status(background) == VMUPRO_FILE_ASYNC_CANCELLED &&
+                    vmupro_file_async_progress(background) < ASYNC_BYTES &&
+                    vmupro_file_async_take_buffer(background, NULL) == NULL;
+  vmupro_file_async_release(background);
+  int calls = vmupro_file_async_update() + vmupro_file_async_update();
+  bool untouched = asyncGot[0] == 0xa5 && asyncGot[ASYNC_HIGH_BYTES - 1] == 0xa5;
+
+  vmupro_file_async_desc_t save = {.op = VMUPRO_FILE_ASYNC_WRITE_AT,
+                                   .priority = VMUPRO_FILE_ASYNC_LOW,
+                                   .path = savePath,
+                                   .data = asyncData,
+                                   .offset = 4096,
+                                   .size = 256 * 1024};
+  remove(savePath);
+  req = vmupro_file_async_submit(&save);
+  bool cancelWrite = AsyncStarted(req) && !vmupro_file_async_cancel(req) && vmupro_file_async_wait(req, -1) &&
+                     vmupro_file_async_status(req) == VMUPRO_FILE_ASYNC_DONE;
+  vmupro_file_async_release(req);
+  memset(asyncGot, 0, save.size);
+  cancelWrite = cancelWrite && vmupro_get_file_size(savePath) == save.offset + save.size &&
+                vmupro_read_file_bytes(savePath, asyncGot, save.offset, (int)save.size) &&
+                memcmp(asyncGot, asyncData, save.size) == 0;
+  if (!started || !cancelWaiting || !cancelLoad || !cancelWrite || calls != 1 || asyncCalls != 1 ||
+      asyncStatus[0] != VMUPRO_FILE_ASYNC_CANCELLED || !untouched)
+  {
+    printf("MISMATCH file_async cancel: waiting %d, load %d, write %d, %d callbacks\n", cancelWaiting, cancelLoad,
+           cancelWrite, asyncCalls);
+    failures++;
+  }
+
+  // failures, refused requests and the request limit
+  vmupro_file_async_desc_t missing = {
+      .op = VMUPRO_FILE_ASYNC_READ, .path = "/tmp/vmupro_no_such_file.bin", .buffer = asyncGot, .size = 16};
+  vmupro_file_async_desc_t pastEnd = {.op = VMUPRO_FILE_ASYNC_READ,
+                                      .path = path,
+                                      .buffer = asyncGot,
+                                      .offset = ASYNC_BYTES - 8,
+                                      .size = 16};
+  vmupro_file_async_desc_t noLoad = {.op = VMUPRO_FILE_ASYNC_LOAD, .path = missing.path};
+  char longPath[VMUPRO_FILE_ASYNC_MAX_PATH + 8];
+  memset(longPath, 'a', sizeof(longPath) - 1);
+  longPath[sizeof(longPath) - 1] = '\0';
+  vmupro_file_async_desc_t empty = pastEnd, tooLong = pastEnd;
+  empty.size = 0;
+  tooLong.path = longPath;
+  vmupro_file_async_request_t *bad[3] = {vmupro_file_async_submit(&missing), vmupro_file_async_submit(&pastEnd),
+                                         vmupro_file_async_submit(&noLoad)};
+  int failed = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    failed += vmupro_file_async_wait(bad[i], 2000) && vmupro_file_async_status(bad[i]) == VMUPRO_FILE_ASYNC_FAILED;
+    vmupro_file_async_release(bad[i]);
+  }
+  bool refused = vmupro_file_async_submit(NULL) == NULL && vmupro_file_async_submit(&empty) == NULL &&
+                 vmupro_file_async_submit(&tooLong) == NULL;
+
+  vmupro_file_async_request_t *all[VMUPRO_FILE_ASYNC_MAX_REQUESTS];
+  vmupro_file_async_desc_t small = pastEnd;
+  small.offset = 0;
+  small.size = 1;
+  int accepted = 0;
+  for (int i = 0; i < VMUPRO_FILE_ASYNC_MAX_REQUESTS; i++)
+  {
+    all[i] = vmupro_file_async_submit(&small);
+    accepted += all[i] != NULL;
+  }
+  vmupro_file_async_get_stats(&stats);
+  bool full = vmupro_file_async_submit(&small) == NULL;
+  vmupro_file_async_stats_t after;
+  vmupro_file_async_get_stats(&after);
+  for (int i = 0; i < VMUPRO_FILE_ASYNC_MAX_REQUESTS; i++)
+    vmupro_file_async_release(all[i]);
+  req = vmupro_file_async_submit(&small);
+  bool reused = req != NULL;
+  vmupro_file_async_release(req);
+  if (failed != 3 || !refused || accepted != VMUPRO_FILE_ASYNC_MAX_REQUESTS || !full ||
+      after.rejected != stats.rejected + 1 || !reused)
+  {
+    printf("MISMATCH file_async limits: %d failed, refused %d, %d accepted, full %d, reused %d\n", failed, refused,
+           accepted, full, reused);
+    failures++;
+  }
+
+  // a released write still reaches the card before stop returns
+  write.copy = false;
+  write.data = asyncData;
+  write.size = 512 * 1024;
+  remove(savePath);
+  write.path = savePath;
+  vmupro_file_async_release(vmupro_file_async_submit(&write));
+  vmupro_file_async_stop();
+  memset(asyncGot, 0, write.size);
+  if (vmupro_file_async_pending() != 0 || vmupro_get_file_size(savePath) != write.size ||
+      !vmupro_read_file_bytes(savePath, asyncGot, 0, (int)write.size) ||
+      memcmp(asyncGot, asyncData, write.size) != 0)
+  {
+    printf("MISMATCH file_async stop: %d pending, save not written\n", vmupro_file_async_pending());
+    failures++;
+  }
+
+  vmupro_host_set_sdcard_speed(0);
+  remove(path);
+  remove(savePath);
+  vmupro_host_reset();
+  return failures;
+}
+
+int RunFileVerify(void)
+{
+  int failures = VerifyFileAsync();
+  return failures;
+}
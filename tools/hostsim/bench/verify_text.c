@@ -0,0 +1,247 @@
+// tools/hostsim/bench/verify_text.c
+//
+// bench_display --verify checks for text: cached text, text runs and
+// batches against vmupro_draw_text, and custom fonts decoding, kerning
+// and clipping like a reference drawn from the generator
+
+#include <stdio.h>
+#include <string.h>
+#include "vmupro_sdk.h"
+#include "vmupro_host.h"
+#include "bench.h"
+
+// Cached text must blend exactly like the firmware renderer does over a
+// background of its bg_color, for every font and at the screen edges
+static int VerifyText(void)
+{
+  static const vmupro_font_id_t fonts[] = {VMUPRO_FONT_TINY_6x8, VMUPRO_FONT_MONO_7x13, VMUPRO_FONT_QUANTICO_18x20,
+                                           VMUPRO_FONT_QUANTICO_32x37, VMUPRO_FONT_OPEN_SANS_15x18};
+  static const int xs[] = {-25, -1, 0, 97, 200, 236, 240};
+  static const int ys[] = {-40, -5, 0, 111, 225, 239};
+  static const uint16_t backgrounds[] = {VMUPRO_COLOR_BLACK, VMUPRO_COLOR_NAVY};
+  static const char *text = "Hi 0123 {Wq}~ #";
+  int failures = 0;
+
+  for (int fi = 0; fi < (int)(sizeof(fonts) / sizeof(fonts[0])); fi++)
+  {
+    vmupro_host_reset();
+    vmupro_glyph_cache_t cache;
+    uint32_t size = vmupro_glyph_cache_size(fonts[fi], ' ', '~');
+    if (size > sizeof(glyphArena) || !vmupro_glyph_cache_init(&cache, fonts[fi], ' ', '~', glyphArena, size))
+    {
+      printf("MISMATCH glyph cache init failed for font %d (%u bytes)\n", fonts[fi], size);
+      failures++;
+      continue;
+    }
+    if (vmupro_text_width(&cache, text) != vmupro_calc_text_length(text))
+    {
+      printf("MISMATCH text_width %d vs calc_text_length %d for font %d\n", vmupro_text_width(&cache, text),
+             vmupro_calc_text_length(text), fonts[fi]);
+      failures++;
+    }
+    vmupro_text_run_t run;
+    vmupro_text_run_set(&run, &cache, text);
+
+    for (int xi = 0; xi < (int)(sizeof(xs) / sizeof(xs[0])); xi++)
+    {
+      for (int yi = 0; yi < (int)(sizeof(ys) / sizeof(ys[0])); yi++)
+      {
+        int x = xs[xi];
+        int y = ys[yi];
+        uint16_t bg = backgrounds[(xi + yi) & 1];
+
+        vmupro_display_clear(bg);
+        vmupro_draw_text(text, x, y, VMUPRO_COLOR_ORANGE, bg);
+        vmupro_draw_text("A", x, y + 60, VMUPRO_COLOR_WHITE, bg);
+        memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+
+        vmupro_display_clear(bg);
+        vmupro_text_draw(&cache, text, x, y, VMUPRO_COLOR_ORANGE);
+        vmupro_text_draw(&cache, "A", x, y + 60, VMUPRO_COLOR_WHITE);
+        failures += CompareWithReference("text_draw", x, y, fonts[fi], 0, 0);
+
+        vmupro_display_clear(bg);
+        vmupro_text_run_draw(&run, x, y, VMUPRO_COLOR_ORANGE);
+        vmupro_text_draw(&cache, "A", x, y + 60, VMUPRO_COLOR_WHITE);
+        failures += CompareWithReference("text_run_draw", x, y, fonts[fi], 0, 0);
+
+        const vmupro_text_item_t items[] = {{text, x, y, VMUPRO_COLOR_ORANGE}, {"A", x, y + 60, VMUPRO_COLOR_WHITE}};
+        vmupro_display_clear(bg);
+        vmupro_text_draw_batch(&cache, items, 2);
+        failures += CompareWithReference("text_draw_batch", x, y, fonts[fi], 0, 0);
+      }
+    }
+  }
+
+  // only inked pixels are written, the rest of the image shows through
+  vmupro_host_reset();
+  vmupro_glyph_cache_t cache;
+  vmupro_glyph_cache_init(&cache, VMUPRO_FONT_QUANTICO_25x29, ' ', '~', glyphArena, sizeof(glyphArena));
+  vmupro_blit_scrolling_background((uint8_t *)background, BG_SIZE, BG_SIZE, 0, 0, 240, 240);
+  memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+  int width = vmupro_text_draw(&cache, "  ", 30, 30, VMUPRO_COLOR_WHITE);
+  failures += CompareWithReference("text_draw_blank", 30, 30, width, 0, 0);
+  vmupro_text_draw(&cache, "Text", 30, 30, VMUPRO_COLOR_WHITE);
+  const uint16_t *fb = (const uint16_t *)vmupro_get_back_buffer();
+  int changed = 0, kept = 0;
+  for (int y = 30; y < 30 + cache.height; y++)
+  {
+    for (int x = 30; x < 30 + vmupro_text_width(&cache, "Text"); x++)
+    {
+      if (fb[y * 240 + x] != reference[y * 240 + x])
+        changed++;
+      else
+        kept++;
+    }
+  }
+  if (changed == 0 || kept == 0)
+  {
+    printf("MISMATCH text_draw over an image: %d pixels changed, %d kept\n", changed, kept);
+    failures++;
+  }
+
+  vmupro_host_reset();
+  return failures;
+}
+
+// Draw a decoded string straight from the generator, independent of the
+// font data and its lookup tables
+static void ReferenceBmText(const uint32_t *codepoints, int count, int x, int y, uint16_t color)
+{
+  uint16_t *fb = (uint16_t *)vmupro_get_back_buffer();
+  uint16_t fg = (uint16_t)((color >> 8) | (color << 8));
+  int pen = 0;
+  uint32_t prev = 0;
+  for (int i = 0; i < count; i++)
+  {
+    uint32_t cp = codepoints[i];
+    if (cp == '\n')
+    {
+      pen = 0;
+      prev = 0;
+      y += BMF_LINE_HEIGHT;
+      continue;
+    }
+    bool known = cp >= 0x20 && cp < 0x7f;
+    for (int e = 0; e < (int)(sizeof(bmfExtra) / sizeof(bmfExtra[0])); e++)
+      known |= bmfExtra[e] == cp;
+    if (!known)
+      cp = '?';
+    pen += BmfKerning(prev, cp);
+    for (int gy = 0; gy < BmfHeight(cp); gy++)
+    {
+      for (int gx = 0; gx < BmfWidth(cp); gx++)
+      {
+        int px = x + pen + BmfXOffset(cp) + gx;
+        int py = y + BmfYOffset(cp) + gy;
+        int a = BmfCoverage(cp, gx, gy);
+        if (px < 0 || py < 0 || px >= 240 || py >= 240 || a == 0)
+          continue;
+        uint16_t bg = (uint16_t)((fb[py * 240 + px] >> 8) | (fb[py * 240 + px] << 8));
+        int r = (bg >> 11) + (((fg >> 11) - (bg >> 11)) * a) / 15;
+        int g = ((bg >> 5) & 63) + ((((fg >> 5) & 63) - ((bg >> 5) & 63)) * a) / 15;
+        int b = (bg & 31) + (((fg & 31) - (bg & 31)) * a) / 15;
+        uint16_t out = (uint16_t)((r << 11) | (g << 5) | b);
+        fb[py * 240 + px] = (uint16_t)((out >> 8) | (out << 8));
+      }
+    }
+    pen += BmfAdvance(cp);
+    prev = cp;
+  }
+}
+
+// Custom fonts: UTF-8 decoding, glyph lookup, kerning, fallback glyphs
+// and clipping against a reference drawn from the generated glyphs
+static int VerifyBmFont(void)
+{
+  static const char text[] = "AVATo, Caf\xc3\xa9\xce\xa9 \xe3\x81\x82\xf0\x9f\x98\x80x\xff\xc0\xaf\xc3\xbc~\nVA\xe3\x81";
+  static const uint32_t decoded[] = {'A', 'V', 'A', 'T', 'o', ',', ' ', 'C', 'a', 'f', 0xe9, 0x3a9, ' ', 0x3042,
+                                     0x1f600, 'x', 0xfffd, 0xfffd, 0xfffd, 0xfc, '~', '\n', 'V', 'A', 0xfffd, 0xfffd};
+  enum
+  {
+    NUM_DECODED = sizeof(decoded) / sizeof(decoded[0])
+  };
+  static const int xs[] = {-30, -3, 0, 97, 200, 236};
+  static const int ys[] = {-20, -2, 0, 120, 228, 239};
+  int failures = 0;
+
+  vmupro_host_reset();
+  uint32_t size = MakeBmFont();
+  vmupro_bmfont_t font;
+  if (!vmupro_bmfont_load(&font, (const uint8_t *)bmfData, size))
+  {
+    printf("MISMATCH custom font failed to load\n");
+    return 1;
+  }
+
+  const char *p = text;
+  for (int i = 0; i < NUM_DECODED; i++)
+  {
+    uint32_t cp = vmupro_utf8_next(&p);
+    if (cp != decoded[i])
+    {
+      printf("MISMATCH utf8_next character %d: U+%04X, expected U+%04X\n", i, cp, decoded[i]);
+      failures++;
+    }
+  }
+  if (vmupro_utf8_next(&p) != 0 || *p != 0)
+  {
+    printf("MISMATCH utf8_next did not stop at the end of the string\n");
+    failures++;
+  }
+
+  // widest line, with kerning and fallbacks
+  int expected = 0;
+  int pen = 0;
+  uint32_t prev = 0;
+  for (int i = 0; i < NUM_DECODED && decoded[i] != '\n'; i++)
+  {
+    uint32_t cp = vmupro_bmfont_find_glyph(&font, decoded[i]) ? decoded[i] : '?';
+    pen += BmfKerning(prev, cp) + BmfAdvance(cp);
+    prev = cp;
+    expected = pen > expected ? pen : expected;
+  }
+  if (vmupro_bmfont_text_width(&font, text) != expected || vmupro_bmfont_get_kerning(&font, 'A', 'V') != -2 ||
+      vmupro_bmfont_get_kerning(&font, 0xe9, 0x3a9) != 1 || vmupro_bmfont_get_kerning(&font, 'V', 'V') != 0)
+  {
+    printf("MISMATCH bmfont_text_width %d, expected %d\n", vmupro_bmfont_text_width(&font, text), expected);
+    failures++;
+  }
+
+  for (int xi = 0; xi < (int)(sizeof(xs) / sizeof(xs[0])); xi++)
+  {
+    for (int yi = 0; yi < (int)(sizeof(ys) / sizeof(ys[0])); yi++)
+    {
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      ReferenceBmText(decoded, NUM_DECODED, xs[xi], ys[yi], VMUPRO_COLOR_ORANGE);
+      memcpy(reference, vmupro_get_back_buffer(), sizeof(reference));
+
+      vmupro_display_clear(VMUPRO_COLOR_NAVY);
+      vmupro_bmfont_draw_text(&font, text, xs[xi], ys[yi], VMUPRO_COLOR_ORANGE);
+      failures += CompareWithReference("bmfont_draw_text", xs[xi], ys[yi], 0, 0, 0);
+    }
+  }
+
+  // damaged or misaligned data is rejected
+  vmupro_bmfont_t bad;
+  bmfData[0] ^= 1;
+  bool loaded = vmupro_bmfont_load(&bad, (const uint8_t *)bmfData, size);
+  bmfData[0] ^= 1;
+  loaded |= vmupro_bmfont_load(&bad, (const uint8_t *)bmfData, size - 8);
+  loaded |= vmupro_bmfont_load(&bad, (const uint8_t *)bmfData + 1, size - 1);
+  if (loaded)
+  {
+    printf("MISMATCH damaged custom font data was accepted\n");
+    failures++;
+  }
+
+  vmupro_host_reset();
+  return failures;
+}
+
+int RunTextVerify(void)
+{
+  int failures = VerifyText();
+  failures += VerifyBmFont();
+  return failures;
+}
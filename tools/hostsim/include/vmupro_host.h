@@ -0,0 +1,188 @@
+/**
+ * @file vmupro_host.h
+ * @brief Host-side (Linux) reference implementation hooks
+ *
+ * The host simulator implements the firmware API declared in vmupro_sdk.h
+ * against in-memory 240x240 RGB565 framebuffers so rendering code can be
+ * exercised, inspected and timed on a development machine or in CI.
+ * This header exposes the few extra entry points that only make sense
+ * on the host (inspection, statistics, resetting state between runs).
+ *
+ * @note Not available on the device - do not include from app code
+ *
+ * @author 8BitMods
+ * @version 2.0.0
+ * @date 2025-07-14
+ * @copyright Copyright (c) 2025 APPCAKE Limited. Distributed under the MIT License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define VMUPRO_HOST_SCREEN_WIDTH 240
+#define VMUPRO_HOST_SCREEN_HEIGHT 240
+
+  /**
+   * @brief Counters describing what would have been sent to the panel
+   */
+  typedef struct
+  {
+    uint64_t frames_pushed;     /**< Double buffer frames pushed */
+    uint64_t refreshes;         /**< Single buffer refreshes */
+    uint64_t bytes_transferred; /**< Bytes sent to the (simulated) panel */
+    uint64_t dirty_rects_sent;  /**< Rectangles sent while in partial update mode */
+    uint64_t sprites_binned;    /**< Sprites (re)binned by tiled sprite batches */
+    uint64_t sprite_tiles;      /**< Screen tiles composited by tiled sprite batches */
+    uint64_t dl_commands;       /**< Display list commands executed by replays */
+    uint64_t dl_culled;         /**< Display list commands skipped as fully overdrawn */
+    uint64_t push_stalls;       /**< Pushes that waited for the previous panel transfer */
+  } vmupro_host_stats_t;
+
+  /**
+   * @brief Counters describing what the (simulated) audio output played
+   *
+   * All counts are stereo frames at 44.1 kHz.
+   */
+  typedef struct
+  {
+    uint64_t frames_queued;   /**< Frames passed to vmupro_audio_add_stream_samples() */
+    uint64_t frames_played;   /**< Frames taken from the ring buffer by the output */
+    uint64_t underruns;       /**< Times the output found the ring buffer empty */
+    uint64_t underrun_frames; /**< Frames of silence played because of underruns */
+    uint64_t overflow_frames; /**< Frames dropped because the ring buffer was full (manual draining only) */
+  } vmupro_host_audio_stats_t;
+
+  /**
+   * @brief Reset framebuffers, layers, windows, audio and statistics
+   *
+   * Puts the simulator back into its power-on state. Call between
+   * independent benchmark or comparison runs.
+   */
+  void vmupro_host_reset(void);
+
+  /**
+   * @brief Get the simulated panel contents
+   *
+   * @return Pointer to the 240x240 RGB565 (big endian) image last sent to the panel
+   */
+  const uint8_t *vmupro_host_get_panel(void);
+
+  /**
+   * @brief Read the panel transfer statistics
+   *
+   * @param out_stats Destination for the current counters
+   */
+  void vmupro_host_get_stats(vmupro_host_stats_t *out_stats);
+
+  /**
+   * @brief Simulate the time a frame takes to reach the panel
+   *
+   * By default pushed frames reach the panel instantly. With a transfer
+   * time, vmupro_push_double_buffer_frame() stalls while the previous
+   * frame is still being sent, like on the device, so triple buffering
+   * and frame pacing code can be exercised on the host.
+   *
+   * @param full_frame_us Microseconds to send a full 240x240 frame, 0 for
+   *                      instant. Partial updates take proportionally less
+   */
+  void vmupro_host_set_panel_transfer_time(uint32_t full_frame_us);
+
+  /**
+   * @brief Write a 240x240 RGB565 (big endian) buffer to a binary PPM file
+   *
+   * @param path Output file path
+   * @param buffer Framebuffer to write, e.g. vmupro_get_back_buffer()
+   * @return true on success, false on failure
+   */
+  bool vmupro_host_write_ppm(const char *path, const uint8_t *buffer);
+
+  /**
+   * @brief Force the scalar row kernels
+   *
+   * Blits with a vectorized row kernel (e.g. vmupro_blit_buffer_transparent)
+   * normally process 8/16 pixels at a time. Forcing the scalar path lets the
+   * two be rendered side by side and compared pixel for pixel.
+   *
+   * @param scalar_only true to disable the vector kernels
+   */
+  void vmupro_host_set_scalar_kernels(bool scalar_only);
+
+  /**
+   * @brief Reset the audio output, its statistics and the global volume
+   *
+   * Part of vmupro_host_reset().
+   */
+  void vmupro_host_audio_reset(void);
+
+  /**
+   * @brief Choose how the simulated audio output drains the ring buffer
+   *
+   * In real time (the default) the ring buffer is played at 44.1 kHz
+   * against vmupro_get_time_us(), and vmupro_audio_add_stream_samples()
+   * blocks while it is full, like on the device. Otherwise frames only
+   * leave the ring buffer through vmupro_host_audio_drain(), so what an
+   * audio task produces can be captured and compared exactly, and
+   * samples added to a full ring buffer are dropped.
+   *
+   * @param enabled true for real time draining
+   */
+  void vmupro_host_audio_set_realtime(bool enabled);
+
+  /**
+   * @brief Play frames from the ring buffer now
+   *
+   * @param frames Stereo frames to play
+   * @return Frames that were in the ring buffer, the rest count as an underrun
+   */
+  uint32_t vmupro_host_audio_drain(uint32_t frames);
+
+  /**
+   * @brief Record the frames the audio output plays
+   *
+   * @param stereo Interleaved left/right destination, NULL to stop recording
+   * @param max_frames Frames stereo can hold, recording stops when it is full
+   */
+  void vmupro_host_audio_capture(int16_t *stereo, uint32_t max_frames);
+
+  /**
+   * @brief Frames recorded since vmupro_host_audio_capture()
+   */
+  uint32_t vmupro_host_audio_captured(void);
+
+  /**
+   * @brief Read the audio output statistics
+   *
+   * @param out_stats Destination for the current counters
+   */
+  void vmupro_host_audio_get_stats(vmupro_host_audio_stats_t *out_stats);
+
+  /**
+   * @brief Set the host directory that /sdcard paths refer to
+   *
+   * @param dir Directory, relative to the working directory or absolute.
+   *            The default is "sdcard"
+   */
+  void vmupro_host_set_sdcard_root(const char *dir);
+
+  /**
+   * @brief Simulate the time the SD card takes to read and write
+   *
+   * By default the file functions return as soon as the host disk
+   * allows. With a speed, each read and write also takes its size over
+   * the speed, so loads and background I/O (vmupro_file_async.h) can be
+   * timed against a card rather than the host's page cache.
+   *
+   * @param bytes_per_second Card throughput, 0 for no delay
+   */
+  void vmupro_host_set_sdcard_speed(uint32_t bytes_per_second);
+
+#ifdef __cplusplus
+}
+#endif
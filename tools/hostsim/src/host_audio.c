@@ -0,0 +1,265 @@
+// tools/hostsim/src/host_audio.c
+//
+// Host version of the audio streaming part of the firmware API
+// The ring buffer drains at 44.1 kHz in real time, like the device's
+// audio output, or only when asked to so mixes can be checked sample
+// for sample (see vmupro_host_audio_set_realtime)
+
+#include <string.h>
+#include <pthread.h>
+#include "vmupro_sdk.h"
+#include "vmupro_host.h"
+
+#define OUTPUT_RATE 44100
+// Stereo frames the ring holds, about 93 ms
+#define RING_FRAMES 4096
+
+static pthread_mutex_t audioLock = PTHREAD_MUTEX_INITIALIZER;
+static int16_t ring[RING_FRAMES * 2];
+static uint32_t ringHead = 0;
+static uint32_t ringCount = 0;
+// Channels of the last stream written. The fill state counts 16 bit
+// samples in that format, two per stereo frame, like the firmware
+static uint32_t ringChannels = 1;
+static bool listening = false;
+static bool realtime = true;
+static uint8_t globalVolume = 100;
+
+// Real time draining: frames due since listen mode started
+static uint64_t drainStartUs = 0;
+static uint64_t drainedFrames = 0;
+// Nothing counts as an underrun before the first samples arrive
+static bool primed = false;
+static bool starving = false;
+
+static int16_t *captureBuf = NULL;
+static uint32_t captureMax = 0;
+static uint32_t captured = 0;
+
+static vmupro_host_audio_stats_t audioStats;
+
+// Play frames from the ring, caller holds audioLock
+static uint32_t PlayLocked(uint32_t frames)
+{
+  uint32_t played = frames < ringCount ? frames : ringCount;
+  for (uint32_t i = 0; i < played; i++)
+  {
+    uint32_t at = (ringHead + i) % RING_FRAMES;
+    if (captureBuf != NULL && captured < captureMax)
+    {
+      captureBuf[captured * 2] = ring[at * 2];
+      captureBuf[captured * 2 + 1] = ring[at * 2 + 1];
+      captured++;
+    }
+  }
+  ringHead = (ringHead + played) % RING_FRAMES;
+  ringCount -= played;
+  audioStats.frames_played += played;
+
+  if (played < frames && primed)
+  {
+    if (!starving)
+      audioStats.underruns++;
+    audioStats.underrun_frames += frames - played;
+    starving = true;
+  }
+  else if (played == frames && frames != 0)
+  {
+    starving = false;
+  }
+  return played;
+}
+
+static void CatchUpLocked(void)
+{
+  if (!realtime || !listening)
+    return;
+  uint64_t due = (vmupro_get_time_us() - drainStartUs) * OUTPUT_RATE / 1000000ull;
+  if (due > drainedFrames)
+  {
+    uint64_t frames = due - drainedFrames;
+    drainedFrames = due;
+    PlayLocked(frames > RING_FRAMES * 2 ? RING_FRAMES * 2 : (uint32_t)frames);
+  }
+}
+
+bool vmupro_audio_start_listen_mode(void)
+{
+  pthread_mutex_lock(&audioLock);
+  listening = true;
+  ringHead = 0;
+  ringCount = 0;
+  drainStartUs = vmupro_get_time_us();
+  drainedFrames = 0;
+  primed = false;
+  starving = false;
+  pthread_mutex_unlock(&audioLock);
+  return true;
+}
+
+void vmupro_audio_exit_listen_mode(void)
+{
+  pthread_mutex_lock(&audioLock);
+  listening = false;
+  ringCount = 0;
+  pthread_mutex_unlock(&audioLock);
+}
+
+void vmupro_audio_add_stream_samples(int16_t *samples, int numSamples, vmupro_stereo_mode_t stereo_mode,
+                                     bool applyGlobalVolume)
+{
+  if (samples == NULL || numSamples <= 0)
+    return;
+
+  bool stereo = stereo_mode == VMUPRO_AUDIO_STEREO;
+  uint32_t frames = stereo ? (uint32_t)numSamples / 2 : (uint32_t)numSamples;
+  uint32_t done = 0;
+
+  pthread_mutex_lock(&audioLock);
+  if (!listening)
+  {
+    pthread_mutex_unlock(&audioLock);
+    return;
+  }
+  int volume = applyGlobalVolume ? globalVolume : 100;
+  ringChannels = stereo ? 2 : 1;
+  audioStats.frames_queued += frames;
+  primed = true;
+  while (done < frames)
+  {
+    CatchUpLocked();
+    uint32_t space = RING_FRAMES - ringCount;
+    if (space == 0)
+    {
+      if (!realtime)
+      {
+        // nothing drains the ring in manual mode, so the rest is lost
+        audioStats.overflow_frames += frames - done;
+        break;
+      }
+      // block until the output has made room, like the firmware does
+      pthread_mutex_unlock(&audioLock);
+      vmupro_delay_us(500);
+      pthread_mutex_lock(&audioLock);
+      continue;
+    }
+
+    uint32_t n = frames - done < space ? frames - done : space;
+    for (uint32_t i = 0; i < n; i++)
+    {
+      int left, right;
+      if (stereo)
+      {
+        left = samples[(done + i) * 2];
+        right = samples[(done + i) * 2 + 1];
+      }
+      else
+      {
+        left = right = samples[done + i];
+      }
+      uint32_t at = (ringHead + ringCount + i) % RING_FRAMES;
+      ring[at * 2] = (int16_t)(left * volume / 100);
+      ring[at * 2 + 1] = (int16_t)(right * volume / 100);
+    }
+    ringCount += n;
+    done += n;
+  }
+  pthread_mutex_unlock(&audioLock);
+}
+
+void vmupro_audio_clear_ring_buffer(void)
+{
+  pthread_mutex_lock(&audioLock);
+  ringCount = 0;
+  pthread_mutex_unlock(&audioLock);
+}
+
+uint8_t vmupro_get_global_volume(void)
+{
+  return globalVolume;
+}
+
+void vmupro_set_global_volume(uint8_t volume)
+{
+  globalVolume = volume > 100 ? 100 : volume;
+}
+
+int vmupro_get_ringbuffer_fill_state(uint32_t *outBufferFilledSamples, uint32_t *outBufferSizeInsamples)
+{
+  pthread_mutex_lock(&audioLock);
+  CatchUpLocked();
+  uint32_t filled = ringCount;
+  uint32_t channels = ringChannels;
+  pthread_mutex_unlock(&audioLock);
+
+  if (outBufferFilledSamples)
+    *outBufferFilledSamples = filled * channels;
+  if (outBufferSizeInsamples)
+    *outBufferSizeInsamples = RING_FRAMES * channels;
+  return (int)(filled * 100 / RING_FRAMES);
+}
+
+//
+// Host hooks
+//
+
+void vmupro_host_audio_reset(void)
+{
+  pthread_mutex_lock(&audioLock);
+  listening = false;
+  realtime = true;
+  globalVolume = 100;
+  ringHead = 0;
+  ringCount = 0;
+  ringChannels = 1;
+  primed = false;
+  starving = false;
+  captureBuf = NULL;
+  captureMax = 0;
+  captured = 0;
+  memset(&audioStats, 0, sizeof(audioStats));
+  pthread_mutex_unlock(&audioLock);
+}
+
+void vmupro_host_audio_set_realtime(bool enabled)
+{
+  pthread_mutex_lock(&audioLock);
+  realtime = enabled;
+  drainStartUs = vmupro_get_time_us();
+  drainedFrames = 0;
+  pthread_mutex_unlock(&audioLock);
+}
+
+uint32_t vmupro_host_audio_drain(uint32_t frames)
+{
+  pthread_mutex_lock(&audioLock);
+  uint32_t played = PlayLocked(frames);
+  pthread_mutex_unlock(&audioLock);
+  return played;
+}
+
+void vmupro_host_audio_capture(int16_t *stereo, uint32_t max_frames)
+{
+  pthread_mutex_lock(&audioLock);
+  captureBuf = stereo;
+  captureMax = stereo != NULL ? max_frames : 0;
+  captured = 0;
+  pthread_mutex_unlock(&audioLock);
+}
+
+uint32_t vmupro_host_audio_captured(void)
+{
+  pthread_mutex_lock(&audioLock);
+  uint32_t frames = captured;
+  pthread_mutex_unlock(&audioLock);
+  return frames;
+}
+
+void vmupro_host_audio_get_stats(vmupro_host_audio_stats_t *out_stats)
+{
+  if (out_stats == NULL)
+    return;
+  pthread_mutex_lock(&audioLock);
+  *out_stats = audioStats;
+  pthread_mutex_unlock(&audioLock);
+}
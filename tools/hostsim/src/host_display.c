@@ -0,0 +1,4011 @@
+// tools/hostsim/src/host_display.c
+//
+// Portable reference implementation of vmupro_display.h
+// Renders into in-memory 240x240 RGB565 (big endian) framebuffers
+// so draw code can be run and timed off-device.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "vmupro_sdk.h"
+#include "vmupro_host.h"
+
+#define SCREEN_W VMUPRO_HOST_SCREEN_WIDTH
+#define SCREEN_H VMUPRO_HOST_SCREEN_HEIGHT
+#define FB_PIXELS (SCREEN_W * SCREEN_H)
+#define FB_BYTES (FB_PIXELS * 2)
+
+// fb[0]/fb[1] are the two sides of the double buffer, fb[2] is the
+// third buffer used with triple buffering
+// panel is what the (simulated) display controller last received
+static uint16_t fb[3][FB_PIXELS];
+static uint16_t panel[FB_PIXELS];
+static int backSide = 0;
+static int frontSide = 1;
+static int lastBlittedSide = 0;
+static bool doubleBufferRunning = false;
+static bool doubleBufferPaused = false;
+static uint8_t brightness = 100;
+static vmupro_host_stats_t stats;
+
+// Areas touched since the last push/refresh, kept merged
+static bool partialUpdates = false;
+static vmupro_rect_t dirtyRects[VMUPRO_MAX_DIRTY_RECTS];
+static int dirtyCount = 0;
+
+typedef struct
+{
+  bool active;
+  int x1, y1, x2, y2;
+  uint16_t mask;
+} ColorWindow;
+static ColorWindow colorWindow;
+
+static vmupro_layer_t layers[VMUPRO_MAX_LAYERS];
+
+//
+// Pixel helpers
+//
+
+// Buffers hold big endian RGB565, swap to do channel maths
+static inline uint16_t Swap16(uint16_t v)
+{
+  return (uint16_t)((v >> 8) | (v << 8));
+}
+
+static inline int R5(uint16_t native) { return native >> 11; }
+static inline int G6(uint16_t native) { return (native >> 5) & 0x3f; }
+static inline int B5(uint16_t native) { return native & 0x1f; }
+
+static inline uint16_t Pack565(int r, int g, int b)
+{
+  return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static inline int Clamp(int v, int lo, int hi)
+{
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// Blend two big endian pixels, alpha 0-255 (255 = all src)
+static inline uint16_t BlendBE(uint16_t srcBE, uint16_t dstBE, int alpha)
+{
+  uint16_t s = Swap16(srcBE);
+  uint16_t d = Swap16(dstBE);
+  int inv = 255 - alpha;
+  int r = (R5(s) * alpha + R5(d) * inv) / 255;
+  int g = (G6(s) * alpha + G6(d) * inv) / 255;
+  int b = (B5(s) * alpha + B5(d) * inv) / 255;
+  return Swap16(Pack565(r, g, b));
+}
+
+static inline uint16_t *Target(void)
+{
+  return fb[backSide];
+}
+
+static inline uint16_t LoadPx(const uint8_t *buffer, int index)
+{
+  uint16_t v;
+  memcpy(&v, buffer + index * 2, 2);
+  return v;
+}
+
+// Whether the color window rejects this write
+static inline bool WindowBlocks(int x, int y, uint16_t c)
+{
+  if (!colorWindow.active)
+    return false;
+  if (x < colorWindow.x1 || x > colorWindow.x2 || y < colorWindow.y1 || y > colorWindow.y2)
+    return false;
+  return c != colorWindow.mask;
+}
+
+static inline void PutPx(int x, int y, uint16_t c)
+{
+  if ((unsigned)x >= SCREEN_W || (unsigned)y >= SCREEN_H)
+    return;
+  if (WindowBlocks(x, y, c))
+    return;
+  Target()[y * SCREEN_W + x] = c;
+}
+
+static inline uint16_t GetPx(int x, int y)
+{
+  return Target()[y * SCREEN_W + x];
+}
+
+// Positive modulo, safe for negative and huge inputs
+static inline int WrapMod(int v, int m)
+{
+  int r = v % m;
+  return r < 0 ? r + m : r;
+}
+
+//
+// Clipping
+//
+
+// Visible part of a w*h rect placed at x,y
+// sx/sy are the offsets into the (unflipped) rect
+typedef struct
+{
+  int dx, dy;
+  int sx, sy;
+  int w, h;
+} Clip;
+
+static bool ClipRect(int x, int y, int w, int h, Clip *out)
+{
+  if (w <= 0 || h <= 0)
+    return false;
+
+  int x0 = x < 0 ? 0 : x;
+  int y0 = y < 0 ? 0 : y;
+  int x1 = x + w > SCREEN_W ? SCREEN_W : x + w;
+  int y1 = y + h > SCREEN_H ? SCREEN_H : y + h;
+  if (x0 >= x1 || y0 >= y1)
+    return false;
+
+  out->dx = x0;
+  out->dy = y0;
+  out->sx = x0 - x;
+  out->sy = y0 - y;
+  out->w = x1 - x0;
+  out->h = y1 - y0;
+  return true;
+}
+
+//
+// Dirty rectangle tracking
+//
+
+static inline int RectArea(const vmupro_rect_t *r)
+{
+  return r->width * r->height;
+}
+
+static vmupro_rect_t RectUnion(const vmupro_rect_t *a, const vmupro_rect_t *b)
+{
+  int x0 = a->x < b->x ? a->x : b->x;
+  int y0 = a->y < b->y ? a->y : b->y;
+  int x1 = a->x + a->width > b->x + b->width ? a->x + a->width : b->x + b->width;
+  int y1 = a->y + a->height > b->y + b->height ? a->y + a->height : b->y + b->height;
+  return (vmupro_rect_t){x0, y0, x1 - x0, y1 - y0};
+}
+
+// Overlapping or sharing an edge
+static inline bool RectsTouch(const vmupro_rect_t *a, const vmupro_rect_t *b)
+{
+  return a->x <= b->x + b->width && b->x <= a->x + a->width &&
+         a->y <= b->y + b->height && b->y <= a->y + a->height;
+}
+
+static void MarkDirty(int x, int y, int w, int h)
+{
+  Clip c;
+  if (!ClipRect(x, y, w, h, &c))
+    return;
+
+  vmupro_rect_t r = {c.dx, c.dy, c.w, c.h};
+  if (r.width == SCREEN_W && r.height == SCREEN_H)
+  {
+    dirtyRects[0] = r;
+    dirtyCount = 1;
+    return;
+  }
+
+  // Fold r into anything it touches, then keep folding while the grown
+  // rect touches more. When the list is full, fold into whichever entry
+  // grows the least. The list therefore never holds overlapping rects.
+  while (true)
+  {
+    int merge = -1;
+    for (int i = 0; i < dirtyCount; i++)
+    {
+      if (RectsTouch(&dirtyRects[i], &r))
+      {
+        merge = i;
+        break;
+      }
+    }
+
+    if (merge < 0 && dirtyCount == VMUPRO_MAX_DIRTY_RECTS)
+    {
+      int bestGrowth = 0;
+      for (int i = 0; i < dirtyCount; i++)
+      {
+        vmupro_rect_t u = RectUnion(&dirtyRects[i], &r);
+        int growth = RectArea(&u) - RectArea(&dirtyRects[i]);
+        if (merge < 0 || growth < bestGrowth)
+        {
+          merge = i;
+          bestGrowth = growth;
+        }
+      }
+    }
+
+    if (merge < 0)
+      break;
+
+    r = RectUnion(&r, &dirtyRects[merge]);
+    dirtyRects[merge] = dirtyRects[--dirtyCount];
+  }
+
+  dirtyRects[dirtyCount++] = r;
+}
+
+static inline void MarkDirtyFull(void)
+{
+  MarkDirty(0, 0, SCREEN_W, SCREEN_H);
+}
+
+// ClipRect for blit destinations, records the visible area as dirty
+static bool ClipDest(int x, int y, int w, int h, Clip *out)
+{
+  if (!ClipRect(x, y, w, h, out))
+    return false;
+  MarkDirty(out->dx, out->dy, out->w, out->h);
+  return true;
+}
+
+// Send the back buffer (or just its dirty areas) to the panel
+static void TransferToPanel(const uint16_t *src)
+{
+  if (!partialUpdates)
+  {
+    memcpy(panel, src, FB_BYTES);
+    stats.bytes_transferred += FB_BYTES;
+    return;
+  }
+
+  for (int i = 0; i < dirtyCount; i++)
+  {
+    const vmupro_rect_t *r = &dirtyRects[i];
+    for (int y = r->y; y < r->y + r->height; y++)
+      memcpy(panel + y * SCREEN_W + r->x, src + y * SCREEN_W + r->x, r->width * 2);
+    stats.bytes_transferred += (uint64_t)RectArea(r) * 2;
+  }
+  stats.dirty_rects_sent += dirtyCount;
+}
+
+void vmupro_set_partial_update_mode(bool enabled)
+{
+  partialUpdates = enabled;
+  // the panel may not match the back buffer yet
+  if (enabled)
+    MarkDirtyFull();
+}
+
+bool vmupro_get_partial_update_mode(void)
+{
+  return partialUpdates;
+}
+
+void vmupro_mark_dirty_rect(int x, int y, int width, int height)
+{
+  MarkDirty(x, y, width, height);
+}
+
+int vmupro_get_dirty_rects(vmupro_rect_t *out_rects, int max_rects)
+{
+  if (out_rects != NULL)
+  {
+    for (int i = 0; i < dirtyCount && i < max_rects; i++)
+      out_rects[i] = dirtyRects[i];
+  }
+  return dirtyCount;
+}
+
+//
+// Display list recording
+//
+// Commands are packed from the start of the arena: a DlCommand header,
+// the arguments as DlArg words, then any copied parameter block. The
+// index grows down from the end, one uint64_t per draw command:
+// bits 0-31 command offset, 32-47 layer + 32768, bit 48 culled.
+// Colour window changes are stored as commands too, but not indexed;
+// each draw command refers to the window that was current when it was
+// recorded (offset + 1, or 0 for whatever was set before recording).
+//
+
+typedef intptr_t DlArg;
+
+typedef enum
+{
+  DL_SET_WINDOW = 1,
+  DL_CLEAR_WINDOW,
+  DL_CLEAR,
+  DL_DRAW_RECT,
+  DL_FILL_RECT,
+  DL_LINE,
+  DL_CIRCLE,
+  DL_CIRCLE_FILLED,
+  DL_ELLIPSE,
+  DL_ELLIPSE_FILLED,
+  DL_POLYGON_FILLED,
+  DL_FLOOD_FILL,
+  DL_FLOOD_FILL_TOLERANCE,
+  DL_BLIT_AT,
+  DL_BLIT_PALETTE,
+  DL_BLIT_TRANSPARENT,
+  DL_BLIT_BLENDED,
+  DL_BLIT_DITHERED,
+  DL_BLIT_FLIP_H,
+  DL_BLIT_FLIPPED,
+  DL_BLIT_SCALED,
+  DL_BLIT_ADVANCED,
+  DL_BLIT_ROTATED_90,
+  DL_BLIT_AFFINE,
+  DL_TILE_PATTERN,
+  DL_TILE,
+  DL_TILE_ADVANCED,
+  DL_SCROLLING_BG,
+  DL_INFINITE_BG,
+  DL_LINE_SCROLL_BG,
+  DL_COLUMN_SCROLL_BG,
+  DL_MOSAIC,
+  DL_MOSAIC_SCREEN,
+  DL_BLURRED,
+  DL_SHADOW_HIGHLIGHT,
+  DL_COLOR_MULTIPLY,
+  DL_COLOR_ADD,
+  DL_FIXED_ALPHA,
+  DL_MASKED,
+  DL_PALETTE_SWAP,
+  DL_SPRITE_BATCH,
+  DL_TILEMAP,
+  DL_RENDER_LAYERS,
+  DL_RENDER_RASTER,
+  DL_TEXT,
+} DlOp;
+
+// Writes every pixel of its bounds when no colour window is active
+#define DL_OPAQUE 0x01
+// Reads the screen outside its own output, nothing is culled across it
+#define DL_BARRIER 0x02
+// Calls back into the app, never culled
+#define DL_KEEP 0x04
+
+typedef struct
+{
+  uint8_t op;
+  uint8_t argc;
+  uint8_t flags;
+  uint8_t pad;
+  int16_t layer;
+  int16_t x0, y0, x1, y1; // clipped bounds, x1/y1 exclusive (x0 == x1 when off screen)
+  uint16_t pad2;
+  uint32_t window;
+  uint32_t dataSize;
+} DlCommand;
+
+#define DL_ALIGN(n) (((n) + 7u) & ~7u)
+#define DL_CULLED (1ull << 48)
+
+// Recording is per thread, the host's stand-in for per core
+static _Thread_local vmupro_display_list_t *recording;
+
+static inline const DlArg *DlArgs(const DlCommand *cmd)
+{
+  return (const DlArg *)(cmd + 1);
+}
+
+static inline void *DlData(const DlCommand *cmd)
+{
+  return (uint8_t *)(cmd + 1) + DL_ALIGN(cmd->argc * sizeof(DlArg));
+}
+
+static inline DlCommand *DlAt(const vmupro_display_list_t *list, uint32_t offset)
+{
+  return (DlCommand *)(list->arena + offset);
+}
+
+static inline uint64_t *DlIndex(const vmupro_display_list_t *list)
+{
+  return (uint64_t *)(list->arena + list->size) - list->count;
+}
+
+// Corner to corner rect, either order, both corners inside
+static inline vmupro_rect_t CornerRect(int x1, int y1, int x2, int y2)
+{
+  vmupro_rect_t r = {x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2, abs(x2 - x1) + 1, abs(y2 - y1) + 1};
+  return r;
+}
+
+static void RecordCommand(DlOp op, int flags, vmupro_rect_t bounds, const DlArg *args, int argc,
+                          const void *data, uint32_t dataSize)
+{
+  vmupro_display_list_t *list = recording;
+  bool draw = op != DL_SET_WINDOW && op != DL_CLEAR_WINDOW;
+  uint32_t bytes = sizeof(DlCommand) + DL_ALIGN(argc * sizeof(DlArg)) + DL_ALIGN(dataSize);
+  uint32_t indexBytes = (list->count + (draw ? 1 : 0)) * sizeof(uint64_t);
+  if (list->overflow || list->used + bytes + indexBytes > list->size)
+  {
+    list->overflow = true;
+    return;
+  }
+
+  DlCommand *cmd = DlAt(list, list->used);
+  memset(cmd, 0, sizeof(*cmd));
+  cmd->op = (uint8_t)op;
+  cmd->argc = (uint8_t)argc;
+  cmd->flags = (uint8_t)flags;
+  cmd->layer = list->layer;
+  cmd->window = list->window;
+  cmd->dataSize = dataSize;
+
+  // opaque draws only occlude when nothing can mask them out
+  if (list->window != 0 && DlAt(list, list->window - 1)->op == DL_SET_WINDOW)
+    cmd->flags &= ~DL_OPAQUE;
+
+  Clip c;
+  if (ClipRect(bounds.x, bounds.y, bounds.width, bounds.height, &c))
+  {
+    cmd->x0 = (int16_t)c.dx;
+    cmd->y0 = (int16_t)c.dy;
+    cmd->x1 = (int16_t)(c.dx + c.w);
+    cmd->y1 = (int16_t)(c.dy + c.h);
+  }
+  if (argc > 0)
+    memcpy((void *)DlArgs(cmd), args, argc * sizeof(DlArg));
+  if (dataSize > 0)
+    memcpy(DlData(cmd), data, dataSize);
+
+  if (draw)
+  {
+    list->count++;
+    DlIndex(list)[0] = ((uint64_t)(uint16_t)(list->layer + 32768) << 32) | list->used;
+  }
+  else
+  {
+    list->window = list->used + 1;
+  }
+  list->used += bytes;
+}
+
+// At the top of each drawing call: while recording, append the command
+// and return instead of drawing
+#define DL_RECORD(op, flags, bounds, data, dataSize, ...)                                   \
+  do                                                                                        \
+  {                                                                                         \
+    if (recording != NULL)                                                                  \
+    {                                                                                       \
+      const DlArg dlArgs[] = {__VA_ARGS__};                                                 \
+      RecordCommand(op, flags, bounds, dlArgs, sizeof(dlArgs) / sizeof(dlArgs[0]), data, dataSize); \
+      return;                                                                               \
+    }                                                                                       \
+  } while (0)
+
+#define DL_PTR(p) ((DlArg)(p))
+#define DL_FULL_SCREEN ((vmupro_rect_t){0, 0, SCREEN_W, SCREEN_H})
+#define DL_RECT(x, y, w, h) ((vmupro_rect_t){(x), (y), (w), (h)})
+
+void vmupro_display_list_init(vmupro_display_list_t *list, void *arena, uint32_t arena_size)
+{
+  if (list == NULL)
+    return;
+  memset(list, 0, sizeof(*list));
+  list->arena = arena;
+  list->size = arena == NULL ? 0 : arena_size & ~7u;
+}
+
+void vmupro_display_list_begin(vmupro_display_list_t *list)
+{
+  if (list == NULL)
+    return;
+  list->used = 0;
+  list->count = 0;
+  list->window = 0;
+  list->layer = 0;
+  list->overflow = false;
+  recording = list;
+}
+
+void vmupro_display_list_set_layer(int layer)
+{
+  if (recording != NULL)
+    recording->layer = (int16_t)Clamp(layer, INT16_MIN, INT16_MAX);
+}
+
+bool vmupro_display_list_end(void)
+{
+  vmupro_display_list_t *list = recording;
+  recording = NULL;
+  return list != NULL && !list->overflow;
+}
+
+//
+// Generic per-pixel blit used by most effect paths
+// op receives the source pixel and the existing dest pixel and returns
+// the pixel to write, or false to leave the destination untouched
+//
+
+typedef bool (*PixelOp)(uint16_t src, uint16_t dst, int x, int y, void *ctx, uint16_t *out);
+
+static void BlitGeneric(const uint8_t *buffer, int x, int y, int width, int height,
+                        vmupro_drawflags_t flags, PixelOp op, void *ctx)
+{
+  Clip c;
+  if (buffer == NULL || !ClipDest(x, y, width, height, &c))
+    return;
+
+  for (int row = 0; row < c.h; row++)
+  {
+    int sy = c.sy + row;
+    if (flags & VMUPRO_DRAWFLAGS_FLIP_V)
+      sy = height - 1 - sy;
+    int dy = c.dy + row;
+    uint16_t *dst = Target() + dy * SCREEN_W;
+
+    for (int col = 0; col < c.w; col++)
+    {
+      int sx = c.sx + col;
+      if (flags & VMUPRO_DRAWFLAGS_FLIP_H)
+        sx = width - 1 - sx;
+      int dx = c.dx + col;
+      uint16_t out;
+      if (op(LoadPx(buffer, sy * width + sx), dst[dx], dx, dy, ctx, &out) && !WindowBlocks(dx, dy, out))
+        dst[dx] = out;
+    }
+  }
+}
+
+static bool OpCopy(uint16_t src, uint16_t dst, int x, int y, void *ctx, uint16_t *out)
+{
+  (void)dst, (void)x, (void)y, (void)ctx;
+  *out = src;
+  return true;
+}
+
+static bool OpKey(uint16_t src, uint16_t dst, int x, int y, void *ctx, uint16_t *out)
+{
+  (void)dst, (void)x, (void)y;
+  if (src == *(uint16_t *)ctx)
+    return false;
+  *out = src;
+  return true;
+}
+
+//
+// Split rendering
+//
+// Full screen passes hand the bottom band to a worker thread (the second
+// core on the device) and draw the top band on the calling thread. Bands
+// never overlap, and dirty marking stays on the calling thread.
+//
+
+typedef void (*BandFn)(int begin, int end, void *ctx);
+
+static bool splitRendering = false;
+static pthread_t splitThread;
+static pthread_mutex_t splitLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t splitCond = PTHREAD_COND_INITIALIZER;
+static struct
+{
+  BandFn fn;
+  int begin, end;
+  void *ctx;
+  bool pending;
+  bool quit;
+} splitJob;
+
+static void *SplitWorkerMain(void *arg)
+{
+  (void)arg;
+  pthread_mutex_lock(&splitLock);
+  for (;;)
+  {
+    while (!splitJob.pending && !splitJob.quit)
+      pthread_cond_wait(&splitCond, &splitLock);
+    if (splitJob.quit)
+      break;
+    pthread_mutex_unlock(&splitLock);
+    splitJob.fn(splitJob.begin, splitJob.end, splitJob.ctx);
+    pthread_mutex_lock(&splitLock);
+    splitJob.pending = false;
+    pthread_cond_broadcast(&splitCond);
+  }
+  pthread_mutex_unlock(&splitLock);
+  return NULL;
+}
+
+// Wait until the second core has finished its band
+static void SplitBarrier(void)
+{
+  if (!splitRendering)
+    return;
+  pthread_mutex_lock(&splitLock);
+  while (splitJob.pending)
+    pthread_cond_wait(&splitCond, &splitLock);
+  pthread_mutex_unlock(&splitLock);
+}
+
+// Run fn over [begin, end), halved at a multiple of align (counted from
+// begin) when split rendering is on
+static void RunSplit(BandFn fn, int begin, int end, int align, void *ctx)
+{
+  int mid = begin + ((end - begin) / 2 / align) * align;
+  if (!splitRendering || mid <= begin || mid >= end)
+  {
+    fn(begin, end, ctx);
+    return;
+  }
+
+  pthread_mutex_lock(&splitLock);
+  splitJob.fn = fn;
+  splitJob.begin = mid;
+  splitJob.end = end;
+  splitJob.ctx = ctx;
+  splitJob.pending = true;
+  pthread_cond_broadcast(&splitCond);
+  pthread_mutex_unlock(&splitLock);
+
+  fn(begin, mid, ctx);
+  SplitBarrier();
+}
+
+void vmupro_set_split_rendering(bool enabled)
+{
+  if (enabled == splitRendering)
+    return;
+
+  if (enabled)
+  {
+    splitJob.pending = false;
+    splitJob.quit = false;
+    if (pthread_create(&splitThread, NULL, SplitWorkerMain, NULL) != 0)
+      return;
+    splitRendering = true;
+    return;
+  }
+
+  SplitBarrier();
+  pthread_mutex_lock(&splitLock);
+  splitJob.quit = true;
+  pthread_cond_broadcast(&splitCond);
+  pthread_mutex_unlock(&splitLock);
+  pthread_join(splitThread, NULL);
+  splitRendering = false;
+}
+
+bool vmupro_get_split_rendering(void)
+{
+  return splitRendering;
+}
+
+//
+// Display management
+//
+
+void vmupro_display_clear(vmupro_color_t color)
+{
+  DL_RECORD(DL_CLEAR, DL_OPAQUE, DL_FULL_SCREEN, NULL, 0, color);
+  uint16_t c = (uint16_t)color;
+  uint16_t *t = Target();
+  MarkDirtyFull();
+  if (colorWindow.active)
+  {
+    for (int y = 0; y < SCREEN_H; y++)
+      for (int x = 0; x < SCREEN_W; x++)
+        PutPx(x, y, c);
+    return;
+  }
+  for (int i = 0; i < FB_PIXELS; i++)
+    t[i] = c;
+}
+
+void vmupro_display_refresh()
+{
+  SplitBarrier();
+  TransferToPanel(Target());
+  stats.refreshes++;
+  dirtyCount = 0;
+}
+
+uint8_t vmupro_get_global_brightness(void)
+{
+  return brightness;
+}
+
+void vmupro_set_global_brightness(uint8_t value)
+{
+  brightness = value > 100 ? 100 : value;
+}
+
+uint8_t *vmupro_get_front_fb()
+{
+  return (uint8_t *)fb[frontSide];
+}
+
+uint8_t *vmupro_get_back_fb()
+{
+  return (uint8_t *)fb[backSide];
+}
+
+uint8_t *vmupro_get_back_buffer()
+{
+  return (uint8_t *)fb[backSide];
+}
+
+void vmupro_start_double_buffer_renderer()
+{
+  doubleBufferRunning = true;
+  doubleBufferPaused = false;
+}
+
+void vmupro_stop_double_buffer_renderer()
+{
+  doubleBufferRunning = false;
+  doubleBufferPaused = false;
+}
+
+void vmupro_pause_double_buffer_renderer()
+{
+  if (doubleBufferRunning)
+    doubleBufferPaused = true;
+}
+
+void vmupro_resume_double_buffer_renderer()
+{
+  doubleBufferPaused = false;
+}
+
+//
+// Panel transfers
+//
+
+// Pushed frames are sent one at a time: transfers[0] is in flight and
+// transfers[1] queued behind it (triple buffering only). The host copies
+// the pixels to the panel at push time and only models how long sending
+// them takes, so pushes stall like they do on the device.
+typedef struct
+{
+  int side;
+  uint64_t done_us;
+} PanelTransfer;
+static PanelTransfer transfers[2];
+static int transferCount = 0;
+static uint32_t transferFrameUs = 0;
+static bool tripleBuffering = false;
+static uint64_t lastPresentUs = 0;
+static vmupro_frame_done_callback_t frameDoneCallback = NULL;
+static void *frameDoneUser = NULL;
+
+// Partial updates bring the new back buffer up to date from the frame
+// just pushed. With three buffers it can be two frames behind, so the
+// dirty areas of the previous push are kept as well
+static uint64_t pushSerial = 0;
+static uint64_t sideSerial[3];
+static vmupro_rect_t prevDirtyRects[VMUPRO_MAX_DIRTY_RECTS];
+static int prevDirtyCount = 0;
+
+static int TransferSlots(void)
+{
+  return tripleBuffering ? 2 : 1;
+}
+
+static void RetireTransfers(uint64_t now)
+{
+  while (transferCount > 0 && transfers[0].done_us <= now)
+  {
+    frontSide = transfers[0].side;
+    lastPresentUs = transfers[0].done_us;
+    transfers[0] = transfers[1];
+    transferCount--;
+    if (frameDoneCallback)
+      frameDoneCallback(lastPresentUs, frameDoneUser);
+  }
+}
+
+static void WaitForTransferSlot(void)
+{
+  RetireTransfers(vmupro_get_time_us());
+  if (transferCount < TransferSlots())
+    return;
+
+  stats.push_stalls++;
+  while (transferCount >= TransferSlots())
+  {
+    uint64_t now = vmupro_get_time_us();
+    if (transfers[0].done_us > now)
+      vmupro_delay_us(transfers[0].done_us - now);
+    RetireTransfers(vmupro_get_time_us());
+  }
+}
+
+static bool SideInFlight(int side)
+{
+  for (int i = 0; i < transferCount; i++)
+    if (transfers[i].side == side)
+      return true;
+  return false;
+}
+
+// The most recently pushed buffer that isn't being sent, so partial
+// updates have the least to catch up on
+static int NextBackSide(int pushed)
+{
+  int best = -1;
+  for (int side = 0; side < (tripleBuffering ? 3 : 2); side++)
+  {
+    if (side == pushed || SideInFlight(side))
+      continue;
+    if (best < 0 || sideSerial[side] > sideSerial[best])
+      best = side;
+  }
+  return best;
+}
+
+static void CopyRects(uint16_t *dst, const uint16_t *src, const vmupro_rect_t *rects, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    const vmupro_rect_t *r = &rects[i];
+    for (int y = r->y; y < r->y + r->height; y++)
+      memcpy(dst + y * SCREEN_W + r->x, src + y * SCREEN_W + r->x, r->width * 2);
+  }
+}
+
+void vmupro_push_double_buffer_frame()
+{
+  if (!doubleBufferRunning || doubleBufferPaused)
+    return;
+
+  SplitBarrier();
+  WaitForTransferSlot();
+
+  uint64_t sentBefore = stats.bytes_transferred;
+  TransferToPanel(fb[backSide]);
+  stats.frames_pushed++;
+
+  // queue behind the frame in flight, if any
+  uint64_t now = vmupro_get_time_us();
+  uint64_t start = transferCount ? transfers[transferCount - 1].done_us : now;
+  uint64_t bytes = stats.bytes_transferred - sentBefore;
+  transfers[transferCount].side = backSide;
+  transfers[transferCount].done_us = start + transferFrameUs * bytes / FB_BYTES;
+  transferCount++;
+
+  int pushed = backSide;
+  lastBlittedSide = pushed;
+  sideSerial[pushed] = ++pushSerial;
+  backSide = NextBackSide(pushed);
+
+  // Bring the new back buffer up to date with what was just sent,
+  // so apps only need to redraw what changes next frame
+  if (partialUpdates)
+  {
+    uint64_t behind = pushSerial - sideSerial[backSide];
+    if (behind > 2)
+    {
+      memcpy(fb[backSide], fb[pushed], FB_BYTES);
+    }
+    else
+    {
+      CopyRects(fb[backSide], fb[pushed], dirtyRects, dirtyCount);
+      if (behind == 2)
+        CopyRects(fb[backSide], fb[pushed], prevDirtyRects, prevDirtyCount);
+    }
+  }
+  memcpy(prevDirtyRects, dirtyRects, sizeof(vmupro_rect_t) * dirtyCount);
+  prevDirtyCount = dirtyCount;
+  dirtyCount = 0;
+
+  // instant transfers complete here
+  RetireTransfers(now);
+}
+
+bool vmupro_try_push_double_buffer_frame(void)
+{
+  if (!doubleBufferRunning || doubleBufferPaused)
+    return false;
+
+  RetireTransfers(vmupro_get_time_us());
+  if (transferCount >= TransferSlots())
+    return false;
+  vmupro_push_double_buffer_frame();
+  return true;
+}
+
+void vmupro_set_triple_buffering(bool enabled)
+{
+  tripleBuffering = enabled;
+}
+
+bool vmupro_get_triple_buffering(void)
+{
+  return tripleBuffering;
+}
+
+int vmupro_get_pending_frames(void)
+{
+  RetireTransfers(vmupro_get_time_us());
+  return transferCount;
+}
+
+uint64_t vmupro_get_last_present_time_us(void)
+{
+  RetireTransfers(vmupro_get_time_us());
+  return lastPresentUs;
+}
+
+void vmupro_set_frame_done_callback(vmupro_frame_done_callback_t callback, void *user_data)
+{
+  frameDoneCallback = callback;
+  frameDoneUser = user_data;
+}
+
+uint8_t vmupro_get_last_blitted_fb_side()
+{
+  return (uint8_t)lastBlittedSide;
+}
+
+//
+// Primitives
+//
+
+static void HLine(int x1, int x2, int y, uint16_t c)
+{
+  if ((unsigned)y >= SCREEN_H)
+    return;
+  if (x1 > x2)
+  {
+    int t = x1;
+    x1 = x2;
+    x2 = t;
+  }
+  x1 = x1 < 0 ? 0 : x1;
+  x2 = x2 >= SCREEN_W ? SCREEN_W - 1 : x2;
+  uint16_t *row = Target() + y * SCREEN_W;
+  for (int x = x1; x <= x2; x++)
+  {
+    if (!WindowBlocks(x, y, c))
+      row[x] = c;
+  }
+}
+
+void vmupro_draw_rect(int x1, int y1, int x2, int y2, vmupro_color_t color)
+{
+  DL_RECORD(DL_DRAW_RECT, 0, CornerRect(x1, y1, x2, y2), NULL, 0, x1, y1, x2, y2, color);
+  uint16_t c = (uint16_t)color;
+  MarkDirty(x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2, abs(x2 - x1) + 1, abs(y2 - y1) + 1);
+  HLine(x1, x2, y1, c);
+  HLine(x1, x2, y2, c);
+  int top = y1 < y2 ? y1 : y2;
+  int bottom = y1 < y2 ? y2 : y1;
+  for (int y = top; y <= bottom; y++)
+  {
+    PutPx(x1, y, c);
+    PutPx(x2, y, c);
+  }
+}
+
+void vmupro_draw_fill_rect(int x1, int y1, int x2, int y2, vmupro_color_t color)
+{
+  DL_RECORD(DL_FILL_RECT, DL_OPAQUE, CornerRect(x1, y1, x2, y2), NULL, 0, x1, y1, x2, y2, color);
+  uint16_t c = (uint16_t)color;
+  int top = y1 < y2 ? y1 : y2;
+  int bottom = y1 < y2 ? y2 : y1;
+  MarkDirty(x1 < x2 ? x1 : x2, top, abs(x2 - x1) + 1, bottom - top + 1);
+  top = top < 0 ? 0 : top;
+  bottom = bottom >= SCREEN_H ? SCREEN_H - 1 : bottom;
+  for (int y = top; y <= bottom; y++)
+    HLine(x1, x2, y, c);
+}
+
+void vmupro_draw_line(int x1, int y1, int x2, int y2, vmupro_color_t color)
+{
+  DL_RECORD(DL_LINE, 0, CornerRect(x1, y1, x2, y2), NULL, 0, x1, y1, x2, y2, color);
+  uint16_t c = (uint16_t)color;
+  MarkDirty(x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2, abs(x2 - x1) + 1, abs(y2 - y1) + 1);
+  int dx = abs(x2 - x1);
+  int sx = x1 < x2 ? 1 : -1;
+  int dy = -abs(y2 - y1);
+  int sy = y1 < y2 ? 1 : -1;
+  int err = dx + dy;
+
+  while (true)
+  {
+    PutPx(x1, y1, c);
+    if (x1 == x2 && y1 == y2)
+      break;
+    int e2 = 2 * err;
+    if (e2 >= dy)
+    {
+      err += dy;
+      x1 += sx;
+    }
+    if (e2 <= dx)
+    {
+      err += dx;
+      y1 += sy;
+    }
+  }
+}
+
+void vmupro_draw_circle(int cx, int cy, int radius, vmupro_color_t color)
+{
+  DL_RECORD(DL_CIRCLE, 0, DL_RECT(cx - radius, cy - radius, radius * 2 + 1, radius * 2 + 1), NULL, 0, cx, cy, radius, color);
+  uint16_t c = (uint16_t)color;
+  MarkDirty(cx - radius, cy - radius, radius * 2 + 1, radius * 2 + 1);
+  int x = radius;
+  int y = 0;
+  int err = 1 - radius;
+  while (x >= y)
+  {
+    PutPx(cx + x, cy + y, c);
+    PutPx(cx + y, cy + x, c);
+    PutPx(cx - y, cy + x, c);
+    PutPx(cx - x, cy + y, c);
+    PutPx(cx - x, cy - y, c);
+    PutPx(cx - y, cy - x, c);
+    PutPx(cx + y, cy - x, c);
+    PutPx(cx + x, cy - y, c);
+    y++;
+    if (err < 0)
+    {
+      err += 2 * y + 1;
+    }
+    else
+    {
+      x--;
+      err += 2 * (y - x) + 1;
+    }
+  }
+}
+
+void vmupro_draw_circle_filled(int cx, int cy, int radius, vmupro_color_t color)
+{
+  DL_RECORD(DL_CIRCLE_FILLED, 0, DL_RECT(cx - radius, cy - radius, radius * 2 + 1, radius * 2 + 1), NULL, 0, cx, cy, radius, color);
+  uint16_t c = (uint16_t)color;
+  MarkDirty(cx - radius, cy - radius, radius * 2 + 1, radius * 2 + 1);
+  int x = radius;
+  int y = 0;
+  int err = 1 - radius;
+  while (x >= y)
+  {
+    HLine(cx - x, cx + x, cy + y, c);
+    HLine(cx - x, cx + x, cy - y, c);
+    HLine(cx - y, cx + y, cy + x, c);
+    HLine(cx - y, cx + y, cy - x, c);
+    y++;
+    if (err < 0)
+    {
+      err += 2 * y + 1;
+    }
+    else
+    {
+      x--;
+      err += 2 * (y - x) + 1;
+    }
+  }
+}
+
+// Midpoint ellipse, calls back once per quadrant-mirrored point pair
+static void EllipseWalk(int cx, int cy, int rx, int ry, uint16_t c, bool filled)
+{
+  if (rx < 0 || ry < 0)
+    return;
+  MarkDirty(cx - rx, cy - ry, rx * 2 + 1, ry * 2 + 1);
+
+  int64_t rx2 = (int64_t)rx * rx;
+  int64_t ry2 = (int64_t)ry * ry;
+  int64_t x = 0;
+  int64_t y = ry;
+  int64_t px = 0;
+  int64_t py = 2 * rx2 * y;
+
+  // region 1
+  int64_t p = ry2 - rx2 * ry + rx2 / 4;
+  while (px < py)
+  {
+    if (filled)
+    {
+      HLine(cx - (int)x, cx + (int)x, cy + (int)y, c);
+      HLine(cx - (int)x, cx + (int)x, cy - (int)y, c);
+    }
+    else
+    {
+      PutPx(cx + (int)x, cy + (int)y, c);
+      PutPx(cx - (int)x, cy + (int)y, c);
+      PutPx(cx + (int)x, cy - (int)y, c);
+      PutPx(cx - (int)x, cy - (int)y, c);
+    }
+    x++;
+    px += 2 * ry2;
+    if (p < 0)
+    {
+      p += ry2 + px;
+    }
+    else
+    {
+      y--;
+      py -= 2 * rx2;
+      p += ry2 + px - py;
+    }
+  }
+
+  // region 2
+  p = ry2 * (2 * x + 1) * (2 * x + 1) / 4 + rx2 * (y - 1) * (y - 1) - rx2 * ry2;
+  while (y >= 0)
+  {
+    if (filled)
+    {
+      HLine(cx - (int)x, cx + (int)x, cy + (int)y, c);
+      HLine(cx - (int)x, cx + (int)x, cy - (int)y, c);
+    }
+    else
+    {
+      PutPx(cx + (int)x, cy + (int)y, c);
+      PutPx(cx - (int)x, cy + (int)y, c);
+      PutPx(cx + (int)x, cy - (int)y, c);
+      PutPx(cx - (int)x, cy - (int)y, c);
+    }
+    y--;
+    py -= 2 * rx2;
+    if (p > 0)
+    {
+      p += rx2 - py;
+    }
+    else
+    {
+      x++;
+      px += 2 * ry2;
+      p += rx2 - py + px;
+    }
+  }
+}
+
+void vmupro_draw_ellipse(int cx, int cy, int rx, int ry, vmupro_color_t color)
+{
+  DL_RECORD(DL_ELLIPSE, 0, DL_RECT(cx - rx, cy - ry, rx * 2 + 1, ry * 2 + 1), NULL, 0, cx, cy, rx, ry, color);
+  EllipseWalk(cx, cy, rx, ry, (uint16_t)color, false);
+}
+
+void vmupro_draw_ellipse_filled(int cx, int cy, int rx, int ry, vmupro_color_t color)
+{
+  DL_RECORD(DL_ELLIPSE_FILLED, 0, DL_RECT(cx - rx, cy - ry, rx * 2 + 1, ry * 2 + 1), NULL, 0, cx, cy, rx, ry, color);
+  EllipseWalk(cx, cy, rx, ry, (uint16_t)color, true);
+}
+
+void vmupro_draw_polygon(int *points, int num_points, vmupro_color_t color)
+{
+  if (points == NULL || num_points < 2)
+    return;
+  for (int i = 0; i < num_points; i++)
+  {
+    int j = (i + 1) % num_points;
+    vmupro_draw_line(points[i * 2], points[i * 2 + 1], points[j * 2], points[j * 2 + 1], color);
+  }
+}
+
+static int CompareInt(const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+// Bounding box of a polygon's vertices
+static vmupro_rect_t PointsBounds(const int *points, int num_points)
+{
+  if (points == NULL || num_points < 1)
+    return (vmupro_rect_t){0, 0, 0, 0};
+  int minX = points[0], maxX = points[0], minY = points[1], maxY = points[1];
+  for (int i = 1; i < num_points; i++)
+  {
+    minX = points[i * 2] < minX ? points[i * 2] : minX;
+    maxX = points[i * 2] > maxX ? points[i * 2] : maxX;
+    minY = points[i * 2 + 1] < minY ? points[i * 2 + 1] : minY;
+    maxY = points[i * 2 + 1] > maxY ? points[i * 2 + 1] : maxY;
+  }
+  return (vmupro_rect_t){minX, minY, maxX - minX + 1, maxY - minY + 1};
+}
+
+void vmupro_draw_polygon_filled(int *points, int num_points, vmupro_color_t color)
+{
+  DL_RECORD(DL_POLYGON_FILLED, 0, PointsBounds(points, num_points), points,
+            points && num_points > 0 ? num_points * 2 * sizeof(int) : 0, num_points, color);
+  if (points == NULL || num_points < 3)
+    return;
+
+  int minY = points[1];
+  int maxY = points[1];
+  for (int i = 1; i < num_points; i++)
+  {
+    int py = points[i * 2 + 1];
+    minY = py < minY ? py : minY;
+    maxY = py > maxY ? py : maxY;
+  }
+  minY = minY < 0 ? 0 : minY;
+  maxY = maxY >= SCREEN_H ? SCREEN_H - 1 : maxY;
+  int minX = points[0];
+  int maxX = points[0];
+  for (int i = 1; i < num_points; i++)
+  {
+    minX = points[i * 2] < minX ? points[i * 2] : minX;
+    maxX = points[i * 2] > maxX ? points[i * 2] : maxX;
+  }
+  MarkDirty(minX, minY, maxX - minX + 1, maxY - minY + 1);
+
+  int *nodes = malloc(sizeof(int) * num_points);
+  if (nodes == NULL)
+    return;
+
+  // Even-odd scanline fill, sampling at pixel centres
+  for (int y = minY; y <= maxY; y++)
+  {
+    int count = 0;
+    int j = num_points - 1;
+    for (int i = 0; i < num_points; i++)
+    {
+      int xi = points[i * 2], yi = points[i * 2 + 1];
+      int xj = points[j * 2], yj = points[j * 2 + 1];
+      if ((yi <= y && yj > y) || (yj <= y && yi > y))
+        nodes[count++] = xi + (int)((int64_t)(y - yi) * (xj - xi) / (yj - yi));
+      j = i;
+    }
+    qsort(nodes, count, sizeof(int), CompareInt);
+    for (int i = 0; i + 1 < count; i += 2)
+      HLine(nodes[i], nodes[i + 1], y, (uint16_t)color);
+  }
+
+  free(nodes);
+}
+
+// Scanline flood fill with an explicit stack of seeds
+static void FloodFillImpl(int x, int y, uint16_t fill, bool (*inside)(uint16_t c, void *ctx), void *ctx)
+{
+  if ((unsigned)x >= SCREEN_W || (unsigned)y >= SCREEN_H)
+    return;
+
+  // visited map so fills that don't change the color (or tolerance
+  // fills that include the fill color) still terminate
+  uint8_t *visited = calloc(FB_PIXELS, 1);
+  int capacity = 1024;
+  int *stack = malloc(sizeof(int) * 2 * capacity);
+  if (visited == NULL || stack == NULL)
+  {
+    free(visited);
+    free(stack);
+    return;
+  }
+
+  int top = 0;
+  stack[top++] = x;
+  stack[top++] = y;
+  uint16_t *t = Target();
+  int minX = x, maxX = x, minY = y, maxY = y;
+
+  while (top > 0)
+  {
+    int sy = stack[--top];
+    int sx = stack[--top];
+    int idx = sy * SCREEN_W + sx;
+    if (visited[idx] || !inside(t[idx], ctx))
+      continue;
+
+    int lx = sx;
+    while (lx > 0 && !visited[idx - (sx - lx) - 1] && inside(t[idx - (sx - lx) - 1], ctx))
+      lx--;
+    int rx = sx;
+    while (rx < SCREEN_W - 1 && !visited[idx + (rx - sx) + 1] && inside(t[idx + (rx - sx) + 1], ctx))
+      rx++;
+
+    minX = lx < minX ? lx : minX;
+    maxX = rx > maxX ? rx : maxX;
+    minY = sy < minY ? sy : minY;
+    maxY = sy > maxY ? sy : maxY;
+
+    for (int px = lx; px <= rx; px++)
+    {
+      visited[sy * SCREEN_W + px] = 1;
+      if (!WindowBlocks(px, sy, fill))
+        t[sy * SCREEN_W + px] = fill;
+
+      for (int ny = sy - 1; ny <= sy + 1; ny += 2)
+      {
+        if ((unsigned)ny >= SCREEN_H || visited[ny * SCREEN_W + px])
+          continue;
+        if (top + 2 > capacity * 2)
+        {
+          capacity *= 2;
+          int *grown = realloc(stack, sizeof(int) * 2 * capacity);
+          if (grown == NULL)
+          {
+            MarkDirty(minX, minY, maxX - minX + 1, maxY - minY + 1);
+            free(visited);
+            free(stack);
+            return;
+          }
+          stack = grown;
+        }
+        stack[top++] = px;
+        stack[top++] = ny;
+      }
+    }
+  }
+
+  MarkDirty(minX, minY, maxX - minX + 1, maxY - minY + 1);
+  free(visited);
+  free(stack);
+}
+
+typedef struct
+{
+  uint16_t fill;
+  uint16_t boundary;
+} BoundaryCtx;
+
+static bool InsideBoundary(uint16_t c, void *ctx)
+{
+  BoundaryCtx *b = ctx;
+  return c != b->boundary && c != b->fill;
+}
+
+void vmupro_flood_fill(int x, int y, vmupro_color_t fill_color, vmupro_color_t boundary_color)
+{
+  DL_RECORD(DL_FLOOD_FILL, DL_BARRIER, DL_FULL_SCREEN, NULL, 0, x, y, fill_color, boundary_color);
+  BoundaryCtx ctx = {(uint16_t)fill_color, (uint16_t)boundary_color};
+  FloodFillImpl(x, y, (uint16_t)fill_color, InsideBoundary, &ctx);
+}
+
+typedef struct
+{
+  uint16_t seed;
+  int tolerance;
+} ToleranceCtx;
+
+static bool InsideTolerance(uint16_t c, void *ctx)
+{
+  ToleranceCtx *t = ctx;
+  uint16_t a = Swap16(c);
+  uint16_t b = Swap16(t->seed);
+  // compare on an 8 bit per channel scale
+  int dr = abs(R5(a) - R5(b)) << 3;
+  int dg = abs(G6(a) - G6(b)) << 2;
+  int db = abs(B5(a) - B5(b)) << 3;
+  int d = dr > dg ? dr : dg;
+  d = d > db ? d : db;
+  return d <= t->tolerance;
+}
+
+void vmupro_flood_fill_tolerance(int x, int y, vmupro_color_t fill_color, int tolerance)
+{
+  DL_RECORD(DL_FLOOD_FILL_TOLERANCE, DL_BARRIER, DL_FULL_SCREEN, NULL, 0, x, y, fill_color, tolerance);
+  if ((unsigned)x >= SCREEN_W || (unsigned)y >= SCREEN_H)
+    return;
+  ToleranceCtx ctx = {GetPx(x, y), tolerance};
+  FloodFillImpl(x, y, (uint16_t)fill_color, InsideTolerance, &ctx);
+}
+
+//
+// Text
+//
+
+// The firmware fonts aren't available off-device. Each font gets its real
+// cell size, and every character a fixed pattern of solid and partially
+// covered pixels, so layout, clipping and anti-aliased edges can still be
+// exercised
+typedef struct
+{
+  uint8_t w, h;
+  bool mono;
+} HostFont;
+
+static const HostFont hostFonts[VMUPRO_FONT_COUNT] = {
+    [VMUPRO_FONT_TINY_6x8] = {6, 8, true},
+    [VMUPRO_FONT_MONO_7x13] = {7, 13, true},
+    [VMUPRO_FONT_QUANTICO_15x16] = {15, 16, false},
+    [VMUPRO_FONT_QUANTICO_18x20] = {18, 20, false},
+    [VMUPRO_FONT_QUANTICO_19x21] = {19, 21, false},
+    [VMUPRO_FONT_QUANTICO_25x29] = {25, 29, false},
+    [VMUPRO_FONT_QUANTICO_29x33] = {29, 33, false},
+    [VMUPRO_FONT_QUANTICO_32x37] = {32, 37, false},
+    [VMUPRO_FONT_GABARITO_18x18] = {18, 18, false},
+    [VMUPRO_FONT_GABARITO_22x24] = {22, 24, false},
+    [VMUPRO_FONT_OPEN_SANS_15x18] = {15, 18, false},
+    [VMUPRO_FONT_OPEN_SANS_21x24] = {21, 24, false},
+};
+static vmupro_font_id_t currentFont = VMUPRO_FONT_DEFAULT;
+
+static int GlyphAdvance(const HostFont *f, unsigned char c)
+{
+  if (c < ' ')
+    return 0;
+  if (f->mono)
+    return f->w;
+  if (c == ' ')
+    return f->w / 3;
+  return f->w - (int)((c * 7u) % (f->w / 2 + 1));
+}
+
+// Coverage 0-15 of a pixel in the character cell, with a one pixel margin
+static int GlyphCoverage(const HostFont *f, unsigned char c, int x, int y, int advance)
+{
+  if (c <= ' ' || x == 0 || y == 0 || x >= advance - 1 || y >= f->h - 1)
+    return 0;
+  uint32_t h = c * 2654435761u ^ (uint32_t)x * 40503u ^ (uint32_t)y * 2246822519u;
+  h ^= h >> 15;
+  h *= 0x2c1b3c6du;
+  h ^= h >> 12;
+  int v = (int)(h & 31);
+  return v >= 16 ? 15 : (v >= 8 ? v - 7 : 0);
+}
+
+// bg + (fg - bg) * coverage / 15 per channel, on big endian pixels
+static inline uint16_t CoverageBlendBE(uint16_t fgBE, uint16_t bgBE, int coverage)
+{
+  uint16_t f = Swap16(fgBE);
+  uint16_t b = Swap16(bgBE);
+  int r = R5(b) + (R5(f) - R5(b)) * coverage / 15;
+  int g = G6(b) + (G6(f) - G6(b)) * coverage / 15;
+  int bl = B5(b) + (B5(f) - B5(b)) * coverage / 15;
+  return Swap16(Pack565(r, g, bl));
+}
+
+static void DrawText(vmupro_font_id_t font, const char *text, int x, int y, uint16_t color, uint16_t bg)
+{
+  const HostFont *f = &hostFonts[font];
+  int width = 0;
+  for (const unsigned char *p = (const unsigned char *)text; *p; p++)
+  {
+    int advance = GlyphAdvance(f, *p);
+    for (int gy = 0; gy < f->h; gy++)
+    {
+      for (int gx = 0; gx < advance; gx++)
+      {
+        int coverage = GlyphCoverage(f, *p, gx, gy, advance);
+        uint16_t c = coverage == 0 ? bg : (coverage == 15 ? color : CoverageBlendBE(color, bg, coverage));
+        PutPx(x + width + gx, y + gy, c);
+      }
+    }
+    width += advance;
+  }
+  MarkDirty(x, y, width, f->h);
+}
+
+void vmupro_set_font(vmupro_font_id_t font_id)
+{
+  currentFont = (unsigned)font_id < VMUPRO_FONT_COUNT ? font_id : VMUPRO_FONT_MEDIUM;
+}
+
+void vmupro_draw_text(const char *text, int x, int y, uint16_t color, uint16_t bg_color)
+{
+  if (text == NULL)
+    return;
+  DL_RECORD(DL_TEXT, 0, DL_RECT(x, y, vmupro_calc_text_length(text), hostFonts[currentFont].h), text,
+            (uint32_t)strlen(text) + 1, currentFont, x, y, color, bg_color);
+  DrawText(currentFont, text, x, y, color, bg_color);
+}
+
+int vmupro_calc_text_length(const char *text)
+{
+  if (text == NULL)
+    return 0;
+  int width = 0;
+  for (const unsigned char *p = (const unsigned char *)text; *p; p++)
+    width += GlyphAdvance(&hostFonts[currentFont], *p);
+  return width;
+}
+
+vmupro_font_info_t vmupro_get_font_info(vmupro_font_id_t font_id)
+{
+  const HostFont *f = &hostFonts[(unsigned)font_id < VMUPRO_FONT_COUNT ? font_id : VMUPRO_FONT_MEDIUM];
+  vmupro_font_info_t info = {f->w, f->h, f->mono ? 1 : 0};
+  return info;
+}
+
+//
+// Blitting
+//
+
+void vmupro_blit_buffer_at(uint8_t *buffer, int x, int y, int width, int height)
+{
+  DL_RECORD(DL_BLIT_AT, buffer ? DL_OPAQUE : 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height);
+  Clip c;
+  if (buffer == NULL || !ClipDest(x, y, width, height, &c))
+    return;
+
+  if (colorWindow.active)
+  {
+    BlitGeneric(buffer, x, y, width, height, VMUPRO_DRAWFLAGS_NORMAL, OpCopy, NULL);
+    return;
+  }
+
+  for (int row = 0; row < c.h; row++)
+  {
+    const uint8_t *src = buffer + ((c.sy + row) * width + c.sx) * 2;
+    memcpy(Target() + (c.dy + row) * SCREEN_W + c.dx, src, c.w * 2);
+  }
+}
+
+void vmupro_blit_buffer_with_palette(uint8_t *buffer, int16_t *palette)
+{
+  DL_RECORD(DL_BLIT_PALETTE, buffer && palette ? DL_OPAQUE : 0, DL_FULL_SCREEN, NULL, 0, DL_PTR(buffer), DL_PTR(palette));
+  if (buffer == NULL || palette == NULL)
+    return;
+
+  // Full screen of 8 bit indices
+  uint16_t *t = Target();
+  MarkDirtyFull();
+  for (int y = 0; y < SCREEN_H; y++)
+  {
+    for (int x = 0; x < SCREEN_W; x++)
+    {
+      uint16_t c = (uint16_t)palette[buffer[y * SCREEN_W + x]];
+      if (!WindowBlocks(x, y, c))
+        t[y * SCREEN_W + x] = c;
+    }
+  }
+}
+
+//
+// Color-key row kernels
+// The vector path handles 16 then 8 pixels at a time with a masked store
+// (dst = key ? dst : src), the scalar path finishes the tail
+//
+
+static void KeyRowScalar(uint16_t *dst, const uint8_t *src, int n, uint16_t key, bool reverse)
+{
+  for (int i = 0; i < n; i++)
+  {
+    uint16_t px = LoadPx(src, reverse ? -i : i);
+    if (px != key)
+      dst[i] = px;
+  }
+}
+
+#if defined(__GNUC__) && !defined(VMUPRO_HOST_NO_VECTOR)
+
+typedef uint16_t V8u16 __attribute__((vector_size(16)));
+
+static inline V8u16 LoadV8(const void *p)
+{
+  V8u16 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void StoreV8(void *p, V8u16 v)
+{
+  memcpy(p, &v, sizeof(v));
+}
+
+static inline V8u16 ReverseV8(V8u16 v)
+{
+#if defined(__clang__)
+  return __builtin_shufflevector(v, v, 7, 6, 5, 4, 3, 2, 1, 0);
+#else
+  return __builtin_shuffle(v, (V8u16){7, 6, 5, 4, 3, 2, 1, 0});
+#endif
+}
+
+// 8 pixels: src lanes are loaded forwards or (for FLIP_H) backwards
+static inline void KeyV8(uint16_t *dst, const uint8_t *src, V8u16 keyV, bool reverse)
+{
+  V8u16 s = reverse ? ReverseV8(LoadV8(src - 14)) : LoadV8(src);
+  V8u16 m = (V8u16)(s == keyV);
+  // fully opaque or fully transparent groups skip the read-modify-write
+  V8u16 none = (V8u16){0};
+  if (memcmp(&m, &none, sizeof(m)) == 0)
+  {
+    StoreV8(dst, s);
+    return;
+  }
+  V8u16 all = ~none;
+  if (memcmp(&m, &all, sizeof(m)) == 0)
+    return;
+  StoreV8(dst, (LoadV8(dst) & m) | (s & ~m));
+}
+
+static void KeyRowVector(uint16_t *dst, const uint8_t *src, int n, uint16_t key, bool reverse)
+{
+  V8u16 keyV = (V8u16){0} + key;
+  int step = reverse ? -2 : 2;
+  int i = 0;
+
+  for (; i + 16 <= n; i += 16)
+  {
+    KeyV8(dst + i, src + i * step, keyV, reverse);
+    KeyV8(dst + i + 8, src + (i + 8) * step, keyV, reverse);
+  }
+  for (; i + 8 <= n; i += 8)
+    KeyV8(dst + i, src + i * step, keyV, reverse);
+
+  KeyRowScalar(dst + i, src + i * step, n - i, key, reverse);
+}
+
+#else
+
+#define KeyRowVector KeyRowScalar
+
+#endif
+
+static bool scalarKernels = false;
+
+void vmupro_host_set_scalar_kernels(bool scalar_only)
+{
+  scalarKernels = scalar_only;
+}
+
+void vmupro_blit_buffer_transparent(uint8_t *buffer, int x, int y, int width, int height, vmupro_color_t transparent_color, vmupro_drawflags_t flags)
+{
+  DL_RECORD(DL_BLIT_TRANSPARENT, 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height, transparent_color, flags);
+  uint16_t key = (uint16_t)transparent_color;
+  Clip c;
+  if (buffer == NULL || !ClipDest(x, y, width, height, &c))
+    return;
+
+  if (colorWindow.active)
+  {
+    BlitGeneric(buffer, x, y, width, height, flags, OpKey, &key);
+    return;
+  }
+
+  bool flipH = (flags & VMUPRO_DRAWFLAGS_FLIP_H) != 0;
+  void (*kernel)(uint16_t *, const uint8_t *, int, uint16_t, bool) = scalarKernels ? KeyRowScalar : KeyRowVector;
+
+  for (int row = 0; row < c.h; row++)
+  {
+    int sy = c.sy + row;
+    if (flags & VMUPRO_DRAWFLAGS_FLIP_V)
+      sy = height - 1 - sy;
+    // with FLIP_H the first visible dest pixel reads source column
+    // width-1-sx and the kernel walks the source backwards
+    int sx = flipH ? width - 1 - c.sx : c.sx;
+    const uint8_t *src = buffer + (sy * width + sx) * 2;
+    kernel(Target() + (c.dy + row) * SCREEN_W + c.dx, src, c.w, key, flipH);
+  }
+}
+
+static bool OpBlend(uint16_t src, uint16_t dst, int x, int y, void *ctx, uint16_t *out)
+{
+  (void)x, (void)y;
+  *out = BlendBE(src, dst, *(int *)ctx);
+  return true;
+}
+
+void vmupro_blit_buffer_blended(uint8_t *buffer, int x, int y, int width, int height, uint8_t alpha_level)
+{
+  DL_RECORD(DL_BLIT_BLENDED, 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height, alpha_level);
+  int alpha = alpha_level;
+  if (alpha == 255)
+  {
+    vmupro_blit_buffer_at(buffer, x, y, width, height);
+    return;
+  }
+  if (alpha == 0)
+    return;
+  BlitGeneric(buffer, x, y, width, height, VMUPRO_DRAWFLAGS_NORMAL, OpBlend, &alpha);
+}
+
+static const int bayer4[4][4] = {
+    {0, 8, 2, 10},
+    {12, 4, 14, 6},
+    {3, 11, 1, 9},
+    {15, 7, 13, 5},
+};
+
+static bool OpDither(uint16_t src, uint16_t dst, int x, int y, void *ctx, uint16_t *out)
+{
+  (void)dst;
+  int strength = *(int *)ctx;
+  int bias = ((bayer4[y & 3][x & 3] - 8) * strength) / 8;
+  uint16_t s = Swap16(src);
+  int r = Clamp(R5(s) + bias, 0, 31);
+  int g = Clamp(G6(s) + bias * 2, 0, 63);
+  int b = Clamp(B5(s) + bias, 0, 31);
+  *out = Swap16(Pack565(r, g, b));
+  return true;
+}
+
+void vmupro_blit_buffer_dithered(uint8_t *buffer, int x, int y, int width, int height, int dither_strength)
+{
+  DL_RECORD(DL_BLIT_DITHERED, 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height, dither_strength);
+  if (dither_strength <= 0)
+  {
+    vmupro_blit_buffer_at(buffer, x, y, width, height);
+    return;
+  }
+  BlitGeneric(buffer, x, y, width, height, VMUPRO_DRAWFLAGS_NORMAL, OpDither, &dither_strength);
+}
+
+void vmupro_blit_buffer_flip_h(uint8_t *buffer, int x, int y, int width, int height)
+{
+  DL_RECORD(DL_BLIT_FLIP_H, buffer ? DL_OPAQUE : 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height);
+  BlitGeneric(buffer, x, y, width, height, VMUPRO_DRAWFLAGS_FLIP_H, OpCopy, NULL);
+}
+
+void vmupro_blit_buffer_flipped(uint8_t *buffer, int x, int y, int width, int height, vmupro_drawflags_t flags)
+{
+  DL_RECORD(DL_BLIT_FLIPPED, buffer ? DL_OPAQUE : 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height, flags);
+  if (flags == VMUPRO_DRAWFLAGS_NORMAL)
+  {
+    vmupro_blit_buffer_at(buffer, x, y, width, height);
+    return;
+  }
+  BlitGeneric(buffer, x, y, width, height, flags, OpCopy, NULL);
+}
+
+// Nearest neighbour scaled blit shared by the scaled/advanced entry points
+// key < 0 disables transparency
+static void BlitScaledImpl(const uint8_t *buffer, int buffer_width, int src_x, int src_y, int src_width, int src_height,
+                           int dest_x, int dest_y, int dest_width, int dest_height,
+                           bool flip_h, bool flip_v, int key)
+{
+  if (buffer == NULL || src_width <= 0 || src_height <= 0)
+    return;
+
+  Clip c;
+  if (!ClipDest(dest_x, dest_y, dest_width, dest_height, &c))
+    return;
+
+  // 16.16 steps through the source region
+  uint32_t stepX = ((uint32_t)src_width << 16) / (uint32_t)dest_width;
+  uint32_t stepY = ((uint32_t)src_height << 16) / (uint32_t)dest_height;
+
+  // 1:1 horizontally with nothing to test per pixel: plain row copies
+  bool rowCopy = stepX == (1u << 16) && !flip_h && key < 0 && !colorWindow.active;
+
+  for (int row = 0; row < c.h; row++)
+  {
+    int v = (int)(((uint64_t)(c.sy + row) * stepY) >> 16);
+    if (flip_v)
+      v = src_height - 1 - v;
+    const uint8_t *srcRow = buffer + ((src_y + v) * buffer_width + src_x) * 2;
+    int dy = c.dy + row;
+    uint16_t *dst = Target() + dy * SCREEN_W;
+
+    if (rowCopy)
+    {
+      memcpy(dst + c.dx, srcRow + c.sx * 2, c.w * 2);
+      continue;
+    }
+
+    uint64_t u16 = (uint64_t)c.sx * stepX;
+    for (int col = 0; col < c.w; col++, u16 += stepX)
+    {
+      int u = (int)(u16 >> 16);
+      if (flip_h)
+        u = src_width - 1 - u;
+      uint16_t px = LoadPx(srcRow, u);
+      if (key >= 0 && px == (uint16_t)key)
+        continue;
+      int dx = c.dx + col;
+      if (!WindowBlocks(dx, dy, px))
+        dst[dx] = px;
+    }
+  }
+}
+
+void vmupro_blit_buffer_scaled(uint8_t *buffer, int buffer_width, int src_x, int src_y, int src_width, int src_height,
+                               int dest_x, int dest_y, int dest_width, int dest_height)
+{
+  DL_RECORD(DL_BLIT_SCALED, buffer && src_width > 0 && src_height > 0 ? DL_OPAQUE : 0,
+            DL_RECT(dest_x, dest_y, dest_width, dest_height), NULL, 0, DL_PTR(buffer), buffer_width,
+            src_x, src_y, src_width, src_height, dest_x, dest_y, dest_width, dest_height);
+  BlitScaledImpl(buffer, buffer_width, src_x, src_y, src_width, src_height,
+                 dest_x, dest_y, dest_width, dest_height, false, false, -1);
+}
+
+void vmupro_blit_buffer_advanced(uint8_t *buffer, int buffer_width, int src_x, int src_y, int src_width, int src_height,
+                                 int dest_x, int dest_y, int dest_width, int dest_height,
+                                 int flip_h, int flip_v, int transparent_color)
+{
+  DL_RECORD(DL_BLIT_ADVANCED, buffer && src_width > 0 && src_height > 0 && transparent_color < 0 ? DL_OPAQUE : 0,
+            DL_RECT(dest_x, dest_y, dest_width, dest_height), NULL, 0, DL_PTR(buffer), buffer_width,
+            src_x, src_y, src_width, src_height, dest_x, dest_y, dest_width, dest_height,
+            flip_h, flip_v, transparent_color);
+  BlitScaledImpl(buffer, buffer_width, src_x, src_y, src_width, src_height,
+                 dest_x, dest_y, dest_width, dest_height, flip_h != 0, flip_v != 0,
+                 transparent_color < 0 ? -1 : (transparent_color & 0xffff));
+}
+
+void vmupro_blit_buffer_rotated_90(uint8_t *buffer, int x, int y, int width, int height, int rotation)
+{
+  DL_RECORD(DL_BLIT_ROTATED_90, buffer ? DL_OPAQUE : 0,
+            (rotation & 1) ? DL_RECT(x, y, height, width) : DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height, rotation);
+  if (buffer == NULL)
+    return;
+
+  rotation = WrapMod(rotation, 4);
+  if (rotation == 0)
+  {
+    vmupro_blit_buffer_at(buffer, x, y, width, height);
+    return;
+  }
+
+  int outW = (rotation == 2) ? width : height;
+  int outH = (rotation == 2) ? height : width;
+  Clip c;
+  if (!ClipDest(x, y, outW, outH, &c))
+    return;
+
+  for (int row = 0; row < c.h; row++)
+  {
+    int oy = c.sy + row;
+    for (int col = 0; col < c.w; col++)
+    {
+      int ox = c.sx + col;
+      int sx, sy;
+      // clockwise
+      if (rotation == 1)
+      {
+        sx = oy;
+        sy = height - 1 - ox;
+      }
+      else if (rotation == 2)
+      {
+        sx = width - 1 - ox;
+        sy = height - 1 - oy;
+      }
+      else
+      {
+        sx = width - 1 - oy;
+        sy = ox;
+      }
+      uint16_t px = LoadPx(buffer, sy * width + sx);
+      int dx = c.dx + col;
+      int dy = c.dy + row;
+      if (!WindowBlocks(dx, dy, px))
+        Target()[dy * SCREEN_W + dx] = px;
+    }
+  }
+}
+
+//
+// Affine blits
+//
+
+static inline int64_t Clamp64(int64_t v, int64_t lo, int64_t hi)
+{
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static int64_t FloorDiv64(int64_t n, int64_t d)
+{
+  if (d < 0)
+  {
+    n = -n;
+    d = -d;
+  }
+  return n >= 0 ? n / d : -((-n + d - 1) / d);
+}
+
+// Steps k in [*k0, *k1) where 0 <= start + k * step < limit
+static void SlabSpan(int64_t start, int64_t step, int64_t limit, int *k0, int *k1)
+{
+  int64_t lo, hi;
+  if (step == 0)
+  {
+    if (start < 0 || start >= limit)
+      *k1 = *k0;
+    return;
+  }
+  if (step > 0)
+  {
+    lo = -FloorDiv64(start, step);
+    hi = FloorDiv64(limit - 1 - start, step) + 1;
+  }
+  else
+  {
+    lo = -FloorDiv64(limit - 1 - start, -step);
+    hi = FloorDiv64(start, -step) + 1;
+  }
+  if (lo > *k0)
+    *k0 = (int)(lo < *k1 ? lo : *k1);
+  if (hi < *k1)
+    *k1 = (int)(hi > *k0 ? hi : *k0);
+}
+
+// Bilinear sample at 16.16 region position (u, v), pixel centres at +0.5
+static uint16_t SampleBilinear(const uint8_t *region, int stride, int w, int h, int32_t u, int32_t v, int key)
+{
+  int32_t su = u - 0x8000;
+  int32_t sv = v - 0x8000;
+  int u0 = su >> 16;
+  int v0 = sv >> 16;
+  int fu = (su >> 8) & 0xff;
+  int fv = (sv >> 8) & 0xff;
+  int u1 = Clamp(u0 + 1, 0, w - 1);
+  int v1 = Clamp(v0 + 1, 0, h - 1);
+  u0 = Clamp(u0, 0, w - 1);
+  v0 = Clamp(v0, 0, h - 1);
+
+  uint16_t p00 = LoadPx(region, v0 * stride + u0);
+  uint16_t p10 = LoadPx(region, v0 * stride + u1);
+  uint16_t p01 = LoadPx(region, v1 * stride + u0);
+  uint16_t p11 = LoadPx(region, v1 * stride + u1);
+  if (key >= 0)
+  {
+    // keyed neighbours take the nearest pixel's colour so edges don't bleed
+    uint16_t n = LoadPx(region, (v >> 16) * stride + (u >> 16));
+    p00 = p00 == (uint16_t)key ? n : p00;
+    p10 = p10 == (uint16_t)key ? n : p10;
+    p01 = p01 == (uint16_t)key ? n : p01;
+    p11 = p11 == (uint16_t)key ? n : p11;
+  }
+  p00 = Swap16(p00);
+  p10 = Swap16(p10);
+  p01 = Swap16(p01);
+  p11 = Swap16(p11);
+
+  int w00 = (256 - fu) * (256 - fv);
+  int w10 = fu * (256 - fv);
+  int w01 = (256 - fu) * fv;
+  int w11 = fu * fv;
+  int r = (R5(p00) * w00 + R5(p10) * w10 + R5(p01) * w01 + R5(p11) * w11) >> 16;
+  int g = (G6(p00) * w00 + G6(p10) * w10 + G6(p01) * w01 + G6(p11) * w11) >> 16;
+  int b = (B5(p00) * w00 + B5(p10) * w10 + B5(p01) * w01 + B5(p11) * w11) >> 16;
+  return Swap16(Pack565(r, g, b));
+}
+
+// Screen bounding box of a transformed w*h region, clamped to the screen
+static vmupro_rect_t AffineBounds(const vmupro_affine_t *m, int w, int h)
+{
+  vmupro_rect_t box = {0, 0, 0, 0};
+  if (m == NULL)
+    return box;
+
+  int64_t minX = INT64_MAX, maxX = INT64_MIN, minY = INT64_MAX, maxY = INT64_MIN;
+  for (int i = 0; i < 4; i++)
+  {
+    int64_t u = (i & 1) ? (int64_t)w << 16 : 0;
+    int64_t v = (i & 2) ? (int64_t)h << 16 : 0;
+    int64_t x = ((m->a * u + m->b * v) >> 16) + m->tx;
+    int64_t y = ((m->c * u + m->d * v) >> 16) + m->ty;
+    minX = x < minX ? x : minX;
+    maxX = x > maxX ? x : maxX;
+    minY = y < minY ? y : minY;
+    maxY = y > maxY ? y : maxY;
+  }
+  box.x = (int)Clamp64(minX >> 16, 0, SCREEN_W);
+  box.y = (int)Clamp64(minY >> 16, 0, SCREEN_H);
+  box.width = (int)Clamp64((maxX + 0xffff) >> 16, 0, SCREEN_W) - box.x;
+  box.height = (int)Clamp64((maxY + 0xffff) >> 16, 0, SCREEN_H) - box.y;
+  return box;
+}
+
+void vmupro_affine_rotate_scale(vmupro_affine_t *matrix, int32_t angle, int32_t scale_x, int32_t scale_y,
+                                int32_t pivot_x, int32_t pivot_y, int32_t dest_x, int32_t dest_y)
+{
+  if (matrix == NULL)
+    return;
+
+  double rad = (angle / 65536.0) * M_PI / 180.0;
+  int32_t cs = (int32_t)lround(cos(rad) * 65536.0);
+  int32_t sn = (int32_t)lround(sin(rad) * 65536.0);
+
+  // rotate(scale(p - pivot)) + dest, clockwise on a y-down screen
+  matrix->a = (int32_t)(((int64_t)cs * scale_x) >> 16);
+  matrix->b = (int32_t)(((int64_t)-sn * scale_y) >> 16);
+  matrix->c = (int32_t)(((int64_t)sn * scale_x) >> 16);
+  matrix->d = (int32_t)(((int64_t)cs * scale_y) >> 16);
+  matrix->tx = dest_x - (int32_t)(((int64_t)matrix->a * pivot_x + (int64_t)matrix->b * pivot_y) >> 16);
+  matrix->ty = dest_y - (int32_t)(((int64_t)matrix->c * pivot_x + (int64_t)matrix->d * pivot_y) >> 16);
+}
+
+void vmupro_blit_buffer_affine(uint8_t *buffer, int buffer_width, int src_x, int src_y, int src_width, int src_height,
+                               const vmupro_affine_t *matrix, vmupro_sample_mode_t sample,
+                               int transparent_color, uint8_t alpha)
+{
+  DL_RECORD(DL_BLIT_AFFINE, 0, AffineBounds(matrix, src_width, src_height), matrix, matrix ? sizeof(*matrix) : 0,
+            DL_PTR(buffer), buffer_width, src_x, src_y, src_width, src_height, sample, transparent_color, alpha);
+  if (buffer == NULL || matrix == NULL || src_width <= 0 || src_height <= 0 || alpha == 0)
+    return;
+
+  const vmupro_affine_t *m = matrix;
+  int64_t det = (int64_t)m->a * m->d - (int64_t)m->b * m->c;
+  if (det == 0)
+    return;
+
+  vmupro_rect_t box = AffineBounds(m, src_width, src_height);
+  Clip c;
+  if (!ClipDest(box.x, box.y, box.width, box.height, &c))
+    return;
+
+  // inverse matrix, screen -> region, 16.16
+  int64_t ia = ((int64_t)m->d << 32) / det;
+  int64_t ib = ((int64_t)-m->b << 32) / det;
+  int64_t ic = ((int64_t)-m->c << 32) / det;
+  int64_t id = ((int64_t)m->a << 32) / det;
+
+  const uint8_t *region = buffer + (src_y * buffer_width + src_x) * 2;
+  int key = transparent_color < 0 ? -1 : (transparent_color & 0xffff);
+  bool bilinear = sample == VMUPRO_SAMPLE_BILINEAR;
+  bool plain = !bilinear && key < 0 && alpha == 255 && !colorWindow.active;
+  int64_t limitU = (int64_t)src_width << 16;
+  int64_t limitV = (int64_t)src_height << 16;
+
+  for (int row = 0; row < c.h; row++)
+  {
+    int dy = c.dy + row;
+    // region position of the first pixel centre on this scanline
+    int64_t px = ((int64_t)c.dx << 16) + 0x8000 - m->tx;
+    int64_t py = ((int64_t)dy << 16) + 0x8000 - m->ty;
+    int64_t u0 = (ia * px + ib * py) >> 16;
+    int64_t v0 = (ic * px + id * py) >> 16;
+
+    // exact span of pixels whose centres fall inside the region
+    int k0 = 0;
+    int k1 = c.w;
+    SlabSpan(u0, ia, limitU, &k0, &k1);
+    SlabSpan(v0, ic, limitV, &k0, &k1);
+    if (k0 >= k1)
+      continue;
+
+    int32_t u = (int32_t)(u0 + ia * k0);
+    int32_t v = (int32_t)(v0 + ic * k0);
+    int32_t du = (int32_t)ia;
+    int32_t dv = (int32_t)ic;
+    uint16_t *dst = Target() + dy * SCREEN_W + c.dx;
+
+    if (plain)
+    {
+      for (int k = k0; k < k1; k++, u += du, v += dv)
+        dst[k] = LoadPx(region, (v >> 16) * buffer_width + (u >> 16));
+      continue;
+    }
+
+    for (int k = k0; k < k1; k++, u += du, v += dv)
+    {
+      uint16_t px;
+      if (key >= 0)
+      {
+        px = LoadPx(region, (v >> 16) * buffer_width + (u >> 16));
+        if (px == (uint16_t)key)
+          continue;
+      }
+      px = bilinear ? SampleBilinear(region, buffer_width, src_width, src_height, u, v, key)
+                    : LoadPx(region, (v >> 16) * buffer_width + (u >> 16));
+      if (alpha != 255)
+        px = BlendBE(px, dst[k], alpha);
+      if (!WindowBlocks(c.dx + k, dy, px))
+        dst[k] = px;
+    }
+  }
+}
+
+void vmupro_blit_buffer_rotated_precise(uint8_t *buffer, int x, int y, int width, int height, int rotation_degrees)
+{
+  if (buffer == NULL || width <= 0 || height <= 0)
+    return;
+
+  vmupro_affine_t m;
+  vmupro_affine_rotate_scale(&m, WrapMod(rotation_degrees, 360) << 16, 0x10000, 0x10000,
+                             width << 15, height << 15, x << 16, y << 16);
+  vmupro_blit_buffer_affine(buffer, width, 0, 0, width, height, &m, VMUPRO_SAMPLE_BILINEAR, -1, 255);
+}
+
+void vmupro_blit_tile_pattern(uint8_t *tile_buffer, int tile_width, int tile_height,
+                              int dest_x, int dest_y, int dest_width, int dest_height)
+{
+  DL_RECORD(DL_TILE_PATTERN, tile_buffer && tile_width > 0 && tile_height > 0 ? DL_OPAQUE : 0,
+            DL_RECT(dest_x, dest_y, dest_width, dest_height), NULL, 0,
+            DL_PTR(tile_buffer), tile_width, tile_height, dest_x, dest_y, dest_width, dest_height);
+  if (tile_buffer == NULL || tile_width <= 0 || tile_height <= 0)
+    return;
+
+  Clip c;
+  if (!ClipDest(dest_x, dest_y, dest_width, dest_height, &c))
+    return;
+
+  for (int row = 0; row < c.h; row++)
+  {
+    int ty = (c.sy + row) % tile_height;
+    int dy = c.dy + row;
+    for (int col = 0; col < c.w; col++)
+    {
+      int tx = (c.sx + col) % tile_width;
+      uint16_t px = LoadPx(tile_buffer, ty * tile_width + tx);
+      int dx = c.dx + col;
+      if (!WindowBlocks(dx, dy, px))
+        Target()[dy * SCREEN_W + dx] = px;
+    }
+  }
+}
+
+void vmupro_blit_tile(uint8_t *buffer, int x, int y, int src_x, int src_y, int width, int height, int tilemap_width)
+{
+  DL_RECORD(DL_TILE, buffer ? DL_OPAQUE : 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, src_x, src_y, width, height, tilemap_width);
+  Clip c;
+  if (buffer == NULL || !ClipDest(x, y, width, height, &c))
+    return;
+
+  for (int row = 0; row < c.h; row++)
+  {
+    const uint8_t *src = buffer + ((src_y + c.sy + row) * tilemap_width + src_x + c.sx) * 2;
+    int dy = c.dy + row;
+    if (colorWindow.active)
+    {
+      for (int col = 0; col < c.w; col++)
+        PutPx(c.dx + col, dy, LoadPx(src, col));
+    }
+    else
+    {
+      memcpy(Target() + dy * SCREEN_W + c.dx, src, c.w * 2);
+    }
+  }
+}
+
+void vmupro_blit_tile_advanced(uint8_t *buffer, int x, int y, int atlas_src_x, int atlas_src_y, int width, int height, int tilemap_width, vmupro_color_t transparent_color, vmupro_drawflags_t flags)
+{
+  DL_RECORD(DL_TILE_ADVANCED, 0, DL_RECT(x, y, width, height), NULL, 0, DL_PTR(buffer), x, y,
+            atlas_src_x, atlas_src_y, width, height, tilemap_width, transparent_color, flags);
+  Clip c;
+  if (buffer == NULL || !ClipDest(x, y, width, height, &c))
+    return;
+
+  uint16_t key = (uint16_t)transparent_color;
+  for (int row = 0; row < c.h; row++)
+  {
+    int sy = c.sy + row;
+    if (flags & VMUPRO_DRAWFLAGS_FLIP_V)
+      sy = height - 1 - sy;
+    const uint8_t *src = buffer + ((atlas_src_y + sy) * tilemap_width + atlas_src_x) * 2;
+    int dy = c.dy + row;
+    for (int col = 0; col < c.w; col++)
+    {
+      int sx = c.sx + col;
+      if (flags & VMUPRO_DRAWFLAGS_FLIP_H)
+        sx = width - 1 - sx;
+      uint16_t px = LoadPx(src, sx);
+      if (px != key)
+        PutPx(c.dx + col, dy, px);
+    }
+  }
+}
+
+//
+// Backgrounds
+//
+
+typedef struct
+{
+  const uint8_t *buffer;
+  int width, height;
+  int ox, oy;
+  int w;
+} ScrollCtx;
+
+static void ScrollRows(int begin, int end, void *ctx)
+{
+  const ScrollCtx *s = ctx;
+  for (int row = begin; row < end; row++)
+  {
+    int sy = (s->oy + row) % s->height;
+    const uint8_t *src = s->buffer + sy * s->width * 2;
+    uint16_t *dst = Target() + row * SCREEN_W;
+
+    // copy in runs up to the wrap point
+    int x = 0;
+    int sx = s->ox;
+    while (x < s->w)
+    {
+      int run = s->width - sx;
+      if (run > s->w - x)
+        run = s->w - x;
+      if (colorWindow.active)
+      {
+        for (int i = 0; i < run; i++)
+          PutPx(x + i, row, LoadPx(src, sx + i));
+      }
+      else
+      {
+        memcpy(dst + x, src + sx * 2, run * 2);
+      }
+      x += run;
+      sx = 0;
+    }
+  }
+}
+
+void vmupro_blit_scrolling_background(uint8_t *bg_buffer, int bg_width, int bg_height,
+                                      int scroll_x, int scroll_y, int dest_width, int dest_height)
+{
+  DL_RECORD(DL_SCROLLING_BG, bg_buffer && bg_width > 0 && bg_height > 0 ? DL_OPAQUE : 0,
+            DL_RECT(0, 0, dest_width, dest_height), NULL, 0,
+            DL_PTR(bg_buffer), bg_width, bg_height, scroll_x, scroll_y, dest_width, dest_height);
+  if (bg_buffer == NULL || bg_width <= 0 || bg_height <= 0)
+    return;
+
+  Clip c;
+  if (!ClipDest(0, 0, dest_width, dest_height, &c))
+    return;
+
+  ScrollCtx ctx = {bg_buffer, bg_width, bg_height, WrapMod(scroll_x, bg_width), WrapMod(scroll_y, bg_height), c.w};
+  RunSplit(ScrollRows, 0, c.h, 1, &ctx);
+}
+
+void vmupro_blit_infinite_scrolling_background(uint8_t *tile_buffer, int tile_width, int tile_height,
+                                               int scroll_x, int scroll_y, int dest_width, int dest_height)
+{
+  DL_RECORD(DL_INFINITE_BG, tile_buffer && tile_width > 0 && tile_height > 0 ? DL_OPAQUE : 0,
+            DL_RECT(0, 0, dest_width, dest_height), NULL, 0,
+            DL_PTR(tile_buffer), tile_width, tile_height, scroll_x, scroll_y, dest_width, dest_height);
+  if (tile_buffer == NULL || tile_width <= 0 || tile_height <= 0)
+    return;
+
+  Clip c;
+  if (!ClipDest(0, 0, dest_width, dest_height, &c))
+    return;
+
+  // wrap once per call; rows and columns then only step and reset at
+  // the tile edges, so any scroll value is safe
+  int ox = WrapMod(scroll_x, tile_width);
+  int sy = WrapMod(scroll_y, tile_height);
+  uint16_t *t = Target();
+
+  for (int row = 0; row < c.h; row++)
+  {
+    uint16_t *dst = t + row * SCREEN_W;
+    const uint8_t *src = tile_buffer + sy * tile_width * 2;
+    if (++sy == tile_height)
+      sy = 0;
+
+    if (colorWindow.active)
+    {
+      int sx = ox;
+      for (int col = 0; col < c.w; col++)
+      {
+        PutPx(col, row, LoadPx(src, sx));
+        if (++sx == tile_width)
+          sx = 0;
+      }
+      continue;
+    }
+
+    // one tile height down the pattern repeats: copy the finished row
+    if (row >= tile_height)
+    {
+      memcpy(dst, dst - tile_height * SCREEN_W, c.w * 2);
+      continue;
+    }
+
+    // otherwise one span per tile column, the first starting at ox
+    int x = 0;
+    int sx = ox;
+    while (x < c.w)
+    {
+      int run = tile_width - sx;
+      if (run > c.w - x)
+        run = c.w - x;
+      memcpy(dst + x, src + sx * 2, run * 2);
+      x += run;
+      sx = 0;
+    }
+  }
+}
+
+void vmupro_blit_parallax_background(uint8_t *bg_buffer, int bg_width, int bg_height,
+                                     int scroll_x, int scroll_y, int parallax_factor_x, int parallax_factor_y)
+{
+  int sx = (int)(((int64_t)scroll_x * parallax_factor_x) >> 8);
+  int sy = (int)(((int64_t)scroll_y * parallax_factor_y) >> 8);
+  vmupro_blit_scrolling_background(bg_buffer, bg_width, bg_height, sx, sy, SCREEN_W, SCREEN_H);
+}
+
+void vmupro_blit_multi_parallax(uint8_t **bg_layers, int *layer_widths, int *layer_heights, int num_layers,
+                                int *parallax_factors_x, int *parallax_factors_y, int scroll_x, int scroll_y)
+{
+  if (bg_layers == NULL || layer_widths == NULL || layer_heights == NULL)
+    return;
+
+  // back to front
+  for (int i = 0; i < num_layers; i++)
+  {
+    int fx = parallax_factors_x ? parallax_factors_x[i] : 256;
+    int fy = parallax_factors_y ? parallax_factors_y[i] : 256;
+    vmupro_blit_parallax_background(bg_layers[i], layer_widths[i], layer_heights[i], scroll_x, scroll_y, fx, fy);
+  }
+}
+
+void vmupro_blit_line_scroll_background(uint8_t *bg_buffer, int bg_width, int bg_height,
+                                        int *scroll_x_per_line, int *scroll_y_per_line)
+{
+  DL_RECORD(DL_LINE_SCROLL_BG, bg_buffer && bg_width > 0 && bg_height > 0 ? DL_OPAQUE : 0, DL_FULL_SCREEN, NULL, 0,
+            DL_PTR(bg_buffer), bg_width, bg_height, DL_PTR(scroll_x_per_line), DL_PTR(scroll_y_per_line));
+  if (bg_buffer == NULL || bg_width <= 0 || bg_height <= 0)
+    return;
+  MarkDirtyFull();
+
+  for (int y = 0; y < SCREEN_H; y++)
+  {
+    int sx = WrapMod(scroll_x_per_line ? scroll_x_per_line[y] : 0, bg_width);
+    int sy = WrapMod(y + (scroll_y_per_line ? scroll_y_per_line[y] : 0), bg_height);
+    const uint8_t *src = bg_buffer + sy * bg_width * 2;
+    for (int x = 0; x < SCREEN_W; x++)
+    {
+      PutPx(x, y, LoadPx(src, sx));
+      if (++sx == bg_width)
+        sx = 0;
+    }
+  }
+}
+
+void vmupro_blit_column_scroll_background(uint8_t *bg_buffer, int bg_width, int bg_height,
+                                          int *scroll_x_per_column, int *scroll_y_per_column)
+{
+  DL_RECORD(DL_COLUMN_SCROLL_BG, bg_buffer && bg_width > 0 && bg_height > 0 ? DL_OPAQUE : 0, DL_FULL_SCREEN, NULL, 0,
+            DL_PTR(bg_buffer), bg_width, bg_height, DL_PTR(scroll_x_per_column), DL_PTR(scroll_y_per_column));
+  if (bg_buffer == NULL || bg_width <= 0 || bg_height <= 0)
+    return;
+  MarkDirtyFull();
+
+  for (int x = 0; x < SCREEN_W; x++)
+  {
+    int sx = WrapMod(x + (scroll_x_per_column ? scroll_x_per_column[x] : 0), bg_width);
+    int sy = WrapMod(scroll_y_per_column ? scroll_y_per_column[x] : 0, bg_height);
+    for (int y = 0; y < SCREEN_H; y++)
+    {
+      PutPx(x, y, LoadPx(bg_buffer, sy * bg_width + sx));
+      if (++sy == bg_height)
+        sy = 0;
+    }
+  }
+}
+
+//
+// Effects
+//
+
+// Average the (clamped) block of a source image into one pixel
+static uint16_t BlockAverage(const uint16_t *src, int stride, int x0, int y0, int bw, int bh)
+{
+  int r = 0, g = 0, b = 0;
+  for (int y = 0; y < bh; y++)
+  {
+    for (int x = 0; x < bw; x++)
+    {
+      uint16_t p = Swap16(src[(y0 + y) * stride + x0 + x]);
+      r += R5(p);
+      g += G6(p);
+      b += B5(p);
+    }
+  }
+  int n = bw * bh;
+  return Swap16(Pack565(r / n, g / n, b / n));
+}
+
+void vmupro_blit_buffer_mosaic(uint8_t *buffer, int x, int y, int width, int height, int mosaic_size)
+{
+  DL_RECORD(DL_MOSAIC, buffer ? DL_OPAQUE : 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height, mosaic_size);
+  if (buffer == NULL || width <= 0 || height <= 0)
+    return;
+  if (mosaic_size <= 1)
+  {
+    vmupro_blit_buffer_at(buffer, x, y, width, height);
+    return;
+  }
+
+  // blocks are aligned to the source image, not the screen
+  uint16_t *src = malloc(width * height * 2);
+  if (src == NULL)
+    return;
+  MarkDirty(x, y, width, height);
+  memcpy(src, buffer, width * height * 2);
+
+  for (int by = 0; by < height; by += mosaic_size)
+  {
+    int bh = by + mosaic_size > height ? height - by : mosaic_size;
+    for (int bx = 0; bx < width; bx += mosaic_size)
+    {
+      int bw = bx + mosaic_size > width ? width - bx : mosaic_size;
+      uint16_t avg = BlockAverage(src, width, bx, by, bw, bh);
+      for (int yy = 0; yy < bh; yy++)
+        for (int xx = 0; xx < bw; xx++)
+          PutPx(x + bx + xx, y + by + yy, avg);
+    }
+  }
+
+  free(src);
+}
+
+typedef struct
+{
+  Clip c;
+  int size;
+} MosaicCtx;
+
+// Rows [begin, end) of the clipped area, begin on a block boundary
+static void MosaicRows(int begin, int end, void *ctx)
+{
+  const MosaicCtx *m = ctx;
+  const Clip *c = &m->c;
+  uint16_t *t = Target();
+  for (int by = begin; by < end; by += m->size)
+  {
+    int bh = by + m->size > end ? end - by : m->size;
+    for (int bx = 0; bx < c->w; bx += m->size)
+    {
+      int bw = bx + m->size > c->w ? c->w - bx : m->size;
+      uint16_t avg = BlockAverage(t, SCREEN_W, c->dx + bx, c->dy + by, bw, bh);
+      for (int yy = 0; yy < bh; yy++)
+        for (int xx = 0; xx < bw; xx++)
+          PutPx(c->dx + bx + xx, c->dy + by + yy, avg);
+    }
+  }
+}
+
+void vmupro_apply_mosaic_to_screen(int x, int y, int width, int height, int mosaic_size)
+{
+  DL_RECORD(DL_MOSAIC_SCREEN, DL_BARRIER, DL_RECT(x, y, width, height), NULL, 0, x, y, width, height, mosaic_size);
+  Clip c;
+  if (mosaic_size <= 1 || !ClipDest(x, y, width, height, &c))
+    return;
+
+  MosaicCtx ctx = {c, mosaic_size};
+  RunSplit(MosaicRows, 0, c.h, mosaic_size, &ctx);
+}
+
+void vmupro_blit_buffer_blurred(uint8_t *buffer, int x, int y, int width, int height, int blur_radius)
+{
+  DL_RECORD(DL_BLURRED, buffer ? DL_OPAQUE : 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height, blur_radius);
+  if (buffer == NULL || width <= 0 || height <= 0)
+    return;
+  if (blur_radius <= 0)
+  {
+    vmupro_blit_buffer_at(buffer, x, y, width, height);
+    return;
+  }
+
+  // separable box blur, two passes approximate a gaussian
+  int n = width * height;
+  uint16_t *a = malloc(n * 2);
+  uint16_t *b = malloc(n * 2);
+  if (a == NULL || b == NULL)
+  {
+    free(a);
+    free(b);
+    return;
+  }
+  for (int i = 0; i < n; i++)
+    a[i] = Swap16(LoadPx(buffer, i));
+
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (int yy = 0; yy < height; yy++)
+    {
+      for (int xx = 0; xx < width; xx++)
+      {
+        int r = 0, g = 0, bl = 0, cnt = 0;
+        for (int k = -blur_radius; k <= blur_radius; k++)
+        {
+          int sx = pass == 0 ? xx + k : xx;
+          int sy = pass == 0 ? yy : yy + k;
+          if (sx < 0 || sy < 0 || sx >= width || sy >= height)
+            continue;
+          uint16_t p = a[sy * width + sx];
+          r += R5(p);
+          g += G6(p);
+          bl += B5(p);
+          cnt++;
+        }
+        b[yy * width + xx] = Pack565(r / cnt, g / cnt, bl / cnt);
+      }
+    }
+    uint16_t *t = a;
+    a = b;
+    b = t;
+  }
+
+  Clip c;
+  if (ClipDest(x, y, width, height, &c))
+  {
+    for (int row = 0; row < c.h; row++)
+      for (int col = 0; col < c.w; col++)
+        PutPx(c.dx + col, c.dy + row, Swap16(a[(c.sy + row) * width + c.sx + col]));
+  }
+
+  free(a);
+  free(b);
+}
+
+static bool OpShadowHighlight(uint16_t src, uint16_t dst, int x, int y, void *ctx, uint16_t *out)
+{
+  (void)dst, (void)x, (void)y;
+  uint16_t s = Swap16(src);
+  if (*(int *)ctx == 0)
+    *out = Swap16(Pack565(R5(s) >> 1, G6(s) >> 1, B5(s) >> 1));
+  else
+    *out = Swap16(Pack565((R5(s) + 31) >> 1, (G6(s) + 63) >> 1, (B5(s) + 31) >> 1));
+  return true;
+}
+
+void vmupro_blit_buffer_shadow_highlight(uint8_t *buffer, int x, int y, int width, int height, int mode)
+{
+  DL_RECORD(DL_SHADOW_HIGHLIGHT, buffer ? DL_OPAQUE : 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height, mode);
+  BlitGeneric(buffer, x, y, width, height, VMUPRO_DRAWFLAGS_NORMAL, OpShadowHighlight, &mode);
+}
+
+static bool OpMultiply(uint16_t src, uint16_t dst, int x, int y, void *ctx, uint16_t *out)
+{
+  (void)dst, (void)x, (void)y;
+  uint16_t s = Swap16(src);
+  uint16_t f = Swap16(*(uint16_t *)ctx);
+  *out = Swap16(Pack565(R5(s) * R5(f) / 31, G6(s) * G6(f) / 63, B5(s) * B5(f) / 31));
+  return true;
+}
+
+void vmupro_blit_buffer_color_multiply(uint8_t *buffer, int x, int y, int width, int height, vmupro_color_t color_filter)
+{
+  DL_RECORD(DL_COLOR_MULTIPLY, buffer ? DL_OPAQUE : 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height, color_filter);
+  uint16_t f = (uint16_t)color_filter;
+  BlitGeneric(buffer, x, y, width, height, VMUPRO_DRAWFLAGS_NORMAL, OpMultiply, &f);
+}
+
+static bool OpAdd(uint16_t src, uint16_t dst, int x, int y, void *ctx, uint16_t *out)
+{
+  (void)dst, (void)x, (void)y;
+  uint16_t s = Swap16(src);
+  uint16_t o = Swap16(*(uint16_t *)ctx);
+  *out = Swap16(Pack565(Clamp(R5(s) + R5(o), 0, 31), Clamp(G6(s) + G6(o), 0, 63), Clamp(B5(s) + B5(o), 0, 31)));
+  return true;
+}
+
+void vmupro_blit_buffer_color_add(uint8_t *buffer, int x, int y, int width, int height, vmupro_color_t color_offset)
+{
+  DL_RECORD(DL_COLOR_ADD, buffer ? DL_OPAQUE : 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height, color_offset);
+  uint16_t o = (uint16_t)color_offset;
+  BlitGeneric(buffer, x, y, width, height, VMUPRO_DRAWFLAGS_NORMAL, OpAdd, &o);
+}
+
+void vmupro_blit_buffer_fixed_alpha(uint8_t *buffer, int x, int y, int width, int height, int alpha_mode)
+{
+  DL_RECORD(DL_FIXED_ALPHA, 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height, alpha_mode);
+  static const int alphas[3] = {64, 128, 192};
+  int alpha = alphas[Clamp(alpha_mode, 0, 2)];
+  BlitGeneric(buffer, x, y, width, height, VMUPRO_DRAWFLAGS_NORMAL, OpBlend, &alpha);
+}
+
+//
+// Collision
+//
+
+int vmupro_sprite_collision_check(int sprite1_x, int sprite1_y, int sprite1_w, int sprite1_h,
+                                  int sprite2_x, int sprite2_y, int sprite2_w, int sprite2_h)
+{
+  return sprite1_x < sprite2_x + sprite2_w && sprite2_x < sprite1_x + sprite1_w &&
+         sprite1_y < sprite2_y + sprite2_h && sprite2_y < sprite1_y + sprite1_h;
+}
+
+int vmupro_sprite_pixel_collision(uint8_t *sprite1, uint8_t *sprite2, int x1, int y1, int x2, int y2,
+                                  int width1, int height1, int width2, int height2)
+{
+  if (!vmupro_sprite_collision_check(x1, y1, width1, height1, x2, y2, width2, height2))
+    return 0;
+
+  int left = x1 > x2 ? x1 : x2;
+  int top = y1 > y2 ? y1 : y2;
+  int right = (x1 + width1 < x2 + width2) ? x1 + width1 : x2 + width2;
+  int bottom = (y1 + height1 < y2 + height2) ? y1 + height1 : y2 + height2;
+
+  // zero (black) pixels count as empty
+  for (int y = top; y < bottom; y++)
+  {
+    for (int x = left; x < right; x++)
+    {
+      if (LoadPx(sprite1, (y - y1) * width1 + (x - x1)) != 0 &&
+          LoadPx(sprite2, (y - y2) * width2 + (x - x2)) != 0)
+        return 1;
+    }
+  }
+  return 0;
+}
+
+//
+// Layer blending
+//
+
+typedef struct
+{
+  uint8_t *layer1;
+  const uint8_t *layer2;
+} BlendCtx;
+
+static void BlendAdditivePixels(int begin, int end, void *ctx)
+{
+  const BlendCtx *l = ctx;
+  for (int i = begin; i < end; i++)
+  {
+    uint16_t a = Swap16(LoadPx(l->layer1, i));
+    uint16_t b = Swap16(LoadPx(l->layer2, i));
+    uint16_t r = Swap16(Pack565(Clamp(R5(a) + R5(b), 0, 31), Clamp(G6(a) + G6(b), 0, 63), Clamp(B5(a) + B5(b), 0, 31)));
+    memcpy(l->layer1 + i * 2, &r, 2);
+  }
+}
+
+void vmupro_blend_layers_additive(uint8_t *layer1, uint8_t *layer2, int width, int height)
+{
+  if (layer1 == NULL || layer2 == NULL)
+    return;
+  BlendCtx ctx = {layer1, layer2};
+  RunSplit(BlendAdditivePixels, 0, width * height, 1, &ctx);
+}
+
+static void BlendMultiplyPixels(int begin, int end, void *ctx)
+{
+  const BlendCtx *l = ctx;
+  for (int i = begin; i < end; i++)
+  {
+    uint16_t a = Swap16(LoadPx(l->layer1, i));
+    uint16_t b = Swap16(LoadPx(l->layer2, i));
+    uint16_t r = Swap16(Pack565(R5(a) * R5(b) / 31, G6(a) * G6(b) / 63, B5(a) * B5(b) / 31));
+    memcpy(l->layer1 + i * 2, &r, 2);
+  }
+}
+
+void vmupro_blend_layers_multiply(uint8_t *layer1, uint8_t *layer2, int width, int height)
+{
+  if (layer1 == NULL || layer2 == NULL)
+    return;
+  BlendCtx ctx = {layer1, layer2};
+  RunSplit(BlendMultiplyPixels, 0, width * height, 1, &ctx);
+}
+
+static void BlendScreenPixels(int begin, int end, void *ctx)
+{
+  const BlendCtx *l = ctx;
+  for (int i = begin; i < end; i++)
+  {
+    uint16_t a = Swap16(LoadPx(l->layer1, i));
+    uint16_t b = Swap16(LoadPx(l->layer2, i));
+    int r = 31 - (31 - R5(a)) * (31 - R5(b)) / 31;
+    int g = 63 - (63 - G6(a)) * (63 - G6(b)) / 63;
+    int bl = 31 - (31 - B5(a)) * (31 - B5(b)) / 31;
+    uint16_t out = Swap16(Pack565(r, g, bl));
+    memcpy(l->layer1 + i * 2, &out, 2);
+  }
+}
+
+void vmupro_blend_layers_screen(uint8_t *layer1, uint8_t *layer2, int width, int height)
+{
+  if (layer1 == NULL || layer2 == NULL)
+    return;
+  BlendCtx ctx = {layer1, layer2};
+  RunSplit(BlendScreenPixels, 0, width * height, 1, &ctx);
+}
+
+//
+// Windowing & masking
+//
+
+void vmupro_set_color_window(int x1, int y1, int x2, int y2, vmupro_color_t mask_color)
+{
+  DL_RECORD(DL_SET_WINDOW, 0, DL_RECT(0, 0, 0, 0), NULL, 0, x1, y1, x2, y2, mask_color);
+  colorWindow.active = true;
+  colorWindow.x1 = x1 < x2 ? x1 : x2;
+  colorWindow.x2 = x1 < x2 ? x2 : x1;
+  colorWindow.y1 = y1 < y2 ? y1 : y2;
+  colorWindow.y2 = y1 < y2 ? y2 : y1;
+  colorWindow.mask = (uint16_t)mask_color;
+}
+
+void vmupro_clear_color_window(void)
+{
+  DL_RECORD(DL_CLEAR_WINDOW, 0, DL_RECT(0, 0, 0, 0), NULL, 0, 0);
+  colorWindow.active = false;
+}
+
+void vmupro_blit_buffer_masked(uint8_t *buffer, uint8_t *mask, int x, int y, int width, int height, vmupro_drawflags_t flags)
+{
+  DL_RECORD(DL_MASKED, 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), DL_PTR(mask), x, y, width, height, flags);
+  Clip c;
+  if (buffer == NULL || mask == NULL || !ClipDest(x, y, width, height, &c))
+    return;
+
+  for (int row = 0; row < c.h; row++)
+  {
+    int sy = c.sy + row;
+    if (flags & VMUPRO_DRAWFLAGS_FLIP_V)
+      sy = height - 1 - sy;
+    for (int col = 0; col < c.w; col++)
+    {
+      int sx = c.sx + col;
+      if (flags & VMUPRO_DRAWFLAGS_FLIP_H)
+        sx = width - 1 - sx;
+      if (mask[sy * width + sx])
+        PutPx(c.dx + col, c.dy + row, LoadPx(buffer, sy * width + sx));
+    }
+  }
+}
+
+//
+// Palettes
+//
+
+typedef struct
+{
+  const uint16_t *from;
+  const uint16_t *to;
+  int size;
+} SwapCtx;
+
+static bool OpPaletteSwap(uint16_t src, uint16_t dst, int x, int y, void *ctx, uint16_t *out)
+{
+  (void)dst, (void)x, (void)y;
+  SwapCtx *s = ctx;
+  *out = src;
+  for (int i = 0; i < s->size; i++)
+  {
+    if (s->from[i] == src)
+    {
+      *out = s->to[i];
+      break;
+    }
+  }
+  return true;
+}
+
+void vmupro_blit_buffer_palette_swap(uint8_t *buffer, int x, int y, int width, int height,
+                                     uint16_t *old_palette, uint16_t *new_palette, int palette_size)
+{
+  DL_RECORD(DL_PALETTE_SWAP, buffer ? DL_OPAQUE : 0, DL_RECT(x, y, width, height), NULL, 0,
+            DL_PTR(buffer), x, y, width, height, DL_PTR(old_palette), DL_PTR(new_palette), palette_size);
+  if (old_palette == NULL || new_palette == NULL || palette_size <= 0)
+  {
+    vmupro_blit_buffer_at(buffer, x, y, width, height);
+    return;
+  }
+  SwapCtx ctx = {old_palette, new_palette, palette_size};
+  BlitGeneric(buffer, x, y, width, height, VMUPRO_DRAWFLAGS_NORMAL, OpPaletteSwap, &ctx);
+}
+
+void vmupro_animate_palette_range(uint16_t *palette, int start_index, int end_index, int shift_amount)
+{
+  if (palette == NULL || end_index <= start_index)
+    return;
+
+  int len = end_index - start_index + 1;
+  int shift = WrapMod(shift_amount, len);
+  if (shift == 0)
+    return;
+
+  uint16_t tmp[256];
+  uint16_t *scratch = len <= 256 ? tmp : malloc(len * 2);
+  if (scratch == NULL)
+    return;
+  for (int i = 0; i < len; i++)
+    scratch[(i + shift) % len] = palette[start_index + i];
+  memcpy(palette + start_index, scratch, len * 2);
+  if (scratch != tmp)
+    free(scratch);
+}
+
+void vmupro_interpolate_palette(uint16_t *palette1, uint16_t *palette2, uint16_t *result, int size, int factor_256)
+{
+  if (palette1 == NULL || palette2 == NULL || result == NULL)
+    return;
+
+  int f = Clamp(factor_256, 0, 256);
+  for (int i = 0; i < size; i++)
+  {
+    uint16_t a = Swap16(palette1[i]);
+    uint16_t b = Swap16(palette2[i]);
+    int r = R5(a) + ((R5(b) - R5(a)) * f >> 8);
+    int g = G6(a) + ((G6(b) - G6(a)) * f >> 8);
+    int bl = B5(a) + ((B5(b) - B5(a)) * f >> 8);
+    result[i] = Swap16(Pack565(r, g, bl));
+  }
+}
+
+//
+// Sprites
+//
+
+static int CompareSpritePriority(const void *a, const void *b)
+{
+  const vmupro_sprite_t *sa = *(const vmupro_sprite_t *const *)a;
+  const vmupro_sprite_t *sb = *(const vmupro_sprite_t *const *)b;
+  if (sa->priority != sb->priority)
+    return sa->priority < sb->priority ? -1 : 1;
+  // keep submission order for equal priorities
+  return sa < sb ? -1 : (sa > sb ? 1 : 0);
+}
+
+typedef struct
+{
+  int key;
+  int alpha;
+} SpriteCtx;
+
+static bool OpSprite(uint16_t src, uint16_t dst, int x, int y, void *ctx, uint16_t *out)
+{
+  (void)x, (void)y;
+  SpriteCtx *s = ctx;
+  if (s->key >= 0 && src == (uint16_t)s->key)
+    return false;
+  *out = s->alpha == 255 ? src : BlendBE(src, dst, s->alpha);
+  return true;
+}
+
+static void RenderSpritesDirect(vmupro_sprite_t **order, int num_sprites)
+{
+  for (int i = 0; i < num_sprites; i++)
+  {
+    vmupro_sprite_t *s = order[i];
+    if (s->alpha == 0)
+      continue;
+    int key = (int)s->transparent_color;
+    SpriteCtx ctx = {key < 0 ? -1 : (key & 0xffff), s->alpha};
+    vmupro_drawflags_t flags = (s->flip_h ? VMUPRO_DRAWFLAGS_FLIP_H : 0) | (s->flip_v ? VMUPRO_DRAWFLAGS_FLIP_V : 0);
+    BlitGeneric(s->buffer, s->x, s->y, s->width, s->height, flags, OpSprite, &ctx);
+  }
+}
+
+//
+// Tiled sprite batches
+//
+// Each screen tile keeps a bitset over sprite ranks (position in priority
+// order), so walking the set bits of a tile visits its sprites back to
+// front. The bins survive between calls and are patched per sprite when
+// only positions change.
+//
+
+#define SPRITE_TILE_MAX 32
+
+static vmupro_sprite_batch_mode_t spriteBatchMode = VMUPRO_SPRITE_BATCH_DIRECT;
+static uint16_t spriteTile[SPRITE_TILE_MAX * SPRITE_TILE_MAX];
+
+static struct
+{
+  bool valid;
+  int tileSize;
+  int tilesX, tilesY;
+  int count;
+  int words;              // bitset words per tile
+  int *priority;          // per sprite, to notice reordering
+  int *order;             // rank -> sprite index
+  int *rank;              // sprite index -> rank
+  vmupro_rect_t *covered; // clipped screen area per sprite, width 0 if not drawn
+  uint32_t *bins;         // tilesX * tilesY bitsets
+} spriteBins;
+
+static void FreeSpriteBins(void)
+{
+  free(spriteBins.priority);
+  free(spriteBins.order);
+  free(spriteBins.rank);
+  free(spriteBins.covered);
+  free(spriteBins.bins);
+  memset(&spriteBins, 0, sizeof(spriteBins));
+}
+
+static vmupro_rect_t SpriteCoverage(const vmupro_sprite_t *s)
+{
+  Clip c;
+  if (s->buffer == NULL || s->alpha == 0 || !ClipRect(s->x, s->y, s->width, s->height, &c))
+    return (vmupro_rect_t){0, 0, 0, 0};
+  return (vmupro_rect_t){c.dx, c.dy, c.w, c.h};
+}
+
+static void BinSprite(int rank, const vmupro_rect_t *r, bool set)
+{
+  if (r->width == 0)
+    return;
+
+  int ts = spriteBins.tileSize;
+  uint32_t bit = 1u << (rank & 31);
+  int word = rank >> 5;
+  for (int ty = r->y / ts; ty <= (r->y + r->height - 1) / ts; ty++)
+  {
+    for (int tx = r->x / ts; tx <= (r->x + r->width - 1) / ts; tx++)
+    {
+      uint32_t *w = &spriteBins.bins[(ty * spriteBins.tilesX + tx) * spriteBins.words + word];
+      *w = set ? (*w | bit) : (*w & ~bit);
+    }
+  }
+  stats.sprites_binned++;
+}
+
+static bool RebuildSpriteBins(vmupro_sprite_t *sprites, int num_sprites, int tileSize)
+{
+  FreeSpriteBins();
+
+  spriteBins.tileSize = tileSize;
+  spriteBins.tilesX = (SCREEN_W + tileSize - 1) / tileSize;
+  spriteBins.tilesY = (SCREEN_H + tileSize - 1) / tileSize;
+  spriteBins.count = num_sprites;
+  spriteBins.words = (num_sprites + 31) / 32;
+  spriteBins.priority = malloc(sizeof(int) * num_sprites);
+  spriteBins.order = malloc(sizeof(int) * num_sprites);
+  spriteBins.rank = malloc(sizeof(int) * num_sprites);
+  spriteBins.covered = malloc(sizeof(vmupro_rect_t) * num_sprites);
+  spriteBins.bins = calloc(spriteBins.tilesX * spriteBins.tilesY * spriteBins.words, sizeof(uint32_t));
+  vmupro_sprite_t **sorted = malloc(sizeof(vmupro_sprite_t *) * num_sprites);
+  if (spriteBins.priority == NULL || spriteBins.order == NULL || spriteBins.rank == NULL ||
+      spriteBins.covered == NULL || spriteBins.bins == NULL || sorted == NULL)
+  {
+    free(sorted);
+    FreeSpriteBins();
+    return false;
+  }
+
+  for (int i = 0; i < num_sprites; i++)
+    sorted[i] = &sprites[i];
+  qsort(sorted, num_sprites, sizeof(vmupro_sprite_t *), CompareSpritePriority);
+
+  for (int r = 0; r < num_sprites; r++)
+  {
+    int i = (int)(sorted[r] - sprites);
+    spriteBins.order[r] = i;
+    spriteBins.rank[i] = r;
+    spriteBins.priority[i] = sprites[i].priority;
+    spriteBins.covered[i] = SpriteCoverage(&sprites[i]);
+    BinSprite(r, &spriteBins.covered[i], true);
+  }
+
+  free(sorted);
+  spriteBins.valid = true;
+  return true;
+}
+
+static bool UpdateSpriteBins(vmupro_sprite_t *sprites, int num_sprites, int tileSize)
+{
+  bool reuse = spriteBins.valid && spriteBins.tileSize == tileSize && spriteBins.count == num_sprites;
+  for (int i = 0; reuse && i < num_sprites; i++)
+    reuse = spriteBins.priority[i] == sprites[i].priority;
+  if (!reuse)
+    return RebuildSpriteBins(sprites, num_sprites, tileSize);
+
+  for (int i = 0; i < num_sprites; i++)
+  {
+    vmupro_rect_t now = SpriteCoverage(&sprites[i]);
+    vmupro_rect_t *was = &spriteBins.covered[i];
+    if (now.x == was->x && now.y == was->y && now.width == was->width && now.height == was->height)
+      continue;
+    BinSprite(spriteBins.rank[i], was, false);
+    BinSprite(spriteBins.rank[i], &now, true);
+    *was = now;
+  }
+  return true;
+}
+
+// Composite one sprite into the tile buffer at screen tile origin tx0,ty0
+static void CompositeSpriteTile(const vmupro_sprite_t *s, const vmupro_rect_t *covered,
+                                int tx0, int ty0, int tw, int th)
+{
+  int x0 = covered->x > tx0 ? covered->x : tx0;
+  int y0 = covered->y > ty0 ? covered->y : ty0;
+  int x1 = covered->x + covered->width < tx0 + tw ? covered->x + covered->width : tx0 + tw;
+  int y1 = covered->y + covered->height < ty0 + th ? covered->y + covered->height : ty0 + th;
+
+  int key = (int)s->transparent_color;
+  key = key < 0 ? -1 : (key & 0xffff);
+  int step = s->flip_h ? -1 : 1;
+  bool window = colorWindow.active;
+
+  for (int y = y0; y < y1; y++)
+  {
+    int sy = y - s->y;
+    if (s->flip_v)
+      sy = s->height - 1 - sy;
+    int sx = x0 - s->x;
+    if (s->flip_h)
+      sx = s->width - 1 - sx;
+    const uint8_t *src = s->buffer + (sy * s->width + sx) * 2;
+    uint16_t *dst = spriteTile + (y - ty0) * tw - tx0;
+
+    for (int x = x0; x < x1; x++, src += step * 2)
+    {
+      uint16_t p;
+      memcpy(&p, src, 2);
+      if (key >= 0 && p == (uint16_t)key)
+        continue;
+      uint16_t out = s->alpha == 255 ? p : BlendBE(p, dst[x], s->alpha);
+      if (!window || !WindowBlocks(x, y, out))
+        dst[x] = out;
+    }
+  }
+}
+
+static void RenderSpritesTiled(vmupro_sprite_t *sprites)
+{
+  int ts = spriteBins.tileSize;
+  uint16_t *t = Target();
+
+  for (int i = 0; i < spriteBins.count; i++)
+  {
+    const vmupro_rect_t *r = &spriteBins.covered[i];
+    if (r->width > 0)
+      MarkDirty(r->x, r->y, r->width, r->height);
+  }
+
+  for (int ty = 0; ty < spriteBins.tilesY; ty++)
+  {
+    for (int tx = 0; tx < spriteBins.tilesX; tx++)
+    {
+      const uint32_t *bits = &spriteBins.bins[(ty * spriteBins.tilesX + tx) * spriteBins.words];
+      bool used = false;
+      for (int w = 0; w < spriteBins.words && !used; w++)
+        used = bits[w] != 0;
+      if (!used)
+        continue;
+
+      int x0 = tx * ts;
+      int y0 = ty * ts;
+      int tw = x0 + ts > SCREEN_W ? SCREEN_W - x0 : ts;
+      int th = y0 + ts > SCREEN_H ? SCREEN_H - y0 : ts;
+      for (int row = 0; row < th; row++)
+        memcpy(spriteTile + row * tw, t + (y0 + row) * SCREEN_W + x0, tw * 2);
+
+      for (int w = 0; w < spriteBins.words; w++)
+      {
+        uint32_t word = bits[w];
+        while (word)
+        {
+          int rank = w * 32 + __builtin_ctz(word);
+          word &= word - 1;
+          int i = spriteBins.order[rank];
+          CompositeSpriteTile(&sprites[i], &spriteBins.covered[i], x0, y0, tw, th);
+        }
+      }
+
+      for (int row = 0; row < th; row++)
+        memcpy(t + (y0 + row) * SCREEN_W + x0, spriteTile + row * tw, tw * 2);
+      stats.sprite_tiles++;
+    }
+  }
+}
+
+// Screen area a batch can touch
+static vmupro_rect_t SpritesBounds(const vmupro_sprite_t *sprites, int num_sprites)
+{
+  vmupro_rect_t box = {0, 0, 0, 0};
+  for (int i = 0; sprites != NULL && i < num_sprites; i++)
+  {
+    vmupro_rect_t r = SpriteCoverage(&sprites[i]);
+    if (RectArea(&r) > 0)
+      box = RectArea(&box) > 0 ? RectUnion(&box, &r) : r;
+  }
+  return box;
+}
+
+void vmupro_sprite_batch_render(vmupro_sprite_t *sprites, int num_sprites)
+{
+  DL_RECORD(DL_SPRITE_BATCH, 0, SpritesBounds(sprites, num_sprites), sprites,
+            sprites && num_sprites > 0 ? num_sprites * sizeof(*sprites) : 0, num_sprites);
+  if (sprites == NULL || num_sprites <= 0)
+    return;
+
+  if (spriteBatchMode != VMUPRO_SPRITE_BATCH_DIRECT && UpdateSpriteBins(sprites, num_sprites, spriteBatchMode))
+  {
+    RenderSpritesTiled(sprites);
+    return;
+  }
+
+  vmupro_sprite_t **order = malloc(sizeof(vmupro_sprite_t *) * num_sprites);
+  if (order == NULL)
+    return;
+  for (int i = 0; i < num_sprites; i++)
+    order[i] = &sprites[i];
+  qsort(order, num_sprites, sizeof(vmupro_sprite_t *), CompareSpritePriority);
+  RenderSpritesDirect(order, num_sprites);
+  free(order);
+}
+
+void vmupro_set_sprite_batch_mode(vmupro_sprite_batch_mode_t mode)
+{
+  if (mode != VMUPRO_SPRITE_BATCH_TILED_16 && mode != VMUPRO_SPRITE_BATCH_TILED_32)
+    mode = VMUPRO_SPRITE_BATCH_DIRECT;
+  if (mode != spriteBatchMode)
+    FreeSpriteBins();
+  spriteBatchMode = mode;
+}
+
+vmupro_sprite_batch_mode_t vmupro_get_sprite_batch_mode(void)
+{
+  return spriteBatchMode;
+}
+
+//
+// Tilemaps
+//
+
+static inline int FloorDiv(int v, int d)
+{
+  return v >= 0 ? v / d : -((-v + d - 1) / d);
+}
+
+// Tile atlas rows: RGB565, or an indexed image (vmupro_indexed.h)
+// expanded through the tilemap's palette
+typedef struct
+{
+  const uint8_t *pixels;
+  int stride; // bytes per atlas row
+  int bpp;    // 16 for RGB565, else 8 or 4
+  int tilesPerRow;
+} TileAtlas;
+
+static bool GetTileAtlas(const vmupro_tilemap_t *tm, TileAtlas *a)
+{
+  int width = tm->atlas_width;
+  a->pixels = tm->atlas;
+  a->bpp = 16;
+  if (tm->palette != NULL)
+  {
+    if (!vmupro_indexed_get_info(tm->atlas, &width, NULL, &a->bpp))
+      return false;
+    a->pixels = tm->atlas + VMUPRO_INDEXED_HEADER_SIZE;
+  }
+  if (width < tm->tile_width)
+    return false;
+  a->stride = a->bpp == 16 ? width * 2 : VMUPRO_INDEXED_STRIDE(width, a->bpp);
+  a->tilesPerRow = width / tm->tile_width;
+  return true;
+}
+
+// Start of row ty of a tile, at the tile's left edge for RGB565 atlases
+// and at the atlas' left edge for indexed ones
+static inline const uint8_t *TileRow(const TileAtlas *a, const vmupro_tilemap_t *tm, int tile, int ty)
+{
+  const uint8_t *row = a->pixels + ((tile / a->tilesPerRow) * tm->tile_height + ty) * a->stride;
+  return a->bpp == 16 ? row + (tile % a->tilesPerRow) * tm->tile_width * 2 : row;
+}
+
+static inline int AtlasIndex(const uint8_t *row, int bpp, int x)
+{
+  return bpp == 8 ? row[x] : (row[x >> 1] >> ((x & 1) ? 0 : 4)) & 0x0f;
+}
+
+static bool ValidTilemap(const vmupro_tilemap_t *tm)
+{
+  TileAtlas a;
+  return tm != NULL && tm->atlas != NULL && tm->map != NULL && tm->tile_width > 0 && tm->tile_height > 0 &&
+         tm->map_width > 0 && tm->map_height > 0 && (tm->entry_size == 1 || tm->entry_size == 2) &&
+         GetTileAtlas(tm, &a);
+}
+
+int vmupro_tilemap_classify_rows(const vmupro_tilemap_t *tilemap, uint8_t *out_classes, int out_size)
+{
+  if (!ValidTilemap(tilemap))
+    return -1;
+
+  // The atlas height isn't known, so classify up to the highest tile
+  // index the map refers to
+  TileAtlas a;
+  GetTileAtlas(tilemap, &a);
+  int needed = 0;
+  for (int i = 0; i < tilemap->map_width * tilemap->map_height; i++)
+  {
+    int tile = tilemap->entry_size == 1 ? ((const uint8_t *)tilemap->map)[i]
+                                        : ((const uint16_t *)tilemap->map)[i] & VMUPRO_TILE_INDEX_MASK;
+    if (tile + 1 > needed)
+      needed = tile + 1;
+  }
+  needed *= tilemap->tile_height;
+  if (out_classes == NULL)
+    return needed;
+  if (out_size < needed)
+    return -1;
+
+  int key = tilemap->transparent_color;
+  for (int r = 0; r < needed; r++)
+  {
+    int tile = r / tilemap->tile_height;
+    const uint8_t *src = TileRow(&a, tilemap, tile, r % tilemap->tile_height);
+    int x0 = (tile % a.tilesPerRow) * tilemap->tile_width;
+    int keyed = 0;
+    for (int x = 0; x < tilemap->tile_width && key >= 0; x++)
+      keyed += (a.bpp == 16 ? LoadPx(src, x) : AtlasIndex(src, a.bpp, x0 + x)) == key;
+    out_classes[r] = keyed == 0 ? VMUPRO_TILEROW_OPAQUE
+                                : (keyed == tilemap->tile_width ? VMUPRO_TILEROW_EMPTY : VMUPRO_TILEROW_MIXED);
+  }
+  return needed;
+}
+
+// Draw the view (c.dx, c.dy, c.w, c.h) of the map, where screen pixel
+// (originX, originY) shows map pixel (scrollX, scrollY)
+static void TilemapRender(const vmupro_tilemap_t *tm, int scrollX, int scrollY, int originX, int originY,
+                          const Clip *c, uint8_t alpha)
+{
+  int tw = tm->tile_width;
+  int th = tm->tile_height;
+  int key = tm->transparent_color;
+  uint16_t *t = Target();
+  TileAtlas a;
+  GetTileAtlas(tm, &a);
+
+  for (int dy = c->dy; dy < c->dy + c->h; dy++)
+  {
+    int mapY = scrollY + (dy - originY);
+    int cellY = FloorDiv(mapY, th);
+    int ty = mapY - cellY * th;
+    if (tm->wrap)
+      cellY = WrapMod(cellY, tm->map_height);
+    else if (cellY < 0 || cellY >= tm->map_height)
+      continue;
+
+    uint16_t *dst = t + dy * SCREEN_W;
+    int mapX = scrollX + (c->dx - originX);
+    int cellX = FloorDiv(mapX, tw);
+    int tx = mapX - cellX * tw;
+    if (tm->wrap)
+      cellX = WrapMod(cellX, tm->map_width);
+
+    int dx = c->dx;
+    int dxEnd = c->dx + c->w;
+    while (dx < dxEnd)
+    {
+      // one tile row span per cell, modulo only on entering a cell
+      int span = tw - tx;
+      if (span > dxEnd - dx)
+        span = dxEnd - dx;
+
+      bool inside = cellX >= 0 && cellX < tm->map_width;
+      int tile = -1;
+      int flags = 0;
+      if (inside)
+      {
+        int cell = cellY * tm->map_width + cellX;
+        if (tm->entry_size == 1)
+        {
+          tile = ((const uint8_t *)tm->map)[cell];
+          flags = tm->attributes ? tm->attributes[cell] : 0;
+        }
+        else
+        {
+          uint16_t e = ((const uint16_t *)tm->map)[cell];
+          tile = e & VMUPRO_TILE_INDEX_MASK;
+          flags = ((e & VMUPRO_TILE_FLIP_H) ? VMUPRO_DRAWFLAGS_FLIP_H : 0) |
+                  ((e & VMUPRO_TILE_FLIP_V) ? VMUPRO_DRAWFLAGS_FLIP_V : 0);
+        }
+      }
+
+      if (tile >= 0 && tile != tm->empty_tile)
+      {
+        int sy = (flags & VMUPRO_DRAWFLAGS_FLIP_V) ? th - 1 - ty : ty;
+        const uint8_t *src = TileRow(&a, tm, tile, sy);
+        int rowClass = key < 0 ? VMUPRO_TILEROW_OPAQUE
+                               : (tm->row_classes ? tm->row_classes[tile * th + sy] : VMUPRO_TILEROW_MIXED);
+        bool flipH = (flags & VMUPRO_DRAWFLAGS_FLIP_H) != 0;
+
+        if (rowClass == VMUPRO_TILEROW_EMPTY)
+        {
+          // nothing to draw
+        }
+        else if (a.bpp != 16)
+        {
+          // indexed atlas: the key is a palette index, tested before lookup
+          int x0 = (tile % a.tilesPerRow) * tw;
+          bool plain = alpha == 255 && !colorWindow.active;
+          for (int i = 0; i < span; i++)
+          {
+            int index = AtlasIndex(src, a.bpp, x0 + (flipH ? tw - 1 - (tx + i) : tx + i));
+            if (rowClass != VMUPRO_TILEROW_OPAQUE && index == key)
+              continue;
+            uint16_t px = tm->palette[index];
+            if (!plain && alpha != 255)
+              px = BlendBE(px, dst[dx + i], alpha);
+            if (plain || !WindowBlocks(dx + i, dy, px))
+              dst[dx + i] = px;
+          }
+        }
+        else if (alpha == 255 && !colorWindow.active)
+        {
+          // opaque rows need no key test, the rest use the color-key kernel
+          const uint8_t *first = src + (flipH ? tw - 1 - tx : tx) * 2;
+          if (rowClass == VMUPRO_TILEROW_OPAQUE && !flipH)
+            memcpy(dst + dx, first, span * 2);
+          else if (rowClass == VMUPRO_TILEROW_OPAQUE)
+            for (int i = 0; i < span; i++)
+              dst[dx + i] = LoadPx(first, -i);
+          else
+            (scalarKernels ? KeyRowScalar : KeyRowVector)(dst + dx, first, span, (uint16_t)key, flipH);
+        }
+        else
+        {
+          for (int i = 0; i < span; i++)
+          {
+            int sx = flipH ? tw - 1 - (tx + i) : tx + i;
+            uint16_t px = LoadPx(src, sx);
+            if (key >= 0 && px == (uint16_t)key)
+              continue;
+            if (alpha != 255)
+              px = BlendBE(px, dst[dx + i], alpha);
+            if (!WindowBlocks(dx + i, dy, px))
+              dst[dx + i] = px;
+          }
+        }
+      }
+
+      dx += span;
+      tx = 0;
+      if (++cellX == tm->map_width && tm->wrap)
+        cellX = 0;
+    }
+  }
+}
+
+void vmupro_tilemap_render(const vmupro_tilemap_t *tilemap, int scroll_x, int scroll_y,
+                           int x, int y, int width, int height)
+{
+  DL_RECORD(DL_TILEMAP, 0, DL_RECT(x, y, width, height), tilemap, tilemap ? sizeof(*tilemap) : 0,
+            scroll_x, scroll_y, x, y, width, height);
+  Clip c;
+  if (!ValidTilemap(tilemap) || !ClipDest(x, y, width, height, &c))
+    return;
+  TilemapRender(tilemap, scroll_x, scroll_y, x, y, &c, 255);
+}
+
+//
+// Layers
+//
+
+static bool ValidLayer(int layer_id)
+{
+  return layer_id >= 0 && layer_id < VMUPRO_MAX_LAYERS;
+}
+
+void vmupro_layer_create(int layer_id, int width, int height)
+{
+  if (!ValidLayer(layer_id) || width <= 0 || height <= 0)
+    return;
+
+  vmupro_layer_destroy(layer_id);
+  vmupro_layer_t *l = &layers[layer_id];
+  l->buffer = calloc(width * height, 2);
+  if (l->buffer == NULL)
+    return;
+  l->active = true;
+  l->width = width;
+  l->height = height;
+  l->scroll_x = 0;
+  l->scroll_y = 0;
+  l->priority = layer_id;
+  l->alpha = 255;
+}
+
+void vmupro_layer_destroy(int layer_id)
+{
+  if (!ValidLayer(layer_id))
+    return;
+  free(layers[layer_id].buffer);
+  memset(&layers[layer_id], 0, sizeof(vmupro_layer_t));
+}
+
+void vmupro_layer_set_scroll(int layer_id, int scroll_x, int scroll_y)
+{
+  if (!ValidLayer(layer_id))
+    return;
+  layers[layer_id].scroll_x = scroll_x;
+  layers[layer_id].scroll_y = scroll_y;
+}
+
+void vmupro_layer_set_priority(int layer_id, int priority)
+{
+  if (ValidLayer(layer_id))
+    layers[layer_id].priority = priority;
+}
+
+void vmupro_layer_set_alpha(int layer_id, uint8_t alpha)
+{
+  if (ValidLayer(layer_id))
+    layers[layer_id].alpha = alpha;
+}
+
+void vmupro_layer_blit_background(int layer_id, uint8_t *bg_buffer, int bg_width, int bg_height)
+{
+  if (!ValidLayer(layer_id) || !layers[layer_id].active || layers[layer_id].buffer == NULL || bg_buffer == NULL)
+    return;
+
+  vmupro_layer_t *l = &layers[layer_id];
+  int w = bg_width < l->width ? bg_width : l->width;
+  int h = bg_height < l->height ? bg_height : l->height;
+  for (int y = 0; y < h; y++)
+    memcpy(l->buffer + y * l->width * 2, bg_buffer + y * bg_width * 2, w * 2);
+}
+
+void vmupro_layer_set_tilemap(int layer_id, const vmupro_tilemap_t *tilemap)
+{
+  if (!ValidLayer(layer_id))
+    return;
+
+  vmupro_layer_destroy(layer_id);
+  if (!ValidTilemap(tilemap))
+    return;
+
+  vmupro_layer_t *l = &layers[layer_id];
+  l->active = true;
+  l->tilemap = tilemap;
+  l->width = tilemap->map_width * tilemap->tile_width;
+  l->height = tilemap->map_height * tilemap->tile_height;
+  l->priority = layer_id;
+  l->alpha = 255;
+}
+
+// Active layers, sorted by priority (stable on layer id)
+static int SortedLayers(int *order)
+{
+  int count = 0;
+  for (int i = 0; i < VMUPRO_MAX_LAYERS; i++)
+  {
+    if (layers[i].active)
+      order[count++] = i;
+  }
+
+  // insertion sort, stable on layer id for equal priorities
+  for (int i = 1; i < count; i++)
+  {
+    int v = order[i];
+    int j = i - 1;
+    while (j >= 0 && layers[order[j]].priority > layers[v].priority)
+    {
+      order[j + 1] = order[j];
+      j--;
+    }
+    order[j + 1] = v;
+  }
+  return count;
+}
+
+// Draw screen row y of a layer, with (scrollX, scrollY) at the top-left
+static void DrawLayerRow(const vmupro_layer_t *l, int y, int scrollX, int scrollY)
+{
+  if (l->tilemap != NULL)
+  {
+    Clip c = {0, y, 0, 0, SCREEN_W, 1};
+    TilemapRender(l->tilemap, scrollX, scrollY, 0, 0, &c, l->alpha);
+    return;
+  }
+
+  const uint8_t *src = l->buffer + ((WrapMod(scrollY, l->height) + y) % l->height) * l->width * 2;
+  uint16_t *dst = Target() + y * SCREEN_W;
+  int sx = WrapMod(scrollX, l->width);
+
+  if (l->alpha == 255 && !colorWindow.active)
+  {
+    // copy in runs up to the wrap point
+    int x = 0;
+    while (x < SCREEN_W)
+    {
+      int run = l->width - sx;
+      if (run > SCREEN_W - x)
+        run = SCREEN_W - x;
+      memcpy(dst + x, src + sx * 2, run * 2);
+      x += run;
+      sx = 0;
+    }
+    return;
+  }
+
+  for (int x = 0; x < SCREEN_W; x++)
+  {
+    uint16_t px = LoadPx(src, sx);
+    if (l->alpha != 255)
+      px = BlendBE(px, dst[x], l->alpha);
+    if (!WindowBlocks(x, y, px))
+      dst[x] = px;
+    if (++sx == l->width)
+      sx = 0;
+  }
+}
+
+typedef struct
+{
+  int order[VMUPRO_MAX_LAYERS];
+  int count;
+} LayersCtx;
+
+// Composite every layer into screen rows [begin, end)
+static void LayerRows(int begin, int end, void *ctx)
+{
+  const LayersCtx *lc = ctx;
+  for (int i = 0; i < lc->count; i++)
+  {
+    const vmupro_layer_t *l = &layers[lc->order[i]];
+    if (l->alpha == 0)
+      continue;
+
+    if (l->tilemap != NULL)
+    {
+      Clip c = {0, begin, 0, begin, SCREEN_W, end - begin};
+      TilemapRender(l->tilemap, l->scroll_x, l->scroll_y, 0, 0, &c, l->alpha);
+      continue;
+    }
+
+    for (int y = begin; y < end; y++)
+      DrawLayerRow(l, y, l->scroll_x, l->scroll_y);
+  }
+}
+
+void vmupro_render_all_layers(void)
+{
+  DL_RECORD(DL_RENDER_LAYERS, 0, DL_FULL_SCREEN, NULL, 0, 0);
+  LayersCtx ctx;
+  ctx.count = SortedLayers(ctx.order);
+
+  for (int i = 0; i < ctx.count; i++)
+  {
+    if (layers[ctx.order[i]].alpha != 0)
+    {
+      MarkDirtyFull();
+      break;
+    }
+  }
+  RunSplit(LayerRows, 0, SCREEN_H, 1, &ctx);
+}
+
+//
+// Raster effects
+//
+
+static void ApplyRasterPalette(uint16_t *row, const vmupro_raster_palette_t *p)
+{
+  for (int x = 0; x < SCREEN_W; x++)
+  {
+    uint16_t c = Swap16(row[x]);
+    row[x] = Swap16(Pack565(p->r[R5(c)], p->g[G6(c)], p->b[B5(c)]));
+  }
+}
+
+void vmupro_render_layers_raster(const vmupro_raster_line_t *lines, vmupro_raster_callback_t callback,
+                                 void *user_data, const vmupro_raster_palette_t *palettes, int num_palettes)
+{
+  DL_RECORD(DL_RENDER_RASTER, callback ? DL_KEEP : 0, DL_FULL_SCREEN, NULL, 0,
+            DL_PTR(lines), DL_PTR(callback), DL_PTR(user_data), DL_PTR(palettes), num_palettes);
+  int order[VMUPRO_MAX_LAYERS];
+  int count = SortedLayers(order);
+  MarkDirtyFull();
+
+  // one pass: every line composites its own layers, then gets its palette
+  for (int y = 0; y < SCREEN_H; y++)
+  {
+    vmupro_raster_line_t p = {0, 0, 0, VMUPRO_RASTER_ALL_LAYERS};
+    if (lines != NULL)
+      p = lines[y];
+    if (callback != NULL)
+      callback(y, &p, user_data);
+
+    for (int i = 0; i < count; i++)
+    {
+      vmupro_layer_t *l = &layers[order[i]];
+      if (l->alpha == 0 || !(p.layer_mask & (1 << order[i])))
+        continue;
+      DrawLayerRow(l, y, l->scroll_x + p.scroll_x, l->scroll_y + p.scroll_y);
+    }
+
+    if (p.palette != 0 && palettes != NULL && p.palette <= num_palettes)
+      ApplyRasterPalette(Target() + y * SCREEN_W, &palettes[p.palette - 1]);
+  }
+}
+
+void vmupro_raster_palette_fade(vmupro_raster_palette_t *palette, vmupro_color_t target, uint8_t amount)
+{
+  if (palette == NULL)
+    return;
+
+  uint16_t t = Swap16((uint16_t)target);
+  int inv = 255 - amount;
+  for (int i = 0; i < 32; i++)
+  {
+    palette->r[i] = (uint8_t)((i * inv + R5(t) * amount + 127) / 255);
+    palette->b[i] = (uint8_t)((i * inv + B5(t) * amount + 127) / 255);
+  }
+  for (int i = 0; i < 64; i++)
+    palette->g[i] = (uint8_t)((i * inv + G6(t) * amount + 127) / 255);
+}
+
+//
+// Display list replay
+//
+
+static int CompareDlKey(const void *a, const void *b)
+{
+  uint64_t ka = *(const uint64_t *)a & ~DL_CULLED;
+  uint64_t kb = *(const uint64_t *)b & ~DL_CULLED;
+  return ka < kb ? -1 : ka > kb;
+}
+
+static int CompareDlOffset(const void *a, const void *b)
+{
+  uint32_t oa = (uint32_t)*(const uint64_t *)a;
+  uint32_t ob = (uint32_t)*(const uint64_t *)b;
+  return oa < ob ? -1 : oa > ob;
+}
+
+// Order the index for replay, skipping the sort when it already holds
+static void SortDlIndex(uint64_t *index, uint32_t count, int (*compare)(const void *, const void *))
+{
+  for (uint32_t i = 1; i < count; i++)
+  {
+    if (compare(&index[i - 1], &index[i]) > 0)
+    {
+      qsort(index, count, sizeof(uint64_t), compare);
+      return;
+    }
+  }
+}
+
+static inline bool DlContains(const vmupro_rect_t *r, const DlCommand *cmd)
+{
+  return cmd->x0 >= r->x && cmd->y0 >= r->y && cmd->x1 <= r->x + r->width && cmd->y1 <= r->y + r->height;
+}
+
+// Walk back to front, culling commands hidden by later opaque ones
+// Returns the number culled
+static int CullDisplayList(const vmupro_display_list_t *list, uint64_t *index, bool startWindowActive)
+{
+  vmupro_rect_t occluders[8];
+  int numOccluders = 0;
+  int culled = 0;
+
+  for (int i = (int)list->count - 1; i >= 0; i--)
+  {
+    const DlCommand *cmd = DlAt(list, (uint32_t)index[i]);
+    bool hidden = false;
+    if (!(cmd->flags & DL_KEEP))
+    {
+      hidden = cmd->x0 >= cmd->x1;
+      for (int k = 0; k < numOccluders && !hidden; k++)
+        hidden = DlContains(&occluders[k], cmd);
+    }
+    if (hidden)
+    {
+      index[i] |= DL_CULLED;
+      culled++;
+      continue;
+    }
+
+    if (cmd->flags & DL_BARRIER)
+      numOccluders = 0;
+
+    // window 0 draws under whatever window was set when the replay started
+    if ((cmd->flags & DL_OPAQUE) && (cmd->window != 0 || !startWindowActive))
+    {
+      vmupro_rect_t r = {cmd->x0, cmd->y0, cmd->x1 - cmd->x0, cmd->y1 - cmd->y0};
+      if (numOccluders < 8)
+      {
+        occluders[numOccluders++] = r;
+      }
+      else
+      {
+        // keep the largest
+        int smallest = 0;
+        for (int k = 1; k < 8; k++)
+          smallest = RectArea(&occluders[k]) < RectArea(&occluders[smallest]) ? k : smallest;
+        if (RectArea(&r) > RectArea(&occluders[smallest]))
+          occluders[smallest] = r;
+      }
+    }
+  }
+  return culled;
+}
+
+// Put back the colour window a command was recorded under
+static void ApplyDlWindow(const vmupro_display_list_t *list, uint32_t window, const ColorWindow *start)
+{
+  if (window == 0)
+  {
+    colorWindow = *start;
+    return;
+  }
+  const DlCommand *cmd = DlAt(list, window - 1);
+  const DlArg *a = DlArgs(cmd);
+  if (cmd->op == DL_SET_WINDOW)
+    vmupro_set_color_window((int)a[0], (int)a[1], (int)a[2], (int)a[3], (vmupro_color_t)a[4]);
+  else
+    vmupro_clear_color_window();
+}
+
+static void ExecuteDlCommand(const DlCommand *cmd)
+{
+  const DlArg *a = DlArgs(cmd);
+  void *data = DlData(cmd);
+#define I(n) ((int)a[n])
+#define P(n) ((void *)a[n])
+
+  switch ((DlOp)cmd->op)
+  {
+  case DL_CLEAR:
+    vmupro_display_clear((vmupro_color_t)I(0));
+    break;
+  case DL_DRAW_RECT:
+    vmupro_draw_rect(I(0), I(1), I(2), I(3), (vmupro_color_t)I(4));
+    break;
+  case DL_FILL_RECT:
+    vmupro_draw_fill_rect(I(0), I(1), I(2), I(3), (vmupro_color_t)I(4));
+    break;
+  case DL_LINE:
+    vmupro_draw_line(I(0), I(1), I(2), I(3), (vmupro_color_t)I(4));
+    break;
+  case DL_CIRCLE:
+    vmupro_draw_circle(I(0), I(1), I(2), (vmupro_color_t)I(3));
+    break;
+  case DL_CIRCLE_FILLED:
+    vmupro_draw_circle_filled(I(0), I(1), I(2), (vmupro_color_t)I(3));
+    break;
+  case DL_ELLIPSE:
+    vmupro_draw_ellipse(I(0), I(1), I(2), I(3), (vmupro_color_t)I(4));
+    break;
+  case DL_ELLIPSE_FILLED:
+    vmupro_draw_ellipse_filled(I(0), I(1), I(2), I(3), (vmupro_color_t)I(4));
+    break;
+  case DL_POLYGON_FILLED:
+    vmupro_draw_polygon_filled(cmd->dataSize ? data : NULL, I(0), (vmupro_color_t)I(1));
+    break;
+  case DL_FLOOD_FILL:
+    vmupro_flood_fill(I(0), I(1), (vmupro_color_t)I(2), (vmupro_color_t)I(3));
+    break;
+  case DL_FLOOD_FILL_TOLERANCE:
+    vmupro_flood_fill_tolerance(I(0), I(1), (vmupro_color_t)I(2), I(3));
+    break;
+  case DL_BLIT_AT:
+    vmupro_blit_buffer_at(P(0), I(1), I(2), I(3), I(4));
+    break;
+  case DL_BLIT_PALETTE:
+    vmupro_blit_buffer_with_palette(P(0), P(1));
+    break;
+  case DL_BLIT_TRANSPARENT:
+    vmupro_blit_buffer_transparent(P(0), I(1), I(2), I(3), I(4), (vmupro_color_t)I(5), (vmupro_drawflags_t)I(6));
+    break;
+  case DL_BLIT_BLENDED:
+    vmupro_blit_buffer_blended(P(0), I(1), I(2), I(3), I(4), (uint8_t)I(5));
+    break;
+  case DL_BLIT_DITHERED:
+    vmupro_blit_buffer_dithered(P(0), I(1), I(2), I(3), I(4), I(5));
+    break;
+  case DL_BLIT_FLIP_H:
+    vmupro_blit_buffer_flip_h(P(0), I(1), I(2), I(3), I(4));
+    break;
+  case DL_BLIT_FLIPPED:
+    vmupro_blit_buffer_flipped(P(0), I(1), I(2), I(3), I(4), (vmupro_drawflags_t)I(5));
+    break;
+  case DL_BLIT_SCALED:
+    vmupro_blit_buffer_scaled(P(0), I(1), I(2), I(3), I(4), I(5), I(6), I(7), I(8), I(9));
+    break;
+  case DL_BLIT_ADVANCED:
+    vmupro_blit_buffer_advanced(P(0), I(1), I(2), I(3), I(4), I(5), I(6), I(7), I(8), I(9), I(10), I(11), I(12));
+    break;
+  case DL_BLIT_ROTATED_90:
+    vmupro_blit_buffer_rotated_90(P(0), I(1), I(2), I(3), I(4), I(5));
+    break;
+  case DL_BLIT_AFFINE:
+    vmupro_blit_buffer_affine(P(0), I(1), I(2), I(3), I(4), I(5), cmd->dataSize ? data : NULL,
+                              (vmupro_sample_mode_t)I(6), I(7), (uint8_t)I(8));
+    break;
+  case DL_TILE_PATTERN:
+    vmupro_blit_tile_pattern(P(0), I(1), I(2), I(3), I(4), I(5), I(6));
+    break;
+  case DL_TILE:
+    vmupro_blit_tile(P(0), I(1), I(2), I(3), I(4), I(5), I(6), I(7));
+    break;
+  case DL_TILE_ADVANCED:
+    vmupro_blit_tile_advanced(P(0), I(1), I(2), I(3), I(4), I(5), I(6), I(7), (vmupro_color_t)I(8), (vmupro_drawflags_t)I(9));
+    break;
+  case DL_SCROLLING_BG:
+    vmupro_blit_scrolling_background(P(0), I(1), I(2), I(3), I(4), I(5), I(6));
+    break;
+  case DL_INFINITE_BG:
+    vmupro_blit_infinite_scrolling_background(P(0), I(1), I(2), I(3), I(4), I(5), I(6));
+    break;
+  case DL_LINE_SCROLL_BG:
+    vmupro_blit_line_scroll_background(P(0), I(1), I(2), P(3), P(4));
+    break;
+  case DL_COLUMN_SCROLL_BG:
+    vmupro_blit_column_scroll_background(P(0), I(1), I(2), P(3), P(4));
+    break;
+  case DL_MOSAIC:
+    vmupro_blit_buffer_mosaic(P(0), I(1), I(2), I(3), I(4), I(5));
+    break;
+  case DL_MOSAIC_SCREEN:
+    vmupro_apply_mosaic_to_screen(I(0), I(1), I(2), I(3), I(4));
+    break;
+  case DL_BLURRED:
+    vmupro_blit_buffer_blurred(P(0), I(1), I(2), I(3), I(4), I(5));
+    break;
+  case DL_SHADOW_HIGHLIGHT:
+    vmupro_blit_buffer_shadow_highlight(P(0), I(1), I(2), I(3), I(4), I(5));
+    break;
+  case DL_COLOR_MULTIPLY:
+    vmupro_blit_buffer_color_multiply(P(0), I(1), I(2), I(3), I(4), (vmupro_color_t)I(5));
+    break;
+  case DL_COLOR_ADD:
+    vmupro_blit_buffer_color_add(P(0), I(1), I(2), I(3), I(4), (vmupro_color_t)I(5));
+    break;
+  case DL_FIXED_ALPHA:
+    vmupro_blit_buffer_fixed_alpha(P(0), I(1), I(2), I(3), I(4), I(5));
+    break;
+  case DL_MASKED:
+    vmupro_blit_buffer_masked(P(0), P(1), I(2), I(3), I(4), I(5), (vmupro_drawflags_t)I(6));
+    break;
+  case DL_PALETTE_SWAP:
+    vmupro_blit_buffer_palette_swap(P(0), I(1), I(2), I(3), I(4), P(5), P(6), I(7));
+    break;
+  case DL_SPRITE_BATCH:
+    vmupro_sprite_batch_render(cmd->dataSize ? data : NULL, I(0));
+    break;
+  case DL_TILEMAP:
+    vmupro_tilemap_render(cmd->dataSize ? data : NULL, I(0), I(1), I(2), I(3), I(4), I(5));
+    break;
+  case DL_RENDER_LAYERS:
+    vmupro_render_all_layers();
+    break;
+  case DL_RENDER_RASTER:
+    vmupro_render_layers_raster(P(0), (vmupro_raster_callback_t)a[1], P(2), P(3), I(4));
+    break;
+  case DL_TEXT:
+    // in the font that was current when it was recorded
+    DrawText((vmupro_font_id_t)I(0), data, I(1), I(2), (uint16_t)I(3), (uint16_t)I(4));
+    break;
+  case DL_SET_WINDOW:
+  case DL_CLEAR_WINDOW:
+    break;
+  }
+#undef I
+#undef P
+}
+
+static int ReplayDisplayList(vmupro_display_list_t *list, uint32_t flags)
+{
+  if (list == NULL || list->arena == NULL)
+    return 0;
+
+  // replaying from inside a recording draws for real
+  vmupro_display_list_t *saved = recording;
+  recording = NULL;
+
+  uint64_t *index = DlIndex(list);
+  if (flags & VMUPRO_DL_SORT_LAYERS)
+    SortDlIndex(index, list->count, CompareDlKey);
+  else
+    SortDlIndex(index, list->count, CompareDlOffset);
+
+  ColorWindow start = colorWindow;
+  int culled = 0;
+  if (flags & VMUPRO_DL_CULL_OVERDRAW)
+    culled = CullDisplayList(list, index, start.active);
+
+  uint32_t window = 0;
+  int executed = 0;
+  for (uint32_t i = 0; i < list->count; i++)
+  {
+    if (index[i] & DL_CULLED)
+    {
+      index[i] &= ~DL_CULLED;
+      continue;
+    }
+    const DlCommand *cmd = DlAt(list, (uint32_t)index[i]);
+    if (cmd->window != window)
+    {
+      ApplyDlWindow(list, cmd->window, &start);
+      window = cmd->window;
+    }
+    ExecuteDlCommand(cmd);
+    executed++;
+  }
+  // leave the window as the recorded calls would have
+  ApplyDlWindow(list, list->window, &start);
+
+  stats.dl_commands += executed;
+  stats.dl_culled += culled;
+  recording = saved;
+  return executed;
+}
+
+int vmupro_display_list_replay(vmupro_display_list_t *list, uint32_t flags)
+{
+  return ReplayDisplayList(list, flags);
+}
+
+// The second core is a worker thread on the host
+static pthread_t replayThread;
+static bool replayRunning = false;
+static vmupro_display_list_t *replayList;
+static uint32_t replayFlags;
+static int replayResult;
+
+static void *ReplayThreadMain(void *arg)
+{
+  (void)arg;
+  replayResult = ReplayDisplayList(replayList, replayFlags);
+  return NULL;
+}
+
+bool vmupro_display_list_replay_async(vmupro_display_list_t *list, uint32_t flags)
+{
+  if (replayRunning || list == NULL)
+    return false;
+  replayList = list;
+  replayFlags = flags;
+  if (pthread_create(&replayThread, NULL, ReplayThreadMain, NULL) != 0)
+    return false;
+  replayRunning = true;
+  return true;
+}
+
+int vmupro_display_list_wait(void)
+{
+  if (!replayRunning)
+    return 0;
+  pthread_join(replayThread, NULL);
+  replayRunning = false;
+  return replayResult;
+}
+
+//
+// Host-only hooks
+//
+
+void vmupro_host_reset(void)
+{
+  vmupro_display_list_wait();
+  vmupro_set_split_rendering(false);
+  recording = NULL;
+  for (int i = 0; i < VMUPRO_MAX_LAYERS; i++)
+    vmupro_layer_destroy(i);
+  memset(fb, 0, sizeof(fb));
+  memset(panel, 0, sizeof(panel));
+  memset(&stats, 0, sizeof(stats));
+  memset(&colorWindow, 0, sizeof(colorWindow));
+  partialUpdates = false;
+  currentFont = VMUPRO_FONT_DEFAULT;
+  dirtyCount = 0;
+  spriteBatchMode = VMUPRO_SPRITE_BATCH_DIRECT;
+  FreeSpriteBins();
+  backSide = 0;
+  frontSide = 1;
+  lastBlittedSide = 0;
+  transferCount = 0;
+  transferFrameUs = 0;
+  tripleBuffering = false;
+  lastPresentUs = 0;
+  frameDoneCallback = NULL;
+  frameDoneUser = NULL;
+  pushSerial = 0;
+  memset(sideSerial, 0, sizeof(sideSerial));
+  prevDirtyCount = 0;
+  doubleBufferRunning = false;
+  doubleBufferPaused = false;
+  brightness = 100;
+  vmupro_host_audio_reset();
+}
+
+void vmupro_host_set_panel_transfer_time(uint32_t full_frame_us)
+{
+  transferFrameUs = full_frame_us;
+}
+
+const uint8_t *vmupro_host_get_panel(void)
+{
+  return (const uint8_t *)panel;
+}
+
+void vmupro_host_get_stats(vmupro_host_stats_t *out_stats)
+{
+  if (out_stats)
+    *out_stats = stats;
+}
+
+bool vmupro_host_write_ppm(const char *path, const uint8_t *buffer)
+{
+  FILE *f = fopen(path, "wb");
+  if (f == NULL)
+    return false;
+
+  fprintf(f, "P6\n%d %d\n255\n", SCREEN_W, SCREEN_H);
+  for (int i = 0; i < FB_PIXELS; i++)
+  {
+    uint16_t p = Swap16(LoadPx(buffer, i));
+    uint8_t rgb[3] = {(uint8_t)(R5(p) * 255 / 31), (uint8_t)(G6(p) * 255 / 63), (uint8_t)(B5(p) * 255 / 31)};
+    fwrite(rgb, 1, 3, f);
+  }
+  return fclose(f) == 0;
+}
@@ -0,0 +1,159 @@
+// tools/hostsim/src/host_file.c
+//
+// Host versions of the file part of the firmware API
+// Paths under /sdcard are mapped to a directory on the host
+// (see vmupro_host_set_sdcard_root), everything else is used as is
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "vmupro_sdk.h"
+#include "vmupro_host.h"
+
+#define SDCARD_PREFIX "/sdcard"
+
+static char sdcardRoot[512] = "sdcard";
+static uint32_t sdcardSpeed;
+
+static bool HostPath(const char *path, char *out, size_t size)
+{
+  if (path == NULL)
+    return false;
+  size_t prefix = strlen(SDCARD_PREFIX);
+  int n;
+  if (strncmp(path, SDCARD_PREFIX, prefix) == 0 && (path[prefix] == '/' || path[prefix] == '\0'))
+    n = snprintf(out, size, "%s%s", sdcardRoot, path + prefix);
+  else
+    n = snprintf(out, size, "%s", path);
+  return n > 0 && (size_t)n < size;
+}
+
+// time the card would take to move bytes, see vmupro_host_set_sdcard_speed
+static void CardDelay(size_t bytes)
+{
+  if (sdcardSpeed != 0)
+    vmupro_delay_us((uint64_t)bytes * 1000000ull / sdcardSpeed);
+}
+
+bool vmupro_file_exists(const char *filename)
+{
+  char path[1024];
+  struct stat st;
+  return HostPath(filename, path, sizeof(path)) && stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+bool vmupro_folder_exists(const char *path)
+{
+  char hostPath[1024];
+  struct stat st;
+  return HostPath(path, hostPath, sizeof(hostPath)) && stat(hostPath, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool vmupro_create_folder(const char *path)
+{
+  char hostPath[1024];
+  if (!HostPath(path, hostPath, sizeof(hostPath)))
+    return false;
+  return mkdir(hostPath, 0755) == 0 || vmupro_folder_exists(path);
+}
+
+size_t vmupro_get_file_size(const char *filename)
+{
+  char path[1024];
+  struct stat st;
+  if (!HostPath(filename, path, sizeof(path)) || stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+    return (size_t)-1;
+  return (size_t)st.st_size;
+}
+
+bool vmupro_read_file_complete(const char *filename, uint8_t *buffer, size_t *file_size)
+{
+  char path[1024];
+  if (buffer == NULL || file_size == NULL || !HostPath(filename, path, sizeof(path)))
+    return false;
+  *file_size = 0;
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+    return false;
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  bool ok = size >= 0 && fread(buffer, 1, (size_t)size, f) == (size_t)size;
+  fclose(f);
+  if (ok)
+  {
+    *file_size = (size_t)size;
+    CardDelay((size_t)size);
+  }
+  return ok;
+}
+
+bool vmupro_read_file_bytes(const char *filename, uint8_t *buffer, uint32_t offset, int num_bytes)
+{
+  char path[1024];
+  if (buffer == NULL || num_bytes <= 0 || !HostPath(filename, path, sizeof(path)))
+    return false;
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+    return false;
+  bool ok = fseek(f, (long)offset, SEEK_SET) == 0 && fread(buffer, 1, (size_t)num_bytes, f) == (size_t)num_bytes;
+  fclose(f);
+  CardDelay((size_t)num_bytes);
+  return ok;
+}
+
+bool vmupro_write_file_complete(const char *filename, const uint8_t *data, size_t size)
+{
+  char path[1024];
+  if (data == NULL || size == 0 || !HostPath(filename, path, sizeof(path)))
+    return false;
+  FILE *f = fopen(path, "wb");
+  if (f == NULL)
+    return false;
+  bool ok = fwrite(data, 1, size, f) == size;
+  CardDelay(size);
+  return fclose(f) == 0 && ok;
+}
+
+bool vmupro_write_file_bytes(const char *filename, const uint8_t *data, uint32_t offset, size_t length)
+{
+  char path[1024];
+  if (data == NULL || length == 0 || !HostPath(filename, path, sizeof(path)))
+    return false;
+  FILE *f = fopen(path, "r+b");
+  if (f == NULL)
+    f = fopen(path, "w+b");
+  if (f == NULL)
+    return false;
+  bool ok = fseek(f, (long)offset, SEEK_SET) == 0 && fwrite(data, 1, length, f) == length;
+  CardDelay(length);
+  return fclose(f) == 0 && ok;
+}
+
+unsigned long crc32(int crc, uint8_t *buf, int len)
+{
+  uint32_t c = ~(uint32_t)crc;
+  for (int i = 0; i < len; i++)
+  {
+    c ^= buf[i];
+    for (int k = 0; k < 8; k++)
+      c = (c >> 1) ^ (0xedb88320u & (0u - (c & 1)));
+  }
+  return ~c;
+}
+
+//
+// Host hooks
+//
+
+void vmupro_host_set_sdcard_root(const char *dir)
+{
+  snprintf(sdcardRoot, sizeof(sdcardRoot), "%s", dir != NULL ? dir : "sdcard");
+}
+
+void vmupro_host_set_sdcard_speed(uint32_t bytes_per_second)
+{
+  sdcardSpeed = bytes_per_second;
+}
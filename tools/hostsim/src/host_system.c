@@ -0,0 +1,64 @@
+// tools/hostsim/src/host_system.c
+//
+// Host versions of the logging and timing parts of the firmware API
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include "vmupro_sdk.h"
+
+static vmupro_log_level_t logLevel = VMUPRO_LOG_INFO;
+
+void vmupro_set_log_level(vmupro_log_level_t level)
+{
+  logLevel = level;
+}
+
+void vmupro_log(vmupro_log_level_t level, const char *tag, const char *fmt, ...)
+{
+  static const char *names[] = {"", "E", "W", "I", "D"};
+  if (level == VMUPRO_LOG_NONE || level > logLevel)
+    return;
+
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "%s %s: ", names[level], tag ? tag : "");
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+uint64_t vmupro_get_time_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000ull;
+}
+
+void vmupro_delay_us(uint64_t delay_us)
+{
+  struct timespec ts = {(time_t)(delay_us / 1000000ull), (long)(delay_us % 1000000ull) * 1000L};
+  while (nanosleep(&ts, &ts) != 0)
+  {
+  }
+}
+
+void vmupro_delay_ms(uint64_t delay_ms)
+{
+  vmupro_delay_us(delay_ms * 1000ull);
+}
+
+void vmupro_sleep_ms(uint32_t milliseconds)
+{
+  vmupro_delay_us((uint64_t)milliseconds * 1000ull);
+}
+
+int vmupro_snprintf(char *buffer, size_t size, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int r = vsnprintf(buffer, size, format, args);
+  va_end(args);
+  return r;
+}
@@ -0,0 +1,258 @@
+#
+#  Convert BMFont output to the VMU Pro custom font format (see sdk/c/include/vmupro_bmfont.h)
+#
+#  Reads a .fnt descriptor (text or XML) and its page images, trims every
+#  glyph to its inked area and stores it as 4bpp anti-aliasing coverage,
+#  together with the metrics and kerning pairs. Draw the result with
+#  vmupro_bmfont_draw_text().
+#
+#
+# Usage:
+#
+#   Font to a binary file (e.g. for a .vmupack resource):
+#
+#     py font_bmfont.py title.fnt
+#
+#   Font to a C header, keeping only the characters used by the game's strings:
+#
+#     py font_bmfont.py dialog.fnt --chars strings_de.txt --header dialog_font.h
+#
+#   Glyphs are read from the channel given by each char's chnl field, or
+#   from the alpha channel (luminance for images without alpha)
+#
+
+import os
+import re
+import sys
+import struct
+import argparse
+from pathlib import Path
+
+BMFONT_MAGIC = 0x4642
+BMFONT_VERSION = 1
+NO_GLYPH = 0xFFFF
+HEADER_FORMAT = "<HBBHHHHHHIII96H"
+GLYPH_FORMAT = "<IIBBbbBBH"
+KERNING_FORMAT = "<Hh"
+
+ATTRIBUTE = re.compile(r'(\w+)=("[^"]*"|\S+)')
+
+
+def ParseFnt(fName):
+    # type: (str) -> tuple[dict, list[str], list[dict], list[dict]]
+    # Returns the common block, page file names, chars and kerning pairs.
+    # Text and XML descriptors share the same tag and attribute names
+
+    common = {}
+    pages = {}
+    chars = []
+    kernings = []
+    for line in Path(fName).read_text(encoding="utf-8").splitlines():
+        line = line.strip().lstrip("<").rstrip(">").rstrip("/").strip()
+        if not line:
+            continue
+        tag = line.split()[0]
+        attrs = {k: v.strip('"').rstrip('"/') for k, v in ATTRIBUTE.findall(line)}
+        if tag == "common":
+            common = {k: int(v) for k, v in attrs.items() if re.match(r"^-?\d+$", v)}
+        elif tag == "page":
+            pages[int(attrs["id"])] = attrs["file"]
+        elif tag == "char":
+            chars.append({k: int(v) for k, v in attrs.items() if re.match(r"^-?\d+$", v)})
+        elif tag == "kerning":
+            kernings.append({k: int(v) for k, v in attrs.items()})
+
+    if "lineHeight" not in common:
+        raise Exception("{}: no common lineHeight, is this a BMFont .fnt file?".format(fName))
+    pageList = [pages[i] for i in sorted(pages)]
+    return (common, pageList, chars, kernings)
+
+
+def LoadPages(fntPath, pageFiles):
+    # type: (str, list[str]) -> list
+    from PIL import Image
+
+    images = []
+    for name in pageFiles:
+        path = Path(fntPath).parent / name
+        if not path.exists():
+            raise Exception("can't find page image {}".format(path))
+        images.append(Image.open(path).convert("RGBA"))
+    return images
+
+
+def Coverage(image, char):
+    # type: (object, dict) -> list[list[int]]
+    # 0-15 coverage of the char's rectangle
+
+    pix = image.load()
+    chnl = char.get("chnl", 15)
+    hasAlpha = image.getextrema()[3][0] < 255
+    rows = []
+    for y in range(char["height"]):
+        row = []
+        for x in range(char["width"]):
+            r, g, b, a = pix[char["x"] + x, char["y"] + y]
+            if chnl == 1:
+                v = b
+            elif chnl == 2:
+                v = g
+            elif chnl == 4:
+                v = r
+            elif chnl == 8 or hasAlpha:
+                v = a
+            else:
+                v = (r * 299 + g * 587 + b * 114) // 1000
+            row.append((v * 15 + 127) // 255)
+        rows.append(row)
+    return rows
+
+
+def Trim(rows):
+    # type: (list[list[int]]) -> tuple[int, int, list[list[int]]]
+    # Returns the left and top of the inked area and its coverage
+
+    inkedRows = [y for y, row in enumerate(rows) if any(row)]
+    if not inkedRows:
+        return (0, 0, [])
+    inkedCols = [x for x in range(len(rows[0])) if any(row[x] for row in rows)]
+    x0, x1 = inkedCols[0], inkedCols[-1] + 1
+    y0, y1 = inkedRows[0], inkedRows[-1] + 1
+    return (x0, y0, [row[x0:x1] for row in rows[y0:y1]])
+
+
+def Pack4bpp(rows):
+    # type: (list[list[int]]) -> bytearray
+    out = bytearray()
+    for row in rows:
+        for x in range(0, len(row), 2):
+            hi = row[x]
+            lo = row[x + 1] if x + 1 < len(row) else 0
+            out.append((hi << 4) | lo)
+    return out
+
+
+def PadByteArray(inArray, boundary):
+    # type: (bytearray, int) -> bytearray
+    while len(inArray) % boundary != 0:
+        inArray.append(0)
+    return inArray
+
+
+def CheckRange(what, value, lo, hi):
+    # type: (str, int, int, int) -> int
+    if value < lo or value > hi:
+        raise Exception("{} {} is outside {}..{}".format(what, value, lo, hi))
+    return value
+
+
+def EncodeFont(common, pages, chars, kernings, keep, fallback):
+    # type: (dict, list, list[dict], list[dict], set, int) -> tuple[bytearray, int, int]
+
+    chars = sorted((c for c in chars if c["id"] >= 0 and (keep is None or c["id"] in keep)), key=lambda c: c["id"])
+    indexOf = {c["id"]: i for i, c in enumerate(chars)}
+
+    pairs = {}
+    for k in kernings:
+        if k["first"] in indexOf and k["second"] in indexOf and k["amount"] != 0:
+            pairs.setdefault(indexOf[k["first"]], []).append(
+                (indexOf[k["second"]], CheckRange("kerning amount", k["amount"], -32768, 32767)))
+
+    glyphs = bytearray()
+    kerning = bytearray()
+    bitmaps = bytearray()
+    for i, c in enumerate(chars):
+        x0, y0, rows = Trim(Coverage(pages[c.get("page", 0)], c))
+        width = len(rows[0]) if rows else 0
+        height = len(rows)
+        bitmapOffset = len(bitmaps)
+        bitmaps += Pack4bpp(rows)
+
+        glyphPairs = sorted(pairs.get(i, []))
+        if len(glyphPairs) > 255:
+            raise Exception("U+{:04X} has {} kerning pairs, at most 255 are supported".format(c["id"], len(glyphPairs)))
+        kerningIndex = len(kerning) // 4
+        for second, amount in glyphPairs:
+            kerning += struct.pack(KERNING_FORMAT, second, amount)
+
+        glyphs += struct.pack(GLYPH_FORMAT, c["id"], bitmapOffset,
+                              CheckRange("glyph width", width, 0, 255),
+                              CheckRange("glyph height", height, 0, 255),
+                              CheckRange("x offset", c.get("xoffset", 0) + x0, -128, 127),
+                              CheckRange("y offset", c.get("yoffset", 0) + y0, -128, 127),
+                              CheckRange("advance", c.get("xadvance", 0), 0, 255),
+                              len(glyphPairs), kerningIndex)
+
+    ascii = [indexOf.get(code, NO_GLYPH) for code in range(0x20, 0x80)]
+    headerSize = struct.calcsize(HEADER_FORMAT)
+    glyphsOffset = headerSize
+    kerningOffset = glyphsOffset + len(glyphs)
+    bitmapOffset = kerningOffset + len(PadByteArray(kerning, 4))
+    header = struct.pack(HEADER_FORMAT, BMFONT_MAGIC, BMFONT_VERSION, 0,
+                         CheckRange("line height", common["lineHeight"], 1, 65535), common.get("base", 0),
+                         CheckRange("glyph count", len(chars), 1, 65534), len(kerning) // 4,
+                         indexOf.get(fallback, NO_GLYPH), 0,
+                         glyphsOffset, kerningOffset, bitmapOffset, *ascii)
+
+    blob = bytearray(header) + glyphs + kerning + bitmaps
+    return (PadByteArray(blob, 4), len(chars), sum(len(p) for p in pairs.values()))
+
+
+def WriteHeader(path, stem, blob):
+    # type: (str, str, bytearray) -> None
+
+    hSrc = "// This file is auto-generated by font_bmfont.py and should not be modified manually!\n\n"
+    hSrc += "#pragma once\n"
+    hSrc += "#include <stdint.h>\n\n"
+    hSrc += "static const uint8_t {}_font[] __attribute__((aligned(4))) = {{\n".format(stem)
+    for i in range(0, len(blob), 16):
+        hSrc += "    " + ", ".join("0x{:02X}".format(b) for b in blob[i:i + 16]) + ",\n"
+    hSrc += "};\n"
+
+    with open(path, "w") as hFile:
+        hFile.write(hSrc)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert BMFont fonts to VMU Pro custom fonts")
+    parser.add_argument("input", help="BMFont descriptor (.fnt, text or XML), page images next to it")
+    parser.add_argument("--chars", default=None,
+                        help="UTF-8 text file, only characters that appear in it are kept")
+    parser.add_argument("--fallback", default="?",
+                        help="Character drawn for characters the font doesn't have (default '?')")
+    parser.add_argument("--header", default=None,
+                        help="Write a C header instead of a binary file")
+    parser.add_argument("--out", default=None,
+                        help="Binary output path (default: input with .bmf extension)")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.input):
+        raise Exception("can't find the file: {}".format(args.input))
+
+    common, pageFiles, chars, kernings = ParseFnt(args.input)
+    pages = LoadPages(args.input, pageFiles)
+
+    keep = None
+    if args.chars:
+        keep = set(ord(ch) for ch in Path(args.chars).read_text(encoding="utf-8") if ch not in "\r\n")
+        keep.add(ord(args.fallback))
+        missing = sorted(code for code in keep if code not in set(c["id"] for c in chars))
+        if missing:
+            print("warning: the font has no glyph for {}".format(
+                " ".join("U+{:04X}".format(code) for code in missing)))
+
+    blob, glyphCount, pairCount = EncodeFont(common, pages, chars, kernings, keep, ord(args.fallback))
+    print("{}: {} glyphs, {} kerning pairs, line height {} -> {} bytes".format(
+        args.input, glyphCount, pairCount, common["lineHeight"], len(blob)))
+
+    stem = Path(args.input).stem.replace("-", "_").replace(" ", "_")
+    if args.header:
+        WriteHeader(args.header, stem, blob)
+    else:
+        outPath = args.out if args.out else str(Path(args.input).with_suffix(".bmf"))
+        with open(outPath, "wb") as outFile:
+            outFile.write(blob)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
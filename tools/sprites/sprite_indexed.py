@@ -0,0 +1,235 @@
+#
+#  Convert images to VMU Pro indexed colour images (see sdk/c/include/vmupro_indexed.h)
+#
+#  Colours are reduced to 16 (4bpp) or 256 (8bpp) palette entries with a
+#  median cut, then every pixel is stored as a palette index. Draw the
+#  result with vmupro_blit_indexed() / vmupro_render_indexed_layer().
+#
+#
+# Usage:
+#
+#   4bpp sprite, transparent pixels become index 0:
+#
+#     py sprite_indexed.py hero.png --bpp 4 --header hero_idx.h
+#
+#   8bpp tile atlas sharing the palette of another asset:
+#
+#     py sprite_indexed.py tiles.png --palette level1.pal --header tiles_idx.h
+#
+#   Raw big endian RGB565 input (as produced by i2h.py):
+#
+#     py sprite_indexed.py sdk_tile_bg_brown.raw --raw 64x64 --bpp 4
+#
+
+import os
+import sys
+import struct
+import argparse
+from pathlib import Path
+
+from sprite_rle import ParseSize, ParseKey, ToRGB565, LoadImage
+
+INDEXED_MAGIC = 0x5849
+
+
+def Channels(c):
+    # type: (int) -> tuple[int, int, int]
+    # RGB565 expanded to 8 bit channels
+    r = (c >> 11) & 0x1F
+    g = (c >> 5) & 0x3F
+    b = c & 0x1F
+    return ((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2))
+
+
+def MedianCut(histogram, maxColours):
+    # type: (dict[int,int], int) -> list[int]
+    # histogram maps RGB565 -> pixel count
+
+    if len(histogram) <= maxColours:
+        return sorted(histogram.keys())
+
+    boxes = [[(Channels(c), n) for c, n in histogram.items()]]
+
+    while len(boxes) < maxColours:
+        # split the box with the widest channel range, weighted by pixel count
+        best = None
+        bestScore = -1
+        for i, box in enumerate(boxes):
+            if len(box) < 2:
+                continue
+            ranges = [max(e[0][ch] for e in box) - min(e[0][ch] for e in box) for ch in range(3)]
+            score = max(ranges) * sum(e[1] for e in box)
+            if score > bestScore:
+                best = (i, ranges.index(max(ranges)))
+                bestScore = score
+        if best is None:
+            break
+
+        i, ch = best
+        box = sorted(boxes[i], key=lambda e: e[0][ch])
+        total = sum(e[1] for e in box)
+        acc = 0
+        cut = 1
+        for j, e in enumerate(box[:-1]):
+            acc += e[1]
+            if acc * 2 >= total:
+                cut = j + 1
+                break
+        boxes[i:i + 1] = [box[:cut], box[cut:]]
+
+    palette = []
+    for box in boxes:
+        total = sum(e[1] for e in box)
+        r = sum(e[0][0] * e[1] for e in box) // total
+        g = sum(e[0][1] * e[1] for e in box) // total
+        b = sum(e[0][2] * e[1] for e in box) // total
+        palette.append(ToRGB565(r, g, b))
+    return palette
+
+
+def Nearest(colour, palette, cache):
+    # type: (int, list[int], dict[int,int]) -> int
+    if colour in cache:
+        return cache[colour]
+    r, g, b = Channels(colour)
+    best = 0
+    bestDist = None
+    for i, p in enumerate(palette):
+        if p is None:
+            continue
+        pr, pg, pb = Channels(p)
+        # weighted towards green like the eye
+        dist = 2 * (r - pr) ** 2 + 4 * (g - pg) ** 2 + 3 * (b - pb) ** 2
+        if bestDist is None or dist < bestDist:
+            best = i
+            bestDist = dist
+    cache[colour] = best
+    return best
+
+
+def LoadPalette(path):
+    # type: (str) -> list[int]
+    data = Path(path).read_bytes()
+    return [(data[i] << 8) | data[i + 1] for i in range(0, len(data), 2)]
+
+
+def EncodeIndexed(width, height, bpp, indices):
+    # type: (int, int, int, list[int]) -> bytearray
+    out = bytearray(struct.pack("<HHHBB", INDEXED_MAGIC, width, height, bpp, 0))
+    stride = (width * bpp + 7) // 8
+    for y in range(height):
+        row = bytearray(stride)
+        for x in range(width):
+            i = indices[y * width + x]
+            if bpp == 8:
+                row[x] = i
+            else:
+                row[x // 2] |= i << (0 if x & 1 else 4)
+        out += row
+    return out
+
+
+def PaletteBytes(palette):
+    # type: (list) -> bytearray
+    out = bytearray()
+    for p in palette:
+        out += struct.pack(">H", 0 if p is None else p)
+    return out
+
+
+def WriteHeader(path, stem, image, palette):
+    # type: (str, str, bytearray, list) -> None
+
+    hSrc = "// This file is auto-generated by sprite_indexed.py and should not be modified manually!\n\n"
+    hSrc += "#pragma once\n"
+    hSrc += "#include <stdint.h>\n\n"
+
+    hSrc += "static const uint8_t {}_idx[] = {{\n".format(stem)
+    for i in range(0, len(image), 16):
+        hSrc += "    " + ", ".join("0x{:02X}".format(b) for b in image[i:i + 16]) + ",\n"
+    hSrc += "};\n\n"
+
+    # stored as the big endian byte pairs, read back as native uint16
+    # like every other RGB565 value in the SDK
+    hSrc += "// not const, so it can be animated with vmupro_animate_palette_range()\n"
+    hSrc += "static uint16_t {}_palette[{}] = {{\n".format(stem, len(palette))
+    values = ["0x{:04X}".format(0 if p is None else ((p & 0xFF) << 8) | (p >> 8)) for p in palette]
+    for i in range(0, len(values), 8):
+        hSrc += "    " + ", ".join(values[i:i + 8]) + ",\n"
+    hSrc += "};\n"
+
+    with open(path, "w") as hFile:
+        hFile.write(hSrc)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert images to VMU Pro 4bpp/8bpp indexed colour images")
+    parser.add_argument("input", help="Image file (any format Pillow reads) or raw RGB565 with --raw")
+    parser.add_argument("--raw", type=ParseSize, default=None,
+                        help="Input is raw big endian RGB565 of this size, e.g. 16x16")
+    parser.add_argument("--bpp", type=int, choices=[4, 8], default=8,
+                        help="Bits per pixel (default 8)")
+    parser.add_argument("--key", type=ParseKey, default=None,
+                        help="Colour to treat as transparent, as #RRGGBB. Alpha < 50%% is always transparent")
+    parser.add_argument("--palette", default=None,
+                        help="Use this existing palette (.pal, big endian RGB565) instead of building one")
+    parser.add_argument("--header", default=None,
+                        help="Write a C header with the image and palette instead of .idx/.pal files")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.input):
+        raise Exception("can't find the file: {}".format(args.input))
+
+    width, height, pixels = LoadImage(args.input, args.raw)
+    if args.key is not None:
+        pixels = [None if p == args.key else p for p in pixels]
+
+    maxColours = 1 << args.bpp
+    transparent = any(p is None for p in pixels)
+
+    if args.palette:
+        palette = LoadPalette(args.palette)
+        if len(palette) > maxColours:
+            raise Exception("{} has {} entries, {}bpp allows {}".format(args.palette, len(palette), args.bpp, maxColours))
+        if transparent:
+            # index 0 of a shared palette is the transparent slot, written as 0
+            # when the palette was built from an image with transparency
+            if palette and palette[0] != 0:
+                raise Exception("{} has colour 0x{:04X} in entry 0, which {} needs for its transparent pixels. "
+                                "Build the palette from an image with transparency, or free entry 0".format(
+                                    args.palette, palette[0], args.input))
+            palette[0] = None
+    else:
+        histogram = {}
+        for p in pixels:
+            if p is not None:
+                histogram[p] = histogram.get(p, 0) + 1
+        # index 0 is reserved for transparency when the image has any
+        palette = MedianCut(histogram, maxColours - 1 if transparent else maxColours)
+        if transparent:
+            palette = [None] + palette
+
+    cache = {}
+    indices = [0 if p is None else Nearest(p, palette, cache) for p in pixels]
+    image = EncodeIndexed(width, height, args.bpp, indices)
+
+    exact = sum(1 for p in pixels if p is not None and palette[cache[p]] == p)
+    opaque = sum(1 for p in pixels if p is not None)
+    print("{}: {}x{} {}bpp, {} colour palette, {} bytes (RGB565 {} bytes), {:.1f}% of pixels exact{}".format(
+        args.input, width, height, args.bpp, len(palette), len(image), width * height * 2,
+        100.0 * exact / max(opaque, 1), ", transparent index 0" if transparent else ""))
+
+    stem = Path(args.input).stem.replace("-", "_").replace(" ", "_")
+    if args.header:
+        WriteHeader(args.header, stem, image, palette)
+    else:
+        base = Path(args.input)
+        with open(str(base.with_suffix(".idx")), "wb") as outFile:
+            outFile.write(image)
+        if not args.palette:
+            with open(str(base.with_suffix(".pal")), "wb") as outFile:
+                outFile.write(PaletteBytes(palette))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
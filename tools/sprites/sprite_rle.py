@@ -0,0 +1,199 @@
+#
+#  Convert images to the VMU Pro RLE sprite format (see sdk/c/include/vmupro_rle.h)
+#
+#  Only the opaque spans of each row are stored, pixels matching the
+#  colour key are dropped. Draw the result with vmupro_blit_rle().
+#
+#
+# Usage:
+#
+#   Single sprite to a binary file (e.g. for a .vmupack resource):
+#
+#     py sprite_rle.py ship.png
+#
+#   Sprite sheet of 32x32 frames to a C header:
+#
+#     py sprite_rle.py enemies.png --frame 32x32 --header enemies_rle.h
+#
+#   Raw big endian RGB565 input (as produced by i2h.py):
+#
+#     py sprite_rle.py ship.raw --raw 64x48
+#
+
+import os
+import sys
+import struct
+import argparse
+from pathlib import Path
+
+RLE_MAGIC = 0x4C52
+HEADER_SIZE = 8
+
+
+def ParseSize(text):
+    # type: (str) -> tuple[int, int]
+    parts = text.lower().split("x")
+    if len(parts) != 2:
+        raise argparse.ArgumentTypeError("expected WIDTHxHEIGHT, got {}".format(text))
+    return (int(parts[0]), int(parts[1]))
+
+
+def ParseKey(text):
+    # type: (str) -> int
+    # #RRGGBB or 0xRRGGBB, converted to RGB565
+    text = text.lstrip("#")
+    if text.lower().startswith("0x"):
+        text = text[2:]
+    rgb = int(text, 16)
+    return ToRGB565((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF)
+
+
+def ToRGB565(r, g, b):
+    # type: (int, int, int) -> int
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)
+
+
+def LoadImage(fName, rawSize):
+    # type: (str, tuple[int,int]) -> tuple[int, int, list[int]]
+    # Returns width, height and a list of RGB565 values
+
+    if rawSize is not None:
+        width, height = rawSize
+        data = Path(fName).read_bytes()
+        if len(data) != width * height * 2:
+            raise Exception("{} is {} bytes, expected {} for {}x{}".format(
+                fName, len(data), width * height * 2, width, height))
+        pixels = [(data[i] << 8) | data[i + 1] for i in range(0, len(data), 2)]
+        return (width, height, pixels)
+
+    from PIL import Image
+
+    im = Image.open(fName).convert("RGBA")
+    width, height = im.size
+    pix = im.load()
+    pixels = []
+    for y in range(height):
+        for x in range(width):
+            r, g, b, a = pix[x, y]
+            # fully transparent pixels become the key
+            pixels.append(None if a < 128 else ToRGB565(r, g, b))
+    return (width, height, pixels)
+
+
+def EncodeSprite(pixels, stride, x0, y0, width, height, key):
+    # type: (list, int, int, int, int, int, int) -> bytearray
+
+    out = bytearray(struct.pack("<HHHH", RLE_MAGIC, width, height, 0))
+    out += bytearray(4 * height)
+
+    for row in range(height):
+        struct.pack_into("<I", out, HEADER_SIZE + row * 4, len(out))
+        rowStart = len(out)
+        out += b"\0\0"
+
+        line = pixels[(y0 + row) * stride + x0:(y0 + row) * stride + x0 + width]
+        spans = 0
+        x = 0
+        last = 0
+        while x < width:
+            while x < width and (line[x] is None or line[x] == key):
+                x += 1
+            if x == width:
+                break
+            start = x
+            while x < width and not (line[x] is None or line[x] == key):
+                x += 1
+
+            out += struct.pack("<HH", start - last, x - start)
+            for p in line[start:x]:
+                out += struct.pack(">H", p)
+            last = x
+            spans += 1
+
+        struct.pack_into("<H", out, rowStart, spans)
+
+    return out
+
+
+def PadByteArray(inArray, boundary):
+    # type: (bytearray, int) -> bytearray
+    while len(inArray) % boundary != 0:
+        inArray.append(0)
+    return inArray
+
+
+def WriteHeader(path, stem, frames):
+    # type: (str, str, list[bytearray]) -> None
+
+    hSrc = "// This file is auto-generated by sprite_rle.py and should not be modified manually!\n\n"
+    hSrc += "#pragma once\n"
+    hSrc += "#include <stdint.h>\n\n"
+
+    blob = bytearray()
+    offsets = []
+    for frame in frames:
+        offsets.append(len(blob))
+        # every frame must start 4 byte aligned
+        blob += PadByteArray(bytearray(frame), 4)
+
+    hSrc += "static const uint8_t {}_rle[] __attribute__((aligned(4))) = {{\n".format(stem)
+    for i in range(0, len(blob), 16):
+        hSrc += "    " + ", ".join("0x{:02X}".format(b) for b in blob[i:i + 16]) + ",\n"
+    hSrc += "};\n"
+
+    if len(frames) > 1:
+        hSrc += "\n#define {}_RLE_FRAMES {}\n".format(stem.upper(), len(frames))
+        hSrc += "static const uint32_t {}_rle_frames[] = {{ {} }};\n".format(
+            stem, ", ".join(str(o) for o in offsets))
+
+    with open(path, "w") as hFile:
+        hFile.write(hSrc)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert images to VMU Pro RLE sprites")
+    parser.add_argument("input", help="Image file (any format Pillow reads) or raw RGB565 with --raw")
+    parser.add_argument("--raw", type=ParseSize, default=None,
+                        help="Input is raw big endian RGB565 of this size, e.g. 64x48")
+    parser.add_argument("--key", type=ParseKey, default=ToRGB565(255, 0, 255),
+                        help="Transparent colour as #RRGGBB (default #FF00FF). Alpha < 50%% is always transparent")
+    parser.add_argument("--frame", type=ParseSize, default=None,
+                        help="Split a sprite sheet into frames of this size, left to right, top to bottom")
+    parser.add_argument("--header", default=None,
+                        help="Write a C header instead of a binary file")
+    parser.add_argument("--out", default=None,
+                        help="Binary output path (default: input with .rle extension)")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.input):
+        raise Exception("can't find the file: {}".format(args.input))
+
+    width, height, pixels = LoadImage(args.input, args.raw)
+    frameW, frameH = args.frame if args.frame else (width, height)
+    if width % frameW != 0 or height % frameH != 0:
+        raise Exception("{}x{} is not a whole number of {}x{} frames".format(width, height, frameW, frameH))
+
+    frames = []
+    for fy in range(0, height, frameH):
+        for fx in range(0, width, frameW):
+            frames.append(EncodeSprite(pixels, width, fx, fy, frameW, frameH, args.key))
+
+    rawBytes = width * height * 2
+    rleBytes = sum(len(f) for f in frames)
+    print("{}: {} frame(s) of {}x{}, {} bytes raw -> {} bytes RLE ({:.0f}%)".format(
+        args.input, len(frames), frameW, frameH, rawBytes, rleBytes, 100.0 * rleBytes / rawBytes))
+
+    stem = Path(args.input).stem.replace("-", "_").replace(" ", "_")
+    if args.header:
+        WriteHeader(args.header, stem, frames)
+    else:
+        outPath = args.out if args.out else str(Path(args.input).with_suffix(".rle"))
+        blob = bytearray()
+        for frame in frames:
+            blob += PadByteArray(bytearray(frame), 4)
+        with open(outPath, "wb") as outFile:
+            outFile.write(blob)
+
+
+if __name__ == "__main__":
+    sys.exit(main())